@@ -0,0 +1,474 @@
+#include <metal_stdlib>
+using namespace metal;
+
+#ifndef REAL
+#define REAL float
+#endif
+
+// BLAS flags, as CBLAS numbers them
+constant int TRANS = 112;
+
+// The side of the square tiles that a threadgroup stages in threadgroup memory
+#define TILE 16
+
+// C = alpha * op(A) * op(B) + beta * C, with column major matrices.
+// Each threadgroup computes a TILE x TILE block of C. It steps along k a tile at a time,
+// with every thread loading one element of op(A) and one of op(B) into threadgroup memory,
+// so that each element is read from device memory once per threadgroup rather than once
+// per thread. The tiles are padded by a column to keep their columns on separate banks.
+kernel void blas_gemm (constant int& trans_a [[buffer(0)]], constant int& trans_b [[buffer(1)]],
+                       constant int& m [[buffer(2)]], constant int& n [[buffer(3)]], constant int& k [[buffer(4)]],
+                       constant REAL& alpha [[buffer(5)]],
+                       const device REAL* a [[buffer(6)]],
+                       constant int& offset_a [[buffer(7)]], constant int& ld_a [[buffer(8)]],
+                       const device REAL* b [[buffer(9)]],
+                       constant int& offset_b [[buffer(10)]], constant int& ld_b [[buffer(11)]],
+                       constant REAL& beta [[buffer(12)]],
+                       device REAL* c [[buffer(13)]],
+                       constant int& offset_c [[buffer(14)]], constant int& ld_c [[buffer(15)]],
+                       uint2 group [[threadgroup_position_in_grid]],
+                       uint2 local [[thread_position_in_threadgroup]]) {
+    threadgroup REAL tile_a[TILE][TILE + 1];
+    threadgroup REAL tile_b[TILE][TILE + 1];
+    const int row = group.x * TILE + local.x;
+    const int col = group.y * TILE + local.y;
+    REAL sum = 0;
+    for (int p0 = 0; p0 < k; p0 += TILE) {
+        const int pa = p0 + (int)local.y;
+        const int pb = p0 + (int)local.x;
+        REAL va = 0;
+        if (row < m && pa < k) {
+            va = trans_a == TRANS ? a[offset_a + pa + row * ld_a] : a[offset_a + row + pa * ld_a];
+        }
+        REAL vb = 0;
+        if (pb < k && col < n) {
+            vb = trans_b == TRANS ? b[offset_b + col + pb * ld_b] : b[offset_b + pb + col * ld_b];
+        }
+        tile_a[local.x][local.y] = va;
+        tile_b[local.x][local.y] = vb;
+        threadgroup_barrier(mem_flags::mem_threadgroup);
+        for (int q = 0; q < TILE; q++) {
+            sum += tile_a[local.x][q] * tile_b[q][local.y];
+        }
+        threadgroup_barrier(mem_flags::mem_threadgroup);
+    }
+    if (row < m && col < n) {
+        const int ic = offset_c + row + col * ld_c;
+        // a zero beta does not read C, which may hold NaNs
+        c[ic] = beta == 0 ? alpha * sum : alpha * sum + beta * c[ic];
+    }
+}
+
+// y = alpha * A * x + beta * y, with one thread for each row of y.
+// Neighbouring threads read neighbouring rows of each column, so the reads of A coalesce.
+kernel void blas_gemv_n (constant int& m [[buffer(0)]], constant int& n [[buffer(1)]],
+                         constant REAL& alpha [[buffer(2)]],
+                         const device REAL* a [[buffer(3)]],
+                         constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
+                         const device REAL* x [[buffer(6)]],
+                         constant int& offset_x [[buffer(7)]], constant int& stride_x [[buffer(8)]],
+                         constant REAL& beta [[buffer(9)]],
+                         device REAL* y [[buffer(10)]],
+                         constant int& offset_y [[buffer(11)]], constant int& stride_y [[buffer(12)]],
+                         uint gid [[thread_position_in_grid]]) {
+    const int row = gid;
+    if (row >= m) {
+        return;
+    }
+    REAL sum = 0;
+    for (int j = 0; j < n; j++) {
+        sum += a[offset_a + row + j * ld_a] * x[offset_x + j * stride_x];
+    }
+    const int iy = offset_y + row * stride_y;
+    y[iy] = beta == 0 ? alpha * sum : alpha * sum + beta * y[iy];
+}
+
+// The threads of a simdgroup, and the most simdgroups in a threadgroup
+#define SIMD_WIDTH 32
+#define MAX_SIMDS 32
+
+// y = alpha * A^T * x + beta * y, with one threadgroup for each row of y.
+// The threads of a group step down a column together, and their sums are reduced across each
+// simdgroup and then across the group.
+kernel void blas_gemv_t (constant int& m [[buffer(0)]], constant int& n [[buffer(1)]],
+                         constant REAL& alpha [[buffer(2)]],
+                         const device REAL* a [[buffer(3)]],
+                         constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
+                         const device REAL* x [[buffer(6)]],
+                         constant int& offset_x [[buffer(7)]], constant int& stride_x [[buffer(8)]],
+                         constant REAL& beta [[buffer(9)]],
+                         device REAL* y [[buffer(10)]],
+                         constant int& offset_y [[buffer(11)]], constant int& stride_y [[buffer(12)]],
+                         uint group [[threadgroup_position_in_grid]],
+                         uint local [[thread_position_in_threadgroup]],
+                         uint threads [[threads_per_threadgroup]],
+                         uint lane [[thread_index_in_simdgroup]],
+                         uint simd [[simdgroup_index_in_threadgroup]]) {
+    threadgroup REAL sums[MAX_SIMDS];
+    const int col = group;
+    REAL sum = 0;
+    for (int i = local; i < m; i += threads) {
+        sum += a[offset_a + i + col * ld_a] * x[offset_x + i * stride_x];
+    }
+    sum = simd_sum(sum);
+    if (lane == 0) {
+        sums[simd] = sum;
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    if (local == 0) {
+        REAL total = 0;
+        for (uint s = 0; s < (threads + SIMD_WIDTH - 1) / SIMD_WIDTH; s++) {
+            total += sums[s];
+        }
+        const int iy = offset_y + col * stride_y;
+        y[iy] = beta == 0 ? alpha * total : alpha * total + beta * y[iy];
+    }
+}
+
+// A = alpha * x * y^T + A, with one thread for each element of A
+kernel void blas_ger (constant int& m [[buffer(0)]], constant int& n [[buffer(1)]],
+                      constant REAL& alpha [[buffer(2)]],
+                      const device REAL* x [[buffer(3)]],
+                      constant int& offset_x [[buffer(4)]], constant int& stride_x [[buffer(5)]],
+                      const device REAL* y [[buffer(6)]],
+                      constant int& offset_y [[buffer(7)]], constant int& stride_y [[buffer(8)]],
+                      device REAL* a [[buffer(9)]],
+                      constant int& offset_a [[buffer(10)]], constant int& ld_a [[buffer(11)]],
+                      uint2 gid [[thread_position_in_grid]]) {
+    const int row = gid.x;
+    const int col = gid.y;
+    if (row < m && col < n) {
+        a[offset_a + row + col * ld_a] += alpha * x[offset_x + row * stride_x] * y[offset_y + col * stride_y];
+    }
+}
+
+// Triangles are given by unit and bottom, as in the uplo kernels: bottom is positive for the
+// lower triangle and negative for the upper one, and a unit (132) diagonal is not read.
+constant int UNIT = 132;
+constant int LEFT = 141;
+
+// Element (i, j) of op(A)
+static inline REAL op_at(const device REAL* a, int offset_a, int ld_a, bool trans, int i, int j) {
+    return trans ? a[offset_a + j + i * ld_a] : a[offset_a + i + j * ld_a];
+}
+
+// Whether element (i, j) of op(A) lies in its triangle, where lower is the triangle of op(A)
+static inline bool in_triangle(bool lower, int i, int j) {
+    return lower ? i >= j : i <= j;
+}
+
+// y = op(A) * x, with one thread for each element. x and y are the same array, read from
+// one buffer and written to another, so that no thread overwrites what another reads.
+kernel void blas_trmv (constant int& trans [[buffer(0)]], constant int& sd [[buffer(1)]],
+                       constant int& unit [[buffer(2)]], constant int& bottom [[buffer(3)]],
+                       const device REAL* a [[buffer(4)]],
+                       constant int& offset_a [[buffer(5)]], constant int& ld_a [[buffer(6)]],
+                       const device REAL* x [[buffer(7)]],
+                       constant int& offset_x [[buffer(8)]], constant int& stride_x [[buffer(9)]],
+                       device REAL* y [[buffer(10)]],
+                       constant int& offset_y [[buffer(11)]], constant int& stride_y [[buffer(12)]],
+                       uint gid [[thread_position_in_grid]]) {
+    const int i = gid;
+    if (i >= sd) {
+        return;
+    }
+    const bool t = trans == TRANS;
+    const bool lower = (bottom > 0) != t;
+    REAL sum = unit == UNIT ? x[offset_x + i * stride_x] : op_at(a, offset_a, ld_a, t, i, i) * x[offset_x + i * stride_x];
+    const int first = lower ? 0 : i + 1;
+    const int last = lower ? i : sd;
+    for (int p = first; p < last; p++) {
+        sum += op_at(a, offset_a, ld_a, t, i, p) * x[offset_x + p * stride_x];
+    }
+    y[offset_y + i * stride_y] = sum;
+}
+
+// Solves op(A) * y = x in place for one vector, by columns: each element is divided by the
+// diagonal, and then the threads of the group take its part out of the elements after it.
+static void solve_vector(bool trans, int sd, int unit, bool lower,
+                         const device REAL* a, int offset_a, int ld_a,
+                         device REAL* x, int offset_x, int stride_x, uint local, uint threads) {
+    for (int s = 0; s < sd; s++) {
+        const int j = lower ? s : sd - 1 - s;
+        if (local == 0 && unit != UNIT) {
+            x[offset_x + j * stride_x] /= op_at(a, offset_a, ld_a, trans, j, j);
+        }
+        threadgroup_barrier(mem_flags::mem_device);
+        const REAL xj = x[offset_x + j * stride_x];
+        const int first = lower ? j + 1 : 0;
+        const int last = lower ? sd : j;
+        for (int i = first + (int)local; i < last; i += threads) {
+            x[offset_x + i * stride_x] -= op_at(a, offset_a, ld_a, trans, i, j) * xj;
+        }
+        threadgroup_barrier(mem_flags::mem_device);
+    }
+}
+
+// Solves op(A) * y = x in place, in a single threadgroup
+kernel void blas_trsv (constant int& trans [[buffer(0)]], constant int& sd [[buffer(1)]],
+                       constant int& unit [[buffer(2)]], constant int& bottom [[buffer(3)]],
+                       const device REAL* a [[buffer(4)]],
+                       constant int& offset_a [[buffer(5)]], constant int& ld_a [[buffer(6)]],
+                       device REAL* x [[buffer(7)]],
+                       constant int& offset_x [[buffer(8)]], constant int& stride_x [[buffer(9)]],
+                       uint local [[thread_position_in_threadgroup]],
+                       uint threads [[threads_per_threadgroup]]) {
+    const bool t = trans == TRANS;
+    solve_vector(t, sd, unit, (bottom > 0) != t, a, offset_a, ld_a, x, offset_x, stride_x, local, threads);
+}
+
+// C = alpha * op(A) * B (left) or alpha * B * op(A) (right), with one thread for each element.
+// B and C are the same array, read from one buffer and written to another.
+kernel void blas_trmm (constant int& side [[buffer(0)]], constant int& trans [[buffer(1)]],
+                       constant int& m [[buffer(2)]], constant int& n [[buffer(3)]],
+                       constant int& unit [[buffer(4)]], constant int& bottom [[buffer(5)]],
+                       constant REAL& alpha [[buffer(6)]],
+                       const device REAL* a [[buffer(7)]],
+                       constant int& offset_a [[buffer(8)]], constant int& ld_a [[buffer(9)]],
+                       const device REAL* b [[buffer(10)]],
+                       constant int& offset_b [[buffer(11)]], constant int& ld_b [[buffer(12)]],
+                       device REAL* c [[buffer(13)]],
+                       constant int& offset_c [[buffer(14)]], constant int& ld_c [[buffer(15)]],
+                       uint2 gid [[thread_position_in_grid]]) {
+    const int i = gid.x;
+    const int j = gid.y;
+    if (i >= m || j >= n) {
+        return;
+    }
+    const bool t = trans == TRANS;
+    const bool lower = (bottom > 0) != t;
+    REAL sum = 0;
+    if (side == LEFT) {
+        // row i of op(A) is non-zero from column 0 (lower) or i (upper)
+        for (int p = lower ? 0 : i; p < (lower ? i + 1 : m); p++) {
+            const REAL ap = (p == i && unit == UNIT) ? 1 : op_at(a, offset_a, ld_a, t, i, p);
+            sum += ap * b[offset_b + p + j * ld_b];
+        }
+    } else {
+        // column j of op(A) is non-zero from row j (lower) or 0 (upper)
+        for (int p = lower ? j : 0; p < (lower ? n : j + 1); p++) {
+            const REAL ap = (p == j && unit == UNIT) ? 1 : op_at(a, offset_a, ld_a, t, p, j);
+            sum += b[offset_b + i + p * ld_b] * ap;
+        }
+    }
+    c[offset_c + i + j * ld_c] = alpha * sum;
+}
+
+// Solves op(A) * X = alpha * B (left) or X * op(A) = alpha * B (right) in place, with a
+// threadgroup for each column (left) or row (right) of B. A row of X solves op(A)^T * x = b.
+kernel void blas_trsm (constant int& side [[buffer(0)]], constant int& trans [[buffer(1)]],
+                       constant int& m [[buffer(2)]], constant int& n [[buffer(3)]],
+                       constant int& unit [[buffer(4)]], constant int& bottom [[buffer(5)]],
+                       constant REAL& alpha [[buffer(6)]],
+                       const device REAL* a [[buffer(7)]],
+                       constant int& offset_a [[buffer(8)]], constant int& ld_a [[buffer(9)]],
+                       device REAL* b [[buffer(10)]],
+                       constant int& offset_b [[buffer(11)]], constant int& ld_b [[buffer(12)]],
+                       uint group [[threadgroup_position_in_grid]],
+                       uint local [[thread_position_in_threadgroup]],
+                       uint threads [[threads_per_threadgroup]]) {
+    const bool left = side == LEFT;
+    const bool t = trans == TRANS;
+    const int sd = left ? m : n;
+    const int start = left ? offset_b + group * ld_b : offset_b + group;
+    const int stride = left ? 1 : ld_b;
+    for (int i = local; i < sd; i += threads) {
+        b[start + i * stride] *= alpha;
+    }
+    threadgroup_barrier(mem_flags::mem_device);
+    const bool tv = left ? t : !t;
+    solve_vector(tv, sd, unit, (bottom > 0) != tv, a, offset_a, ld_a, b, start, stride, local, threads);
+}
+
+// C = alpha * op(A) * op(A)^T + beta * C, with one thread for each element in the triangle of C
+kernel void blas_syrk (constant int& trans [[buffer(0)]], constant int& n [[buffer(1)]], constant int& k [[buffer(2)]],
+                       constant int& bottom [[buffer(3)]],
+                       constant REAL& alpha [[buffer(4)]],
+                       const device REAL* a [[buffer(5)]],
+                       constant int& offset_a [[buffer(6)]], constant int& ld_a [[buffer(7)]],
+                       constant REAL& beta [[buffer(8)]],
+                       device REAL* c [[buffer(9)]],
+                       constant int& offset_c [[buffer(10)]], constant int& ld_c [[buffer(11)]],
+                       uint2 gid [[thread_position_in_grid]]) {
+    const int i = gid.x;
+    const int j = gid.y;
+    if (i >= n || j >= n || !in_triangle(bottom > 0, i, j)) {
+        return;
+    }
+    const bool t = trans == TRANS;
+    REAL sum = 0;
+    for (int p = 0; p < k; p++) {
+        sum += op_at(a, offset_a, ld_a, t, i, p) * op_at(a, offset_a, ld_a, t, j, p);
+    }
+    const int ic = offset_c + i + j * ld_c;
+    c[ic] = beta == 0 ? alpha * sum : alpha * sum + beta * c[ic];
+}
+
+// Factors the symmetric positive definite block of A given by bottom in place, as L * L^T
+// (lower) or U^T * U (upper), in a single threadgroup: each column is scaled by the square root
+// of its diagonal, and then the threads of the group take its product from the columns after it.
+// A diagonal that is not positive is left as NaN for the host to find.
+kernel void blas_potrf (constant int& sd [[buffer(0)]], constant int& bottom [[buffer(1)]],
+                        device REAL* a [[buffer(2)]],
+                        constant int& offset_a [[buffer(3)]], constant int& ld_a [[buffer(4)]],
+                        uint local [[thread_position_in_threadgroup]],
+                        uint threads [[threads_per_threadgroup]]) {
+    // element (i, j) of the lower factor, which is (j, i) of the upper one
+    const int di = bottom > 0 ? 1 : ld_a;
+    const int dj = bottom > 0 ? ld_a : 1;
+    for (int j = 0; j < sd; j++) {
+        const int jj = offset_a + j * (di + dj);
+        if (local == 0) {
+            a[jj] = a[jj] > 0 ? sqrt(a[jj]) : NAN;
+        }
+        threadgroup_barrier(mem_flags::mem_device);
+        const REAL diagonal = a[jj];
+        for (int i = j + 1 + (int)local; i < sd; i += threads) {
+            a[offset_a + i * di + j * dj] /= diagonal;
+        }
+        threadgroup_barrier(mem_flags::mem_device);
+        for (int c = j + 1 + (int)local; c < sd; c += threads) {
+            const REAL acj = a[offset_a + c * di + j * dj];
+            for (int i = c; i < sd; i++) {
+                a[offset_a + i * di + c * dj] -= a[offset_a + i * di + j * dj] * acj;
+            }
+        }
+        threadgroup_barrier(mem_flags::mem_device);
+    }
+}
+
+// Packed triangles hold one triangle column by column with no gaps, as BLAS packs them.
+// The index of element (i, j), which lies in the triangle
+static inline int packed_index(int sd, bool lower, int i, int j) {
+    return lower ? j * (2 * sd - j + 1) / 2 + (i - j) : j * (j + 1) / 2 + i;
+}
+
+// The element (i, j) at index k of a packed triangle. The lower triangle is the upper one turned
+// over, read from its last element.
+static inline void packed_element(uint k, int sd, bool lower, thread int& i, thread int& j) {
+    const uint q = lower ? (uint)(sd * (sd + 1) / 2) - 1 - k : k;
+    // column c of the upper triangle starts at c * (c + 1) / 2. The float root can be one off for large q.
+    uint c = (uint)((sqrt(8.0f * q + 1.0f) - 1.0f) * 0.5f);
+    while (c * (c + 1) / 2 > q) {
+        c--;
+    }
+    while ((c + 1) * (c + 2) / 2 <= q) {
+        c++;
+    }
+    const int r = q - c * (c + 1) / 2;
+    i = lower ? sd - 1 - r : r;
+    j = lower ? sd - 1 - (int)c : (int)c;
+}
+
+// Packs the triangle of A given by bottom into ap, with one thread for each packed element
+kernel void blas_trttp (constant int& sd [[buffer(0)]], constant int& bottom [[buffer(1)]],
+                        const device REAL* a [[buffer(2)]],
+                        constant int& offset_a [[buffer(3)]], constant int& ld_a [[buffer(4)]],
+                        device REAL* ap [[buffer(5)]], constant int& offset_ap [[buffer(6)]],
+                        uint k [[thread_position_in_grid]]) {
+    if (k >= (uint)(sd * (sd + 1) / 2)) {
+        return;
+    }
+    int i, j;
+    packed_element(k, sd, bottom > 0, i, j);
+    ap[offset_ap + k] = a[offset_a + i + j * ld_a];
+}
+
+// Unpacks ap into the triangle of A given by bottom, with one thread for each packed element
+kernel void blas_tpttr (constant int& sd [[buffer(0)]], constant int& bottom [[buffer(1)]],
+                        const device REAL* ap [[buffer(2)]], constant int& offset_ap [[buffer(3)]],
+                        device REAL* a [[buffer(4)]],
+                        constant int& offset_a [[buffer(5)]], constant int& ld_a [[buffer(6)]],
+                        uint k [[thread_position_in_grid]]) {
+    if (k >= (uint)(sd * (sd + 1) / 2)) {
+        return;
+    }
+    int i, j;
+    packed_element(k, sd, bottom > 0, i, j);
+    a[offset_a + i + j * ld_a] = ap[offset_ap + k];
+}
+
+// y = op(A) * x for a packed triangle, as blas_trmv does for a full one
+kernel void blas_tpmv (constant int& trans [[buffer(0)]], constant int& sd [[buffer(1)]],
+                       constant int& unit [[buffer(2)]], constant int& bottom [[buffer(3)]],
+                       const device REAL* ap [[buffer(4)]], constant int& offset_ap [[buffer(5)]],
+                       const device REAL* x [[buffer(6)]],
+                       constant int& offset_x [[buffer(7)]], constant int& stride_x [[buffer(8)]],
+                       device REAL* y [[buffer(9)]],
+                       constant int& offset_y [[buffer(10)]], constant int& stride_y [[buffer(11)]],
+                       uint gid [[thread_position_in_grid]]) {
+    const int i = gid;
+    if (i >= sd) {
+        return;
+    }
+    const bool t = trans == TRANS;
+    const bool stored = bottom > 0;
+    // row i of op(A) is row i of the triangle, or column i with the transpose
+    const bool lower = stored != t;
+    const int first = lower ? 0 : i + 1;
+    const int last = lower ? i : sd;
+    REAL sum = unit == UNIT ? x[offset_x + i * stride_x]
+                            : ap[offset_ap + packed_index(sd, stored, i, i)] * x[offset_x + i * stride_x];
+    for (int p = first; p < last; p++) {
+        const int k = t ? packed_index(sd, stored, p, i) : packed_index(sd, stored, i, p);
+        sum += ap[offset_ap + k] * x[offset_x + p * stride_x];
+    }
+    y[offset_y + i * stride_y] = sum;
+}
+
+// y = alpha * A * x + beta * y for the symmetric A given by a packed triangle, with one thread
+// for each element of y. Row i is row i of the triangle, and then column i past the diagonal.
+kernel void blas_spmv (constant int& sd [[buffer(0)]], constant int& bottom [[buffer(1)]],
+                       constant REAL& alpha [[buffer(2)]],
+                       const device REAL* ap [[buffer(3)]], constant int& offset_ap [[buffer(4)]],
+                       const device REAL* x [[buffer(5)]],
+                       constant int& offset_x [[buffer(6)]], constant int& stride_x [[buffer(7)]],
+                       constant REAL& beta [[buffer(8)]],
+                       device REAL* y [[buffer(9)]],
+                       constant int& offset_y [[buffer(10)]], constant int& stride_y [[buffer(11)]],
+                       uint gid [[thread_position_in_grid]]) {
+    const int i = gid;
+    if (i >= sd) {
+        return;
+    }
+    const bool lower = bottom > 0;
+    REAL sum = 0;
+    for (int p = 0; p < sd; p++) {
+        const int k = in_triangle(lower, i, p) ? packed_index(sd, lower, i, p) : packed_index(sd, lower, p, i);
+        sum += ap[offset_ap + k] * x[offset_x + p * stride_x];
+    }
+    const int iy = offset_y + i * stride_y;
+    y[iy] = beta == 0 ? alpha * sum : alpha * sum + beta * y[iy];
+}
+
+// B = alpha * op(A), where A is m x n, with one thread for each element of A. With the transpose,
+// each threadgroup reads a TILE x TILE block of A down its columns into threadgroup memory, and
+// writes the block turned over down the columns of B, so both sides are read and written in order.
+kernel void blas_omatcopy (constant int& trans [[buffer(0)]], constant int& m [[buffer(1)]], constant int& n [[buffer(2)]],
+                           constant REAL& alpha [[buffer(3)]],
+                           const device REAL* a [[buffer(4)]],
+                           constant int& offset_a [[buffer(5)]], constant int& ld_a [[buffer(6)]],
+                           device REAL* b [[buffer(7)]],
+                           constant int& offset_b [[buffer(8)]], constant int& ld_b [[buffer(9)]],
+                           uint2 group [[threadgroup_position_in_grid]],
+                           uint2 local [[thread_position_in_threadgroup]]) {
+    threadgroup REAL tile[TILE][TILE + 1];
+    const int i = group.x * TILE + local.x;
+    const int j = group.y * TILE + local.y;
+    if (trans != TRANS) {
+        if (i < m && j < n) {
+            b[offset_b + i + j * ld_b] = alpha * a[offset_a + i + j * ld_a];
+        }
+        return;
+    }
+    if (i < m && j < n) {
+        tile[local.y][local.x] = a[offset_a + i + j * ld_a];
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    // element (bi, bj) of B is (bj, bi) of A
+    const int bi = group.y * TILE + local.x;
+    const int bj = group.x * TILE + local.y;
+    if (bi < n && bj < m) {
+        b[offset_b + bi + bj * ld_b] = alpha * tile[local.x][local.y];
+    }
+}
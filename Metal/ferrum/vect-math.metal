@@ -233,481 +233,481 @@ inline REAL log1p(REAL x) {
 
 
 kernel void vector_sqr (const device REAL* x,
-                        constant uint& offset_x,
-                        constant uint& stride_x,
+                        constant int& offset_x,
+                        constant int& stride_x,
                         device REAL* y,
-                        constant uint& offset_y,
-                        constant uint& stride_y,
+                        constant int& offset_y,
+                        constant int& stride_y,
                         uint gid [[thread_position_in_grid]]) {
-    REAL xval = x[offset_x + gid * stride_x];
-    y[offset_y + gid * stride_y] = xval * xval;
+    REAL xval = x[offset_x + (int)gid * stride_x];
+    y[offset_y + (int)gid * stride_y] = xval * xval;
 }
 
-kernel void vector_mul (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                        const device REAL* y, constant uint& offset_y, constant uint& stride_y,
-                        device REAL* z, constant uint& offset_z, constant uint& stride_z,
+kernel void vector_mul (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                        const device REAL* y, constant int& offset_y, constant int& stride_y,
+                        device REAL* z, constant int& offset_z, constant int& stride_z,
                         uint id [[thread_position_in_grid]]) {
-    z[offset_z + id * stride_z] = x[offset_x + id * stride_x] * y[offset_y + id * stride_y];
+    z[offset_z + (int)id * stride_z] = x[offset_x + (int)id * stride_x] * y[offset_y + (int)id * stride_y];
 }
 
 
-kernel void vector_div (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                        const device REAL* y, constant uint& offset_y, constant uint& stride_y,
-                        device REAL* z, constant uint& offset_z, constant uint& stride_z,
+kernel void vector_div (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                        const device REAL* y, constant int& offset_y, constant int& stride_y,
+                        device REAL* z, constant int& offset_z, constant int& stride_z,
                         uint id [[thread_position_in_grid]]) {
-    z[offset_z + id * stride_z] = x[offset_x + id * stride_x] / y[offset_y + id * stride_y];
+    z[offset_z + (int)id * stride_z] = x[offset_x + (int)id * stride_x] / y[offset_y + (int)id * stride_y];
 }
 
 
-kernel void vector_add (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                        const device REAL* y, constant uint& offset_y, constant uint& stride_y,
-                        device REAL* z, constant uint& offset_z, constant uint& stride_z,
+kernel void vector_add (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                        const device REAL* y, constant int& offset_y, constant int& stride_y,
+                        device REAL* z, constant int& offset_z, constant int& stride_z,
                         uint id [[thread_position_in_grid]]) {
-    z[offset_z + id * stride_z] = x[offset_x + id * stride_x] + y[offset_y + id * stride_y];
+    z[offset_z + (int)id * stride_z] = x[offset_x + (int)id * stride_x] + y[offset_y + (int)id * stride_y];
 }
 
 
-kernel void vector_sub (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                        const device REAL* y, constant uint& offset_y, constant uint& stride_y,
-                        device REAL* z, constant uint& offset_z, constant uint& stride_z,
+kernel void vector_sub (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                        const device REAL* y, constant int& offset_y, constant int& stride_y,
+                        device REAL* z, constant int& offset_z, constant int& stride_z,
                         uint id [[thread_position_in_grid]]) {
-    z[offset_z + id * stride_z] = x[offset_x + id * stride_x] - y[offset_y + id * stride_y];
+    z[offset_z + (int)id * stride_z] = x[offset_x + (int)id * stride_x] - y[offset_y + (int)id * stride_y];
 }
 
 
-kernel void vector_inv (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                        device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_inv (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                        device REAL* y, constant int& offset_y, constant int& stride_y,
                         uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = (REAL)1.0 / x[offset_x + id * stride_x];
+    y[offset_y + (int)id * stride_y] = (REAL)1.0 / x[offset_x + (int)id * stride_x];
 }
 
 
-kernel void vector_abs (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                        device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_abs (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                        device REAL* y, constant int& offset_y, constant int& stride_y,
                         uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = abs(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = abs(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_linear_frac (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                                const device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_linear_frac (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                                const device REAL* y, constant int& offset_y, constant int& stride_y,
                                 constant REAL& scalea, constant REAL& shifta,
                                 constant REAL& scaleb, constant REAL& shiftb,
-                                device REAL* z, constant uint& offset_z, constant uint& stride_z,
+                                device REAL* z, constant int& offset_z, constant int& stride_z,
                                 uint id [[thread_position_in_grid]]) {
-    z[offset_z + id * stride_z] =
-        (scalea * x[offset_x + id * stride_x] + shifta) /
-        (scaleb * y[offset_y + id * stride_y] + shiftb);
+    z[offset_z + (int)id * stride_z] =
+        (scalea * x[offset_x + (int)id * stride_x] + shifta) /
+        (scaleb * y[offset_y + (int)id * stride_y] + shiftb);
 }
 
 
 // TODO: do the scaleb and shiftb values need to be included?
 
-kernel void vector_scale_shift (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
+kernel void vector_scale_shift (const device REAL* x, constant int& offset_x, constant int& stride_x,
                                 constant REAL& scalea, constant REAL& shifta,
                                 constant REAL& scaleb, constant REAL& shiftb,
-                                device REAL* y, constant uint& offset_y, constant uint& stride_y,
+                                device REAL* y, constant int& offset_y, constant int& stride_y,
                                 uint id [[thread_position_in_grid]]) {
-  y[offset_y + id * stride_y] = scalea * x[offset_x + id * stride_x] + shifta;
+  y[offset_y + (int)id * stride_y] = scalea * x[offset_x + (int)id * stride_x] + shifta;
 }
 
 
-kernel void vector_fmod (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                         const device REAL* y, constant uint& offset_y, constant uint& stride_y,
-                         device REAL* z, constant uint& offset_z, constant uint& stride_z,
+kernel void vector_fmod (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                         const device REAL* y, constant int& offset_y, constant int& stride_y,
+                         device REAL* z, constant int& offset_z, constant int& stride_z,
                          uint id [[thread_position_in_grid]]) {
-    z[offset_z + id * stride_z] = fmod(x[offset_x + id * stride_x], y[offset_y + id * stride_y]);
+    z[offset_z + (int)id * stride_z] = fmod(x[offset_x + (int)id * stride_x], y[offset_y + (int)id * stride_y]);
 }
 
 
-kernel void vector_frem (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                         const device REAL* y, constant uint& offset_y, constant uint& stride_y,
-                         device REAL* z, constant uint& offset_z, constant uint& stride_z,
+kernel void vector_frem (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                         const device REAL* y, constant int& offset_y, constant int& stride_y,
+                         device REAL* z, constant int& offset_z, constant int& stride_z,
                          uint id [[thread_position_in_grid]]) {
-    z[offset_z + id * stride_z] = remainder(x[offset_x + id * stride_x], y[offset_y + id * stride_y]);
+    z[offset_z + (int)id * stride_z] = remainder(x[offset_x + (int)id * stride_x], y[offset_y + (int)id * stride_y]);
 }
 
 
-kernel void vector_sqrt (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                         device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_sqrt (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                         device REAL* y, constant int& offset_y, constant int& stride_y,
                          uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = sqrt(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = sqrt(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_inv_sqrt (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                             device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_inv_sqrt (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                             device REAL* y, constant int& offset_y, constant int& stride_y,
                              uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = rsqrt(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = rsqrt(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_cbrt (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                         device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_cbrt (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                         device REAL* y, constant int& offset_y, constant int& stride_y,
                          uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = pow(x[offset_x + id * stride_x], REAL1o3);
+    y[offset_y + (int)id * stride_y] = pow(x[offset_x + (int)id * stride_x], REAL1o3);
 }
 
 
-kernel void vector_inv_cbrt (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                             device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_inv_cbrt (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                             device REAL* y, constant int& offset_y, constant int& stride_y,
                              uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = (REAL)1.0 / pow(x[offset_x + id * stride_x], REAL1o3);
+    y[offset_y + (int)id * stride_y] = (REAL)1.0 / pow(x[offset_x + (int)id * stride_x], REAL1o3);
 }
 
 
-kernel void vector_pow2o3 (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                           device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_pow2o3 (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                           device REAL* y, constant int& offset_y, constant int& stride_y,
                            uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = pow(x[offset_x + id * stride_x], REAL2o3);
+    y[offset_y + (int)id * stride_y] = pow(x[offset_x + (int)id * stride_x], REAL2o3);
 }
 
 
-kernel void vector_pow3o2 (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                           device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_pow3o2 (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                           device REAL* y, constant int& offset_y, constant int& stride_y,
                            uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = pow(x[offset_x + id * stride_x], REAL3o2);
+    y[offset_y + (int)id * stride_y] = pow(x[offset_x + (int)id * stride_x], REAL3o2);
 }
 
 
-kernel void vector_pow (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                        const device REAL* y, constant uint& offset_y, constant uint& stride_y,
-                        device REAL* z, constant uint& offset_z, constant uint& stride_z,
+kernel void vector_pow (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                        const device REAL* y, constant int& offset_y, constant int& stride_y,
+                        device REAL* z, constant int& offset_z, constant int& stride_z,
                         uint id [[thread_position_in_grid]]) {
-    z[offset_z + id * stride_z] = pow(x[offset_x + id * stride_x], y[offset_y + id * stride_y]);
+    z[offset_z + (int)id * stride_z] = pow(x[offset_x + (int)id * stride_x], y[offset_y + (int)id * stride_y]);
 }
 
 
-kernel void vector_powx (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
+kernel void vector_powx (const device REAL* x, constant int& offset_x, constant int& stride_x,
                          constant REAL& b,
-                         device REAL* y, constant uint& offset_y, constant uint& stride_y,
+                         device REAL* y, constant int& offset_y, constant int& stride_y,
                          uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = pow(x[offset_x + id * stride_x], b);
+    y[offset_y + (int)id * stride_y] = pow(x[offset_x + (int)id * stride_x], b);
 }
 
 
-kernel void vector_hypot (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                          const device REAL* y, constant uint& offset_y, constant uint& stride_y,
-                          device REAL* z, constant uint& offset_z, constant uint& stride_z,
+kernel void vector_hypot (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                          const device REAL* y, constant int& offset_y, constant int& stride_y,
+                          device REAL* z, constant int& offset_z, constant int& stride_z,
                           uint id [[thread_position_in_grid]]) {
-    z[offset_z + id * stride_z] = hypot(x[offset_x + id * stride_x], y[offset_y + id * stride_y]);
+    z[offset_z + (int)id * stride_z] = hypot(x[offset_x + (int)id * stride_x], y[offset_y + (int)id * stride_y]);
 }
 
 
-kernel void vector_exp (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                        device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_exp (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                        device REAL* y, constant int& offset_y, constant int& stride_y,
                         uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = exp(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = exp(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_exp2 (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                         device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_exp2 (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                         device REAL* y, constant int& offset_y, constant int& stride_y,
                          uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = exp2(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = exp2(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_exp10 (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                          device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_exp10 (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                          device REAL* y, constant int& offset_y, constant int& stride_y,
                           uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = pow((REAL)10.0, x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = pow((REAL)10.0, x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_expm1 (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                          device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_expm1 (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                          device REAL* y, constant int& offset_y, constant int& stride_y,
                           uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = expm1(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = expm1(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_log (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                        device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_log (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                        device REAL* y, constant int& offset_y, constant int& stride_y,
                         uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = log(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = log(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_log2 (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                         device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_log2 (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                         device REAL* y, constant int& offset_y, constant int& stride_y,
                          uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = log2(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = log2(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_log10 (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                          device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_log10 (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                          device REAL* y, constant int& offset_y, constant int& stride_y,
                           uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = log10(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = log10(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_log1p (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                          device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_log1p (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                          device REAL* y, constant int& offset_y, constant int& stride_y,
                           uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = log1p(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = log1p(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_sin (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                        device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_sin (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                        device REAL* y, constant int& offset_y, constant int& stride_y,
                         uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = sin(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = sin(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_cos (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                        device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_cos (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                        device REAL* y, constant int& offset_y, constant int& stride_y,
                         uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = cos(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = cos(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_tan (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                        device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_tan (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                        device REAL* y, constant int& offset_y, constant int& stride_y,
                         uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = tan(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = tan(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_sincos (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                           device REAL* y, constant uint& offset_y, constant uint& stride_y,
-                           device REAL* z, constant uint& offset_z, constant uint& stride_z,
+kernel void vector_sincos (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                           device REAL* y, constant int& offset_y, constant int& stride_y,
+                           device REAL* z, constant int& offset_z, constant int& stride_z,
                            uint id [[thread_position_in_grid]]) {
-    REAL xval = x[offset_x + id * stride_x];
-    y[offset_y + id * stride_y] = sin(xval);
-    z[offset_z + id * stride_z] = cos(xval);
+    REAL xval = x[offset_x + (int)id * stride_x];
+    y[offset_y + (int)id * stride_y] = sin(xval);
+    z[offset_z + (int)id * stride_z] = cos(xval);
 }
 
 
-kernel void vector_asin (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                         device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_asin (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                         device REAL* y, constant int& offset_y, constant int& stride_y,
                          uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = asin(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = asin(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_acos (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                         device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_acos (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                         device REAL* y, constant int& offset_y, constant int& stride_y,
                          uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = acos(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = acos(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_atan (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                         device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_atan (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                         device REAL* y, constant int& offset_y, constant int& stride_y,
                          uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = atan(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = atan(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_atan2 (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                          const device REAL* y, constant uint& offset_y, constant uint& stride_y,
-                          device REAL* z, constant uint& offset_z, constant uint& stride_z,
+kernel void vector_atan2 (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                          const device REAL* y, constant int& offset_y, constant int& stride_y,
+                          device REAL* z, constant int& offset_z, constant int& stride_z,
                           uint id [[thread_position_in_grid]]) {
-    z[offset_z + id * stride_z] = atan2(x[offset_x + id * stride_x], y[offset_y + id * stride_y]);
+    z[offset_z + (int)id * stride_z] = atan2(x[offset_x + (int)id * stride_x], y[offset_y + (int)id * stride_y]);
 }
 
 
-kernel void vector_sinh (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                         device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_sinh (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                         device REAL* y, constant int& offset_y, constant int& stride_y,
                          uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = sinh(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = sinh(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_cosh (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                         device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_cosh (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                         device REAL* y, constant int& offset_y, constant int& stride_y,
                          uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = cosh(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = cosh(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_tanh (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                         device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_tanh (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                         device REAL* y, constant int& offset_y, constant int& stride_y,
                          uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = tanh(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = tanh(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_asinh (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                          device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_asinh (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                          device REAL* y, constant int& offset_y, constant int& stride_y,
                           uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = asinh(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = asinh(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_acosh (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                          device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_acosh (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                          device REAL* y, constant int& offset_y, constant int& stride_y,
                           uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = acosh(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = acosh(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_atanh (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                          device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_atanh (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                          device REAL* y, constant int& offset_y, constant int& stride_y,
                           uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = atanh(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = atanh(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_erf (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                        device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_erf (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                        device REAL* y, constant int& offset_y, constant int& stride_y,
                         uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = erf(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = erf(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_erf_inv (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                            device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_erf_inv (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                            device REAL* y, constant int& offset_y, constant int& stride_y,
                             uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = erfinv(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = erfinv(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_erfc (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                         device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_erfc (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                         device REAL* y, constant int& offset_y, constant int& stride_y,
                          uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = erfc(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = erfc(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_erfc_inv (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                             device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_erfc_inv (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                             device REAL* y, constant int& offset_y, constant int& stride_y,
                              uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = erfcinv(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = erfcinv(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_cdf_norm (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                             device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_cdf_norm (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                             device REAL* y, constant int& offset_y, constant int& stride_y,
                              uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = normcdf(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = normcdf(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_cdf_norm_inv (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                                 device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_cdf_norm_inv (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                                 device REAL* y, constant int& offset_y, constant int& stride_y,
                                  uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = normcdfinv(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = normcdfinv(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_gamma (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                          device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_gamma (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                          device REAL* y, constant int& offset_y, constant int& stride_y,
                           uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = tgamma(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = tgamma(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_lgamma (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                           device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_lgamma (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                           device REAL* y, constant int& offset_y, constant int& stride_y,
                            uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = lgamma(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = lgamma(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_floor (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                          device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_floor (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                          device REAL* y, constant int& offset_y, constant int& stride_y,
                           uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = floor(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = floor(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_ceil (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                         device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_ceil (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                         device REAL* y, constant int& offset_y, constant int& stride_y,
                          uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = ceil(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = ceil(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_trunc (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                          device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_trunc (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                          device REAL* y, constant int& offset_y, constant int& stride_y,
                           uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = trunc(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = trunc(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_round (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                          device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_round (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                          device REAL* y, constant int& offset_y, constant int& stride_y,
                           uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = round(x[offset_x + id * stride_x]);
+    y[offset_y + (int)id * stride_y] = round(x[offset_x + (int)id * stride_x]);
 }
 
 
-kernel void vector_modf (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                         device REAL* y, constant uint& offset_y, constant uint& stride_y,
-                         device REAL* z, constant uint& offset_z, constant uint& stride_z,
+kernel void vector_modf (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                         device REAL* y, constant int& offset_y, constant int& stride_y,
+                         device REAL* z, constant int& offset_z, constant int& stride_z,
                          uint id [[thread_position_in_grid]]) {
-    REAL xval = x[offset_x + id * stride_x];
+    REAL xval = x[offset_x + (int)id * stride_x];
     REAL intpart = (REAL)((long)xval);
-    z[offset_z + id * stride_z] = xval - intpart;
-    y[offset_z + id * stride_z] = intpart;
+    z[offset_z + (int)id * stride_z] = xval - intpart;
+    y[offset_z + (int)id * stride_z] = intpart;
 }
 
 
-kernel void vector_frac (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                         device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_frac (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                         device REAL* y, constant int& offset_y, constant int& stride_y,
                          uint id [[thread_position_in_grid]]) {
-    REAL xval = x[offset_x + id * stride_x];
-    y[offset_y + id * stride_y] = xval - (REAL)((long)xval);
+    REAL xval = x[offset_x + (int)id * stride_x];
+    y[offset_y + (int)id * stride_y] = xval - (REAL)((long)xval);
 }
 
 
-kernel void vector_fmax (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                         const device REAL* y, constant uint& offset_y, constant uint& stride_y,
-                         device REAL* z, constant uint& offset_z, constant uint& stride_z,
+kernel void vector_fmax (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                         const device REAL* y, constant int& offset_y, constant int& stride_y,
+                         device REAL* z, constant int& offset_z, constant int& stride_z,
                          uint id [[thread_position_in_grid]]) {
-    z[offset_z + id * stride_z] = fmax(x[offset_x + id * stride_x], y[offset_y + id * stride_y]);
+    z[offset_z + (int)id * stride_z] = fmax(x[offset_x + (int)id * stride_x], y[offset_y + (int)id * stride_y]);
 }
 
 
-kernel void vector_fmin (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                         const device REAL* y, constant uint& offset_y, constant uint& stride_y,
-                         device REAL* z, constant uint& offset_z, constant uint& stride_z,
+kernel void vector_fmin (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                         const device REAL* y, constant int& offset_y, constant int& stride_y,
+                         device REAL* z, constant int& offset_z, constant int& stride_z,
                          uint id [[thread_position_in_grid]]) {
-    z[offset_z + id * stride_z] = fmin(x[offset_x + id * stride_x], y[offset_y + id * stride_y]);
+    z[offset_z + (int)id * stride_z] = fmin(x[offset_x + (int)id * stride_x], y[offset_y + (int)id * stride_y]);
 }
 
 
-kernel void vector_copysign (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                             const device REAL* y, constant uint& offset_y, constant uint& stride_y,
-                             device REAL* z, constant uint& offset_z, constant uint& stride_z,
+kernel void vector_copysign (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                             const device REAL* y, constant int& offset_y, constant int& stride_y,
+                             device REAL* z, constant int& offset_z, constant int& stride_z,
                              uint id [[thread_position_in_grid]]) {
-    z[offset_z + id * stride_z] = copysign(x[offset_x + id * stride_x], y[offset_y + id * stride_y]);
+    z[offset_z + (int)id * stride_z] = copysign(x[offset_x + (int)id * stride_x], y[offset_y + (int)id * stride_y]);
 }
 
 
-kernel void vector_sigmoid (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                            device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_sigmoid (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                            device REAL* y, constant int& offset_y, constant int& stride_y,
                             uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = tanh(REAL1o2 * x[offset_x + id * stride_x]) * REAL1o2 + REAL1o2;
+    y[offset_y + (int)id * stride_y] = tanh(REAL1o2 * x[offset_x + (int)id * stride_x]) * REAL1o2 + REAL1o2;
 }
 
 
-kernel void vector_ramp (const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                         device REAL* y, constant uint& offset_y, constant uint& stride_y,
+kernel void vector_ramp (const device REAL* x, constant int& offset_x, constant int& stride_x,
+                         device REAL* y, constant int& offset_y, constant int& stride_y,
                          uint id [[thread_position_in_grid]]) {
-    y[offset_y + id * stride_y] = fmax(x[offset_x + id * stride_x], (REAL)0.0);
+    y[offset_y + (int)id * stride_y] = fmax(x[offset_x + (int)id * stride_x], (REAL)0.0);
 }
 
 
 kernel void vector_relu (constant REAL& alpha,
-                         const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                         device REAL* y, constant uint& offset_y, constant uint& stride_y,
+                         const device REAL* x, constant int& offset_x, constant int& stride_x,
+                         device REAL* y, constant int& offset_y, constant int& stride_y,
                          uint id [[thread_position_in_grid]]) {
-    REAL xval = x[offset_x + id * stride_x];
-    y[offset_y + id * stride_y] = fmax(xval, alpha * xval);
+    REAL xval = x[offset_x + (int)id * stride_x];
+    y[offset_y + (int)id * stride_y] = fmax(xval, alpha * xval);
 }
 
 
 kernel void vector_elu (constant REAL& alpha,
-                        const device REAL* x, constant uint& offset_x, constant uint& stride_x,
-                        device REAL* y, constant uint& offset_y, constant uint& stride_y,
+                        const device REAL* x, constant int& offset_x, constant int& stride_x,
+                        device REAL* y, constant int& offset_y, constant int& stride_y,
                         uint id [[thread_position_in_grid]]) {
-    REAL xval = x[offset_x + id * stride_x];
-    y[offset_y + id * stride_y] = fmax(xval, alpha * expm1(xval));
+    REAL xval = x[offset_x + (int)id * stride_x];
+    y[offset_y + (int)id * stride_y] = fmax(xval, alpha * expm1(xval));
 }
 
 
@@ -1663,18 +1663,59 @@ kernel void ge_elu (constant int& sd [[buffer(0)]], constant int& fd [[buffer(1)
 // As these get more complex, annotating parameters to ensure order
 ///////////////////////////////////////////////////////////////////
 
+// uplo kernels run on a line of sd * (sd + 1) / 2 threads, one for each element of a triangle
+// with its diagonal, rather than on the whole square
+static inline uint uplo_threads(int sd) {
+    return (uint)sd * (uint)(sd + 1) / 2;
+}
+
+// Maps thread k to its element (gid_0, gid_1) of the triangle given by unit and bottom, or
+// returns false when it has none. Threads run down each column, so neighbours read neighbouring
+// elements. A unit triangle is the triangle of sd - 1 beside the diagonal, and a bottom of 0 is
+// the whole matrix, whose elements past the last thread are taken by threads k - uplo_threads.
+static inline bool uplo_element(uint k, int sd, int unit, int bottom, thread int& gid_0, thread int& gid_1) {
+    if (bottom == 0) {
+        if (unit == 132 || k >= (uint)sd * (uint)sd) {
+            return false;
+        }
+        gid_0 = k % sd;
+        gid_1 = k / sd;
+        return true;
+    }
+    const int n = unit == 132 ? sd - 1 : sd;
+    if (n <= 0 || k >= uplo_threads(n)) {
+        return false;
+    }
+    // k is element (r, c) of an upper triangle of n with its diagonal, whose column c starts at
+    // c * (c + 1) / 2. The float root can be one off for large k.
+    uint c = (uint)((sqrt(8.0f * k + 1.0f) - 1.0f) * 0.5f);
+    while (c * (c + 1) / 2 > k) {
+        c--;
+    }
+    while ((c + 1) * (c + 2) / 2 <= k) {
+        c++;
+    }
+    const int r = k - c * (c + 1) / 2;
+    if (bottom < 0) {
+        gid_0 = r;
+        gid_1 = c + sd - n;
+    } else {
+        // the lower triangle is the upper one turned over, counting up from the last row and column
+        gid_0 = sd - 1 - r;
+        gid_1 = n - 1 - c;
+    }
+    return true;
+}
+
 
 kernel void uplo_sqr (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                       const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                       device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                      uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            REAL aval = a[offset_a + gid_0 + gid_1 * ld_a];
-            b[offset_b + gid_0 + gid_1 * ld_b] = aval * aval;
-        }
+                      uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        REAL aval = a[offset_a + gid_0 + gid_1 * ld_a];
+        b[offset_b + gid_0 + gid_1 * ld_b] = aval * aval;
     }
 }
 
@@ -1683,13 +1724,10 @@ kernel void uplo_mul (constant int& sd [[buffer(0)]], constant int& unit [[buffe
                       const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                       const device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
                       device REAL* c [[buffer(9)]], constant int& offset_c [[buffer(10)]], constant int& ld_c [[buffer(11)]],
-                      uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            c[offset_c + gid_0 + gid_1 * ld_c] = a[offset_a + gid_0 + gid_1 * ld_a] * b[offset_b + gid_0 + gid_1 * ld_b];
-        }
+                      uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        c[offset_c + gid_0 + gid_1 * ld_c] = a[offset_a + gid_0 + gid_1 * ld_a] * b[offset_b + gid_0 + gid_1 * ld_b];
     }
 }
 
@@ -1698,13 +1736,10 @@ kernel void uplo_div (constant int& sd [[buffer(0)]], constant int& unit [[buffe
                       const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                       const device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
                       device REAL* c [[buffer(9)]], constant int& offset_c [[buffer(10)]], constant int& ld_c [[buffer(11)]],
-                      uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            c[offset_c + gid_0 + gid_1 * ld_c] = a[offset_a + gid_0 + gid_1 * ld_a] / b[offset_b + gid_0 + gid_1 * ld_b];
-        }
+                      uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        c[offset_c + gid_0 + gid_1 * ld_c] = a[offset_a + gid_0 + gid_1 * ld_a] / b[offset_b + gid_0 + gid_1 * ld_b];
     }
 }
 
@@ -1713,13 +1748,10 @@ kernel void uplo_add (constant int& sd [[buffer(0)]], constant int& unit [[buffe
                       const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                       const device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
                       device REAL* c [[buffer(9)]], constant int& offset_c [[buffer(10)]], constant int& ld_c [[buffer(11)]],
-                      uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            c[offset_c + gid_0 + gid_1 * ld_c] = a[offset_a + gid_0 + gid_1 * ld_a] + b[offset_b + gid_0 + gid_1 * ld_b];
-        }
+                      uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        c[offset_c + gid_0 + gid_1 * ld_c] = a[offset_a + gid_0 + gid_1 * ld_a] + b[offset_b + gid_0 + gid_1 * ld_b];
     }
 }
 
@@ -1728,13 +1760,10 @@ kernel void uplo_sub (constant int& sd [[buffer(0)]], constant int& unit [[buffe
                       const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                       const device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
                       device REAL* c [[buffer(9)]], constant int& offset_c [[buffer(10)]], constant int& ld_c [[buffer(11)]],
-                      uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            c[offset_c + gid_0 + gid_1 * ld_c] = a[offset_a + gid_0 + gid_1 * ld_a] - b[offset_b + gid_0 + gid_1 * ld_b];
-        }
+                      uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        c[offset_c + gid_0 + gid_1 * ld_c] = a[offset_a + gid_0 + gid_1 * ld_a] - b[offset_b + gid_0 + gid_1 * ld_b];
     }
 }
 
@@ -1742,13 +1771,10 @@ kernel void uplo_sub (constant int& sd [[buffer(0)]], constant int& unit [[buffe
 kernel void uplo_inv (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                       const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                       device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                      uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = (REAL)1.0 / a[offset_a + gid_0 + gid_1 * ld_a];
-        }
+                      uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = (REAL)1.0 / a[offset_a + gid_0 + gid_1 * ld_a];
     }
 }
 
@@ -1756,13 +1782,10 @@ kernel void uplo_inv (constant int& sd [[buffer(0)]], constant int& unit [[buffe
 kernel void uplo_abs (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                       const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                       device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                      uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = fabs(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                      uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = fabs(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -1773,15 +1796,12 @@ kernel void uplo_linear_frac (constant int& sd [[buffer(0)]], constant int& unit
                               constant REAL& scalea [[buffer(9)]], constant REAL& shifta [[buffer(10)]],
                               constant REAL& scaleb [[buffer(11)]], constant REAL& shiftb [[buffer(12)]],
                               device REAL* c [[buffer(13)]], constant int& offset_c [[buffer(14)]], constant int& ld_c [[buffer(15)]],
-                              uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            c[offset_c + gid_0 + gid_1 * ld_c] =
-                (scalea * a[offset_a + gid_0 + gid_1 * ld_a] + shifta) /
-                (scaleb * b[offset_b + gid_0 + gid_1 * ld_b] + shiftb);
-        }
+                              uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        c[offset_c + gid_0 + gid_1 * ld_c] =
+            (scalea * a[offset_a + gid_0 + gid_1 * ld_a] + shifta) /
+            (scaleb * b[offset_b + gid_0 + gid_1 * ld_b] + shiftb);
     }
 }
 
@@ -1791,13 +1811,10 @@ kernel void uplo_scale_shift (constant int& sd [[buffer(0)]], constant int& unit
                               constant REAL& scalea [[buffer(6)]], constant REAL& shifta [[buffer(7)]],
                               constant REAL& scaleb [[buffer(8)]], constant REAL& shiftb [[buffer(9)]],
                               device REAL* c [[buffer(10)]], constant int& offset_c [[buffer(11)]], constant int& ld_c [[buffer(12)]],
-                              uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            c[offset_c + gid_0 + gid_1 * ld_c] = scalea * a[offset_a + gid_0 + gid_1 * ld_a] + shifta;
-        }
+                              uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        c[offset_c + gid_0 + gid_1 * ld_c] = scalea * a[offset_a + gid_0 + gid_1 * ld_a] + shifta;
     }
 }
 
@@ -1806,13 +1823,10 @@ kernel void uplo_fmod (constant int& sd [[buffer(0)]], constant int& unit [[buff
                       const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                       const device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
                       device REAL* c [[buffer(9)]], constant int& offset_c [[buffer(10)]], constant int& ld_c [[buffer(11)]],
-                      uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            c[offset_c + gid_0 + gid_1 * ld_c] = fmod(a[offset_a + gid_0 + gid_1 * ld_a], b[offset_b + gid_0 + gid_1 * ld_b]);
-        }
+                      uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        c[offset_c + gid_0 + gid_1 * ld_c] = fmod(a[offset_a + gid_0 + gid_1 * ld_a], b[offset_b + gid_0 + gid_1 * ld_b]);
     }
 }
 
@@ -1821,13 +1835,10 @@ kernel void uplo_frem (constant int& sd [[buffer(0)]], constant int& unit [[buff
                       const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                       const device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
                       device REAL* c [[buffer(9)]], constant int& offset_c [[buffer(10)]], constant int& ld_c [[buffer(11)]],
-                      uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            c[offset_c + gid_0 + gid_1 * ld_c] = remainder(a[offset_a + gid_0 + gid_1 * ld_a], b[offset_b + gid_0 + gid_1 * ld_b]);
-        }
+                      uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        c[offset_c + gid_0 + gid_1 * ld_c] = remainder(a[offset_a + gid_0 + gid_1 * ld_a], b[offset_b + gid_0 + gid_1 * ld_b]);
     }
 }
 
@@ -1835,13 +1846,10 @@ kernel void uplo_frem (constant int& sd [[buffer(0)]], constant int& unit [[buff
 kernel void uplo_sqrt (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                       const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                       device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                      uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = sqrt(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                      uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = sqrt(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -1849,13 +1857,10 @@ kernel void uplo_sqrt (constant int& sd [[buffer(0)]], constant int& unit [[buff
 kernel void uplo_inv_sqrt (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                            const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                            device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                           uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = rsqrt(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                           uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = rsqrt(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -1863,13 +1868,10 @@ kernel void uplo_inv_sqrt (constant int& sd [[buffer(0)]], constant int& unit [[
 kernel void uplo_cbrt (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                       const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                       device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                      uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = pow(a[offset_a + gid_0 + gid_1 * ld_a], REAL1o3);
-        }
+                      uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = pow(a[offset_a + gid_0 + gid_1 * ld_a], REAL1o3);
     }
 }
 
@@ -1877,13 +1879,10 @@ kernel void uplo_cbrt (constant int& sd [[buffer(0)]], constant int& unit [[buff
 kernel void uplo_inv_cbrt (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                            const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                            device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                           uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = (REAL)1.0 / pow(a[offset_a + gid_0 + gid_1 * ld_a], REAL1o3);
-        }
+                           uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = (REAL)1.0 / pow(a[offset_a + gid_0 + gid_1 * ld_a], REAL1o3);
     }
 }
 
@@ -1891,13 +1890,10 @@ kernel void uplo_inv_cbrt (constant int& sd [[buffer(0)]], constant int& unit [[
 kernel void uplo_pow2o3 (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                          const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                          device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                         uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = pow(a[offset_a + gid_0 + gid_1 * ld_a], REAL2o3);
-        }
+                         uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = pow(a[offset_a + gid_0 + gid_1 * ld_a], REAL2o3);
     }
 }
 
@@ -1905,13 +1901,10 @@ kernel void uplo_pow2o3 (constant int& sd [[buffer(0)]], constant int& unit [[bu
 kernel void uplo_pow3o2 (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                          const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                          device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                         uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = pow(a[offset_a + gid_0 + gid_1 * ld_a], REAL3o2);
-        }
+                         uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = pow(a[offset_a + gid_0 + gid_1 * ld_a], REAL3o2);
     }
 }
 
@@ -1920,13 +1913,10 @@ kernel void uplo_pow (constant int& sd [[buffer(0)]], constant int& unit [[buffe
                       const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                       const device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
                       device REAL* c [[buffer(9)]], constant int& offset_c [[buffer(10)]], constant int& ld_c [[buffer(11)]],
-                      uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            c[offset_c + gid_0 + gid_1 * ld_c] = pow(a[offset_a + gid_0 + gid_1 * ld_a], b[offset_b + gid_0 + gid_1 * ld_b]);
-        }
+                      uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        c[offset_c + gid_0 + gid_1 * ld_c] = pow(a[offset_a + gid_0 + gid_1 * ld_a], b[offset_b + gid_0 + gid_1 * ld_b]);
     }
 }
 
@@ -1935,13 +1925,10 @@ kernel void uplo_powx (constant int& sd [[buffer(0)]], constant int& unit [[buff
                       const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                       constant REAL& b [[buffer(6)]],
                       device REAL* c [[buffer(7)]], constant int& offset_c [[buffer(8)]], constant int& ld_c [[buffer(9)]],
-                      uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            c[offset_c + gid_0 + gid_1 * ld_c] = pow(a[offset_a + gid_0 + gid_1 * ld_a], b);
-        }
+                      uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        c[offset_c + gid_0 + gid_1 * ld_c] = pow(a[offset_a + gid_0 + gid_1 * ld_a], b);
     }
 }
 
@@ -1950,13 +1937,10 @@ kernel void uplo_hypot (constant int& sd [[buffer(0)]], constant int& unit [[buf
                        const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                        const device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
                        device REAL* c [[buffer(9)]], constant int& offset_c [[buffer(10)]], constant int& ld_c [[buffer(11)]],
-                       uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            c[offset_c + gid_0 + gid_1 * ld_c] = hypot(a[offset_a + gid_0 + gid_1 * ld_a], b[offset_b + gid_0 + gid_1 * ld_b]);
-        }
+                       uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        c[offset_c + gid_0 + gid_1 * ld_c] = hypot(a[offset_a + gid_0 + gid_1 * ld_a], b[offset_b + gid_0 + gid_1 * ld_b]);
     }
 }
 
@@ -1964,13 +1948,10 @@ kernel void uplo_hypot (constant int& sd [[buffer(0)]], constant int& unit [[buf
 kernel void uplo_exp (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                       const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                       device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                      uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = exp(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                      uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = exp(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -1978,13 +1959,10 @@ kernel void uplo_exp (constant int& sd [[buffer(0)]], constant int& unit [[buffe
 kernel void uplo_exp2 (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                       const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                       device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                      uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = exp2(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                      uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = exp2(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -1992,13 +1970,10 @@ kernel void uplo_exp2 (constant int& sd [[buffer(0)]], constant int& unit [[buff
 kernel void uplo_exp10 (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                        const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                        device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                       uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = exp10(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                       uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = exp10(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2006,13 +1981,10 @@ kernel void uplo_exp10 (constant int& sd [[buffer(0)]], constant int& unit [[buf
 kernel void uplo_expm1 (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                         const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                         device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                        uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = expm1(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                        uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = expm1(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2020,13 +1992,10 @@ kernel void uplo_expm1 (constant int& sd [[buffer(0)]], constant int& unit [[buf
 kernel void uplo_log (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                       const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                       device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                      uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = log(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                      uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = log(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2034,13 +2003,10 @@ kernel void uplo_log (constant int& sd [[buffer(0)]], constant int& unit [[buffe
 kernel void uplo_log2 (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                        const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                        device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                       uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = log2(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                       uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = log2(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2048,13 +2014,10 @@ kernel void uplo_log2 (constant int& sd [[buffer(0)]], constant int& unit [[buff
 kernel void uplo_log10 (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                         const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                         device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                        uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = log10(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                        uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = log10(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2062,13 +2025,10 @@ kernel void uplo_log10 (constant int& sd [[buffer(0)]], constant int& unit [[buf
 kernel void uplo_log1p (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                         const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                         device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                        uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = log1p(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                        uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = log1p(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2076,13 +2036,10 @@ kernel void uplo_log1p (constant int& sd [[buffer(0)]], constant int& unit [[buf
 kernel void uplo_sin (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                       const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                       device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                      uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = sin(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                      uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = sin(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2090,13 +2047,10 @@ kernel void uplo_sin (constant int& sd [[buffer(0)]], constant int& unit [[buffe
 kernel void uplo_cos (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                       const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                       device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                      uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = cos(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                      uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = cos(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2104,13 +2058,10 @@ kernel void uplo_cos (constant int& sd [[buffer(0)]], constant int& unit [[buffe
 kernel void uplo_tan (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                       const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                       device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                      uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = tan(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                      uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = tan(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2119,15 +2070,12 @@ kernel void uplo_sincos (constant int& sd [[buffer(0)]], constant int& unit [[bu
                          const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                          device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
                          device REAL* c [[buffer(9)]], constant int& offset_c [[buffer(10)]], constant int& ld_c [[buffer(11)]],
-                         uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            REAL aval = a[offset_a + gid_0 + gid_1 * ld_a];
-            b[offset_b + gid_0 + gid_1 * ld_b] = sin(aval);
-            c[offset_c + gid_0 + gid_1 * ld_c] = cos(aval);
-        }
+                         uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        REAL aval = a[offset_a + gid_0 + gid_1 * ld_a];
+        b[offset_b + gid_0 + gid_1 * ld_b] = sin(aval);
+        c[offset_c + gid_0 + gid_1 * ld_c] = cos(aval);
     }
 }
 
@@ -2135,13 +2083,10 @@ kernel void uplo_sincos (constant int& sd [[buffer(0)]], constant int& unit [[bu
 kernel void uplo_asin (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                        const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                        device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                       uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = asin(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                       uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = asin(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2149,13 +2094,10 @@ kernel void uplo_asin (constant int& sd [[buffer(0)]], constant int& unit [[buff
 kernel void uplo_acos (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                        const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                        device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                       uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = acos(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                       uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = acos(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2163,13 +2105,10 @@ kernel void uplo_acos (constant int& sd [[buffer(0)]], constant int& unit [[buff
 kernel void uplo_atan (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                        const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                        device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                       uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = atan(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                       uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = atan(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2178,13 +2117,10 @@ kernel void uplo_atan2 (constant int& sd [[buffer(0)]], constant int& unit [[buf
                         const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                         const device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
                         device REAL* c [[buffer(9)]], constant int& offset_c [[buffer(10)]], constant int& ld_c [[buffer(11)]],
-                        uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            c[offset_c + gid_0 + gid_1 * ld_c] = atan2(a[offset_a + gid_0 + gid_1 * ld_a], b[offset_b + gid_0 + gid_1 * ld_b]);
-        }
+                        uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        c[offset_c + gid_0 + gid_1 * ld_c] = atan2(a[offset_a + gid_0 + gid_1 * ld_a], b[offset_b + gid_0 + gid_1 * ld_b]);
     }
 }
 
@@ -2192,13 +2128,10 @@ kernel void uplo_atan2 (constant int& sd [[buffer(0)]], constant int& unit [[buf
 kernel void uplo_sinh (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                        const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                        device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                       uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = sinh(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                       uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = sinh(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2206,13 +2139,10 @@ kernel void uplo_sinh (constant int& sd [[buffer(0)]], constant int& unit [[buff
 kernel void uplo_cosh (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                        const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                        device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                       uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = cosh(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                       uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = cosh(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2220,13 +2150,10 @@ kernel void uplo_cosh (constant int& sd [[buffer(0)]], constant int& unit [[buff
 kernel void uplo_tanh (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                        const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                        device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                       uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = tanh(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                       uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = tanh(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2234,13 +2161,10 @@ kernel void uplo_tanh (constant int& sd [[buffer(0)]], constant int& unit [[buff
 kernel void uplo_asinh (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                         const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                         device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                        uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = asinh(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                        uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = asinh(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2248,13 +2172,10 @@ kernel void uplo_asinh (constant int& sd [[buffer(0)]], constant int& unit [[buf
 kernel void uplo_acosh (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                         const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                         device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                        uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = acosh(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                        uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = acosh(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2262,13 +2183,10 @@ kernel void uplo_acosh (constant int& sd [[buffer(0)]], constant int& unit [[buf
 kernel void uplo_atanh (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                         const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                         device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                        uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = atanh(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                        uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = atanh(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2276,13 +2194,10 @@ kernel void uplo_atanh (constant int& sd [[buffer(0)]], constant int& unit [[buf
 kernel void uplo_erf (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                       const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                       device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                      uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = erf(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                      uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = erf(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2290,13 +2205,10 @@ kernel void uplo_erf (constant int& sd [[buffer(0)]], constant int& unit [[buffe
 kernel void uplo_erf_inv (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                           const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                           device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                          uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = erfinv(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                          uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = erfinv(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2304,13 +2216,10 @@ kernel void uplo_erf_inv (constant int& sd [[buffer(0)]], constant int& unit [[b
 kernel void uplo_erfc (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                        const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                        device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                       uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = erfc(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                       uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = erfc(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2318,13 +2227,10 @@ kernel void uplo_erfc (constant int& sd [[buffer(0)]], constant int& unit [[buff
 kernel void uplo_erfc_inv (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                           const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                           device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                          uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = erfcinv(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                          uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = erfcinv(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2332,13 +2238,10 @@ kernel void uplo_erfc_inv (constant int& sd [[buffer(0)]], constant int& unit [[
 kernel void uplo_cdf_norm (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                           const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                           device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                          uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = normcdf(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                          uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = normcdf(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2346,13 +2249,10 @@ kernel void uplo_cdf_norm (constant int& sd [[buffer(0)]], constant int& unit [[
 kernel void uplo_cdf_norm_inv (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                               const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                               device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                              uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = normcdfinv(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                              uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = normcdfinv(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2360,13 +2260,10 @@ kernel void uplo_cdf_norm_inv (constant int& sd [[buffer(0)]], constant int& uni
 kernel void uplo_gamma (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                       const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                       device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                      uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = tgamma(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                      uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = tgamma(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2374,13 +2271,10 @@ kernel void uplo_gamma (constant int& sd [[buffer(0)]], constant int& unit [[buf
 kernel void uplo_lgamma (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                         const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                         device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                        uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = lgamma(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                        uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = lgamma(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2388,13 +2282,10 @@ kernel void uplo_lgamma (constant int& sd [[buffer(0)]], constant int& unit [[bu
 kernel void uplo_floor (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                         const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                         device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                        uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = floor(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                        uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = floor(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2402,13 +2293,10 @@ kernel void uplo_floor (constant int& sd [[buffer(0)]], constant int& unit [[buf
 kernel void uplo_ceil (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                        const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                        device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                       uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = ceil(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                       uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = ceil(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2416,13 +2304,10 @@ kernel void uplo_ceil (constant int& sd [[buffer(0)]], constant int& unit [[buff
 kernel void uplo_trunc (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                         const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                         device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                        uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = trunc(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                        uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = trunc(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2430,13 +2315,10 @@ kernel void uplo_trunc (constant int& sd [[buffer(0)]], constant int& unit [[buf
 kernel void uplo_round (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                         const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                         device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                        uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = round(a[offset_a + gid_0 + gid_1 * ld_a]);
-        }
+                        uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = round(a[offset_a + gid_0 + gid_1 * ld_a]);
     }
 }
 
@@ -2445,16 +2327,13 @@ kernel void uplo_modf (constant int& sd [[buffer(0)]], constant int& unit [[buff
                        const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                        device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
                        device REAL* c [[buffer(9)]], constant int& offset_c [[buffer(10)]], constant int& ld_c [[buffer(11)]],
-                       uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            REAL aval = a[offset_a + gid_0 + gid_1 * ld_a];
-            REAL intpart = (REAL)((long)aval);
-            c[offset_c + gid_0 + gid_1 * ld_c] = aval - intpart;
-            b[offset_b + gid_0 + gid_1 * ld_b] = intpart;
-        }
+                       uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        REAL aval = a[offset_a + gid_0 + gid_1 * ld_a];
+        REAL intpart = (REAL)((long)aval);
+        c[offset_c + gid_0 + gid_1 * ld_c] = aval - intpart;
+        b[offset_b + gid_0 + gid_1 * ld_b] = intpart;
     }
 }
 
@@ -2462,14 +2341,11 @@ kernel void uplo_modf (constant int& sd [[buffer(0)]], constant int& unit [[buff
 kernel void uplo_frac (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                        const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                        device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                       uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            REAL aval = a[offset_a + gid_0 + gid_1 * ld_a];
-            b[offset_b + gid_0 + gid_1 * ld_b] = aval - (REAL)((long)aval);
-        }
+                       uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        REAL aval = a[offset_a + gid_0 + gid_1 * ld_a];
+        b[offset_b + gid_0 + gid_1 * ld_b] = aval - (REAL)((long)aval);
     }
 }
 
@@ -2478,13 +2354,10 @@ kernel void uplo_fmax (constant int& sd [[buffer(0)]], constant int& unit [[buff
                        const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                        const device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
                        device REAL* c [[buffer(9)]], constant int& offset_c [[buffer(10)]], constant int& ld_c [[buffer(11)]],
-                       uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            c[offset_c + gid_0 + gid_1 * ld_c] = fmax(a[offset_a + gid_0 + gid_1 * ld_a], b[offset_b + gid_0 + gid_1 * ld_b]);
-        }
+                       uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        c[offset_c + gid_0 + gid_1 * ld_c] = fmax(a[offset_a + gid_0 + gid_1 * ld_a], b[offset_b + gid_0 + gid_1 * ld_b]);
     }
 }
 
@@ -2493,13 +2366,10 @@ kernel void uplo_fmin (constant int& sd [[buffer(0)]], constant int& unit [[buff
                        const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                        const device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
                        device REAL* c [[buffer(9)]], constant int& offset_c [[buffer(10)]], constant int& ld_c [[buffer(11)]],
-                       uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            c[offset_c + gid_0 + gid_1 * ld_c] = fmin(a[offset_a + gid_0 + gid_1 * ld_a], b[offset_b + gid_0 + gid_1 * ld_b]);
-        }
+                       uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        c[offset_c + gid_0 + gid_1 * ld_c] = fmin(a[offset_a + gid_0 + gid_1 * ld_a], b[offset_b + gid_0 + gid_1 * ld_b]);
     }
 }
 
@@ -2508,13 +2378,10 @@ kernel void uplo_copysign (constant int& sd [[buffer(0)]], constant int& unit [[
                            const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                            const device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
                            device REAL* c [[buffer(9)]], constant int& offset_c [[buffer(10)]], constant int& ld_c [[buffer(11)]],
-                           uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            c[offset_c + gid_0 + gid_1 * ld_c] = copysign(a[offset_a + gid_0 + gid_1 * ld_a], b[offset_b + gid_0 + gid_1 * ld_b]);
-        }
+                           uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        c[offset_c + gid_0 + gid_1 * ld_c] = copysign(a[offset_a + gid_0 + gid_1 * ld_a], b[offset_b + gid_0 + gid_1 * ld_b]);
     }
 }
 
@@ -2522,13 +2389,10 @@ kernel void uplo_copysign (constant int& sd [[buffer(0)]], constant int& unit [[
 kernel void uplo_sigmoid (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                           const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                           device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                          uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = tanh(REAL1o2 * a[offset_a + gid_0 + gid_1 * ld_a]) * REAL1o2 + REAL1o2;
-        }
+                          uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = tanh(REAL1o2 * a[offset_a + gid_0 + gid_1 * ld_a]) * REAL1o2 + REAL1o2;
     }
 }
 
@@ -2536,13 +2400,10 @@ kernel void uplo_sigmoid (constant int& sd [[buffer(0)]], constant int& unit [[b
 kernel void uplo_ramp (constant int& sd [[buffer(0)]], constant int& unit [[buffer(1)]], constant int& bottom [[buffer(2)]],
                       const device REAL* a [[buffer(3)]], constant int& offset_a [[buffer(4)]], constant int& ld_a [[buffer(5)]],
                       device REAL* b [[buffer(6)]], constant int& offset_b [[buffer(7)]], constant int& ld_b [[buffer(8)]],
-                      uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            b[offset_b + gid_0 + gid_1 * ld_b] = fmax(a[offset_a + gid_0 + gid_1 * ld_a], (REAL)0.0);
-        }
+                      uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        b[offset_b + gid_0 + gid_1 * ld_b] = fmax(a[offset_a + gid_0 + gid_1 * ld_a], (REAL)0.0);
     }
 }
 
@@ -2551,14 +2412,11 @@ kernel void uplo_relu (constant int& sd [[buffer(0)]], constant int& unit [[buff
                       constant REAL& alpha [[buffer(3)]],
                       const device REAL* a [[buffer(4)]], constant int& offset_a [[buffer(5)]], constant int& ld_a [[buffer(6)]],
                       device REAL* b [[buffer(7)]], constant int& offset_b [[buffer(8)]], constant int& ld_b [[buffer(9)]],
-                      uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            REAL val = a[offset_a + gid_0 + gid_1 * ld_a];
-            b[offset_b + gid_0 + gid_1 * ld_b] = fmax(val, alpha * val);
-        }
+                      uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        REAL val = a[offset_a + gid_0 + gid_1 * ld_a];
+        b[offset_b + gid_0 + gid_1 * ld_b] = fmax(val, alpha * val);
     }
 }
 
@@ -2567,14 +2425,11 @@ kernel void uplo_elu (constant int& sd [[buffer(0)]], constant int& unit [[buffe
                       constant REAL& alpha [[buffer(3)]],
                       const device REAL* a [[buffer(4)]], constant int& offset_a [[buffer(5)]], constant int& ld_a [[buffer(6)]],
                       device REAL* b [[buffer(7)]], constant int& offset_b [[buffer(8)]], constant int& ld_b [[buffer(9)]],
-                      uint2 id [[thread_position_in_grid]]) {
-    int gid_0 = id.x;
-    int gid_1 = id.y;
-    if (gid_0 < sd && gid_1 < sd) {
-        if ((unit == 132) ? bottom * gid_0 > bottom * gid_1 : bottom * gid_0 >= bottom * gid_1) {
-            REAL val = a[offset_a + gid_0 + gid_1 * ld_a];
-            b[offset_b + gid_0 + gid_1 * ld_b] = fmax(val, alpha * expm1(val));
-        }
+                      uint id [[thread_position_in_grid]]) {
+    int gid_0, gid_1;
+    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {
+        REAL val = a[offset_a + gid_0 + gid_1 * ld_a];
+        b[offset_b + gid_0 + gid_1 * ld_b] = fmax(val, alpha * expm1(val));
     }
 }
 
@@ -0,0 +1,173 @@
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "cpuengine.hpp"
+#include "lazy.hpp"
+#include "split.hpp"
+
+#include "matrix.hpp"
+
+// potrf is checked by multiplying its factor back out to A, in both triangles and on sizes up
+// to 513 so that the 128 wide steps end part way through a block. The triangle that is not given
+// holds NaN, so a factorization that reads or writes it shows. potrs must give an X whose product
+// with A is B. A minor made negative at 200 must be reported rather than factored through. The
+// benchmark factors a 1536 covariance against the column by column loop.
+
+static const float NaN = std::numeric_limits<float>::quiet_NaN();
+
+// A symmetric matrix that is positive definite as its diagonal outweighs the rest of its row.
+// Only one triangle is given, and the other is NaN.
+static Matrix covariance(long n, bool lower) {
+  Matrix a(n, n, 3, 2, 0);
+  for (long j = 0; j < n; j++) {
+    for (long i = 0; i < n; i++) {
+      float x = i == j ? static_cast<float>(n) : value(i * j + i + j, 1);
+      *a.ref(i, j) = i == j || (i > j) == lower ? x : NaN;
+    }
+  }
+  return a;
+}
+
+// element (i, j) of the symmetric matrix from its triangle
+static double symmetric(const Matrix& a, bool lower, long i, long j) {
+  return (i >= j) == lower || i == j ? a.at(i, j) : a.at(j, i);
+}
+
+// element (i, j) of the lower factor L, or of U^T
+static double factor(const Matrix& a, bool lower, long i, long j) {
+  return i < j ? 0.0 : lower ? a.at(i, j) : a.at(j, i);
+}
+
+static bool close(double x, double y, double tolerance) {
+  return std::fabs(x - y) <= tolerance * (1 + std::fabs(y));
+}
+
+// L * L^T (or U^T * U) is A, and X solves A * X = B
+static bool check(Ferrum::Backend& engine, long n, bool lower, long nrhs) {
+  Matrix a = covariance(n, lower), l = a;
+  int bottom = lower ? 1 : -1;
+  if (engine.potrf(n, bottom, l.data.data(), l.len(), l.offset, l.ld) != l.data.data()) {
+    std::cout << engine.name() << " potrf " << (lower ? "lower " : "upper ") << n << " failed" << std::endl;
+    return false;
+  }
+  for (long j = 0; j < n; j++) {
+    for (long i = 0; i < n; i++) {
+      double sum = 0;
+      for (long p = 0; p <= std::min(i, j); p++) {
+        sum += factor(l, lower, i, p) * factor(l, lower, j, p);
+      }
+      bool other = i != j && (i > j) != lower;
+      if (other ? !std::isnan(l.at(i, j)) : !close(sum, symmetric(a, lower, i, j), 1e-5)) {
+        std::cout << engine.name() << " potrf " << (lower ? "lower " : "upper ") << n << " is wrong at " << i
+                  << ", " << j << ": " << sum << ", expected " << symmetric(a, lower, i, j) << std::endl;
+        return false;
+      }
+    }
+  }
+  Matrix b(n, nrhs, 1, 1, 2), x = b;
+  if (engine.potrs(n, nrhs, bottom, l.data.data(), l.len(), l.offset, l.ld,
+                   x.data.data(), x.len(), x.offset, x.ld) != x.data.data()) {
+    return false;
+  }
+  for (long j = 0; j < nrhs; j++) {
+    for (long i = 0; i < n; i++) {
+      double sum = 0;
+      for (long p = 0; p < n; p++) {
+        sum += symmetric(a, lower, i, p) * x.at(p, j);
+      }
+      if (!close(sum, b.at(i, j), 1e-4)) {
+        std::cout << engine.name() << " potrs " << (lower ? "lower " : "upper ") << n << " x " << nrhs
+                  << " is wrong at " << i << ", " << j << ": " << sum << ", expected " << b.at(i, j) << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static bool factors(Ferrum::Backend& engine) {
+  const long sizes[] = {1, 37, 128, 300, 513};
+  for (long n : sizes) {
+    for (int lower = 0; lower < 2; lower++) {
+      if (!check(engine, n, lower, 7)) {
+        return false;
+      }
+    }
+  }
+  return check(engine, 40, true, 0) && check(engine, 0, false, 3);
+}
+
+// A leading minor that is not positive definite is reported, as are bad arguments
+static bool rejects(Ferrum::Backend& engine) {
+  Matrix a = covariance(300, true), b(300, 2, 0, 0, 1);
+  *a.ref(200, 200) = -1.0f;
+  Matrix singular = covariance(10, false);
+  *singular.ref(0, 0) = 0.0f;
+  return engine.potrf(300, 1, a.data.data(), a.len(), a.offset, a.ld) == nullptr &&
+         engine.potrf(10, -1, singular.data.data(), singular.len(), singular.offset, singular.ld) == nullptr &&
+         engine.potrf(300, 0, a.data.data(), a.len(), a.offset, a.ld) == nullptr &&
+         engine.potrf(301, 1, a.data.data(), a.len(), a.offset, a.ld) == nullptr &&
+         engine.potrs(300, 3, 1, a.data.data(), a.len(), a.offset, a.ld, b.data.data(), b.len(), 0, 300) == nullptr &&
+         engine.potrs(300, 2, 0, a.data.data(), a.len(), a.offset, a.ld, b.data.data(), b.len(), 0, 300) == nullptr;
+}
+
+// A deferred call that writes A runs before the factorization reads it
+static bool lazy() {
+  Ferrum::LazyEngine engine(new Ferrum::CpuEngine());
+  Matrix a = covariance(20, true);
+  for (long j = 0; j < 20; j++) {
+    *a.ref(j, j) = -*a.ref(j, j);
+  }
+  // the diagonal, as a vector
+  engine.vect_bB(Ferrum::FunctionID::vector_abs, 20, a.data.data(), a.len(), a.offset, a.ld + 1,
+                 a.data.data(), a.len(), a.offset, a.ld + 1);
+  return engine.potrf(20, 1, a.data.data(), a.len(), a.offset, a.ld) == a.data.data() &&
+         close(a.at(0, 0), std::sqrt(20.0), 1e-6);
+}
+
+// The blocked factorization against the loop that it replaces, which works down each column
+static void benchmark(Ferrum::Backend& engine) {
+  const long n = 1536;
+  Matrix a = covariance(n, true), naive = a;
+  double loop = timed([&]() {
+    for (long j = 0; j < n; j++) {
+      float d = naive.at(j, j);
+      for (long p = 0; p < j; p++) {
+        d -= naive.at(j, p) * naive.at(j, p);
+      }
+      d = std::sqrt(d);
+      *naive.ref(j, j) = d;
+      for (long p = 0; p < j; p++) {
+        float ljp = naive.at(j, p);
+        for (long i = j + 1; i < n; i++) {
+          *naive.ref(i, j) -= naive.at(i, p) * ljp;
+        }
+      }
+      for (long i = j + 1; i < n; i++) {
+        *naive.ref(i, j) /= d;
+      }
+    }
+  });
+  double blocked = timed([&]() {
+    engine.potrf(n, 1, a.data.data(), a.len(), a.offset, a.ld);
+  });
+  double flops = n * n * (n / 3.0);
+  std::cout << "potrf " << n << ": loop " << flops / loop * 1e-9 << " GFLOP/s, blocked " << flops / blocked * 1e-9
+            << " GFLOP/s" << std::endl;
+}
+
+int main(void) {
+  Ferrum::CpuEngine serial(0);
+  Ferrum::CpuEngine pooled;
+  Ferrum::SplitEngine split({new Ferrum::CpuEngine(2), new Ferrum::CpuEngine(2)}, 1);
+  bool ok = factors(serial) && factors(pooled) && factors(split) && rejects(pooled) && rejects(split) && lazy();
+  if (ok) {
+    benchmark(pooled);
+    std::cout << "Success!" << std::endl;
+    return 0;
+  }
+  std::cout << "Failed!" << std::endl;
+  return 1;
+}
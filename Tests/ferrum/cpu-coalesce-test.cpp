@@ -0,0 +1,96 @@
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "coalescer.hpp"
+#include "cpuengine.hpp"
+
+// Threads make small calls at the same time, so that the coalescer batches them.
+// Results are checked against a scalar reference, and the stats must show shared dispatches.
+
+static const int THREAD_COUNT = 16;
+static const int ITERATIONS = 100;
+static const int N = 64;
+
+static bool close(float x, float y) {
+  return std::fabs(x - y) <= 1e-5f * std::fmax(1.0f, std::fabs(y));
+}
+
+static bool worker(Ferrum::Backend* engine, int seed) {
+  std::vector<float> a(2 * N), b(N), c(N, 0.0f);
+  for (int i = 0; i < 2 * N; i++) {
+    a[i] = 0.01f * ((i * 7 + seed) % 100) + 0.5f;
+  }
+  for (int i = 0; i < N; i++) {
+    b[i] = 0.02f * ((i * 13 + seed) % 50);
+  }
+  for (int iter = 0; iter < ITERATIONS; iter++) {
+    switch (iter % 3) {
+      case 0:
+        // strided a, so packing has to gather
+        if (engine->vect_bbB(Ferrum::FunctionID::vector_add, N, a.data(), 2 * N, 1, 2, b.data(), N, 0, 1,
+                             c.data(), N, 0, 1) == nullptr) return false;
+        for (int i = 0; i < N; i++) {
+          if (!close(c[i], a[1 + 2 * i] + b[i])) return false;
+        }
+        break;
+      case 1:
+        // each thread has its own power, so these only batch with their own thread
+        if (engine->vect_bfB(Ferrum::FunctionID::vector_powx, N, a.data(), N, 0, 1, 1.0f + seed % 4,
+                             c.data(), N, 0, 1) == nullptr) return false;
+        for (int i = 0; i < N; i++) {
+          if (!close(c[i], std::pow(a[i], 1.0f + seed % 4))) return false;
+        }
+        break;
+      case 2:
+        // strided result, so scattering must leave the gaps alone
+        std::fill(c.begin(), c.end(), -1.0f);
+        if (engine->vect_bB(Ferrum::FunctionID::vector_sqrt, N / 2, a.data(), N, 0, 1,
+                            c.data(), N, 1, 2) == nullptr) return false;
+        for (int i = 0; i < N; i++) {
+          float expected = i % 2 == 1 ? std::sqrt(a[i / 2]) : -1.0f;
+          if (!close(c[i], expected)) return false;
+        }
+        break;
+    }
+  }
+  return true;
+}
+
+int main(void) {
+  Ferrum::Coalescer engine(new Ferrum::CpuEngine(), 1000, 8);
+  std::atomic<int> failures(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < THREAD_COUNT; t++) {
+    threads.emplace_back([&engine, &failures, t]() {
+      if (!worker(&engine, t)) {
+        failures++;
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  // larger vectors are passed straight through
+  std::vector<float> big(Ferrum::Coalescer::DEFAULT_MAX_ELEMENTS * 2, 4.0f);
+  Ferrum::CoalescerStats before = engine.stats();
+  long count = static_cast<long>(big.size());
+  engine.vect_bB(Ferrum::FunctionID::vector_sqrt, count, big.data(), count, 0, 1, big.data(), count, 0, 1);
+  Ferrum::CoalescerStats after = engine.stats();
+  if (after.requests != before.requests || big.back() != 2.0f) {
+    failures++;
+  }
+
+  Ferrum::CoalescerStats stats = engine.stats();
+  std::cout << stats.requests << " calls in " << stats.batches << " dispatches (average batch "
+            << stats.averageBatch() << ")" << std::endl;
+  if (failures == 0 && stats.coalesced > 0 && stats.batches < stats.requests) {
+    std::cout << "Success!" << std::endl;
+    return 0;
+  }
+  std::cout << "Failed!" << std::endl;
+  return 1;
+}
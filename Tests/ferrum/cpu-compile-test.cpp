@@ -0,0 +1,207 @@
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "cpuengine.hpp"
+#include "expression.hpp"
+#include "graph.hpp"
+#include "split.hpp"
+
+// Kernels compiled from expressions, and dispatched through the vector, ge and uplo shapes
+
+static bool close(float x, float y) {
+  return std::fabs(x - y) <= 1e-5f * std::fmax(1.0f, std::fabs(y));
+}
+
+static float sigmoid(float x) {
+  return 1.0f / (1.0f + std::exp(-x));
+}
+
+static bool parseTests(Ferrum::Backend& engine) {
+  // bad expressions do not compile
+  for (const char* bad : {"a +", "foo(a)", "c * a", "pow(a)", "(a + b", "a b", "min(a, b"}) {
+    if (engine.compile(bad) != Ferrum::FunctionID::UNKNOWN) {
+      std::cout << "'" << bad << "' compiled" << std::endl;
+      return false;
+    }
+  }
+  Ferrum::FunctionID id = engine.compile("a * sigmoid(b) + 0.5");
+  const Ferrum::CompiledKernel* kernel = Ferrum::compiledKernel(id);
+  if (id == Ferrum::FunctionID::UNKNOWN || engine.compile("a * sigmoid(b) + 0.5") != id ||
+      engine.compile("a * sigmoid(b) + 0.5", Ferrum::KernelShape::GE) == id ||
+      kernel == nullptr || kernel->expression->kind() != Ferrum::KernelKind::BINARY ||
+      Ferrum::compiledKernel(Ferrum::FunctionID::vector_exp) != nullptr) {
+    std::cout << "compiled kernels are not numbered as expected" << std::endl;
+    return false;
+  }
+  // the Metal source binds the operands as the dispatch form does
+  Ferrum::Expression* scaled = Ferrum::Expression::parse("sa * a + sha");
+  std::string source = scaled->metalSource("ge_scaled", Ferrum::KernelShape::GE);
+  // a triangle runs on a line of threads that are mapped onto its elements
+  std::string triangle = scaled->metalSource("uplo_scaled", Ferrum::KernelShape::UPLO);
+  delete scaled;
+  if (source.find("constant int& sd [[buffer(0)]]") == std::string::npos ||
+      source.find("constant float& shb [[buffer(8)]]") == std::string::npos ||
+      source.find("device float* z [[buffer(9)]]") == std::string::npos) {
+    std::cout << "unexpected Metal source:" << std::endl << source;
+    return false;
+  }
+  if (triangle.find("constant int& bottom [[buffer(2)]]") == std::string::npos ||
+      triangle.find("uint id [[thread_position_in_grid]]") == std::string::npos ||
+      triangle.find("static inline bool uplo_element(") == std::string::npos ||
+      triangle.find("uplo_element(k, sd, unit, bottom, gid_0, gid_1)") == std::string::npos) {
+    std::cout << "unexpected Metal source:" << std::endl << triangle;
+    return false;
+  }
+  return true;
+}
+
+static bool vectorTests(Ferrum::Backend& engine, const char* name) {
+  const long n = 100000;
+  std::vector<float> a(2 * n), b(n), r(2 * n, -1.0f);
+  for (long i = 0; i < 2 * n; i++) {
+    a[i] = (i % 1000) * 0.002f - 1.0f;
+  }
+  for (long i = 0; i < n; i++) {
+    b[i] = (i % 777) * 0.01f - 3.0f;
+  }
+
+  Ferrum::FunctionID gate = engine.compile("a * sigmoid(b) + 0.5");
+  if (engine.vect_bbB(gate, n, a.data(), 2 * n, 0, 2, b.data(), n, 0, 1, r.data(), n, 0, 1) == nullptr) {
+    return false;
+  }
+  for (long i = 0; i < n; i++) {
+    if (!close(r[i], a[2 * i] * sigmoid(b[i]) + 0.5f)) {
+      std::cout << name << ": a * sigmoid(b) + 0.5 differs at " << i << std::endl;
+      return false;
+    }
+  }
+
+  // a scalar, a power and a reversed operand
+  Ferrum::FunctionID power = engine.compile("-a^2 / (1 + abs(a)) + max(a, sa)");
+  if (engine.vect_bfB(power, n, a.data(), 2 * n, 0, -1, 0.25f, r.data(), 2 * n, 0, 1) == nullptr) {
+    return false;
+  }
+  for (long i = 0; i < n; i++) {
+    float x = a[n - 1 - i];
+    if (!close(r[i], -(x * x) / (1 + std::fabs(x)) + std::fmax(x, 0.25f))) {
+      std::cout << name << ": the power expression differs at " << i << std::endl;
+      return false;
+    }
+  }
+
+  // a binary kernel is not a unary one
+  if (engine.vect_bB(gate, n, a.data(), 2 * n, 0, 1, r.data(), n, 0, 1) != nullptr) {
+    std::cout << name << ": a binary kernel ran as a unary one" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+static bool matrixTests(Ferrum::Backend& engine) {
+  const long sd = 50, fd = 50, ld = 60;
+  std::vector<float> a(ld * fd), r(ld * fd, -1.0f);
+  for (long i = 0; i < ld * fd; i++) {
+    a[i] = (i % 97) * 0.1f;
+  }
+  Ferrum::FunctionID ge = engine.compile("sa * a + sha", Ferrum::KernelShape::GE);
+  engine.ge_bffffB(ge, sd, fd, a.data(), ld * fd, 0, ld, 2.0f, 3.0f, 0.0f, 0.0f, r.data(), ld * fd, 0, ld);
+  for (long j = 0; j < fd; j++) {
+    for (long i = 0; i < ld; i++) {
+      float expected = i < sd ? 2.0f * a[i + j * ld] + 3.0f : -1.0f;
+      if (!close(r[i + j * ld], expected)) {
+        std::cout << "ge: sa * a + sha differs at " << i << ", " << j << std::endl;
+        return false;
+      }
+    }
+  }
+
+  // a unit lower triangle leaves the diagonal and the upper triangle alone
+  std::fill(r.begin(), r.end(), -1.0f);
+  Ferrum::FunctionID uplo = engine.compile("sqrt(a) + 1", Ferrum::KernelShape::UPLO);
+  engine.uplo_bB(uplo, sd, 132, 1, a.data(), ld * fd, 0, ld, r.data(), ld * fd, 0, ld);
+  for (long j = 0; j < sd; j++) {
+    for (long i = 0; i < sd; i++) {
+      float expected = i > j ? std::sqrt(a[i + j * ld]) + 1 : -1.0f;
+      if (!close(r[i + j * ld], expected)) {
+        std::cout << "uplo: sqrt(a) + 1 differs at " << i << ", " << j << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// One pass of a compiled kernel against the built-in kernels it replaces
+static bool timing(Ferrum::Backend& engine) {
+  const long n = 1 << 20;
+  const int repeats = 10;
+  std::vector<float> a(n), b(n), t(n), r(n), fused(n);
+  for (long i = 0; i < n; i++) {
+    a[i] = (i % 1000) * 0.001f;
+    b[i] = (i % 777) * 0.01f - 3.0f;
+  }
+  Ferrum::FunctionID gate = engine.compile("a * sigmoid(b) + 0.5");
+  auto start = std::chrono::steady_clock::now();
+  for (int k = 0; k < repeats; k++) {
+    engine.vect_bB(Ferrum::FunctionID::vector_sigmoid, n, b.data(), n, 0, 1, t.data(), n, 0, 1);
+    engine.vect_bbB(Ferrum::FunctionID::vector_mul, n, a.data(), n, 0, 1, t.data(), n, 0, 1, t.data(), n, 0, 1);
+    engine.vect_bffffB(Ferrum::FunctionID::vector_scale_shift, n, t.data(), n, 0, 1, 1.0f, 0.5f, 0.0f, 0.0f,
+                       r.data(), n, 0, 1);
+  }
+  auto passes = std::chrono::steady_clock::now() - start;
+  start = std::chrono::steady_clock::now();
+  for (int k = 0; k < repeats; k++) {
+    engine.vect_bbB(gate, n, a.data(), n, 0, 1, b.data(), n, 0, 1, fused.data(), n, 0, 1);
+  }
+  auto compiled = std::chrono::steady_clock::now() - start;
+  std::cout << "three passes: " << std::chrono::duration<double, std::milli>(passes).count() / repeats
+            << " ms, compiled: " << std::chrono::duration<double, std::milli>(compiled).count() / repeats
+            << " ms" << std::endl;
+  for (long i = 0; i < n; i++) {
+    if (!close(fused[i], r[i])) {
+      std::cout << "the compiled kernel differs from the passes at " << i << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// A compiled kernel is captured and replayed like any other
+static bool graphTests(Ferrum::CpuEngine& engine) {
+  const long n = 1000;
+  std::vector<float> a(n), b(n), r(n);
+  for (long i = 0; i < n; i++) {
+    a[i] = i * 0.001f;
+    b[i] = 1.0f - i * 0.001f;
+  }
+  Ferrum::FunctionID hypot = engine.compile("sqrt(a * a + b * b)");
+  Ferrum::Graph graph;
+  graph.tensor(a.data(), n);
+  graph.tensor(b.data(), n);
+  graph.tensor(r.data(), n);
+  graph.vect_bbB(hypot, n, a.data(), n, 0, 1, b.data(), n, 0, 1, r.data(), n, 0, 1);
+  Ferrum::GraphExec* exec = engine.instantiate(graph);
+  bool ok = exec != nullptr && exec->replay();
+  delete exec;
+  for (long i = 0; i < n && ok; i++) {
+    ok = close(r[i], std::hypot(a[i], b[i]));
+  }
+  if (!ok) {
+    std::cout << "the replayed compiled kernel differs" << std::endl;
+  }
+  return ok;
+}
+
+int main(void) {
+  Ferrum::CpuEngine engine;
+  Ferrum::SplitEngine split({new Ferrum::CpuEngine(0), new Ferrum::CpuEngine(0)}, 1 << 10);
+  if (parseTests(engine) && vectorTests(engine, "cpu") && vectorTests(split, "split") && matrixTests(engine) &&
+      timing(engine) && graphTests(engine)) {
+    std::cout << "Success!" << std::endl;
+    return 0;
+  }
+  std::cout << "Failed!" << std::endl;
+  return 1;
+}
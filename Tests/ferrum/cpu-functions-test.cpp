@@ -0,0 +1,39 @@
+#include <iostream>
+#include <string>
+
+#include "backend.hpp"
+
+// The generated function table: names and ids look each other up, and each kernel has its operands
+
+static_assert(Ferrum::functionID("vector_sincos") == Ferrum::vector_sincos);
+static_assert(Ferrum::functionInfo(Ferrum::vector_sincos)->outputs == 2);
+
+int main(void) {
+  bool ok = true;
+  for (int i = 0; i < Ferrum::FUNCTION_COUNT && ok; i++) {
+    Ferrum::FunctionID id = static_cast<Ferrum::FunctionID>(i);
+    // a name built at run time, as the JNI layer passes them
+    std::string name = Ferrum::functionName(id);
+    ok = Ferrum::getFunctionID(name) == id && Ferrum::getFunctionID(name + "_") == Ferrum::FunctionID::UNKNOWN &&
+         Ferrum::getFunctionID(name.substr(1)) == Ferrum::FunctionID::UNKNOWN;
+    if (!ok) {
+      std::cout << "'" << name << "' does not find its id" << std::endl;
+    }
+  }
+  const Ferrum::FunctionInfo* add = Ferrum::functionInfo(Ferrum::ge_add);
+  const Ferrum::FunctionInfo* scale = Ferrum::functionInfo(Ferrum::uplo_scale_shift);
+  const Ferrum::FunctionInfo* swap = Ferrum::functionInfo(Ferrum::vector_swap);
+  if (ok && (add->inputs != 2 || add->outputs != 1 || add->scalars != 0 || scale->inputs != 1 ||
+             scale->scalars != 4 || swap->inputs != 0 || swap->outputs != 2 ||
+             Ferrum::functionInfo(Ferrum::FunctionID::UNKNOWN) != nullptr ||
+             Ferrum::functionName(static_cast<Ferrum::FunctionID>(Ferrum::FUNCTION_COUNT)) != nullptr)) {
+    std::cout << "the operands of a kernel are not as declared" << std::endl;
+    ok = false;
+  }
+  if (ok) {
+    std::cout << "Success!" << std::endl;
+    return 0;
+  }
+  std::cout << "Failed!" << std::endl;
+  return 1;
+}
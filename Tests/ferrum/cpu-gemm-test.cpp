@@ -0,0 +1,154 @@
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "cpuengine.hpp"
+#include "graph.hpp"
+#include "lazy.hpp"
+#include "split.hpp"
+
+#include "matrix.hpp"
+
+// C = alpha * op(A) * op(B) + beta * C on the CPU: every transpose against a plain triple loop,
+// on sizes that leave partial blocks, through the wrapping backends, and a rate against the loop
+
+static void reference(bool ta, bool tb, long m, long n, long k, float alpha, const Matrix& a, const Matrix& b,
+                      float beta, Matrix& c) {
+  for (long j = 0; j < n; j++) {
+    for (long i = 0; i < m; i++) {
+      double sum = 0;
+      for (long p = 0; p < k; p++) {
+        sum += static_cast<double>(ta ? a.at(p, i) : a.at(i, p)) * (tb ? b.at(j, p) : b.at(p, j));
+      }
+      *c.ref(i, j) = static_cast<float>(alpha * sum + (beta == 0.0f ? 0.0 : beta * *c.ref(i, j)));
+    }
+  }
+}
+
+static bool same(const Matrix& x, const Matrix& y, long k) {
+  for (size_t i = 0; i < x.data.size(); i++) {
+    if (std::fabs(x.data[i] - y.data[i]) > 1e-5f * (k + 1) || std::isnan(x.data[i])) {
+      std::cout << "element " << i << ": " << x.data[i] << ", expected " << y.data[i] << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool check(Ferrum::Backend& engine, bool ta, bool tb, long m, long n, long k, float alpha, float beta) {
+  Matrix a(ta ? k : m, ta ? m : k, 3, 2, 1);
+  Matrix b(tb ? n : k, tb ? k : n, 5, 1, 2);
+  Matrix c(m, n, 7, 3, 3);
+  if (beta == 0.0f) {
+    // C is not read when beta is 0
+    for (long j = 0; j < n; j++) {
+      for (long i = 0; i < m; i++) {
+        *c.ref(i, j) = std::numeric_limits<float>::quiet_NaN();
+      }
+    }
+  }
+  Matrix expected = c;
+  reference(ta, tb, m, n, k, alpha, a, b, beta, expected);
+  float* result = engine.gemm(ta ? Ferrum::TRANS : Ferrum::NO_TRANS, tb ? Ferrum::TRANS : Ferrum::NO_TRANS,
+                              m, n, k, alpha, a.data.data(), a.len(), a.offset, a.ld,
+                              b.data.data(), b.len(), b.offset, b.ld,
+                              beta, c.data.data(), c.len(), c.offset, c.ld);
+  if (result != c.data.data() || !same(c, expected, k)) {
+    std::cout << engine.name() << " gemm " << (ta ? "T" : "N") << (tb ? "T" : "N") << " " << m << " x " << n
+              << " x " << k << " with alpha " << alpha << ", beta " << beta << " is wrong" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+static bool products(Ferrum::Backend& engine) {
+  const long sizes[][3] = {{1, 1, 1}, {8, 6, 4}, {37, 29, 300}, {130, 101, 17}, {257, 197, 263}};
+  for (const auto& size : sizes) {
+    for (int t = 0; t < 4; t++) {
+      if (!check(engine, t & 1, t & 2, size[0], size[1], size[2], 1.5f, 0.5f)) {
+        return false;
+      }
+    }
+  }
+  return check(engine, false, false, 45, 33, 20, -1.0f, 0.0f) && check(engine, true, true, 45, 33, 20, 2.0f, 1.0f) &&
+         check(engine, false, true, 45, 33, 0, 1.0f, 3.0f) && check(engine, true, false, 45, 33, 20, 0.0f, -2.0f);
+}
+
+static bool rejects(Ferrum::Backend& engine) {
+  Matrix a(10, 10, 0, 0, 1), b(10, 10, 0, 0, 2), c(10, 10, 0, 0, 3);
+  float* data = c.data.data();
+  return engine.gemm(Ferrum::NO_TRANS, Ferrum::NO_TRANS, 11, 10, 10, 1.0f, a.data.data(), a.len(), 0, 10,
+                     b.data.data(), b.len(), 0, 10, 0.0f, data, c.len(), 0, 10) == nullptr &&
+         engine.gemm(Ferrum::NO_TRANS, Ferrum::TRANS, 10, 10, 10, 1.0f, a.data.data(), a.len(), 0, 10,
+                     b.data.data(), b.len(), 1, 10, 0.0f, data, c.len(), 0, 10) == nullptr &&
+         engine.gemm(Ferrum::NO_TRANS, 113, 10, 10, 10, 1.0f, a.data.data(), a.len(), 0, 10,
+                     b.data.data(), b.len(), 0, 10, 0.0f, data, c.len(), 0, 10) == nullptr;
+}
+
+// A deferred call that writes A runs before the product reads it
+static bool lazy() {
+  Ferrum::LazyEngine engine(new Ferrum::CpuEngine());
+  Matrix a(20, 20, 0, 0, 1), b(20, 20, 0, 0, 2), c(20, 20, 0, 0, 3);
+  std::vector<float> source(a.data);
+  engine.vect_bB(Ferrum::FunctionID::vector_abs, a.len(), source.data(), a.len(), 0, 1,
+                 a.data.data(), a.len(), 0, 1);
+  Matrix expected = c;
+  for (float& x : a.data) {
+    x = std::fabs(x);
+  }
+  reference(false, false, 20, 20, 20, 1.0f, a, b, 0.0f, expected);
+  for (float& x : a.data) {
+    x = 0.0f;
+  }
+  engine.gemm(Ferrum::NO_TRANS, Ferrum::NO_TRANS, 20, 20, 20, 1.0f, a.data.data(), a.len(), 0, 20,
+              b.data.data(), b.len(), 0, 20, 0.0f, c.data.data(), c.len(), 0, 20);
+  return same(c, expected, 20);
+}
+
+static double gflops(long n, double seconds) {
+  return 2.0 * n * n * n / seconds * 1e-9;
+}
+
+// The blocked product against the loop that it replaces, which walks B and C down columns
+static void benchmark(Ferrum::Backend& engine) {
+  const long n = 512;
+  Matrix a(n, n, 0, 0, 1), b(n, n, 0, 0, 2), c(n, n, 0, 0, 3), naive(n, n, 0, 0, 3);
+  double loop = timed([&]() {
+    for (long j = 0; j < n; j++) {
+      for (long p = 0; p < n; p++) {
+        float bpj = b.at(p, j);
+        for (long i = 0; i < n; i++) {
+          *naive.ref(i, j) += a.at(i, p) * bpj;
+        }
+      }
+    }
+  });
+  engine.gemm(Ferrum::NO_TRANS, Ferrum::NO_TRANS, n, n, n, 1.0f, a.data.data(), a.len(), 0, n,
+              b.data.data(), b.len(), 0, n, 1.0f, c.data.data(), c.len(), 0, n);
+  double blocked = timed([&]() {
+    engine.gemm(Ferrum::NO_TRANS, Ferrum::NO_TRANS, n, n, n, 1.0f, a.data.data(), a.len(), 0, n,
+                b.data.data(), b.len(), 0, n, 1.0f, c.data.data(), c.len(), 0, n);
+  });
+  std::cout << "gemm " << n << ": loop " << gflops(n, loop) << " GFLOP/s, blocked " << gflops(n, blocked)
+            << " GFLOP/s" << std::endl;
+}
+
+int main(void) {
+  Ferrum::CpuEngine serial(0);
+  Ferrum::CpuEngine pooled;
+  Ferrum::SplitEngine split({new Ferrum::CpuEngine(2), new Ferrum::CpuEngine(2)}, 1);
+  Ferrum::Graph graph;
+  Matrix a(4, 4, 0, 0, 1);
+  bool ok = products(serial) && products(pooled) && products(split) && rejects(pooled) && rejects(split) &&
+            lazy() &&
+            graph.gemm(Ferrum::NO_TRANS, Ferrum::NO_TRANS, 4, 4, 4, 1.0f, a.data.data(), a.len(), 0, 4,
+                       a.data.data(), a.len(), 0, 4, 0.0f, a.data.data(), a.len(), 0, 4) == nullptr;
+  if (ok) {
+    benchmark(pooled);
+    std::cout << "Success!" << std::endl;
+    return 0;
+  }
+  std::cout << "Failed!" << std::endl;
+  return 1;
+}
@@ -0,0 +1,203 @@
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "cpuengine.hpp"
+#include "lazy.hpp"
+#include "split.hpp"
+
+#include "matrix.hpp"
+
+// gemv and ger against sums taken in double. The shapes reach each way the host cuts gemv: tall
+// matrices into blocks of rows, and a short y into groups of columns whose sums are added after.
+// Vectors are strided and reversed, and y starts as NaN when beta is 0 since it must not be read.
+// The benchmark rates reading A, against a dot along each row and down each column.
+
+// A strided vector in an array, with element i at firstIndex(offset, stride, n) + i * stride
+struct Vector {
+  long n, offset, stride;
+  std::vector<float> data;
+
+  Vector(long n, long offset, long stride, int seed) :
+      n(n), offset(offset), stride(stride), data(offset + (n - 1) * std::labs(stride) + 1 + 2) {
+    for (size_t i = 0; i < data.size(); i++) {
+      data[i] = value(i, seed);
+    }
+  }
+
+  float& operator[](long i) { return data[Ferrum::firstIndex(offset, stride, n) + i * stride]; }
+  long len() const { return static_cast<long>(data.size()); }
+};
+
+static bool same(const std::vector<float>& x, const std::vector<float>& y, long terms) {
+  for (size_t i = 0; i < x.size(); i++) {
+    if (std::fabs(x[i] - y[i]) > 4e-6f * (terms + 1) || std::isnan(x[i])) {
+      std::cout << "element " << i << ": " << x[i] << ", expected " << y[i] << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool gemv(Ferrum::Backend& engine, bool t, long m, long n, long strideX, long strideY, float alpha,
+                 float beta) {
+  Matrix a(m, n, 3, 2, 1);
+  Vector x(t ? m : n, 2, strideX, 2);
+  Vector y(t ? n : m, 1, strideY, 3);
+  if (beta == 0.0f) {
+    // y is not read when beta is 0
+    for (long i = 0; i < y.n; i++) {
+      y[i] = std::numeric_limits<float>::quiet_NaN();
+    }
+  }
+  Vector expected = y;
+  for (long i = 0; i < y.n; i++) {
+    double sum = 0;
+    for (long p = 0; p < x.n; p++) {
+      sum += static_cast<double>(t ? a.at(p, i) : a.at(i, p)) * x[p];
+    }
+    expected[i] = static_cast<float>(alpha * sum + (beta == 0.0f ? 0.0 : beta * expected[i]));
+  }
+  float* result = engine.gemv(t ? Ferrum::TRANS : Ferrum::NO_TRANS, m, n, alpha, a.data.data(), a.len(), a.offset,
+                              a.ld, x.data.data(), x.len(), x.offset, x.stride,
+                              beta, y.data.data(), y.len(), y.offset, y.stride);
+  if (result != y.data.data() || !same(y.data, expected.data, x.n)) {
+    std::cout << engine.name() << " gemv " << (t ? "T" : "N") << " " << m << " x " << n << " with strides "
+              << strideX << ", " << strideY << " is wrong" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+static bool ger(Ferrum::Backend& engine, long m, long n, long strideX, long strideY, float alpha) {
+  Vector x(m, 4, strideX, 1);
+  Vector y(n, 0, strideY, 2);
+  Matrix a(m, n, 5, 3, 3);
+  Matrix expected = a;
+  for (long j = 0; j < n; j++) {
+    for (long i = 0; i < m; i++) {
+      *expected.ref(i, j) += alpha * x[i] * y[j];
+    }
+  }
+  float* result = engine.ger(m, n, alpha, x.data.data(), x.len(), x.offset, x.stride,
+                             y.data.data(), y.len(), y.offset, y.stride, a.data.data(), a.len(), a.offset, a.ld);
+  if (result != a.data.data() || !same(a.data, expected.data, 1)) {
+    std::cout << engine.name() << " ger " << m << " x " << n << " with strides " << strideX << ", " << strideY
+              << " is wrong" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+static bool products(Ferrum::Backend& engine) {
+  // small, square, tall enough to be cut into blocks of rows, and wide enough for groups of columns
+  const long sizes[][2] = {{1, 1}, {7, 5}, {300, 301}, {40000, 3}, {20000, 9}, {33, 40000}, {5, 3000}};
+  for (const auto& size : sizes) {
+    for (int t = 0; t < 2; t++) {
+      if (!gemv(engine, t, size[0], size[1], 1, 1, 1.5f, 0.5f) ||
+          !gemv(engine, t, size[0], size[1], -2, 3, -1.0f, 0.0f)) {
+        return false;
+      }
+    }
+    if (!ger(engine, size[0], size[1], 1, 1, 0.75f) || !ger(engine, size[0], size[1], 3, -2, -1.5f)) {
+      return false;
+    }
+  }
+  return gemv(engine, false, 50, 0, 1, 1, 1.0f, 2.0f) && gemv(engine, true, 50, 60, 1, -1, 0.0f, 2.0f);
+}
+
+static bool rejects(Ferrum::Backend& engine) {
+  Matrix a(10, 10, 0, 0, 1);
+  Vector x(10, 0, 1, 2), y(10, 0, 1, 3);
+  float* ad = a.data.data();
+  float* xd = x.data.data();
+  float* yd = y.data.data();
+  return engine.gemv(Ferrum::NO_TRANS, 11, 10, 1.0f, ad, a.len(), 0, 10, xd, x.len(), 0, 1,
+                     0.0f, yd, y.len(), 0, 1) == nullptr &&
+         engine.gemv(Ferrum::TRANS, 10, 10, 1.0f, ad, a.len(), 0, 10, xd, x.len(), 1, 2,
+                     0.0f, yd, y.len(), 0, 1) == nullptr &&
+         engine.gemv(114, 10, 10, 1.0f, ad, a.len(), 0, 10, xd, x.len(), 0, 1, 0.0f, yd, y.len(), 0, 1) == nullptr &&
+         engine.ger(10, 10, 1.0f, xd, x.len(), 0, 1, yd, y.len(), 0, 1, ad, a.len(), 1, 10) == nullptr &&
+         engine.ger(10, 10, 1.0f, xd, x.len(), 0, 1, yd, y.len(), 0, 0, ad, a.len(), 0, 10) == nullptr;
+}
+
+// A deferred call that writes x runs before the product reads it
+static bool lazy() {
+  Ferrum::LazyEngine engine(new Ferrum::CpuEngine());
+  Matrix a(30, 20, 0, 0, 1);
+  Vector x(20, 0, 1, 2), y(30, 0, 1, 3), source = x;
+  engine.vect_bB(Ferrum::FunctionID::vector_abs, x.n, source.data.data(), x.len(), 0, 1, x.data.data(), x.len(), 0, 1);
+  std::vector<float> expected(y.n);
+  for (long i = 0; i < y.n; i++) {
+    for (long j = 0; j < x.n; j++) {
+      expected[i] += a.at(i, j) * std::fabs(source[j]);
+    }
+  }
+  engine.gemv(Ferrum::NO_TRANS, 30, 20, 1.0f, a.data.data(), a.len(), 0, 30, x.data.data(), x.len(), 0, 1,
+              0.0f, y.data.data(), y.len(), 0, 1);
+  return same(std::vector<float>(y.data.begin(), y.data.begin() + y.n), expected, x.n);
+}
+
+// The second of two runs, once A is in whatever cache it fits
+static double warmed(const std::function<void()>& run) {
+  run();
+  return timed(run);
+}
+
+// Reading A is the cost, so rates are in GB/s of A. The loops are the obvious ones: a dot
+// product along each row of A, and down each column when transposed.
+static void benchmark(Ferrum::Backend& engine) {
+  const long m = 4096, n = 4096;
+  Matrix a(m, n, 0, 0, 1);
+  Vector x(n, 0, 1, 2), y(m, 0, 1, 3);
+  double bytes = 4.0 * m * n;
+  double rows = warmed([&]() {
+    for (long i = 0; i < m; i++) {
+      float sum = 0.0f;
+      for (long j = 0; j < n; j++) {
+        sum += a.at(i, j) * x.data[j];
+      }
+      y.data[i] = sum;
+    }
+  });
+  double columns = warmed([&]() {
+    for (long j = 0; j < n; j++) {
+      float sum = 0.0f;
+      for (long i = 0; i < m; i++) {
+        sum += a.at(i, j) * y.data[i];
+      }
+      x.data[j] = sum;
+    }
+  });
+  double blockedN = warmed([&]() {
+    engine.gemv(Ferrum::NO_TRANS, m, n, 1.0f, a.data.data(), a.len(), 0, m, x.data.data(), x.len(), 0, 1,
+                0.0f, y.data.data(), y.len(), 0, 1);
+  });
+  double blockedT = warmed([&]() {
+    engine.gemv(Ferrum::TRANS, m, n, 1.0f, a.data.data(), a.len(), 0, m, y.data.data(), y.len(), 0, 1,
+                0.0f, x.data.data(), x.len(), 0, 1);
+  });
+  double update = warmed([&]() {
+    engine.ger(m, n, 1e-3f, y.data.data(), y.len(), 0, 1, x.data.data(), x.len(), 0, 1,
+               a.data.data(), a.len(), 0, m);
+  });
+  std::cout << "gemv " << m << " x " << n << " (GB/s): N loop " << bytes / rows * 1e-9 << ", blocked "
+            << bytes / blockedN * 1e-9 << "; T loop " << bytes / columns * 1e-9 << ", blocked "
+            << bytes / blockedT * 1e-9 << "; ger " << 2 * bytes / update * 1e-9 << std::endl;
+}
+
+int main(void) {
+  Ferrum::CpuEngine serial(0);
+  Ferrum::CpuEngine pooled;
+  Ferrum::SplitEngine split({new Ferrum::CpuEngine(2), new Ferrum::CpuEngine(2)}, 1);
+  bool ok = products(serial) && products(pooled) && products(split) && rejects(pooled) && rejects(split) && lazy();
+  if (ok) {
+    benchmark(pooled);
+    std::cout << "Success!" << std::endl;
+    return 0;
+  }
+  std::cout << "Failed!" << std::endl;
+  return 1;
+}
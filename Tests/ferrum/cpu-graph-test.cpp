@@ -0,0 +1,203 @@
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "cpuengine.hpp"
+#include "graph.hpp"
+#include "split.hpp"
+
+// A sequence of calls captured once as a graph, and replayed with other data bound to its tensors
+
+static bool close(float x, float y) {
+  return std::fabs(x - y) <= 1e-5f * std::fmax(1.0f, std::fabs(y));
+}
+
+static const long N = 100000;
+static const long SD = 200, FD = 300;
+
+// The tensors of the sequence
+struct Tensors {
+  float* x;
+  float* y;
+  float* acc;
+  float* t;
+  float* q;
+  float* r;
+  float* m;
+  float* mr;
+};
+
+// 33 calls: a weighted sum built up in acc, then a reversed pair, and a matrix and a triangle
+static bool sequence(Ferrum::Backend& backend, const Tensors& v, long n, bool matrices = true) {
+  for (int k = 0; k < 10; k++) {
+    if (backend.vect_bffffB(Ferrum::FunctionID::vector_scale_shift, n, v.x, n, 0, 1, 0.5f, 0.01f * k, 0.0f, 0.0f,
+                            v.t, n, 0, 1) == nullptr ||
+        backend.vect_bbB(Ferrum::FunctionID::vector_mul, n, v.t, n, 0, 1, v.y, n, 0, 1, v.t, n, 0, 1) == nullptr ||
+        backend.vect_bbB(Ferrum::FunctionID::vector_add, n, v.acc, n, 0, 1, v.t, n, 0, 1, v.acc, n, 0, 1) == nullptr) {
+      return false;
+    }
+  }
+  if (backend.vect_bBB(Ferrum::FunctionID::vector_sincos, n / 2, v.acc, n, 0, 2, v.q, n, 0, -1,
+                       v.r, n, 0, 1) == nullptr) {
+    return false;
+  }
+  return !matrices ||
+         (backend.ge_bfB(Ferrum::FunctionID::ge_powx, SD, FD, v.m, SD * FD, 0, SD, 2.0f, v.mr, SD * FD, 0, SD) != nullptr &&
+          backend.uplo_bB(Ferrum::FunctionID::uplo_sqrt, SD, 131, 1, v.m, SD * FD, 0, SD, v.mr, SD * FD, 0, SD) != nullptr);
+}
+
+static void fill(const Tensors& v, long n, int round) {
+  for (long i = 0; i < n; i++) {
+    v.x[i] = ((i + round * 17) % 1000) * 0.001f;
+    v.y[i] = 1.0f - ((i + round * 5) % 777) * 0.001f;
+    v.acc[i] = 0.0f;
+    v.q[i] = 0.0f;
+    v.r[i] = 0.0f;
+  }
+  for (long i = 0; i < SD * FD; i++) {
+    v.m[i] = ((i + round) % 500) * 0.01f;
+    v.mr[i] = -1.0f;
+  }
+}
+
+static bool same(const float* x, const float* y, long n, const char* what) {
+  for (long i = 0; i < n; i++) {
+    if (!close(x[i], y[i])) {
+      std::cout << what << " differs at " << i << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool sameResults(const Tensors& v, const Tensors& w, const char* name) {
+  std::cout << name << ": ";
+  bool ok = same(v.acc, w.acc, N, "acc") && same(v.q, w.q, N, "q") && same(v.r, w.r, N, "r") &&
+            same(v.mr, w.mr, SD * FD, "mr");
+  std::cout << (ok ? "replay matches" : "") << std::endl;
+  return ok;
+}
+
+static Tensors allocate(Ferrum::CpuEngine& engine) {
+  return Tensors{engine.allocate(N), engine.allocate(N), engine.allocate(N), engine.allocate(N),
+                 engine.allocate(N), engine.allocate(N), engine.allocate(SD * FD), engine.allocate(SD * FD)};
+}
+
+static Ferrum::Graph capture(const Tensors& v) {
+  Ferrum::Graph graph;
+  for (float* data : {v.x, v.y, v.acc, v.t, v.q, v.r}) {
+    graph.tensor(data, N);
+  }
+  graph.tensor(v.m, SD * FD);
+  graph.tensor(v.mr, SD * FD);
+  sequence(graph, v, N);
+  return graph;
+}
+
+// The graph's tensors, in the order they were declared
+static void bind(Ferrum::GraphExec* exec, const Tensors& v) {
+  float* data[] = {v.x, v.y, v.acc, v.t, v.q, v.r, v.m, v.mr};
+  for (int t = 0; t < 8; t++) {
+    exec->bind(t, data[t]);
+  }
+}
+
+static bool replayTests(Ferrum::CpuEngine& engine) {
+  Tensors captured = allocate(engine);
+  Tensors expected = allocate(engine);
+  Tensors other = allocate(engine);
+  fill(captured, N, 0);
+  Ferrum::Graph graph = capture(captured);
+  if (graph.ops().size() != 33 || graph.tensorCount() != 8) {
+    std::cout << "captured " << graph.ops().size() << " calls" << std::endl;
+    return false;
+  }
+  // capturing computes nothing
+  if (captured.acc[1] != 0.0f || captured.mr[0] != -1.0f) {
+    std::cout << "capture wrote a result" << std::endl;
+    return false;
+  }
+
+  Ferrum::GraphExec* exec = engine.instantiate(graph);
+  if (exec == nullptr) {
+    return false;
+  }
+  // first on the data the graph was captured with, then twice on other data
+  bool ok = exec->replay();
+  fill(expected, N, 0);
+  ok = ok && sequence(engine, expected, N) && sameResults(captured, expected, "cpu");
+  for (int round = 1; round < 3 && ok; round++) {
+    fill(other, N, round);
+    fill(expected, N, round);
+    bind(exec, other);
+    ok = exec->replay() && sequence(engine, expected, N) && sameResults(other, expected, "cpu rebound");
+  }
+
+  // a backend without its own instance makes the calls one by one
+  Ferrum::SplitEngine split({new Ferrum::CpuEngine(0), new Ferrum::CpuEngine(0)}, 1 << 10);
+  Ferrum::GraphExec* calls = split.instantiate(graph);
+  fill(other, N, 3);
+  fill(expected, N, 3);
+  bind(calls, other);
+  ok = ok && calls->replay() && sequence(engine, expected, N) && sameResults(other, expected, "split");
+  delete calls;
+
+  // with few elements, a call costs little more than its dispatch
+  const long n = 64;
+  const int repeats = 2000;
+  Ferrum::Graph small;
+  for (float* data : {captured.x, captured.y, captured.acc, captured.t, captured.q, captured.r}) {
+    small.tensor(data, n);
+  }
+  sequence(small, captured, n, false);
+  Ferrum::GraphExec* smallExec = engine.instantiate(small);
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < repeats; i++) {
+    sequence(engine, captured, n, false);
+  }
+  auto direct = std::chrono::steady_clock::now() - start;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < repeats; i++) {
+    smallExec->replay();
+  }
+  auto replayed = std::chrono::steady_clock::now() - start;
+  std::cout << "calls: " << std::chrono::duration<double, std::micro>(direct).count() / repeats
+            << " us per sequence, replay: " << std::chrono::duration<double, std::micro>(replayed).count() / repeats
+            << " us per sequence" << std::endl;
+  delete smallExec;
+  delete exec;
+  return ok;
+}
+
+static bool captureTests() {
+  std::vector<float> a(1000), b(1000), outside(1000);
+  Ferrum::Graph graph;
+  graph.tensor(a.data(), 1000);
+  graph.tensor(b.data(), 1000);
+  // a slice of a tensor is recorded from the tensor's start
+  if (graph.vect_bB(Ferrum::FunctionID::vector_exp, 10, a.data() + 100, 50, 5, -2, b.data(), 1000, 0, 1) == nullptr ||
+      graph.ops()[0].a.tensor != 0 || graph.ops()[0].a.offset != 105 || graph.ops()[0].a.stride != -2) {
+    std::cout << "a slice was not recorded in its tensor" << std::endl;
+    return false;
+  }
+  // arrays outside every tensor, and calls that overrun their arrays, are rejected
+  if (graph.vect_bB(Ferrum::FunctionID::vector_exp, 10, outside.data(), 1000, 0, 1, b.data(), 1000, 0, 1) != nullptr ||
+      graph.vect_bB(Ferrum::FunctionID::vector_exp, 10, a.data() + 995, 10, 0, 1, b.data(), 1000, 0, 1) != nullptr ||
+      graph.ge_bB(Ferrum::FunctionID::ge_exp, 40, 30, a.data(), 1000, 0, 40, b.data(), 1000, 0, 40) != nullptr ||
+      graph.ops().size() != 1) {
+    std::cout << "a call outside the tensors was recorded" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int main(void) {
+  Ferrum::CpuEngine engine;
+  if (captureTests() && replayTests(engine)) {
+    std::cout << "Success!" << std::endl;
+    return 0;
+  }
+  std::cout << "Failed!" << std::endl;
+  return 1;
+}
@@ -0,0 +1,158 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "kernelcache.hpp"
+
+// Compiled kernels kept on disk: entries are keyed by source, version and target, shared by
+// processes, and evicted least recently used first
+
+static std::string kernel(int k) {
+  return "kernel void vector_compiled_" + std::to_string(k) + "(device float* z [[buffer(0)]]) {}";
+}
+
+static std::string artifact(int k, size_t bytes) {
+  return std::string(bytes, static_cast<char>('a' + k % 26));
+}
+
+static bool roundTrip(const std::string& directory) {
+  Ferrum::KernelCache cache(directory, Ferrum::KernelCache::hostTarget());
+  std::string data;
+  if (!cache.enabled() || cache.load(kernel(0), data)) {
+    std::cout << "an empty cache hit" << std::endl;
+    return false;
+  }
+  std::string binary = artifact(0, 1000);
+  binary[10] = '\0';
+  if (!cache.store(kernel(0), binary) || !cache.load(kernel(0), data) || data != binary) {
+    std::cout << "a stored entry did not load" << std::endl;
+    return false;
+  }
+  // another process, or the next run, finds it
+  Ferrum::KernelCache again(directory, Ferrum::KernelCache::hostTarget());
+  if (!again.load(kernel(0), data) || data != binary) {
+    std::cout << "an entry did not load in a new cache" << std::endl;
+    return false;
+  }
+  // another target does not
+  Ferrum::KernelCache other(directory, "another-target");
+  if (other.load(kernel(0), data) || other.load(kernel(1), data)) {
+    std::cout << "an entry loaded for another target" << std::endl;
+    return false;
+  }
+  Ferrum::KernelCacheStats stats = cache.stats();
+  if (stats.hits != 1 || stats.misses != 1 || stats.stores != 1) {
+    std::cout << "hits " << stats.hits << ", misses " << stats.misses << ", stores " << stats.stores << std::endl;
+    return false;
+  }
+  // a cache without a directory never hits
+  Ferrum::KernelCache off("", Ferrum::KernelCache::hostTarget());
+  if (off.enabled() || off.store(kernel(0), binary) || off.load(kernel(0), data)) {
+    std::cout << "a cache without a directory was used" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// An entry that was cut short, or that holds another source under the same name, is a miss
+static bool damaged(const std::string& directory) {
+  Ferrum::KernelCache cache(directory, Ferrum::KernelCache::hostTarget());
+  std::string data, binary = artifact(2, 500);
+  cache.store(kernel(2), binary);
+  std::string path = cache.path(kernel(2));
+  if (truncate(path.c_str(), 300) != 0 || cache.load(kernel(2), data)) {
+    std::cout << "a truncated entry loaded" << std::endl;
+    return false;
+  }
+  // a collision: the entry for kernel 3 is put where kernel 2 is looked for
+  cache.store(kernel(3), binary);
+  if (rename(cache.path(kernel(3)).c_str(), path.c_str()) != 0 || cache.load(kernel(2), data)) {
+    std::cout << "an entry for another source loaded" << std::endl;
+    return false;
+  }
+  return cache.store(kernel(2), binary) && cache.load(kernel(2), data) && data == binary;
+}
+
+// Entries used least recently go first once the directory is over its size
+static bool eviction(const std::string& directory) {
+  const size_t bytes = 10000;
+  Ferrum::KernelCache cache(directory, Ferrum::KernelCache::hostTarget(), 5 * bytes + 1000);
+  std::string data;
+  for (int k = 0; k < 5; k++) {
+    cache.store(kernel(k), artifact(k, bytes));
+    usleep(2000);
+  }
+  // 0 is used again, so 1 and 2 are the oldest when 5 and 6 are stored
+  cache.load(kernel(0), data);
+  usleep(2000);
+  cache.store(kernel(5), artifact(5, bytes));
+  usleep(2000);
+  cache.store(kernel(6), artifact(6, bytes));
+  bool kept[7];
+  for (int k = 0; k < 7; k++) {
+    kept[k] = cache.load(kernel(k), data);
+  }
+  if (!kept[0] || kept[1] || kept[2] || !kept[3] || !kept[4] || !kept[5] || !kept[6] ||
+      cache.size() > 5 * bytes + 1000 || cache.stats().evicted != 2) {
+    std::cout << "evicted " << cache.stats().evicted << " entries to " << cache.size() << " bytes, keeping";
+    for (int k = 0; k < 7; k++) {
+      std::cout << (kept[k] ? " yes" : " no");
+    }
+    std::cout << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Processes storing and loading the same entries at once only ever see whole ones
+static bool processes(const std::string& directory) {
+  const int children = 4, rounds = 200;
+  for (int c = 0; c < children; c++) {
+    if (fork() == 0) {
+      Ferrum::KernelCache cache(directory, Ferrum::KernelCache::hostTarget(), 20000);
+      std::string data;
+      bool ok = true;
+      for (int r = 0; r < rounds && ok; r++) {
+        int k = (r + c) % 8;
+        cache.store(kernel(k), artifact(k, 3000 + 100 * k));
+        if (cache.load(kernel((k + 1) % 8), data)) {
+          ok = data == artifact((k + 1) % 8, 3000 + 100 * ((k + 1) % 8));
+        }
+      }
+      _exit(ok ? 0 : 1);
+    }
+  }
+  bool ok = true;
+  for (int c = 0; c < children; c++) {
+    int status;
+    wait(&status);
+    ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  }
+  Ferrum::KernelCache cache(directory, Ferrum::KernelCache::hostTarget(), 20000);
+  if (!ok || cache.size() > 20000) {
+    std::cout << "concurrent processes read a partial entry, or overran the size" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int main(void) {
+  char root[] = "/tmp/ferrum-kernelcache-XXXXXX";
+  if (mkdtemp(root) == nullptr) {
+    std::cout << "Failed!" << std::endl;
+    return 1;
+  }
+  std::string base = root;
+  bool ok = roundTrip(base + "/round/trip") && damaged(base + "/damaged") && eviction(base + "/eviction") &&
+            processes(base + "/processes");
+  std::system(("rm -rf " + base).c_str());
+  if (ok) {
+    std::cout << "Success!" << std::endl;
+    return 0;
+  }
+  std::cout << "Failed!" << std::endl;
+  return 1;
+}
@@ -0,0 +1,181 @@
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "cpuengine.hpp"
+#include "lazy.hpp"
+
+// Deferred calls, optimized before they run: unread results are dropped, repeated calls reuse
+// a result, sin and cos are merged, and runs of vector calls are fused tile by tile. A linear
+// algebra call still reads what they left in scratch.
+
+static bool close(float x, float y) {
+  return std::fabs(x - y) <= 1e-5f * std::fmax(1.0f, std::fabs(y));
+}
+
+static bool same(const std::vector<float>& x, const std::vector<float>& y, const char* what) {
+  for (size_t i = 0; i < x.size(); i++) {
+    if (!close(x[i], y[i])) {
+      std::cout << what << " differs at " << i << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+static void fill(std::vector<float>& x, std::vector<float>& y) {
+  for (size_t i = 0; i < x.size(); i++) {
+    x[i] = (i % 1000) * 0.001f;
+    y[i] = 1.0f - (i % 777) * 0.001f;
+  }
+}
+
+static bool eliminationTests() {
+  const long n = 1000;
+  std::vector<float> x(n), y(n), t(n, -1.0f), scratch(n), s(n), c(n), p(n), q(n);
+  fill(x, y);
+  Ferrum::LazyEngine lazy(new Ferrum::CpuEngine(0));
+  const float* xs = x.data();
+  const float* ys = y.data();
+
+  // exp into t is overwritten whole before it is read, and the log is only left in scratch
+  lazy.vect_bB(Ferrum::FunctionID::vector_exp, n, xs, n, 0, 1, t.data(), n, 0, 1);
+  lazy.vect_bB(Ferrum::FunctionID::vector_log, n, ys, n, 0, 1, scratch.data(), n, 0, 1);
+  lazy.vect_bB(Ferrum::FunctionID::vector_sqrt, n, ys, n, 0, 1, t.data(), n, 0, 1);
+  lazy.discard(scratch.data(), n);
+  // sin and cos of x become one sincos
+  lazy.vect_bB(Ferrum::FunctionID::vector_sin, n, xs, n, 0, 1, s.data(), n, 0, 1);
+  lazy.vect_bB(Ferrum::FunctionID::vector_cos, n, xs, n, 0, 1, c.data(), n, 0, 1);
+  // the same call twice is made once, and into another array it is a copy
+  lazy.vect_bfB(Ferrum::FunctionID::vector_powx, n, ys, n, 0, 1, 1.5f, p.data(), n, 0, 1);
+  lazy.vect_bfB(Ferrum::FunctionID::vector_powx, n, ys, n, 0, 1, 1.5f, p.data(), n, 0, 1);
+  lazy.vect_bfB(Ferrum::FunctionID::vector_powx, n, ys, n, 0, 1, 1.5f, q.data(), n, 0, 1);
+
+  // a call that overruns its array is rejected as it is made
+  if (lazy.vect_bB(Ferrum::FunctionID::vector_exp, n + 1, xs, n, 0, 1, t.data(), n, 0, 1) != nullptr) {
+    std::cout << "an out of bounds call was deferred" << std::endl;
+    return false;
+  }
+  // nothing runs until the results are materialized
+  if (t[0] != -1.0f || lazy.stats().executed != 0) {
+    std::cout << "a call ran before it was materialized" << std::endl;
+    return false;
+  }
+  if (!lazy.materialize()) {
+    return false;
+  }
+  for (long i = 0; i < n; i++) {
+    if (!close(t[i], std::sqrt(y[i])) || !close(s[i], std::sin(x[i])) || !close(c[i], std::cos(x[i])) ||
+        !close(p[i], std::pow(y[i], 1.5f)) || !close(q[i], std::pow(y[i], 1.5f))) {
+      std::cout << "a materialized result differs at " << i << std::endl;
+      return false;
+    }
+  }
+  Ferrum::LazyStats stats = lazy.stats();
+  std::cout << "recorded " << stats.recorded << ", eliminated " << stats.eliminated << ", reused " << stats.reused
+            << ", merged " << stats.merged << ", executed " << stats.executed << std::endl;
+  if (stats.recorded != 8 || stats.eliminated != 2 || stats.reused != 2 || stats.merged != 1 ||
+      stats.executed != 4) {
+    std::cout << "the calls were not optimized as expected" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// A weighted sum built up in acc, and a reversed square added to y
+static void sequence(Ferrum::Backend& backend, const std::vector<float>& x, const std::vector<float>& y,
+                     std::vector<float>& t, std::vector<float>& acc, std::vector<float>& w) {
+  long n = static_cast<long>(x.size());
+  for (int k = 0; k < 10; k++) {
+    backend.vect_bffffB(Ferrum::FunctionID::vector_scale_shift, n, x.data(), n, 0, 1, 0.5f, 0.01f * k, 0.0f, 0.0f,
+                        t.data(), n, 0, 1);
+    backend.vect_bbB(Ferrum::FunctionID::vector_mul, n, t.data(), n, 0, 1, y.data(), n, 0, 1, t.data(), n, 0, 1);
+    backend.vect_bbB(Ferrum::FunctionID::vector_add, n, acc.data(), n, 0, 1, t.data(), n, 0, 1,
+                     acc.data(), n, 0, 1);
+  }
+  backend.vect_bB(Ferrum::FunctionID::vector_sqr, n, x.data(), n, 0, -1, w.data(), n, 0, 1);
+  backend.vect_bbB(Ferrum::FunctionID::vector_add, n, w.data(), n, 0, 1, y.data(), n, 0, 1, w.data(), n, 0, 1);
+}
+
+static bool fusionTests() {
+  const long n = 1 << 20;
+  std::vector<float> x(n), y(n);
+  fill(x, y);
+  std::vector<float> t(n), acc(n, 0.0f), w(n), te(n), acce(n, 0.0f), we(n);
+
+  Ferrum::CpuEngine engine(0);
+  auto start = std::chrono::steady_clock::now();
+  sequence(engine, x, y, te, acce, we);
+  auto eager = std::chrono::steady_clock::now() - start;
+
+  Ferrum::LazyEngine lazy(new Ferrum::CpuEngine(0), 1 << 14);
+  start = std::chrono::steady_clock::now();
+  sequence(lazy, x, y, t, acc, w);
+  bool ok = lazy.materialize();
+  auto fused = std::chrono::steady_clock::now() - start;
+  std::cout << "eager: " << std::chrono::duration<double, std::milli>(eager).count()
+            << " ms, fused: " << std::chrono::duration<double, std::milli>(fused).count() << " ms" << std::endl;
+
+  Ferrum::LazyStats stats = lazy.stats();
+  if (!ok || stats.fused != 32 || stats.executed != 1) {
+    std::cout << "fused " << stats.fused << " calls in " << stats.executed << " chains" << std::endl;
+    return false;
+  }
+  return same(t, te, "t") && same(acc, acce, "acc") && same(w, we, "w");
+}
+
+// The pending calls run once there are too many of them
+static bool limitTests() {
+  const long n = 100;
+  std::vector<float> x(n), y(n), r(n, 0.0f);
+  fill(x, y);
+  Ferrum::LazyEngine lazy(new Ferrum::CpuEngine(0), Ferrum::LazyEngine::DEFAULT_FUSE_TILE, 4);
+  for (int k = 0; k < 4; k++) {
+    lazy.vect_bbB(Ferrum::FunctionID::vector_add, n, r.data(), n, 0, 1, x.data(), n, 0, 1, r.data(), n, 0, 1);
+  }
+  if (lazy.stats().executed != 4 || !close(r[n - 1], 4 * x[n - 1])) {
+    std::cout << "the pending calls did not run at the limit" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// A linear algebra call runs the deferred calls before it, including those that write scratch it
+// reads. The scratch stays scratch until the caller materializes.
+static bool blasTests() {
+  const long n = 8;
+  std::vector<float> x(n), y(n), identity(n * n, 0.0f), scratch(n), r(n, 0.0f);
+  fill(x, y);
+  for (long i = 0; i < n; i++) {
+    identity[i + i * n] = 1.0f;
+  }
+  Ferrum::LazyEngine lazy(new Ferrum::CpuEngine(0));
+  lazy.discard(scratch.data(), n);
+  lazy.vect_bB(Ferrum::FunctionID::vector_exp, n, x.data(), n, 0, 1, scratch.data(), n, 0, 1);
+  lazy.gemv(Ferrum::NO_TRANS, n, n, 1.0f, identity.data(), n * n, 0, n, scratch.data(), n, 0, 1,
+            0.0f, r.data(), n, 0, 1);
+  for (long i = 0; i < n; i++) {
+    if (!close(r[i], std::exp(x[i]))) {
+      std::cout << "gemv read " << r[i] << " from scratch at " << i << ", expected " << std::exp(x[i]) << std::endl;
+      return false;
+    }
+  }
+  // a later write to the scratch is still dropped when the caller materializes
+  lazy.vect_bB(Ferrum::FunctionID::vector_log, n, y.data(), n, 0, 1, scratch.data(), n, 0, 1);
+  lazy.materialize();
+  if (lazy.stats().eliminated != 1) {
+    std::cout << "eliminated " << lazy.stats().eliminated << " scratch calls, expected 1" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int main(void) {
+  if (eliminationTests() && fusionTests() && limitTests() && blasTests()) {
+    std::cout << "Success!" << std::endl;
+    return 0;
+  }
+  std::cout << "Failed!" << std::endl;
+  return 1;
+}
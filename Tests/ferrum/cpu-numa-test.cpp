@@ -0,0 +1,108 @@
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "cpuengine.hpp"
+#include "numa.hpp"
+
+// Checks node-placed resident tensors and node scheduling, using a made-up two node topology
+// so that it runs on any host. Then reports the per-node bandwidth of a memory-bound kernel
+// on the real topology of this host.
+
+static bool close(float x, float y) {
+  return std::fabs(x - y) <= 1e-5f * std::fmax(1.0f, std::fabs(y));
+}
+
+static bool placementTests() {
+  const Ferrum::NumaTopology& host = Ferrum::NumaTopology::host();
+  std::vector<int> cpus = host.cpus();
+  Ferrum::NumaTopology twoNodes({Ferrum::NumaNode{0, cpus}, Ferrum::NumaNode{1, cpus}});
+  Ferrum::CpuEngine engine(4, std::vector<int>(), twoNodes);
+
+  const long n = 1 << 22;
+  float* a = engine.allocate(n, Ferrum::Placement::FIRST_TOUCH);
+  float* r = engine.allocate(n, Ferrum::Placement::FIRST_TOUCH);
+  float* interleaved = engine.allocate(n, Ferrum::Placement::INTERLEAVED);
+  if (a == nullptr || r == nullptr || interleaved == nullptr || a[n - 1] != 0.0f) {
+    std::cout << "allocation failed" << std::endl;
+    return false;
+  }
+  for (long i = 0; i < n; i++) {
+    a[i] = (i % 1000) * 0.001f;
+  }
+
+  engine.vect_bB(Ferrum::FunctionID::vector_exp, n, a, n, 0, 1, r, n, 0, 1);
+  for (long i = 0; i < n; i++) {
+    if (!close(r[i], std::exp(a[i]))) {
+      std::cout << "vector_exp differs at " << i << std::endl;
+      return false;
+    }
+  }
+  // each node owns half of the result, and moved its half of both operands
+  std::vector<Ferrum::NodeStats> stats = engine.nodeStats();
+  uint64_t half = n / 2 * 2 * sizeof(float);
+  if (stats.size() != 2 || stats[0].bytes != half || stats[1].bytes != half) {
+    std::cout << "node stats: " << stats[0].bytes << ", " << stats[1].bytes << " expected " << half << std::endl;
+    return false;
+  }
+
+  // a strided result that starts in the second segment is all on node 1
+  engine.resetNodeStats();
+  engine.vect_bB(Ferrum::FunctionID::vector_sqr, n / 4 - 2, a, n, 0, 1, r, n, n / 2 + 3, 2);
+  stats = engine.nodeStats();
+  if (stats[0].bytes != 0 || stats[1].bytes == 0 || !close(r[n / 2 + 3 + 2 * 100], a[100] * a[100])) {
+    std::cout << "strided result was not scheduled on node 1" << std::endl;
+    return false;
+  }
+
+  // interleaved and ordinary memory are scheduled without regard to nodes
+  engine.resetNodeStats();
+  engine.vect_bB(Ferrum::FunctionID::vector_sqr, n, a, n, 0, 1, interleaved, n, 0, 1);
+  std::vector<float> plain(n);
+  engine.vect_bB(Ferrum::FunctionID::vector_sqr, n, a, n, 0, 1, plain.data(), n, 0, 1);
+  stats = engine.nodeStats();
+  if (stats[0].bytes != 0 || stats[1].bytes != 0 || !close(plain[n - 1], interleaved[n - 1])) {
+    std::cout << "unplaced results were node scheduled" << std::endl;
+    return false;
+  }
+
+  engine.free(a);
+  engine.free(r);
+  engine.free(interleaved);
+  return true;
+}
+
+static void bandwidthReport() {
+  const Ferrum::NumaTopology& host = Ferrum::NumaTopology::host();
+  Ferrum::CpuEngine engine;
+  std::cout << host.nodeCount() << " NUMA node(s), " << engine.threadCount() + 1 << " threads" << std::endl;
+
+  const long n = 1 << 24;
+  float* a = engine.allocate(n);
+  float* r = engine.allocate(n);
+  if (a == nullptr || r == nullptr) {
+    return;
+  }
+  engine.vect_bB(Ferrum::FunctionID::vector_sqr, n, a, n, 0, 1, r, n, 0, 1);
+  engine.resetNodeStats();
+  for (int i = 0; i < 10; i++) {
+    engine.vect_bB(Ferrum::FunctionID::vector_sqr, n, a, n, 0, 1, r, n, 0, 1);
+  }
+  std::vector<Ferrum::NodeStats> stats = engine.nodeStats();
+  for (size_t k = 0; k < stats.size(); k++) {
+    std::cout << "  node " << host.nodes()[k].id << ": " << stats[k].bytes / (1 << 20) << "MB, "
+              << stats[k].gigabytesPerSecond() << " GB/s per thread" << std::endl;
+  }
+  engine.free(a);
+  engine.free(r);
+}
+
+int main(void) {
+  if (!placementTests()) {
+    std::cout << "Failed!" << std::endl;
+    return 1;
+  }
+  bandwidthReport();
+  std::cout << "Success!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,249 @@
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "cpuengine.hpp"
+#include "lazy.hpp"
+#include "split.hpp"
+
+#include "matrix.hpp"
+
+// trttp must lay a triangle out column by column with no gaps, and tpttr must put it back without
+// touching the other triangle, with a vector function squaring the packed elements in between.
+// tpmv and spmv are summed from the full matrix, and sizes up to 1100 span several of the blocks
+// of rows that the host gives each task. Sentinels around the packed array, and NaN in the other
+// triangle and a unit diagonal, show any read or write outside what was given. The benchmark
+// runs spmv on a packed 4096 covariance against gemv on the full one.
+
+static const float NaN = std::numeric_limits<float>::quiet_NaN();
+
+// An sd x sd triangle with NaN in the other triangle, and on the diagonal when unit
+static Matrix triangle(long sd, bool lower, bool unit, int seed) {
+  Matrix a(sd, sd, 2, 3, seed);
+  for (long j = 0; j < sd; j++) {
+    for (long i = 0; i < sd; i++) {
+      if (i == j ? unit : (i > j) != lower) {
+        *a.ref(i, j) = NaN;
+      }
+    }
+  }
+  return a;
+}
+
+static bool inTriangle(bool lower, long i, long j) {
+  return lower ? i >= j : i <= j;
+}
+
+// A packed copy of a triangle, after a few elements that must be kept
+struct Packed {
+  long offset;
+  std::vector<float> data;
+
+  Packed(long sd) : offset(5), data(offset + Ferrum::packedLength(sd) + 2, -7.0f) {}
+
+  long len() const { return static_cast<long>(data.size()); }
+};
+
+static bool close(double x, double y, double tolerance) {
+  return std::fabs(x - y) <= tolerance * (1 + std::fabs(y));
+}
+
+// The triangle goes to packed storage in column order and comes back to its own triangle,
+// with the other triangle of the full matrix and the elements around the packed ones kept
+static bool packs(Ferrum::Backend& engine, long sd, bool lower) {
+  int bottom = lower ? 1 : -1;
+  Matrix a = triangle(sd, lower, false, 1);
+  Packed p(sd);
+  if (engine.trttp(sd, bottom, a.data.data(), a.len(), a.offset, a.ld, p.data.data(), p.len(), p.offset) !=
+      p.data.data()) {
+    return false;
+  }
+  long k = p.offset;
+  for (long j = 0; j < sd; j++) {
+    for (long i = lower ? j : 0; i <= (lower ? sd - 1 : j); i++, k++) {
+      if (p.data[k] != a.at(i, j)) {
+        std::cout << engine.name() << " trttp " << (lower ? "lower " : "upper ") << sd << " is wrong at " << i
+                  << ", " << j << std::endl;
+        return false;
+      }
+    }
+  }
+  if (p.data[p.offset - 1] != -7.0f || p.data[k] != -7.0f) {
+    return false;
+  }
+  // elementwise functions are vector functions over the packed elements
+  engine.vect_bB(Ferrum::FunctionID::vector_sqr, Ferrum::packedLength(sd), p.data.data(), p.len(), p.offset, 1,
+                 p.data.data(), p.len(), p.offset, 1);
+  Matrix b(sd, sd, 1, 2, 2);
+  if (engine.tpttr(sd, bottom, p.data.data(), p.len(), p.offset, b.data.data(), b.len(), b.offset, b.ld) !=
+      b.data.data()) {
+    return false;
+  }
+  Matrix original(sd, sd, 1, 2, 2);
+  for (long j = 0; j < sd; j++) {
+    for (long i = 0; i < sd; i++) {
+      float expected = inTriangle(lower, i, j) ? a.at(i, j) * a.at(i, j) : original.at(i, j);
+      if (b.at(i, j) != expected) {
+        std::cout << engine.name() << " tpttr " << (lower ? "lower " : "upper ") << sd << " is wrong at " << i
+                  << ", " << j << std::endl;
+        return false;
+      }
+    }
+  }
+  return b.data[0] == original.data[0] && b.data.back() == original.data.back();
+}
+
+// x = op(A) * x with a packed A, against the loop over the full triangle
+static bool multiplies(Ferrum::Backend& engine, long sd, bool trans, bool lower, bool unit, long stride) {
+  int bottom = lower ? 1 : -1;
+  Matrix a = triangle(sd, lower, unit, 3);
+  Packed p(sd);
+  engine.trttp(sd, bottom, a.data.data(), a.len(), a.offset, a.ld, p.data.data(), p.len(), p.offset);
+  long incx = stride < 0 ? -stride : stride;
+  std::vector<float> x(sd * incx + 4);
+  for (size_t i = 0; i < x.size(); i++) {
+    x[i] = value(i, 4);
+  }
+  std::vector<float> original = x;
+  long first = Ferrum::firstIndex(2, stride, sd);
+  if (engine.tpmv(trans ? Ferrum::TRANS : Ferrum::NO_TRANS, sd, unit ? Ferrum::UNIT : Ferrum::NON_UNIT, bottom,
+                  p.data.data(), p.len(), p.offset, x.data(), x.size(), 2, stride) != x.data()) {
+    return false;
+  }
+  for (long i = 0; i < sd; i++) {
+    double sum = 0;
+    for (long j = 0; j < sd; j++) {
+      long r = trans ? j : i;
+      long c = trans ? i : j;
+      if (inTriangle(lower, r, c)) {
+        sum += (r == c && unit ? 1.0 : a.at(r, c)) * original[first + j * stride];
+      }
+    }
+    if (!close(x[first + i * stride], sum, 1e-4)) {
+      std::cout << engine.name() << " tpmv " << (trans ? "trans " : "") << (lower ? "lower " : "upper ")
+                << (unit ? "unit " : "") << sd << " stride " << stride << " is wrong at " << i << ": "
+                << x[first + i * stride] << ", expected " << sum << std::endl;
+      return false;
+    }
+  }
+  return x[0] == original[0] && x.back() == original.back();
+}
+
+// y = alpha * A * x + beta * y with the symmetric A given by a packed triangle
+static bool symmetric(Ferrum::Backend& engine, long sd, bool lower, float beta, long stride) {
+  int bottom = lower ? 1 : -1;
+  Matrix a = triangle(sd, lower, false, 5);
+  Packed p(sd);
+  engine.trttp(sd, bottom, a.data.data(), a.len(), a.offset, a.ld, p.data.data(), p.len(), p.offset);
+  std::vector<float> x(sd + 1), y(sd * 2 + 3);
+  for (size_t i = 0; i < x.size(); i++) {
+    x[i] = value(i, 6);
+  }
+  for (size_t i = 0; i < y.size(); i++) {
+    y[i] = beta == 0.0f ? NaN : value(i, 7);
+  }
+  std::vector<float> original = y;
+  long first = Ferrum::firstIndex(1, stride, sd);
+  if (engine.spmv(sd, bottom, 0.5f, p.data.data(), p.len(), p.offset, x.data(), x.size(), 1, 1,
+                  beta, y.data(), y.size(), 1, stride) != y.data()) {
+    return false;
+  }
+  for (long i = 0; i < sd; i++) {
+    double sum = 0;
+    for (long j = 0; j < sd; j++) {
+      sum += (inTriangle(lower, i, j) ? a.at(i, j) : a.at(j, i)) * x[1 + j];
+    }
+    double expected = 0.5 * sum + (beta == 0.0f ? 0.0 : beta * original[first + i * stride]);
+    if (!close(y[first + i * stride], expected, 1e-4)) {
+      std::cout << engine.name() << " spmv " << (lower ? "lower " : "upper ") << sd << " beta " << beta
+                << " is wrong at " << i << ": " << y[first + i * stride] << ", expected " << expected << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool packed(Ferrum::Backend& engine) {
+  const long sizes[] = {1, 37, 300, 1100};
+  for (long sd : sizes) {
+    for (int lower = 0; lower < 2; lower++) {
+      if (!packs(engine, sd, lower) ||
+          !symmetric(engine, sd, lower, 0.0f, 1) || !symmetric(engine, sd, lower, 2.0f, -2)) {
+        return false;
+      }
+      for (int trans = 0; trans < 2; trans++) {
+        for (int unit = 0; unit < 2; unit++) {
+          if (!multiplies(engine, sd, trans, lower, unit, 1) || !multiplies(engine, sd, trans, lower, unit, -3)) {
+            return false;
+          }
+        }
+      }
+    }
+  }
+  return packs(engine, 0, true) && multiplies(engine, 0, false, true, false, 1);
+}
+
+// A packed triangle that runs past its array is reported, as is a bottom of 0
+static bool rejects(Ferrum::Backend& engine) {
+  Matrix a(30, 30, 0, 0, 1);
+  std::vector<float> p(Ferrum::packedLength(30)), x(30);
+  long len = static_cast<long>(p.size());
+  return engine.trttp(30, 1, a.data.data(), a.len(), 0, 30, p.data(), len, 1) == nullptr &&
+         engine.tpttr(31, -1, p.data(), len, 0, a.data.data(), a.len(), 0, 30) == nullptr &&
+         engine.trttp(30, 0, a.data.data(), a.len(), 0, 30, p.data(), len, 0) == nullptr &&
+         engine.tpmv(Ferrum::NO_TRANS, 31, Ferrum::NON_UNIT, 1, p.data(), len, 0, x.data(), 31, 0, 1) == nullptr &&
+         engine.tpmv(Ferrum::NO_TRANS, 30, Ferrum::NON_UNIT, 1, p.data(), len, 0, x.data(), 30, 0, 2) == nullptr &&
+         engine.spmv(30, 0, 1.0f, p.data(), len, 0, x.data(), 30, 0, 1, 0.0f, x.data(), 30, 0, 1) == nullptr;
+}
+
+// A deferred call that writes the packed triangle runs before tpmv reads it
+static bool lazy() {
+  Ferrum::LazyEngine engine(new Ferrum::CpuEngine());
+  long sd = 20;
+  std::vector<float> p(Ferrum::packedLength(sd), -1.0f), x(sd, 1.0f);
+  long len = static_cast<long>(p.size());
+  engine.vect_bB(Ferrum::FunctionID::vector_abs, len, p.data(), len, 0, 1, p.data(), len, 0, 1);
+  // each row of the lower triangle of ones adds up its ones
+  return engine.tpmv(Ferrum::NO_TRANS, sd, Ferrum::NON_UNIT, 1, p.data(), len, 0, x.data(), sd, 0, 1) == x.data() &&
+         x[0] == 1.0f && x[sd - 1] == sd;
+}
+
+// spmv on a packed covariance against gemv on the full matrix, which holds nearly twice the floats
+static void benchmark(Ferrum::Backend& engine) {
+  const long sd = 4096;
+  const int runs = 20;
+  Matrix a(sd, sd, 0, 0, 1);
+  Packed p(sd);
+  engine.trttp(sd, 1, a.data.data(), a.len(), 0, a.ld, p.data.data(), p.len(), p.offset);
+  std::vector<float> x(sd, 1.0f), y(sd);
+  double full = timed([&]() {
+    for (int r = 0; r < runs; r++) {
+      engine.gemv(Ferrum::NO_TRANS, sd, sd, 1.0f, a.data.data(), a.len(), 0, a.ld, x.data(), sd, 0, 1,
+                  0.0f, y.data(), sd, 0, 1);
+    }
+  });
+  double packed = timed([&]() {
+    for (int r = 0; r < runs; r++) {
+      engine.spmv(sd, 1, 1.0f, p.data.data(), p.len(), p.offset, x.data(), sd, 0, 1, 0.0f, y.data(), sd, 0, 1);
+    }
+  });
+  double flops = 2.0 * sd * sd * runs;
+  std::cout << "spmv " << sd << ": " << Ferrum::packedLength(sd) * sizeof(float) / (1 << 20) << " MB packed, "
+            << flops / packed * 1e-9 << " GFLOP/s, gemv on " << sd * sd * sizeof(float) / (1 << 20) << " MB, "
+            << flops / full * 1e-9 << " GFLOP/s" << std::endl;
+}
+
+int main(void) {
+  Ferrum::CpuEngine serial(0);
+  Ferrum::CpuEngine pooled;
+  Ferrum::SplitEngine split({new Ferrum::CpuEngine(2), new Ferrum::CpuEngine(2)}, 1);
+  bool ok = packed(serial) && packed(pooled) && packed(split) && rejects(pooled) && rejects(split) && lazy();
+  if (ok) {
+    benchmark(pooled);
+    std::cout << "Success!" << std::endl;
+    return 0;
+  }
+  std::cout << "Failed!" << std::endl;
+  return 1;
+}
@@ -0,0 +1,128 @@
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "pool.hpp"
+
+// The host buffer pool: requests round up to power-of-two classes, released blocks come back
+// to later requests of their class, blocks past the high-water mark go straight back to the
+// allocator, and trim gives up cached blocks largest first.
+
+static bool expect(bool ok, const char* what) {
+  if (!ok) {
+    std::cout << what << std::endl;
+  }
+  return ok;
+}
+
+static bool counts(const Ferrum::PoolStats& stats, uint64_t hits, uint64_t misses, uint64_t evictions,
+                   size_t resident, size_t inUse) {
+  if (stats.hits == hits && stats.misses == misses && stats.evictions == evictions &&
+      stats.residentBytes == resident && stats.inUseBytes == inUse) {
+    return true;
+  }
+  std::cout << "hits " << stats.hits << ", misses " << stats.misses << ", evictions " << stats.evictions
+            << ", resident " << stats.residentBytes << ", in use " << stats.inUseBytes << "; expected " << hits
+            << ", " << misses << ", " << evictions << ", " << resident << ", " << inUse << std::endl;
+  return false;
+}
+
+static bool classes() {
+  const size_t cases[][3] = {{0, 8, 256}, {1, 8, 256}, {256, 8, 256}, {257, 9, 512},
+                             {3000, 12, 4096}, {4096, 12, 4096}, {(1 << 20) + 1, 21, 1 << 21}};
+  for (const auto& c : cases) {
+    size_t classBytes = 0;
+    int cls = Ferrum::sizeClass(c[0], classBytes);
+    if (cls != static_cast<int>(c[1]) || classBytes != c[2]) {
+      std::cout << c[0] << " bytes went to class " << cls << " of " << classBytes << " bytes" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// A released block is handed out again for any request of its class, but not another class
+static bool reuse() {
+  Ferrum::HostPool pool(Ferrum::HostAllocator(), 1 << 20);
+  Ferrum::HostBlock a = pool.acquire(100);
+  if (!expect(a && a.size == 256 && reinterpret_cast<uintptr_t>(a.data) % Ferrum::HostAllocator::ALIGNMENT == 0,
+              "the first block is not a whole aligned class") ||
+      !counts(pool.stats(), 0, 1, 0, 256, 256)) {
+    return false;
+  }
+  pool.release(a);
+  Ferrum::HostBlock b = pool.acquire(200);
+  Ferrum::HostBlock c = pool.acquire(300);
+  if (!expect(b == a, "a released block was not reused") || !expect(!(c == a), "a block was handed out twice") ||
+      !counts(pool.stats(), 1, 2, 0, 768, 768)) {
+    return false;
+  }
+  pool.release(b);
+  pool.release(c);
+  if (!counts(pool.stats(), 1, 2, 0, 768, 0)) {
+    return false;
+  }
+  Ferrum::HostBlock d = pool.acquire(512);
+  bool ok = expect(d == c, "the larger class was not reused") && counts(pool.stats(), 2, 2, 0, 768, 512);
+  pool.release(d);
+  return ok && expect(pool.stats().hitRate() == 0.5, "the hit rate is not half");
+}
+
+// Free blocks are cached up to the high-water mark, and the rest are freed as they are released
+static bool eviction() {
+  Ferrum::HostPool pool(Ferrum::HostAllocator(), 4096);
+  std::vector<Ferrum::HostBlock> blocks;
+  for (int k = 0; k < 4; k++) {
+    blocks.push_back(pool.acquire(2048));
+  }
+  for (const Ferrum::HostBlock& block : blocks) {
+    pool.release(block);
+  }
+  if (!counts(pool.stats(), 0, 4, 2, 4096, 0)) {
+    return false;
+  }
+  // the two cached blocks serve the next two requests, and the third allocates
+  Ferrum::HostBlock a = pool.acquire(2048);
+  Ferrum::HostBlock b = pool.acquire(2048);
+  Ferrum::HostBlock c = pool.acquire(2048);
+  bool ok = counts(pool.stats(), 2, 5, 2, 6144, 6144);
+  pool.release(a);
+  pool.release(b);
+  pool.release(c);
+  return ok && counts(pool.stats(), 2, 5, 3, 4096, 0);
+}
+
+// trim frees the largest cached blocks first, down to its target, as does lowering the mark
+static bool trimming() {
+  Ferrum::HostPool pool(Ferrum::HostAllocator(), 1 << 20);
+  Ferrum::HostBlock small = pool.acquire(256);
+  Ferrum::HostBlock medium = pool.acquire(1024);
+  Ferrum::HostBlock large = pool.acquire(8192);
+  pool.release(small);
+  pool.release(medium);
+  pool.release(large);
+  pool.trim(2048);
+  if (!counts(pool.stats(), 0, 3, 1, 1280, 0)) {
+    return false;
+  }
+  // the small block is still cached, and the large one has to be allocated again
+  Ferrum::HostBlock again = pool.acquire(200);
+  Ferrum::HostBlock larger = pool.acquire(8000);
+  bool ok = expect(again == small, "trim freed the small block") && counts(pool.stats(), 1, 4, 1, 9472, 8448);
+  pool.release(again);
+  pool.release(larger);
+  pool.setHighWaterMark(1024);
+  ok = ok && counts(pool.stats(), 1, 4, 3, 256, 0) &&
+       expect(pool.stats().highWaterMark == 1024, "the mark was not set");
+  pool.trim();
+  return ok && counts(pool.stats(), 1, 4, 4, 0, 0);
+}
+
+int main(void) {
+  if (classes() && reuse() && eviction() && trimming()) {
+    std::cout << "Success!" << std::endl;
+    return 0;
+  }
+  std::cout << "Failed!" << std::endl;
+  return 1;
+}
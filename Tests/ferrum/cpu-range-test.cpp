@@ -0,0 +1,74 @@
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "coalescer.hpp"
+#include "cpuengine.hpp"
+#include "split.hpp"
+
+// Vector calls compute exactly n elements of larger arrays, leave the rest alone, and are
+// rejected when an array cannot hold n elements.
+
+static bool close(float x, float y) {
+  return std::fabs(x - y) <= 1e-5f * std::fmax(1.0f, std::fabs(y));
+}
+
+static bool rangeTests(Ferrum::Backend& engine, const char* name) {
+  const long len = 1 << 22;
+  std::vector<float> a(len), b(len), r(len, -1.0f);
+  for (long i = 0; i < len; i++) {
+    a[i] = (i % 1000) * 0.001f;
+    b[i] = 1.0f - (i % 777) * 0.001f;
+  }
+
+  // a strided slice from the middle of a, into a slice of r
+  const long n = 3000, offset_a = len / 2 + 1, stride_a = 3, offset = 11;
+  if (engine.vect_bB(Ferrum::FunctionID::vector_exp, n, a.data(), len, offset_a, stride_a,
+                     r.data(), len, offset, 1) == nullptr) {
+    std::cout << name << ": vector_exp failed" << std::endl;
+    return false;
+  }
+  for (long i = 0; i < offset + n + 10; i++) {
+    float expected = i >= offset && i < offset + n ? std::exp(a[offset_a + (i - offset) * stride_a]) : -1.0f;
+    if (!close(r[i], expected)) {
+      std::cout << name << ": vector_exp differs at " << i << std::endl;
+      return false;
+    }
+  }
+
+  // fewer elements than every operand holds
+  std::fill(r.begin(), r.end(), -1.0f);
+  engine.vect_bbB(Ferrum::FunctionID::vector_add, 10, a.data(), len, 0, 2, b.data(), len, 5, 1, r.data(), len, 0, 1);
+  for (long i = 0; i < 20; i++) {
+    float expected = i < 10 ? a[2 * i] + b[5 + i] : -1.0f;
+    if (!close(r[i], expected)) {
+      std::cout << name << ": vector_add differs at " << i << std::endl;
+      return false;
+    }
+  }
+
+  // one element more than the result holds, then an operand that starts past its end
+  if (engine.vect_bB(Ferrum::FunctionID::vector_exp, 101, a.data(), len, 0, 1, r.data(), 100, 0, 1) != nullptr ||
+      engine.vect_bbB(Ferrum::FunctionID::vector_add, 1, a.data(), len, 0, 1, b.data(), len, len, 1,
+                      r.data(), len, 0, 1) != nullptr) {
+    std::cout << name << ": a vector that overruns its array was accepted" << std::endl;
+    return false;
+  }
+  if (r[20] != -1.0f) {
+    std::cout << name << ": a rejected call wrote its result" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int main(void) {
+  Ferrum::CpuEngine engine;
+  Ferrum::SplitEngine split({new Ferrum::CpuEngine(0), new Ferrum::CpuEngine(0)}, 1 << 10);
+  Ferrum::Coalescer coalescer(new Ferrum::CpuEngine(0));
+  if (rangeTests(engine, "cpu") && rangeTests(split, "split") && rangeTests(coalescer, "coalescer")) {
+    std::cout << "Success!" << std::endl;
+    return 0;
+  }
+  std::cout << "Failed!" << std::endl;
+  return 1;
+}
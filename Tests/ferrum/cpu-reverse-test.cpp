@@ -0,0 +1,97 @@
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "coalescer.hpp"
+#include "cpuengine.hpp"
+#include "split.hpp"
+
+// Negative strides, with BLAS semantics: element i of n lies at offset + (n - 1 - i) * |stride|,
+// so the offset is the lowest element touched and the vector runs backwards from the far end.
+
+static bool close(float x, float y) {
+  return std::fabs(x - y) <= 1e-5f * std::fmax(1.0f, std::fabs(y));
+}
+
+// The index of element i of n
+static long at(long offset, long stride, long n, long i) {
+  return stride < 0 ? offset + (n - 1 - i) * -stride : offset + i * stride;
+}
+
+static bool reverseTests(Ferrum::Backend& engine, const char* name) {
+  const long len = 1 << 20;
+  std::vector<float> a(len), b(len), q(len), r(len);
+  for (long i = 0; i < len; i++) {
+    a[i] = (i % 1000) * 0.001f;
+    b[i] = 1.0f - (i % 777) * 0.001f;
+  }
+
+  // every combination of directions, large enough to be split
+  const long n = 100000;
+  for (long sa : {2L, -2L}) {
+    for (long sb : {1L, -3L}) {
+      for (long sr : {1L, -1L, -2L}) {
+        std::fill(r.begin(), r.end(), -1.0f);
+        if (engine.vect_bbB(Ferrum::FunctionID::vector_sub, n, a.data(), len, 7, sa, b.data(), len, 5, sb,
+                            r.data(), len, 3, sr) == nullptr) {
+          std::cout << name << ": vector_sub failed for strides " << sa << ", " << sb << ", " << sr << std::endl;
+          return false;
+        }
+        for (long i = 0; i < n; i++) {
+          float expected = a[at(7, sa, n, i)] - b[at(5, sb, n, i)];
+          if (!close(r[at(3, sr, n, i)], expected)) {
+            std::cout << name << ": vector_sub differs at " << i << " for strides " << sa << ", " << sb << ", "
+                      << sr << std::endl;
+            return false;
+          }
+        }
+        // a strided result leaves its gaps alone
+        if (r[2] != -1.0f || (sr == -2 && r[4] != -1.0f)) {
+          std::cout << name << ": vector_sub wrote outside its result" << std::endl;
+          return false;
+        }
+      }
+    }
+  }
+
+  // a reversed copy of a, with no copy made first
+  const long m = 1000;
+  engine.vect_bB(Ferrum::FunctionID::vector_sqr, m, a.data(), m, 0, -1, r.data(), m, 0, 1);
+  for (long i = 0; i < m; i++) {
+    if (!close(r[i], a[m - 1 - i] * a[m - 1 - i])) {
+      std::cout << name << ": reversed vector_sqr differs at " << i << std::endl;
+      return false;
+    }
+  }
+
+  // both outputs of a pair function run backwards
+  engine.vect_bBB(Ferrum::FunctionID::vector_sincos, m, a.data(), len, 0, 1, q.data(), len, 10, -2,
+                  r.data(), len, 0, -1);
+  for (long i = 0; i < m; i++) {
+    if (!close(q[at(10, -2, m, i)], std::sin(a[i])) || !close(r[at(0, -1, m, i)], std::cos(a[i]))) {
+      std::cout << name << ": reversed vector_sincos differs at " << i << std::endl;
+      return false;
+    }
+  }
+
+  // a backwards vector is still bounded by its array, and a zero stride is rejected
+  if (engine.vect_bB(Ferrum::FunctionID::vector_exp, 11, a.data(), 100, 0, -10, r.data(), len, 0, 1) != nullptr ||
+      engine.vect_bB(Ferrum::FunctionID::vector_exp, 10, a.data(), 100, 0, 0, r.data(), len, 0, 1) != nullptr) {
+    std::cout << name << ": an out of bounds vector was accepted" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int main(void) {
+  Ferrum::CpuEngine engine;
+  Ferrum::SplitEngine split({new Ferrum::CpuEngine(0), new Ferrum::CpuEngine(0)}, 1 << 10);
+  Ferrum::Coalescer coalescer(new Ferrum::CpuEngine(0), Ferrum::Coalescer::DEFAULT_WINDOW_MICROS,
+                              Ferrum::Coalescer::DEFAULT_MAX_BATCH, 1 << 20);
+  if (reverseTests(engine, "cpu") && reverseTests(split, "split") && reverseTests(coalescer, "coalescer")) {
+    std::cout << "Success!" << std::endl;
+    return 0;
+  }
+  std::cout << "Failed!" << std::endl;
+  return 1;
+}
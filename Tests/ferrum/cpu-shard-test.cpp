@@ -0,0 +1,114 @@
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "cpuengine.hpp"
+#include "numa.hpp"
+#include "split.hpp"
+
+// Shards vector and ge calls over one CPU device per NUMA node. The checks use a made-up two
+// node topology so that they run on any host. Then the real nodes of this host are timed
+// against a single engine that spans all of them.
+
+static bool close(float x, float y) {
+  return std::fabs(x - y) <= 1e-5f * std::fmax(1.0f, std::fabs(y));
+}
+
+static bool shardTests() {
+  std::vector<int> cpus = Ferrum::NumaTopology::host().cpus();
+  Ferrum::NumaTopology twoNodes({Ferrum::NumaNode{0, cpus}, Ferrum::NumaNode{1, cpus}});
+  Ferrum::SplitEngine engine(Ferrum::CpuEngine::nodeDevices(twoNodes));
+  if (engine.backendCount() != 2) {
+    std::cout << "expected a device per node" << std::endl;
+    return false;
+  }
+
+  const int n = 1 << 21;
+  std::vector<float> a(n), b(n), r(n);
+  for (int i = 0; i < n; i++) {
+    a[i] = (i % 1000) * 0.001f;
+    b[i] = 1.0f - (i % 777) * 0.001f;
+  }
+  engine.vect_bB(Ferrum::FunctionID::vector_exp, n, a.data(), n, 0, 1, r.data(), n, 0, 1);
+  for (int i = 0; i < n; i++) {
+    if (!close(r[i], std::exp(a[i]))) {
+      std::cout << "vector_exp differs at " << i << std::endl;
+      return false;
+    }
+  }
+  std::vector<double> rates = engine.throughput(Ferrum::FunctionID::vector_exp);
+  if (rates[0] <= 0.0 || rates[1] <= 0.0) {
+    std::cout << "vector_exp was not sharded" << std::endl;
+    return false;
+  }
+
+  // columns are sharded, with leading dimensions larger than the rows and an offset operand
+  const int sd = 1000, fd = 1200, lda = 1024, ldr = 1010;
+  std::fill(r.begin(), r.end(), -1.0f);
+  engine.ge_bbB(Ferrum::FunctionID::ge_add, sd, fd, a.data(), n, 3, lda, b.data(), n, 0, sd, r.data(), n, 0, ldr);
+  for (int j = 0; j < fd; j++) {
+    for (int i = 0; i < ldr; i++) {
+      float expected = i < sd ? a[3 + i + j * lda] + b[i + j * sd] : -1.0f;
+      if (!close(r[i + j * ldr], expected)) {
+        std::cout << "ge_add differs at " << i << ", " << j << std::endl;
+        return false;
+      }
+    }
+  }
+  rates = engine.throughput(Ferrum::FunctionID::ge_add);
+  if (rates[0] <= 0.0 || rates[1] <= 0.0) {
+    std::cout << "ge_add was not sharded" << std::endl;
+    return false;
+  }
+
+  // a matrix that overruns its array is passed whole to a device, which rejects it
+  if (engine.ge_bB(Ferrum::FunctionID::ge_exp, sd, fd, a.data(), n, 0, 4096, r.data(), n, 0, sd) != nullptr) {
+    std::cout << "an oversized matrix was accepted" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+static double time(Ferrum::Backend& engine, Ferrum::FunctionID id, int sd, int fd,
+                   std::vector<float>& a, std::vector<float>& r) {
+  int n = static_cast<int>(a.size());
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 5; i++) {
+    if (fd == 0) {
+      engine.vect_bB(id, n, a.data(), n, 0, 1, r.data(), n, 0, 1);
+    } else {
+      engine.ge_bB(id, sd, fd, a.data(), n, 0, sd, r.data(), n, 0, sd);
+    }
+  }
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / 5;
+}
+
+static void benchmark() {
+  const Ferrum::NumaTopology& host = Ferrum::NumaTopology::host();
+  Ferrum::SplitEngine sharded(Ferrum::CpuEngine::nodeDevices(host));
+  Ferrum::CpuEngine single;
+  std::cout << host.nodeCount() << " node device(s)" << std::endl;
+
+  const int n = 1 << 22;
+  std::vector<float> a(n, 0.5f), r(n);
+  for (int fd : {0, 2048}) {
+    Ferrum::FunctionID id = fd == 0 ? Ferrum::FunctionID::vector_exp : Ferrum::FunctionID::ge_exp;
+    // the first call measures the devices
+    time(sharded, id, n / 2048, fd, a, r);
+    double one = time(single, id, n / 2048, fd, a, r);
+    double all = time(sharded, id, n / 2048, fd, a, r);
+    std::cout << "  " << (fd == 0 ? "vector_exp" : "ge_exp") << ": " << one << "ms single engine, "
+              << all << "ms sharded" << std::endl;
+  }
+}
+
+int main(void) {
+  if (!shardTests()) {
+    std::cout << "Failed!" << std::endl;
+    return 1;
+  }
+  benchmark();
+  std::cout << "Success!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,131 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "cpuengine.hpp"
+#include "split.hpp"
+
+// Splits calls over two CPU "devices" of different speeds, and checks that the results are
+// complete and that the split settles near the ratio of the device speeds.
+
+// A single threaded CPU engine that takes at least a fixed time per element
+class Throttled : public Ferrum::CpuEngine {
+  public:
+    explicit Throttled(double nanosPerElement) : Ferrum::CpuEngine(0), calls(0), nanos(nanosPerElement) {}
+
+    std::atomic<int> calls;
+
+    float* vect_bB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                   float* result, long len, long offset, long stride) override {
+      auto start = std::chrono::steady_clock::now();
+      float* r = Ferrum::CpuEngine::vect_bB(id, n, a, lena, offset_a, stride_a, result, len, offset, stride);
+      pace(start, n);
+      return r;
+    }
+
+    float* vect_bbB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                    const float* b, long lenb, long offset_b, long stride_b,
+                    float* result, long len, long offset, long stride) override {
+      auto start = std::chrono::steady_clock::now();
+      float* r = Ferrum::CpuEngine::vect_bbB(id, n, a, lena, offset_a, stride_a, b, lenb, offset_b, stride_b,
+                                             result, len, offset, stride);
+      pace(start, n);
+      return r;
+    }
+
+  private:
+    double nanos;
+
+    void pace(std::chrono::steady_clock::time_point start, long n) {
+      calls++;
+      std::this_thread::sleep_until(start + std::chrono::nanoseconds(static_cast<long>(n * nanos)));
+    }
+};
+
+static bool close(float x, float y) {
+  return std::fabs(x - y) <= 1e-5f * std::fmax(1.0f, std::fabs(y));
+}
+
+int main(void) {
+  const int n = 1 << 21;
+  std::vector<float> a(n), b(n), r(n), q(n);
+  for (int i = 0; i < n; i++) {
+    a[i] = (i % 1000) * 0.001f;
+    b[i] = 1.0f - (i % 777) * 0.001f;
+  }
+
+  Throttled* fast = new Throttled(2.0);
+  Throttled* slow = new Throttled(8.0);
+  Ferrum::SplitEngine engine({fast, slow});
+  Ferrum::FunctionID sqr = Ferrum::getFunctionID("vector_sqr");
+
+  bool ok = true;
+  for (int call = 0; call < 12 && ok; call++) {
+    std::fill(r.begin(), r.end(), -1.0f);
+    ok = engine.vect_bB(sqr, n, a.data(), n, 0, 1, r.data(), n, 0, 1) != nullptr;
+    for (int i = 0; i < n && ok; i++) {
+      if (!close(r[i], a[i] * a[i])) {
+        std::cout << "vector_sqr differs at " << i << " on call " << call << std::endl;
+        ok = false;
+      }
+    }
+  }
+  // the slow device runs at a quarter of the speed, so it should settle near a fifth of the work
+  std::vector<double> shares = engine.shares(sqr);
+  std::cout << "shares: " << shares[0] << ", " << shares[1] << std::endl;
+  if (ok && (shares[1] < 0.1 || shares[1] > 0.3)) {
+    std::cout << "split did not follow throughput" << std::endl;
+    ok = false;
+  }
+
+  // strided operands are cut at the same element on every operand
+  if (ok) {
+    std::fill(r.begin(), r.end(), -1.0f);
+    engine.vect_bbB(Ferrum::FunctionID::vector_add, (n - 2) / 3 + 1, a.data(), n, 1, 3, b.data(), n, 0, 2, r.data(), n, 0, 1);
+    for (int i = 0; i < n && ok; i++) {
+      float expected = i < (n - 2) / 3 + 1 ? a[1 + 3 * i] + b[2 * i] : -1.0f;
+      if (!close(r[i], expected)) {
+        std::cout << "vector_add differs at " << i << std::endl;
+        ok = false;
+      }
+    }
+  }
+
+  // both outputs of a pair function are split
+  if (ok) {
+    engine.vect_bBB(Ferrum::FunctionID::vector_sincos, n, a.data(), n, 0, 1, q.data(), n, 0, 1, r.data(), n, 0, 1);
+    for (int i = 0; i < n && ok; i++) {
+      if (!close(q[i], std::sin(a[i])) || !close(r[i], std::cos(a[i]))) {
+        std::cout << "vector_sincos differs at " << i << std::endl;
+        ok = false;
+      }
+    }
+  }
+
+  // small calls run whole on the faster device
+  if (ok) {
+    int fastCalls = fast->calls;
+    int slowCalls = slow->calls;
+    engine.vect_bB(sqr, 1000, a.data(), 1000, 0, 1, r.data(), 1000, 0, 1);
+    if (fast->calls != fastCalls + 1 || slow->calls != slowCalls || !close(r[999], a[999] * a[999])) {
+      std::cout << "small call was not sent to the faster device" << std::endl;
+      ok = false;
+    }
+  }
+
+  if (ok) {
+    auto start = std::chrono::steady_clock::now();
+    engine.vect_bB(sqr, n, a.data(), n, 0, 1, r.data(), n, 0, 1);
+    double split = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    fast->vect_bB(sqr, n, a.data(), n, 0, 1, r.data(), n, 0, 1);
+    double alone = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "split: " << split << "ms, faster device alone: " << alone << "ms" << std::endl;
+  }
+
+  std::cout << (ok ? "Success!" : "Failed!") << std::endl;
+  return ok ? 0 : 1;
+}
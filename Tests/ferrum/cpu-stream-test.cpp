@@ -0,0 +1,136 @@
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "cpuengine.hpp"
+#include "stream.hpp"
+
+// Streams functions over files that are read and written a chunk at a time, and over callbacks
+// whose streams are longer than an int can count.
+
+static bool close(float x, float y) {
+  return std::fabs(x - y) <= 1e-5f * std::fmax(1.0f, std::fabs(y));
+}
+
+static const char* A_PATH = "/tmp/ferrum-stream-test.a";
+static const char* B_PATH = "/tmp/ferrum-stream-test.b";
+static const char* OUT_PATH = "/tmp/ferrum-stream-test.out";
+
+static float valueA(long i) { return (i % 1000) * 0.001f; }
+static float valueB(long i) { return 1.0f - (i % 777) * 0.001f; }
+
+static void writeFile(const char* path, long n, float (*value)(long)) {
+  std::vector<float> data(n);
+  for (long i = 0; i < n; i++) {
+    data[i] = value(i);
+  }
+  std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(data.data()), sizeof(float) * n);
+}
+
+static bool fileTests(Ferrum::Streamer& streamer) {
+  // not a multiple of the chunk, so the last chunk is short
+  const long n = 3000001;
+  writeFile(A_PATH, n, valueA);
+  writeFile(B_PATH, n - 5, valueB);
+
+  bool ok = streamer.stream_bB(Ferrum::FunctionID::vector_exp, A_PATH, OUT_PATH);
+  Ferrum::MappedFile* out = Ferrum::MappedFile::openRead(OUT_PATH);
+  if (!ok || out == nullptr || out->size() != n) {
+    std::cout << "vector_exp was not streamed to a file" << std::endl;
+    delete out;
+    return false;
+  }
+  for (long i = 0; i < n && ok; i++) {
+    if (!close(out->data()[i], std::exp(valueA(i)))) {
+      std::cout << "vector_exp differs at " << i << std::endl;
+      ok = false;
+    }
+  }
+  delete out;
+  Ferrum::StreamStats stats = streamer.stats();
+  if (ok && (stats.elements != static_cast<uint64_t>(n) || stats.chunks != 12)) {
+    std::cout << "unexpected counters: " << stats.elements << " elements in " << stats.chunks << " chunks" << std::endl;
+    ok = false;
+  }
+
+  // the stream ends with the shorter input
+  ok = ok && streamer.stream_bbB(Ferrum::FunctionID::vector_add, A_PATH, B_PATH, OUT_PATH);
+  out = ok ? Ferrum::MappedFile::openRead(OUT_PATH) : nullptr;
+  if (out == nullptr || out->size() != n - 5) {
+    std::cout << "vector_add was not streamed to a file" << std::endl;
+    ok = false;
+  }
+  for (long i = 0; ok && i < n - 5; i++) {
+    if (!close(out->data()[i], valueA(i) + valueB(i))) {
+      std::cout << "vector_add differs at " << i << std::endl;
+      ok = false;
+    }
+  }
+  delete out;
+
+  if (ok && streamer.stream_bB(Ferrum::FunctionID::vector_exp, "/tmp/ferrum-stream-test.missing", OUT_PATH)) {
+    std::cout << "a missing file was streamed" << std::endl;
+    ok = false;
+  }
+  std::remove(A_PATH);
+  std::remove(B_PATH);
+  std::remove(OUT_PATH);
+  return ok;
+}
+
+static bool callbackTests(Ferrum::Streamer& streamer) {
+  // more elements than an int can count
+  const long n = (1L << 31) + 1000;
+  Ferrum::Streamer::Source a = [n](float* buffer, long first, long count) {
+    count = std::min(count, n - first);
+    for (long i = 0; i < count; i++) {
+      buffer[i] = valueA(first + i);
+    }
+    return count;
+  };
+  Ferrum::Streamer::Source b = [n](float* buffer, long first, long count) {
+    count = std::min(count, n - first);
+    std::fill(buffer, buffer + count, 2.0f);
+    return count;
+  };
+  long next = 0;
+  bool ordered = true;
+  Ferrum::Streamer::Sink sink = [&](const float* buffer, long first, long count) {
+    ordered = ordered && first == next;
+    next = first + count;
+    // the first and last elements of each chunk, which is enough to catch a lost or shifted chunk
+    return close(buffer[0], valueA(first) * 2.0f) && close(buffer[count - 1], valueA(first + count - 1) * 2.0f);
+  };
+  if (!streamer.stream_bbB(Ferrum::FunctionID::vector_mul, a, b, sink) || !ordered || next != n) {
+    std::cout << "vector_mul was not streamed past 2^31 elements" << std::endl;
+    return false;
+  }
+  Ferrum::StreamStats stats = streamer.stats();
+  std::cout << stats.elements << " elements: " << stats.readSeconds << "s reading, " << stats.computeSeconds
+            << "s computing, " << stats.writeSeconds << "s writing, " << stats.wallSeconds << "s overall" << std::endl;
+
+  // a sink can stop the stream
+  long taken = 0;
+  Ferrum::Streamer::Sink stop = [&](const float*, long, long count) {
+    taken += count;
+    return taken < 4 * (1L << 18);
+  };
+  if (streamer.stream_bB(Ferrum::FunctionID::vector_exp, a, stop) || taken >= n) {
+    std::cout << "the sink did not stop the stream" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int main(void) {
+  Ferrum::CpuEngine engine;
+  Ferrum::Streamer streamer(&engine, 1 << 18);
+  if (fileTests(streamer) && callbackTests(streamer)) {
+    std::cout << "Success!" << std::endl;
+    return 0;
+  }
+  std::cout << "Failed!" << std::endl;
+  return 1;
+}
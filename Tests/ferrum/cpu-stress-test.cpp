@@ -0,0 +1,102 @@
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "cpuengine.hpp"
+
+// Many threads share one engine, each calling a mix of functions on its own arrays.
+// Every result is checked against a scalar reference computed on the calling thread.
+
+static const int THREAD_COUNT = 32;
+static const int ITERATIONS = 200;
+static const int N = 1000;
+
+static bool close(float x, float y) {
+  return std::fabs(x - y) <= 1e-5f * std::fmax(1.0f, std::fabs(y));
+}
+
+static bool worker(Ferrum::Backend* engine, int seed) {
+  const int sd = 24;
+  std::vector<float> a(N), b(N), c(N), d(N);
+  for (int i = 0; i < N; i++) {
+    a[i] = 0.001f * ((i * 7 + seed) % 1000) + 0.01f;
+    b[i] = 0.002f * ((i * 13 + seed) % 500) - 0.5f;
+  }
+  for (int iter = 0; iter < ITERATIONS; iter++) {
+    switch ((iter + seed) % 5) {
+      case 0:
+        if (engine->vect_bbB(Ferrum::FunctionID::vector_add, N, a.data(), N, 0, 1, b.data(), N, 0, 1,
+                             c.data(), N, 0, 1) == nullptr) return false;
+        for (int i = 0; i < N; i++) {
+          if (!close(c[i], a[i] + b[i])) return false;
+        }
+        break;
+      case 1:
+        // every other element of a, into the start of c
+        if (engine->vect_bB(Ferrum::FunctionID::vector_exp, N / 2, a.data(), N, 1, 2,
+                            c.data(), N, 0, 1) == nullptr) return false;
+        for (int i = 0; i < N / 2; i++) {
+          if (!close(c[i], std::exp(a[1 + 2 * i]))) return false;
+        }
+        break;
+      case 2:
+        // 24 x 30 submatrices with a leading dimension of 32
+        if (engine->ge_bbB(Ferrum::FunctionID::ge_mul, sd, 30, a.data(), N, 0, 32, b.data(), N, 0, 32,
+                           c.data(), N, 0, 32) == nullptr) return false;
+        for (int j = 0; j < 30; j++) {
+          for (int i = 0; i < sd; i++) {
+            int k = i + j * 32;
+            if (!close(c[k], a[k] * b[k])) return false;
+          }
+        }
+        break;
+      case 3: {
+        // lower, non-unit: only the triangle is written
+        std::fill(c.begin(), c.end(), -1.0f);
+        if (engine->uplo_bB(Ferrum::FunctionID::uplo_sqr, sd, 131, 1, a.data(), N, 0, sd,
+                            c.data(), N, 0, sd) == nullptr) return false;
+        for (int j = 0; j < sd; j++) {
+          for (int i = 0; i < sd; i++) {
+            int k = i + j * sd;
+            float expected = i >= j ? a[k] * a[k] : -1.0f;
+            if (!close(c[k], expected)) return false;
+          }
+        }
+        break;
+      }
+      case 4:
+        if (engine->vect_bBB(Ferrum::FunctionID::vector_sincos, N, a.data(), N, 0, 1, d.data(), N, 0, 1,
+                             c.data(), N, 0, 1) == nullptr) return false;
+        for (int i = 0; i < N; i++) {
+          if (!close(d[i], std::sin(a[i])) || !close(c[i], std::cos(a[i]))) return false;
+        }
+        break;
+    }
+  }
+  return true;
+}
+
+int main(void) {
+  Ferrum::CpuEngine engine;
+  std::atomic<int> failures(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < THREAD_COUNT; t++) {
+    threads.emplace_back([&engine, &failures, t]() {
+      if (!worker(&engine, t)) {
+        failures++;
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  if (failures == 0) {
+    std::cout << "Success!" << std::endl;
+    return 0;
+  }
+  std::cout << "Failed! " << failures << " of " << THREAD_COUNT << " threads saw bad results" << std::endl;
+  return 1;
+}
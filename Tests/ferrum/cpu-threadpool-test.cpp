@@ -0,0 +1,148 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "cpuengine.hpp"
+#include "threadpool.hpp"
+
+// Checks that parallelFor visits every index exactly once, including from many callers and
+// from inside another loop, then that split engine calls match a scalar reference.
+// Timings for a cheap and an expensive kernel are printed, but are not checked.
+
+static bool covers(Ferrum::ThreadPool& pool, long n, long grain) {
+  std::vector<std::atomic<int>> hits(n);
+  for (auto& hit : hits) {
+    hit = 0;
+  }
+  pool.parallelFor(n, grain, [&](long begin, long end) {
+    if (end - begin > grain) {
+      hits[begin] += 100;  // pieces must never be larger than the grain
+    }
+    for (long i = begin; i < end; i++) {
+      hits[i]++;
+    }
+  });
+  for (auto& hit : hits) {
+    if (hit != 1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool poolTests() {
+  Ferrum::ThreadPool pool(4);
+  if (!covers(pool, 1, 1) || !covers(pool, 100, 1000) || !covers(pool, 100000, 7) ||
+      !covers(pool, 1000000, 4096)) {
+    std::cout << "parallelFor coverage failed" << std::endl;
+    return false;
+  }
+
+  // concurrent callers
+  std::atomic<int> failures(0);
+  std::vector<std::thread> callers;
+  for (int t = 0; t < 8; t++) {
+    callers.emplace_back([&pool, &failures, t]() {
+      for (int i = 0; i < 20; i++) {
+        if (!covers(pool, 10000 + t * 101 + i, 64 + t)) {
+          failures++;
+        }
+      }
+    });
+  }
+  for (std::thread& caller : callers) {
+    caller.join();
+  }
+
+  // nested loops
+  std::atomic<long> total(0);
+  pool.parallelFor(64, 1, [&](long begin, long end) {
+    for (long i = begin; i < end; i++) {
+      pool.parallelFor(1000, 10, [&](long b, long e) { total += e - b; });
+    }
+  });
+  if (failures != 0 || total != 64000) {
+    std::cout << "concurrent or nested parallelFor failed" << std::endl;
+    return false;
+  }
+
+  // a pool with no workers runs everything on the caller
+  Ferrum::ThreadPool inlinePool(0);
+  return covers(inlinePool, 50000, 100);
+}
+
+static bool close(float x, float y) {
+  return std::fabs(x - y) <= 1e-4f * std::fmax(1.0f, std::fabs(y));
+}
+
+static double time(Ferrum::CpuEngine& engine, Ferrum::FunctionID id, std::vector<float>& a, std::vector<float>& r) {
+  int n = static_cast<int>(a.size());
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 5; i++) {
+    engine.vect_bB(id, n, a.data(), n, 0, 1, r.data(), n, 0, 1);
+  }
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / 5;
+}
+
+static bool engineTests() {
+  const int n = 1 << 21;
+  std::vector<float> a(n), b(n), r(n);
+  for (int i = 0; i < n; i++) {
+    a[i] = 0.5f + (i % 1000) * 0.01f;
+    b[i] = 1.0f - (i % 777) * 0.001f;
+  }
+
+  Ferrum::CpuEngine engine(4);
+  engine.vect_bB(Ferrum::FunctionID::vector_lgamma, n, a.data(), n, 0, 1, r.data(), n, 0, 1);
+  for (int i = 0; i < n; i++) {
+    if (!close(r[i], std::lgamma(a[i]))) {
+      std::cout << "vector_lgamma differs at " << i << std::endl;
+      return false;
+    }
+  }
+  // odd strides, so pieces start partway through each operand
+  engine.vect_bbB(Ferrum::FunctionID::vector_add, (n - 2) / 3 + 1, a.data(), n, 1, 3, b.data(), n, 0, 2, r.data(), n, 0, 1);
+  for (int i = 0; i < n / 3; i++) {
+    if (!close(r[i], a[1 + 3 * i] + b[2 * i])) {
+      std::cout << "vector_add differs at " << i << std::endl;
+      return false;
+    }
+  }
+  const int sd = 1000;
+  std::fill(r.begin(), r.end(), -1.0f);
+  engine.uplo_bB(Ferrum::FunctionID::uplo_exp, sd, 131, -1, a.data(), n, 0, sd + 24, r.data(), n, 0, sd + 24);
+  for (int j = 0; j < sd; j++) {
+    for (int i = 0; i < sd + 24; i++) {
+      int k = i + j * (sd + 24);
+      float expected = (i <= j) ? std::exp(a[k]) : -1.0f;
+      if (!close(r[k], expected)) {
+        std::cout << "uplo_exp differs at " << i << ", " << j << std::endl;
+        return false;
+      }
+    }
+  }
+
+  Ferrum::CpuEngine serial(0);
+  Ferrum::CpuEngine parallel;
+  std::cout << "threads: " << parallel.threadCount() + 1 << std::endl;
+  for (const char* name : {"vector_sqr", "vector_lgamma"}) {
+    Ferrum::FunctionID id = Ferrum::getFunctionID(name);
+    double one = time(serial, id, a, r);
+    double all = time(parallel, id, a, r);
+    std::cout << "  " << name << ": " << one << "ms serial, " << all << "ms parallel ("
+              << one / all << "x)" << std::endl;
+  }
+  return true;
+}
+
+int main(void) {
+  if (poolTests() && engineTests()) {
+    std::cout << "Success!" << std::endl;
+    return 0;
+  }
+  std::cout << "Failed!" << std::endl;
+  return 1;
+}
@@ -0,0 +1,103 @@
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include "cpuengine.hpp"
+
+#include "matrix.hpp"
+
+// ge_add and the paired ge_sincos on views whose shapes reach each path of CpuEngine::ge: a
+// contiguous matrix run as one vector, a single column, a few columns of 2^18 rows that are cut
+// into blocks of rows, and thousands of columns of 3 rows that are grouped into wide tiles. Each
+// operand gets its own offset and leading dimension, and the padding of the result must come
+// back unchanged. The benchmark times a million columns of 4 rows, and two padded columns of 4M
+// rows, against a kernel call per column.
+
+// Whether r holds f of a (and b) in its view and its own values outside it
+static bool matches(const Matrix& r, const Matrix& before, const std::function<float(long i, long j)>& f) {
+  for (long k = 0; k < r.len(); k++) {
+    long p = k - r.offset;
+    long i = p < 0 ? -1 : p % r.ld;
+    long j = p < 0 ? -1 : p / r.ld;
+    bool inside = p >= 0 && i < r.rows && j < r.cols;
+    float expected = inside ? f(i, j) : before.data[k];
+    if (std::fabs(r.data[k] - expected) > 1e-6f * (1 + std::fabs(expected))) {
+      std::cout << "wrong at " << i << ", " << j << ": " << r.data[k] << ", expected " << expected << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool shape(Ferrum::Backend& engine, long sd, long fd, long padA, long padB, long padR) {
+  Matrix a(sd, fd, 1, padA, 1), b(sd, fd, 0, padB, 2), r(sd, fd, 3, padR, 3), before = r;
+  engine.ge_bbB(Ferrum::FunctionID::ge_add, sd, fd, a.data.data(), a.len(), a.offset, a.ld,
+                b.data.data(), b.len(), b.offset, b.ld, r.data.data(), r.len(), r.offset, r.ld);
+  if (!matches(r, before, [&](long i, long j) { return a.at(i, j) + b.at(i, j); })) {
+    std::cout << "ge_add " << sd << " x " << fd << " with padding " << padA << ", " << padB << ", " << padR
+              << std::endl;
+    return false;
+  }
+  // a PAIR kernel writes two results
+  Matrix q(sd, fd, 2, padB, 4), qBefore = q;
+  r = before;
+  engine.ge_bBB(Ferrum::FunctionID::ge_sincos, sd, fd, a.data.data(), a.len(), a.offset, a.ld,
+                q.data.data(), q.len(), q.offset, q.ld, r.data.data(), r.len(), r.offset, r.ld);
+  if (!matches(q, qBefore, [&](long i, long j) { return std::sin(a.at(i, j)); }) ||
+      !matches(r, before, [&](long i, long j) { return std::cos(a.at(i, j)); })) {
+    std::cout << "ge_sincos " << sd << " x " << fd << " with padding " << padA << ", " << padB << ", " << padR
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+static bool tiles(Ferrum::Backend& engine) {
+  const long shapes[][2] = {{1, 1}, {3, 40000}, {37, 3001}, {1 << 18, 3}, {100000, 1}, {513, 513}};
+  for (const auto& s : shapes) {
+    // contiguous, all padded alike, and each operand with its own leading dimension
+    if (!shape(engine, s[0], s[1], 0, 0, 0) || !shape(engine, s[0], s[1], 5, 5, 5) ||
+        !shape(engine, s[0], s[1], 0, 9, 2)) {
+      return false;
+    }
+  }
+  return shape(engine, 0, 5, 0, 0, 0) && shape(engine, 5, 0, 1, 1, 1);
+}
+
+// A contiguous matrix of short columns, and a few tall columns of a view, each against the loop
+// that calls the kernel a column at a time on the calling thread
+static void benchmark(Ferrum::Backend& engine) {
+  const long shapes[][3] = {{4, 1 << 20, 0}, {1 << 22, 2, 16}};
+  const Ferrum::CpuKernel& kernel = Ferrum::cpuKernel(Ferrum::FunctionID::ge_add);
+  for (const auto& s : shapes) {
+    long sd = s[0], fd = s[1];
+    Matrix a(sd, fd, 0, s[2], 1), b(sd, fd, 0, s[2], 2), r(sd, fd, 0, s[2], 3);
+    double loop = timed([&]() {
+      for (long j = 0; j < fd; j++) {
+        Ferrum::Run run{a.data.data() + j * a.ld, 1, b.data.data() + j * b.ld, 1, nullptr, 0,
+                        r.data.data() + j * r.ld, 1};
+        kernel.apply(run, sd, {0, 0, 0, 0});
+      }
+    });
+    double tiled = timed([&]() {
+      engine.ge_bbB(Ferrum::FunctionID::ge_add, sd, fd, a.data.data(), a.len(), 0, a.ld,
+                    b.data.data(), b.len(), 0, b.ld, r.data.data(), r.len(), 0, r.ld);
+    });
+    double bytes = 3.0 * sizeof(float) * sd * fd;
+    std::cout << "ge_add " << sd << " x " << fd << " ld " << a.ld << ": column loop " << bytes / loop * 1e-9
+              << " GB/s, tiled " << bytes / tiled * 1e-9 << " GB/s" << std::endl;
+  }
+}
+
+int main(void) {
+  Ferrum::CpuEngine serial(0);
+  Ferrum::CpuEngine pooled;
+  if (tiles(serial) && tiles(pooled)) {
+    benchmark(pooled);
+    std::cout << "Success!" << std::endl;
+    return 0;
+  }
+  std::cout << "Failed!" << std::endl;
+  return 1;
+}
@@ -0,0 +1,123 @@
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include "cpuengine.hpp"
+#include "lazy.hpp"
+#include "split.hpp"
+
+#include "matrix.hpp"
+
+// omatcopy with and without the transpose, on shapes that end part way through a 4 x 4 vector
+// block and a 32 x 32 block, and on long thin matrices either way round. A and B have different
+// padding, alpha is 1 (a plain copy) and -2, and the padding of B must come back unchanged. A row
+// major matrix read in with TRANS must come out column major. The benchmark times a 4096 square
+// transpose against the loop that writes B down its columns.
+
+static bool check(Ferrum::Backend& engine, bool trans, long m, long n, float alpha, long padA, long padB) {
+  Matrix a(m, n, 3, padA, 1);
+  Matrix b(trans ? n : m, trans ? m : n, 2, padB, 2), before = b;
+  if (engine.omatcopy(trans ? Ferrum::TRANS : Ferrum::NO_TRANS, m, n, alpha, a.data.data(), a.len(), a.offset, a.ld,
+                      b.data.data(), b.len(), b.offset, b.ld) != b.data.data()) {
+    return false;
+  }
+  for (long k = 0; k < b.len(); k++) {
+    long p = k - b.offset;
+    long i = p < 0 ? -1 : p % b.ld;
+    long j = p < 0 ? -1 : p / b.ld;
+    bool inside = p >= 0 && i < b.rows && j < b.cols;
+    float expected = !inside ? before.data[k] : alpha * (trans ? a.at(j, i) : a.at(i, j));
+    if (b.data[k] != expected) {
+      std::cout << engine.name() << " omatcopy " << (trans ? "trans " : "") << m << " x " << n << " alpha " << alpha
+                << " is wrong at " << i << ", " << j << ": " << b.data[k] << ", expected " << expected << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// A row major m x n matrix is a column major n x m one, so its transpose is the column major matrix
+static bool rowMajor(Ferrum::Backend& engine) {
+  const long m = 70, n = 45;
+  std::vector<float> rows(m * n), cols(m * n);
+  for (long i = 0; i < m; i++) {
+    for (long j = 0; j < n; j++) {
+      rows[i * n + j] = static_cast<float>(i * 1000 + j);
+    }
+  }
+  engine.omatcopy(Ferrum::TRANS, n, m, 1.0f, rows.data(), m * n, 0, n, cols.data(), m * n, 0, m);
+  for (long i = 0; i < m; i++) {
+    for (long j = 0; j < n; j++) {
+      if (cols[i + j * m] != rows[i * n + j]) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static bool copies(Ferrum::Backend& engine) {
+  const long shapes[][2] = {{1, 1}, {4, 4}, {3, 5}, {37, 29}, {64, 96}, {257, 130}, {1000, 3}, {2, 3000}};
+  for (const auto& s : shapes) {
+    for (int trans = 0; trans < 2; trans++) {
+      if (!check(engine, trans, s[0], s[1], 1.0f, 0, 0) || !check(engine, trans, s[0], s[1], -2.0f, 7, 1) ||
+          !check(engine, trans, s[0], s[1], 1.0f, 1, 13)) {
+        return false;
+      }
+    }
+  }
+  return check(engine, true, 0, 5, 1.0f, 0, 0) && check(engine, false, 5, 0, 1.0f, 0, 0) && rowMajor(engine);
+}
+
+// B that cannot hold op(A) is reported, as is an unknown transpose
+static bool rejects(Ferrum::Backend& engine) {
+  Matrix a(30, 20, 0, 0, 1), b(20, 29, 0, 0, 2);
+  return engine.omatcopy(Ferrum::NO_TRANS, 30, 20, 1.0f, a.data.data(), a.len(), 0, 30, b.data.data(), b.len(), 0, 30) ==
+             nullptr &&
+         engine.omatcopy(Ferrum::TRANS, 30, 20, 1.0f, a.data.data(), a.len(), 0, 30, b.data.data(), b.len(), 1, 20) ==
+             nullptr &&
+         engine.omatcopy(0, 30, 20, 1.0f, a.data.data(), a.len(), 0, 30, b.data.data(), b.len(), 0, 20) == nullptr;
+}
+
+// A deferred call that writes A runs before the copy reads it
+static bool lazy() {
+  Ferrum::LazyEngine engine(new Ferrum::CpuEngine());
+  std::vector<float> a(12, -3.0f), b(12);
+  engine.vect_bB(Ferrum::FunctionID::vector_abs, 12, a.data(), 12, 0, 1, a.data(), 12, 0, 1);
+  return engine.omatcopy(Ferrum::TRANS, 3, 4, 1.0f, a.data(), 12, 0, 3, b.data(), 12, 0, 4) == b.data() &&
+         b[0] == 3.0f && b[11] == 3.0f;
+}
+
+// The blocked transpose against the loop that writes B down its columns
+static void benchmark(Ferrum::Backend& engine) {
+  const long n = 4096;
+  Matrix a(n, n, 0, 0, 1), b(n, n, 0, 0, 2);
+  double loop = timed([&]() {
+    for (long j = 0; j < n; j++) {
+      for (long i = 0; i < n; i++) {
+        b.data[i + j * n] = a.data[j + i * n];
+      }
+    }
+  });
+  double blocked = timed([&]() {
+    engine.omatcopy(Ferrum::TRANS, n, n, 1.0f, a.data.data(), a.len(), 0, n, b.data.data(), b.len(), 0, n);
+  });
+  double bytes = 2.0 * sizeof(float) * n * n;
+  std::cout << "transpose " << n << ": loop " << bytes / loop * 1e-9 << " GB/s, blocked " << bytes / blocked * 1e-9
+            << " GB/s" << std::endl;
+}
+
+int main(void) {
+  Ferrum::CpuEngine serial(0);
+  Ferrum::CpuEngine pooled;
+  Ferrum::SplitEngine split({new Ferrum::CpuEngine(2), new Ferrum::CpuEngine(2)}, 1);
+  bool ok = copies(serial) && copies(pooled) && copies(split) && rejects(pooled) && rejects(split) && lazy();
+  if (ok) {
+    benchmark(pooled);
+    std::cout << "Success!" << std::endl;
+    return 0;
+  }
+  std::cout << "Failed!" << std::endl;
+  return 1;
+}
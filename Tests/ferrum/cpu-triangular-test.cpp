@@ -0,0 +1,307 @@
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "cpuengine.hpp"
+#include "lazy.hpp"
+#include "split.hpp"
+
+#include "matrix.hpp"
+
+// Each of the eight transpose, triangle and diagonal flags for trmv and trmm, whose products are
+// summed from the full matrix the triangle stands for, then trsv and trsm, which must give back
+// what the product was taken from. The triangle that is not given, and a unit diagonal, hold NaN
+// so that reading them shows. Sizes of 128 and 300 cross the blocks that the host works on the
+// diagonal. syrk must leave the other triangle of C alone. The benchmark solves with a Cholesky
+// factor for 256 right hand sides, against substitution down each column.
+
+static const float NaN = std::numeric_limits<float>::quiet_NaN();
+
+// An sd x sd triangle that is well conditioned to solve: a diagonal between 1 and 2 and small
+// elements beside it. The diagonal is NaN when unit, as is the other triangle.
+struct Triangle : Matrix {
+  bool lower, unit;
+
+  Triangle(long sd, bool lower, bool unit, int seed) : Matrix(sd, sd, 2, 3, seed), lower(lower), unit(unit) {
+    for (long j = 0; j < sd; j++) {
+      for (long i = 0; i < sd; i++) {
+        float& x = *ref(i, j);
+        if (i == j) {
+          x = unit ? NaN : 1.5f + x / 2;
+        } else if ((i > j) == lower) {
+          x /= sd;
+        } else {
+          x = NaN;
+        }
+      }
+    }
+  }
+
+  // element (i, j) of op(A), as the full matrix
+  double op(bool trans, long i, long j) const {
+    if (trans) {
+      std::swap(i, j);
+    }
+    if (i == j) {
+      return unit ? 1.0 : at(i, i);
+    }
+    return (i > j) == lower ? at(i, j) : 0.0;
+  }
+
+  int bottom() const { return lower ? 1 : -1; }
+  int diagonal() const { return unit ? Ferrum::UNIT : Ferrum::NON_UNIT; }
+};
+
+static bool same(const std::vector<float>& x, const std::vector<float>& y, double tolerance) {
+  for (size_t i = 0; i < x.size(); i++) {
+    bool bothNaN = std::isnan(x[i]) && std::isnan(y[i]);
+    if (!bothNaN && !(std::fabs(x[i] - y[i]) <= tolerance * (1 + std::fabs(y[i])))) {
+      std::cout << "element " << i << ": " << x[i] << ", expected " << y[i] << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+static const char* describe(bool trans, bool lower, bool unit) {
+  static const char* names[] = {"N lower", "N lower unit", "N upper", "N upper unit",
+                                "T lower", "T lower unit", "T upper", "T upper unit"};
+  return names[trans * 4 + !lower * 2 + unit];
+}
+
+// x = op(A) * x and its solve, on a strided vector
+static bool vectors(Ferrum::Backend& engine, long sd, long stride, bool trans, bool lower, bool unit) {
+  Triangle a(sd, lower, unit, 1);
+  long offset = 1;
+  std::vector<float> x(offset + (sd - 1) * std::labs(stride) + 3);
+  for (size_t i = 0; i < x.size(); i++) {
+    x[i] = value(i, 2);
+  }
+  long first = Ferrum::firstIndex(offset, stride, sd);
+  std::vector<float> product = x;
+  for (long i = 0; i < sd; i++) {
+    double sum = 0;
+    for (long p = 0; p < sd; p++) {
+      sum += a.op(trans, i, p) * x[first + p * stride];
+    }
+    product[first + i * stride] = static_cast<float>(sum);
+  }
+  int t = trans ? Ferrum::TRANS : Ferrum::NO_TRANS;
+  std::vector<float> y = x;
+  float* result = engine.trmv(t, sd, a.diagonal(), a.bottom(), a.data.data(), a.len(), a.offset, a.ld,
+                              y.data(), static_cast<long>(y.size()), offset, stride);
+  if (result != y.data() || !same(y, product, 1e-5)) {
+    std::cout << engine.name() << " trmv " << describe(trans, lower, unit) << " " << sd << " with stride "
+              << stride << " is wrong" << std::endl;
+    return false;
+  }
+  // solving the product gives x back
+  result = engine.trsv(t, sd, a.diagonal(), a.bottom(), a.data.data(), a.len(), a.offset, a.ld,
+                       y.data(), static_cast<long>(y.size()), offset, stride);
+  if (result != y.data() || !same(y, x, 1e-4)) {
+    std::cout << engine.name() << " trsv " << describe(trans, lower, unit) << " " << sd << " with stride "
+              << stride << " is wrong" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// B = alpha * op(A) * B or alpha * B * op(A), and the solve that undoes it
+static bool matrices(Ferrum::Backend& engine, bool left, long m, long n, bool trans, bool lower, bool unit,
+                     float alpha) {
+  long sd = left ? m : n;
+  Triangle a(sd, lower, unit, 3);
+  Matrix x(m, n, 4, 2, 4);
+  Matrix product = x;
+  for (long j = 0; j < n; j++) {
+    for (long i = 0; i < m; i++) {
+      double sum = 0;
+      for (long p = 0; p < sd; p++) {
+        sum += left ? a.op(trans, i, p) * x.at(p, j) : x.at(i, p) * a.op(trans, p, j);
+      }
+      *product.ref(i, j) = static_cast<float>(alpha * sum);
+    }
+  }
+  int s = left ? Ferrum::LEFT : Ferrum::RIGHT;
+  int t = trans ? Ferrum::TRANS : Ferrum::NO_TRANS;
+  Matrix b = x;
+  float* result = engine.trmm(s, t, m, n, a.diagonal(), a.bottom(), alpha, a.data.data(), a.len(), a.offset,
+                              a.ld, b.data.data(), b.len(), b.offset, b.ld);
+  if (result != b.data.data() || !same(b.data, product.data, 1e-5)) {
+    std::cout << engine.name() << " trmm " << (left ? "left " : "right ") << describe(trans, lower, unit) << " "
+              << m << " x " << n << " is wrong" << std::endl;
+    return false;
+  }
+  // B is now alpha * op(A) * X, so solving against alpha * B / alpha^2 gives X back
+  for (long j = 0; j < n; j++) {
+    for (long i = 0; i < m; i++) {
+      *b.ref(i, j) /= alpha * alpha;
+    }
+  }
+  result = engine.trsm(s, t, m, n, a.diagonal(), a.bottom(), alpha, a.data.data(), a.len(), a.offset, a.ld,
+                       b.data.data(), b.len(), b.offset, b.ld);
+  for (long j = 0; j < n; j++) {
+    for (long i = 0; i < m; i++) {
+      *product.ref(i, j) = x.at(i, j);
+    }
+  }
+  if (result != b.data.data() || !same(b.data, product.data, 1e-4)) {
+    std::cout << engine.name() << " trsm " << (left ? "left " : "right ") << describe(trans, lower, unit) << " "
+              << m << " x " << n << " is wrong" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Only the triangle of C changes, and C is not read when beta is 0
+static bool syrk(Ferrum::Backend& engine, bool trans, long n, long k, bool lower, float alpha, float beta) {
+  Matrix a(trans ? k : n, trans ? n : k, 1, 2, 5);
+  Matrix c(n, n, 3, 1, 6);
+  auto inTriangle = [&](long i, long j) { return lower ? i >= j : i <= j; };
+  if (beta == 0.0f) {
+    for (long j = 0; j < n; j++) {
+      for (long i = 0; i < n; i++) {
+        if (inTriangle(i, j)) {
+          *c.ref(i, j) = NaN;
+        }
+      }
+    }
+  }
+  Matrix expected = c;
+  for (long j = 0; j < n; j++) {
+    for (long i = 0; i < n; i++) {
+      if (!inTriangle(i, j)) {
+        continue;
+      }
+      double sum = 0;
+      for (long p = 0; p < k; p++) {
+        sum += static_cast<double>(trans ? a.at(p, i) : a.at(i, p)) * (trans ? a.at(p, j) : a.at(j, p));
+      }
+      *expected.ref(i, j) = static_cast<float>(alpha * sum + (beta == 0.0f ? 0.0 : beta * c.at(i, j)));
+    }
+  }
+  float* result = engine.syrk(trans ? Ferrum::TRANS : Ferrum::NO_TRANS, n, k, lower ? 1 : -1, alpha,
+                              a.data.data(), a.len(), a.offset, a.ld, beta, c.data.data(), c.len(), c.offset, c.ld);
+  if (result != c.data.data() || !same(c.data, expected.data, 1e-5 * (k + 1))) {
+    std::cout << engine.name() << " syrk " << (trans ? "T " : "N ") << (lower ? "lower " : "upper ") << n << " x "
+              << k << " is wrong" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+static bool functions(Ferrum::Backend& engine) {
+  // single elements, one diagonal block, and several blocks with a partial one
+  const long sizes[] = {1, 37, 128, 300};
+  const long shapes[][2] = {{300, 37}, {45, 260}, {1, 9}, {37, 1}};
+  for (int flags = 0; flags < 8; flags++) {
+    bool trans = flags & 1, lower = flags & 2, unit = flags & 4;
+    for (long sd : sizes) {
+      if (!vectors(engine, sd, 1, trans, lower, unit) || !vectors(engine, sd, -3, trans, lower, unit)) {
+        return false;
+      }
+    }
+    for (const auto& shape : shapes) {
+      for (int left = 0; left < 2; left++) {
+        if (!matrices(engine, left, shape[0], shape[1], trans, lower, unit, left ? 1.0f : -0.5f)) {
+          return false;
+        }
+      }
+    }
+  }
+  for (int flags = 0; flags < 4; flags++) {
+    bool trans = flags & 1, lower = flags & 2;
+    if (!syrk(engine, trans, 300, 45, lower, 1.5f, 0.5f) || !syrk(engine, trans, 37, 260, lower, -1.0f, 0.0f)) {
+      return false;
+    }
+  }
+  return syrk(engine, false, 20, 0, true, 1.0f, 2.0f);
+}
+
+static bool rejects(Ferrum::Backend& engine) {
+  Matrix a(10, 10, 0, 0, 1), b(10, 10, 0, 0, 2);
+  float* ad = a.data.data();
+  float* bd = b.data.data();
+  return engine.trmv(Ferrum::NO_TRANS, 10, Ferrum::NON_UNIT, 0, ad, a.len(), 0, 10, bd, 10, 0, 1) == nullptr &&
+         engine.trsv(113, 10, Ferrum::NON_UNIT, 1, ad, a.len(), 0, 10, bd, 10, 0, 1) == nullptr &&
+         engine.trsv(Ferrum::TRANS, 10, Ferrum::NON_UNIT, 1, ad, a.len(), 0, 10, bd, 10, 0, 2) == nullptr &&
+         engine.trmm(143, Ferrum::NO_TRANS, 10, 10, Ferrum::UNIT, -1, 1.0f, ad, a.len(), 0, 10,
+                     bd, b.len(), 0, 10) == nullptr &&
+         engine.trsm(Ferrum::RIGHT, Ferrum::NO_TRANS, 10, 11, Ferrum::UNIT, -1, 1.0f, ad, a.len(), 0, 10,
+                     bd, b.len(), 0, 10) == nullptr &&
+         engine.syrk(Ferrum::NO_TRANS, 10, 10, 1, 1.0f, ad, a.len(), 1, 10, 0.0f, bd, b.len(), 0, 10) == nullptr &&
+         engine.syrk(Ferrum::TRANS, 10, 10, 0, 1.0f, ad, a.len(), 0, 10, 0.0f, bd, b.len(), 0, 10) == nullptr;
+}
+
+// A deferred call that writes x runs before the solve reads it
+static bool lazy() {
+  Ferrum::LazyEngine engine(new Ferrum::CpuEngine());
+  Triangle a(30, true, false, 1);
+  std::vector<float> source(30), x(30);
+  for (long i = 0; i < 30; i++) {
+    source[i] = -value(i, 2);
+  }
+  engine.vect_bB(Ferrum::FunctionID::vector_abs, 30, source.data(), 30, 0, 1, x.data(), 30, 0, 1);
+  engine.trsv(Ferrum::NO_TRANS, 30, Ferrum::NON_UNIT, 1, a.data.data(), a.len(), a.offset, a.ld, x.data(), 30, 0, 1);
+  std::vector<float> product(30);
+  for (long i = 0; i < 30; i++) {
+    double sum = 0;
+    for (long p = 0; p <= i; p++) {
+      sum += a.op(false, i, p) * x[p];
+    }
+    product[i] = static_cast<float>(sum);
+    source[i] = std::fabs(source[i]);
+  }
+  return same(product, source, 1e-5);
+}
+
+// Solving L * L^T * X = B for many right hand sides, as a Gaussian process does with its Cholesky
+// factor, against forward and back substitution down the columns of B
+static void benchmark(Ferrum::Backend& engine) {
+  const long n = 1024, rhs = 256;
+  Triangle l(n, true, false, 1);
+  Matrix b(n, rhs, 0, 0, 2), naive = b;
+  double loop = timed([&]() {
+    for (long c = 0; c < rhs; c++) {
+      float* x = naive.ref(0, c);
+      for (long j = 0; j < n; j++) {
+        x[j] /= l.at(j, j);
+        for (long i = j + 1; i < n; i++) {
+          x[i] -= l.at(i, j) * x[j];
+        }
+      }
+      for (long j = n - 1; j >= 0; j--) {
+        float sum = x[j];
+        for (long i = j + 1; i < n; i++) {
+          sum -= l.at(i, j) * x[i];
+        }
+        x[j] = sum / l.at(j, j);
+      }
+    }
+  });
+  double blocked = timed([&]() {
+    engine.trsm(Ferrum::LEFT, Ferrum::NO_TRANS, n, rhs, Ferrum::NON_UNIT, 1, 1.0f, l.data.data(), l.len(), l.offset,
+                l.ld, b.data.data(), b.len(), 0, n);
+    engine.trsm(Ferrum::LEFT, Ferrum::TRANS, n, rhs, Ferrum::NON_UNIT, 1, 1.0f, l.data.data(), l.len(), l.offset,
+                l.ld, b.data.data(), b.len(), 0, n);
+  });
+  double flops = 2.0 * n * n * rhs;
+  std::cout << "Cholesky solve " << n << " x " << rhs << ": loop " << flops / loop * 1e-9 << " GFLOP/s, blocked "
+            << flops / blocked * 1e-9 << " GFLOP/s" << std::endl;
+}
+
+int main(void) {
+  Ferrum::CpuEngine serial(0);
+  Ferrum::CpuEngine pooled;
+  Ferrum::SplitEngine split({new Ferrum::CpuEngine(2), new Ferrum::CpuEngine(2)}, 1);
+  bool ok = functions(serial) && functions(pooled) && functions(split) && rejects(pooled) && rejects(split) &&
+            lazy();
+  if (ok) {
+    benchmark(pooled);
+    std::cout << "Success!" << std::endl;
+    return 0;
+  }
+  std::cout << "Failed!" << std::endl;
+  return 1;
+}
@@ -0,0 +1,177 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "cpuengine.hpp"
+#include "tuner.hpp"
+
+// Calibrates a profile over a slow and a fast CPU "device", checks that it saves and loads,
+// and that a tuned engine sends calls to the device the profile chose.
+
+// A CPU engine that counts its calls, and can be slowed down by a fixed time per element
+class Device : public Ferrum::CpuEngine {
+  public:
+    Device(int threads, double nanosPerElement) : Ferrum::CpuEngine(threads), calls(0), nanos(nanosPerElement) {}
+
+    std::atomic<int> calls;
+
+    float* vect_bB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                   float* result, long len, long offset, long stride) override {
+      pace(n);
+      return Ferrum::CpuEngine::vect_bB(id, n, a, lena, offset_a, stride_a, result, len, offset, stride);
+    }
+
+    float* vect_bbB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                    const float* b, long lenb, long offset_b, long stride_b,
+                    float* result, long len, long offset, long stride) override {
+      pace(n);
+      return Ferrum::CpuEngine::vect_bbB(id, n, a, lena, offset_a, stride_a, b, lenb, offset_b, stride_b,
+                                         result, len, offset, stride);
+    }
+
+    float* vect_bBB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                    float* b, long lenb, long offset_b, long stride_b,
+                    float* result, long len, long offset, long stride) override {
+      pace(n);
+      return Ferrum::CpuEngine::vect_bBB(id, n, a, lena, offset_a, stride_a, b, lenb, offset_b, stride_b,
+                                         result, len, offset, stride);
+    }
+
+    float* ge_bB(Ferrum::FunctionID id, long sd, long fd,
+                 const float* a, long lena, long offset_a, long stride_a,
+                 float* result, long len, long offset, long stride) override {
+      pace(static_cast<long>(sd) * fd);
+      return Ferrum::CpuEngine::ge_bB(id, sd, fd, a, lena, offset_a, stride_a, result, len, offset, stride);
+    }
+
+  private:
+    double nanos;
+
+    void pace(long n) {
+      calls++;
+      if (nanos > 0) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(static_cast<long>(n * nanos)));
+      }
+    }
+};
+
+static bool close(float x, float y) {
+  return std::fabs(x - y) <= 1e-5f * std::fmax(1.0f, std::fabs(y));
+}
+
+static const char* PROFILE_PATH = "/tmp/ferrum-tuner-test.profile";
+
+static bool profileTests(Ferrum::TuningProfile& profile) {
+  Device slow(0, 20.0);
+  Device fast(2, 0.0);
+  Ferrum::CalibrationOptions options;
+  options.minLength = 1 << 10;
+  options.maxLength = 1 << 14;
+  options.repeats = 2;
+  profile = Ferrum::calibrate({&slow, &fast}, options);
+
+  // every measured choice is the fast device, including for functions that were not timed themselves
+  for (const char* fn : {"vector_exp", "vector_add", "vector_sincos", "vector_powx", "vector_linear_frac"}) {
+    for (int c = 0; c < Ferrum::SIZE_CLASSES; c++) {
+      for (bool strided : {false, true}) {
+        const Ferrum::Choice* choice = profile.find(Ferrum::getFunctionID(fn), c, strided);
+        if (choice == nullptr || choice->backend != 1) {
+          std::cout << "calibration did not choose the fast device for " << fn << std::endl;
+          return false;
+        }
+      }
+    }
+  }
+  if (profile.find(Ferrum::FunctionID::ge_exp, 10, false) != nullptr) {
+    std::cout << "matrix functions should not be in the profile" << std::endl;
+    return false;
+  }
+
+  Ferrum::TuningProfile loaded;
+  if (!profile.save(PROFILE_PATH) || !loaded.load(PROFILE_PATH) || !(loaded == profile)) {
+    std::cout << "profile did not survive a save and load" << std::endl;
+    return false;
+  }
+  std::ofstream(PROFILE_PATH) << "ferrum-tuning 999\nbackends cpu cpu\n";
+  if (loaded.load(PROFILE_PATH) || !loaded.empty()) {
+    std::cout << "a profile of another version was loaded" << std::endl;
+    return false;
+  }
+  std::remove(PROFILE_PATH);
+  return true;
+}
+
+static bool routingTests(const Ferrum::TuningProfile& profile) {
+  Device* slow = new Device(0, 20.0);
+  Device* fast = new Device(2, 0.0);
+  Ferrum::TunedEngine engine({slow, fast}, profile);
+
+  const int n = 1 << 12;
+  std::vector<float> a(n), r(n);
+  for (int i = 0; i < n; i++) {
+    a[i] = (i % 1000) * 0.001f;
+  }
+  engine.vect_bB(Ferrum::FunctionID::vector_exp, n, a.data(), n, 0, 1, r.data(), n, 0, 1);
+  if (slow->calls != 0 || fast->calls != 1 || !close(r[n - 1], std::exp(a[n - 1]))) {
+    std::cout << "vector call was not routed to the fast device" << std::endl;
+    return false;
+  }
+  // matrices follow the vector function of the same operation
+  engine.ge_bB(Ferrum::FunctionID::ge_exp, 64, 64, a.data(), n, 0, 64, r.data(), n, 0, 64);
+  if (slow->calls != 0 || fast->calls != 2 || !close(r[n - 1], std::exp(a[n - 1]))) {
+    std::cout << "matrix call was not routed to the fast device" << std::endl;
+    return false;
+  }
+
+  // a profile from other backends is ignored, and everything goes to the primary
+  Ferrum::TuningProfile other({"metal", "cpu"});
+  other.set(Ferrum::FunctionID::vector_exp, 12, false, Ferrum::Choice{1, 0});
+  Ferrum::TunedEngine mismatched({new Device(0, 0.0), new Device(0, 0.0)}, other);
+  if (mismatched.route(Ferrum::FunctionID::vector_exp, n, false) != 0) {
+    std::cout << "a mismatched profile was used" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// A tuned thread count changes how a call is split, but not its result
+static bool launchOptionTests() {
+  Ferrum::CpuEngine engine(3);
+  std::vector<int> threads = engine.launchOptions(Ferrum::FunctionID::vector_lgamma);
+  if (threads.empty() || threads.front() != 1 || threads.back() != 4) {
+    std::cout << "unexpected thread options" << std::endl;
+    return false;
+  }
+  const int n = 1 << 16;
+  std::vector<float> a(n), r(n);
+  for (int i = 0; i < n; i++) {
+    a[i] = 0.5f + (i % 1000) * 0.01f;
+  }
+  for (int option : threads) {
+    engine.setLaunchOption(Ferrum::FunctionID::vector_lgamma, Ferrum::sizeClass(n), option);
+    std::fill(r.begin(), r.end(), 0.0f);
+    engine.vect_bB(Ferrum::FunctionID::vector_lgamma, n, a.data(), n, 0, 1, r.data(), n, 0, 1);
+    for (int i = 0; i < n; i++) {
+      if (!close(r[i], std::lgamma(a[i]))) {
+        std::cout << "vector_lgamma differs at " << i << " with " << option << " threads" << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int main(void) {
+  Ferrum::TuningProfile profile;
+  if (profileTests(profile) && routingTests(profile) && launchOptionTests()) {
+    std::cout << "Success!" << std::endl;
+    return 0;
+  }
+  std::cout << "Failed!" << std::endl;
+  return 1;
+}
@@ -0,0 +1,91 @@
+#include <cmath>
+#include <iostream>
+#include <sys/mman.h>
+
+#include "cpuengine.hpp"
+#include "split.hpp"
+
+// Calls with offsets, strides and lengths past 2^31 elements. The arrays are sparse mappings
+// that reserve no memory, and only the few pages that a call touches are ever filled.
+
+static bool close(float x, float y) {
+  return std::fabs(x - y) <= 1e-5f * std::fmax(1.0f, std::fabs(y));
+}
+
+static const long BIG = (1L << 31) + 5;
+
+static float* sparse(long len) {
+  void* data = mmap(nullptr, sizeof(float) * len, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  return data == MAP_FAILED ? nullptr : static_cast<float*>(data);
+}
+
+static bool wideTests(Ferrum::Backend& engine) {
+  const long len = 3 * BIG;
+  float* a = sparse(len);
+  float* r = sparse(len);
+  if (a == nullptr || r == nullptr) {
+    std::cout << "could not map the test arrays" << std::endl;
+    return false;
+  }
+  bool ok = true;
+
+  // an offset past 2^31
+  const long n = 5000;
+  for (long i = 0; i < n; i++) {
+    a[2 * BIG + i] = (i % 1000) * 0.001f;
+  }
+  engine.vect_bB(Ferrum::FunctionID::vector_exp, n, a, 2 * BIG + n, 2 * BIG, 1, r, BIG + n, BIG, 1);
+  for (long i = 0; i < n && ok; i++) {
+    if (!close(r[BIG + i], std::exp(a[2 * BIG + i]))) {
+      std::cout << "vector_exp differs at " << i << std::endl;
+      ok = false;
+    }
+  }
+
+  // a stride past 2^31, on one operand of a binary function
+  for (long i = 0; i < 3; i++) {
+    a[i * BIG] = 1.0f + i;
+    a[2 * BIG + 10 + i] = 0.5f;
+  }
+  engine.vect_bbB(Ferrum::FunctionID::vector_add, 3, a, 2 * BIG + 1, 0, BIG, a, len, 2 * BIG + 10, 1, r, 10, 7, 1);
+  for (long i = 0; i < 3 && ok; i++) {
+    if (!close(r[7 + i], 1.5f + i)) {
+      std::cout << "vector_add differs at " << i << std::endl;
+      ok = false;
+    }
+  }
+
+  // a matrix whose leading dimension is past 2^31
+  const long sd = 4, fd = 3;
+  for (long j = 0; j < fd; j++) {
+    for (long i = 0; i < sd; i++) {
+      a[i + j * BIG] = 0.1f * (i + j);
+    }
+  }
+  engine.ge_bB(Ferrum::FunctionID::ge_sqr, sd, fd, a, len, 0, BIG, r, len, 1, BIG);
+  for (long j = 0; j < fd && ok; j++) {
+    for (long i = 0; i < sd && ok; i++) {
+      float x = a[i + j * BIG];
+      if (!close(r[1 + i + j * BIG], x * x)) {
+        std::cout << "ge_sqr differs at " << i << ", " << j << std::endl;
+        ok = false;
+      }
+    }
+  }
+
+  munmap(a, sizeof(float) * len);
+  munmap(r, sizeof(float) * len);
+  return ok;
+}
+
+int main(void) {
+  Ferrum::CpuEngine engine;
+  Ferrum::SplitEngine split({new Ferrum::CpuEngine(0), new Ferrum::CpuEngine(0)}, 1 << 10);
+  if (wideTests(engine) && wideTests(split)) {
+    std::cout << "Success!" << std::endl;
+    return 0;
+  }
+  std::cout << "Failed!" << std::endl;
+  return 1;
+}
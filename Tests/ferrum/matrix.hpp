@@ -0,0 +1,42 @@
+#pragma once
+
+#ifndef FERRUM_TEST_MATRIX_HPP
+#define FERRUM_TEST_MATRIX_HPP
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+// Matrices and timing shared by the CPU tests of the linear algebra functions
+
+// A repeatable value between -1 and 1 for element i of an array
+static inline float value(long i, int seed) {
+  return static_cast<float>((i * 37 + seed * 11) % 101) / 50.0f - 1.0f;
+}
+
+// A column major matrix in an array, after offset elements and with pad rows past its own in
+// each column. The whole array, padding too, is filled from value.
+struct Matrix {
+  long rows, cols, offset, ld;
+  std::vector<float> data;
+
+  Matrix(long rows, long cols, long offset, long pad, int seed) :
+      rows(rows), cols(cols), offset(offset), ld(rows + pad), data(offset + ld * cols + pad) {
+    for (size_t i = 0; i < data.size(); i++) {
+      data[i] = value(i, seed);
+    }
+  }
+
+  float at(long i, long j) const { return data[offset + i + j * ld]; }
+  float* ref(long i, long j) { return &data[offset + i + j * ld]; }
+  long len() const { return static_cast<long>(data.size()); }
+};
+
+// The seconds a call takes
+static inline double timed(const std::function<void()>& run) {
+  auto start = std::chrono::steady_clock::now();
+  run();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+#endif // FERRUM_TEST_MATRIX_HPP
@@ -0,0 +1,285 @@
+#pragma once
+
+#ifndef FERRUM_BACKEND_HPP
+#define FERRUM_BACKEND_HPP
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "blas.hpp"
+#include "cpukernels.hpp"
+#include "functions.hpp"
+
+#ifdef DEBUG
+#define DBG1(arg1) std::cout << (arg1) << std::endl
+#define DBG2(arg1, arg2) std::cout << (arg1) << (arg2) << std::endl
+#define DBG3(arg1, arg2, arg3) std::cout << (arg1) << (arg2) << (arg3) << std::endl
+#define MACRO_DISPATCH(arg1, arg2, arg3, func, ...) func
+#define DBG(...) MACRO_DISPATCH(__VA_ARGS__, DBG3, DBG2, DBG1)(__VA_ARGS__)
+#else
+#define DBG(...)
+#endif
+
+namespace Ferrum {
+
+  class Graph;
+  class GraphExec;
+
+  // The dispatch interface implemented by each compute backend.
+  //
+  // Backends are thread safe: any number of threads may dispatch on the same backend at once.
+  // Every call builds its own submission state (a command buffer and encoder on Metal, stack
+  // locals on the CPU), while the state shared between calls, such as pipelines and kernel
+  // tables, is read-only once the backend is constructed. Pooled memory is locked internally.
+  // Callers are still responsible for not writing to the same result or in/out array from
+  // two calls at once, and for not destroying a backend while calls are in flight.
+  class Backend {
+    public:
+      virtual ~Backend() {}
+
+      virtual const char* name() const = 0;
+
+      // Tuning hooks (see tuner.hpp). A launch option is a backend's own parameter for one function
+      // and size class: the threadgroup width on Metal, or the most threads a call is split over on
+      // the CPU. Option 0 is the backend's default. Options are read without locking, so they are
+      // set before calls are made. Backends without options ignore them.
+      virtual std::vector<int> launchOptions(FunctionID id) const { return std::vector<int>(); }
+      virtual void setLaunchOption(FunctionID id, int sizeClass, int option) {}
+
+      // Prepares a captured graph (see graph.hpp) for replay on this backend, or returns nullptr
+      // if it cannot run here. The caller deletes the instance. Backends without their own way
+      // to replay a graph make its calls one by one.
+      virtual GraphExec* instantiate(const Graph& graph);
+
+      // Compiles an elementwise expression (see expression.hpp) into a kernel for a shape, and
+      // returns the id that calls dispatch it with, or UNKNOWN if it does not compile. It is
+      // called with the dispatch form that its operands and scalars call for.
+      virtual FunctionID compile(const std::string& expression, KernelShape shape = KernelShape::VECTOR);
+
+      // Dispatch functions
+      // f: float, b: buffer, B: in/out buffer. The final buffer is always an out-only buffer (shown as B)
+      // Buffers are *always* followed by: length, offset, stride
+      // These, and matrix dimensions, are 64-bit counts of elements.
+      // Vector functions compute exactly n elements, which every buffer must hold from its offset.
+      // Vector strides may be negative, as BLAS increments are: the elements then run backwards
+      // from offset + (n - 1) * |stride| to the offset, which is always the lowest one touched.
+
+      // general vector functions
+      virtual float* vect_bB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                                    float* result, long len, long offset, long stride) = 0;
+      virtual float* vect_bfB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                                     float sa,
+                                                     float* result, long len, long offset, long stride) = 0;
+      virtual float* vect_fbB(FunctionID id, long n, float sa,
+                                                     const float* a, long lena, long offset_a, long stride_a,
+                                                     float* result, long len, long offset, long stride) = 0;
+      virtual float* vect_bbB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                                     const float* b, long lenb, long offset_b, long stride_b,
+                                                     float* result, long len, long offset, long stride) = 0;
+      virtual float* vect_bBB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                                     float* b, long lenb, long offset_b, long stride_b,
+                                                     float* result, long len, long offset, long stride) = 0;
+      virtual float* vect_bffffB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                                        float sa, float sha,
+                                                        float sb, float shb,
+                                                        float* result, long len, long offset, long stride) = 0;
+      virtual float* vect_bbffffB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                                         const float* b, long lenb, long offset_b, long stride_b,
+                                                         float sa, float sha,
+                                                         float sb, float shb,
+                                                         float* result, long len, long offset, long stride) = 0;
+      // general matrix functions
+      virtual float* ge_bB(FunctionID id, long sd, long fd,
+                                          const float* a, long lena, long offset_a, long stride_a,
+                                          float* result, long len, long offset, long stride) = 0;
+      virtual float* ge_bfB(FunctionID id, long sd, long fd,
+                                           const float* a, long lena, long offset_a, long stride_a,
+                                           float sa,
+                                           float* result, long len, long offset, long stride) = 0;
+      virtual float* ge_fbB(FunctionID id, long sd, long fd, float sa,
+                                           const float* a, long lena, long offset_a, long stride_a,
+                                           float* result, long len, long offset, long stride) = 0;
+      virtual float* ge_bbB(FunctionID id, long sd, long fd,
+                                           const float* a, long lena, long offset_a, long stride_a,
+                                           const float* b, long lenb, long offset_b, long stride_b,
+                                           float* result, long len, long offset, long stride) = 0;
+      virtual float* ge_bBB(FunctionID id, long sd, long fd,
+                                           const float* a, long lena, long offset_a, long stride_a,
+                                           float* b, long lenb, long offset_b, long stride_b,
+                                           float* result, long len, long offset, long stride) = 0;
+      virtual float* ge_bffffB(FunctionID id, long sd, long fd,
+                                              const float* a, long lena, long offset_a, long stride_a,
+                                              float sa, float sha,
+                                              float sb, float shb,
+                                              float* result, long len, long offset, long stride) = 0;
+      virtual float* ge_bbffffB(FunctionID id, long sd, long fd,
+                                               const float* a, long lena, long offset_a, long stride_a,
+                                               const float* b, long lenb, long offset_b, long stride_b,
+                                               float sa, float sha,
+                                               float sb, float shb,
+                                               float* result, long len, long offset, long stride) = 0;
+      // general uplo functions
+      virtual float* uplo_bB(FunctionID id, long sd, int unit, int bottom,
+                                            const float* a, long lena, long offset_a, long stride_a,
+                                            float* result, long len, long offset, long stride) = 0;
+      virtual float* uplo_bfB(FunctionID id, long sd, int unit, int bottom,
+                                             const float* a, long lena, long offset_a, long stride_a,
+                                             float sa,
+                                             float* result, long len, long offset, long stride) = 0;
+      virtual float* uplo_fbB(FunctionID id, long sd, int unit, int bottom,
+                                             const float* a, long lena, long offset_a, long stride_a,
+                                             float sa,
+                                             float* result, long len, long offset, long stride) = 0;
+      virtual float* uplo_bbB(FunctionID id, long sd, int unit, int bottom,
+                                             const float* a, long lena, long offset_a, long stride_a,
+                                             const float* b, long lenb, long offset_b, long stride_b,
+                                             float* result, long len, long offset, long stride) = 0;
+      virtual float* uplo_bBB(FunctionID id, long sd, int unit, int bottom,
+                                             const float* a, long lena, long offset_a, long stride_a,
+                                             float* b, long lenb, long offset_b, long stride_b,
+                                             float* result, long len, long offset, long stride) = 0;
+      virtual float* uplo_bffffB(FunctionID id, long sd, int unit, int bottom,
+                                                const float* a, long lena, long offset_a, long stride_a,
+                                                float sa, float sha,
+                                                float sb, float shb,
+                                                float* result, long len, long offset, long stride) = 0;
+      virtual float* uplo_bbffffB(FunctionID id, long sd, int unit, int bottom,
+                                                 const float* a, long lena, long offset_a, long stride_a,
+                                                 const float* b, long lenb, long offset_b, long stride_b,
+                                                 float sa, float sha,
+                                                 float sb, float shb,
+                                                 float* result, long len, long offset, long stride) = 0;
+
+      // Linear algebra functions (see blas.hpp)
+      // Matrices are column major, as in the ge functions: each is followed by its length, offset and
+      // leading dimension. Vectors are followed by their length, offset and stride, as in the vector
+      // functions. Transposes are NO_TRANS or TRANS. These return the result, or nullptr when an
+      // operand does not fit in its array. Backends that do not have them report it and return nullptr.
+
+      // C = alpha * op(A) * op(B) + beta * C, where op(A) is m x k and op(B) is k x n
+      virtual float* gemm(int transA, int transB, long m, long n, long k, float alpha,
+                          const float* a, long lena, long offset_a, long lda,
+                          const float* b, long lenb, long offset_b, long ldb,
+                          float beta, float* c, long lenc, long offset_c, long ldc);
+      // y = alpha * op(A) * x + beta * y, where A is m x n
+      virtual float* gemv(int trans, long m, long n, float alpha,
+                          const float* a, long lena, long offset_a, long lda,
+                          const float* x, long lenx, long offset_x, long stride_x,
+                          float beta, float* y, long leny, long offset_y, long stride_y);
+      // A = alpha * x * y^T + A, where A is m x n
+      virtual float* ger(long m, long n, float alpha,
+                         const float* x, long lenx, long offset_x, long stride_x,
+                         const float* y, long leny, long offset_y, long stride_y,
+                         float* a, long lena, long offset_a, long lda);
+
+      // Triangles are given by sd, unit and bottom, as in the uplo functions. Sides are LEFT or RIGHT.
+      // x = op(A) * x
+      virtual float* trmv(int trans, long sd, int unit, int bottom,
+                          const float* a, long lena, long offset_a, long lda,
+                          float* x, long lenx, long offset_x, long stride_x);
+      // Solves op(A) * y = x, and leaves y in x
+      virtual float* trsv(int trans, long sd, int unit, int bottom,
+                          const float* a, long lena, long offset_a, long lda,
+                          float* x, long lenx, long offset_x, long stride_x);
+      // B = alpha * op(A) * B (left) or alpha * B * op(A) (right), where B is m x n
+      virtual float* trmm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                          const float* a, long lena, long offset_a, long lda,
+                          float* b, long lenb, long offset_b, long ldb);
+      // Solves op(A) * X = alpha * B (left) or X * op(A) = alpha * B (right), and leaves X in B
+      virtual float* trsm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                          const float* a, long lena, long offset_a, long lda,
+                          float* b, long lenb, long offset_b, long ldb);
+      // C = alpha * op(A) * op(A)^T + beta * C on the triangle of C given by bottom, where op(A) is n x k
+      virtual float* syrk(int trans, long n, long k, int bottom, float alpha,
+                          const float* a, long lena, long offset_a, long lda,
+                          float beta, float* c, long lenc, long offset_c, long ldc);
+      // Factors the symmetric positive definite A given by the triangle bottom as L * L^T (lower) or
+      // U^T * U (upper), leaving the factor in that triangle. Fails when A is not positive definite.
+      virtual float* potrf(long sd, int bottom, float* a, long lena, long offset_a, long lda);
+      // Solves A * X = B with the factor from potrf, and leaves X in B, where B is sd x n
+      virtual float* potrs(long sd, long n, int bottom, const float* a, long lena, long offset_a, long lda,
+                           float* b, long lenb, long offset_b, long ldb);
+
+      // Packed triangles (see blas.hpp) are followed by their length and offset, and hold packedLength(sd)
+      // elements from the offset. Elementwise functions on a packed triangle are the vector functions
+      // over those elements with a stride of 1.
+      // Packs the triangle bottom of A into ap
+      virtual float* trttp(long sd, int bottom, const float* a, long lena, long offset_a, long lda,
+                           float* ap, long lenap, long offset_ap);
+      // Unpacks ap into the triangle bottom of A, leaving the other triangle as it was
+      virtual float* tpttr(long sd, int bottom, const float* ap, long lenap, long offset_ap,
+                           float* a, long lena, long offset_a, long lda);
+      // x = op(A) * x, where A is a packed triangle
+      virtual float* tpmv(int trans, long sd, int unit, int bottom, const float* ap, long lenap, long offset_ap,
+                          float* x, long lenx, long offset_x, long stride_x);
+      // y = alpha * A * x + beta * y, where the symmetric A is given by the packed triangle bottom
+      virtual float* spmv(long sd, int bottom, float alpha, const float* ap, long lenap, long offset_ap,
+                          const float* x, long lenx, long offset_x, long stride_x,
+                          float beta, float* y, long leny, long offset_y, long stride_y);
+
+      // B = alpha * op(A), where A is m x n, and B is m x n or n x m with the transpose. A row major
+      // matrix is the transpose of a column major one, so TRANS converts between the two. A and B do
+      // not overlap.
+      virtual float* omatcopy(int trans, long m, long n, float alpha,
+                              const float* a, long lena, long offset_a, long lda,
+                              float* b, long lenb, long offset_b, long ldb);
+  };
+
+  // The number of strided elements that an array holds, from the offset, in either direction
+  inline long elementCount(long len, long offset, long stride) {
+    if (stride == 0 || offset < 0 || offset >= len) {
+      return 0;
+    }
+    return (len - offset - 1) / (stride < 0 ? -stride : stride) + 1;
+  }
+
+  // Whether an array holds n strided elements from the offset
+  inline bool holds(long len, long offset, long stride, long n) {
+    return n <= 0 || n <= elementCount(len, offset, stride);
+  }
+
+  // The index of the first of n strided elements, which is past the offset for a negative stride
+  inline long firstIndex(long offset, long stride, long n) {
+    return (stride < 0 && n > 0) ? offset - (n - 1) * stride : offset;
+  }
+
+  // Calls are tuned by size class: the power of two at or below their element count
+  const int SIZE_CLASSES = 40;
+
+  inline int sizeClass(long n) {
+    int c = 0;
+    while (n > 1 && c < SIZE_CLASSES - 1) {
+      n >>= 1;
+      c++;
+    }
+    return c;
+  }
+
+  // Launch options by function and size class, for backends that can be tuned
+  class LaunchTable {
+    public:
+      LaunchTable() : options(FUNCTION_COUNT * SIZE_CLASSES, 0) {}
+
+      int get(FunctionID id, long n) const {
+        size_t i = static_cast<size_t>(id) * SIZE_CLASSES + sizeClass(n);
+        return (id == FunctionID::UNKNOWN || i >= options.size()) ? 0 : options[i];
+      }
+
+      void set(FunctionID id, int sizeClass, int option) {
+        size_t i = static_cast<size_t>(id) * SIZE_CLASSES + sizeClass;
+        if (id != FunctionID::UNKNOWN && sizeClass >= 0 && sizeClass < SIZE_CLASSES && i < options.size()) {
+          options[i] = option;
+        }
+      }
+
+    private:
+      std::vector<int> options;
+  };
+
+  inline FunctionID getFunctionID(const std::string& name) {
+    return functionID(name);
+  }
+
+} // namespace Ferrum
+
+#endif // FERRUM_BACKEND_HPP
@@ -0,0 +1,123 @@
+#pragma once
+
+#ifndef FERRUM_BLAS_HPP
+#define FERRUM_BLAS_HPP
+
+namespace Ferrum {
+
+  class ThreadPool;
+
+  // BLAS flags, as CBLAS numbers them (as the unit flag of the uplo functions is)
+  const int NO_TRANS = 111;
+  const int TRANS = 112;
+  const int NON_UNIT = 131;
+  const int UNIT = 132;
+  const int LEFT = 141;
+  const int RIGHT = 142;
+
+  // Host kernels for the linear algebra functions, which the CPU engine runs once it has
+  // checked that every matrix fits in its array. Matrices are column major, and are given
+  // by their first element and leading dimension. A kernel splits its work over the pool,
+  // or runs on the calling thread when the pool is nullptr.
+
+  // C = alpha * op(A) * op(B) + beta * C, where op(A) is m x k and op(B) is k x n.
+  // C is not read when beta is 0.
+  //
+  // Blocked as in GotoBLAS: a KC x NC panel of op(B) is packed once and shared, and each task
+  // packs an MC x KC block of op(A) that stays in L2. The packed operands are read in order
+  // by a micro-kernel that keeps an 8 x 6 block of C in vector registers over the whole KC.
+  // Tasks are tiles of C within the panel, so even a short C is spread over the threads.
+  void hostGemm(ThreadPool* pool, bool transA, bool transB, long m, long n, long k, float alpha,
+                const float* a, long lda, const float* b, long ldb, float beta, float* c, long ldc);
+
+  // Vectors are given by their first element and a stride, which may be negative.
+
+  // y = alpha * op(A) * x + beta * y, where A is m x n. y is not read when beta is 0.
+  //
+  // Bound by the bandwidth of reading A once. Without the transpose, columns of A are added into
+  // blocks of y that stay in L1. A short y is also cut into groups of columns, whose sums are
+  // added at the end. With the transpose, each element of y is a dot product down a column, and
+  // tall columns are cut into blocks of rows whose partial dots are reduced at the end, so that
+  // a few long columns still spread over the threads.
+  void hostGemv(ThreadPool* pool, bool trans, long m, long n, float alpha, const float* a, long lda,
+                const float* x, long incx, float beta, float* y, long incy);
+
+  // A = alpha * x * y^T + A, where A is m x n, over tiles of A
+  void hostGer(ThreadPool* pool, long m, long n, float alpha, const float* x, long incx,
+               const float* y, long incy, float* a, long lda);
+
+  // Triangles are given as the uplo functions give them: the lower triangle when bottom is
+  // positive and the upper when it is negative, with a diagonal of ones that is not read when
+  // unit. The other triangle is never read. Most of the work of the triangular functions is
+  // handed to gemv or gemm: trmv and trsv work a block on the diagonal at a time, and trmm and
+  // trsm cut the triangle in halves until it is small, taking each half's product with gemm.
+
+  // x = op(A) * x, where A is an sd x sd triangle
+  void hostTrmv(ThreadPool* pool, bool trans, long sd, bool unit, bool lower, const float* a, long lda,
+                float* x, long incx);
+  // Solves op(A) * y = x, and leaves y in x
+  void hostTrsv(ThreadPool* pool, bool trans, long sd, bool unit, bool lower, const float* a, long lda,
+                float* x, long incx);
+
+  // B = alpha * op(A) * B (left) or alpha * B * op(A) (right), where B is m x n
+  void hostTrmm(ThreadPool* pool, bool left, bool trans, long m, long n, bool unit, bool lower, float alpha,
+                const float* a, long lda, float* b, long ldb);
+  // Solves op(A) * X = alpha * B (left) or X * op(A) = alpha * B (right), and leaves X in B
+  void hostTrsm(ThreadPool* pool, bool left, bool trans, long m, long n, bool unit, bool lower, float alpha,
+                const float* a, long lda, float* b, long ldb);
+
+  // C = alpha * op(A) * op(A)^T + beta * C on one triangle of C, where op(A) is n x k.
+  // The other triangle is not touched.
+  void hostSyrk(ThreadPool* pool, bool trans, long n, long k, bool lower, float alpha,
+                const float* a, long lda, float beta, float* c, long ldc);
+
+  // Factors the symmetric positive definite n x n matrix given by one triangle of A as
+  // L * L^T (lower) or U^T * U (upper), leaving the factor in that triangle. Returns 0, or the
+  // order of the first leading minor that is not positive definite, where A is left partly
+  // factored.
+  //
+  // Blocked right-looking: each step factors a block on the diagonal, solves the panel below
+  // (or beside) it with trsm, and takes the panel's product from the rest of the matrix with
+  // syrk, both spread over the pool.
+  long hostPotrf(ThreadPool* pool, long n, bool lower, float* a, long lda);
+  // Solves A * X = B with the factor from hostPotrf, and leaves X in B, where B is n x nrhs
+  void hostPotrs(ThreadPool* pool, long n, long nrhs, bool lower, const float* a, long lda, float* b, long ldb);
+
+  // Packed triangles hold one triangle of an sd x sd matrix column by column with no gaps, as
+  // BLAS packs them: column j of the lower triangle holds rows j to sd - 1, and of the upper rows
+  // 0 to j. The diagonal is always stored, even when it is a unit one that is not read.
+  inline long packedLength(long sd) {
+    return sd > 0 ? sd * (sd + 1) / 2 : 0;
+  }
+
+  // The index in a packed triangle of its element (i, j), which lies in the triangle
+  inline long packedIndex(long sd, bool lower, long i, long j) {
+    return lower ? j * (2 * sd - j + 1) / 2 + (i - j) : j * (j + 1) / 2 + i;
+  }
+
+  // Copies the triangle of the sd x sd matrix A into ap (trttp), or ap into the triangle of A,
+  // leaving the other triangle as it was (tpttr)
+  void hostTrttp(ThreadPool* pool, long sd, bool lower, const float* a, long lda, float* ap);
+  void hostTpttr(ThreadPool* pool, long sd, bool lower, const float* ap, float* a, long lda);
+
+  // x = op(A) * x, where A is the packed triangle ap. Tasks are blocks of rows of the result,
+  // which add the parts of the columns of A that lie in their rows (or take dots of whole
+  // columns, with the transpose) from a copy of x, so A is read once.
+  void hostTpmv(ThreadPool* pool, bool trans, long sd, bool unit, bool lower, const float* ap,
+                float* x, long incx);
+  // y = alpha * A * x + beta * y, where the symmetric A is given by the packed triangle ap.
+  // y is not read when beta is 0. Each block of rows of y takes both the columns of the triangle
+  // that cross it and the dots of its own columns, so blocks do the same work.
+  void hostSpmv(ThreadPool* pool, long sd, bool lower, float alpha, const float* ap,
+                const float* x, long incx, float beta, float* y, long incy);
+
+  // B = alpha * op(A), where A is m x n and does not overlap B. Without the transpose this copies
+  // between leading dimensions a column at a time. The transpose, which also converts between
+  // column and row major, works on square blocks that keep both sides in L1, each taken as 4 x 4
+  // blocks that are read and written as vectors, with the blocks spread over the pool.
+  void hostOmatcopy(ThreadPool* pool, bool trans, long m, long n, float alpha, const float* a, long lda,
+                    float* b, long ldb);
+
+} // namespace Ferrum
+
+#endif // FERRUM_BLAS_HPP
@@ -0,0 +1,289 @@
+#pragma once
+
+#ifndef FERRUM_COALESCER_HPP
+#define FERRUM_COALESCER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include "backend.hpp"
+#include "pool.hpp"
+
+namespace Ferrum {
+
+  struct CoalescerStats {
+    uint64_t requests;       // small calls that were eligible for coalescing
+    uint64_t batches;        // dispatches made for those calls
+    uint64_t coalesced;      // calls that shared a dispatch with at least one other call
+
+    double averageBatch() const {
+      return batches == 0 ? 0.0 : static_cast<double>(requests) / batches;
+    }
+  };
+
+  // An opt-in layer over another backend that merges small concurrent calls.
+  //
+  // The first thread to make a small vector call opens a batch for its function and scalars,
+  // then waits up to the latency window for other threads to make the same call. Once the
+  // window expires, or the batch is full, the operands of every call in the batch are packed
+  // into one contiguous buffer, dispatched once, and the results are scattered back. A call
+  // that found no company within the window is dispatched on its own arrays, unpacked.
+  //
+  // Only the elementwise unary and binary vector functions are coalesced. Pair functions, matrix
+  // functions, and vectors longer than maxElements go straight to the wrapped backend.
+  // The coalescer owns the wrapped backend.
+  class Coalescer : public Backend {
+    public:
+      static const long DEFAULT_WINDOW_MICROS = 50;
+      static const int DEFAULT_MAX_BATCH = 32;
+      static const long DEFAULT_MAX_ELEMENTS = 4096;
+
+      Coalescer(Backend* backend,
+                long windowMicros = DEFAULT_WINDOW_MICROS,
+                int maxBatch = DEFAULT_MAX_BATCH,
+                long maxElements = DEFAULT_MAX_ELEMENTS);
+      ~Coalescer();
+
+      const char* name() const override { return "coalescer"; }
+
+      // Kernels are compiled on the wrapped backend
+      FunctionID compile(const std::string& expression, KernelShape shape = KernelShape::VECTOR) override {
+        return engine->compile(expression, shape);
+      }
+
+      // Tuning. These may be changed while calls are in flight, and apply to new batches.
+      void setWindow(long micros) { windowMicros = micros; }
+      void setMaxBatch(int requests) { maxBatch = requests < 1 ? 1 : requests; }
+      void setMaxElements(long elements) { maxElements = elements; }
+
+      CoalescerStats stats() const;
+      Backend* backend() { return engine; }
+
+      // Linear algebra functions go straight to the wrapped backend
+      float* gemm(int transA, int transB, long m, long n, long k, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  const float* b, long lenb, long offset_b, long ldb,
+                  float beta, float* c, long lenc, long offset_c, long ldc) override {
+        return engine->gemm(transA, transB, m, n, k, alpha, a, lena, offset_a, lda, b, lenb, offset_b, ldb,
+                            beta, c, lenc, offset_c, ldc);
+      }
+      float* gemv(int trans, long m, long n, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  const float* x, long lenx, long offset_x, long stride_x,
+                  float beta, float* y, long leny, long offset_y, long stride_y) override {
+        return engine->gemv(trans, m, n, alpha, a, lena, offset_a, lda, x, lenx, offset_x, stride_x,
+                            beta, y, leny, offset_y, stride_y);
+      }
+      float* ger(long m, long n, float alpha,
+                 const float* x, long lenx, long offset_x, long stride_x,
+                 const float* y, long leny, long offset_y, long stride_y,
+                 float* a, long lena, long offset_a, long lda) override {
+        return engine->ger(m, n, alpha, x, lenx, offset_x, stride_x, y, leny, offset_y, stride_y,
+                           a, lena, offset_a, lda);
+      }
+      float* trmv(int trans, long sd, int unit, int bottom,
+                  const float* a, long lena, long offset_a, long lda,
+                  float* x, long lenx, long offset_x, long stride_x) override {
+        return engine->trmv(trans, sd, unit, bottom, a, lena, offset_a, lda, x, lenx, offset_x, stride_x);
+      }
+      float* trsv(int trans, long sd, int unit, int bottom,
+                  const float* a, long lena, long offset_a, long lda,
+                  float* x, long lenx, long offset_x, long stride_x) override {
+        return engine->trsv(trans, sd, unit, bottom, a, lena, offset_a, lda, x, lenx, offset_x, stride_x);
+      }
+      float* trmm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  float* b, long lenb, long offset_b, long ldb) override {
+        return engine->trmm(side, trans, m, n, unit, bottom, alpha, a, lena, offset_a, lda, b, lenb, offset_b, ldb);
+      }
+      float* trsm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  float* b, long lenb, long offset_b, long ldb) override {
+        return engine->trsm(side, trans, m, n, unit, bottom, alpha, a, lena, offset_a, lda, b, lenb, offset_b, ldb);
+      }
+      float* syrk(int trans, long n, long k, int bottom, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  float beta, float* c, long lenc, long offset_c, long ldc) override {
+        return engine->syrk(trans, n, k, bottom, alpha, a, lena, offset_a, lda, beta, c, lenc, offset_c, ldc);
+      }
+      float* potrf(long sd, int bottom, float* a, long lena, long offset_a, long lda) override {
+        return engine->potrf(sd, bottom, a, lena, offset_a, lda);
+      }
+      float* potrs(long sd, long n, int bottom, const float* a, long lena, long offset_a, long lda,
+                   float* b, long lenb, long offset_b, long ldb) override {
+        return engine->potrs(sd, n, bottom, a, lena, offset_a, lda, b, lenb, offset_b, ldb);
+      }
+      float* trttp(long sd, int bottom, const float* a, long lena, long offset_a, long lda,
+                   float* ap, long lenap, long offset_ap) override {
+        return engine->trttp(sd, bottom, a, lena, offset_a, lda, ap, lenap, offset_ap);
+      }
+      float* tpttr(long sd, int bottom, const float* ap, long lenap, long offset_ap,
+                   float* a, long lena, long offset_a, long lda) override {
+        return engine->tpttr(sd, bottom, ap, lenap, offset_ap, a, lena, offset_a, lda);
+      }
+      float* tpmv(int trans, long sd, int unit, int bottom, const float* ap, long lenap, long offset_ap,
+                  float* x, long lenx, long offset_x, long stride_x) override {
+        return engine->tpmv(trans, sd, unit, bottom, ap, lenap, offset_ap, x, lenx, offset_x, stride_x);
+      }
+      float* spmv(long sd, int bottom, float alpha, const float* ap, long lenap, long offset_ap,
+                  const float* x, long lenx, long offset_x, long stride_x,
+                  float beta, float* y, long leny, long offset_y, long stride_y) override {
+        return engine->spmv(sd, bottom, alpha, ap, lenap, offset_ap, x, lenx, offset_x, stride_x,
+                            beta, y, leny, offset_y, stride_y);
+      }
+      float* omatcopy(int trans, long m, long n, float alpha,
+                      const float* a, long lena, long offset_a, long lda,
+                      float* b, long lenb, long offset_b, long ldb) override {
+        return engine->omatcopy(trans, m, n, alpha, a, lena, offset_a, lda, b, lenb, offset_b, ldb);
+      }
+
+      // Dispatch functions
+      // f: float, b: buffer, B: in/out buffer. The final buffer is always an out-only buffer (shown as B)
+      // Buffers are *always* followed by: length, offset, stride
+
+      // general vector functions
+      float* vect_bB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                            float* result, long len, long offset, long stride) override;
+      float* vect_bfB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                             float sa,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_fbB(FunctionID id, long n, float sa,
+                                             const float* a, long lena, long offset_a, long stride_a,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_bbB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                             const float* b, long lenb, long offset_b, long stride_b,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_bBB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                             float* b, long lenb, long offset_b, long stride_b,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_bffffB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                                float sa, float sha,
+                                                float sb, float shb,
+                                                float* result, long len, long offset, long stride) override;
+      float* vect_bbffffB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                                 const float* b, long lenb, long offset_b, long stride_b,
+                                                 float sa, float sha,
+                                                 float sb, float shb,
+                                                 float* result, long len, long offset, long stride) override;
+      // general matrix functions
+      float* ge_bB(FunctionID id, long sd, long fd,
+                                  const float* a, long lena, long offset_a, long stride_a,
+                                  float* result, long len, long offset, long stride) override;
+      float* ge_bfB(FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float sa,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_fbB(FunctionID id, long sd, long fd, float sa,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_bbB(FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   const float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_bBB(FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_bffffB(FunctionID id, long sd, long fd,
+                                      const float* a, long lena, long offset_a, long stride_a,
+                                      float sa, float sha,
+                                      float sb, float shb,
+                                      float* result, long len, long offset, long stride) override;
+      float* ge_bbffffB(FunctionID id, long sd, long fd,
+                                       const float* a, long lena, long offset_a, long stride_a,
+                                       const float* b, long lenb, long offset_b, long stride_b,
+                                       float sa, float sha,
+                                       float sb, float shb,
+                                       float* result, long len, long offset, long stride) override;
+      // general uplo functions
+      float* uplo_bB(FunctionID id, long sd, int unit, int bottom,
+                                    const float* a, long lena, long offset_a, long stride_a,
+                                    float* result, long len, long offset, long stride) override;
+      float* uplo_bfB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float sa,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_fbB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float sa,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_bbB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     const float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_bBB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_bffffB(FunctionID id, long sd, int unit, int bottom,
+                                        const float* a, long lena, long offset_a, long stride_a,
+                                        float sa, float sha,
+                                        float sb, float shb,
+                                        float* result, long len, long offset, long stride) override;
+      float* uplo_bbffffB(FunctionID id, long sd, int unit, int bottom,
+                                         const float* a, long lena, long offset_a, long stride_a,
+                                         const float* b, long lenb, long offset_b, long stride_b,
+                                         float sa, float sha,
+                                         float sb, float shb,
+                                         float* result, long len, long offset, long stride) override;
+
+    private:
+      // The vector argument patterns that can be coalesced
+      enum class Form { BB, BFB, FBB, BBB, BFFFFB, BBFFFFB };
+
+      // One caller's operands, already clamped to n elements
+      struct Request {
+        const float* a; long inc_a;
+        const float* b; long inc_b;
+        float* r; long inc_r;
+        long n;
+      };
+
+      // Calls can only share a dispatch if they agree on all of these.
+      // Scalars are compared by their bits, so that NaN arguments still match.
+      using Key = std::tuple<int, Form, uint32_t, uint32_t, uint32_t, uint32_t>;
+
+      struct Batch {
+        Key key;
+        FunctionID id;
+        Form form;
+        float sa, sha, sb, shb;
+        std::vector<Request> requests;
+        bool done;
+        bool failed;
+        std::condition_variable filled;
+        std::condition_variable finished;
+      };
+
+      Backend* engine;
+      std::atomic<long> windowMicros;
+      std::atomic<int> maxBatch;
+      std::atomic<long> maxElements;
+
+      mutable std::mutex lock;
+      std::map<Key, std::shared_ptr<Batch>> open;
+      CoalescerStats counters;
+      HostPool* pool;
+
+      float* submit(FunctionID id, Form form, float sa, float sha, float sb, float shb,
+                    const Request& request, float* result);
+      bool dispatch(Batch& batch);
+      float* call(FunctionID id, Form form, long n, float sa, float sha, float sb, float shb,
+                  const float* a, long lena, long offset_a, long stride_a,
+                  const float* b, long lenb, long offset_b, long stride_b,
+                  float* result, long len, long offset, long stride);
+      float* route(FunctionID id, Form form, long n, float sa, float sha, float sb, float shb,
+                   const float* a, long lena, long offset_a, long stride_a,
+                   const float* b, long lenb, long offset_b, long stride_b,
+                   float* result, long len, long offset, long stride);
+  };
+
+} // namespace Ferrum
+
+#endif // FERRUM_COALESCER_HPP
@@ -0,0 +1,256 @@
+#pragma once
+
+#ifndef FERRUM_CPU_ENGINE_HPP
+#define FERRUM_CPU_ENGINE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "backend.hpp"
+#include "cpukernels.hpp"
+#include "numa.hpp"
+#include "threadpool.hpp"
+
+namespace Ferrum {
+
+  // Runs the kernels on the host. This backend has no platform dependencies, so it is
+  // available wherever Metal is not, and it serves as a reference for the GPU results.
+  // Vectors and matrices that do not fit in their arrays are rejected.
+  //
+  // Large calls are split over a work-stealing thread pool. The grain is chosen per call from
+  // the kernel's cost per element and the L2 cache size: cheap memory-bound kernels such as add
+  // get large pieces that fill half of L2, while expensive kernels such as lgamma get small
+  // pieces so that every thread has work. Calls with less total work than INLINE_WORK run on
+  // the calling thread.
+  //
+  // On NUMA hosts the workers are pinned node by node. Resident tensors from allocate() can be
+  // placed FIRST_TOUCH, with one contiguous segment per node, or INTERLEAVED. A vector call whose
+  // result is a FIRST_TOUCH tensor is cut at the segment boundaries, and each node's range is
+  // started on that node's workers, so most elements are read and written by local threads.
+  // Bytes moved and time spent are counted per node for those calls (see nodeStats).
+  //
+  // A graph is instantiated as a list of kernel runs, with every check and lookup of the
+  // dispatch functions done once, so that a replay only places the runs on the bound tensors.
+  struct NodeStats {
+    uint64_t bytes;       // operand bytes read and written by node-scheduled calls
+    uint64_t busyNanos;   // thread time spent on them
+
+    // per busy thread
+    double gigabytesPerSecond() const {
+      return busyNanos == 0 ? 0.0 : static_cast<double>(bytes) / busyNanos;
+    }
+  };
+
+  class CpuEngine : public Backend {
+    public:
+      // cost-weighted elements (an add is 1) below which a call is not split
+      static const long INLINE_WORK = 1 << 15;
+      // cost-weighted elements aimed for in each piece of a split call
+      static const long CHUNK_WORK = 1 << 16;
+      static const long MIN_GRAIN = 256;
+
+      // With no CPUs given, the workers are spread over every CPU of the topology, node by node
+      explicit CpuEngine(int threads = ThreadPool::DEFAULT_THREADS, const std::vector<int>& cpus = std::vector<int>(),
+                         const NumaTopology& topology = NumaTopology::host());
+      ~CpuEngine();
+
+      CpuEngine(const CpuEngine&) = delete;
+      CpuEngine& operator=(const CpuEngine&) = delete;
+
+      // One engine per NUMA node, with its workers pinned to that node's CPUs and its resident
+      // tensors kept on that node, so that each node can be used as a separate device
+      static std::vector<Backend*> nodeDevices(const NumaTopology& topology = NumaTopology::host());
+
+      int threadCount() const { return pool->threadCount(); }
+      const NumaTopology& numaTopology() const { return topology; }
+
+      // Resident tensors: page-aligned host memory placed over the NUMA nodes.
+      // The memory is zeroed. Returns nullptr if the memory cannot be mapped.
+      float* allocate(long count, Placement placement = Placement::FIRST_TOUCH);
+      void free(float* data);
+
+      std::vector<NodeStats> nodeStats() const;
+      void resetNodeStats();
+
+      const char* name() const override { return "cpu"; }
+
+      // Launch options are thread counts, from 1 up to the workers and the caller.
+      // They apply to vector functions.
+      std::vector<int> launchOptions(FunctionID id) const override;
+      void setLaunchOption(FunctionID id, int sizeClass, int option) override { launch.set(id, sizeClass, option); }
+
+      GraphExec* instantiate(const Graph& graph) override;
+
+      // Dispatch functions
+      // f: float, b: buffer, B: in/out buffer. The final buffer is always an out-only buffer (shown as B)
+      // Buffers are *always* followed by: length, offset, stride
+
+      // general vector functions
+      float* vect_bB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                            float* result, long len, long offset, long stride) override;
+      float* vect_bfB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                             float sa,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_fbB(FunctionID id, long n, float sa,
+                                             const float* a, long lena, long offset_a, long stride_a,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_bbB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                             const float* b, long lenb, long offset_b, long stride_b,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_bBB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                             float* b, long lenb, long offset_b, long stride_b,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_bffffB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                                float sa, float sha,
+                                                float sb, float shb,
+                                                float* result, long len, long offset, long stride) override;
+      float* vect_bbffffB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                                 const float* b, long lenb, long offset_b, long stride_b,
+                                                 float sa, float sha,
+                                                 float sb, float shb,
+                                                 float* result, long len, long offset, long stride) override;
+      // general matrix functions
+      float* ge_bB(FunctionID id, long sd, long fd,
+                                  const float* a, long lena, long offset_a, long stride_a,
+                                  float* result, long len, long offset, long stride) override;
+      float* ge_bfB(FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float sa,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_fbB(FunctionID id, long sd, long fd, float sa,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_bbB(FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   const float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_bBB(FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_bffffB(FunctionID id, long sd, long fd,
+                                      const float* a, long lena, long offset_a, long stride_a,
+                                      float sa, float sha,
+                                      float sb, float shb,
+                                      float* result, long len, long offset, long stride) override;
+      float* ge_bbffffB(FunctionID id, long sd, long fd,
+                                       const float* a, long lena, long offset_a, long stride_a,
+                                       const float* b, long lenb, long offset_b, long stride_b,
+                                       float sa, float sha,
+                                       float sb, float shb,
+                                       float* result, long len, long offset, long stride) override;
+      // general uplo functions
+      float* uplo_bB(FunctionID id, long sd, int unit, int bottom,
+                                    const float* a, long lena, long offset_a, long stride_a,
+                                    float* result, long len, long offset, long stride) override;
+      float* uplo_bfB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float sa,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_fbB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float sa,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_bbB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     const float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_bBB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_bffffB(FunctionID id, long sd, int unit, int bottom,
+                                        const float* a, long lena, long offset_a, long stride_a,
+                                        float sa, float sha,
+                                        float sb, float shb,
+                                        float* result, long len, long offset, long stride) override;
+      float* uplo_bbffffB(FunctionID id, long sd, int unit, int bottom,
+                                         const float* a, long lena, long offset_a, long stride_a,
+                                         const float* b, long lenb, long offset_b, long stride_b,
+                                         float sa, float sha,
+                                         float sb, float shb,
+                                         float* result, long len, long offset, long stride) override;
+
+      // linear algebra functions, blocked and split over the pool
+      float* gemm(int transA, int transB, long m, long n, long k, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  const float* b, long lenb, long offset_b, long ldb,
+                  float beta, float* c, long lenc, long offset_c, long ldc) override;
+      float* gemv(int trans, long m, long n, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  const float* x, long lenx, long offset_x, long stride_x,
+                  float beta, float* y, long leny, long offset_y, long stride_y) override;
+      float* ger(long m, long n, float alpha,
+                 const float* x, long lenx, long offset_x, long stride_x,
+                 const float* y, long leny, long offset_y, long stride_y,
+                 float* a, long lena, long offset_a, long lda) override;
+      float* trmv(int trans, long sd, int unit, int bottom,
+                  const float* a, long lena, long offset_a, long lda,
+                  float* x, long lenx, long offset_x, long stride_x) override;
+      float* trsv(int trans, long sd, int unit, int bottom,
+                  const float* a, long lena, long offset_a, long lda,
+                  float* x, long lenx, long offset_x, long stride_x) override;
+      float* trmm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  float* b, long lenb, long offset_b, long ldb) override;
+      float* trsm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  float* b, long lenb, long offset_b, long ldb) override;
+      float* syrk(int trans, long n, long k, int bottom, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  float beta, float* c, long lenc, long offset_c, long ldc) override;
+      float* potrf(long sd, int bottom, float* a, long lena, long offset_a, long lda) override;
+      float* potrs(long sd, long n, int bottom, const float* a, long lena, long offset_a, long lda,
+                   float* b, long lenb, long offset_b, long ldb) override;
+      float* trttp(long sd, int bottom, const float* a, long lena, long offset_a, long lda,
+                   float* ap, long lenap, long offset_ap) override;
+      float* tpttr(long sd, int bottom, const float* ap, long lenap, long offset_ap,
+                   float* a, long lena, long offset_a, long lda) override;
+      float* tpmv(int trans, long sd, int unit, int bottom, const float* ap, long lenap, long offset_ap,
+                  float* x, long lenx, long offset_x, long stride_x) override;
+      float* spmv(long sd, int bottom, float alpha, const float* ap, long lenap, long offset_ap,
+                  const float* x, long lenx, long offset_x, long stride_x,
+                  float beta, float* y, long leny, long offset_y, long stride_y) override;
+      float* omatcopy(int trans, long m, long n, float alpha,
+                      const float* a, long lena, long offset_a, long lda,
+                      float* b, long lenb, long offset_b, long ldb) override;
+
+    private:
+      class GraphTasks;
+
+      struct Resident {
+        size_t bytes;
+        Placement placement;
+        size_t segment;       // bytes per node for FIRST_TOUCH
+      };
+
+      struct NodeCounters {
+        std::atomic<uint64_t> bytes;
+        std::atomic<uint64_t> busyNanos;
+      };
+
+      NumaTopology topology;
+      ThreadPool* pool;
+      long cacheElements;     // floats that fit in half of the L2 cache
+      LaunchTable launch;
+
+      mutable std::mutex residentLock;
+      std::map<const float*, Resident> residents;
+      std::unique_ptr<NodeCounters[]> counters;
+
+      long grain(const CpuKernel& kernel) const;
+      bool nodeSplits(const Run& run, long n, std::vector<long>& splits) const;
+
+      float* vector(FunctionID id, KernelKind kind, long n, const Run& run, const Scalars& s, float* result);
+      float* ge(FunctionID id, KernelKind kind, long sd, long fd, const Run& run, const Scalars& s, float* result);
+      float* uplo(FunctionID id, KernelKind kind, long sd, int unit, int bottom,
+                  const Run& run, const Scalars& s, float* result);
+  };
+
+} // namespace Ferrum
+
+#endif // FERRUM_CPU_ENGINE_HPP
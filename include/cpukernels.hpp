@@ -0,0 +1,53 @@
+#pragma once
+
+#ifndef FERRUM_CPU_KERNELS_HPP
+#define FERRUM_CPU_KERNELS_HPP
+
+#include "functions.hpp"
+
+namespace Ferrum {
+
+  // Host implementations of the kernels in the Metal library.
+  // Each kernel is an elementwise operation, applied over the vector, ge or uplo shape
+  // given by the prefix of its name. The operation itself only ever sees a strided run
+  // of elements: the CPU engine breaks vectors and matrix columns into runs.
+
+  enum class KernelShape { VECTOR, GE, UPLO };
+
+  // UNARY: a -> result, BINARY: a, b -> result, PAIR: a -> b, result
+  enum class KernelKind { UNSUPPORTED, UNARY, BINARY, PAIR };
+
+  struct Scalars {
+    float sa, sha, sb, shb;
+  };
+
+  // One strided run of elements. Unused operands are null.
+  struct Run {
+    const float* a; long inc_a;
+    const float* b; long inc_b;
+    float* q; long inc_q;        // the in/out operand of a PAIR kernel
+    float* r; long inc_r;
+  };
+
+  using RunFn = void (*)(const Run& run, long n, const Scalars& s);
+
+  class Expression;
+
+  struct CpuKernel {
+    KernelShape shape;
+    KernelKind kind;
+    RunFn run;
+    int cost;          // relative cost per element: 1 for memory bound operations like add
+    const Expression* expression = nullptr;   // in place of run, for kernels compiled at run time
+
+    // Computes one run, with the function or the expression
+    void apply(const Run& run, long n, const Scalars& s) const;
+  };
+
+  // The host kernel for a function, built in or compiled (see expression.hpp). Unknown
+  // functions, and those with no host implementation, have the kind UNSUPPORTED.
+  const CpuKernel& cpuKernel(FunctionID id);
+
+} // namespace Ferrum
+
+#endif // FERRUM_CPU_KERNELS_HPP
@@ -3,145 +3,299 @@
 #ifndef METAL_COMPUTE_HPP
 #define METAL_COMPUTE_HPP
 
+#include <atomic>
+#include <mutex>
+#include <dispatch/dispatch.h>
 #include <Metal/Metal.hpp>
 #include <MetalKit/MetalKit.hpp>
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include "FoundationEx.hpp"
+#include "backend.hpp"
+#include "cpukernels.hpp"
 #include "functions.hpp"
-
-#ifdef DEBUG
-#define DBG1(arg1) std::cout << (arg1) << std::endl
-#define DBG2(arg1, arg2) std::cout << (arg1) << (arg2) << std::endl
-#define DBG3(arg1, arg2, arg3) std::cout << (arg1) << (arg2) << (arg3) << std::endl
-#define MACRO_DISPATCH(arg1, arg2, arg3, func, ...) func
-#define DBG(...) MACRO_DISPATCH(__VA_ARGS__, DBG3, DBG2, DBG1)(__VA_ARGS__)
-#else
-#define DBG(...)
-#endif
+#include "kernelcache.hpp"
+#include "pool.hpp"
 
 namespace Ferrum {
 
-  class MetalEngine {
+  // Allocates shared storage Metal buffers for the engine's buffer pool
+  class MetalAllocator {
+    public:
+      using Block = MTL::Buffer*;
+
+      MetalAllocator(MTL::Device* device) : device(device) {}
+
+      Block allocate(size_t bytes) { return device->newBuffer(bytes, MTL::ResourceStorageModeShared); }
+      void free(Block block) { block->release(); }
+      static size_t size(Block block) { return block->length(); }
+
+    private:
+      MTL::Device* device;
+  };
+
+  using MetalPool = BufferPool<MetalAllocator>;
+
+  // Dispatches to the GPU. Submissions are spread over a ring of command queues so that
+  // calls from concurrent threads are encoded and executed in parallel.
+  //
+  // Lengths, offsets and strides are 64-bit, but the kernels index with 32-bit integers, which
+  // is what the GPU computes fastest. A call whose indices all fit in 32 bits is dispatched
+  // as it is. Larger calls are dispatched in windows: each window binds its operands at a byte
+  // offset into their buffers, and covers as many elements or columns as keep the indices
+  // within the window below 2^31.
+  //
+  // A graph is instantiated as an indirect command buffer, encoded once with a command for each
+  // window of each call. Its tensors are kept in shared buffers, so a replay copies the bound
+  // data in, runs every command in one submission, and copies the written tensors out.
+  class MetalEngine : public Backend {
 
-    using BufferAction = std::function<void(std::vector<MTL::Buffer*>&, int)>;
+    using BufferAction = std::function<void(std::vector<MTL::Buffer*>&, long)>;
     BufferAction emptyAction;
 
     public:
-      MetalEngine(const char* path);
+      static const int DEFAULT_QUEUE_COUNT = 4;
+
+      // deviceIndex picks one of the devices listed by MTL::CopyAllDevices
+      MetalEngine(const char* path, int queueCount = DEFAULT_QUEUE_COUNT, int deviceIndex = 0);
       ~MetalEngine();
 
+      // The number of Metal devices on this host
+      static int deviceCount();
+
+      const char* name() const override { return "metal"; }
+
+      // Launch options are threadgroup widths, in multiples of the SIMD width up to the pipeline's maximum
+      std::vector<int> launchOptions(FunctionID id) const override;
+      void setLaunchOption(FunctionID id, int sizeClass, int option) override { launch.set(id, sizeClass, option); }
+
+      GraphExec* instantiate(const Graph& graph) override;
+
+      // Compiled kernels are built from their Metal source into a library of their own, and their
+      // GPU code is kept in the kernel cache (FERRUM_KERNEL_CACHE) for the next process
+      FunctionID compile(const std::string& expression, KernelShape shape = KernelShape::VECTOR) override;
+
       // Dispatch functions
       // f: float, b: buffer, B: in/out buffer. The final buffer is always an out-only buffer (shown as B)
       // Buffers are *always* followed by: length, offset, stride
 
       // general vector functions
-      float* vect_bB(FunctionID id, const float* a, int lena, int offset_a, int stride_a,
-                                    float* result, int len, int offset, int stride);
-      float* vect_bfB(FunctionID id, const float* a, int lena, int offset_a, int stride_a,
-                                     float sa,
-                                     float* result, int len, int offset, int stride);
-      float* vect_fbB(FunctionID id, float sa,
-                                     const float* a, int lena, int offset_a, int stride_a,
-                                     float* result, int len, int offset, int stride);
-      float* vect_bbB(FunctionID id, const float* a, int lena, int offset_a, int stride_a,
-                                     const float* b, int lenb, int offset_b, int stride_b,
-                                     float* result, int len, int offset, int stride);
-      float* vect_bBB(FunctionID id, const float* a, int lena, int offset_a, int stride_a,
-                                     float* b, int lenb, int offset_b, int stride_b,
-                                     float* result, int len, int offset, int stride);
-      float* vect_bffffB(FunctionID id, const float* a, int lena, int offset_a, int stride_a,
-                                        float sa, float sha,
-                                        float sb, float shb,
-                                        float* result, int len, int offset, int stride);
-      float* vect_bbffffB(FunctionID id, const float* a, int lena, int offset_a, int stride_a,
-                                         const float* b, int lenb, int offset_b, int stride_b,
-                                         float sa, float sha,
-                                         float sb, float shb,
-                                         float* result, int len, int offset, int stride);
+      float* vect_bB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                            float* result, long len, long offset, long stride) override;
+      float* vect_bfB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                             float sa,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_fbB(FunctionID id, long n, float sa,
+                                             const float* a, long lena, long offset_a, long stride_a,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_bbB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                             const float* b, long lenb, long offset_b, long stride_b,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_bBB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                             float* b, long lenb, long offset_b, long stride_b,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_bffffB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                                float sa, float sha,
+                                                float sb, float shb,
+                                                float* result, long len, long offset, long stride) override;
+      float* vect_bbffffB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                                 const float* b, long lenb, long offset_b, long stride_b,
+                                                 float sa, float sha,
+                                                 float sb, float shb,
+                                                 float* result, long len, long offset, long stride) override;
       // general matrix functions
-      float* ge_bB(FunctionID id, int sd, int fd,
-                                  const float* a, int lena, int offset_a, int stride_a,
-                                  float* result, int len, int offset, int stride);
-      float* ge_bfB(FunctionID id, int sd, int fd,
-                                   const float* a, int lena, int offset_a, int stride_a,
+      float* ge_bB(FunctionID id, long sd, long fd,
+                                  const float* a, long lena, long offset_a, long stride_a,
+                                  float* result, long len, long offset, long stride) override;
+      float* ge_bfB(FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
                                    float sa,
-                                   float* result, int len, int offset, int stride);
-      float* ge_fbB(FunctionID id, int sd, int fd, float sa,
-                                   const float* a, int lena, int offset_a, int stride_a,
-                                   float* result, int len, int offset, int stride);
-      float* ge_bbB(FunctionID id, int sd, int fd,
-                                   const float* a, int lena, int offset_a, int stride_a,
-                                   const float* b, int lenb, int offset_b, int stride_b,
-                                   float* result, int len, int offset, int stride);
-      float* ge_bBB(FunctionID id, int sd, int fd,
-                                   const float* a, int lena, int offset_a, int stride_a,
-                                   float* b, int lenb, int offset_b, int stride_b,
-                                   float* result, int len, int offset, int stride);
-      float* ge_bffffB(FunctionID id, int sd, int fd,
-                                      const float* a, int lena, int offset_a, int stride_a,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_fbB(FunctionID id, long sd, long fd, float sa,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_bbB(FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   const float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_bBB(FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_bffffB(FunctionID id, long sd, long fd,
+                                      const float* a, long lena, long offset_a, long stride_a,
                                       float sa, float sha,
                                       float sb, float shb,
-                                      float* result, int len, int offset, int stride);
-      float* ge_bbffffB(FunctionID id, int sd, int fd,
-                                       const float* a, int lena, int offset_a, int stride_a,
-                                       const float* b, int lenb, int offset_b, int stride_b,
+                                      float* result, long len, long offset, long stride) override;
+      float* ge_bbffffB(FunctionID id, long sd, long fd,
+                                       const float* a, long lena, long offset_a, long stride_a,
+                                       const float* b, long lenb, long offset_b, long stride_b,
                                        float sa, float sha,
                                        float sb, float shb,
-                                       float* result, int len, int offset, int stride);
+                                       float* result, long len, long offset, long stride) override;
       // general uplo functions
-      float* uplo_bB(FunctionID id, int sd, int unit, int bottom,
-                                    const float* a, int lena, int offset_a, int stride_a,
-                                    float* result, int len, int offset, int stride);
-      float* uplo_bfB(FunctionID id, int sd, int unit, int bottom,
-                                     const float* a, int lena, int offset_a, int stride_a,
+      float* uplo_bB(FunctionID id, long sd, int unit, int bottom,
+                                    const float* a, long lena, long offset_a, long stride_a,
+                                    float* result, long len, long offset, long stride) override;
+      float* uplo_bfB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
                                      float sa,
-                                     float* result, int len, int offset, int stride);
-      float* uplo_fbB(FunctionID id, int sd, int unit, int bottom,
-                                     const float* a, int lena, int offset_a, int stride_a,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_fbB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
                                      float sa,
-                                     float* result, int len, int offset, int stride);
-      float* uplo_bbB(FunctionID id, int sd, int unit, int bottom,
-                                     const float* a, int lena, int offset_a, int stride_a,
-                                     const float* b, int lenb, int offset_b, int stride_b,
-                                     float* result, int len, int offset, int stride);
-      float* uplo_bBB(FunctionID id, int sd, int unit, int bottom,
-                                     const float* a, int lena, int offset_a, int stride_a,
-                                     float* b, int lenb, int offset_b, int stride_b,
-                                     float* result, int len, int offset, int stride);
-      float* uplo_bffffB(FunctionID id, int sd, int unit, int bottom,
-                                        const float* a, int lena, int offset_a, int stride_a,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_bbB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     const float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_bBB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_bffffB(FunctionID id, long sd, int unit, int bottom,
+                                        const float* a, long lena, long offset_a, long stride_a,
                                         float sa, float sha,
                                         float sb, float shb,
-                                        float* result, int len, int offset, int stride);
-      float* uplo_bbffffB(FunctionID id, int sd, int unit, int bottom,
-                                         const float* a, int lena, int offset_a, int stride_a,
-                                         const float* b, int lenb, int offset_b, int stride_b,
+                                        float* result, long len, long offset, long stride) override;
+      float* uplo_bbffffB(FunctionID id, long sd, int unit, int bottom,
+                                         const float* a, long lena, long offset_a, long stride_a,
+                                         const float* b, long lenb, long offset_b, long stride_b,
                                          float sa, float sha,
                                          float sb, float shb,
-                                         float* result, int len, int offset, int stride);
+                                         float* result, long len, long offset, long stride) override;
+
+      // linear algebra functions, on tiles staged in threadgroup memory
+      float* gemm(int transA, int transB, long m, long n, long k, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  const float* b, long lenb, long offset_b, long ldb,
+                  float beta, float* c, long lenc, long offset_c, long ldc) override;
+      float* gemv(int trans, long m, long n, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  const float* x, long lenx, long offset_x, long stride_x,
+                  float beta, float* y, long leny, long offset_y, long stride_y) override;
+      float* ger(long m, long n, float alpha,
+                 const float* x, long lenx, long offset_x, long stride_x,
+                 const float* y, long leny, long offset_y, long stride_y,
+                 float* a, long lena, long offset_a, long lda) override;
+      float* trmv(int trans, long sd, int unit, int bottom,
+                  const float* a, long lena, long offset_a, long lda,
+                  float* x, long lenx, long offset_x, long stride_x) override;
+      float* trsv(int trans, long sd, int unit, int bottom,
+                  const float* a, long lena, long offset_a, long lda,
+                  float* x, long lenx, long offset_x, long stride_x) override;
+      float* trmm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  float* b, long lenb, long offset_b, long ldb) override;
+      float* trsm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  float* b, long lenb, long offset_b, long ldb) override;
+      float* syrk(int trans, long n, long k, int bottom, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  float beta, float* c, long lenc, long offset_c, long ldc) override;
+      float* potrf(long sd, int bottom, float* a, long lena, long offset_a, long lda) override;
+      float* potrs(long sd, long n, int bottom, const float* a, long lena, long offset_a, long lda,
+                   float* b, long lenb, long offset_b, long ldb) override;
+      float* trttp(long sd, int bottom, const float* a, long lena, long offset_a, long lda,
+                   float* ap, long lenap, long offset_ap) override;
+      float* tpttr(long sd, int bottom, const float* ap, long lenap, long offset_ap,
+                   float* a, long lena, long offset_a, long lda) override;
+      float* tpmv(int trans, long sd, int unit, int bottom, const float* ap, long lenap, long offset_ap,
+                  float* x, long lenx, long offset_x, long stride_x) override;
+      float* spmv(long sd, int bottom, float alpha, const float* ap, long lenap, long offset_ap,
+                  const float* x, long lenx, long offset_x, long stride_x,
+                  float beta, float* y, long leny, long offset_y, long stride_y) override;
+      float* omatcopy(int trans, long m, long n, float alpha,
+                      const float* a, long lena, long offset_a, long lda,
+                      float* b, long lenb, long offset_b, long ldb) override;
+
+      // Buffer pool management.
+      // Operand buffers are recycled between calls. Free buffers are cached up to the
+      // high-water mark, and the cache is trimmed when the system reports memory pressure.
+      PoolStats poolStats() const;
+      void setPoolHighWaterMark(size_t bytes);
+      void trimPool();
 
     private:
+      class GraphCommands;
+
       MTL::Device* device;
       MTL::Library* library;
-      MTL::CommandQueue* commandQueue;
+      std::vector<MTL::CommandQueue*> commandQueues;
+      std::atomic<unsigned int> nextQueue;
+      MetalPool* pool;
+      dispatch_source_t memoryPressureSource;
+      // signalled by the source's cancel handler, once no event handler can still be running
+      dispatch_semaphore_t pressureCancelled;
       MTL::Function** function;
       // for now, keep track of the function pipeline states in a map
       int fnCount;
       MTL::Function** kernelFunctions;
       MTL::ComputePipelineState** computePipelineStates;
+      // compiled kernels, by the order they were compiled in, and set once each
+      std::mutex compileLock;
+      MTL::Function** compiledFunctions;
+      std::atomic<MTL::ComputePipelineState*>* compiledStates;
+      // compiled kernels built before, on this host or by another process
+      KernelCache* kernelCache;
+      LaunchTable launch;
 
+      // The pipeline of a built-in or compiled function, or nullptr
+      MTL::ComputePipelineState* pipelineState(FunctionID id) const;
+      // The pipeline of a compiled kernel, through the kernel cache
+      MTL::ComputePipelineState* cachedPipeline(MTL::Function* function, const std::string& source, NS::Error** error);
+
+      // Selects the queue for the next submission
+      MTL::CommandQueue* commandQueue();
+
+      // Pooled buffers: inputs are filled from the caller's data.
+      // Outputs are left uninitialized when the kernel will write every element (dense).
+      MTL::Buffer* inputBuffer(const float* data, long len);
+      MTL::Buffer* outputBuffer(float* result, long len, bool dense);
+
+      // An operand's offset, and its stride (vectors) or leading dimension (matrices)
+      struct Layout {
+        long offset;
+        long stride;
+      };
+
+      // An operand as the kernel sees it in one window
+      struct View {
+        NS::UInteger bytes;    // where the buffer is bound
+        int32_t offset;
+        int32_t stride;
+      };
+
+      // One dispatch of rows x cols threads (cols is 1 for vectors)
+      struct Window {
+        int32_t rows;
+        int32_t cols;
+        View views[3];
+      };
+
+      // Cuts a call into windows. Returns false if an index cannot be brought within 32 bits.
+      static bool windows(KernelShape shape, long rows, long cols, const std::vector<Layout>& layouts,
+                          std::vector<Window>& out);
+      // Binds a buffer with its offset and stride, which the kernels always take in that order
+      static void setView(MTL::ComputeCommandEncoder* encoder, MTL::Buffer* buffer, const View& view, int index);
+
+      // The result buffer holds len elements of the result, from element first
       template<typename CreateBuffers, typename SetBuffers, typename CopyResults>
-      float* call_metal(FunctionID id,
-                        float* result, int len, int offset, int stride,
+      float* call_metal(FunctionID id, KernelShape shape, long rows, long cols, const std::vector<Layout>& layouts,
+                        float* result, long first, long len,
                         CreateBuffers createBuffers, SetBuffers setBuffers, CopyResults copyResults);
+      // Runs whole threadgroups of a kernel that sizes its own work, such as a tiled one. The last
+      // buffer holds the result, which is copied back over len elements.
+      template<typename CreateBuffers, typename SetBuffers>
+      float* call_groups(FunctionID id, MTL::Size groups, MTL::Size groupSize, float* result, long len,
+                         CreateBuffers createBuffers, SetBuffers setBuffers);
+      // Encodes any number of dispatches over the same buffers into one command buffer, as a
+      // function of several steps does. The last buffer holds the result, copied back as above.
+      template<typename CreateBuffers, typename Encode>
+      float* call_encoded(float* result, long len, CreateBuffers createBuffers, Encode encode);
   };
 
-  inline FunctionID getFunctionID(const std::string& name) {
-    auto it = functionMap->find(name);
-    return (it == functionMap->end()) ? FunctionID::UNKNOWN : it->second;
-  }
-
 } // namespace Ferrum
 
 #endif // METAL_COMPUTE_HPP
@@ -0,0 +1,115 @@
+#pragma once
+
+#ifndef FERRUM_EXPRESSION_HPP
+#define FERRUM_EXPRESSION_HPP
+
+#include <string>
+#include <vector>
+
+#include "cpukernels.hpp"
+#include "functions.hpp"
+
+namespace Ferrum {
+
+  // An elementwise formula over the operands a and b and the scalars sa, sha, sb and shb,
+  // compiled into a kernel at run time, such as:
+  //
+  //   a * sigmoid(b) + sa
+  //
+  // Expressions have the operators + - * / and ^ (a power), parentheses, numbers, and the
+  // functions abs, exp, exp2, log, log2, log10, sqrt, rsqrt, cbrt, sin, cos, tan, asin, acos,
+  // atan, sinh, cosh, tanh, floor, ceil, round, trunc, sigmoid and relu, of one argument,
+  // and pow, min, max, atan2, fmod and copysign, of two.
+  //
+  // On the host an expression runs as a small program over blocks of elements: each step
+  // is a loop over one block, so that the loops are tight and the block stays in cache.
+  // For Metal it is written out as the source of a kernel.
+  class Expression {
+    public:
+      // Parses an expression, or reports the error and returns nullptr
+      static Expression* parse(const std::string& source);
+
+      const std::string& source() const { return text; }
+      // UNARY over a alone, or BINARY over a and b
+      KernelKind kind() const { return usesB ? KernelKind::BINARY : KernelKind::UNARY; }
+      // The scalars a call passes (0, 1 or 4), which pick the dispatch form of the kernel:
+      // bB, bfB (sa alone) or bffffB when UNARY, and bbB or bbffffB (any scalar) when BINARY
+      int scalars() const;
+      int cost() const { return weight; }
+
+      // Computes one strided run, as a host kernel does
+      void run(const Run& run, long n, const Scalars& s) const;
+      // The Metal source of a kernel with this name, for a shape, that takes its arguments
+      // in the order that the dispatch form binds them
+      std::string metalSource(const std::string& name, KernelShape shape) const;
+
+    private:
+      enum class Code {
+        A, B, NUMBER, SA, SHA, SB, SHB, NEG, ADD, SUB, MUL, DIV, POW, MIN, MAX, ATAN2, FMOD, COPYSIGN,
+        ABS, EXP, EXP2, LOG, LOG2, LOG10, SQRT, RSQRT, CBRT, SIN, COS, TAN, ASIN, ACOS, ATAN,
+        SINH, COSH, TANH, FLOOR, CEIL, ROUND, TRUNC, SIGMOID, RELU
+      };
+
+      // A node of the parsed expression. Leaves have no children.
+      struct Node {
+        Code code;
+        float value;
+        int x, y;
+      };
+
+      // One step of the host program, from and to slots of one block each
+      struct Step {
+        Code code;
+        float value;
+        int to, x, y;
+      };
+
+      struct Function;
+      class Parser;
+
+      static const Function FUNCTIONS[];
+      static const Function* function(Code code);
+
+      std::string text;
+      std::vector<Node> nodes;
+      int root;
+      std::vector<Step> program;
+      int slots;
+      bool usesB;
+      bool usesSa;
+      bool usesShifts;       // sha, sb or shb
+      int weight;
+
+      Expression() : root(-1), slots(0), usesB(false), usesSa(false), usesShifts(false), weight(1) {}
+      void emit(int node, int depth);
+      std::string metal(int node) const;
+  };
+
+  // The most kernels a process may compile
+  const int MAX_COMPILED_KERNELS = 1024;
+
+  // A kernel compiled from an expression for one shape
+  struct CompiledKernel {
+    FunctionID id;
+    int index;             // from 0, in the order kernels were compiled
+    std::string name;      // the name of its Metal kernel
+    KernelShape shape;
+    const Expression* expression;
+    CpuKernel kernel;
+  };
+
+  // Compiles an expression for a shape, and returns the FunctionID to dispatch it with.
+  // Compiled kernels are numbered after the built-in functions, and last for the life of
+  // the process. Compiling the same expression for the same shape again returns the same
+  // id. Returns UNKNOWN if the expression does not parse, or too many have been compiled.
+  FunctionID compileKernel(const std::string& source, KernelShape shape);
+
+  // The compiled kernel with an id, or nullptr for a built-in function
+  const CompiledKernel* compiledKernel(FunctionID id);
+
+  // The name of a built-in or compiled kernel, for messages. Never nullptr.
+  const char* kernelName(FunctionID id);
+
+} // namespace Ferrum
+
+#endif // FERRUM_EXPRESSION_HPP
@@ -0,0 +1,512 @@
+// This file is auto-generated
+
+#pragma once
+
+#ifndef _FUNCTIONS_HPP
+#define _FUNCTIONS_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace Ferrum {
+
+  enum FunctionID : int {
+    UNKNOWN = -1,
+    blas_gemm = 0,
+    blas_gemv_n = 1,
+    blas_gemv_t = 2,
+    blas_ger = 3,
+    blas_omatcopy = 4,
+    blas_potrf = 5,
+    blas_spmv = 6,
+    blas_syrk = 7,
+    blas_tpmv = 8,
+    blas_tpttr = 9,
+    blas_trmm = 10,
+    blas_trmv = 11,
+    blas_trsm = 12,
+    blas_trsv = 13,
+    blas_trttp = 14,
+    ge_abs = 15,
+    ge_acos = 16,
+    ge_acosh = 17,
+    ge_add = 18,
+    ge_asin = 19,
+    ge_asinh = 20,
+    ge_atan = 21,
+    ge_atan2 = 22,
+    ge_atanh = 23,
+    ge_cbrt = 24,
+    ge_cdf_norm = 25,
+    ge_cdf_norm_inv = 26,
+    ge_ceil = 27,
+    ge_copysign = 28,
+    ge_cos = 29,
+    ge_cosh = 30,
+    ge_div = 31,
+    ge_elu = 32,
+    ge_erf = 33,
+    ge_erf_inv = 34,
+    ge_erfc = 35,
+    ge_erfcinv = 36,
+    ge_exp = 37,
+    ge_exp10 = 38,
+    ge_exp2 = 39,
+    ge_expm1 = 40,
+    ge_floor = 41,
+    ge_fmax = 42,
+    ge_fmin = 43,
+    ge_fmod = 44,
+    ge_frac = 45,
+    ge_frem = 46,
+    ge_gamma = 47,
+    ge_hypot = 48,
+    ge_inv = 49,
+    ge_inv_cbrt = 50,
+    ge_inv_sqrt = 51,
+    ge_lgamma = 52,
+    ge_linear_frac = 53,
+    ge_log = 54,
+    ge_log10 = 55,
+    ge_log1p = 56,
+    ge_log2 = 57,
+    ge_modf = 58,
+    ge_mul = 59,
+    ge_pow = 60,
+    ge_pow2o3 = 61,
+    ge_pow3o2 = 62,
+    ge_powx = 63,
+    ge_ramp = 64,
+    ge_relu = 65,
+    ge_round = 66,
+    ge_scale_shift = 67,
+    ge_sigmoid = 68,
+    ge_sin = 69,
+    ge_sincos = 70,
+    ge_sinh = 71,
+    ge_sqr = 72,
+    ge_sqrt = 73,
+    ge_sub = 74,
+    ge_tan = 75,
+    ge_tanh = 76,
+    ge_trunc = 77,
+    uplo_abs = 78,
+    uplo_acos = 79,
+    uplo_acosh = 80,
+    uplo_add = 81,
+    uplo_asin = 82,
+    uplo_asinh = 83,
+    uplo_atan = 84,
+    uplo_atan2 = 85,
+    uplo_atanh = 86,
+    uplo_cbrt = 87,
+    uplo_cdf_norm = 88,
+    uplo_cdf_norm_inv = 89,
+    uplo_ceil = 90,
+    uplo_copysign = 91,
+    uplo_cos = 92,
+    uplo_cosh = 93,
+    uplo_div = 94,
+    uplo_elu = 95,
+    uplo_erf = 96,
+    uplo_erf_inv = 97,
+    uplo_erfc = 98,
+    uplo_erfc_inv = 99,
+    uplo_exp = 100,
+    uplo_exp10 = 101,
+    uplo_exp2 = 102,
+    uplo_expm1 = 103,
+    uplo_floor = 104,
+    uplo_fmax = 105,
+    uplo_fmin = 106,
+    uplo_fmod = 107,
+    uplo_frac = 108,
+    uplo_frem = 109,
+    uplo_gamma = 110,
+    uplo_hypot = 111,
+    uplo_inv = 112,
+    uplo_inv_cbrt = 113,
+    uplo_inv_sqrt = 114,
+    uplo_lgamma = 115,
+    uplo_linear_frac = 116,
+    uplo_log = 117,
+    uplo_log10 = 118,
+    uplo_log1p = 119,
+    uplo_log2 = 120,
+    uplo_modf = 121,
+    uplo_mul = 122,
+    uplo_pow = 123,
+    uplo_pow2o3 = 124,
+    uplo_pow3o2 = 125,
+    uplo_powx = 126,
+    uplo_ramp = 127,
+    uplo_relu = 128,
+    uplo_round = 129,
+    uplo_scale_shift = 130,
+    uplo_sigmoid = 131,
+    uplo_sin = 132,
+    uplo_sincos = 133,
+    uplo_sinh = 134,
+    uplo_sqr = 135,
+    uplo_sqrt = 136,
+    uplo_sub = 137,
+    uplo_tan = 138,
+    uplo_tanh = 139,
+    uplo_trunc = 140,
+    vector_abs = 141,
+    vector_acos = 142,
+    vector_acosh = 143,
+    vector_add = 144,
+    vector_asin = 145,
+    vector_asinh = 146,
+    vector_atan = 147,
+    vector_atan2 = 148,
+    vector_atanh = 149,
+    vector_cbrt = 150,
+    vector_cdf_norm = 151,
+    vector_cdf_norm_inv = 152,
+    vector_ceil = 153,
+    vector_copy = 154,
+    vector_copysign = 155,
+    vector_cos = 156,
+    vector_cosh = 157,
+    vector_div = 158,
+    vector_elu = 159,
+    vector_equals = 160,
+    vector_erf = 161,
+    vector_erf_inv = 162,
+    vector_erfc = 163,
+    vector_erfc_inv = 164,
+    vector_exp = 165,
+    vector_exp10 = 166,
+    vector_exp2 = 167,
+    vector_expm1 = 168,
+    vector_floor = 169,
+    vector_fmax = 170,
+    vector_fmin = 171,
+    vector_fmod = 172,
+    vector_frac = 173,
+    vector_frem = 174,
+    vector_gamma = 175,
+    vector_hypot = 176,
+    vector_inv = 177,
+    vector_inv_cbrt = 178,
+    vector_inv_sqrt = 179,
+    vector_lgamma = 180,
+    vector_linear_frac = 181,
+    vector_log = 182,
+    vector_log10 = 183,
+    vector_log1p = 184,
+    vector_log2 = 185,
+    vector_modf = 186,
+    vector_mul = 187,
+    vector_pow = 188,
+    vector_pow2o3 = 189,
+    vector_pow3o2 = 190,
+    vector_powx = 191,
+    vector_ramp = 192,
+    vector_relu = 193,
+    vector_round = 194,
+    vector_scale_shift = 195,
+    vector_set = 196,
+    vector_sigmoid = 197,
+    vector_sin = 198,
+    vector_sincos = 199,
+    vector_sinh = 200,
+    vector_sqr = 201,
+    vector_sqrt = 202,
+    vector_sub = 203,
+    vector_swap = 204,
+    vector_tan = 205,
+    vector_tanh = 206,
+    vector_trunc = 207
+  };
+
+  const int FUNCTION_COUNT = 208;
+
+  // A kernel's operand buffers that are only read, the buffers it writes (and may also read),
+  // and its float scalars
+  struct FunctionInfo {
+    const char* name;
+    int inputs;
+    int outputs;
+    int scalars;
+  };
+
+  inline constexpr FunctionInfo FUNCTION_INFO[FUNCTION_COUNT] = {
+    {"blas_gemm", 2, 1, 2},
+    {"blas_gemv_n", 2, 1, 2},
+    {"blas_gemv_t", 2, 1, 2},
+    {"blas_ger", 2, 1, 1},
+    {"blas_omatcopy", 1, 1, 1},
+    {"blas_potrf", 0, 1, 0},
+    {"blas_spmv", 2, 1, 2},
+    {"blas_syrk", 1, 1, 2},
+    {"blas_tpmv", 2, 1, 0},
+    {"blas_tpttr", 1, 1, 0},
+    {"blas_trmm", 2, 1, 1},
+    {"blas_trmv", 2, 1, 0},
+    {"blas_trsm", 1, 1, 1},
+    {"blas_trsv", 1, 1, 0},
+    {"blas_trttp", 1, 1, 0},
+    {"ge_abs", 1, 1, 0},
+    {"ge_acos", 1, 1, 0},
+    {"ge_acosh", 1, 1, 0},
+    {"ge_add", 2, 1, 0},
+    {"ge_asin", 1, 1, 0},
+    {"ge_asinh", 1, 1, 0},
+    {"ge_atan", 1, 1, 0},
+    {"ge_atan2", 2, 1, 0},
+    {"ge_atanh", 1, 1, 0},
+    {"ge_cbrt", 1, 1, 0},
+    {"ge_cdf_norm", 1, 1, 0},
+    {"ge_cdf_norm_inv", 1, 1, 0},
+    {"ge_ceil", 1, 1, 0},
+    {"ge_copysign", 2, 1, 0},
+    {"ge_cos", 1, 1, 0},
+    {"ge_cosh", 1, 1, 0},
+    {"ge_div", 2, 1, 0},
+    {"ge_elu", 1, 1, 1},
+    {"ge_erf", 1, 1, 0},
+    {"ge_erf_inv", 1, 1, 0},
+    {"ge_erfc", 1, 1, 0},
+    {"ge_erfcinv", 1, 1, 0},
+    {"ge_exp", 1, 1, 0},
+    {"ge_exp10", 1, 1, 0},
+    {"ge_exp2", 1, 1, 0},
+    {"ge_expm1", 1, 1, 0},
+    {"ge_floor", 1, 1, 0},
+    {"ge_fmax", 2, 1, 0},
+    {"ge_fmin", 2, 1, 0},
+    {"ge_fmod", 2, 1, 0},
+    {"ge_frac", 1, 1, 0},
+    {"ge_frem", 2, 1, 0},
+    {"ge_gamma", 1, 1, 0},
+    {"ge_hypot", 2, 1, 0},
+    {"ge_inv", 1, 1, 0},
+    {"ge_inv_cbrt", 1, 1, 0},
+    {"ge_inv_sqrt", 1, 1, 0},
+    {"ge_lgamma", 1, 1, 0},
+    {"ge_linear_frac", 2, 1, 4},
+    {"ge_log", 1, 1, 0},
+    {"ge_log10", 1, 1, 0},
+    {"ge_log1p", 1, 1, 0},
+    {"ge_log2", 1, 1, 0},
+    {"ge_modf", 1, 2, 0},
+    {"ge_mul", 2, 1, 0},
+    {"ge_pow", 2, 1, 0},
+    {"ge_pow2o3", 1, 1, 0},
+    {"ge_pow3o2", 1, 1, 0},
+    {"ge_powx", 1, 1, 1},
+    {"ge_ramp", 1, 1, 0},
+    {"ge_relu", 1, 1, 1},
+    {"ge_round", 1, 1, 0},
+    {"ge_scale_shift", 1, 1, 4},
+    {"ge_sigmoid", 1, 1, 0},
+    {"ge_sin", 1, 1, 0},
+    {"ge_sincos", 1, 2, 0},
+    {"ge_sinh", 1, 1, 0},
+    {"ge_sqr", 1, 1, 0},
+    {"ge_sqrt", 1, 1, 0},
+    {"ge_sub", 2, 1, 0},
+    {"ge_tan", 1, 1, 0},
+    {"ge_tanh", 1, 1, 0},
+    {"ge_trunc", 1, 1, 0},
+    {"uplo_abs", 1, 1, 0},
+    {"uplo_acos", 1, 1, 0},
+    {"uplo_acosh", 1, 1, 0},
+    {"uplo_add", 2, 1, 0},
+    {"uplo_asin", 1, 1, 0},
+    {"uplo_asinh", 1, 1, 0},
+    {"uplo_atan", 1, 1, 0},
+    {"uplo_atan2", 2, 1, 0},
+    {"uplo_atanh", 1, 1, 0},
+    {"uplo_cbrt", 1, 1, 0},
+    {"uplo_cdf_norm", 1, 1, 0},
+    {"uplo_cdf_norm_inv", 1, 1, 0},
+    {"uplo_ceil", 1, 1, 0},
+    {"uplo_copysign", 2, 1, 0},
+    {"uplo_cos", 1, 1, 0},
+    {"uplo_cosh", 1, 1, 0},
+    {"uplo_div", 2, 1, 0},
+    {"uplo_elu", 1, 1, 1},
+    {"uplo_erf", 1, 1, 0},
+    {"uplo_erf_inv", 1, 1, 0},
+    {"uplo_erfc", 1, 1, 0},
+    {"uplo_erfc_inv", 1, 1, 0},
+    {"uplo_exp", 1, 1, 0},
+    {"uplo_exp10", 1, 1, 0},
+    {"uplo_exp2", 1, 1, 0},
+    {"uplo_expm1", 1, 1, 0},
+    {"uplo_floor", 1, 1, 0},
+    {"uplo_fmax", 2, 1, 0},
+    {"uplo_fmin", 2, 1, 0},
+    {"uplo_fmod", 2, 1, 0},
+    {"uplo_frac", 1, 1, 0},
+    {"uplo_frem", 2, 1, 0},
+    {"uplo_gamma", 1, 1, 0},
+    {"uplo_hypot", 2, 1, 0},
+    {"uplo_inv", 1, 1, 0},
+    {"uplo_inv_cbrt", 1, 1, 0},
+    {"uplo_inv_sqrt", 1, 1, 0},
+    {"uplo_lgamma", 1, 1, 0},
+    {"uplo_linear_frac", 2, 1, 4},
+    {"uplo_log", 1, 1, 0},
+    {"uplo_log10", 1, 1, 0},
+    {"uplo_log1p", 1, 1, 0},
+    {"uplo_log2", 1, 1, 0},
+    {"uplo_modf", 1, 2, 0},
+    {"uplo_mul", 2, 1, 0},
+    {"uplo_pow", 2, 1, 0},
+    {"uplo_pow2o3", 1, 1, 0},
+    {"uplo_pow3o2", 1, 1, 0},
+    {"uplo_powx", 1, 1, 1},
+    {"uplo_ramp", 1, 1, 0},
+    {"uplo_relu", 1, 1, 1},
+    {"uplo_round", 1, 1, 0},
+    {"uplo_scale_shift", 1, 1, 4},
+    {"uplo_sigmoid", 1, 1, 0},
+    {"uplo_sin", 1, 1, 0},
+    {"uplo_sincos", 1, 2, 0},
+    {"uplo_sinh", 1, 1, 0},
+    {"uplo_sqr", 1, 1, 0},
+    {"uplo_sqrt", 1, 1, 0},
+    {"uplo_sub", 2, 1, 0},
+    {"uplo_tan", 1, 1, 0},
+    {"uplo_tanh", 1, 1, 0},
+    {"uplo_trunc", 1, 1, 0},
+    {"vector_abs", 1, 1, 0},
+    {"vector_acos", 1, 1, 0},
+    {"vector_acosh", 1, 1, 0},
+    {"vector_add", 2, 1, 0},
+    {"vector_asin", 1, 1, 0},
+    {"vector_asinh", 1, 1, 0},
+    {"vector_atan", 1, 1, 0},
+    {"vector_atan2", 2, 1, 0},
+    {"vector_atanh", 1, 1, 0},
+    {"vector_cbrt", 1, 1, 0},
+    {"vector_cdf_norm", 1, 1, 0},
+    {"vector_cdf_norm_inv", 1, 1, 0},
+    {"vector_ceil", 1, 1, 0},
+    {"vector_copy", 1, 1, 0},
+    {"vector_copysign", 2, 1, 0},
+    {"vector_cos", 1, 1, 0},
+    {"vector_cosh", 1, 1, 0},
+    {"vector_div", 2, 1, 0},
+    {"vector_elu", 1, 1, 1},
+    {"vector_equals", 2, 0, 0},
+    {"vector_erf", 1, 1, 0},
+    {"vector_erf_inv", 1, 1, 0},
+    {"vector_erfc", 1, 1, 0},
+    {"vector_erfc_inv", 1, 1, 0},
+    {"vector_exp", 1, 1, 0},
+    {"vector_exp10", 1, 1, 0},
+    {"vector_exp2", 1, 1, 0},
+    {"vector_expm1", 1, 1, 0},
+    {"vector_floor", 1, 1, 0},
+    {"vector_fmax", 2, 1, 0},
+    {"vector_fmin", 2, 1, 0},
+    {"vector_fmod", 2, 1, 0},
+    {"vector_frac", 1, 1, 0},
+    {"vector_frem", 2, 1, 0},
+    {"vector_gamma", 1, 1, 0},
+    {"vector_hypot", 2, 1, 0},
+    {"vector_inv", 1, 1, 0},
+    {"vector_inv_cbrt", 1, 1, 0},
+    {"vector_inv_sqrt", 1, 1, 0},
+    {"vector_lgamma", 1, 1, 0},
+    {"vector_linear_frac", 2, 1, 4},
+    {"vector_log", 1, 1, 0},
+    {"vector_log10", 1, 1, 0},
+    {"vector_log1p", 1, 1, 0},
+    {"vector_log2", 1, 1, 0},
+    {"vector_modf", 1, 2, 0},
+    {"vector_mul", 2, 1, 0},
+    {"vector_pow", 2, 1, 0},
+    {"vector_pow2o3", 1, 1, 0},
+    {"vector_pow3o2", 1, 1, 0},
+    {"vector_powx", 1, 1, 1},
+    {"vector_ramp", 1, 1, 0},
+    {"vector_relu", 1, 1, 1},
+    {"vector_round", 1, 1, 0},
+    {"vector_scale_shift", 1, 1, 4},
+    {"vector_set", 0, 1, 1},
+    {"vector_sigmoid", 1, 1, 0},
+    {"vector_sin", 1, 1, 0},
+    {"vector_sincos", 1, 2, 0},
+    {"vector_sinh", 1, 1, 0},
+    {"vector_sqr", 1, 1, 0},
+    {"vector_sqrt", 1, 1, 0},
+    {"vector_sub", 2, 1, 0},
+    {"vector_swap", 0, 2, 0},
+    {"vector_tan", 1, 1, 0},
+    {"vector_tanh", 1, 1, 0},
+    {"vector_trunc", 1, 1, 0}
+  };
+
+  // A perfect hash of the names: the bucket of a name holds the seed that hashes it to its slot,
+  // and the slot holds its id. Empty slots hold 0, whose name does not match.
+  const uint32_t FUNCTION_BUCKETS = 64;
+  const uint32_t FUNCTION_SLOTS = 256;
+
+  inline constexpr uint32_t FUNCTION_SEEDS[FUNCTION_BUCKETS] = {
+      5, 5, 10, 15, 14, 1, 1, 14, 5, 4, 3, 4, 2, 5, 2, 1,
+      2, 24, 3, 12, 8, 7, 9, 2, 33, 1, 4, 8, 30, 3, 6, 3,
+      34, 25, 6, 10, 13, 5, 17, 1, 1, 1, 4, 7, 23, 1, 3, 0,
+      7, 20, 8, 2, 1, 3, 5, 1, 1, 1, 8, 1, 1, 15, 9, 52
+  };
+
+  inline constexpr int16_t FUNCTION_SLOT_IDS[FUNCTION_SLOTS] = {
+      143, 118, 136, 81, 178, 0, 166, 71, 9, 131, 160, 164, 78, 39, 169, 19,
+      101, 174, 0, 0, 134, 135, 204, 132, 187, 95, 75, 80, 74, 194, 145, 60,
+      159, 117, 14, 23, 48, 83, 128, 0, 0, 121, 43, 57, 0, 144, 33, 69,
+      180, 149, 183, 59, 45, 0, 138, 6, 140, 0, 119, 84, 91, 0, 139, 97,
+      30, 77, 158, 125, 186, 0, 0, 28, 141, 182, 0, 0, 40, 37, 0, 200,
+      63, 24, 50, 173, 0, 150, 185, 170, 15, 154, 17, 27, 179, 207, 123, 199,
+      172, 21, 92, 13, 0, 201, 181, 31, 168, 87, 93, 16, 73, 25, 0, 98,
+      113, 0, 202, 109, 44, 102, 0, 70, 68, 79, 161, 0, 0, 196, 205, 137,
+      120, 184, 0, 0, 176, 163, 142, 0, 0, 0, 155, 188, 147, 64, 193, 203,
+      165, 100, 54, 127, 130, 104, 107, 151, 129, 106, 66, 197, 65, 29, 32, 191,
+      5, 34, 0, 67, 11, 0, 0, 18, 58, 177, 0, 4, 20, 56, 190, 162,
+      89, 52, 0, 0, 0, 41, 156, 148, 38, 0, 0, 96, 111, 0, 122, 62,
+      36, 8, 110, 0, 116, 0, 61, 105, 2, 146, 157, 153, 47, 189, 171, 3,
+      115, 99, 90, 195, 112, 51, 22, 192, 126, 1, 152, 88, 42, 114, 0, 55,
+      85, 167, 124, 12, 198, 49, 72, 133, 0, 0, 26, 0, 0, 0, 0, 10,
+      0, 86, 76, 0, 46, 175, 35, 7, 0, 94, 108, 103, 82, 0, 206, 53
+  };
+
+  // FNV-1a, finished with a mix so that every bit of the result depends on every bit of the name
+  constexpr uint32_t functionHash(std::string_view name, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (char c : name) {
+      h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    return h ^ (h >> 16);
+  }
+
+  // The id of a built-in function's name, or UNKNOWN
+  constexpr FunctionID functionID(std::string_view name) {
+    uint32_t seed = FUNCTION_SEEDS[functionHash(name, 0) & (FUNCTION_BUCKETS - 1)];
+    int id = FUNCTION_SLOT_IDS[functionHash(name, seed) & (FUNCTION_SLOTS - 1)];
+    return name == FUNCTION_INFO[id].name ? static_cast<FunctionID>(id) : UNKNOWN;
+  }
+
+  // The operands of a built-in function, or nullptr
+  constexpr const FunctionInfo* functionInfo(FunctionID id) {
+    return id >= 0 && id < FUNCTION_COUNT ? &FUNCTION_INFO[id] : nullptr;
+  }
+
+  // The name of a built-in function, or nullptr
+  constexpr const char* functionName(FunctionID id) {
+    return id >= 0 && id < FUNCTION_COUNT ? FUNCTION_INFO[id].name : nullptr;
+  }
+
+} // namespace Ferrum
+
+#endif // _FUNCTIONS_HPP
+
@@ -0,0 +1,205 @@
+#pragma once
+
+#ifndef FERRUM_GRAPH_HPP
+#define FERRUM_GRAPH_HPP
+
+#include <vector>
+
+#include "backend.hpp"
+#include "cpukernels.hpp"
+
+namespace Ferrum {
+
+  // A recorded sequence of calls, to be replayed many times on new data.
+  //
+  // A graph is captured by declaring its tensors, then making the calls on the graph as on any
+  // backend. Nothing is computed: each call is checked and recorded against the tensors that
+  // its operands lie in. A backend then instantiates the graph once, doing all of its per-call
+  // work up front, and the instance is replayed with other data bound to the tensors.
+  //
+  //   Graph graph;
+  //   int x = graph.tensor(input, n), y = graph.tensor(output, n);
+  //   graph.vect_bB(FunctionID::vector_exp, n, input, n, 0, 1, output, n, 0, 1);
+  //   ...
+  //   GraphExec* exec = engine.instantiate(graph);
+  //   exec->bind(x, nextInput);
+  //   exec->replay();
+  //
+  // Calls are replayed in order, and each sees the results of the ones before it.
+  class Graph : public Backend {
+    public:
+      // The arguments of a dispatch function, after its shape
+      enum class Form { bB, bfB, fbB, bbB, bBB, bffffB, bbffffB };
+
+      // An operand, from the start of a tensor
+      struct Operand {
+        int tensor;        // -1 when the form has no such operand
+        long offset;
+        long stride;
+      };
+
+      struct Op {
+        FunctionID id;
+        KernelShape shape;
+        Form form;
+        long n;            // the elements of a vector, or the rows of a matrix
+        long fd;           // the columns of a ge matrix
+        int unit;
+        int bottom;
+        Scalars s;
+        Operand a, b, r;
+      };
+
+      const char* name() const override { return "graph"; }
+
+      // Declares a tensor of len elements that calls may use, and returns its index.
+      // Instances start with the data bound to it.
+      int tensor(float* data, long len);
+
+      int tensorCount() const { return static_cast<int>(tensors.size()); }
+      long tensorLength(int tensor) const { return tensors[tensor].len; }
+      float* tensorData(int tensor) const { return tensors[tensor].data; }
+      const std::vector<Op>& ops() const { return recorded; }
+      // Forgets every tensor and call
+      void clear() { tensors.clear(); recorded.clear(); }
+
+      // Makes one recorded call on a backend, with data bound to every tensor
+      static float* call(Backend* backend, const Op& op, float* const* data, const long* lens);
+
+      // Dispatch functions record the call and return the result, which is left as it is.
+      // They return nullptr if an operand is not in a tensor, or does not fit in its array.
+      // Buffers are *always* followed by: length, offset, stride
+
+      // general vector functions
+      float* vect_bB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                            float* result, long len, long offset, long stride) override;
+      float* vect_bfB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                             float sa,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_fbB(FunctionID id, long n, float sa,
+                                             const float* a, long lena, long offset_a, long stride_a,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_bbB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                             const float* b, long lenb, long offset_b, long stride_b,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_bBB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                             float* b, long lenb, long offset_b, long stride_b,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_bffffB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                                float sa, float sha,
+                                                float sb, float shb,
+                                                float* result, long len, long offset, long stride) override;
+      float* vect_bbffffB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                                 const float* b, long lenb, long offset_b, long stride_b,
+                                                 float sa, float sha,
+                                                 float sb, float shb,
+                                                 float* result, long len, long offset, long stride) override;
+      // general matrix functions
+      float* ge_bB(FunctionID id, long sd, long fd,
+                                  const float* a, long lena, long offset_a, long stride_a,
+                                  float* result, long len, long offset, long stride) override;
+      float* ge_bfB(FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float sa,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_fbB(FunctionID id, long sd, long fd, float sa,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_bbB(FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   const float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_bBB(FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_bffffB(FunctionID id, long sd, long fd,
+                                      const float* a, long lena, long offset_a, long stride_a,
+                                      float sa, float sha,
+                                      float sb, float shb,
+                                      float* result, long len, long offset, long stride) override;
+      float* ge_bbffffB(FunctionID id, long sd, long fd,
+                                       const float* a, long lena, long offset_a, long stride_a,
+                                       const float* b, long lenb, long offset_b, long stride_b,
+                                       float sa, float sha,
+                                       float sb, float shb,
+                                       float* result, long len, long offset, long stride) override;
+      // general uplo functions
+      float* uplo_bB(FunctionID id, long sd, int unit, int bottom,
+                                    const float* a, long lena, long offset_a, long stride_a,
+                                    float* result, long len, long offset, long stride) override;
+      float* uplo_bfB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float sa,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_fbB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float sa,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_bbB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     const float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_bBB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_bffffB(FunctionID id, long sd, int unit, int bottom,
+                                        const float* a, long lena, long offset_a, long stride_a,
+                                        float sa, float sha,
+                                        float sb, float shb,
+                                        float* result, long len, long offset, long stride) override;
+      float* uplo_bbffffB(FunctionID id, long sd, int unit, int bottom,
+                                         const float* a, long lena, long offset_a, long stride_a,
+                                         const float* b, long lenb, long offset_b, long stride_b,
+                                         float sa, float sha,
+                                         float sb, float shb,
+                                         float* result, long len, long offset, long stride) override;
+
+    private:
+      struct Tensor {
+        float* data;
+        long len;
+      };
+
+      std::vector<Tensor> tensors;
+      std::vector<Op> recorded;
+
+      bool operand(const float* data, long len, long offset, long stride, Operand& out) const;
+      float* record(Op op, const float* a, long lena, long offset_a, long stride_a,
+                    const float* b, long lenb, long offset_b, long stride_b,
+                    float* result, long len, long offset, long stride);
+  };
+
+  // A graph instantiated on a backend. Every tensor starts bound to the data it was captured
+  // with. An instance is not thread safe: replay it from one thread at a time.
+  class GraphExec {
+    public:
+      explicit GraphExec(const Graph& graph);
+      virtual ~GraphExec() {}
+
+      // Binds other data to a tensor. It must hold as many elements as the tensor.
+      virtual void bind(int tensor, float* data) { bound[tensor] = data; }
+      // Makes every call of the graph. Returns false if one fails, and stops there.
+      virtual bool replay() = 0;
+
+    protected:
+      std::vector<Graph::Op> ops;
+      std::vector<float*> bound;
+      std::vector<long> lens;
+  };
+
+  // The instance for backends with nothing to prepare, which makes the recorded calls in turn
+  class CallGraphExec : public GraphExec {
+    public:
+      CallGraphExec(Backend* backend, const Graph& graph) : GraphExec(graph), backend(backend) {}
+
+      bool replay() override;
+
+    private:
+      Backend* backend;
+  };
+
+} // namespace Ferrum
+
+#endif // FERRUM_GRAPH_HPP
@@ -0,0 +1,80 @@
+#pragma once
+
+#ifndef FERRUM_KERNELCACHE_HPP
+#define FERRUM_KERNELCACHE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Ferrum {
+
+  struct KernelCacheStats {
+    long hits;
+    long misses;
+    long stores;
+    long evicted;
+  };
+
+  // Compiled kernels kept on disk between runs, so that a kernel built at run time is only
+  // built once on a host.
+  //
+  // An entry is named by a hash of the kernel's source, the cache version and the target it
+  // was built for (the instruction set, or the GPU and OS), and holds all three ahead of the
+  // compiled data, so that a hash collision or a torn file is a miss rather than a wrong
+  // kernel. Entries live in a directory of their own for each version.
+  //
+  // Any number of processes may share a directory. Entries are written to a temporary file
+  // and renamed into place, so a reader sees a whole entry or none. A load touches the entry,
+  // and when a store takes the directory over its size, the entries used least recently are
+  // removed under a lock file until it fits again.
+  class KernelCache {
+    public:
+      // Bumped whenever compiled data from an older version of Ferrum may no longer load
+      static const int VERSION = 1;
+      static const size_t DEFAULT_MAX_BYTES = static_cast<size_t>(256) << 20;
+
+      // FERRUM_KERNEL_CACHE, if it is set, and otherwise ferrum in the user's cache directory.
+      // An empty FERRUM_KERNEL_CACHE turns the cache off.
+      static std::string defaultDirectory();
+      // The architecture and vector extensions this library was built for, such as x86_64-avx2
+      static std::string hostTarget();
+
+      // An empty directory makes a cache that never hits or stores
+      KernelCache(const std::string& directory, const std::string& target,
+                  size_t maxBytes = DEFAULT_MAX_BYTES);
+
+      bool enabled() const { return !root.empty(); }
+      // The directory of this version's entries
+      const std::string& directory() const { return root; }
+      const std::string& target() const { return host; }
+      // The file an entry for this source is kept in
+      std::string path(const std::string& source) const;
+
+      // Reads the compiled data for a source, and returns false on a miss
+      bool load(const std::string& source, std::string& data);
+      // Writes the compiled data for a source, replacing any entry there is
+      bool store(const std::string& source, const std::string& data);
+      // Removes the entries used least recently until the directory holds at most maxBytes
+      void evict();
+      // The bytes held by the entries
+      size_t size() const;
+
+      KernelCacheStats stats() const { return {hits.load(), misses.load(), stores.load(), evicted.load()}; }
+
+    private:
+      std::string root;
+      std::string host;
+      size_t maxBytes;
+      std::atomic<long> hits;
+      std::atomic<long> misses;
+      std::atomic<long> stores;
+      std::atomic<long> evicted;
+
+      uint64_t hash(const std::string& source) const;
+  };
+
+} // namespace Ferrum
+
+#endif // FERRUM_KERNELCACHE_HPP
@@ -0,0 +1,229 @@
+#pragma once
+
+#ifndef FERRUM_LAZY_HPP
+#define FERRUM_LAZY_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "backend.hpp"
+#include "graph.hpp"
+
+namespace Ferrum {
+
+  struct LazyStats {
+    uint64_t recorded;      // calls deferred
+    uint64_t eliminated;    // calls whose results were never read
+    uint64_t reused;        // calls replaced by an earlier call with the same arguments, or a copy of its result
+    uint64_t merged;        // sin and cos calls merged into one sincos call
+    uint64_t fused;         // calls run tile by tile in a fused chain
+    uint64_t executed;      // calls made on the wrapped backend, counting a fused chain once
+  };
+
+  // An opt-in layer over another backend that defers calls, and optimizes them before they run.
+  //
+  // Calls are checked and recorded as they are made, and return their result without computing
+  // it. The deferred calls form a graph (see graph.hpp) that is run by materialize(), which the
+  // caller makes before reading any result. It is also made when maxPending calls are deferred,
+  // and by the destructor. Arrays must outlive the calls made on them. Before the calls run:
+  //  - Calls with the same function, scalars and inputs as an earlier call, where nothing has
+  //    changed in between, reuse its result, as it is or through a vector copy.
+  //  - vector, ge and uplo sin and cos calls on the same input are merged into one sincos call.
+  //  - Calls whose results are overwritten before they are read, or are left in an array that
+  //    the caller has discarded, are dropped.
+  //  - Runs of vector calls with the same length, whose operands line up element for element,
+  //    are fused: the run is made one tile of fuseTile elements at a time, so that the results
+  //    that pass from call to call stay in cache. Fusion suits host backends, and a fuseTile
+  //    of 0 turns it off, as it should be for the GPU.
+  // The lazy engine owns the wrapped backend.
+  class LazyEngine : public Backend {
+    public:
+      static const long DEFAULT_FUSE_TILE = 1 << 16;
+      static const int DEFAULT_MAX_PENDING = 1024;
+
+      explicit LazyEngine(Backend* backend, long fuseTile = DEFAULT_FUSE_TILE, int maxPending = DEFAULT_MAX_PENDING);
+      ~LazyEngine();
+
+      LazyEngine(const LazyEngine&) = delete;
+      LazyEngine& operator=(const LazyEngine&) = delete;
+
+      const char* name() const override { return "lazy"; }
+
+      // Graphs are instantiated on the wrapped backend
+      GraphExec* instantiate(const Graph& graph) override { return engine->instantiate(graph); }
+      // and kernels compiled there
+      FunctionID compile(const std::string& expression, KernelShape shape = KernelShape::VECTOR) override {
+        return engine->compile(expression, shape);
+      }
+
+      // Marks an array as scratch space until the next materialize: what the deferred calls
+      // leave in it will not be read, so calls that only write there need not run
+      void discard(const float* data, long len);
+      // Runs the deferred calls. Returns false if one of them fails.
+      bool materialize();
+
+      LazyStats stats() const;
+      Backend* backend() { return engine; }
+
+      // Dispatch functions
+      // f: float, b: buffer, B: in/out buffer. The final buffer is always an out-only buffer (shown as B)
+      // Buffers are *always* followed by: length, offset, stride
+
+      // general vector functions
+      float* vect_bB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                            float* result, long len, long offset, long stride) override;
+      float* vect_bfB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                             float sa,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_fbB(FunctionID id, long n, float sa,
+                                             const float* a, long lena, long offset_a, long stride_a,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_bbB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                             const float* b, long lenb, long offset_b, long stride_b,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_bBB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                             float* b, long lenb, long offset_b, long stride_b,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_bffffB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                                float sa, float sha,
+                                                float sb, float shb,
+                                                float* result, long len, long offset, long stride) override;
+      float* vect_bbffffB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                                 const float* b, long lenb, long offset_b, long stride_b,
+                                                 float sa, float sha,
+                                                 float sb, float shb,
+                                                 float* result, long len, long offset, long stride) override;
+      // general matrix functions
+      float* ge_bB(FunctionID id, long sd, long fd,
+                                  const float* a, long lena, long offset_a, long stride_a,
+                                  float* result, long len, long offset, long stride) override;
+      float* ge_bfB(FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float sa,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_fbB(FunctionID id, long sd, long fd, float sa,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_bbB(FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   const float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_bBB(FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_bffffB(FunctionID id, long sd, long fd,
+                                      const float* a, long lena, long offset_a, long stride_a,
+                                      float sa, float sha,
+                                      float sb, float shb,
+                                      float* result, long len, long offset, long stride) override;
+      float* ge_bbffffB(FunctionID id, long sd, long fd,
+                                       const float* a, long lena, long offset_a, long stride_a,
+                                       const float* b, long lenb, long offset_b, long stride_b,
+                                       float sa, float sha,
+                                       float sb, float shb,
+                                       float* result, long len, long offset, long stride) override;
+      // general uplo functions
+      float* uplo_bB(FunctionID id, long sd, int unit, int bottom,
+                                    const float* a, long lena, long offset_a, long stride_a,
+                                    float* result, long len, long offset, long stride) override;
+      float* uplo_bfB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float sa,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_fbB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float sa,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_bbB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     const float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_bBB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_bffffB(FunctionID id, long sd, int unit, int bottom,
+                                        const float* a, long lena, long offset_a, long stride_a,
+                                        float sa, float sha,
+                                        float sb, float shb,
+                                        float* result, long len, long offset, long stride) override;
+      float* uplo_bbffffB(FunctionID id, long sd, int unit, int bottom,
+                                         const float* a, long lena, long offset_a, long stride_a,
+                                         const float* b, long lenb, long offset_b, long stride_b,
+                                         float sa, float sha,
+                                         float sb, float shb,
+                                         float* result, long len, long offset, long stride) override;
+
+      // linear algebra functions run at once, after the deferred calls
+      float* gemm(int transA, int transB, long m, long n, long k, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  const float* b, long lenb, long offset_b, long ldb,
+                  float beta, float* c, long lenc, long offset_c, long ldc) override;
+      float* gemv(int trans, long m, long n, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  const float* x, long lenx, long offset_x, long stride_x,
+                  float beta, float* y, long leny, long offset_y, long stride_y) override;
+      float* ger(long m, long n, float alpha,
+                 const float* x, long lenx, long offset_x, long stride_x,
+                 const float* y, long leny, long offset_y, long stride_y,
+                 float* a, long lena, long offset_a, long lda) override;
+      float* trmv(int trans, long sd, int unit, int bottom,
+                  const float* a, long lena, long offset_a, long lda,
+                  float* x, long lenx, long offset_x, long stride_x) override;
+      float* trsv(int trans, long sd, int unit, int bottom,
+                  const float* a, long lena, long offset_a, long lda,
+                  float* x, long lenx, long offset_x, long stride_x) override;
+      float* trmm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  float* b, long lenb, long offset_b, long ldb) override;
+      float* trsm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  float* b, long lenb, long offset_b, long ldb) override;
+      float* syrk(int trans, long n, long k, int bottom, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  float beta, float* c, long lenc, long offset_c, long ldc) override;
+      float* potrf(long sd, int bottom, float* a, long lena, long offset_a, long lda) override;
+      float* potrs(long sd, long n, int bottom, const float* a, long lena, long offset_a, long lda,
+                   float* b, long lenb, long offset_b, long ldb) override;
+      float* trttp(long sd, int bottom, const float* a, long lena, long offset_a, long lda,
+                   float* ap, long lenap, long offset_ap) override;
+      float* tpttr(long sd, int bottom, const float* ap, long lenap, long offset_ap,
+                   float* a, long lena, long offset_a, long lda) override;
+      float* tpmv(int trans, long sd, int unit, int bottom, const float* ap, long lenap, long offset_ap,
+                  float* x, long lenx, long offset_x, long stride_x) override;
+      float* spmv(long sd, int bottom, float alpha, const float* ap, long lenap, long offset_ap,
+                  const float* x, long lenx, long offset_x, long stride_x,
+                  float beta, float* y, long leny, long offset_y, long stride_y) override;
+      float* omatcopy(int trans, long m, long n, float alpha,
+                      const float* a, long lena, long offset_a, long lda,
+                      float* b, long lenb, long offset_b, long ldb) override;
+
+    private:
+      struct Scratch {
+        const float* data;
+        long len;
+      };
+
+      Backend* engine;
+      long fuseTile;
+      int maxPending;
+
+      mutable std::mutex lock;
+      Graph pending;
+      std::vector<Scratch> scratch;
+      LazyStats counters;
+
+      // Declares an array as a tensor of the pending graph, unless one already holds it
+      void declare(const float* data, long len);
+      // Counts a recorded call, and materializes if the graph has grown to maxPending calls
+      float* deferred(float* result);
+      // Optimizes and makes the pending calls. The final run before the caller reads the
+      // results may drop what is left in scratch arrays.
+      bool run(bool final);
+  };
+
+} // namespace Ferrum
+
+#endif // FERRUM_LAZY_HPP
@@ -0,0 +1,51 @@
+#pragma once
+
+#ifndef FERRUM_NUMA_HPP
+#define FERRUM_NUMA_HPP
+
+#include <cstddef>
+#include <vector>
+
+namespace Ferrum {
+
+  // How the pages of a resident tensor are spread over NUMA nodes
+  enum class Placement {
+    DEFAULT,       // wherever the kernel puts them, usually the node of the first thread to write
+    FIRST_TOUCH,   // split into one contiguous segment per node, each written first by its own node
+    INTERLEAVED    // pages dealt round robin over all nodes
+  };
+
+  struct NumaNode {
+    int id;
+    std::vector<int> cpus;
+  };
+
+  // The NUMA nodes of a host, and the CPUs that belong to each.
+  // On Linux these are read from sysfs. Other hosts are reported as a single node.
+  // A topology can also be described directly, to exercise node scheduling on a single node host.
+  class NumaTopology {
+    public:
+      explicit NumaTopology(const std::vector<NumaNode>& nodes);
+
+      // The topology of this host, detected once
+      static const NumaTopology& host();
+
+      const std::vector<NumaNode>& nodes() const { return nodeList; }
+      int nodeCount() const { return static_cast<int>(nodeList.size()); }
+      // The index of the node that holds a CPU, or 0 when the CPU is unknown
+      int nodeOfCpu(int cpu) const;
+      // Every CPU, grouped node by node
+      std::vector<int> cpus() const;
+
+      // Memory policy hints. These return false where the policy cannot be applied,
+      // such as on hosts without NUMA support, in which case memory is placed by default.
+      bool preferNode(void* data, size_t bytes, int node) const;
+      bool interleave(void* data, size_t bytes) const;
+
+    private:
+      std::vector<NumaNode> nodeList;
+  };
+
+} // namespace Ferrum
+
+#endif // FERRUM_NUMA_HPP
@@ -0,0 +1,213 @@
+#pragma once
+
+#ifndef FERRUM_POOL_HPP
+#define FERRUM_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace Ferrum {
+
+  // Counters reported by a BufferPool. Bytes are measured in size-class units,
+  // so they reflect the memory actually held rather than the sizes requested.
+  struct PoolStats {
+    uint64_t hits;           // acquisitions satisfied from a free list
+    uint64_t misses;         // acquisitions that had to allocate
+    uint64_t evictions;      // blocks freed by trimming or the high-water mark
+    size_t residentBytes;    // all bytes allocated by the pool, in use or free
+    size_t inUseBytes;       // bytes currently handed out to callers
+    size_t highWaterMark;    // the most free bytes the pool will cache
+
+    double hitRate() const {
+      uint64_t total = hits + misses;
+      return total == 0 ? 0.0 : static_cast<double>(hits) / total;
+    }
+  };
+
+  // Rounds a request up to its power-of-two size class.
+  // Returns the class index, and sets classBytes to the size of that class.
+  int sizeClass(size_t bytes, size_t& classBytes);
+
+  // A cache of reusable blocks, binned by power-of-two size class.
+  // The Allocator provides the underlying memory:
+  //   Block Allocator::allocate(size_t bytes);  returns a null-equivalent Block on failure
+  //   void Allocator::free(Block block);
+  //   size_t Allocator::size(Block block);      the allocated (class) size of the block
+  // Released blocks are kept for reuse until the free bytes would pass the high-water mark,
+  // at which point the released block goes straight back to the allocator.
+  // All operations lock the pool, so trim may be called from a memory pressure handler.
+  template<typename Allocator>
+  class BufferPool {
+    public:
+      using Block = typename Allocator::Block;
+
+      static const size_t DEFAULT_HIGH_WATER_MARK = 256 * 1024 * 1024;
+
+      BufferPool(Allocator allocator, size_t highWaterMark = DEFAULT_HIGH_WATER_MARK);
+      ~BufferPool();
+
+      BufferPool(const BufferPool&) = delete;
+      BufferPool& operator=(const BufferPool&) = delete;
+
+      // Returns a block of at least the requested size
+      Block acquire(size_t bytes);
+      // Returns a block to the pool. The block must have come from acquire.
+      void release(Block block);
+      // Frees cached blocks, largest first, until no more than targetBytes are cached
+      void trim(size_t targetBytes = 0);
+
+      void setHighWaterMark(size_t bytes);
+      PoolStats stats() const;
+
+      Allocator& allocator() { return alloc; }
+
+    private:
+      static const int CLASS_COUNT = 64;
+
+      Allocator alloc;
+      mutable std::mutex lock;
+      std::vector<Block> freeLists[CLASS_COUNT];
+      PoolStats counters;
+      size_t freeBytes;
+
+      void evict(int cls);
+      void trimLocked(size_t targetBytes);
+  };
+
+  // Host memory allocator, used by the CPU backend.
+  // Memory is 64-byte aligned (one cache line) so that vector loops never straddle lines
+  // at the start of a buffer. Blocks of 2MB or more can optionally be backed by huge pages.
+  struct HostBlock {
+    void* data;
+    size_t size;
+
+    bool operator==(const HostBlock& other) const { return data == other.data; }
+    explicit operator bool() const { return data != nullptr; }
+  };
+
+  class HostAllocator {
+    public:
+      using Block = HostBlock;
+
+      static const size_t ALIGNMENT = 64;
+      static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+      HostAllocator(bool hugePages = false) : hugePages(hugePages) {}
+
+      Block allocate(size_t bytes);
+      void free(Block block);
+      static size_t size(Block block) { return block.size; }
+
+    private:
+      bool hugePages;
+  };
+
+  using HostPool = BufferPool<HostAllocator>;
+
+
+  // BufferPool implementation
+
+  template<typename Allocator>
+  BufferPool<Allocator>::BufferPool(Allocator allocator, size_t highWaterMark) :
+      alloc(allocator), counters(), freeBytes(0) {
+    counters.highWaterMark = highWaterMark;
+  }
+
+  template<typename Allocator>
+  BufferPool<Allocator>::~BufferPool() {
+    trimLocked(0);
+  }
+
+  template<typename Allocator>
+  typename BufferPool<Allocator>::Block BufferPool<Allocator>::acquire(size_t bytes) {
+    size_t classBytes;
+    int cls = sizeClass(bytes, classBytes);
+    std::lock_guard<std::mutex> guard(lock);
+    std::vector<Block>& freeList = freeLists[cls];
+    if (!freeList.empty()) {
+      Block block = freeList.back();
+      freeList.pop_back();
+      freeBytes -= classBytes;
+      counters.hits++;
+      counters.inUseBytes += classBytes;
+      return block;
+    }
+    Block block = alloc.allocate(classBytes);
+    if (!block) {
+      // under pressure, so give back everything cached and try once more
+      trimLocked(0);
+      block = alloc.allocate(classBytes);
+      if (!block) {
+        return block;
+      }
+    }
+    counters.misses++;
+    counters.residentBytes += classBytes;
+    counters.inUseBytes += classBytes;
+    return block;
+  }
+
+  template<typename Allocator>
+  void BufferPool<Allocator>::release(Block block) {
+    if (!block) {
+      return;
+    }
+    size_t classBytes;
+    int cls = sizeClass(Allocator::size(block), classBytes);
+    std::lock_guard<std::mutex> guard(lock);
+    counters.inUseBytes -= classBytes;
+    if (freeBytes + classBytes > counters.highWaterMark) {
+      counters.evictions++;
+      counters.residentBytes -= classBytes;
+      alloc.free(block);
+      return;
+    }
+    freeLists[cls].push_back(block);
+    freeBytes += classBytes;
+  }
+
+  template<typename Allocator>
+  void BufferPool<Allocator>::evict(int cls) {
+    std::vector<Block>& freeList = freeLists[cls];
+    Block block = freeList.back();
+    freeList.pop_back();
+    size_t classBytes = size_t(1) << cls;
+    freeBytes -= classBytes;
+    counters.residentBytes -= classBytes;
+    counters.evictions++;
+    alloc.free(block);
+  }
+
+  template<typename Allocator>
+  void BufferPool<Allocator>::trim(size_t targetBytes) {
+    std::lock_guard<std::mutex> guard(lock);
+    trimLocked(targetBytes);
+  }
+
+  template<typename Allocator>
+  void BufferPool<Allocator>::trimLocked(size_t targetBytes) {
+    for (int cls = CLASS_COUNT - 1; cls >= 0 && freeBytes > targetBytes; cls--) {
+      while (!freeLists[cls].empty() && freeBytes > targetBytes) {
+        evict(cls);
+      }
+    }
+  }
+
+  template<typename Allocator>
+  void BufferPool<Allocator>::setHighWaterMark(size_t bytes) {
+    std::lock_guard<std::mutex> guard(lock);
+    counters.highWaterMark = bytes;
+    trimLocked(bytes);
+  }
+
+  template<typename Allocator>
+  PoolStats BufferPool<Allocator>::stats() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return counters;
+  }
+
+} // namespace Ferrum
+
+#endif // FERRUM_POOL_HPP
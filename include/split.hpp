@@ -0,0 +1,207 @@
+#pragma once
+
+#ifndef FERRUM_SPLIT_HPP
+#define FERRUM_SPLIT_HPP
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "backend.hpp"
+#include "threadpool.hpp"
+
+namespace Ferrum {
+
+  // A backend that runs one large call on several backends at once, such as the GPU and the
+  // CPU, every Metal device on the host, or every NUMA node (see CpuEngine::nodeDevices).
+  //
+  // The elements of a vector call, or the columns of a ge call, are cut into one contiguous part
+  // per backend, in proportion to the throughput each backend has shown for that function. The
+  // parts run concurrently, each on its backend's own queues and buffers, and the results are
+  // written straight into the caller's arrays.
+  // Throughput is measured on every split call and kept as a moving average, so the split
+  // follows changes in load. Until a backend has been measured for a function, it is given an
+  // equal share. Every backend keeps at least a small part, so that a slow backend is still
+  // measured and can win back work if it speeds up.
+  //
+  // Calls shorter than the split threshold, including those with non-positive strides, run whole
+  // on the backend with the best measured throughput, as do small or malformed matrices.
+  // Uplo functions run on the first (primary) backend. The split engine owns its backends.
+  class SplitEngine : public Backend {
+    public:
+      static const long DEFAULT_MIN_SPLIT = 1 << 18;
+      // The smallest part given to any backend
+      static const long MIN_PART = 1 << 14;
+
+      explicit SplitEngine(const std::vector<Backend*>& backends, long minSplit = DEFAULT_MIN_SPLIT);
+      ~SplitEngine();
+
+      const char* name() const override { return "split"; }
+
+      // Compiles a kernel on every backend
+      FunctionID compile(const std::string& expression, KernelShape shape = KernelShape::VECTOR) override;
+
+      int backendCount() const { return static_cast<int>(engines.size()); }
+      Backend* backend(int index) { return engines[index]; }
+
+      // Measured elements per second of each backend on a function, 0 where not yet measured
+      std::vector<double> throughput(FunctionID id) const;
+      // The fraction of a split call that each backend is given
+      std::vector<double> shares(FunctionID id) const;
+
+      // Dispatch functions
+      // f: float, b: buffer, B: in/out buffer. The final buffer is always an out-only buffer (shown as B)
+      // Buffers are *always* followed by: length, offset, stride
+
+      // general vector functions
+      float* vect_bB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                            float* result, long len, long offset, long stride) override;
+      float* vect_bfB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                             float sa,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_fbB(FunctionID id, long n, float sa,
+                                             const float* a, long lena, long offset_a, long stride_a,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_bbB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                             const float* b, long lenb, long offset_b, long stride_b,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_bBB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                             float* b, long lenb, long offset_b, long stride_b,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_bffffB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                                float sa, float sha,
+                                                float sb, float shb,
+                                                float* result, long len, long offset, long stride) override;
+      float* vect_bbffffB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                                 const float* b, long lenb, long offset_b, long stride_b,
+                                                 float sa, float sha,
+                                                 float sb, float shb,
+                                                 float* result, long len, long offset, long stride) override;
+      // general matrix functions
+      float* ge_bB(FunctionID id, long sd, long fd,
+                                  const float* a, long lena, long offset_a, long stride_a,
+                                  float* result, long len, long offset, long stride) override;
+      float* ge_bfB(FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float sa,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_fbB(FunctionID id, long sd, long fd, float sa,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_bbB(FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   const float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_bBB(FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_bffffB(FunctionID id, long sd, long fd,
+                                      const float* a, long lena, long offset_a, long stride_a,
+                                      float sa, float sha,
+                                      float sb, float shb,
+                                      float* result, long len, long offset, long stride) override;
+      float* ge_bbffffB(FunctionID id, long sd, long fd,
+                                       const float* a, long lena, long offset_a, long stride_a,
+                                       const float* b, long lenb, long offset_b, long stride_b,
+                                       float sa, float sha,
+                                       float sb, float shb,
+                                       float* result, long len, long offset, long stride) override;
+      // general uplo functions
+      float* uplo_bB(FunctionID id, long sd, int unit, int bottom,
+                                    const float* a, long lena, long offset_a, long stride_a,
+                                    float* result, long len, long offset, long stride) override;
+      float* uplo_bfB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float sa,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_fbB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float sa,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_bbB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     const float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_bBB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_bffffB(FunctionID id, long sd, int unit, int bottom,
+                                        const float* a, long lena, long offset_a, long stride_a,
+                                        float sa, float sha,
+                                        float sb, float shb,
+                                        float* result, long len, long offset, long stride) override;
+      float* uplo_bbffffB(FunctionID id, long sd, int unit, int bottom,
+                                         const float* a, long lena, long offset_a, long stride_a,
+                                         const float* b, long lenb, long offset_b, long stride_b,
+                                         float sa, float sha,
+                                         float sb, float shb,
+                                         float* result, long len, long offset, long stride) override;
+
+      // linear algebra functions
+      float* gemm(int transA, int transB, long m, long n, long k, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  const float* b, long lenb, long offset_b, long ldb,
+                  float beta, float* c, long lenc, long offset_c, long ldc) override;
+      float* gemv(int trans, long m, long n, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  const float* x, long lenx, long offset_x, long stride_x,
+                  float beta, float* y, long leny, long offset_y, long stride_y) override;
+      float* ger(long m, long n, float alpha,
+                 const float* x, long lenx, long offset_x, long stride_x,
+                 const float* y, long leny, long offset_y, long stride_y,
+                 float* a, long lena, long offset_a, long lda) override;
+      float* trmv(int trans, long sd, int unit, int bottom,
+                  const float* a, long lena, long offset_a, long lda,
+                  float* x, long lenx, long offset_x, long stride_x) override;
+      float* trsv(int trans, long sd, int unit, int bottom,
+                  const float* a, long lena, long offset_a, long lda,
+                  float* x, long lenx, long offset_x, long stride_x) override;
+      float* trmm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  float* b, long lenb, long offset_b, long ldb) override;
+      float* trsm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  float* b, long lenb, long offset_b, long ldb) override;
+      float* syrk(int trans, long n, long k, int bottom, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  float beta, float* c, long lenc, long offset_c, long ldc) override;
+      float* potrf(long sd, int bottom, float* a, long lena, long offset_a, long lda) override;
+      float* potrs(long sd, long n, int bottom, const float* a, long lena, long offset_a, long lda,
+                   float* b, long lenb, long offset_b, long ldb) override;
+      float* trttp(long sd, int bottom, const float* a, long lena, long offset_a, long lda,
+                   float* ap, long lenap, long offset_ap) override;
+      float* tpttr(long sd, int bottom, const float* ap, long lenap, long offset_ap,
+                   float* a, long lena, long offset_a, long lda) override;
+      float* tpmv(int trans, long sd, int unit, int bottom, const float* ap, long lenap, long offset_ap,
+                  float* x, long lenx, long offset_x, long stride_x) override;
+      float* spmv(long sd, int bottom, float alpha, const float* ap, long lenap, long offset_ap,
+                  const float* x, long lenx, long offset_x, long stride_x,
+                  float beta, float* y, long leny, long offset_y, long stride_y) override;
+      float* omatcopy(int trans, long m, long n, float alpha,
+                      const float* a, long lena, long offset_a, long lda,
+                      float* b, long lenb, long offset_b, long ldb) override;
+
+    private:
+      // Runs elements (or columns) [begin, begin + count) of a call on one backend
+      using Part = std::function<float*(Backend* backend, long begin, long count)>;
+
+      std::vector<Backend*> engines;
+      long minSplit;
+      ThreadPool* lanes;
+
+      mutable std::mutex lock;
+      std::map<int, std::vector<double>> rates;   // elements per nanosecond, by function then backend
+
+      int fastest(FunctionID id) const;
+      std::vector<long> partition(FunctionID id, long n, long minPart) const;
+      bool splits(long n, long width) const;
+      void record(FunctionID id, int backend, long count, double nanos);
+      float* split(FunctionID id, long n, long width, float* result, const Part& part);
+  };
+
+} // namespace Ferrum
+
+#endif // FERRUM_SPLIT_HPP
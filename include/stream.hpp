@@ -0,0 +1,109 @@
+#pragma once
+
+#ifndef FERRUM_STREAM_HPP
+#define FERRUM_STREAM_HPP
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include "backend.hpp"
+#include "pool.hpp"
+
+namespace Ferrum {
+
+  // A file of raw float32 values, mapped into memory.
+  // Lengths and positions are counted in elements, and are 64-bit.
+  class MappedFile {
+    public:
+      // Maps an existing file for reading. Returns nullptr if it cannot be opened or mapped.
+      static MappedFile* openRead(const std::string& path);
+      // Creates a file of count elements, or truncates an existing one, and maps it for writing
+      static MappedFile* create(const std::string& path, long count);
+      ~MappedFile();
+
+      MappedFile(const MappedFile&) = delete;
+      MappedFile& operator=(const MappedFile&) = delete;
+
+      float* data() const { return elements; }
+      long size() const { return count; }
+
+      // Paging hints. These cover whole pages, and are ignored where they are not supported.
+      // Starts reading a range in the background
+      void willNeed(long first, long n) const;
+      // Drops a range that has been read, and starts writing back a range that has been written
+      void release(long first, long n) const;
+
+    private:
+      MappedFile(int fd, float* elements, long count, size_t bytes, bool writable) :
+          fd(fd), elements(elements), count(count), bytes(bytes), writable(writable) {}
+
+      int fd;
+      float* elements;
+      long count;
+      size_t bytes;
+      bool writable;
+  };
+
+  struct StreamStats {
+    uint64_t elements;
+    uint64_t chunks;
+    double readSeconds;      // time spent filling chunks (or prefetching mapped ones)
+    double computeSeconds;   // time spent in the backend
+    double writeSeconds;     // time spent draining chunks (or flushing mapped ones)
+    double wallSeconds;      // less than the sum of the stages when they overlap
+  };
+
+  // Applies an elementwise vector function to inputs that are too large for memory, one chunk
+  // at a time.
+  //
+  // Files are mapped and passed to the backend in place, a chunk at a time. While a chunk is
+  // computed, the kernel is asked to read ahead the next chunk of each input (MADV_WILLNEED),
+  // and once it is done, its input pages are dropped and its output pages are queued for
+  // writeback, so reads, compute and writes overlap and memory use stays near a few chunks.
+  //
+  // Sources and sinks are callbacks for any other storage. They run as a pipeline: a reader
+  // thread fills the next chunks while the caller computes one, and a writer thread drains
+  // the chunks before it. The stages pass chunks around a ring of three buffers.
+  //
+  // Only unary (bB) and binary (bbB) functions can be streamed. The backend is not owned.
+  class Streamer {
+    public:
+      // Writes up to count elements, starting at element first, and returns the number written.
+      // Fewer than count marks the end of the input.
+      using Source = std::function<long(float* buffer, long first, long count)>;
+      // Takes count result elements starting at element first. Returns false to stop the stream.
+      using Sink = std::function<bool(const float* buffer, long first, long count)>;
+
+      static const long DEFAULT_CHUNK = 1 << 20;
+
+      explicit Streamer(Backend* backend, long chunkElements = DEFAULT_CHUNK);
+      ~Streamer();
+
+      // output = f(input), for files or callbacks. Returns false if anything fails.
+      bool stream_bB(FunctionID id, const std::string& input, const std::string& output);
+      bool stream_bB(FunctionID id, const Source& input, const Sink& output);
+      // output = f(a, b). The stream ends with the shorter input.
+      bool stream_bbB(FunctionID id, const std::string& a, const std::string& b, const std::string& output);
+      bool stream_bbB(FunctionID id, const Source& a, const Source& b, const Sink& output);
+
+      // The counters of the most recent stream
+      StreamStats stats() const;
+
+    private:
+      Backend* engine;
+      long chunk;
+      HostPool* pool;
+
+      mutable std::mutex lock;
+      StreamStats last;
+
+      float* compute(FunctionID id, const float* a, const float* b, float* result, long n);
+      bool mapped(FunctionID id, const std::string& a, const std::string* b, const std::string& output);
+      bool pipeline(FunctionID id, const Source& a, const Source* b, const Sink& output);
+  };
+
+} // namespace Ferrum
+
+#endif // FERRUM_STREAM_HPP
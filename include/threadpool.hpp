@@ -0,0 +1,97 @@
+#pragma once
+
+#ifndef FERRUM_THREADPOOL_HPP
+#define FERRUM_THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Ferrum {
+
+  // A work-stealing pool for splitting loops over the CPU.
+  //
+  // parallelFor hands out a range of indices as tasks. A task larger than the grain is split
+  // in half: the upper half goes on the back of a deque, and the lower half is split again,
+  // until a grain-sized piece is left to run. Each worker takes work from the back of its own
+  // deque, so it stays on recently split (cache-warm) ranges, and steals from the front of
+  // other deques, which hold the largest remaining ranges. The calling thread works on its own
+  // loop too, and ranges no larger than the grain run entirely on the caller, with no wake-ups.
+  //
+  // Workers can be pinned to a set of CPUs. This is supported on Linux; elsewhere the
+  // affinity list is ignored. When the CPUs are labelled with their NUMA nodes, a loop can be
+  // cut into one range per node, each range is started on that node's workers, and workers
+  // steal from their own node before reaching across to another.
+  class ThreadPool {
+    public:
+      using Body = std::function<void(long begin, long end)>;
+
+      // One worker per hardware thread, less the caller
+      static const int DEFAULT_THREADS = -1;
+
+      // cpuNodes, when given, holds the NUMA node index of each entry in cpus
+      explicit ThreadPool(int threads = DEFAULT_THREADS, const std::vector<int>& cpus = std::vector<int>(),
+                          const std::vector<int>& cpuNodes = std::vector<int>());
+      ~ThreadPool();
+
+      ThreadPool(const ThreadPool&) = delete;
+      ThreadPool& operator=(const ThreadPool&) = delete;
+
+      // The number of worker threads, not counting callers
+      int threadCount() const { return static_cast<int>(workers.size()); }
+
+      // Runs body over [0, n) in pieces of no more than grain indices, and returns once all have run.
+      // May be called from many threads at once, and from inside a body.
+      void parallelFor(long n, long grain, const Body& body);
+      // As above, with [nodeSplits[k], nodeSplits[k + 1]) started on the workers of node k.
+      // nodeSplits begins with 0 and ends with n.
+      void parallelFor(long n, long grain, const Body& body, const std::vector<long>& nodeSplits);
+
+    private:
+      struct Job {
+        const Body* body;
+        long grain;
+        std::atomic<long> remaining;
+        std::mutex lock;
+        std::condition_variable finished;
+        bool done;
+      };
+
+      struct Task {
+        Job* job;
+        long begin;
+        long end;
+      };
+
+      struct Worker {
+        std::mutex lock;
+        std::deque<Task> tasks;
+        std::thread thread;
+        int node;
+      };
+
+      std::vector<std::unique_ptr<Worker>> workers;
+      std::vector<std::vector<int>> nodeWorkers;   // the workers on each node
+      std::atomic<long> queued;
+      std::atomic<unsigned int> nextWorker;
+      std::mutex sleepLock;
+      std::condition_variable wake;
+      bool stopping;
+
+      void wait(Job& job);
+      void workerLoop(int index, int cpu);
+      void run(Task task, int self);
+      void push(const Task& task, int self);
+      void pushTo(const Task& task, int target);
+      bool pop(int self, Task& task);
+      bool steal(int self, Task& task);
+  };
+
+} // namespace Ferrum
+
+#endif // FERRUM_THREADPOOL_HPP
@@ -0,0 +1,231 @@
+#pragma once
+
+#ifndef FERRUM_TUNER_HPP
+#define FERRUM_TUNER_HPP
+
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "backend.hpp"
+
+namespace Ferrum {
+
+  // Where a call runs: an index into the tuned engine's backends, and that backend's launch option
+  struct Choice {
+    int backend;
+    int option;
+
+    bool operator==(const Choice& other) const { return backend == other.backend && option == other.option; }
+  };
+
+  // The fastest choice for each function, size class and stride (unit or not) on one host.
+  //
+  // Profiles are saved as text, one choice per line, headed by a format version and the names of
+  // the backends that were measured. A profile only loads for the same version and backends.
+  class TuningProfile {
+    public:
+      static const int VERSION = 1;
+
+      TuningProfile() {}
+      explicit TuningProfile(const std::vector<std::string>& backendNames) : names(backendNames) {}
+
+      const std::vector<std::string>& backendNames() const { return names; }
+      bool empty() const { return choices.empty(); }
+      size_t size() const { return choices.size(); }
+
+      void set(FunctionID id, int sizeClass, bool strided, Choice choice);
+      // The choice measured at the nearest size class, or nullptr when the function was not measured
+      const Choice* find(FunctionID id, int sizeClass, bool strided) const;
+
+      bool save(const std::string& path) const;
+      // Returns false, leaving the profile empty, if the file is missing, malformed or of another version
+      bool load(const std::string& path);
+
+      bool operator==(const TuningProfile& other) const { return names == other.names && choices == other.choices; }
+
+    private:
+      using Key = std::tuple<int, bool, int>;   // function, strided, size class
+
+      std::vector<std::string> names;
+      std::map<Key, Choice> choices;
+  };
+
+  struct CalibrationOptions {
+    long minLength = 1 << 10;
+    long maxLength = 1 << 22;
+    int repeats = 3;
+  };
+
+  // Benchmarks each family of vector functions on every backend, with every launch option the
+  // backend offers, at lengths from minLength to maxLength in steps of 4x, for unit and non-unit
+  // strides. A family is the functions that share a kernel kind and cost class, such as the
+  // cheap binary functions; one member is timed, and its choices are given to the whole family.
+  // Launch options are left at their defaults afterwards.
+  TuningProfile calibrate(const std::vector<Backend*>& backends,
+                          const CalibrationOptions& options = CalibrationOptions());
+
+  // A backend that routes each call to the backend chosen by a tuning profile, and sets the
+  // launch options that the profile found. Vector calls are looked up by function, length and
+  // stride. Matrix calls use the profile of the matching vector function at the matrix's element
+  // count. Calls the profile does not cover run on the first (primary) backend.
+  // The tuned engine owns the backends it is given.
+  class TunedEngine : public Backend {
+    public:
+      // The profile must have been measured on the same backends, in the same order
+      TunedEngine(const std::vector<Backend*>& backends, const TuningProfile& profile);
+      ~TunedEngine();
+
+      const char* name() const override { return "tuned"; }
+
+      int backendCount() const { return static_cast<int>(engines.size()); }
+      Backend* backend(int index) { return engines[index]; }
+      // The backend that a call would be sent to
+      int route(FunctionID id, long n, bool strided) const;
+
+      // Dispatch functions
+      // f: float, b: buffer, B: in/out buffer. The final buffer is always an out-only buffer (shown as B)
+      // Buffers are *always* followed by: length, offset, stride
+
+      // general vector functions
+      float* vect_bB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                            float* result, long len, long offset, long stride) override;
+      float* vect_bfB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                             float sa,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_fbB(FunctionID id, long n, float sa,
+                                             const float* a, long lena, long offset_a, long stride_a,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_bbB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                             const float* b, long lenb, long offset_b, long stride_b,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_bBB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                             float* b, long lenb, long offset_b, long stride_b,
+                                             float* result, long len, long offset, long stride) override;
+      float* vect_bffffB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                                float sa, float sha,
+                                                float sb, float shb,
+                                                float* result, long len, long offset, long stride) override;
+      float* vect_bbffffB(FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                                 const float* b, long lenb, long offset_b, long stride_b,
+                                                 float sa, float sha,
+                                                 float sb, float shb,
+                                                 float* result, long len, long offset, long stride) override;
+      // general matrix functions
+      float* ge_bB(FunctionID id, long sd, long fd,
+                                  const float* a, long lena, long offset_a, long stride_a,
+                                  float* result, long len, long offset, long stride) override;
+      float* ge_bfB(FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float sa,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_fbB(FunctionID id, long sd, long fd, float sa,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_bbB(FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   const float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_bBB(FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) override;
+      float* ge_bffffB(FunctionID id, long sd, long fd,
+                                      const float* a, long lena, long offset_a, long stride_a,
+                                      float sa, float sha,
+                                      float sb, float shb,
+                                      float* result, long len, long offset, long stride) override;
+      float* ge_bbffffB(FunctionID id, long sd, long fd,
+                                       const float* a, long lena, long offset_a, long stride_a,
+                                       const float* b, long lenb, long offset_b, long stride_b,
+                                       float sa, float sha,
+                                       float sb, float shb,
+                                       float* result, long len, long offset, long stride) override;
+      // general uplo functions
+      float* uplo_bB(FunctionID id, long sd, int unit, int bottom,
+                                    const float* a, long lena, long offset_a, long stride_a,
+                                    float* result, long len, long offset, long stride) override;
+      float* uplo_bfB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float sa,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_fbB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float sa,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_bbB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     const float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_bBB(FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) override;
+      float* uplo_bffffB(FunctionID id, long sd, int unit, int bottom,
+                                        const float* a, long lena, long offset_a, long stride_a,
+                                        float sa, float sha,
+                                        float sb, float shb,
+                                        float* result, long len, long offset, long stride) override;
+      float* uplo_bbffffB(FunctionID id, long sd, int unit, int bottom,
+                                         const float* a, long lena, long offset_a, long stride_a,
+                                         const float* b, long lenb, long offset_b, long stride_b,
+                                         float sa, float sha,
+                                         float sb, float shb,
+                                         float* result, long len, long offset, long stride) override;
+
+      // linear algebra functions
+      float* gemm(int transA, int transB, long m, long n, long k, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  const float* b, long lenb, long offset_b, long ldb,
+                  float beta, float* c, long lenc, long offset_c, long ldc) override;
+      float* gemv(int trans, long m, long n, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  const float* x, long lenx, long offset_x, long stride_x,
+                  float beta, float* y, long leny, long offset_y, long stride_y) override;
+      float* ger(long m, long n, float alpha,
+                 const float* x, long lenx, long offset_x, long stride_x,
+                 const float* y, long leny, long offset_y, long stride_y,
+                 float* a, long lena, long offset_a, long lda) override;
+      float* trmv(int trans, long sd, int unit, int bottom,
+                  const float* a, long lena, long offset_a, long lda,
+                  float* x, long lenx, long offset_x, long stride_x) override;
+      float* trsv(int trans, long sd, int unit, int bottom,
+                  const float* a, long lena, long offset_a, long lda,
+                  float* x, long lenx, long offset_x, long stride_x) override;
+      float* trmm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  float* b, long lenb, long offset_b, long ldb) override;
+      float* trsm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  float* b, long lenb, long offset_b, long ldb) override;
+      float* syrk(int trans, long n, long k, int bottom, float alpha,
+                  const float* a, long lena, long offset_a, long lda,
+                  float beta, float* c, long lenc, long offset_c, long ldc) override;
+      float* potrf(long sd, int bottom, float* a, long lena, long offset_a, long lda) override;
+      float* potrs(long sd, long n, int bottom, const float* a, long lena, long offset_a, long lda,
+                   float* b, long lenb, long offset_b, long ldb) override;
+      float* trttp(long sd, int bottom, const float* a, long lena, long offset_a, long lda,
+                   float* ap, long lenap, long offset_ap) override;
+      float* tpttr(long sd, int bottom, const float* ap, long lenap, long offset_ap,
+                   float* a, long lena, long offset_a, long lda) override;
+      float* tpmv(int trans, long sd, int unit, int bottom, const float* ap, long lenap, long offset_ap,
+                  float* x, long lenx, long offset_x, long stride_x) override;
+      float* spmv(long sd, int bottom, float alpha, const float* ap, long lenap, long offset_ap,
+                  const float* x, long lenx, long offset_x, long stride_x,
+                  float beta, float* y, long leny, long offset_y, long stride_y) override;
+      float* omatcopy(int trans, long m, long n, float alpha,
+                      const float* a, long lena, long offset_a, long lda,
+                      float* b, long lenb, long offset_b, long ldb) override;
+
+    private:
+      std::vector<Backend*> engines;
+      // the backend for each function, stride and size class, flattened
+      std::vector<signed char> routes;
+
+      Backend* engineFor(FunctionID id, long n, bool strided) const { return engines[route(id, n, strided)]; }
+  };
+
+} // namespace Ferrum
+
+#endif // FERRUM_TUNER_HPP
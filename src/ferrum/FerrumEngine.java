@@ -1,5 +1,11 @@
 package ferrum;
 
+/**
+ * Access to the Ferrum native engine.
+ * An engine is thread safe: one instance can be shared by any number of threads,
+ * and calls from different threads are dispatched concurrently.
+ * Close the engine only once all calls on it have returned.
+ */
 public class FerrumEngine implements AutoCloseable {
 
     static {
@@ -16,64 +22,138 @@ public class FerrumEngine implements AutoCloseable {
       engineHandle = init(path);
     }
 
+    private FerrumEngine(long engineHandle) {
+      this.engineHandle = engineHandle;
+    }
+
+    /**
+     * Creates an engine that merges small vector calls made at the same time by different threads.
+     * Calls to the same function with the same scalars are packed into one dispatch.
+     * @param path the path of the Metal library, or null for the embedded library
+     * @param windowMicros how long a call may wait for others to join it
+     * @param maxBatch the most calls that can share one dispatch
+     */
+    public static FerrumEngine coalescing(String path, long windowMicros, int maxBatch) {
+      return new FerrumEngine(initCoalescing(path, windowMicros, maxBatch));
+    }
+
+    /**
+     * Creates an engine that runs each large vector call on the GPU and the CPU at once.
+     * The elements of a call are divided in proportion to the measured speed of each device.
+     * @param path the path of the Metal library, or null for the embedded library
+     */
+    public static FerrumEngine split(String path) {
+      return new FerrumEngine(initSplit(path));
+    }
+
+    /**
+     * Creates an engine that shards each large vector or matrix call over every Metal device on this host.
+     * Each device has its own queues and buffers, and gets a share of the call in proportion to its speed.
+     * @param path the path of the Metal library, or null for the embedded library
+     */
+    public static FerrumEngine sharded(String path) {
+      return new FerrumEngine(initSharded(path));
+    }
+
+    /**
+     * Creates an engine that sends each call to the GPU or the CPU, whichever was fastest for that
+     * function and size on this host. The measurements are kept in a profile file. When the file is
+     * missing, or was made for other devices, the devices are measured again and the file is rewritten,
+     * which can take some time.
+     * @param path the path of the Metal library, or null for the embedded library
+     * @param profilePath the tuning profile to load, or to create
+     */
+    public static FerrumEngine tuned(String path, String profilePath) {
+      return new FerrumEngine(initTuned(path, profilePath));
+    }
+
     private static native long init(String path);
 
-    public void close() {
-      close(engineHandle);
+    private static native long initCoalescing(String path, long windowMicros, int maxBatch);
+
+    private static native long initSplit(String path);
+
+    private static native long initSharded(String path);
+
+    private static native long initTuned(String path, String profilePath);
+
+    public synchronized void close() {
+      if (engineHandle != 0) {
+        close(engineHandle);
+        engineHandle = 0;
+      }
     }
 
     private static native void close(long engineHandle);
 
     public float[] vect_bB(String fn, float[] a) {
-        return vect_bB(fn, a, 0, 1);
+        return vect_bB(fn, a.length, a, 0, 1);
     }
 
     public float[] vect_bfB(String fn, float[] a, float sa) {
-        return vect_bfB(fn, a, 0, 1, sa);
+        return vect_bfB(fn, a.length, a, 0, 1, sa);
     }
 
     public float[] vect_fbB(String fn, float sa, float[] a) {
-        return vect_fbB(fn, sa, a, 0, 1);
+        return vect_fbB(fn, a.length, sa, a, 0, 1);
     }
 
     public float[] vect_bbB(String fn, float[] a, float[] b) {
-        return vect_bbB(fn, a, 0, 1, b, 0, 1);
+        return vect_bbB(fn, Math.min(a.length, b.length), a, 0, 1, b, 0, 1);
     }
 
     public float[] vect_bBB(String fn, float[] a, float[] b) {
-        return vect_bBB(fn, a, 0, 1, b, 0, 1);
+        return vect_bBB(fn, Math.min(a.length, b.length), a, 0, 1, b, 0, 1);
     }
 
     public float[] vect_bffffB(String fn, float[] a, float sa, float sha, float sb, float shb) {
-        return vect_bffffB(fn, a, 0, 1, sa, sha, sb, shb);
+        return vect_bffffB(fn, a.length, a, 0, 1, sa, sha, sb, shb);
     }
 
     public float[] vect_bbffffB(String fn, float[] a, float[] b, float sa, float sha, float sb, float shb) {
-        return vect_bbffffB(fn, a, 0, 1, b, 0, 1, sa, sha, sb, shb);
+        return vect_bbffffB(fn, Math.min(a.length, b.length), a, 0, 1, b, 0, 1, sa, sha, sb, shb);
     }
 
-    public native float[] vect_bB(String fn, float[] a, int offset_a, int stride_a);
+    // These compute n elements, from the offset of each array at its stride, and return
+    // them in a new array of n elements. Only that range of each array is read, so a small
+    // slice of a large array costs only the slice. An IllegalArgumentException is thrown
+    // if an array cannot hold its n elements. As in BLAS, a negative stride reads (or writes)
+    // the elements backwards, from offset + (n - 1) * |stride| down to the offset.
 
-    public native float[] vect_bfB(String fn, float[] a, int offset_a, int stride_a, float sa);
+    public native float[] vect_bB(String fn, int n, float[] a, int offset_a, int stride_a);
 
-    public native float[] vect_fbB(String fn, float sa, float[] a, int offset_a, int stride_a);
+    public native float[] vect_bfB(String fn, int n, float[] a, int offset_a, int stride_a, float sa);
 
-    public native float[] vect_bbB(String fn,
+    public native float[] vect_fbB(String fn, int n, float sa, float[] a, int offset_a, int stride_a);
+
+    public native float[] vect_bbB(String fn, int n,
                                    float[] a, int offset_a, int stride_a,
                                    float[] b, int offset_b, int stride_b);
 
-    public native float[] vect_bBB(String fn,
+    public native float[] vect_bBB(String fn, int n,
                                    float[] a, int offset_a, int stride_a,
                                    float[] b, int offset_b, int stride_b);
 
-    public native float[] vect_bffffB(String fn,
+    public native float[] vect_bffffB(String fn, int n,
                                       float[] a, int offset_a, int stride_a,
                                       float sa, float sha,
                                       float sb, float shb);
 
-    public native float[] vect_bbffffB(String fn,
+    public native float[] vect_bbffffB(String fn, int n,
                                        float[] a, int offset_a, int stride_a,
                                        float[] b, int offset_b, int stride_b,
                                        float sa, float sha,
                                        float sb, float shb);
+
+    /**
+     * Applies a vector function to a file of raw float32 values, writing the results to another.
+     * The files are processed a chunk at a time, so they may be larger than memory.
+     * Returns false if a file cannot be read or written.
+     */
+    public native boolean stream_bB(String fn, String input, String output);
+
+    /**
+     * As stream_bB, for binary functions. The output is as long as the shorter input.
+     */
+    public native boolean stream_bbB(String fn, String a, String b, String output);
 }
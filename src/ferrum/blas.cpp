@@ -0,0 +1,1053 @@
+#include "blas.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include "backend.hpp"
+#include "threadpool.hpp"
+
+namespace {
+
+  // Four floats: a vector register with SSE on x86-64, and with NEON on arm64
+  typedef float Lane __attribute__((vector_size(16)));
+
+  // the block of C that the micro-kernel keeps in registers
+  const long MR = 8;
+  const long NR = 6;
+  // the packed blocks: KC x NR of op(B) stays in L1, MC x KC of op(A) in L2,
+  // and the KC x NC panel of op(B) in the last level cache
+  const long KC = 256;
+  const long MC = 128;
+  const long NC = 3072;
+  // the columns of C in one task, a multiple of NR
+  const long NT = 96;
+
+  // the rows of y that a gemv task adds into, which stay in L1
+  const long GEMV_ROWS = 2048;
+  // the fewest columns of A worth a gemv task of their own
+  const long GEMV_COLUMNS = 128;
+  // the rows and columns of A in a transposed gemv task, or a ger task
+  const long DOT_ROWS = 8192;
+  const long DOT_COLUMNS = 8;
+  // calls smaller than this run on the calling thread
+  const long MIN_PARALLEL = 1 << 15;
+  // the side of the blocks on the diagonal of a triangle
+  const long TRI_BLOCK = 128;
+  // the side of the triangles that trmm and trsm stop halving at
+  const long TRI_LEAF = 16;
+  // the columns of B in a task of a diagonal block on the left
+  const long TRI_VECTORS = 16;
+  // the rows of B in a task of a diagonal block on the right, which stay in L1 across its columns
+  const long TRI_ROWS = 256;
+  // the rows of the result in a task of a packed product, and the columns in a task of a packing copy
+  const long PACKED_ROWS = 512;
+  const long PACKED_COLUMNS = 64;
+  // the side of the square blocks of a transpose, whose source and destination stay in L1
+  const long TRANSPOSE_BLOCK = 32;
+
+  inline Lane load(const float* p) {
+    Lane v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+  }
+
+  inline void store(float* p, Lane v) {
+    std::memcpy(p, &v, sizeof(v));
+  }
+
+  // Runs body over [0, n), on the pool when there is one and more than one index
+  void forEach(Ferrum::ThreadPool* pool, long n, const Ferrum::ThreadPool::Body& body) {
+    if (pool == nullptr || n <= 1) {
+      body(0, n);
+    } else {
+      pool->parallelFor(n, 1, body);
+    }
+  }
+
+  // C = beta * C over a block, without reading C when beta is 0
+  void scale(long rows, long cols, float beta, float* c, long ldc) {
+    if (beta == 1.0f) {
+      return;
+    }
+    for (long j = 0; j < cols; j++) {
+      float* cj = c + j * ldc;
+      if (beta == 0.0f) {
+        std::fill(cj, cj + rows, 0.0f);
+      } else {
+        for (long i = 0; i < rows; i++) {
+          cj[i] *= beta;
+        }
+      }
+    }
+  }
+
+  // Packs rows [i0, i0 + mc) and columns [p0, p0 + kc) of op(A) into slivers of MR rows,
+  // each stored column by column, with the last sliver padded with zeros
+  void packA(bool trans, const float* a, long lda, long i0, long mc, long p0, long kc, float* packed) {
+    for (long s = 0; s < mc; s += MR) {
+      long rows = std::min(MR, mc - s);
+      for (long p = 0; p < kc; p++) {
+        float* out = packed + s * kc + p * MR;
+        for (long r = 0; r < rows; r++) {
+          long i = i0 + s + r;
+          out[r] = trans ? a[(p0 + p) + i * lda] : a[i + (p0 + p) * lda];
+        }
+        for (long r = rows; r < MR; r++) {
+          out[r] = 0.0f;
+        }
+      }
+    }
+  }
+
+  // Packs rows [p0, p0 + kc) of NR columns of op(B) from column j0, stored row by row,
+  // with the columns past cols padded with zeros
+  void packB(bool trans, const float* b, long ldb, long p0, long kc, long j0, long cols, float* packed) {
+    for (long c = 0; c < NR; c++) {
+      long j = j0 + c;
+      for (long p = 0; p < kc; p++) {
+        packed[p * NR + c] = c >= cols ? 0.0f : trans ? b[j + (p0 + p) * ldb] : b[(p0 + p) + j * ldb];
+      }
+    }
+  }
+
+  // C += alpha * (an MR x KC sliver of A) * (a KC x NR sliver of B), for the rows x cols
+  // corner of the block that lies within C
+  void microKernel(long kc, const float* a, const float* b, float alpha, float* c, long ldc, long rows, long cols) {
+    Lane c00 = {}, c10 = {}, c01 = {}, c11 = {}, c02 = {}, c12 = {};
+    Lane c03 = {}, c13 = {}, c04 = {}, c14 = {}, c05 = {}, c15 = {};
+    for (long p = 0; p < kc; p++) {
+      Lane a0 = load(a);
+      Lane a1 = load(a + 4);
+      c00 += a0 * b[0];
+      c10 += a1 * b[0];
+      c01 += a0 * b[1];
+      c11 += a1 * b[1];
+      c02 += a0 * b[2];
+      c12 += a1 * b[2];
+      c03 += a0 * b[3];
+      c13 += a1 * b[3];
+      c04 += a0 * b[4];
+      c14 += a1 * b[4];
+      c05 += a0 * b[5];
+      c15 += a1 * b[5];
+      a += MR;
+      b += NR;
+    }
+    Lane block[2 * NR] = {c00, c10, c01, c11, c02, c12, c03, c13, c04, c14, c05, c15};
+    if (rows == MR && cols == NR) {
+      for (long j = 0; j < NR; j++) {
+        float* cj = c + j * ldc;
+        store(cj, load(cj) + block[2 * j] * alpha);
+        store(cj + 4, load(cj + 4) + block[2 * j + 1] * alpha);
+      }
+      return;
+    }
+    float values[MR * NR];
+    std::memcpy(values, block, sizeof(values));
+    for (long j = 0; j < cols; j++) {
+      for (long i = 0; i < rows; i++) {
+        c[i + j * ldc] += alpha * values[i + j * MR];
+      }
+    }
+  }
+
+  float sum(Lane v) {
+    return (v[0] + v[1]) + (v[2] + v[3]);
+  }
+
+  // A strided vector as a contiguous one, copied into packed unless it already is
+  const float* contiguous(const float* x, long n, long inc, std::vector<float>& packed) {
+    if (inc == 1) {
+      return x;
+    }
+    packed.resize(n);
+    for (long i = 0; i < n; i++) {
+      packed[i] = x[i * inc];
+    }
+    return packed.data();
+  }
+
+  // y = a * s + y over n elements
+  void axpy(long n, float s, const float* a, float* y) {
+    Lane sv = {s, s, s, s};
+    long i = 0;
+    for (; i + 4 <= n; i += 4) {
+      store(y + i, load(y + i) + load(a + i) * sv);
+    }
+    for (; i < n; i++) {
+      y[i] += a[i] * s;
+    }
+  }
+
+  // y = a0 * s0 + a1 * s1 + a2 * s2 + a3 * s3 + y, which reads and writes y once for four columns
+  void axpy4(long n, const float* s, const float* a0, const float* a1, const float* a2, const float* a3,
+             float* y) {
+    long i = 0;
+    for (; i + 4 <= n; i += 4) {
+      Lane v = load(y + i);
+      v += load(a0 + i) * s[0];
+      v += load(a1 + i) * s[1];
+      v += load(a2 + i) * s[2];
+      v += load(a3 + i) * s[3];
+      store(y + i, v);
+    }
+    for (; i < n; i++) {
+      y[i] += a0[i] * s[0] + a1[i] * s[1] + a2[i] * s[2] + a3[i] * s[3];
+    }
+  }
+
+  float dot(long n, const float* a, const float* x) {
+    Lane s0 = {}, s1 = {};
+    long i = 0;
+    for (; i + 8 <= n; i += 8) {
+      s0 += load(a + i) * load(x + i);
+      s1 += load(a + i + 4) * load(x + i + 4);
+    }
+    float s = sum(s0 + s1);
+    for (; i < n; i++) {
+      s += a[i] * x[i];
+    }
+    return s;
+  }
+
+  // Dots of four columns with x, which reads x once for the four
+  void dot4(long n, const float* a, long lda, const float* x, float* out) {
+    const float* a0 = a;
+    const float* a1 = a + lda;
+    const float* a2 = a + 2 * lda;
+    const float* a3 = a + 3 * lda;
+    Lane s0 = {}, s1 = {}, s2 = {}, s3 = {};
+    long i = 0;
+    for (; i + 4 <= n; i += 4) {
+      Lane xv = load(x + i);
+      s0 += load(a0 + i) * xv;
+      s1 += load(a1 + i) * xv;
+      s2 += load(a2 + i) * xv;
+      s3 += load(a3 + i) * xv;
+    }
+    out[0] = sum(s0);
+    out[1] = sum(s1);
+    out[2] = sum(s2);
+    out[3] = sum(s3);
+    for (; i < n; i++) {
+      out[0] += a0[i] * x[i];
+      out[1] += a1[i] * x[i];
+      out[2] += a2[i] * x[i];
+      out[3] += a3[i] * x[i];
+    }
+  }
+
+  // y = alpha * sum + beta * y over a strided y, without reading y when beta is 0
+  void update(float* y, float alpha, float sum, float beta) {
+    *y = beta == 0.0f ? alpha * sum : alpha * sum + beta * *y;
+  }
+
+  // y = A * x, where y has m rows. Tasks are blocks of rows by groups of columns, and each
+  // group of columns adds into its own copy of y, which are summed into y at the end.
+  void gemvN(Ferrum::ThreadPool* pool, long m, long n, float alpha, const float* a, long lda,
+             const float* x, float beta, float* y, long incy) {
+    long rowBlocks = (m + GEMV_ROWS - 1) / GEMV_ROWS;
+    long groups = 1;
+    if (pool != nullptr) {
+      long threads = pool->threadCount() + 1;
+      groups = std::max(1L, std::min(threads / rowBlocks, n / GEMV_COLUMNS));
+    }
+    long width = (n + groups - 1) / groups;
+    std::vector<float> partial(groups * m);
+    forEach(pool, rowBlocks * groups, [&](long first, long last) {
+      for (long t = first; t < last; t++) {
+        long r0 = (t % rowBlocks) * GEMV_ROWS;
+        long rows = std::min(GEMV_ROWS, m - r0);
+        long j0 = (t / rowBlocks) * width;
+        long j1 = std::min(n, j0 + width);
+        float* acc = partial.data() + (t / rowBlocks) * m + r0;
+        long j = j0;
+        for (; j + 4 <= j1; j += 4) {
+          const float* aj = a + r0 + j * lda;
+          axpy4(rows, x + j, aj, aj + lda, aj + 2 * lda, aj + 3 * lda, acc);
+        }
+        for (; j < j1; j++) {
+          axpy(rows, x[j], a + r0 + j * lda, acc);
+        }
+      }
+    });
+    forEach(pool, rowBlocks, [&](long first, long last) {
+      for (long i = first * GEMV_ROWS; i < std::min(m, last * GEMV_ROWS); i++) {
+        float s = partial[i];
+        for (long g = 1; g < groups; g++) {
+          s += partial[g * m + i];
+        }
+        update(y + i * incy, alpha, s, beta);
+      }
+    });
+  }
+
+  // y = A^T * x, where y has n rows. Tasks are blocks of rows by a few columns, and the partial
+  // dots of the blocks of rows are summed at the end.
+  void gemvT(Ferrum::ThreadPool* pool, long m, long n, float alpha, const float* a, long lda,
+             const float* x, float beta, float* y, long incy) {
+    long rowBlocks = (m + DOT_ROWS - 1) / DOT_ROWS;
+    long colBlocks = (n + DOT_COLUMNS - 1) / DOT_COLUMNS;
+    std::vector<float> partial(rowBlocks * n);
+    forEach(pool, rowBlocks * colBlocks, [&](long first, long last) {
+      for (long t = first; t < last; t++) {
+        long r0 = (t % rowBlocks) * DOT_ROWS;
+        long rows = std::min(DOT_ROWS, m - r0);
+        long j0 = (t / rowBlocks) * DOT_COLUMNS;
+        long j1 = std::min(n, j0 + DOT_COLUMNS);
+        float* out = partial.data() + (t % rowBlocks) * n;
+        long j = j0;
+        for (; j + 4 <= j1; j += 4) {
+          dot4(rows, a + r0 + j * lda, lda, x + r0, out + j);
+        }
+        for (; j < j1; j++) {
+          out[j] = dot(rows, a + r0 + j * lda, x + r0);
+        }
+      }
+    });
+    forEach(pool, colBlocks, [&](long first, long last) {
+      for (long j = first * DOT_COLUMNS; j < std::min(n, last * DOT_COLUMNS); j++) {
+        float s = partial[j];
+        for (long b = 1; b < rowBlocks; b++) {
+          s += partial[b * n + j];
+        }
+        update(y + j * incy, alpha, s, beta);
+      }
+    });
+  }
+
+  // Element (i, j) of op(A)
+  inline float at(const float* a, long lda, bool trans, long i, long j) {
+    return trans ? a[j + i * lda] : a[i + j * lda];
+  }
+
+  // The block of op(A) from element (i, j), as gemm and gemv take it with the same transpose
+  inline const float* block(const float* a, long lda, bool trans, long i, long j) {
+    return trans ? a + j + i * lda : a + i + j * lda;
+  }
+
+  // Solves op(T) * y = x in place for an n x n block T on the diagonal, where lower is the
+  // triangle of op(T)
+  void solveBlock(long n, bool trans, bool unit, bool lower, const float* t, long ldt, float* x, long inc) {
+    for (long s = 0; s < n; s++) {
+      long i = lower ? s : n - 1 - s;
+      float v = x[i * inc];
+      long first = lower ? 0 : i + 1;
+      long last = lower ? i : n;
+      for (long p = first; p < last; p++) {
+        v -= at(t, ldt, trans, i, p) * x[p * inc];
+      }
+      x[i * inc] = unit ? v : v / at(t, ldt, trans, i, i);
+    }
+  }
+
+  // x = op(T) * x in place for an n x n block T on the diagonal. Each element is written
+  // after the elements that it is computed from are read.
+  void multiplyBlock(long n, bool trans, bool unit, bool lower, const float* t, long ldt, float* x, long inc) {
+    for (long s = 0; s < n; s++) {
+      long i = lower ? n - 1 - s : s;
+      float v = unit ? x[i * inc] : at(t, ldt, trans, i, i) * x[i * inc];
+      long first = lower ? 0 : i + 1;
+      long last = lower ? i : n;
+      for (long p = first; p < last; p++) {
+        v += at(t, ldt, trans, i, p) * x[p * inc];
+      }
+      x[i * inc] = v;
+    }
+  }
+
+  // Runs a diagonal block on each of count vectors, step apart, in parallel
+  void eachVector(Ferrum::ThreadPool* pool, long count, long work,
+                  const std::function<void(long vector)>& body) {
+    long tasks = (count + TRI_VECTORS - 1) / TRI_VECTORS;
+    forEach(count * work < MIN_PARALLEL ? nullptr : pool, tasks, [&](long first, long last) {
+      for (long v = first * TRI_VECTORS; v < std::min(count, last * TRI_VECTORS); v++) {
+        body(v);
+      }
+    });
+  }
+
+  // B = alpha * B over an m x n block
+  void scaleMatrix(Ferrum::ThreadPool* pool, long m, long n, float alpha, float* b, long ldb) {
+    forEach(m * n < MIN_PARALLEL ? nullptr : pool, (n + NT - 1) / NT, [&](long first, long last) {
+      for (long t = first; t < last; t++) {
+        scale(m, std::min(NT, n - t * NT), alpha, b + t * NT * ldb, ldb);
+      }
+    });
+  }
+
+  // Runs a diagonal block on the right over blocks of rows of B in parallel
+  void eachRows(Ferrum::ThreadPool* pool, long rows, long work,
+                const std::function<void(long first, long count)>& body) {
+    long tasks = (rows + TRI_ROWS - 1) / TRI_ROWS;
+    forEach(rows * work < MIN_PARALLEL ? nullptr : pool, tasks, [&](long first, long last) {
+      for (long t = first; t < last; t++) {
+        body(t * TRI_ROWS, std::min(TRI_ROWS, rows - t * TRI_ROWS));
+      }
+    });
+  }
+
+  // B = B * op(T) in place over rows of B, for an sd x sd block T on the diagonal. Column j of the
+  // result adds the columns of B on lower's side of it, so those are written after it.
+  void multiplyColumns(long sd, long rows, bool trans, bool unit, bool lower, const float* t, long ldt,
+                       float* b, long ldb) {
+    for (long s = 0; s < sd; s++) {
+      long j = lower ? s : sd - 1 - s;
+      float* bj = b + j * ldb;
+      if (!unit) {
+        float d = at(t, ldt, trans, j, j);
+        for (long i = 0; i < rows; i++) {
+          bj[i] *= d;
+        }
+      }
+      long first = lower ? j + 1 : 0;
+      long last = lower ? sd : j;
+      for (long p = first; p < last; p++) {
+        axpy(rows, at(t, ldt, trans, p, j), b + p * ldb, bj);
+      }
+    }
+  }
+
+  // Solves X * op(T) = B in place over rows of B, a column at a time: column j takes away the
+  // columns of X that are solved before it, and is divided by the diagonal
+  void solveColumns(long sd, long rows, bool trans, bool unit, bool lower, const float* t, long ldt,
+                    float* b, long ldb) {
+    for (long s = 0; s < sd; s++) {
+      long j = lower ? sd - 1 - s : s;
+      float* bj = b + j * ldb;
+      long first = lower ? j + 1 : 0;
+      long last = lower ? sd : j;
+      for (long p = first; p < last; p++) {
+        axpy(rows, -at(t, ldt, trans, p, j), b + p * ldb, bj);
+      }
+      if (!unit) {
+        float d = 1.0f / at(t, ldt, trans, j, j);
+        for (long i = 0; i < rows; i++) {
+          bj[i] *= d;
+        }
+      }
+    }
+  }
+
+  // B = op(A) * B (left) or B * op(A) (right) for an sd x sd triangle, where lower is the triangle of
+  // op(A) and count is the number of columns (left) or rows (right) of B. The triangle is cut in
+  // halves until it is small, and the product of a half with the other part of B is added by gemm,
+  // after the part that it reads has been used and before the part that it writes is.
+  void multiplyTriangle(Ferrum::ThreadPool* pool, bool left, bool trans, long sd, long count, bool unit, bool lower,
+                        const float* a, long lda, float* b, long ldb) {
+    if (sd <= TRI_LEAF && left) {
+      eachVector(pool, count, sd * sd, [&](long v) {
+        multiplyBlock(sd, trans, unit, lower, a, lda, b + v * ldb, 1);
+      });
+      return;
+    }
+    if (sd <= TRI_LEAF) {
+      eachRows(pool, count, sd * sd, [&](long first, long rows) {
+        multiplyColumns(sd, rows, trans, unit, lower, a, lda, b + first, ldb);
+      });
+      return;
+    }
+    long h = sd / 2;
+    const float* a22 = a + h + h * lda;
+    float* b2 = left ? b + h : b + h * ldb;
+    // the second half goes first when the gemm reads the first half of B, as it must be read unchanged
+    bool backward = left == lower;
+    if (backward) {
+      multiplyTriangle(pool, left, trans, sd - h, count, unit, lower, a22, lda, b2, ldb);
+    } else {
+      multiplyTriangle(pool, left, trans, h, count, unit, lower, a, lda, b, ldb);
+    }
+    if (left && lower) {
+      hostGemm(pool, trans, false, sd - h, count, h, 1.0f, block(a, lda, trans, h, 0), lda, b, ldb, 1.0f, b2, ldb);
+    } else if (left) {
+      hostGemm(pool, trans, false, h, count, sd - h, 1.0f, block(a, lda, trans, 0, h), lda, b2, ldb, 1.0f, b, ldb);
+    } else if (lower) {
+      hostGemm(pool, false, trans, count, h, sd - h, 1.0f, b2, ldb, block(a, lda, trans, h, 0), lda, 1.0f, b, ldb);
+    } else {
+      hostGemm(pool, false, trans, count, sd - h, h, 1.0f, b, ldb, block(a, lda, trans, 0, h), lda, 1.0f, b2, ldb);
+    }
+    if (backward) {
+      multiplyTriangle(pool, left, trans, h, count, unit, lower, a, lda, b, ldb);
+    } else {
+      multiplyTriangle(pool, left, trans, sd - h, count, unit, lower, a22, lda, b2, ldb);
+    }
+  }
+
+  // Solves op(A) * X = B (left) or X * op(A) = B (right) in place, in halves as multiplyTriangle
+  // does: the half that is solved first has its product taken from the rest of B by gemm
+  void solveTriangle(Ferrum::ThreadPool* pool, bool left, bool trans, long sd, long count, bool unit, bool lower,
+                     const float* a, long lda, float* b, long ldb) {
+    if (sd <= TRI_LEAF && left) {
+      eachVector(pool, count, sd * sd, [&](long v) {
+        solveBlock(sd, trans, unit, lower, a, lda, b + v * ldb, 1);
+      });
+      return;
+    }
+    if (sd <= TRI_LEAF) {
+      eachRows(pool, count, sd * sd, [&](long first, long rows) {
+        solveColumns(sd, rows, trans, unit, lower, a, lda, b + first, ldb);
+      });
+      return;
+    }
+    long h = sd / 2;
+    const float* a22 = a + h + h * lda;
+    float* b2 = left ? b + h : b + h * ldb;
+    // the first half goes first when the rest of B depends on it
+    bool forward = left == lower;
+    if (forward) {
+      solveTriangle(pool, left, trans, h, count, unit, lower, a, lda, b, ldb);
+    } else {
+      solveTriangle(pool, left, trans, sd - h, count, unit, lower, a22, lda, b2, ldb);
+    }
+    if (left && lower) {
+      hostGemm(pool, trans, false, sd - h, count, h, -1.0f, block(a, lda, trans, h, 0), lda, b, ldb, 1.0f, b2, ldb);
+    } else if (left) {
+      hostGemm(pool, trans, false, h, count, sd - h, -1.0f, block(a, lda, trans, 0, h), lda, b2, ldb, 1.0f, b, ldb);
+    } else if (lower) {
+      hostGemm(pool, false, trans, count, h, sd - h, -1.0f, b2, ldb, block(a, lda, trans, h, 0), lda, 1.0f, b, ldb);
+    } else {
+      hostGemm(pool, false, trans, count, sd - h, h, -1.0f, b, ldb, block(a, lda, trans, 0, h), lda, 1.0f, b2, ldb);
+    }
+    if (forward) {
+      solveTriangle(pool, left, trans, sd - h, count, unit, lower, a22, lda, b2, ldb);
+    } else {
+      solveTriangle(pool, left, trans, h, count, unit, lower, a, lda, b, ldb);
+    }
+  }
+
+  // Factors an n x n block on the diagonal in place, a column at a time, where element (i, j)
+  // of the lower factor is read from the upper triangle, transposed, when not lower. Returns 0,
+  // or the order of the first leading minor that is not positive definite.
+  long factorBlock(long n, bool lower, float* a, long lda) {
+    auto ref = [&](long i, long j) -> float& { return lower ? a[i + j * lda] : a[j + i * lda]; };
+    for (long j = 0; j < n; j++) {
+      float d = ref(j, j);
+      for (long p = 0; p < j; p++) {
+        d -= ref(j, p) * ref(j, p);
+      }
+      // also fails on NaN
+      if (!(d > 0.0f)) {
+        ref(j, j) = d;
+        return j + 1;
+      }
+      float diagonal = std::sqrt(d);
+      ref(j, j) = diagonal;
+      for (long i = j + 1; i < n; i++) {
+        float v = ref(i, j);
+        for (long p = 0; p < j; p++) {
+          v -= ref(i, p) * ref(j, p);
+        }
+        ref(i, j) = v / diagonal;
+      }
+    }
+    return 0;
+  }
+
+  // out += T * x (or T^T * x when trans) over rows [r0, r1) of the result, for the packed sd x sd
+  // triangle T, without its diagonal when diagonal is false. out holds the rows from r0. Without the
+  // transpose, each column that crosses the rows adds its part; with it, each row is a column's dot.
+  void packedRows(long sd, bool lower, bool trans, bool diagonal, const float* ap, const float* x,
+                  long r0, long r1, float* out) {
+    long skip = diagonal ? 0 : 1;
+    if (trans) {
+      for (long i = r0; i < r1; i++) {
+        long first = lower ? i + skip : 0;
+        long last = lower ? sd : i + 1 - skip;
+        if (first < last) {
+          out[i - r0] += dot(last - first, ap + Ferrum::packedIndex(sd, lower, first, i), x + first);
+        }
+      }
+      return;
+    }
+    long j0 = lower ? 0 : r0;
+    long j1 = lower ? r1 : sd;
+    for (long j = j0; j < j1; j++) {
+      long first = lower ? std::max(r0, j + skip) : r0;
+      long last = lower ? r1 : std::min(r1, j + 1 - skip);
+      if (first < last) {
+        axpy(last - first, x[j], ap + Ferrum::packedIndex(sd, lower, first, j), out + (first - r0));
+      }
+    }
+  }
+
+  // Runs a packed product over blocks of the rows of its result in parallel
+  void eachPacked(Ferrum::ThreadPool* pool, long sd, const std::function<void(long r0, long r1, float* out)>& body) {
+    long tasks = (sd + PACKED_ROWS - 1) / PACKED_ROWS;
+    forEach(Ferrum::packedLength(sd) < MIN_PARALLEL ? nullptr : pool, tasks, [&](long first, long last) {
+      float out[PACKED_ROWS];
+      for (long t = first; t < last; t++) {
+        long r0 = t * PACKED_ROWS;
+        long r1 = std::min(sd, r0 + PACKED_ROWS);
+        std::fill(out, out + (r1 - r0), 0.0f);
+        body(r0, r1, out);
+      }
+    });
+  }
+
+  // Copies the triangle's columns between full and packed storage in parallel
+  void eachPackedColumn(Ferrum::ThreadPool* pool, long sd, bool lower,
+                        const std::function<void(long j, long first, long count)>& body) {
+    long tasks = (sd + PACKED_COLUMNS - 1) / PACKED_COLUMNS;
+    forEach(Ferrum::packedLength(sd) < MIN_PARALLEL ? nullptr : pool, tasks, [&](long first, long last) {
+      for (long j = first * PACKED_COLUMNS; j < std::min(sd, last * PACKED_COLUMNS); j++) {
+        body(j, lower ? j : 0, lower ? sd - j : j + 1);
+      }
+    });
+  }
+
+  // B = alpha * A^T for a 4 x 4 block: columns of A are loaded as vectors, turned into rows, and
+  // stored as columns of B
+  void transpose4(float alpha, const float* a, long lda, float* b, long ldb) {
+    Lane c0 = load(a);
+    Lane c1 = load(a + lda);
+    Lane c2 = load(a + 2 * lda);
+    Lane c3 = load(a + 3 * lda);
+    Lane t0 = {c0[0], c1[0], c2[0], c3[0]};
+    Lane t1 = {c0[1], c1[1], c2[1], c3[1]};
+    Lane t2 = {c0[2], c1[2], c2[2], c3[2]};
+    Lane t3 = {c0[3], c1[3], c2[3], c3[3]};
+    store(b, t0 * alpha);
+    store(b + ldb, t1 * alpha);
+    store(b + 2 * ldb, t2 * alpha);
+    store(b + 3 * ldb, t3 * alpha);
+  }
+
+  // B = alpha * A^T for an m x n block of A, no larger than TRANSPOSE_BLOCK, in 4 x 4 blocks with
+  // the edges an element at a time. The block of B is built in a buffer and copied out a column at
+  // a time, as with a leading dimension of a large power of two the columns of B in a block would
+  // fall on the same cache sets.
+  void transposeBlock(long m, long n, float alpha, const float* a, long lda, float* b, long ldb) {
+    float t[TRANSPOSE_BLOCK * TRANSPOSE_BLOCK];
+    long m4 = m - m % 4;
+    long n4 = n - n % 4;
+    for (long j = 0; j < n4; j += 4) {
+      for (long i = 0; i < m4; i += 4) {
+        transpose4(alpha, a + i + j * lda, lda, t + j + i * TRANSPOSE_BLOCK, TRANSPOSE_BLOCK);
+      }
+    }
+    for (long j = 0; j < n; j++) {
+      for (long i = j < n4 ? m4 : 0; i < m; i++) {
+        t[j + i * TRANSPOSE_BLOCK] = alpha * a[i + j * lda];
+      }
+    }
+    for (long i = 0; i < m; i++) {
+      std::memcpy(b + i * ldb, t + i * TRANSPOSE_BLOCK, n * sizeof(float));
+    }
+  }
+
+} // namespace
+
+void Ferrum::hostGemm(Ferrum::ThreadPool* pool, bool transA, bool transB, long m, long n, long k, float alpha,
+                      const float* a, long lda, const float* b, long ldb, float beta, float* c, long ldc) {
+  if (m <= 0 || n <= 0) {
+    return;
+  }
+  if (k <= 0 || alpha == 0.0f) {
+    forEach(pool, (n + NT - 1) / NT, [&](long first, long last) {
+      for (long t = first; t < last; t++) {
+        scale(m, std::min(NT, n - t * NT), beta, c + t * NT * ldc, ldc);
+      }
+    });
+    return;
+  }
+
+  std::vector<float> panel(((std::min(NC, n) + NR - 1) / NR) * NR * std::min(KC, k));
+  for (long jc = 0; jc < n; jc += NC) {
+    long nc = std::min(NC, n - jc);
+    long slivers = (nc + NR - 1) / NR;
+    for (long pc = 0; pc < k; pc += KC) {
+      long kc = std::min(KC, k - pc);
+      forEach(pool, slivers, [&](long first, long last) {
+        for (long s = first; s < last; s++) {
+          packB(transB, b, ldb, pc, kc, jc + s * NR, std::min(NR, nc - s * NR), panel.data() + s * kc * NR);
+        }
+      });
+
+      long rowTiles = (m + MC - 1) / MC;
+      long colTiles = (nc + NT - 1) / NT;
+      forEach(pool, rowTiles * colTiles, [&](long first, long last) {
+        thread_local std::vector<float> block;
+        block.resize(((MC + MR - 1) / MR) * MR * KC);
+        for (long t = first; t < last; t++) {
+          long i0 = (t % rowTiles) * MC;
+          long mc = std::min(MC, m - i0);
+          long j0 = (t / rowTiles) * NT;
+          long nt = std::min(NT, nc - j0);
+          float* tile = c + i0 + (jc + j0) * ldc;
+          // C is scaled by beta before its first product is added
+          if (pc == 0) {
+            scale(mc, nt, beta, tile, ldc);
+          }
+          packA(transA, a, lda, i0, mc, pc, kc, block.data());
+          for (long jr = 0; jr < nt; jr += NR) {
+            const float* sliverB = panel.data() + ((j0 + jr) / NR) * kc * NR;
+            for (long ir = 0; ir < mc; ir += MR) {
+              microKernel(kc, block.data() + ir * kc, sliverB, alpha, tile + ir + jr * ldc, ldc,
+                          std::min(MR, mc - ir), std::min(NR, nt - jr));
+            }
+          }
+        }
+      });
+    }
+  }
+}
+
+void Ferrum::hostGemv(Ferrum::ThreadPool* pool, bool trans, long m, long n, float alpha, const float* a, long lda,
+                      const float* x, long incx, float beta, float* y, long incy) {
+  long rows = trans ? n : m;
+  long cols = trans ? m : n;
+  if (rows <= 0) {
+    return;
+  }
+  if (cols <= 0 || alpha == 0.0f) {
+    for (long i = 0; i < rows; i++) {
+      update(y + i * incy, 0.0f, 0.0f, beta);
+    }
+    return;
+  }
+  if (m * n < MIN_PARALLEL) {
+    pool = nullptr;
+  }
+  std::vector<float> packed;
+  const float* xs = contiguous(x, cols, incx, packed);
+  if (trans) {
+    gemvT(pool, m, n, alpha, a, lda, xs, beta, y, incy);
+  } else {
+    gemvN(pool, m, n, alpha, a, lda, xs, beta, y, incy);
+  }
+}
+
+void Ferrum::hostGer(Ferrum::ThreadPool* pool, long m, long n, float alpha, const float* x, long incx,
+                     const float* y, long incy, float* a, long lda) {
+  if (m <= 0 || n <= 0 || alpha == 0.0f) {
+    return;
+  }
+  if (m * n < MIN_PARALLEL) {
+    pool = nullptr;
+  }
+  std::vector<float> packed;
+  const float* xs = contiguous(x, m, incx, packed);
+  long rowBlocks = (m + DOT_ROWS - 1) / DOT_ROWS;
+  long colBlocks = (n + DOT_COLUMNS - 1) / DOT_COLUMNS;
+  forEach(pool, rowBlocks * colBlocks, [&](long first, long last) {
+    for (long t = first; t < last; t++) {
+      long r0 = (t % rowBlocks) * DOT_ROWS;
+      long rows = std::min(DOT_ROWS, m - r0);
+      long j0 = (t / rowBlocks) * DOT_COLUMNS;
+      for (long j = j0; j < std::min(n, j0 + DOT_COLUMNS); j++) {
+        axpy(rows, alpha * y[j * incy], xs + r0, a + r0 + j * lda);
+      }
+    }
+  });
+}
+
+// The triangular functions step along the diagonal in the order that substitution needs:
+// forwards when op(A) is lower, and backwards when it is upper. Each step works on the block
+// of the diagonal, and passes what that block contributes to the rest of the vector (or
+// matrix) to gemv (or gemm).
+
+void Ferrum::hostTrmv(Ferrum::ThreadPool* pool, bool trans, long sd, bool unit, bool lower, const float* a, long lda,
+                      float* x, long incx) {
+  // lower of op(A)
+  lower = lower != trans;
+  // each block takes the parts of x that are still as they were, which are those before it when
+  // op(A) is lower, so the last block goes first
+  for (long s = 0; s < sd; s += TRI_BLOCK) {
+    long nb = std::min(TRI_BLOCK, sd - s);
+    long j0 = lower ? sd - s - nb : s;
+    multiplyBlock(nb, trans, unit, lower, a + j0 + j0 * lda, lda, x + j0 * incx, incx);
+    long r0 = lower ? 0 : j0 + nb;
+    long rest = lower ? j0 : sd - j0 - nb;
+    if (rest > 0) {
+      hostGemv(pool, trans, trans ? rest : nb, trans ? nb : rest, 1.0f, block(a, lda, trans, j0, r0), lda,
+               x + r0 * incx, incx, 1.0f, x + j0 * incx, incx);
+    }
+  }
+}
+
+void Ferrum::hostTrsv(Ferrum::ThreadPool* pool, bool trans, long sd, bool unit, bool lower, const float* a, long lda,
+                      float* x, long incx) {
+  lower = lower != trans;
+  for (long s = 0; s < sd; s += TRI_BLOCK) {
+    long nb = std::min(TRI_BLOCK, sd - s);
+    long j0 = lower ? s : sd - s - nb;
+    solveBlock(nb, trans, unit, lower, a + j0 + j0 * lda, lda, x + j0 * incx, incx);
+    // the elements still to be solved lose what this block contributes to them
+    long r0 = lower ? j0 + nb : 0;
+    long rest = lower ? sd - j0 - nb : j0;
+    if (rest > 0) {
+      hostGemv(pool, trans, trans ? nb : rest, trans ? rest : nb, -1.0f, block(a, lda, trans, r0, j0), lda,
+               x + j0 * incx, incx, 1.0f, x + r0 * incx, incx);
+    }
+  }
+}
+
+void Ferrum::hostTrmm(Ferrum::ThreadPool* pool, bool left, bool trans, long m, long n, bool unit, bool lower,
+                      float alpha, const float* a, long lda, float* b, long ldb) {
+  if (m <= 0 || n <= 0) {
+    return;
+  }
+  scaleMatrix(pool, m, n, alpha, b, ldb);
+  if (alpha == 0.0f) {
+    return;
+  }
+  multiplyTriangle(pool, left, trans, left ? m : n, left ? n : m, unit, lower != trans, a, lda, b, ldb);
+}
+
+void Ferrum::hostTrsm(Ferrum::ThreadPool* pool, bool left, bool trans, long m, long n, bool unit, bool lower,
+                      float alpha, const float* a, long lda, float* b, long ldb) {
+  if (m <= 0 || n <= 0) {
+    return;
+  }
+  scaleMatrix(pool, m, n, alpha, b, ldb);
+  if (alpha == 0.0f) {
+    return;
+  }
+  solveTriangle(pool, left, trans, left ? m : n, left ? n : m, unit, lower != trans, a, lda, b, ldb);
+}
+
+void Ferrum::hostSyrk(Ferrum::ThreadPool* pool, bool trans, long n, long k, bool lower, float alpha,
+                      const float* a, long lda, float beta, float* c, long ldc) {
+  if (n <= 0) {
+    return;
+  }
+  // column blocks of C are independent: each is a block on the diagonal, and a product of rows of
+  // op(A) with the block's rows for the rest of its column within the triangle
+  long blocks = (n + TRI_BLOCK - 1) / TRI_BLOCK;
+  forEach(pool, blocks, [&](long first, long last) {
+    std::vector<float> diagonal(TRI_BLOCK * TRI_BLOCK);
+    for (long t = first; t < last; t++) {
+      long j0 = t * TRI_BLOCK;
+      long nb = std::min(TRI_BLOCK, n - j0);
+      const float* rows = block(a, lda, trans, j0, 0);
+      hostGemm(nullptr, trans, !trans, nb, nb, k, alpha, rows, lda, rows, lda, 0.0f, diagonal.data(), nb);
+      for (long j = 0; j < nb; j++) {
+        long i0 = lower ? j : 0;
+        long i1 = lower ? nb : j + 1;
+        for (long i = i0; i < i1; i++) {
+          update(c + (j0 + i) + (j0 + j) * ldc, 1.0f, diagonal[i + j * nb], beta);
+        }
+      }
+      long r0 = lower ? j0 + nb : 0;
+      long rest = lower ? n - j0 - nb : j0;
+      if (rest > 0) {
+        hostGemm(pool, trans, !trans, rest, nb, k, alpha, block(a, lda, trans, r0, 0), lda, rows, lda,
+                 beta, c + r0 + j0 * ldc, ldc);
+      }
+    }
+  });
+}
+
+long Ferrum::hostPotrf(Ferrum::ThreadPool* pool, long n, bool lower, float* a, long lda) {
+  for (long j0 = 0; j0 < n; j0 += TRI_BLOCK) {
+    long nb = std::min(TRI_BLOCK, n - j0);
+    float* diagonal = a + j0 + j0 * lda;
+    long minor = factorBlock(nb, lower, diagonal, lda);
+    if (minor != 0) {
+      return j0 + minor;
+    }
+    long rest = n - j0 - nb;
+    if (rest <= 0) {
+      break;
+    }
+    float* trailing = a + (j0 + nb) + (j0 + nb) * lda;
+    if (lower) {
+      // L21 = A21 * L11^-T, then A22 -= L21 * L21^T
+      float* panel = a + (j0 + nb) + j0 * lda;
+      hostTrsm(pool, false, true, rest, nb, false, true, 1.0f, diagonal, lda, panel, lda);
+      hostSyrk(pool, false, rest, nb, true, -1.0f, panel, lda, 1.0f, trailing, lda);
+    } else {
+      // U12 = U11^-T * A12, then A22 -= U12^T * U12
+      float* panel = a + j0 + (j0 + nb) * lda;
+      hostTrsm(pool, true, true, nb, rest, false, false, 1.0f, diagonal, lda, panel, lda);
+      hostSyrk(pool, true, rest, nb, false, -1.0f, panel, lda, 1.0f, trailing, lda);
+    }
+  }
+  return 0;
+}
+
+void Ferrum::hostPotrs(Ferrum::ThreadPool* pool, long n, long nrhs, bool lower, const float* a, long lda,
+                       float* b, long ldb) {
+  // L * L^T * X = B is solved as L * Y = B and then L^T * X = Y, and U^T * U * X = B the other way round
+  hostTrsm(pool, true, !lower, n, nrhs, false, lower, 1.0f, a, lda, b, ldb);
+  hostTrsm(pool, true, lower, n, nrhs, false, lower, 1.0f, a, lda, b, ldb);
+}
+
+void Ferrum::hostTrttp(Ferrum::ThreadPool* pool, long sd, bool lower, const float* a, long lda, float* ap) {
+  eachPackedColumn(pool, sd, lower, [&](long j, long first, long count) {
+    std::memcpy(ap + packedIndex(sd, lower, first, j), a + first + j * lda, count * sizeof(float));
+  });
+}
+
+void Ferrum::hostTpttr(Ferrum::ThreadPool* pool, long sd, bool lower, const float* ap, float* a, long lda) {
+  eachPackedColumn(pool, sd, lower, [&](long j, long first, long count) {
+    std::memcpy(a + first + j * lda, ap + packedIndex(sd, lower, first, j), count * sizeof(float));
+  });
+}
+
+void Ferrum::hostTpmv(Ferrum::ThreadPool* pool, bool trans, long sd, bool unit, bool lower, const float* ap,
+                      float* x, long incx) {
+  if (sd <= 0) {
+    return;
+  }
+  // the result is written over x, so every block reads a copy of it
+  std::vector<float> xs(sd);
+  for (long i = 0; i < sd; i++) {
+    xs[i] = x[i * incx];
+  }
+  eachPacked(pool, sd, [&](long r0, long r1, float* out) {
+    packedRows(sd, lower, trans, !unit, ap, xs.data(), r0, r1, out);
+    for (long i = r0; i < r1; i++) {
+      x[i * incx] = unit ? out[i - r0] + xs[i] : out[i - r0];
+    }
+  });
+}
+
+void Ferrum::hostSpmv(Ferrum::ThreadPool* pool, long sd, bool lower, float alpha, const float* ap,
+                      const float* x, long incx, float beta, float* y, long incy) {
+  if (sd <= 0) {
+    return;
+  }
+  std::vector<float> packed;
+  const float* xs = contiguous(x, sd, incx, packed);
+  // row i of A is row i of the triangle, and the rest of it is column i of the triangle without its diagonal
+  eachPacked(pool, sd, [&](long r0, long r1, float* out) {
+    packedRows(sd, lower, false, true, ap, xs, r0, r1, out);
+    packedRows(sd, lower, true, false, ap, xs, r0, r1, out);
+    for (long i = r0; i < r1; i++) {
+      update(y + i * incy, alpha, out[i - r0], beta);
+    }
+  });
+}
+
+void Ferrum::hostOmatcopy(Ferrum::ThreadPool* pool, bool trans, long m, long n, float alpha,
+                          const float* a, long lda, float* b, long ldb) {
+  if (m <= 0 || n <= 0) {
+    return;
+  }
+  if (!trans) {
+    forEach(m * n < MIN_PARALLEL ? nullptr : pool, (n + NT - 1) / NT, [&](long first, long last) {
+      for (long j = first * NT; j < std::min(n, last * NT); j++) {
+        const float* aj = a + j * lda;
+        float* bj = b + j * ldb;
+        if (alpha == 1.0f) {
+          std::memcpy(bj, aj, m * sizeof(float));
+        } else {
+          for (long i = 0; i < m; i++) {
+            bj[i] = alpha * aj[i];
+          }
+        }
+      }
+    });
+    return;
+  }
+  // consecutive blocks run down a block column of A, and so across a block row of B
+  long rowBlocks = (m + TRANSPOSE_BLOCK - 1) / TRANSPOSE_BLOCK;
+  long blocks = rowBlocks * ((n + TRANSPOSE_BLOCK - 1) / TRANSPOSE_BLOCK);
+  forEach(m * n < MIN_PARALLEL ? nullptr : pool, blocks, [&](long first, long last) {
+    for (long t = first; t < last; t++) {
+      long i0 = (t % rowBlocks) * TRANSPOSE_BLOCK;
+      long j0 = (t / rowBlocks) * TRANSPOSE_BLOCK;
+      transposeBlock(std::min(TRANSPOSE_BLOCK, m - i0), std::min(TRANSPOSE_BLOCK, n - j0), alpha,
+                     a + i0 + j0 * lda, lda, b + j0 + i0 * ldb, ldb);
+    }
+  });
+}
+
+// backends without linear algebra
+
+static float* unsupported(const Ferrum::Backend* backend, const char* function) {
+  std::cerr << "Error: The " << backend->name() << " backend does not run " << function << std::endl;
+  return nullptr;
+}
+
+float* Ferrum::Backend::gemm(int transA, int transB, long m, long n, long k, float alpha,
+                             const float* a, long lena, long offset_a, long lda,
+                             const float* b, long lenb, long offset_b, long ldb,
+                             float beta, float* c, long lenc, long offset_c, long ldc) {
+  return unsupported(this, "gemm");
+}
+
+float* Ferrum::Backend::gemv(int trans, long m, long n, float alpha,
+                             const float* a, long lena, long offset_a, long lda,
+                             const float* x, long lenx, long offset_x, long stride_x,
+                             float beta, float* y, long leny, long offset_y, long stride_y) {
+  return unsupported(this, "gemv");
+}
+
+float* Ferrum::Backend::ger(long m, long n, float alpha,
+                            const float* x, long lenx, long offset_x, long stride_x,
+                            const float* y, long leny, long offset_y, long stride_y,
+                            float* a, long lena, long offset_a, long lda) {
+  return unsupported(this, "ger");
+}
+
+float* Ferrum::Backend::trmv(int trans, long sd, int unit, int bottom,
+                             const float* a, long lena, long offset_a, long lda,
+                             float* x, long lenx, long offset_x, long stride_x) {
+  return unsupported(this, "trmv");
+}
+
+float* Ferrum::Backend::trsv(int trans, long sd, int unit, int bottom,
+                             const float* a, long lena, long offset_a, long lda,
+                             float* x, long lenx, long offset_x, long stride_x) {
+  return unsupported(this, "trsv");
+}
+
+float* Ferrum::Backend::trmm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                             const float* a, long lena, long offset_a, long lda,
+                             float* b, long lenb, long offset_b, long ldb) {
+  return unsupported(this, "trmm");
+}
+
+float* Ferrum::Backend::trsm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                             const float* a, long lena, long offset_a, long lda,
+                             float* b, long lenb, long offset_b, long ldb) {
+  return unsupported(this, "trsm");
+}
+
+float* Ferrum::Backend::syrk(int trans, long n, long k, int bottom, float alpha,
+                             const float* a, long lena, long offset_a, long lda,
+                             float beta, float* c, long lenc, long offset_c, long ldc) {
+  return unsupported(this, "syrk");
+}
+
+float* Ferrum::Backend::potrf(long sd, int bottom, float* a, long lena, long offset_a, long lda) {
+  return unsupported(this, "potrf");
+}
+
+float* Ferrum::Backend::potrs(long sd, long n, int bottom, const float* a, long lena, long offset_a, long lda,
+                              float* b, long lenb, long offset_b, long ldb) {
+  return unsupported(this, "potrs");
+}
+
+float* Ferrum::Backend::trttp(long sd, int bottom, const float* a, long lena, long offset_a, long lda,
+                              float* ap, long lenap, long offset_ap) {
+  return unsupported(this, "trttp");
+}
+
+float* Ferrum::Backend::tpttr(long sd, int bottom, const float* ap, long lenap, long offset_ap,
+                              float* a, long lena, long offset_a, long lda) {
+  return unsupported(this, "tpttr");
+}
+
+float* Ferrum::Backend::tpmv(int trans, long sd, int unit, int bottom, const float* ap, long lenap, long offset_ap,
+                             float* x, long lenx, long offset_x, long stride_x) {
+  return unsupported(this, "tpmv");
+}
+
+float* Ferrum::Backend::spmv(long sd, int bottom, float alpha, const float* ap, long lenap, long offset_ap,
+                             const float* x, long lenx, long offset_x, long stride_x,
+                             float beta, float* y, long leny, long offset_y, long stride_y) {
+  return unsupported(this, "spmv");
+}
+
+float* Ferrum::Backend::omatcopy(int trans, long m, long n, float alpha,
+                                 const float* a, long lena, long offset_a, long lda,
+                                 float* b, long lenb, long offset_b, long ldb) {
+  return unsupported(this, "omatcopy");
+}
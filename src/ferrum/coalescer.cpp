@@ -0,0 +1,372 @@
+#include "coalescer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+static uint32_t bits(float f) {
+  uint32_t b;
+  std::memcpy(&b, &f, sizeof(b));
+  return b;
+}
+
+// The lowest element that n strided elements from first touch, which is an operand's base
+// when it is passed on as a whole array
+template <typename T>
+static T* lowest(T* first, long inc, long n) {
+  return inc < 0 ? first + (n - 1) * inc : first;
+}
+
+static long span(long n, long inc) {
+  return (n - 1) * (inc < 0 ? -inc : inc) + 1;
+}
+
+Ferrum::Coalescer::Coalescer(Ferrum::Backend* backend, long windowMicros, int maxBatch, long maxElements) :
+    engine(backend), windowMicros(windowMicros), maxBatch(maxBatch < 1 ? 1 : maxBatch),
+    maxElements(maxElements), counters() {
+  pool = new HostPool(HostAllocator());
+}
+
+Ferrum::Coalescer::~Coalescer() {
+  delete pool;
+  delete engine;
+}
+
+Ferrum::CoalescerStats Ferrum::Coalescer::stats() const {
+  std::lock_guard<std::mutex> guard(lock);
+  return counters;
+}
+
+// Joins the open batch for this call, or opens one and leads it.
+// The leader waits out the window, closes the batch, and dispatches it for everyone.
+float* Ferrum::Coalescer::submit(Ferrum::FunctionID id, Form form, float sa, float sha, float sb, float shb,
+                                 const Request& request, float* result) {
+  Key key{static_cast<int>(id), form, bits(sa), bits(sha), bits(sb), bits(shb)};
+  std::unique_lock<std::mutex> guard(lock);
+  counters.requests++;
+
+  auto it = open.find(key);
+  if (it != open.end()) {
+    std::shared_ptr<Batch> batch = it->second;
+    batch->requests.push_back(request);
+    if (static_cast<int>(batch->requests.size()) >= maxBatch) {
+      open.erase(it);
+      batch->filled.notify_one();
+    }
+    batch->finished.wait(guard, [&]() { return batch->done; });
+    return batch->failed ? nullptr : result;
+  }
+
+  std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+  batch->key = key;
+  batch->id = id;
+  batch->form = form;
+  batch->sa = sa;
+  batch->sha = sha;
+  batch->sb = sb;
+  batch->shb = shb;
+  batch->done = false;
+  batch->failed = false;
+  batch->requests.push_back(request);
+  open.emplace(key, batch);
+
+  batch->filled.wait_for(guard, std::chrono::microseconds(windowMicros.load()), [&]() {
+    return static_cast<int>(batch->requests.size()) >= maxBatch;
+  });
+  // a follower that filled the batch has already closed it
+  auto self = open.find(key);
+  if (self != open.end() && self->second == batch) {
+    open.erase(self);
+  }
+  counters.batches++;
+  if (batch->requests.size() > 1) {
+    counters.coalesced += batch->requests.size();
+  }
+  guard.unlock();
+
+  // the batch is closed, so its requests can be read without the lock
+  bool ok = dispatch(*batch);
+
+  guard.lock();
+  batch->done = true;
+  batch->failed = !ok;
+  guard.unlock();
+  batch->finished.notify_all();
+  return ok ? result : nullptr;
+}
+
+// Packs every request into contiguous buffers, makes one call, then scatters the results.
+// A lone request is dispatched directly on its own arrays.
+bool Ferrum::Coalescer::dispatch(Batch& batch) {
+  if (batch.requests.size() == 1) {
+    const Request& r = batch.requests[0];
+    const float* b = r.b == nullptr ? nullptr : lowest(r.b, r.inc_b, r.n);
+    long lenb = r.b == nullptr ? 0 : span(r.n, r.inc_b);
+    return call(batch.id, batch.form, r.n, batch.sa, batch.sha, batch.sb, batch.shb,
+                lowest(r.a, r.inc_a, r.n), span(r.n, r.inc_a), 0, r.inc_a, b, lenb, 0, r.inc_b,
+                lowest(r.r, r.inc_r, r.n), span(r.n, r.inc_r), 0, r.inc_r) != nullptr;
+  }
+
+  long total = 0;
+  bool hasB = batch.requests[0].b != nullptr;
+  for (const Request& r : batch.requests) {
+    total += r.n;
+  }
+  size_t bytes = sizeof(float) * total;
+  HostBlock blockA = pool->acquire(bytes);
+  HostBlock blockB = hasB ? pool->acquire(bytes) : HostBlock{nullptr, 0};
+  HostBlock blockR = pool->acquire(bytes);
+  bool ok = blockA && blockR && (blockB || !hasB);
+
+  if (ok) {
+    float* a = static_cast<float*>(blockA.data);
+    float* b = static_cast<float*>(blockB.data);
+    float* r = static_cast<float*>(blockR.data);
+    long base = 0;
+    for (const Request& q : batch.requests) {
+      for (long i = 0; i < q.n; i++) {
+        a[base + i] = q.a[i * q.inc_a];
+      }
+      if (hasB) {
+        for (long i = 0; i < q.n; i++) {
+          b[base + i] = q.b[i * q.inc_b];
+        }
+      }
+      base += q.n;
+    }
+    ok = call(batch.id, batch.form, total, batch.sa, batch.sha, batch.sb, batch.shb,
+              a, total, 0, 1, b, hasB ? total : 0, 0, 1, r, total, 0, 1) != nullptr;
+    if (ok) {
+      base = 0;
+      for (const Request& q : batch.requests) {
+        for (long i = 0; i < q.n; i++) {
+          q.r[i * q.inc_r] = r[base + i];
+        }
+        base += q.n;
+      }
+    }
+  }
+  pool->release(blockA);
+  pool->release(blockB);
+  pool->release(blockR);
+  return ok;
+}
+
+// Calls the wrapped backend for any of the coalescable forms
+float* Ferrum::Coalescer::call(Ferrum::FunctionID id, Form form, long n, float sa, float sha, float sb, float shb,
+                               const float* a, long lena, long offset_a, long stride_a,
+                               const float* b, long lenb, long offset_b, long stride_b,
+                               float* result, long len, long offset, long stride) {
+  switch (form) {
+    case Form::BB:
+      return engine->vect_bB(id, n, a, lena, offset_a, stride_a, result, len, offset, stride);
+    case Form::BFB:
+      return engine->vect_bfB(id, n, a, lena, offset_a, stride_a, sa, result, len, offset, stride);
+    case Form::FBB:
+      return engine->vect_fbB(id, n, sa, a, lena, offset_a, stride_a, result, len, offset, stride);
+    case Form::BBB:
+      return engine->vect_bbB(id, n, a, lena, offset_a, stride_a, b, lenb, offset_b, stride_b,
+                              result, len, offset, stride);
+    case Form::BFFFFB:
+      return engine->vect_bffffB(id, n, a, lena, offset_a, stride_a, sa, sha, sb, shb,
+                                 result, len, offset, stride);
+    case Form::BBFFFFB:
+      return engine->vect_bbffffB(id, n, a, lena, offset_a, stride_a, b, lenb, offset_b, stride_b,
+                                  sa, sha, sb, shb, result, len, offset, stride);
+  }
+  return nullptr;
+}
+
+// Small calls go through submit, everything else straight to the wrapped backend
+float* Ferrum::Coalescer::route(Ferrum::FunctionID id, Form form, long n, float sa, float sha, float sb, float shb,
+                                const float* a, long lena, long offset_a, long stride_a,
+                                const float* b, long lenb, long offset_b, long stride_b,
+                                float* result, long len, long offset, long stride) {
+  // calls that overrun their arrays go straight through, and are rejected there
+  bool inBounds = holds(lena, offset_a, stride_a, n) && holds(len, offset, stride, n) &&
+                  (b == nullptr || holds(lenb, offset_b, stride_b, n));
+  if (n <= 0 || n > maxElements || !inBounds) {
+    return call(id, form, n, sa, sha, sb, shb, a, lena, offset_a, stride_a, b, lenb, offset_b, stride_b,
+                result, len, offset, stride);
+  }
+  Request request{a + firstIndex(offset_a, stride_a, n), stride_a,
+                  b == nullptr ? nullptr : b + firstIndex(offset_b, stride_b, n), stride_b,
+                  result + firstIndex(offset, stride, n), stride, n};
+  return submit(id, form, sa, sha, sb, shb, request, result);
+}
+
+// general vector functions
+float* Ferrum::Coalescer::vect_bB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                  float* result, long len, long offset, long stride) {
+  return route(id, Form::BB, n, 0, 0, 0, 0, a, lena, offset_a, stride_a, nullptr, 0, 0, 0,
+               result, len, offset, stride);
+}
+
+float* Ferrum::Coalescer::vect_bfB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                   float sa,
+                                   float* result, long len, long offset, long stride) {
+  return route(id, Form::BFB, n, sa, 0, 0, 0, a, lena, offset_a, stride_a, nullptr, 0, 0, 0,
+               result, len, offset, stride);
+}
+
+float* Ferrum::Coalescer::vect_fbB(Ferrum::FunctionID id, long n, float sa,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* result, long len, long offset, long stride) {
+  return route(id, Form::FBB, n, sa, 0, 0, 0, a, lena, offset_a, stride_a, nullptr, 0, 0, 0,
+               result, len, offset, stride);
+}
+
+float* Ferrum::Coalescer::vect_bbB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                   const float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) {
+  return route(id, Form::BBB, n, 0, 0, 0, 0, a, lena, offset_a, stride_a, b, lenb, offset_b, stride_b,
+               result, len, offset, stride);
+}
+
+float* Ferrum::Coalescer::vect_bBB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                   float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) {
+  return engine->vect_bBB(id, n, a, lena, offset_a, stride_a,
+                          b, lenb, offset_b, stride_b,
+                          result, len, offset, stride);
+}
+
+float* Ferrum::Coalescer::vect_bffffB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                      float sa, float sha,
+                                      float sb, float shb,
+                                      float* result, long len, long offset, long stride) {
+  return route(id, Form::BFFFFB, n, sa, sha, sb, shb, a, lena, offset_a, stride_a, nullptr, 0, 0, 0,
+               result, len, offset, stride);
+}
+
+float* Ferrum::Coalescer::vect_bbffffB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                       const float* b, long lenb, long offset_b, long stride_b,
+                                       float sa, float sha,
+                                       float sb, float shb,
+                                       float* result, long len, long offset, long stride) {
+  return route(id, Form::BBFFFFB, n, sa, sha, sb, shb, a, lena, offset_a, stride_a, b, lenb, offset_b, stride_b,
+               result, len, offset, stride);
+}
+
+// Matrix functions are not coalesced
+
+// general matrix functions
+float* Ferrum::Coalescer::ge_bB(Ferrum::FunctionID id, long sd, long fd,
+                                const float* a, long lena, long offset_a, long stride_a,
+                                float* result, long len, long offset, long stride) {
+  return engine->ge_bB(id, sd, fd, a, lena, offset_a, stride_a, result, len, offset, stride);
+}
+
+float* Ferrum::Coalescer::ge_bfB(Ferrum::FunctionID id, long sd, long fd,
+                                 const float* a, long lena, long offset_a, long stride_a,
+                                 float sa,
+                                 float* result, long len, long offset, long stride) {
+  return engine->ge_bfB(id, sd, fd, a, lena, offset_a, stride_a, sa, result, len, offset, stride);
+}
+
+float* Ferrum::Coalescer::ge_fbB(Ferrum::FunctionID id, long sd, long fd, float sa,
+                                 const float* a, long lena, long offset_a, long stride_a,
+                                 float* result, long len, long offset, long stride) {
+  return engine->ge_fbB(id, sd, fd, sa, a, lena, offset_a, stride_a, result, len, offset, stride);
+}
+
+float* Ferrum::Coalescer::ge_bbB(Ferrum::FunctionID id, long sd, long fd,
+                                 const float* a, long lena, long offset_a, long stride_a,
+                                 const float* b, long lenb, long offset_b, long stride_b,
+                                 float* result, long len, long offset, long stride) {
+  return engine->ge_bbB(id, sd, fd, a, lena, offset_a, stride_a,
+                        b, lenb, offset_b, stride_b,
+                        result, len, offset, stride);
+}
+
+float* Ferrum::Coalescer::ge_bBB(Ferrum::FunctionID id, long sd, long fd,
+                                 const float* a, long lena, long offset_a, long stride_a,
+                                 float* b, long lenb, long offset_b, long stride_b,
+                                 float* result, long len, long offset, long stride) {
+  return engine->ge_bBB(id, sd, fd, a, lena, offset_a, stride_a,
+                        b, lenb, offset_b, stride_b,
+                        result, len, offset, stride);
+}
+
+float* Ferrum::Coalescer::ge_bffffB(Ferrum::FunctionID id, long sd, long fd,
+                                    const float* a, long lena, long offset_a, long stride_a,
+                                    float sa, float sha,
+                                    float sb, float shb,
+                                    float* result, long len, long offset, long stride) {
+  return engine->ge_bffffB(id, sd, fd, a, lena, offset_a, stride_a,
+                           sa, sha, sb, shb,
+                           result, len, offset, stride);
+}
+
+float* Ferrum::Coalescer::ge_bbffffB(Ferrum::FunctionID id, long sd, long fd,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     const float* b, long lenb, long offset_b, long stride_b,
+                                     float sa, float sha,
+                                     float sb, float shb,
+                                     float* result, long len, long offset, long stride) {
+  return engine->ge_bbffffB(id, sd, fd, a, lena, offset_a, stride_a,
+                            b, lenb, offset_b, stride_b,
+                            sa, sha, sb, shb,
+                            result, len, offset, stride);
+}
+
+// general uplo functions
+float* Ferrum::Coalescer::uplo_bB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                  const float* a, long lena, long offset_a, long stride_a,
+                                  float* result, long len, long offset, long stride) {
+  return engine->uplo_bB(id, sd, unit, bottom, a, lena, offset_a, stride_a, result, len, offset, stride);
+}
+
+float* Ferrum::Coalescer::uplo_bfB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float sa,
+                                   float* result, long len, long offset, long stride) {
+  return engine->uplo_bfB(id, sd, unit, bottom, a, lena, offset_a, stride_a, sa, result, len, offset, stride);
+}
+
+float* Ferrum::Coalescer::uplo_fbB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float sa,
+                                   float* result, long len, long offset, long stride) {
+  return engine->uplo_fbB(id, sd, unit, bottom, a, lena, offset_a, stride_a, sa, result, len, offset, stride);
+}
+
+float* Ferrum::Coalescer::uplo_bbB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   const float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) {
+  return engine->uplo_bbB(id, sd, unit, bottom, a, lena, offset_a, stride_a,
+                          b, lenb, offset_b, stride_b,
+                          result, len, offset, stride);
+}
+
+float* Ferrum::Coalescer::uplo_bBB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) {
+  return engine->uplo_bBB(id, sd, unit, bottom, a, lena, offset_a, stride_a,
+                          b, lenb, offset_b, stride_b,
+                          result, len, offset, stride);
+}
+
+float* Ferrum::Coalescer::uplo_bffffB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                      const float* a, long lena, long offset_a, long stride_a,
+                                      float sa, float sha,
+                                      float sb, float shb,
+                                      float* result, long len, long offset, long stride) {
+  return engine->uplo_bffffB(id, sd, unit, bottom, a, lena, offset_a, stride_a,
+                             sa, sha, sb, shb,
+                             result, len, offset, stride);
+}
+
+float* Ferrum::Coalescer::uplo_bbffffB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                       const float* a, long lena, long offset_a, long stride_a,
+                                       const float* b, long lenb, long offset_b, long stride_b,
+                                       float sa, float sha,
+                                       float sb, float shb,
+                                       float* result, long len, long offset, long stride) {
+  return engine->uplo_bbffffB(id, sd, unit, bottom, a, lena, offset_a, stride_a,
+                              b, lenb, offset_b, stride_b,
+                              sa, sha, sb, shb,
+                              result, len, offset, stride);
+}
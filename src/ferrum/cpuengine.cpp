@@ -0,0 +1,1024 @@
+#include "cpuengine.hpp"
+#include "blas.hpp"
+#include "expression.hpp"
+#include "graph.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <sys/sysctl.h>
+#endif
+
+static const long DEFAULT_L2_BYTES = 1024 * 1024;
+
+static long l2CacheBytes() {
+  long bytes = 0;
+#if defined(__APPLE__)
+  size_t size = sizeof(bytes);
+  if (sysctlbyname("hw.l2cachesize", &bytes, &size, nullptr, 0) != 0) {
+    bytes = 0;
+  }
+#elif defined(_SC_LEVEL2_CACHE_SIZE)
+  bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+  return bytes > 0 ? bytes : DEFAULT_L2_BYTES;
+}
+
+// tests that an sd x fd column major matrix fits in an array
+static bool fits(long sd, long fd, long len, long offset, long ld) {
+  if (sd <= 0 || fd <= 0) {
+    return true;
+  }
+  return offset >= 0 && ld >= sd && offset + (sd - 1) + (fd - 1) * ld < len;
+}
+
+static float* outOfBounds(Ferrum::FunctionID id) {
+  std::cerr << "Error: Matrix does not fit in its array for function '" << Ferrum::kernelName(id) << "'" << std::endl;
+  return nullptr;
+}
+
+static float* vectorOutOfBounds(Ferrum::FunctionID id) {
+  std::cerr << "Error: Vector does not fit in its array for function '" << Ferrum::kernelName(id) << "'" << std::endl;
+  return nullptr;
+}
+
+// The run starting i elements further along
+static Ferrum::Run advance(const Ferrum::Run& run, long i) {
+  return Ferrum::Run{run.a + i * run.inc_a, run.inc_a,
+                     run.b == nullptr ? nullptr : run.b + i * run.inc_b, run.inc_b,
+                     run.q == nullptr ? nullptr : run.q + i * run.inc_q, run.inc_q,
+                     run.r + i * run.inc_r, run.inc_r};
+}
+
+// Rows [first, ...) of column j. Matrix runs carry the leading dimension of each operand
+// in place of the increment.
+static Ferrum::Run column(const Ferrum::Run& run, long first, long j) {
+  return Ferrum::Run{run.a + first + j * run.inc_a, 1,
+                     run.b == nullptr ? nullptr : run.b + first + j * run.inc_b, 1,
+                     run.q == nullptr ? nullptr : run.q + first + j * run.inc_q, 1,
+                     run.r + first + j * run.inc_r, 1};
+}
+
+
+// The number of arrays that a kernel reads or writes
+static long streams(Ferrum::KernelKind kind) {
+  return kind == Ferrum::KernelKind::UNARY ? 2 : 3;
+}
+
+
+Ferrum::CpuEngine::CpuEngine(int threads, const std::vector<int>& cpus, const Ferrum::NumaTopology& topology) :
+    topology(topology), counters(new NodeCounters[topology.nodeCount()]) {
+  std::vector<int> workerCpus = cpus;
+  std::vector<int> workerNodes;
+  if (workerCpus.empty() && topology.nodeCount() > 1) {
+    // deal CPUs out a node at a time, so that a short pool still reaches every node
+    const std::vector<NumaNode>& nodes = topology.nodes();
+    for (size_t i = 0; workerCpus.size() < topology.cpus().size(); i++) {
+      for (int n = 0; n < topology.nodeCount(); n++) {
+        if (i < nodes[n].cpus.size()) {
+          workerCpus.push_back(nodes[n].cpus[i]);
+          workerNodes.push_back(n);
+        }
+      }
+    }
+  } else {
+    for (int cpu : workerCpus) {
+      workerNodes.push_back(topology.nodeOfCpu(cpu));
+    }
+  }
+  pool = new ThreadPool(threads, workerCpus, workerNodes);
+  cacheElements = l2CacheBytes() / 2 / sizeof(float);
+  resetNodeStats();
+}
+
+std::vector<Ferrum::Backend*> Ferrum::CpuEngine::nodeDevices(const Ferrum::NumaTopology& topology) {
+  std::vector<Backend*> devices;
+  for (const NumaNode& node : topology.nodes()) {
+    // the calling thread works alongside the node's workers
+    int threads = std::max(0, static_cast<int>(node.cpus.size()) - 1);
+    devices.push_back(new CpuEngine(threads, node.cpus, NumaTopology({node})));
+  }
+  return devices;
+}
+
+Ferrum::CpuEngine::~CpuEngine() {
+  delete pool;
+  for (auto& entry : residents) {
+    munmap(const_cast<float*>(entry.first), entry.second.bytes);
+  }
+}
+
+// Elements per piece: enough work to outweigh the cost of handing the piece to another thread,
+// but no more than the operands of a cheap kernel can stream through L2
+long Ferrum::CpuEngine::grain(const Ferrum::CpuKernel& kernel) const {
+  long cacheGrain = std::max(MIN_GRAIN, cacheElements / streams(kernel.kind));
+  return std::clamp(CHUNK_WORK / kernel.cost, MIN_GRAIN, cacheGrain);
+}
+
+std::vector<int> Ferrum::CpuEngine::launchOptions(Ferrum::FunctionID id) const {
+  std::vector<int> threads;
+  int all = threadCount() + 1;
+  if (all > 1) {
+    for (int t = 1; t < all; t *= 2) {
+      threads.push_back(t);
+    }
+    threads.push_back(all);
+  }
+  return threads;
+}
+
+// Resident tensors are mapped directly, so that their pages are not shared with other
+// allocations, and so each page is placed when it is first written
+float* Ferrum::CpuEngine::allocate(long count, Ferrum::Placement placement) {
+  size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  size_t pages = std::max<size_t>(1, (sizeof(float) * count + page - 1) / page);
+  size_t bytes = pages * page;
+  void* data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (data == MAP_FAILED) {
+    std::cerr << "Error: Failed to map " << bytes << " bytes for a resident tensor" << std::endl;
+    return nullptr;
+  }
+  char* bytesAt = static_cast<char*>(data);
+
+  int nodes = topology.nodeCount();
+  size_t segmentPages = (pages + nodes - 1) / nodes;
+  std::vector<long> splits;
+  if (placement == Placement::INTERLEAVED) {
+    topology.interleave(data, bytes);
+  } else if (placement == Placement::FIRST_TOUCH && nodes > 1) {
+    for (int k = 0; k < nodes; k++) {
+      size_t first = std::min(pages, k * segmentPages);
+      size_t last = std::min(pages, (k + 1) * segmentPages);
+      splits.push_back(static_cast<long>(first));
+      if (first < last) {
+        // pins the segment to its node even when a page is stolen by another node's worker
+        topology.preferNode(bytesAt + first * page, (last - first) * page, k);
+      }
+    }
+    splits.push_back(static_cast<long>(pages));
+  } else if (placement == Placement::FIRST_TOUCH) {
+    // a single node engine, such as one of nodeDevices, keeps its memory on its own node
+    topology.preferNode(data, bytes, 0);
+  }
+
+  // fault every page in from the threads that will work on it
+  ThreadPool::Body touch = [&](long begin, long end) {
+    std::memset(bytesAt + begin * page, 0, (end - begin) * page);
+  };
+  if (splits.empty()) {
+    pool->parallelFor(static_cast<long>(pages), 64, touch);
+  } else {
+    pool->parallelFor(static_cast<long>(pages), 64, touch, splits);
+  }
+
+  std::lock_guard<std::mutex> guard(residentLock);
+  residents[static_cast<float*>(data)] = Resident{bytes, placement, segmentPages * page};
+  return static_cast<float*>(data);
+}
+
+void Ferrum::CpuEngine::free(float* data) {
+  std::lock_guard<std::mutex> guard(residentLock);
+  auto it = residents.find(data);
+  if (it == residents.end()) {
+    std::cerr << "Error: Not a resident tensor of this engine" << std::endl;
+    return;
+  }
+  munmap(data, it->second.bytes);
+  residents.erase(it);
+}
+
+std::vector<Ferrum::NodeStats> Ferrum::CpuEngine::nodeStats() const {
+  std::vector<NodeStats> stats;
+  for (int n = 0; n < topology.nodeCount(); n++) {
+    stats.push_back(NodeStats{counters[n].bytes.load(), counters[n].busyNanos.load()});
+  }
+  return stats;
+}
+
+void Ferrum::CpuEngine::resetNodeStats() {
+  for (int n = 0; n < topology.nodeCount(); n++) {
+    counters[n].bytes = 0;
+    counters[n].busyNanos = 0;
+  }
+}
+
+// Finds where a vector call crosses from one node's segment of a FIRST_TOUCH result to the next.
+// Returns false when the result is not node placed, and the call is scheduled as usual.
+bool Ferrum::CpuEngine::nodeSplits(const Ferrum::Run& run, long n, std::vector<long>& splits) const {
+  int nodes = topology.nodeCount();
+  if (run.inc_r <= 0) {
+    return false;
+  }
+  std::lock_guard<std::mutex> guard(residentLock);
+  auto it = residents.upper_bound(run.r);
+  if (it == residents.begin()) {
+    return false;
+  }
+  --it;
+  const Resident& resident = it->second;
+  long offset = run.r - it->first;
+  if (resident.placement != Placement::FIRST_TOUCH || offset >= static_cast<long>(resident.bytes / sizeof(float))) {
+    return false;
+  }
+  long segment = static_cast<long>(resident.segment / sizeof(float));
+  splits.assign(1, 0);
+  for (int k = 1; k < nodes; k++) {
+    // the first index whose result lies in segment k
+    long boundary = k * segment - offset;
+    long index = boundary <= 0 ? 0 : (boundary + run.inc_r - 1) / run.inc_r;
+    splits.push_back(std::min(n, index));
+  }
+  splits.push_back(n);
+  return true;
+}
+
+float* Ferrum::CpuEngine::vector(Ferrum::FunctionID id, Ferrum::KernelKind kind, long n,
+                                 const Ferrum::Run& run, const Ferrum::Scalars& s, float* result) {
+  const CpuKernel& kernel = cpuKernel(id);
+  if (kernel.kind != kind || kernel.shape != KernelShape::VECTOR) {
+    std::cerr << "Error: No vector kernel of this type for function '" << kernelName(id) << "'" << std::endl;
+    return nullptr;
+  }
+  int threads = launch.get(id, n);
+  if (threads == 1 || n * kernel.cost <= INLINE_WORK) {
+    kernel.apply(run, n, s);
+    return result;
+  }
+  long pieceSize = grain(kernel);
+  if (threads > 1) {
+    // a tuned thread count allows no more pieces than threads
+    pieceSize = std::max(pieceSize, (n + threads - 1) / threads);
+  }
+  std::vector<long> splits;
+  if (nodeSplits(run, n, splits)) {
+    long elementBytes = streams(kind) * sizeof(float);
+    pool->parallelFor(n, pieceSize, [&](long begin, long end) {
+      auto start = std::chrono::steady_clock::now();
+      kernel.apply(advance(run, begin), end - begin, s);
+      auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+      int node = static_cast<int>(std::upper_bound(splits.begin(), splits.end(), begin) - splits.begin()) - 1;
+      counters[node].bytes += (end - begin) * elementBytes;
+      counters[node].busyNanos += nanos.count();
+    }, splits);
+  } else {
+    pool->parallelFor(n, pieceSize, [&](long begin, long end) {
+      kernel.apply(advance(run, begin), end - begin, s);
+    });
+  }
+  return result;
+}
+
+// Matrices whose operands are all contiguous (every ld is sd) are one vector. Others are cut into
+// tiles that are whole columns when they are short, and blocks of rows of a column when they are
+// long, each of about a piece of work, so that both a few tall columns and many short ones spread
+// over the pool.
+float* Ferrum::CpuEngine::ge(Ferrum::FunctionID id, Ferrum::KernelKind kind, long sd, long fd,
+                             const Ferrum::Run& run, const Ferrum::Scalars& s, float* result) {
+  const CpuKernel& kernel = cpuKernel(id);
+  if (kernel.kind != kind || kernel.shape != KernelShape::GE) {
+    std::cerr << "Error: No ge kernel of this type for function '" << kernelName(id) << "'" << std::endl;
+    return nullptr;
+  }
+  if (sd <= 0 || fd <= 0) {
+    return result;
+  }
+  long n = sd * fd;
+  long pieceSize = grain(kernel);
+  if (fd == 1 || (run.inc_a == sd && (run.b == nullptr || run.inc_b == sd) &&
+                  (run.q == nullptr || run.inc_q == sd) && run.inc_r == sd)) {
+    Run flat = column(run, 0, 0);
+    if (n * kernel.cost <= INLINE_WORK) {
+      kernel.apply(flat, n, s);
+    } else {
+      pool->parallelFor(n, pieceSize, [&](long begin, long end) {
+        kernel.apply(advance(flat, begin), end - begin, s);
+      });
+    }
+    return result;
+  }
+  long rows = std::min(sd, pieceSize);
+  long cols = std::max(1L, pieceSize / rows);
+  long rowBlocks = (sd + rows - 1) / rows;
+  auto tiles = [&](long first, long last) {
+    for (long t = first; t < last; t++) {
+      long i0 = (t % rowBlocks) * rows;
+      long j0 = (t / rowBlocks) * cols;
+      for (long j = j0; j < std::min(fd, j0 + cols); j++) {
+        kernel.apply(column(run, i0, j), std::min(rows, sd - i0), s);
+      }
+    }
+  };
+  long count = rowBlocks * ((fd + cols - 1) / cols);
+  if (n * kernel.cost <= INLINE_WORK) {
+    tiles(0, count);
+  } else {
+    pool->parallelFor(count, 1, tiles);
+  }
+  return result;
+}
+
+// Only the stored triangle of each column is visited.
+// Lower (bottom > 0) keeps rows below the diagonal, upper (bottom < 0) keeps rows above it,
+// and the diagonal is skipped for unit (132) matrices.
+float* Ferrum::CpuEngine::uplo(Ferrum::FunctionID id, Ferrum::KernelKind kind, long sd, int unit, int bottom,
+                               const Ferrum::Run& run, const Ferrum::Scalars& s, float* result) {
+  const CpuKernel& kernel = cpuKernel(id);
+  if (kernel.kind != kind || kernel.shape != KernelShape::UPLO) {
+    std::cerr << "Error: No uplo kernel of this type for function '" << kernelName(id) << "'" << std::endl;
+    return nullptr;
+  }
+  int diagonal = (unit == 132) ? 1 : 0;
+  auto columns = [&](long begin, long end) {
+    for (long j = begin; j < end; j++) {
+      long first, last;
+      if (bottom > 0) {
+        first = j + diagonal;
+        last = sd;
+      } else if (bottom < 0) {
+        first = 0;
+        last = j + 1 - diagonal;
+      } else {
+        first = 0;
+        last = diagonal ? 0 : sd;
+      }
+      if (first < last) {
+        kernel.apply(column(run, first, j), last - first, s);
+      }
+    }
+  };
+  // about half of each column is in the triangle
+  if (sd * sd / 2 * kernel.cost <= INLINE_WORK) {
+    columns(0, sd);
+  } else {
+    pool->parallelFor(sd, std::max(1L, 2 * grain(kernel) / std::max(sd, 1L)), columns);
+  }
+  return result;
+}
+
+// The kind of kernel that a dispatch form calls
+static Ferrum::KernelKind formKind(Ferrum::Graph::Form form) {
+  switch (form) {
+    case Ferrum::Graph::Form::bbB:
+    case Ferrum::Graph::Form::bbffffB:
+      return Ferrum::KernelKind::BINARY;
+    case Ferrum::Graph::Form::bBB:
+      return Ferrum::KernelKind::PAIR;
+    default:
+      return Ferrum::KernelKind::UNARY;
+  }
+}
+
+// Each recorded call, as the run that its dispatch function would build.
+// Runs are placed on the bound tensors before a replay, whenever a tensor has been rebound.
+class Ferrum::CpuEngine::GraphTasks : public Ferrum::GraphExec {
+  public:
+    GraphTasks(CpuEngine* engine, const Graph& graph) : GraphExec(graph), engine(engine), placed(false) {
+      for (const Graph::Op& op : ops) {
+        tasks.push_back(Task{&op, formKind(op.form), Run{}});
+      }
+    }
+
+    void bind(int tensor, float* data) override {
+      GraphExec::bind(tensor, data);
+      placed = false;
+    }
+
+    bool replay() override {
+      if (!placed) {
+        place();
+      }
+      for (const Task& task : tasks) {
+        const Graph::Op& op = *task.op;
+        float* result;
+        switch (op.shape) {
+          case KernelShape::VECTOR:
+            result = engine->vector(op.id, task.kind, op.n, task.run, op.s, task.run.r);
+            break;
+          case KernelShape::GE:
+            result = engine->ge(op.id, task.kind, op.n, op.fd, task.run, op.s, task.run.r);
+            break;
+          default:
+            result = engine->uplo(op.id, task.kind, op.n, op.unit, op.bottom, task.run, op.s, task.run.r);
+            break;
+        }
+        if (result == nullptr) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+  private:
+    struct Task {
+      const Graph::Op* op;
+      KernelKind kind;
+      Run run;
+    };
+
+    CpuEngine* engine;
+    std::vector<Task> tasks;
+    bool placed;
+
+    // Vectors start at their first element, and matrices carry their leading dimension
+    float* at(const Graph::Operand& operand, const Graph::Op& op) const {
+      float* data = bound[operand.tensor];
+      return op.shape == KernelShape::VECTOR ? data + firstIndex(operand.offset, operand.stride, op.n)
+                                             : data + operand.offset;
+    }
+
+    void place() {
+      for (Task& task : tasks) {
+        const Graph::Op& op = *task.op;
+        float* b = op.b.tensor < 0 ? nullptr : at(op.b, op);
+        task.run = Run{at(op.a, op), op.a.stride,
+                       task.kind == KernelKind::BINARY ? b : nullptr, op.b.stride,
+                       task.kind == KernelKind::PAIR ? b : nullptr, op.b.stride,
+                       at(op.r, op), op.r.stride};
+      }
+      placed = true;
+    }
+};
+
+// Recorded calls were checked against their arrays, so only the kernels are looked up here
+Ferrum::GraphExec* Ferrum::CpuEngine::instantiate(const Ferrum::Graph& graph) {
+  for (const Graph::Op& op : graph.ops()) {
+    const CpuKernel& kernel = cpuKernel(op.id);
+    if (kernel.kind != formKind(op.form) || kernel.shape != op.shape) {
+      std::cerr << "Error: No kernel of this type for function '" << kernelName(op.id) << "'" << std::endl;
+      return nullptr;
+    }
+  }
+  return new GraphTasks(this, graph);
+}
+
+// general vector functions
+float* Ferrum::CpuEngine::vect_bB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                  float* result, long len, long offset, long stride) {
+  if (!(holds(lena, offset_a, stride_a, n) &&
+        holds(len, offset, stride, n))) {
+    return vectorOutOfBounds(id);
+  }
+  Run run{a + firstIndex(offset_a, stride_a, n), stride_a,
+          nullptr, 0,
+          nullptr, 0,
+          result + firstIndex(offset, stride, n), stride};
+  return vector(id, KernelKind::UNARY, n, run, {0, 0, 0, 0}, result);
+}
+
+float* Ferrum::CpuEngine::vect_bfB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                   float sa,
+                                   float* result, long len, long offset, long stride) {
+  if (!(holds(lena, offset_a, stride_a, n) &&
+        holds(len, offset, stride, n))) {
+    return vectorOutOfBounds(id);
+  }
+  Run run{a + firstIndex(offset_a, stride_a, n), stride_a,
+          nullptr, 0,
+          nullptr, 0,
+          result + firstIndex(offset, stride, n), stride};
+  return vector(id, KernelKind::UNARY, n, run, {sa, 0, 0, 0}, result);
+}
+
+float* Ferrum::CpuEngine::vect_fbB(Ferrum::FunctionID id, long n, float sa,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* result, long len, long offset, long stride) {
+  if (!(holds(lena, offset_a, stride_a, n) &&
+        holds(len, offset, stride, n))) {
+    return vectorOutOfBounds(id);
+  }
+  Run run{a + firstIndex(offset_a, stride_a, n), stride_a,
+          nullptr, 0,
+          nullptr, 0,
+          result + firstIndex(offset, stride, n), stride};
+  return vector(id, KernelKind::UNARY, n, run, {sa, 0, 0, 0}, result);
+}
+
+float* Ferrum::CpuEngine::vect_bbB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                   const float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) {
+  if (!(holds(lena, offset_a, stride_a, n) &&
+        holds(lenb, offset_b, stride_b, n) &&
+        holds(len, offset, stride, n))) {
+    return vectorOutOfBounds(id);
+  }
+  Run run{a + firstIndex(offset_a, stride_a, n), stride_a,
+          b + firstIndex(offset_b, stride_b, n), stride_b,
+          nullptr, 0,
+          result + firstIndex(offset, stride, n), stride};
+  return vector(id, KernelKind::BINARY, n, run, {0, 0, 0, 0}, result);
+}
+
+float* Ferrum::CpuEngine::vect_bBB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                   float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) {
+  if (!(holds(lena, offset_a, stride_a, n) &&
+        holds(lenb, offset_b, stride_b, n) &&
+        holds(len, offset, stride, n))) {
+    return vectorOutOfBounds(id);
+  }
+  Run run{a + firstIndex(offset_a, stride_a, n), stride_a,
+          nullptr, 0,
+          b + firstIndex(offset_b, stride_b, n), stride_b,
+          result + firstIndex(offset, stride, n), stride};
+  return vector(id, KernelKind::PAIR, n, run, {0, 0, 0, 0}, result);
+}
+
+float* Ferrum::CpuEngine::vect_bffffB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                      float sa, float sha,
+                                      float sb, float shb,
+                                      float* result, long len, long offset, long stride) {
+  if (!(holds(lena, offset_a, stride_a, n) &&
+        holds(len, offset, stride, n))) {
+    return vectorOutOfBounds(id);
+  }
+  Run run{a + firstIndex(offset_a, stride_a, n), stride_a,
+          nullptr, 0,
+          nullptr, 0,
+          result + firstIndex(offset, stride, n), stride};
+  return vector(id, KernelKind::UNARY, n, run, {sa, sha, sb, shb}, result);
+}
+
+float* Ferrum::CpuEngine::vect_bbffffB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                       const float* b, long lenb, long offset_b, long stride_b,
+                                       float sa, float sha,
+                                       float sb, float shb,
+                                       float* result, long len, long offset, long stride) {
+  if (!(holds(lena, offset_a, stride_a, n) &&
+        holds(lenb, offset_b, stride_b, n) &&
+        holds(len, offset, stride, n))) {
+    return vectorOutOfBounds(id);
+  }
+  Run run{a + firstIndex(offset_a, stride_a, n), stride_a,
+          b + firstIndex(offset_b, stride_b, n), stride_b,
+          nullptr, 0,
+          result + firstIndex(offset, stride, n), stride};
+  return vector(id, KernelKind::BINARY, n, run, {sa, sha, sb, shb}, result);
+}
+
+// general matrix functions
+float* Ferrum::CpuEngine::ge_bB(Ferrum::FunctionID id, long sd, long fd,
+                                const float* a, long lena, long offset_a, long stride_a,
+                                float* result, long len, long offset, long stride) {
+  if (!(fits(sd, fd, lena, offset_a, stride_a) &&
+        fits(sd, fd, len, offset, stride))) {
+    return outOfBounds(id);
+  }
+  Run run{a + offset_a, stride_a, nullptr, 0, nullptr, 0, result + offset, stride};
+  return ge(id, KernelKind::UNARY, sd, fd, run, {0, 0, 0, 0}, result);
+}
+
+float* Ferrum::CpuEngine::ge_bfB(Ferrum::FunctionID id, long sd, long fd,
+                                 const float* a, long lena, long offset_a, long stride_a,
+                                 float sa,
+                                 float* result, long len, long offset, long stride) {
+  if (!(fits(sd, fd, lena, offset_a, stride_a) &&
+        fits(sd, fd, len, offset, stride))) {
+    return outOfBounds(id);
+  }
+  Run run{a + offset_a, stride_a, nullptr, 0, nullptr, 0, result + offset, stride};
+  return ge(id, KernelKind::UNARY, sd, fd, run, {sa, 0, 0, 0}, result);
+}
+
+float* Ferrum::CpuEngine::ge_fbB(Ferrum::FunctionID id, long sd, long fd, float sa,
+                                 const float* a, long lena, long offset_a, long stride_a,
+                                 float* result, long len, long offset, long stride) {
+  if (!(fits(sd, fd, lena, offset_a, stride_a) &&
+        fits(sd, fd, len, offset, stride))) {
+    return outOfBounds(id);
+  }
+  Run run{a + offset_a, stride_a, nullptr, 0, nullptr, 0, result + offset, stride};
+  return ge(id, KernelKind::UNARY, sd, fd, run, {sa, 0, 0, 0}, result);
+}
+
+float* Ferrum::CpuEngine::ge_bbB(Ferrum::FunctionID id, long sd, long fd,
+                                 const float* a, long lena, long offset_a, long stride_a,
+                                 const float* b, long lenb, long offset_b, long stride_b,
+                                 float* result, long len, long offset, long stride) {
+  if (!(fits(sd, fd, lena, offset_a, stride_a) &&
+        fits(sd, fd, lenb, offset_b, stride_b) &&
+        fits(sd, fd, len, offset, stride))) {
+    return outOfBounds(id);
+  }
+  Run run{a + offset_a, stride_a, b + offset_b, stride_b, nullptr, 0, result + offset, stride};
+  return ge(id, KernelKind::BINARY, sd, fd, run, {0, 0, 0, 0}, result);
+}
+
+float* Ferrum::CpuEngine::ge_bBB(Ferrum::FunctionID id, long sd, long fd,
+                                 const float* a, long lena, long offset_a, long stride_a,
+                                 float* b, long lenb, long offset_b, long stride_b,
+                                 float* result, long len, long offset, long stride) {
+  if (!(fits(sd, fd, lena, offset_a, stride_a) &&
+        fits(sd, fd, lenb, offset_b, stride_b) &&
+        fits(sd, fd, len, offset, stride))) {
+    return outOfBounds(id);
+  }
+  Run run{a + offset_a, stride_a, nullptr, 0, b + offset_b, stride_b, result + offset, stride};
+  return ge(id, KernelKind::PAIR, sd, fd, run, {0, 0, 0, 0}, result);
+}
+
+float* Ferrum::CpuEngine::ge_bffffB(Ferrum::FunctionID id, long sd, long fd,
+                                    const float* a, long lena, long offset_a, long stride_a,
+                                    float sa, float sha,
+                                    float sb, float shb,
+                                    float* result, long len, long offset, long stride) {
+  if (!(fits(sd, fd, lena, offset_a, stride_a) &&
+        fits(sd, fd, len, offset, stride))) {
+    return outOfBounds(id);
+  }
+  Run run{a + offset_a, stride_a, nullptr, 0, nullptr, 0, result + offset, stride};
+  return ge(id, KernelKind::UNARY, sd, fd, run, {sa, sha, sb, shb}, result);
+}
+
+float* Ferrum::CpuEngine::ge_bbffffB(Ferrum::FunctionID id, long sd, long fd,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     const float* b, long lenb, long offset_b, long stride_b,
+                                     float sa, float sha,
+                                     float sb, float shb,
+                                     float* result, long len, long offset, long stride) {
+  if (!(fits(sd, fd, lena, offset_a, stride_a) &&
+        fits(sd, fd, lenb, offset_b, stride_b) &&
+        fits(sd, fd, len, offset, stride))) {
+    return outOfBounds(id);
+  }
+  Run run{a + offset_a, stride_a, b + offset_b, stride_b, nullptr, 0, result + offset, stride};
+  return ge(id, KernelKind::BINARY, sd, fd, run, {sa, sha, sb, shb}, result);
+}
+
+// general uplo functions
+float* Ferrum::CpuEngine::uplo_bB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                  const float* a, long lena, long offset_a, long stride_a,
+                                  float* result, long len, long offset, long stride) {
+  if (!(fits(sd, sd, lena, offset_a, stride_a) &&
+        fits(sd, sd, len, offset, stride))) {
+    return outOfBounds(id);
+  }
+  Run run{a + offset_a, stride_a, nullptr, 0, nullptr, 0, result + offset, stride};
+  return uplo(id, KernelKind::UNARY, sd, unit, bottom, run, {0, 0, 0, 0}, result);
+}
+
+float* Ferrum::CpuEngine::uplo_bfB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float sa,
+                                   float* result, long len, long offset, long stride) {
+  if (!(fits(sd, sd, lena, offset_a, stride_a) &&
+        fits(sd, sd, len, offset, stride))) {
+    return outOfBounds(id);
+  }
+  Run run{a + offset_a, stride_a, nullptr, 0, nullptr, 0, result + offset, stride};
+  return uplo(id, KernelKind::UNARY, sd, unit, bottom, run, {sa, 0, 0, 0}, result);
+}
+
+float* Ferrum::CpuEngine::uplo_fbB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float sa,
+                                   float* result, long len, long offset, long stride) {
+  if (!(fits(sd, sd, lena, offset_a, stride_a) &&
+        fits(sd, sd, len, offset, stride))) {
+    return outOfBounds(id);
+  }
+  Run run{a + offset_a, stride_a, nullptr, 0, nullptr, 0, result + offset, stride};
+  return uplo(id, KernelKind::UNARY, sd, unit, bottom, run, {sa, 0, 0, 0}, result);
+}
+
+float* Ferrum::CpuEngine::uplo_bbB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   const float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) {
+  if (!(fits(sd, sd, lena, offset_a, stride_a) &&
+        fits(sd, sd, lenb, offset_b, stride_b) &&
+        fits(sd, sd, len, offset, stride))) {
+    return outOfBounds(id);
+  }
+  Run run{a + offset_a, stride_a, b + offset_b, stride_b, nullptr, 0, result + offset, stride};
+  return uplo(id, KernelKind::BINARY, sd, unit, bottom, run, {0, 0, 0, 0}, result);
+}
+
+float* Ferrum::CpuEngine::uplo_bBB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) {
+  if (!(fits(sd, sd, lena, offset_a, stride_a) &&
+        fits(sd, sd, lenb, offset_b, stride_b) &&
+        fits(sd, sd, len, offset, stride))) {
+    return outOfBounds(id);
+  }
+  Run run{a + offset_a, stride_a, nullptr, 0, b + offset_b, stride_b, result + offset, stride};
+  return uplo(id, KernelKind::PAIR, sd, unit, bottom, run, {0, 0, 0, 0}, result);
+}
+
+float* Ferrum::CpuEngine::uplo_bffffB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                      const float* a, long lena, long offset_a, long stride_a,
+                                      float sa, float sha,
+                                      float sb, float shb,
+                                      float* result, long len, long offset, long stride) {
+  if (!(fits(sd, sd, lena, offset_a, stride_a) &&
+        fits(sd, sd, len, offset, stride))) {
+    return outOfBounds(id);
+  }
+  Run run{a + offset_a, stride_a, nullptr, 0, nullptr, 0, result + offset, stride};
+  return uplo(id, KernelKind::UNARY, sd, unit, bottom, run, {sa, sha, sb, shb}, result);
+}
+
+float* Ferrum::CpuEngine::uplo_bbffffB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                       const float* a, long lena, long offset_a, long stride_a,
+                                       const float* b, long lenb, long offset_b, long stride_b,
+                                       float sa, float sha,
+                                       float sb, float shb,
+                                       float* result, long len, long offset, long stride) {
+  if (!(fits(sd, sd, lena, offset_a, stride_a) &&
+        fits(sd, sd, lenb, offset_b, stride_b) &&
+        fits(sd, sd, len, offset, stride))) {
+    return outOfBounds(id);
+  }
+  Run run{a + offset_a, stride_a, b + offset_b, stride_b, nullptr, 0, result + offset, stride};
+  return uplo(id, KernelKind::BINARY, sd, unit, bottom, run, {sa, sha, sb, shb}, result);
+}
+
+// linear algebra functions
+
+static bool transpose(Ferrum::FunctionID id, int trans) {
+  if (trans != Ferrum::NO_TRANS && trans != Ferrum::TRANS) {
+    std::cerr << "Error: Unknown transpose for function '" << Ferrum::kernelName(id) << "'" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+float* Ferrum::CpuEngine::gemm(int transA, int transB, long m, long n, long k, float alpha,
+                               const float* a, long lena, long offset_a, long lda,
+                               const float* b, long lenb, long offset_b, long ldb,
+                               float beta, float* c, long lenc, long offset_c, long ldc) {
+  if (!transpose(FunctionID::blas_gemm, transA) || !transpose(FunctionID::blas_gemm, transB)) {
+    return nullptr;
+  }
+  bool ta = transA == TRANS;
+  bool tb = transB == TRANS;
+  if (!(fits(ta ? k : m, ta ? m : k, lena, offset_a, lda) &&
+        fits(tb ? n : k, tb ? k : n, lenb, offset_b, ldb) &&
+        fits(m, n, lenc, offset_c, ldc))) {
+    return outOfBounds(FunctionID::blas_gemm);
+  }
+  hostGemm(pool, ta, tb, m, n, k, alpha, a + offset_a, lda, b + offset_b, ldb, beta, c + offset_c, ldc);
+  return c;
+}
+
+float* Ferrum::CpuEngine::gemv(int trans, long m, long n, float alpha,
+                               const float* a, long lena, long offset_a, long lda,
+                               const float* x, long lenx, long offset_x, long stride_x,
+                               float beta, float* y, long leny, long offset_y, long stride_y) {
+  if (!transpose(FunctionID::blas_gemv_n, trans)) {
+    return nullptr;
+  }
+  bool t = trans == TRANS;
+  FunctionID id = t ? FunctionID::blas_gemv_t : FunctionID::blas_gemv_n;
+  long nx = t ? m : n;
+  long ny = t ? n : m;
+  if (!fits(m, n, lena, offset_a, lda)) {
+    return outOfBounds(id);
+  }
+  if (!(holds(lenx, offset_x, stride_x, nx) &&
+        holds(leny, offset_y, stride_y, ny))) {
+    return vectorOutOfBounds(id);
+  }
+  hostGemv(pool, t, m, n, alpha, a + offset_a, lda, x + firstIndex(offset_x, stride_x, nx), stride_x,
+           beta, y + firstIndex(offset_y, stride_y, ny), stride_y);
+  return y;
+}
+
+float* Ferrum::CpuEngine::ger(long m, long n, float alpha,
+                              const float* x, long lenx, long offset_x, long stride_x,
+                              const float* y, long leny, long offset_y, long stride_y,
+                              float* a, long lena, long offset_a, long lda) {
+  FunctionID id = FunctionID::blas_ger;
+  if (!fits(m, n, lena, offset_a, lda)) {
+    return outOfBounds(id);
+  }
+  if (!(holds(lenx, offset_x, stride_x, m) &&
+        holds(leny, offset_y, stride_y, n))) {
+    return vectorOutOfBounds(id);
+  }
+  hostGer(pool, m, n, alpha, x + firstIndex(offset_x, stride_x, m), stride_x,
+          y + firstIndex(offset_y, stride_y, n), stride_y, a + offset_a, lda);
+  return a;
+}
+
+// Triangular functions take a triangle as the uplo functions do, but need one: a bottom of 0
+// (the whole matrix) has no triangle to solve with
+static bool triangle(Ferrum::FunctionID id, int bottom) {
+  if (bottom == 0) {
+    std::cerr << "Error: No triangle given for function '" << Ferrum::kernelName(id) << "'" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+static bool knownSide(Ferrum::FunctionID id, int side) {
+  if (side != Ferrum::LEFT && side != Ferrum::RIGHT) {
+    std::cerr << "Error: Unknown side for function '" << Ferrum::kernelName(id) << "'" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+float* Ferrum::CpuEngine::trmv(int trans, long sd, int unit, int bottom,
+                               const float* a, long lena, long offset_a, long lda,
+                               float* x, long lenx, long offset_x, long stride_x) {
+  FunctionID id = FunctionID::blas_trmv;
+  if (!transpose(id, trans) || !triangle(id, bottom)) {
+    return nullptr;
+  }
+  if (!fits(sd, sd, lena, offset_a, lda)) {
+    return outOfBounds(id);
+  }
+  if (!holds(lenx, offset_x, stride_x, sd)) {
+    return vectorOutOfBounds(id);
+  }
+  hostTrmv(pool, trans == TRANS, sd, unit == UNIT, bottom > 0, a + offset_a, lda,
+           x + firstIndex(offset_x, stride_x, sd), stride_x);
+  return x;
+}
+
+float* Ferrum::CpuEngine::trsv(int trans, long sd, int unit, int bottom,
+                               const float* a, long lena, long offset_a, long lda,
+                               float* x, long lenx, long offset_x, long stride_x) {
+  FunctionID id = FunctionID::blas_trsv;
+  if (!transpose(id, trans) || !triangle(id, bottom)) {
+    return nullptr;
+  }
+  if (!fits(sd, sd, lena, offset_a, lda)) {
+    return outOfBounds(id);
+  }
+  if (!holds(lenx, offset_x, stride_x, sd)) {
+    return vectorOutOfBounds(id);
+  }
+  hostTrsv(pool, trans == TRANS, sd, unit == UNIT, bottom > 0, a + offset_a, lda,
+           x + firstIndex(offset_x, stride_x, sd), stride_x);
+  return x;
+}
+
+float* Ferrum::CpuEngine::trmm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                               const float* a, long lena, long offset_a, long lda,
+                               float* b, long lenb, long offset_b, long ldb) {
+  FunctionID id = FunctionID::blas_trmm;
+  if (!knownSide(id, side) || !transpose(id, trans) || !triangle(id, bottom)) {
+    return nullptr;
+  }
+  long sd = side == LEFT ? m : n;
+  if (!(fits(sd, sd, lena, offset_a, lda) &&
+        fits(m, n, lenb, offset_b, ldb))) {
+    return outOfBounds(id);
+  }
+  hostTrmm(pool, side == LEFT, trans == TRANS, m, n, unit == UNIT, bottom > 0, alpha, a + offset_a, lda,
+           b + offset_b, ldb);
+  return b;
+}
+
+float* Ferrum::CpuEngine::trsm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                               const float* a, long lena, long offset_a, long lda,
+                               float* b, long lenb, long offset_b, long ldb) {
+  FunctionID id = FunctionID::blas_trsm;
+  if (!knownSide(id, side) || !transpose(id, trans) || !triangle(id, bottom)) {
+    return nullptr;
+  }
+  long sd = side == LEFT ? m : n;
+  if (!(fits(sd, sd, lena, offset_a, lda) &&
+        fits(m, n, lenb, offset_b, ldb))) {
+    return outOfBounds(id);
+  }
+  hostTrsm(pool, side == LEFT, trans == TRANS, m, n, unit == UNIT, bottom > 0, alpha, a + offset_a, lda,
+           b + offset_b, ldb);
+  return b;
+}
+
+float* Ferrum::CpuEngine::syrk(int trans, long n, long k, int bottom, float alpha,
+                               const float* a, long lena, long offset_a, long lda,
+                               float beta, float* c, long lenc, long offset_c, long ldc) {
+  FunctionID id = FunctionID::blas_syrk;
+  if (!transpose(id, trans) || !triangle(id, bottom)) {
+    return nullptr;
+  }
+  bool t = trans == TRANS;
+  if (!(fits(t ? k : n, t ? n : k, lena, offset_a, lda) &&
+        fits(n, n, lenc, offset_c, ldc))) {
+    return outOfBounds(id);
+  }
+  hostSyrk(pool, t, n, k, bottom > 0, alpha, a + offset_a, lda, beta, c + offset_c, ldc);
+  return c;
+}
+
+float* Ferrum::CpuEngine::potrf(long sd, int bottom, float* a, long lena, long offset_a, long lda) {
+  FunctionID id = FunctionID::blas_potrf;
+  if (!triangle(id, bottom)) {
+    return nullptr;
+  }
+  if (!fits(sd, sd, lena, offset_a, lda)) {
+    return outOfBounds(id);
+  }
+  long minor = hostPotrf(pool, sd, bottom > 0, a + offset_a, lda);
+  if (minor != 0) {
+    std::cerr << "Error: Leading minor " << minor << " is not positive definite for function '"
+              << kernelName(id) << "'" << std::endl;
+    return nullptr;
+  }
+  return a;
+}
+
+float* Ferrum::CpuEngine::potrs(long sd, long n, int bottom, const float* a, long lena, long offset_a, long lda,
+                                float* b, long lenb, long offset_b, long ldb) {
+  // the solve is two trsm calls, and reports as trsm
+  FunctionID id = FunctionID::blas_trsm;
+  if (!triangle(id, bottom)) {
+    return nullptr;
+  }
+  if (!(fits(sd, sd, lena, offset_a, lda) &&
+        fits(sd, n, lenb, offset_b, ldb))) {
+    return outOfBounds(id);
+  }
+  hostPotrs(pool, sd, n, bottom > 0, a + offset_a, lda, b + offset_b, ldb);
+  return b;
+}
+
+float* Ferrum::CpuEngine::trttp(long sd, int bottom, const float* a, long lena, long offset_a, long lda,
+                                float* ap, long lenap, long offset_ap) {
+  FunctionID id = FunctionID::blas_trttp;
+  if (!triangle(id, bottom)) {
+    return nullptr;
+  }
+  if (!(fits(sd, sd, lena, offset_a, lda) &&
+        holds(lenap, offset_ap, 1, packedLength(sd)))) {
+    return outOfBounds(id);
+  }
+  hostTrttp(pool, sd, bottom > 0, a + offset_a, lda, ap + offset_ap);
+  return ap;
+}
+
+float* Ferrum::CpuEngine::tpttr(long sd, int bottom, const float* ap, long lenap, long offset_ap,
+                                float* a, long lena, long offset_a, long lda) {
+  FunctionID id = FunctionID::blas_tpttr;
+  if (!triangle(id, bottom)) {
+    return nullptr;
+  }
+  if (!(holds(lenap, offset_ap, 1, packedLength(sd)) &&
+        fits(sd, sd, lena, offset_a, lda))) {
+    return outOfBounds(id);
+  }
+  hostTpttr(pool, sd, bottom > 0, ap + offset_ap, a + offset_a, lda);
+  return a;
+}
+
+float* Ferrum::CpuEngine::tpmv(int trans, long sd, int unit, int bottom, const float* ap, long lenap, long offset_ap,
+                               float* x, long lenx, long offset_x, long stride_x) {
+  FunctionID id = FunctionID::blas_tpmv;
+  if (!transpose(id, trans) || !triangle(id, bottom)) {
+    return nullptr;
+  }
+  if (!holds(lenap, offset_ap, 1, packedLength(sd))) {
+    return outOfBounds(id);
+  }
+  if (!holds(lenx, offset_x, stride_x, sd)) {
+    return vectorOutOfBounds(id);
+  }
+  hostTpmv(pool, trans == TRANS, sd, unit == UNIT, bottom > 0, ap + offset_ap,
+           x + firstIndex(offset_x, stride_x, sd), stride_x);
+  return x;
+}
+
+float* Ferrum::CpuEngine::spmv(long sd, int bottom, float alpha, const float* ap, long lenap, long offset_ap,
+                               const float* x, long lenx, long offset_x, long stride_x,
+                               float beta, float* y, long leny, long offset_y, long stride_y) {
+  FunctionID id = FunctionID::blas_spmv;
+  if (!triangle(id, bottom)) {
+    return nullptr;
+  }
+  if (!holds(lenap, offset_ap, 1, packedLength(sd))) {
+    return outOfBounds(id);
+  }
+  if (!(holds(lenx, offset_x, stride_x, sd) &&
+        holds(leny, offset_y, stride_y, sd))) {
+    return vectorOutOfBounds(id);
+  }
+  hostSpmv(pool, sd, bottom > 0, alpha, ap + offset_ap, x + firstIndex(offset_x, stride_x, sd), stride_x,
+           beta, y + firstIndex(offset_y, stride_y, sd), stride_y);
+  return y;
+}
+
+float* Ferrum::CpuEngine::omatcopy(int trans, long m, long n, float alpha,
+                                   const float* a, long lena, long offset_a, long lda,
+                                   float* b, long lenb, long offset_b, long ldb) {
+  FunctionID id = FunctionID::blas_omatcopy;
+  if (!transpose(id, trans)) {
+    return nullptr;
+  }
+  bool t = trans == TRANS;
+  if (!(fits(m, n, lena, offset_a, lda) &&
+        fits(t ? n : m, t ? m : n, lenb, offset_b, ldb))) {
+    return outOfBounds(id);
+  }
+  hostOmatcopy(pool, t, m, n, alpha, a + offset_a, lda, b + offset_b, ldb);
+  return b;
+}
@@ -0,0 +1,312 @@
+#include "cpukernels.hpp"
+#include "expression.hpp"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+using Ferrum::Scalars;
+using Ferrum::Run;
+
+namespace {
+
+  const float REAL2o3 = 0.6666666666666667f;
+  const float REAL3o2 = 1.5f;
+  const float SQRT2 = 1.4142135623730951f;
+
+  // Inverse error function: M. Giles, "Approximating the erfinv function",
+  // GPU Computing Gems Jade Edition, 2011. Single precision.
+  inline float erfinv(float x) {
+    float w = -std::log((1.0f - x) * (1.0f + x));
+    float p;
+    if (w < 5.0f) {
+      w = w - 2.5f;
+      p = 2.81022636e-08f;
+      p = 3.43273939e-07f + p * w;
+      p = -3.5233877e-06f + p * w;
+      p = -4.39150654e-06f + p * w;
+      p = 0.00021858087f + p * w;
+      p = -0.00125372503f + p * w;
+      p = -0.00417768164f + p * w;
+      p = 0.246640727f + p * w;
+      p = 1.50140941f + p * w;
+    } else {
+      w = std::sqrt(w) - 3.0f;
+      p = -0.000200214257f;
+      p = 0.000100950558f + p * w;
+      p = 0.00134934322f + p * w;
+      p = -0.00367342844f + p * w;
+      p = 0.00573950773f + p * w;
+      p = -0.0076224613f + p * w;
+      p = 0.00943887047f + p * w;
+      p = 1.00167406f + p * w;
+      p = 2.83297682f + p * w;
+    }
+    return p * x;
+  }
+
+  inline float erfcinv(float x) {
+    return erfinv(1.0f - x);
+  }
+
+  // Approximation of the inverse normal CDF: Peter John Acklam, 2002
+  // The same approximation as the Metal kernels.
+  const float CNI_A[] = {-3.969683028665376e+01f, 2.209460984245205e+02f, -2.759285104469687e+02f,
+                         1.383577518672690e+02f, -3.066479806614716e+01f, 2.506628277459239e+00f};
+  const float CNI_B[] = {-5.447609879822406e+01f, 1.615858368580409e+02f, -1.556989798598866e+02f,
+                         6.680131188771972e+01f, -1.328068155288572e+01f};
+  const float CNI_C[] = {-7.784894002430293e-03f, -3.223964580411365e-01f, -2.400758277161838e+00f,
+                         -2.549732539343734e+00f, 4.374664141464968e+00f, 2.938163982698783e+00f};
+  const float CNI_D[] = {7.784695709041462e-03f, 3.224671290700398e-01f, 2.445134137142996e+00f,
+                         3.754408661907416e+00f};
+  const float X_LOW = 0.02425f;
+  const float X_HIGH = 1.0f - X_LOW;
+
+  inline float normcdfinv(float x) {
+    float q, r;
+    if (x < X_LOW) {
+      q = std::sqrt(-2.0f * std::log(x));
+      return (((((CNI_C[0] * q + CNI_C[1]) * q + CNI_C[2]) * q + CNI_C[3]) * q + CNI_C[4]) * q + CNI_C[5]) /
+             ((((CNI_D[0] * q + CNI_D[1]) * q + CNI_D[2]) * q + CNI_D[3]) * q + 1.0f);
+    } else if (x <= X_HIGH) {
+      q = x - 0.5f;
+      r = q * q;
+      return (((((CNI_A[0] * r + CNI_A[1]) * r + CNI_A[2]) * r + CNI_A[3]) * r + CNI_A[4]) * r + CNI_A[5]) * q /
+             (((((CNI_B[0] * r + CNI_B[1]) * r + CNI_B[2]) * r + CNI_B[3]) * r + CNI_B[4]) * r + 1.0f);
+    } else {
+      q = std::sqrt(-2.0f * std::log(1.0f - x));
+      return -(((((CNI_C[0] * q + CNI_C[1]) * q + CNI_C[2]) * q + CNI_C[3]) * q + CNI_C[4]) * q + CNI_C[5]) /
+             ((((CNI_D[0] * q + CNI_D[1]) * q + CNI_D[2]) * q + CNI_D[3]) * q + 1.0f);
+    }
+  }
+
+  inline float frac(float x) {
+    return x - static_cast<float>(static_cast<long>(x));
+  }
+
+  // Operations. Each defines the value of a single element.
+
+#define UNARY_OP(name, expr) \
+  struct Op_##name { static inline float apply(float x, const Scalars& s) { return (expr); } };
+#define BINARY_OP(name, expr) \
+  struct Op_##name { static inline float apply(float x, float y, const Scalars& s) { return (expr); } };
+#define PAIR_OP(name, yexpr, zexpr) \
+  struct Op_##name { static inline void apply(float x, float& y, float& z) { y = (yexpr); z = (zexpr); } };
+
+  UNARY_OP(abs, std::fabs(x))
+  UNARY_OP(acos, std::acos(x))
+  UNARY_OP(acosh, std::acosh(x))
+  UNARY_OP(asin, std::asin(x))
+  UNARY_OP(asinh, std::asinh(x))
+  UNARY_OP(atan, std::atan(x))
+  UNARY_OP(atanh, std::atanh(x))
+  UNARY_OP(cbrt, std::cbrt(x))
+  UNARY_OP(cdf_norm, 0.5f * std::erfc(-x / SQRT2))
+  UNARY_OP(cdf_norm_inv, normcdfinv(x))
+  UNARY_OP(ceil, std::ceil(x))
+  UNARY_OP(copy, x)
+  UNARY_OP(cos, std::cos(x))
+  UNARY_OP(cosh, std::cosh(x))
+  UNARY_OP(elu, std::fmax(x, s.sa * std::expm1(x)))
+  UNARY_OP(erf, std::erf(x))
+  UNARY_OP(erf_inv, erfinv(x))
+  UNARY_OP(erfc, std::erfc(x))
+  UNARY_OP(erfc_inv, erfcinv(x))
+  UNARY_OP(exp, std::exp(x))
+  UNARY_OP(exp10, std::pow(10.0f, x))
+  UNARY_OP(exp2, std::exp2(x))
+  UNARY_OP(expm1, std::expm1(x))
+  UNARY_OP(floor, std::floor(x))
+  UNARY_OP(frac, frac(x))
+  UNARY_OP(gamma, std::tgamma(x))
+  UNARY_OP(inv, 1.0f / x)
+  UNARY_OP(inv_cbrt, 1.0f / std::cbrt(x))
+  UNARY_OP(inv_sqrt, 1.0f / std::sqrt(x))
+  UNARY_OP(lgamma, std::lgamma(x))
+  UNARY_OP(log, std::log(x))
+  UNARY_OP(log10, std::log10(x))
+  UNARY_OP(log1p, std::log1p(x))
+  UNARY_OP(log2, std::log2(x))
+  UNARY_OP(pow2o3, std::pow(x, REAL2o3))
+  UNARY_OP(pow3o2, std::pow(x, REAL3o2))
+  UNARY_OP(powx, std::pow(x, s.sa))
+  UNARY_OP(ramp, std::fmax(x, 0.0f))
+  UNARY_OP(relu, std::fmax(x, s.sa * x))
+  UNARY_OP(round, std::round(x))
+  UNARY_OP(scale_shift, s.sa * x + s.sha)
+  UNARY_OP(sigmoid, std::tanh(0.5f * x) * 0.5f + 0.5f)
+  UNARY_OP(sin, std::sin(x))
+  UNARY_OP(sinh, std::sinh(x))
+  UNARY_OP(sqr, x * x)
+  UNARY_OP(sqrt, std::sqrt(x))
+  UNARY_OP(tan, std::tan(x))
+  UNARY_OP(tanh, std::tanh(x))
+  UNARY_OP(trunc, std::trunc(x))
+
+  BINARY_OP(add, x + y)
+  BINARY_OP(atan2, std::atan2(x, y))
+  BINARY_OP(copysign, std::copysign(x, y))
+  BINARY_OP(div, x / y)
+  BINARY_OP(fmax, std::fmax(x, y))
+  BINARY_OP(fmin, std::fmin(x, y))
+  BINARY_OP(fmod, std::fmod(x, y))
+  BINARY_OP(frem, std::remainder(x, y))
+  BINARY_OP(hypot, std::hypot(x, y))
+  BINARY_OP(linear_frac, (s.sa * x + s.sha) / (s.sb * y + s.shb))
+  BINARY_OP(mul, x * y)
+  BINARY_OP(pow, std::pow(x, y))
+  BINARY_OP(sub, x - y)
+
+  PAIR_OP(sincos, std::sin(x), std::cos(x))
+  PAIR_OP(modf, static_cast<float>(static_cast<long>(x)), frac(x))
+
+  // Loops over a run. The unit stride case is split out so that the compiler can vectorize it.
+
+  template<typename Op>
+  void unaryRun(const Run& run, long n, const Scalars& s) {
+    const float* a = run.a;
+    float* r = run.r;
+    if (run.inc_a == 1 && run.inc_r == 1) {
+      for (long i = 0; i < n; i++) {
+        r[i] = Op::apply(a[i], s);
+      }
+    } else {
+      for (long i = 0; i < n; i++) {
+        r[i * run.inc_r] = Op::apply(a[i * run.inc_a], s);
+      }
+    }
+  }
+
+  template<typename Op>
+  void binaryRun(const Run& run, long n, const Scalars& s) {
+    const float* a = run.a;
+    const float* b = run.b;
+    float* r = run.r;
+    if (run.inc_a == 1 && run.inc_b == 1 && run.inc_r == 1) {
+      for (long i = 0; i < n; i++) {
+        r[i] = Op::apply(a[i], b[i], s);
+      }
+    } else {
+      for (long i = 0; i < n; i++) {
+        r[i * run.inc_r] = Op::apply(a[i * run.inc_a], b[i * run.inc_b], s);
+      }
+    }
+  }
+
+  template<typename Op>
+  void pairRun(const Run& run, long n, const Scalars&) {
+    for (long i = 0; i < n; i++) {
+      Op::apply(run.a[i * run.inc_a], run.q[i * run.inc_q], run.r[i * run.inc_r]);
+    }
+  }
+
+  // Relative cost of one element, used to size the pieces that a loop is split into.
+  // Cheap operations are bound by memory bandwidth, the rest by arithmetic. The classes are
+  // rough ratios of measured time per element: add ~0.75ns, exp ~3ns, lgamma ~11ns (x86-64, -O2).
+  const int CHEAP = 1;
+  const int MEDIUM = 2;
+  const int TRANSCENDENTAL = 5;
+  const int HEAVY = 15;
+
+  struct CpuOp {
+    const char* name;
+    Ferrum::KernelKind kind;
+    Ferrum::RunFn run;
+    int cost;
+  };
+
+#define UNARY(name, cost) {#name, Ferrum::KernelKind::UNARY, unaryRun<Op_##name>, cost}
+#define BINARY(name, cost) {#name, Ferrum::KernelKind::BINARY, binaryRun<Op_##name>, cost}
+#define PAIR(name, cost) {#name, Ferrum::KernelKind::PAIR, pairRun<Op_##name>, cost}
+
+  const CpuOp CPU_OPS[] = {
+    UNARY(abs, CHEAP), UNARY(acos, TRANSCENDENTAL), UNARY(acosh, HEAVY), UNARY(asin, TRANSCENDENTAL),
+    UNARY(asinh, HEAVY), UNARY(atan, TRANSCENDENTAL), UNARY(atanh, HEAVY), UNARY(cbrt, HEAVY),
+    UNARY(cdf_norm, TRANSCENDENTAL), UNARY(cdf_norm_inv, HEAVY), UNARY(ceil, CHEAP), UNARY(copy, CHEAP),
+    UNARY(cos, TRANSCENDENTAL), UNARY(cosh, TRANSCENDENTAL), UNARY(elu, TRANSCENDENTAL),
+    UNARY(erf, TRANSCENDENTAL), UNARY(erf_inv, HEAVY), UNARY(erfc, TRANSCENDENTAL),
+    UNARY(erfc_inv, HEAVY), UNARY(exp, TRANSCENDENTAL), UNARY(exp10, HEAVY),
+    UNARY(exp2, TRANSCENDENTAL), UNARY(expm1, TRANSCENDENTAL), UNARY(floor, CHEAP), UNARY(frac, CHEAP),
+    UNARY(gamma, HEAVY), UNARY(inv, MEDIUM), UNARY(inv_cbrt, HEAVY), UNARY(inv_sqrt, MEDIUM),
+    UNARY(lgamma, HEAVY), UNARY(log, TRANSCENDENTAL), UNARY(log10, TRANSCENDENTAL),
+    UNARY(log1p, TRANSCENDENTAL), UNARY(log2, TRANSCENDENTAL), UNARY(pow2o3, HEAVY),
+    UNARY(pow3o2, HEAVY), UNARY(powx, HEAVY), UNARY(ramp, CHEAP), UNARY(relu, CHEAP),
+    UNARY(round, CHEAP), UNARY(scale_shift, CHEAP), UNARY(sigmoid, HEAVY),
+    UNARY(sin, TRANSCENDENTAL), UNARY(sinh, TRANSCENDENTAL), UNARY(sqr, CHEAP), UNARY(sqrt, MEDIUM),
+    UNARY(tan, HEAVY), UNARY(tanh, TRANSCENDENTAL), UNARY(trunc, CHEAP),
+    BINARY(add, CHEAP), BINARY(atan2, HEAVY), BINARY(copysign, CHEAP), BINARY(div, MEDIUM),
+    BINARY(fmax, CHEAP), BINARY(fmin, CHEAP), BINARY(fmod, HEAVY), BINARY(frem, HEAVY),
+    BINARY(hypot, HEAVY), BINARY(linear_frac, MEDIUM), BINARY(mul, CHEAP), BINARY(pow, HEAVY),
+    BINARY(sub, CHEAP),
+    PAIR(sincos, HEAVY), PAIR(modf, MEDIUM)
+  };
+
+  // A few kernels are named differently between shapes
+  const char* canonicalName(const std::string& op) {
+    if (op == "erfcinv") {
+      return "erfc_inv";
+    }
+    return nullptr;
+  }
+
+  Ferrum::CpuKernel lookup(const std::string& fullName) {
+    Ferrum::CpuKernel kernel{Ferrum::KernelShape::VECTOR, Ferrum::KernelKind::UNSUPPORTED, nullptr, 1};
+    std::string op;
+    if (fullName.rfind("vector_", 0) == 0) {
+      op = fullName.substr(7);
+    } else if (fullName.rfind("ge_", 0) == 0) {
+      kernel.shape = Ferrum::KernelShape::GE;
+      op = fullName.substr(3);
+    } else if (fullName.rfind("uplo_", 0) == 0) {
+      kernel.shape = Ferrum::KernelShape::UPLO;
+      op = fullName.substr(5);
+    } else {
+      return kernel;
+    }
+    const char* alias = canonicalName(op);
+    if (alias != nullptr) {
+      op = alias;
+    }
+    for (const CpuOp& cpuOp : CPU_OPS) {
+      if (op == cpuOp.name) {
+        kernel.kind = cpuOp.kind;
+        kernel.run = cpuOp.run;
+        kernel.cost = cpuOp.cost;
+        break;
+      }
+    }
+    return kernel;
+  }
+
+  // Indexed by FunctionID, and built on first use
+  const std::vector<Ferrum::CpuKernel>& kernelTable() {
+    static const std::vector<Ferrum::CpuKernel> table = []() {
+      std::vector<Ferrum::CpuKernel> kernels;
+      for (const Ferrum::FunctionInfo& info : Ferrum::FUNCTION_INFO) {
+        kernels.push_back(lookup(info.name));
+      }
+      return kernels;
+    }();
+    return table;
+  }
+
+} // namespace
+
+const Ferrum::CpuKernel& Ferrum::cpuKernel(Ferrum::FunctionID id) {
+  static const CpuKernel unsupported{KernelShape::VECTOR, KernelKind::UNSUPPORTED, nullptr, 1};
+  const std::vector<CpuKernel>& table = kernelTable();
+  int index = static_cast<int>(id);
+  if (index >= static_cast<int>(table.size())) {
+    const CompiledKernel* compiled = compiledKernel(id);
+    return compiled == nullptr ? unsupported : compiled->kernel;
+  }
+  return index < 0 ? unsupported : table[index];
+}
+
+void Ferrum::CpuKernel::apply(const Ferrum::Run& run, long n, const Ferrum::Scalars& s) const {
+  if (expression != nullptr) {
+    expression->run(run, n, s);
+  } else {
+    this->run(run, n, s);
+  }
+}
@@ -3,8 +3,15 @@
 #define NS_PRIVATE_IMPLEMENTATION
 #define MTL_PRIVATE_IMPLEMENTATION
 
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <unistd.h>
 #include <unordered_map>
 #include <vector>
 #include <Metal/Metal.hpp>
@@ -12,30 +19,65 @@
 #include <simd/simd.h>
 
 #include "engine.hpp"
+#include "expression.hpp"
+#include "graph.hpp"
 
 const char* LIB_NAME = "ferrum";
 const char* LIB_TYPE = "metallib";
 const char* FERRUM_LIB = "FERRUM_LIB";
 
 const char* str(const NS::String* s);
-MTL::Device* getDevice();
+MTL::Device* getDevice(int index);
 MTL::Library* initLibrary(MTL::Device* device, const char* path);
 
 
 // constructor for Ferrum::MetalEngine
-Ferrum::MetalEngine::MetalEngine(const char* path) :
-    emptyAction([](std::vector<MTL::Buffer*>&, int) {}) {
+Ferrum::MetalEngine::MetalEngine(const char* path, int queueCount, int deviceIndex) :
+    emptyAction([](std::vector<MTL::Buffer*>&, long) {}),
+    library(nullptr), nextQueue(0), pool(nullptr), memoryPressureSource(nullptr), pressureCancelled(nullptr),
+    fnCount(0), kernelFunctions(nullptr), computePipelineStates(nullptr),
+    compiledFunctions(new MTL::Function*[MAX_COMPILED_KERNELS]()),
+    compiledStates(new std::atomic<MTL::ComputePipelineState*>[MAX_COMPILED_KERNELS]()), kernelCache(nullptr) {
   DBG("Getting Metal device");
-  device = getDevice();
+  device = getDevice(deviceIndex);
+  if (device == nullptr) {
+    return;
+  }
+  // compiled kernels are only good for the GPU and the Metal compiler they were built with
+  std::string target = std::string(str(device->name())) + " " +
+                       str(NS::ProcessInfo::processInfo()->operatingSystemVersionString());
+  kernelCache = new KernelCache(KernelCache::defaultDirectory(), target);
+  pool = new MetalPool(MetalAllocator(device));
+  DBG("Watching for memory pressure...");
+  memoryPressureSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0,
+                                                DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL,
+                                                dispatch_get_global_queue(QOS_CLASS_UTILITY, 0));
+  if (memoryPressureSource != nullptr) {
+    dispatch_set_context(memoryPressureSource, this);
+    dispatch_source_set_event_handler_f(memoryPressureSource, [](void* engine) {
+      static_cast<Ferrum::MetalEngine*>(engine)->trimPool();
+    });
+    pressureCancelled = dispatch_semaphore_create(0);
+    dispatch_source_set_cancel_handler_f(memoryPressureSource, [](void* engine) {
+      dispatch_semaphore_signal(static_cast<Ferrum::MetalEngine*>(engine)->pressureCancelled);
+    });
+    dispatch_resume(memoryPressureSource);
+  }
   DBG("Initializing library...");
   library = initLibrary(device, path);
   if (library == nullptr) {
     std::cerr << "Error: Failed to initialize Metal library" << std::endl;
     return;
   }
-  DBG("Creating command queue...");
-
-  commandQueue = device->newCommandQueue();
+  DBG("Creating command queues...");
+  for (int q = 0; q < queueCount; q++) {
+    MTL::CommandQueue* queue = device->newCommandQueue();
+    if (queue == nullptr) {
+      std::cerr << "Error: Failed to create command queue" << std::endl;
+      break;
+    }
+    commandQueues.push_back(queue);
+  }
 
   DBG("Retrieving function names...");
   NS::Array* functions = library->functionNames();
@@ -62,11 +104,11 @@ Ferrum::MetalEngine::MetalEngine(const char* path) :
       std::cerr << "Error: Failed to create pipeline state for: " << str(fnName) << std::endl;
     } else {
       DBG("Created pipeline state for: ", str(fnName));
-      auto idIt = functionMap->find(str(fnName));
-      if (idIt == functionMap->end()) {
+      FunctionID id = functionID(str(fnName));
+      if (id == FunctionID::UNKNOWN) {
         std::cerr << "Error: Unknown function: " << str(fnName) << std::endl;
       } else {
-        computePipelineStates[static_cast<int>(idIt->second)] = pipelineState;
+        computePipelineStates[static_cast<int>(id)] = pipelineState;
       }
     }
   }
@@ -75,6 +117,14 @@ Ferrum::MetalEngine::MetalEngine(const char* path) :
 
 
 Ferrum::MetalEngine::~MetalEngine() {
+  if (memoryPressureSource != nullptr) {
+    // cancelling is asynchronous: a handler already trimming the pool may still be running
+    dispatch_source_cancel(memoryPressureSource);
+    dispatch_semaphore_wait(pressureCancelled, DISPATCH_TIME_FOREVER);
+    dispatch_release(pressureCancelled);
+    dispatch_release(memoryPressureSource);
+  }
+  delete pool;
   if (computePipelineStates != nullptr) {
     for (int i = 0; i < fnCount; i++) {
       if (computePipelineStates[i] != nullptr) {
@@ -87,8 +137,17 @@ Ferrum::MetalEngine::~MetalEngine() {
     delete[] computePipelineStates;
     delete[] kernelFunctions;
   }
-  if (commandQueue != nullptr) {
-    commandQueue->release();
+  for (int i = 0; i < MAX_COMPILED_KERNELS; i++) {
+    if (compiledStates[i].load() != nullptr) {
+      compiledStates[i].load()->release();
+      compiledFunctions[i]->release();
+    }
+  }
+  delete[] compiledStates;
+  delete[] compiledFunctions;
+  delete kernelCache;
+  for (MTL::CommandQueue* queue : commandQueues) {
+    queue->release();
   }
   if (library != nullptr) {
     library->release();
@@ -180,19 +239,28 @@ const NS::String* getLibPath(const char* path) {
 
 
 // Finds a Metal device. This is not straightforward as there is no default device when
-// there is no UI.
-MTL::Device* getDevice() {
+// there is no UI, so every device is listed and one is picked by its index.
+MTL::Device* getDevice(int index) {
   NS::Array* devices = MTL::CopyAllDevices();
   int length = devices != nullptr ? devices->count() : 0;
   if (length == 0) {
     std::cerr << "Metal is not supported on this device" << std::endl;
     return nullptr;
   }
-  MTL::Device* device = devices->object<MTL::Device>(0);
+  if (index < 0 || index >= length) {
+    std::cerr << "Error: No Metal device " << index << " of " << length << std::endl;
+    return nullptr;
+  }
+  MTL::Device* device = devices->object<MTL::Device>(index);
   DBG("Running on device: ", device->name()->utf8String());
   return device;
 }
 
+int Ferrum::MetalEngine::deviceCount() {
+  NS::Array* devices = MTL::CopyAllDevices();
+  return devices != nullptr ? static_cast<int>(devices->count()) : 0;
+}
+
 extern "C" char binary_ferrum_bin_start[];
 extern "C" unsigned long long binary_ferrum_bin_size;
 
@@ -269,611 +337,1913 @@ MTL::Library* initLibrary(MTL::Device* device, const char* path = nullptr) {
 }
 
 
+// the largest index that a kernel can compute
+static const long INDEX_LIMIT = INT32_MAX;
+
+static long magnitude(long stride) {
+  return stride < 0 ? -stride : stride;
+}
+
+// The elements from the first to the last of n strided elements
+static long span(long n, long stride) {
+  return n <= 0 ? 0 : (n - 1) * magnitude(stride) + 1;
+}
+
+// The threads of a window: rows x columns, or for a triangle a line of one for each element of
+// the triangle with its diagonal, which the uplo kernels map back to their rows and columns
+static MTL::Size grid(Ferrum::KernelShape shape, long rows, long cols) {
+  if (shape == Ferrum::KernelShape::UPLO) {
+    return MTL::Size(rows * (rows + 1) / 2, 1, 1);
+  }
+  return MTL::Size(rows, cols, 1);
+}
+
+static float* vectorOutOfBounds(Ferrum::FunctionID id) {
+  std::cerr << "Error: Vector does not fit in its array for function '" << Ferrum::kernelName(id) << "'" << std::endl;
+  return nullptr;
+}
+
+bool Ferrum::MetalEngine::windows(Ferrum::KernelShape shape, long rows, long cols,
+                                  const std::vector<Layout>& layouts, std::vector<Window>& out) {
+  bool matrix = shape != KernelShape::VECTOR;
+  // a window steps over columns of a matrix, or elements of a vector, and each step
+  // reaches the rest of its column
+  long steps = matrix ? cols : rows;
+  long reach = matrix ? rows - 1 : 0;
+
+  // the 32-bit fast path: one dispatch with the caller's offsets. A vector with a negative
+  // stride starts at its highest index.
+  bool narrow = rows <= INDEX_LIMIT && cols <= INDEX_LIMIT;
+  for (const Layout& layout : layouts) {
+    narrow = narrow && magnitude(layout.stride) <= INDEX_LIMIT &&
+             layout.offset + reach + (steps - 1) * std::max(0L, layout.stride) <= INDEX_LIMIT;
+  }
+  if (narrow) {
+    Window window{static_cast<int32_t>(rows), static_cast<int32_t>(cols), {}};
+    for (size_t i = 0; i < layouts.size(); i++) {
+      window.views[i] = View{0, static_cast<int32_t>(layouts[i].offset), static_cast<int32_t>(layouts[i].stride)};
+    }
+    out.push_back(window);
+    return true;
+  }
+
+  // the most steps that a window can take before an index passes the limit
+  long most = INDEX_LIMIT;
+  for (const Layout& layout : layouts) {
+    if (reach > INDEX_LIMIT || layout.stride == 0 || magnitude(layout.stride) > INDEX_LIMIT) {
+      return false;
+    }
+    most = std::min(most, 1 + (INDEX_LIMIT - reach) / magnitude(layout.stride));
+  }
+  // uplo kernels map their threads onto the whole triangle, so a triangle cannot be cut into windows
+  if (shape == KernelShape::UPLO && most < steps) {
+    return false;
+  }
+  for (long first = 0; first < steps; first += most) {
+    long count = std::min(most, steps - first);
+    Window window{static_cast<int32_t>(matrix ? rows : count), static_cast<int32_t>(matrix ? count : 1), {}};
+    for (size_t i = 0; i < layouts.size(); i++) {
+      long stride = layouts[i].stride;
+      long start = layouts[i].offset + first * stride;
+      // a backwards window is bound at its lowest element, and starts count - 1 strides above it
+      long above = stride < 0 ? (count - 1) * -stride : 0;
+      window.views[i] = View{sizeof(float) * (start - above), static_cast<int32_t>(above),
+                             static_cast<int32_t>(stride)};
+    }
+    out.push_back(window);
+  }
+  return true;
+}
+
+void Ferrum::MetalEngine::setView(MTL::ComputeCommandEncoder* encoder, MTL::Buffer* buffer,
+                                  const View& view, int index) {
+  encoder->setBuffer(buffer, view.bytes, index);
+  encoder->setBytes(&view.offset, sizeof(view.offset), index + 1);
+  encoder->setBytes(&view.stride, sizeof(view.stride), index + 2);
+}
+
 template<typename CreateBuffers, typename SetBuffers, typename CopyResults>
-float* Ferrum::MetalEngine::call_metal(Ferrum::FunctionID id,
-                                       float* result, int len, int offset, int stride,
+float* Ferrum::MetalEngine::call_metal(Ferrum::FunctionID id, Ferrum::KernelShape shape, long rows, long cols,
+                                       const std::vector<Layout>& layouts, float* result, long first, long len,
                                        CreateBuffers createBuffers, SetBuffers setBuffers,
                                        CopyResults copyResults) {
-  MTL::ComputePipelineState* pipelineState = computePipelineStates[static_cast<int>(id)];
+  // an engine without a device or library has no pipelines
+  MTL::ComputePipelineState* pipelineState = this->pipelineState(id);
   if (pipelineState == nullptr) {
-    std::cerr << "Error: Failed to find pipeline state for '" << id << "'" << std::endl;
+    std::cerr << "Error: Failed to find pipeline state for '" << kernelName(id) << "'" << std::endl;
     return nullptr;
   }
+  // nothing to compute, and the result is left as it is
+  if (rows <= 0 || cols <= 0) {
+    return result;
+  }
+  std::vector<Window> dispatches;
+  if (!windows(shape, rows, cols, layouts, dispatches)) {
+    std::cerr << "Error: Strides are too large to index for function '" << kernelName(id) << "'" << std::endl;
+    return nullptr;
+  }
+
+  // calls may arrive on threads without an autorelease pool, such as JVM threads
+  NS::AutoreleasePool* autoreleasePool = NS::AutoreleasePool::alloc()->init();
 
   auto buffers = createBuffers();
 
+  auto releaseBuffers = [&]() {
+    for (auto& buffer : buffers) {
+      pool->release(buffer);
+    }
+    autoreleasePool->release();
+  };
+
   for (auto& buffer : buffers) {
     if (buffer == nullptr) {
       std::cerr << "Error: Failed to create buffer" << std::endl;
+      releaseBuffers();
       return nullptr;
     }
-  } 
+  }
 
-  MTL::CommandBuffer* commandBuffer = commandQueue->commandBuffer();
+  MTL::CommandBuffer* commandBuffer = commandQueue()->commandBuffer();
   if (commandBuffer == nullptr) {
     std::cerr << "Error: Failed to create command buffer" << std::endl;
+    releaseBuffers();
     return nullptr;
   }
 
   MTL::ComputeCommandEncoder* encoder = commandBuffer->computeCommandEncoder();
   if (encoder == nullptr) {
     std::cerr << "Error: Failed to create command encoder" << std::endl;
+    releaseBuffers();
     return nullptr;
   }
 
   encoder->setComputePipelineState(pipelineState);
 
-  setBuffers(encoder, buffers);
-
-  MTL::Size gridSize = MTL::Size(1, 1, 1);
-  MTL::Size threadGroupSize = MTL::Size(len, 1, 1);
+  // a single threadgroup is limited to the pipeline's maximum, so larger calls
+  // (such as coalesced batches) are spread over as many threadgroups as they need
+  NS::UInteger groupWidth = std::min<NS::UInteger>(grid(shape, rows, cols).width,
+                                                   pipelineState->maxTotalThreadsPerThreadgroup());
+  // a tuned width, where the profile has one, narrows the threadgroup
+  int tuned = launch.get(id, rows * cols);
+  if (tuned > 0) {
+    groupWidth = std::min<NS::UInteger>(groupWidth, tuned);
+  }
+  MTL::Size threadGroupSize = MTL::Size(groupWidth, 1, 1);
 
-  encoder->dispatchThreadgroups(gridSize, threadGroupSize);
+  // matrices are dispatched as a grid of rows x columns, and triangles as a line of their elements
+  for (const Window& window : dispatches) {
+    setBuffers(encoder, buffers, window);
+    encoder->dispatchThreads(grid(shape, window.rows, window.cols), threadGroupSize);
+  }
 
   encoder->endEncoding();
   commandBuffer->commit();
   commandBuffer->waitUntilCompleted();
 
   float* bresult = reinterpret_cast<float*>(buffers.back()->contents());
-  memcpy(result, bresult, sizeof(float) * len);
+  memcpy(result + first, bresult, sizeof(float) * len);
   // bring over more buffers if there is more than one result
   copyResults(buffers, len);
+  releaseBuffers();
+  return result;
+}
+
+template<typename CreateBuffers, typename SetBuffers>
+float* Ferrum::MetalEngine::call_groups(Ferrum::FunctionID id, MTL::Size groups, MTL::Size groupSize,
+                                        float* result, long len,
+                                        CreateBuffers createBuffers, SetBuffers setBuffers) {
+  MTL::ComputePipelineState* pipelineState = this->pipelineState(id);
+  if (pipelineState == nullptr) {
+    std::cerr << "Error: Failed to find pipeline state for '" << kernelName(id) << "'" << std::endl;
+    return nullptr;
+  }
+  if (groups.width == 0 || groups.height == 0 || groups.depth == 0) {
+    return result;
+  }
+  return call_encoded(result, len, createBuffers,
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
+        encoder->setComputePipelineState(pipelineState);
+        setBuffers(encoder, buffers);
+        encoder->dispatchThreadgroups(groups, groupSize);
+      });
+}
+
+template<typename CreateBuffers, typename Encode>
+float* Ferrum::MetalEngine::call_encoded(float* result, long len, CreateBuffers createBuffers, Encode encode) {
+  NS::AutoreleasePool* autoreleasePool = NS::AutoreleasePool::alloc()->init();
+
+  auto buffers = createBuffers();
+
+  auto releaseBuffers = [&]() {
+    for (auto& buffer : buffers) {
+      pool->release(buffer);
+    }
+    autoreleasePool->release();
+  };
+
   for (auto& buffer : buffers) {
-    buffer->release();
+    if (buffer == nullptr) {
+      std::cerr << "Error: Failed to create buffer" << std::endl;
+      releaseBuffers();
+      return nullptr;
+    }
   }
+
+  MTL::CommandBuffer* commandBuffer = commandQueue()->commandBuffer();
+  MTL::ComputeCommandEncoder* encoder = commandBuffer == nullptr ? nullptr : commandBuffer->computeCommandEncoder();
+  if (encoder == nullptr) {
+    std::cerr << "Error: Failed to create command encoder" << std::endl;
+    releaseBuffers();
+    return nullptr;
+  }
+
+  // dispatches on one encoder run in order
+  encode(encoder, buffers);
+  encoder->endEncoding();
+  commandBuffer->commit();
+  commandBuffer->waitUntilCompleted();
+
+  memcpy(result, buffers.back()->contents(), sizeof(float) * len);
+  releaseBuffers();
   return result;
 }
 
+MTL::ComputePipelineState* Ferrum::MetalEngine::pipelineState(Ferrum::FunctionID id) const {
+  const CompiledKernel* compiled = compiledKernel(id);
+  if (compiled != nullptr) {
+    return compiledStates[compiled->index].load(std::memory_order_acquire);
+  }
+  return (id == FunctionID::UNKNOWN || id >= fnCount) ? nullptr : computePipelineStates[static_cast<int>(id)];
+}
+
+// Builds the Metal source of a kernel into a library of its own, once for each kernel
+Ferrum::FunctionID Ferrum::MetalEngine::compile(const std::string& expression, Ferrum::KernelShape shape) {
+  FunctionID id = Backend::compile(expression, shape);
+  const CompiledKernel* compiled = compiledKernel(id);
+  if (compiled == nullptr || device == nullptr) {
+    return FunctionID::UNKNOWN;
+  }
+  std::lock_guard<std::mutex> guard(compileLock);
+  if (compiledStates[compiled->index].load() != nullptr) {
+    return id;
+  }
+  NS::AutoreleasePool* autoreleasePool = NS::AutoreleasePool::alloc()->init();
+  std::string source = compiled->expression->metalSource(compiled->name, shape);
+  NS::Error* pError = nullptr;
+  MTL::Library* sourceLibrary = device->newLibrary(nsStr(source.c_str()), nullptr, &pError);
+  MTL::Function* function = sourceLibrary == nullptr ? nullptr
+                                                       : sourceLibrary->newFunction(nsStr(compiled->name.c_str()));
+  MTL::ComputePipelineState* state = function == nullptr ? nullptr : cachedPipeline(function, source, &pError);
+  if (sourceLibrary != nullptr) {
+    sourceLibrary->release();
+  }
+  if (state == nullptr) {
+    std::cerr << "Error: Failed to compile expression '" << expression << "'";
+    if (pError != nullptr) {
+      std::cerr << ": " << str(pError->localizedDescription());
+    }
+    std::cerr << std::endl;
+    if (function != nullptr) {
+      function->release();
+    }
+    autoreleasePool->release();
+    return FunctionID::UNKNOWN;
+  }
+  compiledFunctions[compiled->index] = function;
+  compiledStates[compiled->index].store(state, std::memory_order_release);
+  autoreleasePool->release();
+  return id;
+}
+
+// A binary archive is read from and written to a file, so an entry passes through a temporary one
+static std::string archivePath() {
+  static std::atomic<unsigned int> archives(0);
+  const char* temp = std::getenv("TMPDIR");
+  std::string directory = temp != nullptr && *temp != '\0' ? temp : "/tmp";
+  return directory + "/ferrum-" + std::to_string(getpid()) + "-" + std::to_string(archives++) +
+         ".metalar";
+}
+
+// Builds the pipeline of a compiled kernel through a binary archive from the kernel cache, so
+// that the GPU code is only generated when the cache has none for the source. On a miss the
+// new pipeline is added to an empty archive, which is stored for the next process.
+MTL::ComputePipelineState* Ferrum::MetalEngine::cachedPipeline(MTL::Function* function, const std::string& source,
+                                                               NS::Error** error) {
+  if (kernelCache == nullptr || !kernelCache->enabled()) {
+    return device->newComputePipelineState(function, error);
+  }
+  std::string path = archivePath();
+  NS::URL* url = NS::URL::fileURLWithPath(nsStr(path.c_str()));
+  std::string data;
+  bool cached = kernelCache->load(source, data);
+  if (cached) {
+    std::ofstream out(path, std::ios::binary);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    out.close();
+    cached = !out.fail();
+  }
+  MTL::BinaryArchiveDescriptor* archiveDescriptor = MTL::BinaryArchiveDescriptor::alloc()->init();
+  archiveDescriptor->setUrl(cached ? url : nullptr);
+  MTL::BinaryArchive* archive = device->newBinaryArchive(archiveDescriptor, nullptr);
+  if (archive == nullptr && cached) {
+    // an archive this GPU cannot read is replaced by a new one
+    cached = false;
+    archiveDescriptor->setUrl(nullptr);
+    archive = device->newBinaryArchive(archiveDescriptor, nullptr);
+  }
+  archiveDescriptor->release();
+  if (archive == nullptr) {
+    std::remove(path.c_str());
+    return device->newComputePipelineState(function, error);
+  }
+
+  MTL::ComputePipelineDescriptor* descriptor = MTL::ComputePipelineDescriptor::alloc()->init();
+  descriptor->setComputeFunction(function);
+  descriptor->setBinaryArchives(NS::Array::array(archive));
+  MTL::ComputePipelineState* state = device->newComputePipelineState(descriptor, MTL::PipelineOptionNone,
+                                                                     nullptr, error);
+  if (state != nullptr && !cached && archive->addComputePipelineFunctions(descriptor, nullptr) &&
+      archive->serializeToURL(url, nullptr)) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream bytes;
+    bytes << in.rdbuf();
+    kernelCache->store(source, bytes.str());
+  }
+  descriptor->release();
+  archive->release();
+  std::remove(path.c_str());
+  return state;
+}
+
+std::vector<int> Ferrum::MetalEngine::launchOptions(Ferrum::FunctionID id) const {
+  std::vector<int> widths;
+  MTL::ComputePipelineState* pipelineState = this->pipelineState(id);
+  if (pipelineState != nullptr) {
+    int simd = static_cast<int>(pipelineState->threadExecutionWidth());
+    int most = static_cast<int>(pipelineState->maxTotalThreadsPerThreadgroup());
+    for (int width = simd; width <= most; width *= 2) {
+      widths.push_back(width);
+    }
+  }
+  return widths;
+}
+
+// command queues are used round robin, so that concurrent callers do not serialize on one queue
+MTL::CommandQueue* Ferrum::MetalEngine::commandQueue() {
+  unsigned int q = nextQueue.fetch_add(1, std::memory_order_relaxed);
+  return commandQueues[q % commandQueues.size()];
+}
+
+// buffer pool
+
+MTL::Buffer* Ferrum::MetalEngine::inputBuffer(const float* data, long len) {
+  MTL::Buffer* buffer = pool->acquire(sizeof(float) * len);
+  if (buffer != nullptr) {
+    memcpy(buffer->contents(), data, sizeof(float) * len);
+  }
+  return buffer;
+}
+
+// Pooled buffers are not cleared, so an output that the kernel will only partly write
+// is initialized from the caller's result to preserve the elements outside the view
+MTL::Buffer* Ferrum::MetalEngine::outputBuffer(float* result, long len, bool dense) {
+  return dense ? pool->acquire(sizeof(float) * len) : inputBuffer(result, len);
+}
+
+Ferrum::PoolStats Ferrum::MetalEngine::poolStats() const {
+  return pool->stats();
+}
+
+void Ferrum::MetalEngine::setPoolHighWaterMark(size_t bytes) {
+  pool->setHighWaterMark(bytes);
+}
+
+void Ferrum::MetalEngine::trimPool() {
+  DBG("Trimming buffer pool");
+  pool->trim();
+}
+
+// graphs
+
+// Constants are bound from one buffer, each at an offset that every device accepts
+static const NS::UInteger CONSTANT_ALIGNMENT = 256;
+// The most buffers that a kernel binds: the uplo prefix, three operands and four scalars
+static const NS::UInteger MAX_BINDINGS = 16;
+
+class Ferrum::MetalEngine::GraphCommands : public Ferrum::GraphExec {
+  public:
+    GraphCommands(MetalEngine* engine, const Graph& graph) :
+        GraphExec(graph), engine(engine), written(graph.tensorCount(), false),
+        commands(nullptr), constants(nullptr), count(0) {}
+
+    ~GraphCommands() {
+      for (MTL::Buffer* buffer : tensors) {
+        buffer->release();
+      }
+      for (auto& entry : pipelines) {
+        entry.second->release();
+      }
+      if (commands != nullptr) {
+        commands->release();
+      }
+      if (constants != nullptr) {
+        constants->release();
+      }
+    }
+
+    // Encodes a command for each window of each call. Returns false if a call cannot be encoded.
+    bool encode() {
+      MTL::Device* device = engine->device;
+      for (size_t t = 0; t < lens.size(); t++) {
+        MTL::Buffer* buffer = device->newBuffer(sizeof(float) * std::max(1L, lens[t]), MTL::ResourceStorageModeShared);
+        if (buffer == nullptr) {
+          std::cerr << "Error: Failed to create buffer" << std::endl;
+          return false;
+        }
+        tensors.push_back(buffer);
+      }
+
+      std::vector<Command> encoded;
+      NS::UInteger slots = 0;
+      for (const Graph::Op& op : ops) {
+        bool vector = op.shape == KernelShape::VECTOR;
+        long rows = op.n;
+        long cols = vector ? 1 : (op.shape == KernelShape::GE ? op.fd : op.n);
+        if (rows <= 0 || cols <= 0) {
+          continue;
+        }
+        MTL::ComputePipelineState* state = pipeline(op.id);
+        if (state == nullptr) {
+          return false;
+        }
+        // tensors are whole, so operands keep their offsets from the start of the tensor
+        std::vector<Layout> layouts;
+        for (const Graph::Operand* operand : {&op.a, &op.b, &op.r}) {
+          if (operand->tensor >= 0) {
+            long offset = vector ? firstIndex(operand->offset, operand->stride, op.n) : operand->offset;
+            layouts.push_back(Layout{offset, operand->stride});
+          }
+        }
+        std::vector<Window> dispatches;
+        if (!windows(op.shape, rows, cols, layouts, dispatches)) {
+          std::cerr << "Error: Strides are too large to index for function '" << kernelName(op.id) << "'" << std::endl;
+          return false;
+        }
+        NS::UInteger groupWidth = std::min<NS::UInteger>(grid(op.shape, rows, cols).width,
+                                                         state->maxTotalThreadsPerThreadgroup());
+        int tuned = engine->launch.get(op.id, rows * cols);
+        if (tuned > 0) {
+          groupWidth = std::min<NS::UInteger>(groupWidth, tuned);
+        }
+        for (size_t w = 0; w < dispatches.size(); w++) {
+          // each call waits for the ones before it, while its own windows run together
+          Command command{state, grid(op.shape, dispatches[w].rows, dispatches[w].cols), MTL::Size(groupWidth, 1, 1),
+                          w == 0 && !encoded.empty(), {}};
+          bindings(op, dispatches[w], command.arguments);
+          for (const Argument& argument : command.arguments) {
+            slots += argument.tensor < 0 ? 1 : 0;
+          }
+          encoded.push_back(command);
+        }
+        written[op.r.tensor] = true;
+        if (op.form == Graph::Form::bBB) {
+          written[op.b.tensor] = true;
+        }
+      }
+      count = encoded.size();
+      if (count == 0) {
+        return true;
+      }
+
+      MTL::IndirectCommandBufferDescriptor* descriptor = MTL::IndirectCommandBufferDescriptor::alloc()->init();
+      descriptor->setCommandTypes(MTL::IndirectCommandTypeConcurrentDispatchThreads);
+      descriptor->setInheritPipelineState(false);
+      descriptor->setInheritBuffers(false);
+      descriptor->setMaxKernelBufferBindCount(MAX_BINDINGS);
+      commands = device->newIndirectCommandBuffer(descriptor, count, MTL::ResourceStorageModeShared);
+      descriptor->release();
+      constants = device->newBuffer(std::max<NS::UInteger>(slots, 1) * CONSTANT_ALIGNMENT,
+                                    MTL::ResourceStorageModeShared);
+      if (commands == nullptr || constants == nullptr) {
+        std::cerr << "Error: Failed to create indirect command buffer" << std::endl;
+        return false;
+      }
+
+      char* values = static_cast<char*>(constants->contents());
+      NS::UInteger slot = 0;
+      for (NS::UInteger i = 0; i < count; i++) {
+        const Command& encodedCommand = encoded[i];
+        MTL::IndirectComputeCommand* command = commands->indirectComputeCommand(i);
+        command->setComputePipelineState(encodedCommand.pipeline);
+        for (size_t index = 0; index < encodedCommand.arguments.size(); index++) {
+          const Argument& argument = encodedCommand.arguments[index];
+          if (argument.tensor >= 0) {
+            command->setKernelBuffer(tensors[argument.tensor], argument.bytes, index);
+          } else {
+            memcpy(values + slot * CONSTANT_ALIGNMENT, &argument.value, sizeof(argument.value));
+            command->setKernelBuffer(constants, slot * CONSTANT_ALIGNMENT, index);
+            slot++;
+          }
+        }
+        if (encodedCommand.barrier) {
+          command->setBarrier();
+        }
+        command->concurrentDispatchThreads(encodedCommand.grid, encodedCommand.group);
+      }
+      return true;
+    }
+
+    bool replay() override {
+      // calls may arrive on threads without an autorelease pool, such as JVM threads
+      NS::AutoreleasePool* autoreleasePool = NS::AutoreleasePool::alloc()->init();
+      for (size_t t = 0; t < tensors.size(); t++) {
+        memcpy(tensors[t]->contents(), bound[t], sizeof(float) * lens[t]);
+      }
+      if (count > 0) {
+        MTL::CommandBuffer* commandBuffer = engine->commandQueue()->commandBuffer();
+        MTL::ComputeCommandEncoder* encoder = commandBuffer == nullptr ? nullptr : commandBuffer->computeCommandEncoder();
+        if (encoder == nullptr) {
+          std::cerr << "Error: Failed to create command encoder" << std::endl;
+          autoreleasePool->release();
+          return false;
+        }
+        for (MTL::Buffer* buffer : tensors) {
+          encoder->useResource(buffer, MTL::ResourceUsageRead | MTL::ResourceUsageWrite);
+        }
+        encoder->useResource(constants, MTL::ResourceUsageRead);
+        encoder->executeCommandsInBuffer(commands, NS::Range(0, count));
+        encoder->endEncoding();
+        commandBuffer->commit();
+        commandBuffer->waitUntilCompleted();
+      }
+      for (size_t t = 0; t < tensors.size(); t++) {
+        if (written[t]) {
+          memcpy(bound[t], tensors[t]->contents(), sizeof(float) * lens[t]);
+        }
+      }
+      autoreleasePool->release();
+      return true;
+    }
+
+  private:
+    // A kernel argument: a tensor bound at a byte offset, or a 32-bit constant
+    struct Argument {
+      int tensor;          // -1 for a constant
+      NS::UInteger bytes;
+      uint32_t value;
+    };
+
+    struct Command {
+      MTL::ComputePipelineState* pipeline;
+      MTL::Size grid;
+      MTL::Size group;
+      bool barrier;
+      std::vector<Argument> arguments;
+    };
+
+    MetalEngine* engine;
+    std::vector<MTL::Buffer*> tensors;
+    std::vector<bool> written;
+    std::unordered_map<int, MTL::ComputePipelineState*> pipelines;
+    MTL::IndirectCommandBuffer* commands;
+    MTL::Buffer* constants;
+    NS::UInteger count;
+
+    // Pipelines in an indirect command buffer must be created to support it, so the graph has its own
+    MTL::ComputePipelineState* pipeline(FunctionID id) {
+      auto it = pipelines.find(static_cast<int>(id));
+      if (it != pipelines.end()) {
+        return it->second;
+      }
+      const char* name = functionName(id);
+      MTL::Function* function = name == nullptr ? nullptr : engine->library->newFunction(nsStr(name));
+      // a compiled kernel has its function from when it was compiled on the engine
+      const CompiledKernel* compiled = compiledKernel(id);
+      if (compiled != nullptr && engine->compiledStates[compiled->index].load() != nullptr) {
+        name = compiled->name.c_str();
+        function = engine->compiledFunctions[compiled->index]->retain();
+      }
+      if (function == nullptr) {
+        std::cerr << "Error: Failed to find pipeline state for '" << kernelName(id) << "'" << std::endl;
+        return nullptr;
+      }
+      MTL::ComputePipelineDescriptor* descriptor = MTL::ComputePipelineDescriptor::alloc()->init();
+      descriptor->setComputeFunction(function);
+      descriptor->setSupportIndirectCommandBuffers(true);
+      NS::Error* pError = nullptr;
+      MTL::ComputePipelineState* state =
+          engine->device->newComputePipelineState(descriptor, MTL::PipelineOptionNone, nullptr, &pError);
+      descriptor->release();
+      function->release();
+      if (state == nullptr) {
+        std::cerr << "Error: Failed to create pipeline state for: " << name << std::endl;
+        return nullptr;
+      }
+      pipelines[static_cast<int>(id)] = state;
+      return state;
+    }
+
+    // The arguments of a kernel, in the order that the dispatch functions bind them
+    static void bindings(const Graph::Op& op, const Window& w, std::vector<Argument>& out) {
+      auto constant = [&](const void* value) {
+        Argument argument{-1, 0, 0};
+        memcpy(&argument.value, value, sizeof(argument.value));
+        out.push_back(argument);
+      };
+      auto buffer = [&](const Graph::Operand& operand, const View& view) {
+        out.push_back(Argument{operand.tensor, view.bytes, 0});
+        constant(&view.offset);
+        constant(&view.stride);
+      };
+      if (op.shape == KernelShape::GE) {
+        constant(&w.rows);
+        constant(&w.cols);
+      } else if (op.shape == KernelShape::UPLO) {
+        constant(&w.rows);
+        constant(&op.unit);
+        constant(&op.bottom);
+      }
+      // the result's view follows b's, when there is a b
+      const View& result = w.views[op.b.tensor < 0 ? 1 : 2];
+      switch (op.form) {
+        case Graph::Form::bB:
+          buffer(op.a, w.views[0]);
+          break;
+        case Graph::Form::bfB:
+          buffer(op.a, w.views[0]);
+          constant(&op.s.sa);
+          break;
+        case Graph::Form::fbB:
+          // uplo kernels take the scalar after a
+          if (op.shape == KernelShape::UPLO) {
+            buffer(op.a, w.views[0]);
+            constant(&op.s.sa);
+          } else {
+            constant(&op.s.sa);
+            buffer(op.a, w.views[0]);
+          }
+          break;
+        case Graph::Form::bbB:
+        case Graph::Form::bBB:
+          buffer(op.a, w.views[0]);
+          buffer(op.b, w.views[1]);
+          break;
+        case Graph::Form::bffffB:
+          buffer(op.a, w.views[0]);
+          constant(&op.s.sa);
+          constant(&op.s.sha);
+          constant(&op.s.sb);
+          constant(&op.s.shb);
+          break;
+        case Graph::Form::bbffffB:
+          buffer(op.a, w.views[0]);
+          buffer(op.b, w.views[1]);
+          constant(&op.s.sa);
+          constant(&op.s.sha);
+          constant(&op.s.sb);
+          constant(&op.s.shb);
+          break;
+      }
+      buffer(op.r, result);
+    }
+};
+
+Ferrum::GraphExec* Ferrum::MetalEngine::instantiate(const Ferrum::Graph& graph) {
+  if (library == nullptr || commandQueues.empty()) {
+    std::cerr << "Error: No Metal device to instantiate the graph on" << std::endl;
+    return nullptr;
+  }
+  NS::AutoreleasePool* autoreleasePool = NS::AutoreleasePool::alloc()->init();
+  GraphCommands* commands = new GraphCommands(this, graph);
+  if (!commands->encode()) {
+    delete commands;
+    commands = nullptr;
+  }
+  autoreleasePool->release();
+  return commands;
+}
+
 // general vector functions
-float* Ferrum::MetalEngine::vect_bB(Ferrum::FunctionID id, const float* a, int lena, int offset_a, int stride_a,
-                                    float* result, int len, int offset, int stride) {
-  return call_metal(id, result, len, offset, stride,
+float* Ferrum::MetalEngine::vect_bB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                    float* result, long len, long offset, long stride) {
+  if (!(holds(lena, offset_a, stride_a, n) &&
+        holds(len, offset, stride, n))) {
+    return vectorOutOfBounds(id);
+  }
+  return call_metal(id, KernelShape::VECTOR, n, 1,
+                    {{firstIndex(0, stride_a, n), stride_a}, {firstIndex(0, stride, n), stride}},
+                    result, offset, span(n, stride),
       [&]() {
-        MTL::Buffer* bufferA = device->newBuffer(a, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferR = device->newBuffer(sizeof(float) * len, MTL::StorageModeShared);
+        MTL::Buffer* bufferA = inputBuffer(a + offset_a, span(n, stride_a));
+        MTL::Buffer* bufferR = outputBuffer(result + offset, span(n, stride), magnitude(stride) == 1);
         return std::vector<MTL::Buffer*>{bufferA, bufferR};
       },
-      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
-        encoder->setBuffer(buffers[0], 0, 0);
-        encoder->setBytes(&offset_a, sizeof(offset_a), 1);
-        encoder->setBytes(&stride_a, sizeof(stride_a), 2);
-        encoder->setBuffer(buffers[1], 0, 3);
-        encoder->setBytes(&offset, sizeof(offset), 4);
-        encoder->setBytes(&stride, sizeof(stride), 5);
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers, const Window& w) {
+        setView(encoder, buffers[0], w.views[0], 0);
+        setView(encoder, buffers[1], w.views[1], 3);
       },
       emptyAction);
 }
 
-float* Ferrum::MetalEngine::vect_bfB(Ferrum::FunctionID id, const float* a, int lena, int offset_a, int stride_a,
+float* Ferrum::MetalEngine::vect_bfB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
                                      float sa,
-                                     float* result, int len, int offset, int stride) {
-  return call_metal(id, result, len, offset, stride,
+                                     float* result, long len, long offset, long stride) {
+  if (!(holds(lena, offset_a, stride_a, n) &&
+        holds(len, offset, stride, n))) {
+    return vectorOutOfBounds(id);
+  }
+  return call_metal(id, KernelShape::VECTOR, n, 1,
+                    {{firstIndex(0, stride_a, n), stride_a}, {firstIndex(0, stride, n), stride}},
+                    result, offset, span(n, stride),
       [&]() {
-        MTL::Buffer* bufferA = device->newBuffer(a, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferR = device->newBuffer(sizeof(float) * len, MTL::StorageModeShared);
+        MTL::Buffer* bufferA = inputBuffer(a + offset_a, span(n, stride_a));
+        MTL::Buffer* bufferR = outputBuffer(result + offset, span(n, stride), magnitude(stride) == 1);
         return std::vector<MTL::Buffer*>{bufferA, bufferR};
       },
-      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
-        encoder->setBuffer(buffers[0], 0, 0);
-        encoder->setBytes(&offset_a, sizeof(offset_a), 1);
-        encoder->setBytes(&stride_a, sizeof(stride_a), 2);
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers, const Window& w) {
+        setView(encoder, buffers[0], w.views[0], 0);
         encoder->setBytes(&sa, sizeof(sa), 3);
-        encoder->setBuffer(buffers[1], 0, 4);
-        encoder->setBytes(&offset, sizeof(offset), 5);
-        encoder->setBytes(&stride, sizeof(stride), 6);
+        setView(encoder, buffers[1], w.views[1], 4);
       },
       emptyAction);
 }
 
-float* Ferrum::MetalEngine::vect_fbB(Ferrum::FunctionID id, float sa,
-                                     const float* a, int lena, int offset_a, int stride_a,
-                                     float* result, int len, int offset, int stride) {
-  return call_metal(id, result, len, offset, stride,
+float* Ferrum::MetalEngine::vect_fbB(Ferrum::FunctionID id, long n, float sa,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float* result, long len, long offset, long stride) {
+  if (!(holds(lena, offset_a, stride_a, n) &&
+        holds(len, offset, stride, n))) {
+    return vectorOutOfBounds(id);
+  }
+  return call_metal(id, KernelShape::VECTOR, n, 1,
+                    {{firstIndex(0, stride_a, n), stride_a}, {firstIndex(0, stride, n), stride}},
+                    result, offset, span(n, stride),
       [&]() {
-        MTL::Buffer* bufferA = device->newBuffer(a, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferR = device->newBuffer(sizeof(float) * len, MTL::StorageModeShared);
+        MTL::Buffer* bufferA = inputBuffer(a + offset_a, span(n, stride_a));
+        MTL::Buffer* bufferR = outputBuffer(result + offset, span(n, stride), magnitude(stride) == 1);
         return std::vector<MTL::Buffer*>{bufferA, bufferR};
       },
-      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers, const Window& w) {
         encoder->setBytes(&sa, sizeof(sa), 0);
-        encoder->setBuffer(buffers[0], 0, 1);
-        encoder->setBytes(&offset_a, sizeof(offset_a), 2);
-        encoder->setBytes(&stride_a, sizeof(stride_a), 3);
-        encoder->setBuffer(buffers[1], 0, 4);
-        encoder->setBytes(&offset, sizeof(offset), 5);
-        encoder->setBytes(&stride, sizeof(stride), 6);
+        setView(encoder, buffers[0], w.views[0], 1);
+        setView(encoder, buffers[1], w.views[1], 4);
       },
       emptyAction);
 }
 
-float* Ferrum::MetalEngine::vect_bbB(Ferrum::FunctionID id, const float* a, int lena, int offset_a, int stride_a,
-                                     const float* b, int lenb, int offset_b, int stride_b,
-                                     float* result, int len, int offset, int stride) {
-  return call_metal(id, result, len, offset, stride,
+float* Ferrum::MetalEngine::vect_bbB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                     const float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) {
+  if (!(holds(lena, offset_a, stride_a, n) &&
+        holds(lenb, offset_b, stride_b, n) &&
+        holds(len, offset, stride, n))) {
+    return vectorOutOfBounds(id);
+  }
+  return call_metal(id, KernelShape::VECTOR, n, 1,
+                    {{firstIndex(0, stride_a, n), stride_a},
+                     {firstIndex(0, stride_b, n), stride_b},
+                     {firstIndex(0, stride, n), stride}},
+                    result, offset, span(n, stride),
       [&]() {
-        MTL::Buffer* bufferA = device->newBuffer(a, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferB = device->newBuffer(b, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferR = device->newBuffer(sizeof(float) * len, MTL::StorageModeShared);
+        MTL::Buffer* bufferA = inputBuffer(a + offset_a, span(n, stride_a));
+        MTL::Buffer* bufferB = inputBuffer(b + offset_b, span(n, stride_b));
+        MTL::Buffer* bufferR = outputBuffer(result + offset, span(n, stride), magnitude(stride) == 1);
         return std::vector<MTL::Buffer*>{bufferA, bufferB, bufferR};
       },
-      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
-        encoder->setBuffer(buffers[0], 0, 0);
-        encoder->setBytes(&offset_a, sizeof(offset_a), 1);
-        encoder->setBytes(&stride_a, sizeof(stride_a), 2);
-        encoder->setBuffer(buffers[1], 0, 3);
-        encoder->setBytes(&offset_b, sizeof(offset_b), 4);
-        encoder->setBytes(&stride_b, sizeof(stride_b), 5);
-        encoder->setBuffer(buffers[2], 0, 6);
-        encoder->setBytes(&offset, sizeof(offset), 7);
-        encoder->setBytes(&stride, sizeof(stride), 8);
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers, const Window& w) {
+        setView(encoder, buffers[0], w.views[0], 0);
+        setView(encoder, buffers[1], w.views[1], 3);
+        setView(encoder, buffers[2], w.views[2], 6);
       },
       emptyAction);
 }
 
-float* Ferrum::MetalEngine::vect_bBB(Ferrum::FunctionID id, const float* a, int lena, int offset_a, int stride_a,
-                                     float* b, int lenb, int offset_b, int stride_b,
-                                     float* result, int len, int offset, int stride) {
-  return call_metal(id, result, len, offset, stride,
+float* Ferrum::MetalEngine::vect_bBB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                     float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) {
+  if (!(holds(lena, offset_a, stride_a, n) &&
+        holds(lenb, offset_b, stride_b, n) &&
+        holds(len, offset, stride, n))) {
+    return vectorOutOfBounds(id);
+  }
+  return call_metal(id, KernelShape::VECTOR, n, 1,
+                    {{firstIndex(0, stride_a, n), stride_a},
+                     {firstIndex(0, stride_b, n), stride_b},
+                     {firstIndex(0, stride, n), stride}},
+                    result, offset, span(n, stride),
       [&]() {
-        MTL::Buffer* bufferA = device->newBuffer(a, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferB = device->newBuffer(b, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferR = device->newBuffer(sizeof(float) * len, MTL::StorageModeShared);
+        MTL::Buffer* bufferA = inputBuffer(a + offset_a, span(n, stride_a));
+        MTL::Buffer* bufferB = inputBuffer(b + offset_b, span(n, stride_b));
+        MTL::Buffer* bufferR = outputBuffer(result + offset, span(n, stride), magnitude(stride) == 1);
         return std::vector<MTL::Buffer*>{bufferA, bufferB, bufferR};
       },
-      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
-        encoder->setBuffer(buffers[0], 0, 0);
-        encoder->setBytes(&offset_a, sizeof(offset_a), 1);
-        encoder->setBytes(&stride_a, sizeof(stride_a), 2);
-        encoder->setBuffer(buffers[1], 0, 3);
-        encoder->setBytes(&offset_b, sizeof(offset_b), 4);
-        encoder->setBytes(&stride_b, sizeof(stride_b), 5);
-        encoder->setBuffer(buffers[2], 0, 6);
-        encoder->setBytes(&offset, sizeof(offset), 7);
-        encoder->setBytes(&stride, sizeof(stride), 8);
-      },
-      [&](std::vector<MTL::Buffer*>& buffers, int len) {
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers, const Window& w) {
+        setView(encoder, buffers[0], w.views[0], 0);
+        setView(encoder, buffers[1], w.views[1], 3);
+        setView(encoder, buffers[2], w.views[2], 6);
+      },
+      [&](std::vector<MTL::Buffer*>& buffers, long len) {
         float* b_result = reinterpret_cast<float*>(buffers[1]->contents());
-        memcpy(b, b_result, sizeof(float) * len);
+        memcpy(b + offset_b, b_result, sizeof(float) * span(n, stride_b));
       });
 }
 
-float* Ferrum::MetalEngine::vect_bffffB(Ferrum::FunctionID id, const float* a, int lena, int offset_a, int stride_a,
+float* Ferrum::MetalEngine::vect_bffffB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
                                         float sa, float sha,
                                         float sb, float shb,
-                                        float* result, int len, int offset, int stride) {
-  return call_metal(id, result, len, offset, stride,
+                                        float* result, long len, long offset, long stride) {
+  if (!(holds(lena, offset_a, stride_a, n) &&
+        holds(len, offset, stride, n))) {
+    return vectorOutOfBounds(id);
+  }
+  return call_metal(id, KernelShape::VECTOR, n, 1,
+                    {{firstIndex(0, stride_a, n), stride_a}, {firstIndex(0, stride, n), stride}},
+                    result, offset, span(n, stride),
       [&]() {
-        MTL::Buffer* bufferA = device->newBuffer(a, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferR = device->newBuffer(sizeof(float) * len, MTL::StorageModeShared);
+        MTL::Buffer* bufferA = inputBuffer(a + offset_a, span(n, stride_a));
+        MTL::Buffer* bufferR = outputBuffer(result + offset, span(n, stride), magnitude(stride) == 1);
         return std::vector<MTL::Buffer*>{bufferA, bufferR};
       },
-      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
-        encoder->setBuffer(buffers[0], 0, 0);
-        encoder->setBytes(&offset_a, sizeof(offset_a), 1);
-        encoder->setBytes(&stride_a, sizeof(stride_a), 2);
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers, const Window& w) {
+        setView(encoder, buffers[0], w.views[0], 0);
         encoder->setBytes(&sa, sizeof(sa), 3);
         encoder->setBytes(&sha, sizeof(sha), 4);
         encoder->setBytes(&sb, sizeof(sb), 5);
         encoder->setBytes(&shb, sizeof(shb), 6);
-        encoder->setBuffer(buffers[1], 0, 7);
-        encoder->setBytes(&offset, sizeof(offset), 8);
-        encoder->setBytes(&stride, sizeof(stride), 9);
+        setView(encoder, buffers[1], w.views[1], 7);
       },
       emptyAction);
 }
 
-float* Ferrum::MetalEngine::vect_bbffffB(Ferrum::FunctionID id, const float* a, int lena, int offset_a, int stride_a,
-                                         const float* b, int lenb, int offset_b, int stride_b,
+float* Ferrum::MetalEngine::vect_bbffffB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                         const float* b, long lenb, long offset_b, long stride_b,
                                          float sa, float sha,
                                          float sb, float shb,
-                                         float* result, int len, int offset, int stride) {
-  return call_metal(id, result, len, offset, stride,
+                                         float* result, long len, long offset, long stride) {
+  if (!(holds(lena, offset_a, stride_a, n) &&
+        holds(lenb, offset_b, stride_b, n) &&
+        holds(len, offset, stride, n))) {
+    return vectorOutOfBounds(id);
+  }
+  return call_metal(id, KernelShape::VECTOR, n, 1,
+                    {{firstIndex(0, stride_a, n), stride_a},
+                     {firstIndex(0, stride_b, n), stride_b},
+                     {firstIndex(0, stride, n), stride}},
+                    result, offset, span(n, stride),
       [&]() {
-        MTL::Buffer* bufferA = device->newBuffer(a, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferB = device->newBuffer(b, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferR = device->newBuffer(sizeof(float) * len, MTL::StorageModeShared);
+        MTL::Buffer* bufferA = inputBuffer(a + offset_a, span(n, stride_a));
+        MTL::Buffer* bufferB = inputBuffer(b + offset_b, span(n, stride_b));
+        MTL::Buffer* bufferR = outputBuffer(result + offset, span(n, stride), magnitude(stride) == 1);
         return std::vector<MTL::Buffer*>{bufferA, bufferB, bufferR};
       },
-      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
-        encoder->setBuffer(buffers[0], 0, 0);
-        encoder->setBytes(&offset_a, sizeof(offset_a), 1);
-        encoder->setBytes(&stride_a, sizeof(stride_a), 2);
-        encoder->setBuffer(buffers[1], 0, 3);
-        encoder->setBytes(&offset_b, sizeof(offset_b), 4);
-        encoder->setBytes(&stride_b, sizeof(stride_b), 5);
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers, const Window& w) {
+        setView(encoder, buffers[0], w.views[0], 0);
+        setView(encoder, buffers[1], w.views[1], 3);
         encoder->setBytes(&sa, sizeof(sa), 6);
         encoder->setBytes(&sha, sizeof(sha), 7);
         encoder->setBytes(&sb, sizeof(sb), 8);
         encoder->setBytes(&shb, sizeof(shb), 9);
-        encoder->setBuffer(buffers[2], 0, 10);
-        encoder->setBytes(&offset, sizeof(offset), 11);
-        encoder->setBytes(&stride, sizeof(stride), 12);
+        setView(encoder, buffers[2], w.views[2], 10);
       },
       emptyAction);
 }
 
 // general matrix functions
-float* Ferrum::MetalEngine::ge_bB(Ferrum::FunctionID id, int sd, int fd,
-                                  const float* a, int lena, int offset_a, int stride_a,
-                                  float* result, int len, int offset, int stride) {
-  return call_metal(id, result, len, offset, stride,
+float* Ferrum::MetalEngine::ge_bB(Ferrum::FunctionID id, long sd, long fd,
+                                  const float* a, long lena, long offset_a, long stride_a,
+                                  float* result, long len, long offset, long stride) {
+  return call_metal(id, KernelShape::GE, sd, fd, {{offset_a, stride_a}, {offset, stride}},
+                    result, 0, len,
       [&]() {
-        MTL::Buffer* bufferA = device->newBuffer(a, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferR = device->newBuffer(sizeof(float) * len, MTL::StorageModeShared);
+        MTL::Buffer* bufferA = inputBuffer(a, lena);
+        MTL::Buffer* bufferR = outputBuffer(result, len, offset == 0 && stride == sd);
         return std::vector<MTL::Buffer*>{bufferA, bufferR};
       },
-      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
-        encoder->setBytes(&sd, sizeof(sd), 0);
-        encoder->setBytes(&fd, sizeof(fd), 1);
-        encoder->setBuffer(buffers[0], 0, 2);
-        encoder->setBytes(&offset_a, sizeof(offset_a), 3);
-        encoder->setBytes(&stride_a, sizeof(stride_a), 4);
-        encoder->setBuffer(buffers[1], 0, 5);
-        encoder->setBytes(&offset, sizeof(offset), 6);
-        encoder->setBytes(&stride, sizeof(stride), 7);
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers, const Window& w) {
+        encoder->setBytes(&w.rows, sizeof(w.rows), 0);
+        encoder->setBytes(&w.cols, sizeof(w.cols), 1);
+        setView(encoder, buffers[0], w.views[0], 2);
+        setView(encoder, buffers[1], w.views[1], 5);
       },
       emptyAction);
 }
 
-float* Ferrum::MetalEngine::ge_bfB(Ferrum::FunctionID id, int sd, int fd,
-                                   const float* a, int lena, int offset_a, int stride_a,
+float* Ferrum::MetalEngine::ge_bfB(Ferrum::FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
                                    float sa,
-                                   float* result, int len, int offset, int stride) {
-  return call_metal(id, result, len, offset, stride,
+                                   float* result, long len, long offset, long stride) {
+  return call_metal(id, KernelShape::GE, sd, fd, {{offset_a, stride_a}, {offset, stride}},
+                    result, 0, len,
       [&]() {
-        MTL::Buffer* bufferA = device->newBuffer(a, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferR = device->newBuffer(sizeof(float) * len, MTL::StorageModeShared);
+        MTL::Buffer* bufferA = inputBuffer(a, lena);
+        MTL::Buffer* bufferR = outputBuffer(result, len, offset == 0 && stride == sd);
         return std::vector<MTL::Buffer*>{bufferA, bufferR};
       },
-      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
-        encoder->setBytes(&sd, sizeof(sd), 0);
-        encoder->setBytes(&fd, sizeof(fd), 1);
-        encoder->setBuffer(buffers[0], 0, 2);
-        encoder->setBytes(&offset_a, sizeof(offset_a), 3);
-        encoder->setBytes(&stride_a, sizeof(stride_a), 4);
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers, const Window& w) {
+        encoder->setBytes(&w.rows, sizeof(w.rows), 0);
+        encoder->setBytes(&w.cols, sizeof(w.cols), 1);
+        setView(encoder, buffers[0], w.views[0], 2);
         encoder->setBytes(&sa, sizeof(sa), 5);
-        encoder->setBuffer(buffers[1], 0, 6);
-        encoder->setBytes(&offset, sizeof(offset), 7);
-        encoder->setBytes(&stride, sizeof(stride), 8);
+        setView(encoder, buffers[1], w.views[1], 6);
       },
       emptyAction);
 }
 
-float* Ferrum::MetalEngine::ge_fbB(Ferrum::FunctionID id, int sd, int fd, float sa,
-                                   const float* a, int lena, int offset_a, int stride_a,
-                                   float* result, int len, int offset, int stride) {
-  return call_metal(id, result, len, offset, stride,
+float* Ferrum::MetalEngine::ge_fbB(Ferrum::FunctionID id, long sd, long fd, float sa,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* result, long len, long offset, long stride) {
+  return call_metal(id, KernelShape::GE, sd, fd, {{offset_a, stride_a}, {offset, stride}},
+                    result, 0, len,
       [&]() {
-        MTL::Buffer* bufferA = device->newBuffer(a, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferR = device->newBuffer(sizeof(float) * len, MTL::StorageModeShared);
+        MTL::Buffer* bufferA = inputBuffer(a, lena);
+        MTL::Buffer* bufferR = outputBuffer(result, len, offset == 0 && stride == sd);
         return std::vector<MTL::Buffer*>{bufferA, bufferR};
       },
-      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
-        encoder->setBytes(&sd, sizeof(sd), 0);
-        encoder->setBytes(&fd, sizeof(fd), 1);
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers, const Window& w) {
+        encoder->setBytes(&w.rows, sizeof(w.rows), 0);
+        encoder->setBytes(&w.cols, sizeof(w.cols), 1);
         encoder->setBytes(&sa, sizeof(sa), 2);
-        encoder->setBuffer(buffers[0], 0, 3);
-        encoder->setBytes(&offset_a, sizeof(offset_a), 4);
-        encoder->setBytes(&stride_a, sizeof(stride_a), 5);
-        encoder->setBuffer(buffers[1], 0, 6);
-        encoder->setBytes(&offset, sizeof(offset), 7);
-        encoder->setBytes(&stride, sizeof(stride), 8);
+        setView(encoder, buffers[0], w.views[0], 3);
+        setView(encoder, buffers[1], w.views[1], 6);
       },
       emptyAction);
 }
 
-float* Ferrum::MetalEngine::ge_bbB(Ferrum::FunctionID id, int sd, int fd,
-                                   const float* a, int lena, int offset_a, int stride_a,
-                                   const float* b, int lenb, int offset_b, int stride_b,
-                                   float* result, int len, int offset, int stride) {
-  return call_metal(id, result, len, offset, stride,
+float* Ferrum::MetalEngine::ge_bbB(Ferrum::FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   const float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) {
+  return call_metal(id, KernelShape::GE, sd, fd, {{offset_a, stride_a}, {offset_b, stride_b}, {offset, stride}},
+                    result, 0, len,
       [&]() {
-        MTL::Buffer* bufferA = device->newBuffer(a, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferB = device->newBuffer(b, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferR = device->newBuffer(sizeof(float) * len, MTL::StorageModeShared);
+        MTL::Buffer* bufferA = inputBuffer(a, lena);
+        MTL::Buffer* bufferB = inputBuffer(b, lenb);
+        MTL::Buffer* bufferR = outputBuffer(result, len, offset == 0 && stride == sd);
         return std::vector<MTL::Buffer*>{bufferA, bufferB, bufferR};
       },
-      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
-        encoder->setBytes(&sd, sizeof(sd), 0);
-        encoder->setBytes(&fd, sizeof(fd), 1);
-        encoder->setBuffer(buffers[0], 0, 2);
-        encoder->setBytes(&offset_a, sizeof(offset_a), 3);
-        encoder->setBytes(&stride_a, sizeof(stride_a), 4);
-        encoder->setBuffer(buffers[1], 0, 5);
-        encoder->setBytes(&offset_b, sizeof(offset_b), 6);
-        encoder->setBytes(&stride_b, sizeof(stride_b), 7);
-        encoder->setBuffer(buffers[2], 0, 8);
-        encoder->setBytes(&offset, sizeof(offset), 9);
-        encoder->setBytes(&stride, sizeof(stride), 10);
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers, const Window& w) {
+        encoder->setBytes(&w.rows, sizeof(w.rows), 0);
+        encoder->setBytes(&w.cols, sizeof(w.cols), 1);
+        setView(encoder, buffers[0], w.views[0], 2);
+        setView(encoder, buffers[1], w.views[1], 5);
+        setView(encoder, buffers[2], w.views[2], 8);
       },
       emptyAction);
 }
 
-float* Ferrum::MetalEngine::ge_bBB(Ferrum::FunctionID id, int sd, int fd,
-                                   const float* a, int lena, int offset_a, int stride_a,
-                                   float* b, int lenb, int offset_b, int stride_b,
-                                   float* result, int len, int offset, int stride) {
-  return call_metal(id, result, len, offset, stride,
+float* Ferrum::MetalEngine::ge_bBB(Ferrum::FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) {
+  return call_metal(id, KernelShape::GE, sd, fd, {{offset_a, stride_a}, {offset_b, stride_b}, {offset, stride}},
+                    result, 0, len,
       [&]() {
-        MTL::Buffer* bufferA = device->newBuffer(a, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferB = device->newBuffer(b, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferR = device->newBuffer(sizeof(float) * len, MTL::StorageModeShared);
+        MTL::Buffer* bufferA = inputBuffer(a, lena);
+        MTL::Buffer* bufferB = inputBuffer(b, lenb);
+        MTL::Buffer* bufferR = outputBuffer(result, len, offset == 0 && stride == sd);
         return std::vector<MTL::Buffer*>{bufferA, bufferB, bufferR};
       },
-      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
-        encoder->setBytes(&sd, sizeof(sd), 0);
-        encoder->setBytes(&fd, sizeof(fd), 1);
-        encoder->setBuffer(buffers[0], 0, 2);
-        encoder->setBytes(&offset_a, sizeof(offset_a), 3);
-        encoder->setBytes(&stride_a, sizeof(stride_a), 4);
-        encoder->setBuffer(buffers[1], 0, 5);
-        encoder->setBytes(&offset_b, sizeof(offset_b), 6);
-        encoder->setBytes(&stride_b, sizeof(stride_b), 7);
-        encoder->setBuffer(buffers[2], 0, 8);
-        encoder->setBytes(&offset, sizeof(offset), 9);
-        encoder->setBytes(&stride, sizeof(stride), 10);
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers, const Window& w) {
+        encoder->setBytes(&w.rows, sizeof(w.rows), 0);
+        encoder->setBytes(&w.cols, sizeof(w.cols), 1);
+        setView(encoder, buffers[0], w.views[0], 2);
+        setView(encoder, buffers[1], w.views[1], 5);
+        setView(encoder, buffers[2], w.views[2], 8);
       },
-      [&](std::vector<MTL::Buffer*>& buffers, int len) {
+      [&](std::vector<MTL::Buffer*>& buffers, long len) {
         float* b_result = reinterpret_cast<float*>(buffers[1]->contents());
-        memcpy(b, b_result, sizeof(float) * len);
+        memcpy(b, b_result, sizeof(float) * lenb);
       });
 }
 
-float* Ferrum::MetalEngine::ge_bffffB(Ferrum::FunctionID id, int sd, int fd,
-                                      const float* a, int lena, int offset_a, int stride_a,
+float* Ferrum::MetalEngine::ge_bffffB(Ferrum::FunctionID id, long sd, long fd,
+                                      const float* a, long lena, long offset_a, long stride_a,
                                       float sa, float sha,
                                       float sb, float shb,
-                                      float* result, int len, int offset, int stride) {
-  return call_metal(id, result, len, offset, stride,
+                                      float* result, long len, long offset, long stride) {
+  return call_metal(id, KernelShape::GE, sd, fd, {{offset_a, stride_a}, {offset, stride}},
+                    result, 0, len,
       [&]() {
-        MTL::Buffer* bufferA = device->newBuffer(a, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferR = device->newBuffer(sizeof(float) * len, MTL::StorageModeShared);
+        MTL::Buffer* bufferA = inputBuffer(a, lena);
+        MTL::Buffer* bufferR = outputBuffer(result, len, offset == 0 && stride == sd);
         return std::vector<MTL::Buffer*>{bufferA, bufferR};
       },
-      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
-        encoder->setBytes(&sd, sizeof(sd), 0);
-        encoder->setBytes(&fd, sizeof(fd), 1);
-        encoder->setBuffer(buffers[0], 0, 2);
-        encoder->setBytes(&offset_a, sizeof(offset_a), 3);
-        encoder->setBytes(&stride_a, sizeof(stride_a), 4);
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers, const Window& w) {
+        encoder->setBytes(&w.rows, sizeof(w.rows), 0);
+        encoder->setBytes(&w.cols, sizeof(w.cols), 1);
+        setView(encoder, buffers[0], w.views[0], 2);
         encoder->setBytes(&sa, sizeof(sa), 5);
         encoder->setBytes(&sha, sizeof(sha), 6);
         encoder->setBytes(&sb, sizeof(sb), 7);
         encoder->setBytes(&shb, sizeof(shb), 8);
-        encoder->setBuffer(buffers[1], 0, 9);
-        encoder->setBytes(&offset, sizeof(offset), 10);
-        encoder->setBytes(&stride, sizeof(stride), 11);
+        setView(encoder, buffers[1], w.views[1], 9);
       },
       emptyAction);
 }
 
-float* Ferrum::MetalEngine::ge_bbffffB(Ferrum::FunctionID id, int sd, int fd,
-                                       const float* a, int lena, int offset_a, int stride_a,
-                                       const float* b, int lenb, int offset_b, int stride_b,
+float* Ferrum::MetalEngine::ge_bbffffB(Ferrum::FunctionID id, long sd, long fd,
+                                       const float* a, long lena, long offset_a, long stride_a,
+                                       const float* b, long lenb, long offset_b, long stride_b,
                                        float sa, float sha,
                                        float sb, float shb,
-                                       float* result, int len, int offset, int stride) {
-  return call_metal(id, result, len, offset, stride,
+                                       float* result, long len, long offset, long stride) {
+  return call_metal(id, KernelShape::GE, sd, fd, {{offset_a, stride_a}, {offset_b, stride_b}, {offset, stride}},
+                    result, 0, len,
       [&]() {
-        MTL::Buffer* bufferA = device->newBuffer(a, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferB = device->newBuffer(b, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferR = device->newBuffer(sizeof(float) * len, MTL::StorageModeShared);
+        MTL::Buffer* bufferA = inputBuffer(a, lena);
+        MTL::Buffer* bufferB = inputBuffer(b, lenb);
+        MTL::Buffer* bufferR = outputBuffer(result, len, offset == 0 && stride == sd);
         return std::vector<MTL::Buffer*>{bufferA, bufferB, bufferR};
       },
-      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
-        encoder->setBytes(&sd, sizeof(sd), 0);
-        encoder->setBytes(&fd, sizeof(fd), 1);
-        encoder->setBuffer(buffers[0], 0, 2);
-        encoder->setBytes(&offset_a, sizeof(offset_a), 3);
-        encoder->setBytes(&stride_a, sizeof(stride_a), 4);
-        encoder->setBuffer(buffers[1], 0, 5);
-        encoder->setBytes(&offset_b, sizeof(offset_b), 6);
-        encoder->setBytes(&stride_b, sizeof(stride_b), 7);
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers, const Window& w) {
+        encoder->setBytes(&w.rows, sizeof(w.rows), 0);
+        encoder->setBytes(&w.cols, sizeof(w.cols), 1);
+        setView(encoder, buffers[0], w.views[0], 2);
+        setView(encoder, buffers[1], w.views[1], 5);
         encoder->setBytes(&sa, sizeof(sa), 8);
         encoder->setBytes(&sha, sizeof(sha), 9);
         encoder->setBytes(&sb, sizeof(sb), 10);
         encoder->setBytes(&shb, sizeof(shb), 11);
-        encoder->setBuffer(buffers[2], 0, 12);
-        encoder->setBytes(&offset, sizeof(offset), 13);
-        encoder->setBytes(&stride, sizeof(stride), 14);
+        setView(encoder, buffers[2], w.views[2], 12);
       },
       emptyAction);
 }
 
 // general uplo functions
-float* Ferrum::MetalEngine::uplo_bB(Ferrum::FunctionID id, int sd, int unit, int bottom,
-                                    const float* a, int lena, int offset_a, int stride_a,
-                                    float* result, int len, int offset, int stride) {
-  return call_metal(id, result, len, offset, stride,
+float* Ferrum::MetalEngine::uplo_bB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                    const float* a, long lena, long offset_a, long stride_a,
+                                    float* result, long len, long offset, long stride) {
+  return call_metal(id, KernelShape::UPLO, sd, sd, {{offset_a, stride_a}, {offset, stride}},
+                    result, 0, len,
       [&]() {
-        MTL::Buffer* bufferA = device->newBuffer(a, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferR = device->newBuffer(sizeof(float) * len, MTL::StorageModeShared);
+        MTL::Buffer* bufferA = inputBuffer(a, lena);
+        MTL::Buffer* bufferR = outputBuffer(result, len, false);
         return std::vector<MTL::Buffer*>{bufferA, bufferR};
       },
-      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
-        encoder->setBytes(&sd, sizeof(sd), 0);
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers, const Window& w) {
+        encoder->setBytes(&w.rows, sizeof(w.rows), 0);
         encoder->setBytes(&unit, sizeof(unit), 1);
         encoder->setBytes(&bottom, sizeof(bottom), 2);
-        encoder->setBuffer(buffers[0], 0, 3);
-        encoder->setBytes(&offset_a, sizeof(offset_a), 4);
-        encoder->setBytes(&stride_a, sizeof(stride_a), 5);
-        encoder->setBuffer(buffers[1], 0, 6);
-        encoder->setBytes(&offset, sizeof(offset), 7);
-        encoder->setBytes(&stride, sizeof(stride), 8);
+        setView(encoder, buffers[0], w.views[0], 3);
+        setView(encoder, buffers[1], w.views[1], 6);
       },
       emptyAction);
 }
 
-float* Ferrum::MetalEngine::uplo_bfB(Ferrum::FunctionID id, int sd, int unit, int bottom,
-                                     const float* a, int lena, int offset_a, int stride_a,
+float* Ferrum::MetalEngine::uplo_bfB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
                                      float sa,
-                                     float* result, int len, int offset, int stride) {
-  return call_metal(id, result, len, offset, stride,
+                                     float* result, long len, long offset, long stride) {
+  return call_metal(id, KernelShape::UPLO, sd, sd, {{offset_a, stride_a}, {offset, stride}},
+                    result, 0, len,
       [&]() {
-        MTL::Buffer* bufferA = device->newBuffer(a, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferR = device->newBuffer(sizeof(float) * len, MTL::StorageModeShared);
+        MTL::Buffer* bufferA = inputBuffer(a, lena);
+        MTL::Buffer* bufferR = outputBuffer(result, len, false);
         return std::vector<MTL::Buffer*>{bufferA, bufferR};
       },
-      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
-        encoder->setBytes(&sd, sizeof(sd), 0);
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers, const Window& w) {
+        encoder->setBytes(&w.rows, sizeof(w.rows), 0);
         encoder->setBytes(&unit, sizeof(unit), 1);
         encoder->setBytes(&bottom, sizeof(bottom), 2);
-        encoder->setBuffer(buffers[0], 0, 3);
-        encoder->setBytes(&offset_a, sizeof(offset_a), 4);
-        encoder->setBytes(&stride_a, sizeof(stride_a), 5);
+        setView(encoder, buffers[0], w.views[0], 3);
         encoder->setBytes(&sa, sizeof(sa), 6);
-        encoder->setBuffer(buffers[1], 0, 7);
-        encoder->setBytes(&offset, sizeof(offset), 8);
-        encoder->setBytes(&stride, sizeof(stride), 9);
+        setView(encoder, buffers[1], w.views[1], 7);
       },
       emptyAction);
 }
 
-float* Ferrum::MetalEngine::uplo_fbB(Ferrum::FunctionID id, int sd, int unit, int bottom,
-                                     const float* a, int lena, int offset_a, int stride_a,
+float* Ferrum::MetalEngine::uplo_fbB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
 				     float sa,
-                                     float* result, int len, int offset, int stride) {
-  return call_metal(id, result, len, offset, stride,
+                                     float* result, long len, long offset, long stride) {
+  return call_metal(id, KernelShape::UPLO, sd, sd, {{offset_a, stride_a}, {offset, stride}},
+                    result, 0, len,
       [&]() {
-        MTL::Buffer* bufferA = device->newBuffer(a, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferR = device->newBuffer(sizeof(float) * len, MTL::StorageModeShared);
+        MTL::Buffer* bufferA = inputBuffer(a, lena);
+        MTL::Buffer* bufferR = outputBuffer(result, len, false);
         return std::vector<MTL::Buffer*>{bufferA, bufferR};
       },
-      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
-        encoder->setBytes(&sd, sizeof(sd), 0);
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers, const Window& w) {
+        encoder->setBytes(&w.rows, sizeof(w.rows), 0);
         encoder->setBytes(&unit, sizeof(unit), 1);
         encoder->setBytes(&bottom, sizeof(bottom), 2);
-        encoder->setBuffer(buffers[0], 0, 3);
-        encoder->setBytes(&offset_a, sizeof(offset_a), 4);
-        encoder->setBytes(&stride_a, sizeof(stride_a), 5);
+        setView(encoder, buffers[0], w.views[0], 3);
         encoder->setBytes(&sa, sizeof(sa), 6);
-        encoder->setBuffer(buffers[1], 0, 7);
-        encoder->setBytes(&offset, sizeof(offset), 8);
-        encoder->setBytes(&stride, sizeof(stride), 9);
+        setView(encoder, buffers[1], w.views[1], 7);
       },
       emptyAction);
 }
 
-float* Ferrum::MetalEngine::uplo_bbB(Ferrum::FunctionID id, int sd, int unit, int bottom,
-                                     const float* a, int lena, int offset_a, int stride_a,
-                                     const float* b, int lenb, int offset_b, int stride_b,
-                                     float* result, int len, int offset, int stride) {
-  return call_metal(id, result, len, offset, stride,
+float* Ferrum::MetalEngine::uplo_bbB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     const float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) {
+  return call_metal(id, KernelShape::UPLO, sd, sd, {{offset_a, stride_a}, {offset_b, stride_b}, {offset, stride}},
+                    result, 0, len,
       [&]() {
-        MTL::Buffer* bufferA = device->newBuffer(a, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferB = device->newBuffer(b, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferR = device->newBuffer(sizeof(float) * len, MTL::StorageModeShared);
+        MTL::Buffer* bufferA = inputBuffer(a, lena);
+        MTL::Buffer* bufferB = inputBuffer(b, lenb);
+        MTL::Buffer* bufferR = outputBuffer(result, len, false);
         return std::vector<MTL::Buffer*>{bufferA, bufferB, bufferR};
       },
-      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
-        encoder->setBytes(&sd, sizeof(sd), 0);
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers, const Window& w) {
+        encoder->setBytes(&w.rows, sizeof(w.rows), 0);
         encoder->setBytes(&unit, sizeof(unit), 1);
         encoder->setBytes(&bottom, sizeof(bottom), 2);
-        encoder->setBuffer(buffers[0], 0, 3);
-        encoder->setBytes(&offset_a, sizeof(offset_a), 4);
-        encoder->setBytes(&stride_a, sizeof(stride_a), 5);
-        encoder->setBuffer(buffers[1], 0, 6);
-        encoder->setBytes(&offset_b, sizeof(offset_b), 7);
-        encoder->setBytes(&stride_b, sizeof(stride_b), 8);
-        encoder->setBuffer(buffers[2], 0, 9);
-        encoder->setBytes(&offset, sizeof(offset), 10);
-        encoder->setBytes(&stride, sizeof(stride), 11);
+        setView(encoder, buffers[0], w.views[0], 3);
+        setView(encoder, buffers[1], w.views[1], 6);
+        setView(encoder, buffers[2], w.views[2], 9);
       },
       emptyAction);
 }
 
-float* Ferrum::MetalEngine::uplo_bBB(Ferrum::FunctionID id, int sd, int unit, int bottom,
-                                     const float* a, int lena, int offset_a, int stride_a,
-                                     float* b, int lenb, int offset_b, int stride_b,
-                                     float* result, int len, int offset, int stride) {
-  return call_metal(id, result, len, offset, stride,
+float* Ferrum::MetalEngine::uplo_bBB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) {
+  return call_metal(id, KernelShape::UPLO, sd, sd, {{offset_a, stride_a}, {offset_b, stride_b}, {offset, stride}},
+                    result, 0, len,
       [&]() {
-        MTL::Buffer* bufferA = device->newBuffer(a, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferB = device->newBuffer(b, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferR = device->newBuffer(sizeof(float) * len, MTL::StorageModeShared);
+        MTL::Buffer* bufferA = inputBuffer(a, lena);
+        MTL::Buffer* bufferB = inputBuffer(b, lenb);
+        MTL::Buffer* bufferR = outputBuffer(result, len, false);
         return std::vector<MTL::Buffer*>{bufferA, bufferB, bufferR};
       },
-      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
-        encoder->setBytes(&sd, sizeof(sd), 0);
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers, const Window& w) {
+        encoder->setBytes(&w.rows, sizeof(w.rows), 0);
         encoder->setBytes(&unit, sizeof(unit), 1);
         encoder->setBytes(&bottom, sizeof(bottom), 2);
-        encoder->setBuffer(buffers[0], 0, 3);
-        encoder->setBytes(&offset_a, sizeof(offset_a), 4);
-        encoder->setBytes(&stride_a, sizeof(stride_a), 5);
-        encoder->setBuffer(buffers[1], 0, 6);
-        encoder->setBytes(&offset_b, sizeof(offset_b), 7);
-        encoder->setBytes(&stride_b, sizeof(stride_b), 8);
-        encoder->setBuffer(buffers[2], 0, 9);
-        encoder->setBytes(&offset, sizeof(offset), 10);
-        encoder->setBytes(&stride, sizeof(stride), 11);
+        setView(encoder, buffers[0], w.views[0], 3);
+        setView(encoder, buffers[1], w.views[1], 6);
+        setView(encoder, buffers[2], w.views[2], 9);
       },
-      [&](std::vector<MTL::Buffer*>& buffers, int len) {
+      [&](std::vector<MTL::Buffer*>& buffers, long len) {
         float* b_result = reinterpret_cast<float*>(buffers[1]->contents());
-        memcpy(b, b_result, sizeof(float) * len);
+        memcpy(b, b_result, sizeof(float) * lenb);
       });
 }
 
-float* Ferrum::MetalEngine::uplo_bffffB(Ferrum::FunctionID id, int sd, int unit, int bottom,
-                                        const float* a, int lena, int offset_a, int stride_a,
+float* Ferrum::MetalEngine::uplo_bffffB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                        const float* a, long lena, long offset_a, long stride_a,
                                         float sa, float sha,
                                         float sb, float shb,
-                                        float* result, int len, int offset, int stride) {
-  return call_metal(id, result, len, offset, stride,
+                                        float* result, long len, long offset, long stride) {
+  return call_metal(id, KernelShape::UPLO, sd, sd, {{offset_a, stride_a}, {offset, stride}},
+                    result, 0, len,
       [&]() {
-        MTL::Buffer* bufferA = device->newBuffer(a, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferR = device->newBuffer(sizeof(float) * len, MTL::StorageModeShared);
+        MTL::Buffer* bufferA = inputBuffer(a, lena);
+        MTL::Buffer* bufferR = outputBuffer(result, len, false);
         return std::vector<MTL::Buffer*>{bufferA, bufferR};
       },
-      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
-        encoder->setBytes(&sd, sizeof(sd), 0);
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers, const Window& w) {
+        encoder->setBytes(&w.rows, sizeof(w.rows), 0);
         encoder->setBytes(&unit, sizeof(unit), 1);
         encoder->setBytes(&bottom, sizeof(bottom), 2);
-        encoder->setBuffer(buffers[0], 0, 3);
-        encoder->setBytes(&offset_a, sizeof(offset_a), 4);
-        encoder->setBytes(&stride_a, sizeof(stride_a), 5);
+        setView(encoder, buffers[0], w.views[0], 3);
         encoder->setBytes(&sa, sizeof(sa), 6);
         encoder->setBytes(&sha, sizeof(sha), 7);
         encoder->setBytes(&sb, sizeof(sb), 8);
         encoder->setBytes(&shb, sizeof(shb), 9);
-        encoder->setBuffer(buffers[1], 0, 10);
-        encoder->setBytes(&offset, sizeof(offset), 11);
-        encoder->setBytes(&stride, sizeof(stride), 12);
+        setView(encoder, buffers[1], w.views[1], 10);
       },
       emptyAction);
 }
 
-float* Ferrum::MetalEngine::uplo_bbffffB(Ferrum::FunctionID id, int sd, int unit, int bottom,
-                                         const float* a, int lena, int offset_a, int stride_a,
-                                         const float* b, int lenb, int offset_b, int stride_b,
+float* Ferrum::MetalEngine::uplo_bbffffB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                         const float* a, long lena, long offset_a, long stride_a,
+                                         const float* b, long lenb, long offset_b, long stride_b,
                                          float sa, float sha,
                                          float sb, float shb,
-                                         float* result, int len, int offset, int stride) {
-  return call_metal(id, result, len, offset, stride,
+                                         float* result, long len, long offset, long stride) {
+  return call_metal(id, KernelShape::UPLO, sd, sd, {{offset_a, stride_a}, {offset_b, stride_b}, {offset, stride}},
+                    result, 0, len,
       [&]() {
-        MTL::Buffer* bufferA = device->newBuffer(a, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferB = device->newBuffer(b, sizeof(float) * lena, MTL::StorageModeShared);
-        MTL::Buffer* bufferR = device->newBuffer(sizeof(float) * len, MTL::StorageModeShared);
+        MTL::Buffer* bufferA = inputBuffer(a, lena);
+        MTL::Buffer* bufferB = inputBuffer(b, lenb);
+        MTL::Buffer* bufferR = outputBuffer(result, len, false);
         return std::vector<MTL::Buffer*>{bufferA, bufferB, bufferR};
       },
-      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
-        encoder->setBytes(&sd, sizeof(sd), 0);
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers, const Window& w) {
+        encoder->setBytes(&w.rows, sizeof(w.rows), 0);
         encoder->setBytes(&unit, sizeof(unit), 1);
         encoder->setBytes(&bottom, sizeof(bottom), 2);
-        encoder->setBuffer(buffers[0], 0, 3);
-        encoder->setBytes(&offset_a, sizeof(offset_a), 4);
-        encoder->setBytes(&stride_a, sizeof(stride_a), 5);
-        encoder->setBuffer(buffers[1], 0, 6);
-        encoder->setBytes(&offset_b, sizeof(offset_b), 7);
-        encoder->setBytes(&stride_b, sizeof(stride_b), 8);
+        setView(encoder, buffers[0], w.views[0], 3);
+        setView(encoder, buffers[1], w.views[1], 6);
         encoder->setBytes(&sa, sizeof(sa), 9);
         encoder->setBytes(&sha, sizeof(sha), 10);
         encoder->setBytes(&sb, sizeof(sb), 11);
         encoder->setBytes(&shb, sizeof(shb), 12);
-        encoder->setBuffer(buffers[2], 0, 13);
-        encoder->setBytes(&offset, sizeof(offset), 14);
-        encoder->setBytes(&stride, sizeof(stride), 15);
+        setView(encoder, buffers[2], w.views[2], 13);
       },
       emptyAction);
 }
 
 
+
+// linear algebra functions
+
+// the side of the tiles of C that blas_gemm computes in a threadgroup (TILE in blas.metal)
+static const long GEMM_TILE = 16;
+// the threads in a threadgroup of the matrix-vector kernels
+static const long GEMV_GROUP = 256;
+// the threads in the threadgroup that solves each vector of the triangular solves
+static const long SOLVE_GROUP = 256;
+// the side of the blocks on the diagonal that blas_potrf factors in a threadgroup
+static const long POTRF_BLOCK = 64;
+
+// tests that an sd x fd column major matrix fits in an array, and that the kernel can index it
+static bool fitsIndexed(long sd, long fd, long len, long offset, long ld) {
+  if (sd <= 0 || fd <= 0) {
+    return true;
+  }
+  long last = offset + (sd - 1) + (fd - 1) * ld;
+  return offset >= 0 && ld >= sd && last < len && last <= INDEX_LIMIT;
+}
+
+// tests that n strided elements fit in an array, and that the kernel can index them
+static bool holdsIndexed(long len, long offset, long stride, long n) {
+  return Ferrum::holds(len, offset, stride, n) && (n <= 0 || offset + span(n, stride) - 1 <= INDEX_LIMIT);
+}
+
+float* Ferrum::MetalEngine::gemm(int transA, int transB, long m, long n, long k, float alpha,
+                                 const float* a, long lena, long offset_a, long lda,
+                                 const float* b, long lenb, long offset_b, long ldb,
+                                 float beta, float* c, long lenc, long offset_c, long ldc) {
+  FunctionID id = FunctionID::blas_gemm;
+  if ((transA != NO_TRANS && transA != TRANS) || (transB != NO_TRANS && transB != TRANS)) {
+    std::cerr << "Error: Unknown transpose for function '" << kernelName(id) << "'" << std::endl;
+    return nullptr;
+  }
+  bool ta = transA == TRANS;
+  bool tb = transB == TRANS;
+  if (!(fitsIndexed(ta ? k : m, ta ? m : k, lena, offset_a, lda) &&
+        fitsIndexed(tb ? n : k, tb ? k : n, lenb, offset_b, ldb) &&
+        fitsIndexed(m, n, lenc, offset_c, ldc) && k <= INDEX_LIMIT)) {
+    std::cerr << "Error: Matrix does not fit in its array for function '" << kernelName(id) << "'" << std::endl;
+    return nullptr;
+  }
+  int32_t dims[3] = {static_cast<int32_t>(m), static_cast<int32_t>(n), static_cast<int32_t>(k)};
+  int32_t layout[6] = {static_cast<int32_t>(offset_a), static_cast<int32_t>(lda),
+                       static_cast<int32_t>(offset_b), static_cast<int32_t>(ldb),
+                       static_cast<int32_t>(offset_c), static_cast<int32_t>(ldc)};
+  MTL::Size groups(m <= 0 || n <= 0 ? 0 : (m + GEMM_TILE - 1) / GEMM_TILE, (n + GEMM_TILE - 1) / GEMM_TILE, 1);
+  return call_groups(id, groups, MTL::Size(GEMM_TILE, GEMM_TILE, 1), c, lenc,
+      [&]() {
+        MTL::Buffer* bufferA = inputBuffer(a, lena);
+        MTL::Buffer* bufferB = inputBuffer(b, lenb);
+        MTL::Buffer* bufferC = outputBuffer(c, lenc, false);
+        return std::vector<MTL::Buffer*>{bufferA, bufferB, bufferC};
+      },
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
+        encoder->setBytes(&transA, sizeof(transA), 0);
+        encoder->setBytes(&transB, sizeof(transB), 1);
+        encoder->setBytes(&dims[0], sizeof(int32_t), 2);
+        encoder->setBytes(&dims[1], sizeof(int32_t), 3);
+        encoder->setBytes(&dims[2], sizeof(int32_t), 4);
+        encoder->setBytes(&alpha, sizeof(alpha), 5);
+        encoder->setBuffer(buffers[0], 0, 6);
+        encoder->setBytes(&layout[0], sizeof(int32_t), 7);
+        encoder->setBytes(&layout[1], sizeof(int32_t), 8);
+        encoder->setBuffer(buffers[1], 0, 9);
+        encoder->setBytes(&layout[2], sizeof(int32_t), 10);
+        encoder->setBytes(&layout[3], sizeof(int32_t), 11);
+        encoder->setBytes(&beta, sizeof(beta), 12);
+        encoder->setBuffer(buffers[2], 0, 13);
+        encoder->setBytes(&layout[4], sizeof(int32_t), 14);
+        encoder->setBytes(&layout[5], sizeof(int32_t), 15);
+      });
+}
+
+float* Ferrum::MetalEngine::gemv(int trans, long m, long n, float alpha,
+                                 const float* a, long lena, long offset_a, long lda,
+                                 const float* x, long lenx, long offset_x, long stride_x,
+                                 float beta, float* y, long leny, long offset_y, long stride_y) {
+  if (trans != NO_TRANS && trans != TRANS) {
+    std::cerr << "Error: Unknown transpose for function '" << kernelName(FunctionID::blas_gemv_n) << "'" << std::endl;
+    return nullptr;
+  }
+  bool t = trans == TRANS;
+  FunctionID id = t ? FunctionID::blas_gemv_t : FunctionID::blas_gemv_n;
+  long nx = t ? m : n;
+  long ny = t ? n : m;
+  if (!fitsIndexed(m, n, lena, offset_a, lda)) {
+    std::cerr << "Error: Matrix does not fit in its array for function '" << kernelName(id) << "'" << std::endl;
+    return nullptr;
+  }
+  if (!(holdsIndexed(lenx, offset_x, stride_x, nx) && holdsIndexed(leny, offset_y, stride_y, ny))) {
+    return vectorOutOfBounds(id);
+  }
+  // the kernels index element 0 of each vector at its offset
+  int32_t dims[2] = {static_cast<int32_t>(m), static_cast<int32_t>(n)};
+  int32_t layout[6] = {static_cast<int32_t>(offset_a), static_cast<int32_t>(lda),
+                       static_cast<int32_t>(firstIndex(offset_x, stride_x, nx)), static_cast<int32_t>(stride_x),
+                       static_cast<int32_t>(firstIndex(offset_y, stride_y, ny)), static_cast<int32_t>(stride_y)};
+  // a threadgroup for each element of y when transposed, or a thread for each otherwise
+  MTL::Size groups(ny <= 0 ? 0 : t ? ny : (ny + GEMV_GROUP - 1) / GEMV_GROUP, 1, 1);
+  return call_groups(id, groups, MTL::Size(GEMV_GROUP, 1, 1), y, leny,
+      [&]() {
+        MTL::Buffer* bufferA = inputBuffer(a, lena);
+        MTL::Buffer* bufferX = inputBuffer(x, lenx);
+        MTL::Buffer* bufferY = outputBuffer(y, leny, false);
+        return std::vector<MTL::Buffer*>{bufferA, bufferX, bufferY};
+      },
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
+        encoder->setBytes(&dims[0], sizeof(int32_t), 0);
+        encoder->setBytes(&dims[1], sizeof(int32_t), 1);
+        encoder->setBytes(&alpha, sizeof(alpha), 2);
+        encoder->setBuffer(buffers[0], 0, 3);
+        encoder->setBytes(&layout[0], sizeof(int32_t), 4);
+        encoder->setBytes(&layout[1], sizeof(int32_t), 5);
+        encoder->setBuffer(buffers[1], 0, 6);
+        encoder->setBytes(&layout[2], sizeof(int32_t), 7);
+        encoder->setBytes(&layout[3], sizeof(int32_t), 8);
+        encoder->setBytes(&beta, sizeof(beta), 9);
+        encoder->setBuffer(buffers[2], 0, 10);
+        encoder->setBytes(&layout[4], sizeof(int32_t), 11);
+        encoder->setBytes(&layout[5], sizeof(int32_t), 12);
+      });
+}
+
+float* Ferrum::MetalEngine::ger(long m, long n, float alpha,
+                                const float* x, long lenx, long offset_x, long stride_x,
+                                const float* y, long leny, long offset_y, long stride_y,
+                                float* a, long lena, long offset_a, long lda) {
+  FunctionID id = FunctionID::blas_ger;
+  if (!fitsIndexed(m, n, lena, offset_a, lda)) {
+    std::cerr << "Error: Matrix does not fit in its array for function '" << kernelName(id) << "'" << std::endl;
+    return nullptr;
+  }
+  if (!(holdsIndexed(lenx, offset_x, stride_x, m) && holdsIndexed(leny, offset_y, stride_y, n))) {
+    return vectorOutOfBounds(id);
+  }
+  int32_t dims[2] = {static_cast<int32_t>(m), static_cast<int32_t>(n)};
+  int32_t layout[6] = {static_cast<int32_t>(firstIndex(offset_x, stride_x, m)), static_cast<int32_t>(stride_x),
+                       static_cast<int32_t>(firstIndex(offset_y, stride_y, n)), static_cast<int32_t>(stride_y),
+                       static_cast<int32_t>(offset_a), static_cast<int32_t>(lda)};
+  MTL::Size groups(m <= 0 || n <= 0 ? 0 : (m + GEMM_TILE - 1) / GEMM_TILE, (n + GEMM_TILE - 1) / GEMM_TILE, 1);
+  return call_groups(id, groups, MTL::Size(GEMM_TILE, GEMM_TILE, 1), a, lena,
+      [&]() {
+        MTL::Buffer* bufferX = inputBuffer(x, lenx);
+        MTL::Buffer* bufferY = inputBuffer(y, leny);
+        MTL::Buffer* bufferA = outputBuffer(a, lena, false);
+        return std::vector<MTL::Buffer*>{bufferX, bufferY, bufferA};
+      },
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
+        encoder->setBytes(&dims[0], sizeof(int32_t), 0);
+        encoder->setBytes(&dims[1], sizeof(int32_t), 1);
+        encoder->setBytes(&alpha, sizeof(alpha), 2);
+        encoder->setBuffer(buffers[0], 0, 3);
+        encoder->setBytes(&layout[0], sizeof(int32_t), 4);
+        encoder->setBytes(&layout[1], sizeof(int32_t), 5);
+        encoder->setBuffer(buffers[1], 0, 6);
+        encoder->setBytes(&layout[2], sizeof(int32_t), 7);
+        encoder->setBytes(&layout[3], sizeof(int32_t), 8);
+        encoder->setBuffer(buffers[2], 0, 9);
+        encoder->setBytes(&layout[4], sizeof(int32_t), 10);
+        encoder->setBytes(&layout[5], sizeof(int32_t), 11);
+      });
+}
+
+static float* matrixOutOfBounds(Ferrum::FunctionID id) {
+  std::cerr << "Error: Matrix does not fit in its array for function '" << Ferrum::kernelName(id) << "'" << std::endl;
+  return nullptr;
+}
+
+// Checks the flags of a triangular function, reporting the first that is not known
+static bool triangular(Ferrum::FunctionID id, int side, int trans, int bottom) {
+  if (side != Ferrum::LEFT && side != Ferrum::RIGHT) {
+    std::cerr << "Error: Unknown side for function '" << Ferrum::kernelName(id) << "'" << std::endl;
+    return false;
+  }
+  if (trans != Ferrum::NO_TRANS && trans != Ferrum::TRANS) {
+    std::cerr << "Error: Unknown transpose for function '" << Ferrum::kernelName(id) << "'" << std::endl;
+    return false;
+  }
+  if (bottom == 0) {
+    std::cerr << "Error: No triangle given for function '" << Ferrum::kernelName(id) << "'" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+float* Ferrum::MetalEngine::trmv(int trans, long sd, int unit, int bottom,
+                                 const float* a, long lena, long offset_a, long lda,
+                                 float* x, long lenx, long offset_x, long stride_x) {
+  FunctionID id = FunctionID::blas_trmv;
+  if (!triangular(id, LEFT, trans, bottom)) {
+    return nullptr;
+  }
+  if (!fitsIndexed(sd, sd, lena, offset_a, lda)) {
+    return matrixOutOfBounds(id);
+  }
+  if (!holdsIndexed(lenx, offset_x, stride_x, sd)) {
+    return vectorOutOfBounds(id);
+  }
+  int32_t size = static_cast<int32_t>(sd);
+  int32_t layout[4] = {static_cast<int32_t>(offset_a), static_cast<int32_t>(lda),
+                       static_cast<int32_t>(firstIndex(offset_x, stride_x, sd)), static_cast<int32_t>(stride_x)};
+  MTL::Size groups(sd <= 0 ? 0 : (sd + GEMV_GROUP - 1) / GEMV_GROUP, 1, 1);
+  // x is read from one buffer and written to another
+  return call_groups(id, groups, MTL::Size(GEMV_GROUP, 1, 1), x, lenx,
+      [&]() {
+        MTL::Buffer* bufferA = inputBuffer(a, lena);
+        MTL::Buffer* bufferX = inputBuffer(x, lenx);
+        MTL::Buffer* bufferY = outputBuffer(x, lenx, false);
+        return std::vector<MTL::Buffer*>{bufferA, bufferX, bufferY};
+      },
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
+        encoder->setBytes(&trans, sizeof(trans), 0);
+        encoder->setBytes(&size, sizeof(size), 1);
+        encoder->setBytes(&unit, sizeof(unit), 2);
+        encoder->setBytes(&bottom, sizeof(bottom), 3);
+        encoder->setBuffer(buffers[0], 0, 4);
+        encoder->setBytes(&layout[0], sizeof(int32_t), 5);
+        encoder->setBytes(&layout[1], sizeof(int32_t), 6);
+        encoder->setBuffer(buffers[1], 0, 7);
+        encoder->setBytes(&layout[2], sizeof(int32_t), 8);
+        encoder->setBytes(&layout[3], sizeof(int32_t), 9);
+        encoder->setBuffer(buffers[2], 0, 10);
+        encoder->setBytes(&layout[2], sizeof(int32_t), 11);
+        encoder->setBytes(&layout[3], sizeof(int32_t), 12);
+      });
+}
+
+float* Ferrum::MetalEngine::trsv(int trans, long sd, int unit, int bottom,
+                                 const float* a, long lena, long offset_a, long lda,
+                                 float* x, long lenx, long offset_x, long stride_x) {
+  FunctionID id = FunctionID::blas_trsv;
+  if (!triangular(id, LEFT, trans, bottom)) {
+    return nullptr;
+  }
+  if (!fitsIndexed(sd, sd, lena, offset_a, lda)) {
+    return matrixOutOfBounds(id);
+  }
+  if (!holdsIndexed(lenx, offset_x, stride_x, sd)) {
+    return vectorOutOfBounds(id);
+  }
+  int32_t size = static_cast<int32_t>(sd);
+  int32_t layout[4] = {static_cast<int32_t>(offset_a), static_cast<int32_t>(lda),
+                       static_cast<int32_t>(firstIndex(offset_x, stride_x, sd)), static_cast<int32_t>(stride_x)};
+  // substitution is sequential, so it runs in one threadgroup that synchronizes at each element
+  return call_groups(id, MTL::Size(sd <= 0 ? 0 : 1, 1, 1), MTL::Size(SOLVE_GROUP, 1, 1), x, lenx,
+      [&]() {
+        MTL::Buffer* bufferA = inputBuffer(a, lena);
+        MTL::Buffer* bufferX = outputBuffer(x, lenx, false);
+        return std::vector<MTL::Buffer*>{bufferA, bufferX};
+      },
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
+        encoder->setBytes(&trans, sizeof(trans), 0);
+        encoder->setBytes(&size, sizeof(size), 1);
+        encoder->setBytes(&unit, sizeof(unit), 2);
+        encoder->setBytes(&bottom, sizeof(bottom), 3);
+        encoder->setBuffer(buffers[0], 0, 4);
+        encoder->setBytes(&layout[0], sizeof(int32_t), 5);
+        encoder->setBytes(&layout[1], sizeof(int32_t), 6);
+        encoder->setBuffer(buffers[1], 0, 7);
+        encoder->setBytes(&layout[2], sizeof(int32_t), 8);
+        encoder->setBytes(&layout[3], sizeof(int32_t), 9);
+      });
+}
+
+float* Ferrum::MetalEngine::trmm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                                 const float* a, long lena, long offset_a, long lda,
+                                 float* b, long lenb, long offset_b, long ldb) {
+  FunctionID id = FunctionID::blas_trmm;
+  if (!triangular(id, side, trans, bottom)) {
+    return nullptr;
+  }
+  long sd = side == LEFT ? m : n;
+  if (!(fitsIndexed(sd, sd, lena, offset_a, lda) && fitsIndexed(m, n, lenb, offset_b, ldb))) {
+    return matrixOutOfBounds(id);
+  }
+  int32_t dims[2] = {static_cast<int32_t>(m), static_cast<int32_t>(n)};
+  int32_t layout[4] = {static_cast<int32_t>(offset_a), static_cast<int32_t>(lda),
+                       static_cast<int32_t>(offset_b), static_cast<int32_t>(ldb)};
+  MTL::Size groups(m <= 0 || n <= 0 ? 0 : (m + GEMM_TILE - 1) / GEMM_TILE, (n + GEMM_TILE - 1) / GEMM_TILE, 1);
+  // B is read from one buffer and written to another
+  return call_groups(id, groups, MTL::Size(GEMM_TILE, GEMM_TILE, 1), b, lenb,
+      [&]() {
+        MTL::Buffer* bufferA = inputBuffer(a, lena);
+        MTL::Buffer* bufferB = inputBuffer(b, lenb);
+        MTL::Buffer* bufferC = outputBuffer(b, lenb, false);
+        return std::vector<MTL::Buffer*>{bufferA, bufferB, bufferC};
+      },
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
+        encoder->setBytes(&side, sizeof(side), 0);
+        encoder->setBytes(&trans, sizeof(trans), 1);
+        encoder->setBytes(&dims[0], sizeof(int32_t), 2);
+        encoder->setBytes(&dims[1], sizeof(int32_t), 3);
+        encoder->setBytes(&unit, sizeof(unit), 4);
+        encoder->setBytes(&bottom, sizeof(bottom), 5);
+        encoder->setBytes(&alpha, sizeof(alpha), 6);
+        encoder->setBuffer(buffers[0], 0, 7);
+        encoder->setBytes(&layout[0], sizeof(int32_t), 8);
+        encoder->setBytes(&layout[1], sizeof(int32_t), 9);
+        encoder->setBuffer(buffers[1], 0, 10);
+        encoder->setBytes(&layout[2], sizeof(int32_t), 11);
+        encoder->setBytes(&layout[3], sizeof(int32_t), 12);
+        encoder->setBuffer(buffers[2], 0, 13);
+        encoder->setBytes(&layout[2], sizeof(int32_t), 14);
+        encoder->setBytes(&layout[3], sizeof(int32_t), 15);
+      });
+}
+
+float* Ferrum::MetalEngine::trsm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                                 const float* a, long lena, long offset_a, long lda,
+                                 float* b, long lenb, long offset_b, long ldb) {
+  FunctionID id = FunctionID::blas_trsm;
+  if (!triangular(id, side, trans, bottom)) {
+    return nullptr;
+  }
+  long sd = side == LEFT ? m : n;
+  if (!(fitsIndexed(sd, sd, lena, offset_a, lda) && fitsIndexed(m, n, lenb, offset_b, ldb))) {
+    return matrixOutOfBounds(id);
+  }
+  int32_t dims[2] = {static_cast<int32_t>(m), static_cast<int32_t>(n)};
+  int32_t layout[4] = {static_cast<int32_t>(offset_a), static_cast<int32_t>(lda),
+                       static_cast<int32_t>(offset_b), static_cast<int32_t>(ldb)};
+  // a threadgroup solves each column (left) or row (right) of B
+  MTL::Size groups(m <= 0 || n <= 0 ? 0 : side == LEFT ? n : m, 1, 1);
+  return call_groups(id, groups, MTL::Size(SOLVE_GROUP, 1, 1), b, lenb,
+      [&]() {
+        MTL::Buffer* bufferA = inputBuffer(a, lena);
+        MTL::Buffer* bufferB = outputBuffer(b, lenb, false);
+        return std::vector<MTL::Buffer*>{bufferA, bufferB};
+      },
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
+        encoder->setBytes(&side, sizeof(side), 0);
+        encoder->setBytes(&trans, sizeof(trans), 1);
+        encoder->setBytes(&dims[0], sizeof(int32_t), 2);
+        encoder->setBytes(&dims[1], sizeof(int32_t), 3);
+        encoder->setBytes(&unit, sizeof(unit), 4);
+        encoder->setBytes(&bottom, sizeof(bottom), 5);
+        encoder->setBytes(&alpha, sizeof(alpha), 6);
+        encoder->setBuffer(buffers[0], 0, 7);
+        encoder->setBytes(&layout[0], sizeof(int32_t), 8);
+        encoder->setBytes(&layout[1], sizeof(int32_t), 9);
+        encoder->setBuffer(buffers[1], 0, 10);
+        encoder->setBytes(&layout[2], sizeof(int32_t), 11);
+        encoder->setBytes(&layout[3], sizeof(int32_t), 12);
+      });
+}
+
+float* Ferrum::MetalEngine::syrk(int trans, long n, long k, int bottom, float alpha,
+                                 const float* a, long lena, long offset_a, long lda,
+                                 float beta, float* c, long lenc, long offset_c, long ldc) {
+  FunctionID id = FunctionID::blas_syrk;
+  if (!triangular(id, LEFT, trans, bottom)) {
+    return nullptr;
+  }
+  bool t = trans == TRANS;
+  if (!(fitsIndexed(t ? k : n, t ? n : k, lena, offset_a, lda) && fitsIndexed(n, n, lenc, offset_c, ldc) &&
+        k <= INDEX_LIMIT)) {
+    return matrixOutOfBounds(id);
+  }
+  int32_t dims[2] = {static_cast<int32_t>(n), static_cast<int32_t>(k)};
+  int32_t layout[4] = {static_cast<int32_t>(offset_a), static_cast<int32_t>(lda),
+                       static_cast<int32_t>(offset_c), static_cast<int32_t>(ldc)};
+  MTL::Size groups(n <= 0 ? 0 : (n + GEMM_TILE - 1) / GEMM_TILE, (n + GEMM_TILE - 1) / GEMM_TILE, 1);
+  return call_groups(id, groups, MTL::Size(GEMM_TILE, GEMM_TILE, 1), c, lenc,
+      [&]() {
+        MTL::Buffer* bufferA = inputBuffer(a, lena);
+        MTL::Buffer* bufferC = outputBuffer(c, lenc, false);
+        return std::vector<MTL::Buffer*>{bufferA, bufferC};
+      },
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
+        encoder->setBytes(&trans, sizeof(trans), 0);
+        encoder->setBytes(&dims[0], sizeof(int32_t), 1);
+        encoder->setBytes(&dims[1], sizeof(int32_t), 2);
+        encoder->setBytes(&bottom, sizeof(bottom), 3);
+        encoder->setBytes(&alpha, sizeof(alpha), 4);
+        encoder->setBuffer(buffers[0], 0, 5);
+        encoder->setBytes(&layout[0], sizeof(int32_t), 6);
+        encoder->setBytes(&layout[1], sizeof(int32_t), 7);
+        encoder->setBytes(&beta, sizeof(beta), 8);
+        encoder->setBuffer(buffers[1], 0, 9);
+        encoder->setBytes(&layout[2], sizeof(int32_t), 10);
+        encoder->setBytes(&layout[3], sizeof(int32_t), 11);
+      });
+}
+
+// Encodes blas_trsm with no unit diagonal on a and b, which may be the same buffer
+static void encodeTrsm(MTL::ComputeCommandEncoder* encoder, MTL::ComputePipelineState* pipelineState,
+                       int side, int trans, int32_t m, int32_t n, int bottom,
+                       MTL::Buffer* a, int32_t offset_a, int32_t lda, MTL::Buffer* b, int32_t offset_b, int32_t ldb) {
+  int unit = Ferrum::NON_UNIT;
+  float alpha = 1.0f;
+  encoder->setComputePipelineState(pipelineState);
+  encoder->setBytes(&side, sizeof(side), 0);
+  encoder->setBytes(&trans, sizeof(trans), 1);
+  encoder->setBytes(&m, sizeof(m), 2);
+  encoder->setBytes(&n, sizeof(n), 3);
+  encoder->setBytes(&unit, sizeof(unit), 4);
+  encoder->setBytes(&bottom, sizeof(bottom), 5);
+  encoder->setBytes(&alpha, sizeof(alpha), 6);
+  encoder->setBuffer(a, 0, 7);
+  encoder->setBytes(&offset_a, sizeof(offset_a), 8);
+  encoder->setBytes(&lda, sizeof(lda), 9);
+  encoder->setBuffer(b, 0, 10);
+  encoder->setBytes(&offset_b, sizeof(offset_b), 11);
+  encoder->setBytes(&ldb, sizeof(ldb), 12);
+  encoder->dispatchThreadgroups(MTL::Size(side == Ferrum::LEFT ? n : m, 1, 1), MTL::Size(SOLVE_GROUP, 1, 1));
+}
+
+float* Ferrum::MetalEngine::potrf(long sd, int bottom, float* a, long lena, long offset_a, long lda) {
+  FunctionID id = FunctionID::blas_potrf;
+  if (!triangular(id, LEFT, NO_TRANS, bottom)) {
+    return nullptr;
+  }
+  if (!fitsIndexed(sd, sd, lena, offset_a, lda)) {
+    return matrixOutOfBounds(id);
+  }
+  MTL::ComputePipelineState* factor = pipelineState(id);
+  MTL::ComputePipelineState* solve = pipelineState(FunctionID::blas_trsm);
+  MTL::ComputePipelineState* update = pipelineState(FunctionID::blas_syrk);
+  if (factor == nullptr || solve == nullptr || update == nullptr) {
+    std::cerr << "Error: Failed to find pipeline state for '" << kernelName(id) << "'" << std::endl;
+    return nullptr;
+  }
+  if (sd <= 0) {
+    return a;
+  }
+  bool lower = bottom > 0;
+  int32_t ld = static_cast<int32_t>(lda);
+  // each step factors a block on the diagonal, solves the panel below (or beside) it, and takes
+  // the panel's product from the rest of the matrix, as the host does, all in one command buffer
+  float* result = call_encoded(a, lena,
+      [&]() {
+        return std::vector<MTL::Buffer*>{outputBuffer(a, lena, false)};
+      },
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
+        MTL::Buffer* buffer = buffers[0];
+        for (long j0 = 0; j0 < sd; j0 += POTRF_BLOCK) {
+          int32_t nb = static_cast<int32_t>(std::min(POTRF_BLOCK, sd - j0));
+          int32_t rest = static_cast<int32_t>(sd - j0 - nb);
+          int32_t diagonal = static_cast<int32_t>(offset_a + j0 + j0 * lda);
+          encoder->setComputePipelineState(factor);
+          encoder->setBytes(&nb, sizeof(nb), 0);
+          encoder->setBytes(&bottom, sizeof(bottom), 1);
+          encoder->setBuffer(buffer, 0, 2);
+          encoder->setBytes(&diagonal, sizeof(diagonal), 3);
+          encoder->setBytes(&ld, sizeof(ld), 4);
+          encoder->dispatchThreadgroups(MTL::Size(1, 1, 1), MTL::Size(SOLVE_GROUP, 1, 1));
+          if (rest == 0) {
+            break;
+          }
+          // L21 = A21 * L11^-T, or U12 = U11^-T * A12
+          int32_t panel = lower ? diagonal + nb : diagonal + nb * ld;
+          encodeTrsm(encoder, solve, lower ? RIGHT : LEFT, TRANS, lower ? rest : nb, lower ? nb : rest, bottom,
+                     buffer, diagonal, ld, buffer, panel, ld);
+          // A22 -= L21 * L21^T, or U12^T * U12
+          int trans = lower ? NO_TRANS : TRANS;
+          float alpha = -1.0f;
+          float beta = 1.0f;
+          int32_t trailing = diagonal + nb + nb * ld;
+          encoder->setComputePipelineState(update);
+          encoder->setBytes(&trans, sizeof(trans), 0);
+          encoder->setBytes(&rest, sizeof(rest), 1);
+          encoder->setBytes(&nb, sizeof(nb), 2);
+          encoder->setBytes(&bottom, sizeof(bottom), 3);
+          encoder->setBytes(&alpha, sizeof(alpha), 4);
+          encoder->setBuffer(buffer, 0, 5);
+          encoder->setBytes(&panel, sizeof(panel), 6);
+          encoder->setBytes(&ld, sizeof(ld), 7);
+          encoder->setBytes(&beta, sizeof(beta), 8);
+          encoder->setBuffer(buffer, 0, 9);
+          encoder->setBytes(&trailing, sizeof(trailing), 10);
+          encoder->setBytes(&ld, sizeof(ld), 11);
+          long tiles = (rest + GEMM_TILE - 1) / GEMM_TILE;
+          encoder->dispatchThreadgroups(MTL::Size(tiles, tiles, 1), MTL::Size(GEMM_TILE, GEMM_TILE, 1));
+        }
+      });
+  if (result == nullptr) {
+    return nullptr;
+  }
+  // blas_potrf leaves a diagonal that is not positive as NaN, which spreads to those after it
+  for (long j = 0; j < sd; j++) {
+    if (!(a[offset_a + j + j * lda] > 0.0f)) {
+      std::cerr << "Error: Leading minor " << j + 1 << " is not positive definite for function '"
+                << kernelName(id) << "'" << std::endl;
+      return nullptr;
+    }
+  }
+  return a;
+}
+
+float* Ferrum::MetalEngine::potrs(long sd, long n, int bottom, const float* a, long lena, long offset_a, long lda,
+                                  float* b, long lenb, long offset_b, long ldb) {
+  // the solve is two trsm dispatches, and reports as trsm
+  FunctionID id = FunctionID::blas_trsm;
+  if (!triangular(id, LEFT, NO_TRANS, bottom)) {
+    return nullptr;
+  }
+  if (!(fitsIndexed(sd, sd, lena, offset_a, lda) && fitsIndexed(sd, n, lenb, offset_b, ldb))) {
+    return matrixOutOfBounds(id);
+  }
+  MTL::ComputePipelineState* solve = pipelineState(id);
+  if (solve == nullptr) {
+    std::cerr << "Error: Failed to find pipeline state for '" << kernelName(id) << "'" << std::endl;
+    return nullptr;
+  }
+  if (sd <= 0 || n <= 0) {
+    return b;
+  }
+  bool lower = bottom > 0;
+  int32_t dims[2] = {static_cast<int32_t>(sd), static_cast<int32_t>(n)};
+  int32_t layout[4] = {static_cast<int32_t>(offset_a), static_cast<int32_t>(lda),
+                       static_cast<int32_t>(offset_b), static_cast<int32_t>(ldb)};
+  return call_encoded(b, lenb,
+      [&]() {
+        MTL::Buffer* bufferA = inputBuffer(a, lena);
+        MTL::Buffer* bufferB = outputBuffer(b, lenb, false);
+        return std::vector<MTL::Buffer*>{bufferA, bufferB};
+      },
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
+        // L * L^T * X = B is solved as L * Y = B and then L^T * X = Y, and U^T * U * X = B the other way round
+        for (int trans : {lower ? NO_TRANS : TRANS, lower ? TRANS : NO_TRANS}) {
+          encodeTrsm(encoder, solve, LEFT, trans, dims[0], dims[1], bottom,
+                     buffers[0], layout[0], layout[1], buffers[1], layout[2], layout[3]);
+        }
+      });
+}
+
+// Packed triangles are read with one thread for each packed element (trttp, tpttr) or row (tpmv, spmv)
+
+float* Ferrum::MetalEngine::trttp(long sd, int bottom, const float* a, long lena, long offset_a, long lda,
+                                  float* ap, long lenap, long offset_ap) {
+  FunctionID id = FunctionID::blas_trttp;
+  if (!triangular(id, LEFT, NO_TRANS, bottom)) {
+    return nullptr;
+  }
+  long packed = packedLength(sd);
+  if (!(fitsIndexed(sd, sd, lena, offset_a, lda) && holdsIndexed(lenap, offset_ap, 1, packed))) {
+    return matrixOutOfBounds(id);
+  }
+  int32_t size = static_cast<int32_t>(sd);
+  int32_t layout[3] = {static_cast<int32_t>(offset_a), static_cast<int32_t>(lda), static_cast<int32_t>(offset_ap)};
+  MTL::Size groups((packed + GEMV_GROUP - 1) / GEMV_GROUP, 1, 1);
+  return call_groups(id, groups, MTL::Size(GEMV_GROUP, 1, 1), ap, lenap,
+      [&]() {
+        MTL::Buffer* bufferA = inputBuffer(a, lena);
+        MTL::Buffer* bufferP = outputBuffer(ap, lenap, false);
+        return std::vector<MTL::Buffer*>{bufferA, bufferP};
+      },
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
+        encoder->setBytes(&size, sizeof(size), 0);
+        encoder->setBytes(&bottom, sizeof(bottom), 1);
+        encoder->setBuffer(buffers[0], 0, 2);
+        encoder->setBytes(&layout[0], sizeof(int32_t), 3);
+        encoder->setBytes(&layout[1], sizeof(int32_t), 4);
+        encoder->setBuffer(buffers[1], 0, 5);
+        encoder->setBytes(&layout[2], sizeof(int32_t), 6);
+      });
+}
+
+float* Ferrum::MetalEngine::tpttr(long sd, int bottom, const float* ap, long lenap, long offset_ap,
+                                  float* a, long lena, long offset_a, long lda) {
+  FunctionID id = FunctionID::blas_tpttr;
+  if (!triangular(id, LEFT, NO_TRANS, bottom)) {
+    return nullptr;
+  }
+  long packed = packedLength(sd);
+  if (!(holdsIndexed(lenap, offset_ap, 1, packed) && fitsIndexed(sd, sd, lena, offset_a, lda))) {
+    return matrixOutOfBounds(id);
+  }
+  int32_t size = static_cast<int32_t>(sd);
+  int32_t layout[3] = {static_cast<int32_t>(offset_ap), static_cast<int32_t>(offset_a), static_cast<int32_t>(lda)};
+  MTL::Size groups((packed + GEMV_GROUP - 1) / GEMV_GROUP, 1, 1);
+  // the other triangle of A is kept
+  return call_groups(id, groups, MTL::Size(GEMV_GROUP, 1, 1), a, lena,
+      [&]() {
+        MTL::Buffer* bufferP = inputBuffer(ap, lenap);
+        MTL::Buffer* bufferA = outputBuffer(a, lena, false);
+        return std::vector<MTL::Buffer*>{bufferP, bufferA};
+      },
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
+        encoder->setBytes(&size, sizeof(size), 0);
+        encoder->setBytes(&bottom, sizeof(bottom), 1);
+        encoder->setBuffer(buffers[0], 0, 2);
+        encoder->setBytes(&layout[0], sizeof(int32_t), 3);
+        encoder->setBuffer(buffers[1], 0, 4);
+        encoder->setBytes(&layout[1], sizeof(int32_t), 5);
+        encoder->setBytes(&layout[2], sizeof(int32_t), 6);
+      });
+}
+
+float* Ferrum::MetalEngine::tpmv(int trans, long sd, int unit, int bottom, const float* ap, long lenap,
+                                 long offset_ap, float* x, long lenx, long offset_x, long stride_x) {
+  FunctionID id = FunctionID::blas_tpmv;
+  if (!triangular(id, LEFT, trans, bottom)) {
+    return nullptr;
+  }
+  if (!holdsIndexed(lenap, offset_ap, 1, packedLength(sd))) {
+    return matrixOutOfBounds(id);
+  }
+  if (!holdsIndexed(lenx, offset_x, stride_x, sd)) {
+    return vectorOutOfBounds(id);
+  }
+  int32_t size = static_cast<int32_t>(sd);
+  int32_t layout[3] = {static_cast<int32_t>(offset_ap),
+                       static_cast<int32_t>(firstIndex(offset_x, stride_x, sd)), static_cast<int32_t>(stride_x)};
+  MTL::Size groups(sd <= 0 ? 0 : (sd + GEMV_GROUP - 1) / GEMV_GROUP, 1, 1);
+  // x is read from one buffer and written to another
+  return call_groups(id, groups, MTL::Size(GEMV_GROUP, 1, 1), x, lenx,
+      [&]() {
+        MTL::Buffer* bufferP = inputBuffer(ap, lenap);
+        MTL::Buffer* bufferX = inputBuffer(x, lenx);
+        MTL::Buffer* bufferY = outputBuffer(x, lenx, false);
+        return std::vector<MTL::Buffer*>{bufferP, bufferX, bufferY};
+      },
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
+        encoder->setBytes(&trans, sizeof(trans), 0);
+        encoder->setBytes(&size, sizeof(size), 1);
+        encoder->setBytes(&unit, sizeof(unit), 2);
+        encoder->setBytes(&bottom, sizeof(bottom), 3);
+        encoder->setBuffer(buffers[0], 0, 4);
+        encoder->setBytes(&layout[0], sizeof(int32_t), 5);
+        encoder->setBuffer(buffers[1], 0, 6);
+        encoder->setBytes(&layout[1], sizeof(int32_t), 7);
+        encoder->setBytes(&layout[2], sizeof(int32_t), 8);
+        encoder->setBuffer(buffers[2], 0, 9);
+        encoder->setBytes(&layout[1], sizeof(int32_t), 10);
+        encoder->setBytes(&layout[2], sizeof(int32_t), 11);
+      });
+}
+
+float* Ferrum::MetalEngine::spmv(long sd, int bottom, float alpha, const float* ap, long lenap, long offset_ap,
+                                 const float* x, long lenx, long offset_x, long stride_x,
+                                 float beta, float* y, long leny, long offset_y, long stride_y) {
+  FunctionID id = FunctionID::blas_spmv;
+  if (!triangular(id, LEFT, NO_TRANS, bottom)) {
+    return nullptr;
+  }
+  if (!holdsIndexed(lenap, offset_ap, 1, packedLength(sd))) {
+    return matrixOutOfBounds(id);
+  }
+  if (!(holdsIndexed(lenx, offset_x, stride_x, sd) && holdsIndexed(leny, offset_y, stride_y, sd))) {
+    return vectorOutOfBounds(id);
+  }
+  int32_t size = static_cast<int32_t>(sd);
+  int32_t layout[5] = {static_cast<int32_t>(offset_ap),
+                       static_cast<int32_t>(firstIndex(offset_x, stride_x, sd)), static_cast<int32_t>(stride_x),
+                       static_cast<int32_t>(firstIndex(offset_y, stride_y, sd)), static_cast<int32_t>(stride_y)};
+  MTL::Size groups(sd <= 0 ? 0 : (sd + GEMV_GROUP - 1) / GEMV_GROUP, 1, 1);
+  return call_groups(id, groups, MTL::Size(GEMV_GROUP, 1, 1), y, leny,
+      [&]() {
+        MTL::Buffer* bufferP = inputBuffer(ap, lenap);
+        MTL::Buffer* bufferX = inputBuffer(x, lenx);
+        MTL::Buffer* bufferY = outputBuffer(y, leny, false);
+        return std::vector<MTL::Buffer*>{bufferP, bufferX, bufferY};
+      },
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
+        encoder->setBytes(&size, sizeof(size), 0);
+        encoder->setBytes(&bottom, sizeof(bottom), 1);
+        encoder->setBytes(&alpha, sizeof(alpha), 2);
+        encoder->setBuffer(buffers[0], 0, 3);
+        encoder->setBytes(&layout[0], sizeof(int32_t), 4);
+        encoder->setBuffer(buffers[1], 0, 5);
+        encoder->setBytes(&layout[1], sizeof(int32_t), 6);
+        encoder->setBytes(&layout[2], sizeof(int32_t), 7);
+        encoder->setBytes(&beta, sizeof(beta), 8);
+        encoder->setBuffer(buffers[2], 0, 9);
+        encoder->setBytes(&layout[3], sizeof(int32_t), 10);
+        encoder->setBytes(&layout[4], sizeof(int32_t), 11);
+      });
+}
+
+float* Ferrum::MetalEngine::omatcopy(int trans, long m, long n, float alpha,
+                                     const float* a, long lena, long offset_a, long lda,
+                                     float* b, long lenb, long offset_b, long ldb) {
+  FunctionID id = FunctionID::blas_omatcopy;
+  if (trans != NO_TRANS && trans != TRANS) {
+    std::cerr << "Error: Unknown transpose for function '" << kernelName(id) << "'" << std::endl;
+    return nullptr;
+  }
+  bool t = trans == TRANS;
+  if (!(fitsIndexed(m, n, lena, offset_a, lda) && fitsIndexed(t ? n : m, t ? m : n, lenb, offset_b, ldb))) {
+    return matrixOutOfBounds(id);
+  }
+  int32_t dims[2] = {static_cast<int32_t>(m), static_cast<int32_t>(n)};
+  int32_t layout[4] = {static_cast<int32_t>(offset_a), static_cast<int32_t>(lda),
+                       static_cast<int32_t>(offset_b), static_cast<int32_t>(ldb)};
+  // a threadgroup for each tile of A
+  MTL::Size groups(m <= 0 || n <= 0 ? 0 : (m + GEMM_TILE - 1) / GEMM_TILE, (n + GEMM_TILE - 1) / GEMM_TILE, 1);
+  return call_groups(id, groups, MTL::Size(GEMM_TILE, GEMM_TILE, 1), b, lenb,
+      [&]() {
+        MTL::Buffer* bufferA = inputBuffer(a, lena);
+        MTL::Buffer* bufferB = outputBuffer(b, lenb, false);
+        return std::vector<MTL::Buffer*>{bufferA, bufferB};
+      },
+      [&](MTL::ComputeCommandEncoder* encoder, std::vector<MTL::Buffer*>& buffers) {
+        encoder->setBytes(&trans, sizeof(trans), 0);
+        encoder->setBytes(&dims[0], sizeof(int32_t), 1);
+        encoder->setBytes(&dims[1], sizeof(int32_t), 2);
+        encoder->setBytes(&alpha, sizeof(alpha), 3);
+        encoder->setBuffer(buffers[0], 0, 4);
+        encoder->setBytes(&layout[0], sizeof(int32_t), 5);
+        encoder->setBytes(&layout[1], sizeof(int32_t), 6);
+        encoder->setBuffer(buffers[1], 0, 7);
+        encoder->setBytes(&layout[2], sizeof(int32_t), 8);
+        encoder->setBytes(&layout[3], sizeof(int32_t), 9);
+      });
+}
@@ -0,0 +1,563 @@
+#include "expression.hpp"
+#include "backend.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+
+// The elements in one block of the host program
+static const long BLOCK = 256;
+
+// Relative costs per element, as for the built-in kernels
+static const int CHEAP = 1;
+static const int MEDIUM = 2;
+static const int TRANSCENDENTAL = 5;
+
+struct Ferrum::Expression::Function {
+  const char* name;
+  Code code;
+  int arity;
+  const char* metal;
+  int cost;
+};
+
+const Ferrum::Expression::Function Ferrum::Expression::FUNCTIONS[] = {
+  {"abs", Code::ABS, 1, "fabs", CHEAP}, {"exp", Code::EXP, 1, "exp", TRANSCENDENTAL},
+  {"exp2", Code::EXP2, 1, "exp2", TRANSCENDENTAL}, {"log", Code::LOG, 1, "log", TRANSCENDENTAL},
+  {"log2", Code::LOG2, 1, "log2", TRANSCENDENTAL}, {"log10", Code::LOG10, 1, "log10", TRANSCENDENTAL},
+  {"sqrt", Code::SQRT, 1, "sqrt", MEDIUM}, {"rsqrt", Code::RSQRT, 1, "rsqrt", MEDIUM},
+  {"cbrt", Code::CBRT, 1, "cbrt", TRANSCENDENTAL}, {"sin", Code::SIN, 1, "sin", TRANSCENDENTAL},
+  {"cos", Code::COS, 1, "cos", TRANSCENDENTAL}, {"tan", Code::TAN, 1, "tan", TRANSCENDENTAL},
+  {"asin", Code::ASIN, 1, "asin", TRANSCENDENTAL}, {"acos", Code::ACOS, 1, "acos", TRANSCENDENTAL},
+  {"atan", Code::ATAN, 1, "atan", TRANSCENDENTAL}, {"sinh", Code::SINH, 1, "sinh", TRANSCENDENTAL},
+  {"cosh", Code::COSH, 1, "cosh", TRANSCENDENTAL}, {"tanh", Code::TANH, 1, "tanh", TRANSCENDENTAL},
+  {"floor", Code::FLOOR, 1, "floor", CHEAP}, {"ceil", Code::CEIL, 1, "ceil", CHEAP},
+  {"round", Code::ROUND, 1, "round", CHEAP}, {"trunc", Code::TRUNC, 1, "trunc", CHEAP},
+  {"sigmoid", Code::SIGMOID, 1, nullptr, TRANSCENDENTAL}, {"relu", Code::RELU, 1, nullptr, CHEAP},
+  {"pow", Code::POW, 2, "pow", TRANSCENDENTAL}, {"min", Code::MIN, 2, "fmin", CHEAP},
+  {"max", Code::MAX, 2, "fmax", CHEAP}, {"atan2", Code::ATAN2, 2, "atan2", TRANSCENDENTAL},
+  {"fmod", Code::FMOD, 2, "fmod", MEDIUM}, {"copysign", Code::COPYSIGN, 2, "copysign", CHEAP},
+  {nullptr, Code::A, 0, nullptr, 0}
+};
+
+const Ferrum::Expression::Function* Ferrum::Expression::function(Code code) {
+  for (const Function* f = FUNCTIONS; f->name != nullptr; f++) {
+    if (f->code == code) {
+      return f;
+    }
+  }
+  return nullptr;
+}
+
+// A recursive descent parser, with the usual precedence: ^ binds tightest, and to the right
+class Ferrum::Expression::Parser {
+  public:
+    Parser(Expression& expression) : e(expression), s(expression.text), pos(0), ok(true) {}
+
+    bool parse() {
+      e.root = sum();
+      skip();
+      if (ok && pos < s.size()) {
+        fail(std::string("Unexpected '") + s[pos] + "'");
+      }
+      return ok;
+    }
+
+  private:
+    Expression& e;
+    const std::string& s;
+    size_t pos;
+    bool ok;
+
+    void fail(const std::string& what) {
+      if (ok) {
+        std::cerr << "Error: " << what << " in expression '" << s << "'" << std::endl;
+        ok = false;
+      }
+    }
+
+    void skip() {
+      while (pos < s.size() && std::isspace(static_cast<unsigned char>(s[pos]))) {
+        pos++;
+      }
+    }
+
+    bool next(char c) {
+      skip();
+      if (pos < s.size() && s[pos] == c) {
+        pos++;
+        return true;
+      }
+      return false;
+    }
+
+    int node(Code code, float value, int x, int y) {
+      e.nodes.push_back(Node{code, value, x, y});
+      return static_cast<int>(e.nodes.size()) - 1;
+    }
+
+    int sum() {
+      int x = product();
+      while (ok) {
+        if (next('+')) {
+          x = node(Code::ADD, 0, x, product());
+        } else if (next('-')) {
+          x = node(Code::SUB, 0, x, product());
+        } else {
+          break;
+        }
+      }
+      return x;
+    }
+
+    int product() {
+      int x = unary();
+      while (ok) {
+        if (next('*')) {
+          x = node(Code::MUL, 0, x, unary());
+        } else if (next('/')) {
+          x = node(Code::DIV, 0, x, unary());
+        } else {
+          break;
+        }
+      }
+      return x;
+    }
+
+    int unary() {
+      if (next('-')) {
+        int x = unary();
+        if (ok && e.nodes[x].code == Code::NUMBER) {
+          e.nodes[x].value = -e.nodes[x].value;
+          return x;
+        }
+        return node(Code::NEG, 0, x, -1);
+      }
+      return power();
+    }
+
+    int power() {
+      int x = primary();
+      if (ok && next('^')) {
+        return node(Code::POW, 0, x, unary());
+      }
+      return x;
+    }
+
+    int primary() {
+      if (!ok) {
+        return -1;
+      }
+      if (next('(')) {
+        int x = sum();
+        if (!next(')')) {
+          fail("Missing ')'");
+        }
+        return x;
+      }
+      skip();
+      if (pos >= s.size()) {
+        fail("Unexpected end");
+        return -1;
+      }
+      if (std::isdigit(static_cast<unsigned char>(s[pos])) || s[pos] == '.') {
+        const char* start = s.c_str() + pos;
+        char* end = nullptr;
+        float value = std::strtof(start, &end);
+        if (end == start) {
+          fail("Bad number");
+          return -1;
+        }
+        pos += end - start;
+        return node(Code::NUMBER, value, -1, -1);
+      }
+      size_t first = pos;
+      while (pos < s.size() && (std::isalnum(static_cast<unsigned char>(s[pos])) || s[pos] == '_')) {
+        pos++;
+      }
+      std::string name = s.substr(first, pos - first);
+      if (name.empty()) {
+        fail(std::string("Unexpected '") + s[pos] + "'");
+        return -1;
+      }
+      if (name == "a") {
+        return node(Code::A, 0, -1, -1);
+      }
+      if (name == "b") {
+        e.usesB = true;
+        return node(Code::B, 0, -1, -1);
+      }
+      if (name == "sa") {
+        e.usesSa = true;
+        return node(Code::SA, 0, -1, -1);
+      }
+      if (name == "sha" || name == "sb" || name == "shb") {
+        e.usesShifts = true;
+        return node(name == "sha" ? Code::SHA : (name == "sb" ? Code::SB : Code::SHB), 0, -1, -1);
+      }
+      for (const Function* f = FUNCTIONS; f->name != nullptr; f++) {
+        if (name == f->name) {
+          return call(*f);
+        }
+      }
+      fail("Unknown name '" + name + "'");
+      return -1;
+    }
+
+    int call(const Function& f) {
+      if (!next('(')) {
+        fail(std::string("Missing '(' after ") + f.name);
+        return -1;
+      }
+      int x = sum();
+      int y = -1;
+      if (f.arity == 2) {
+        if (!next(',')) {
+          fail(std::string(f.name) + " takes two arguments");
+          return -1;
+        }
+        y = sum();
+      }
+      if (!next(')')) {
+        fail(std::string("Missing ')' after the arguments of ") + f.name);
+        return -1;
+      }
+      e.weight += f.cost;
+      return node(f.code, 0, x, y);
+    }
+};
+
+Ferrum::Expression* Ferrum::Expression::parse(const std::string& source) {
+  Expression* expression = new Expression();
+  expression->text = source;
+  Parser parser(*expression);
+  if (!parser.parse()) {
+    delete expression;
+    return nullptr;
+  }
+  expression->emit(expression->root, 0);
+  return expression;
+}
+
+int Ferrum::Expression::scalars() const {
+  if (usesShifts || (usesB && usesSa)) {
+    return 4;
+  }
+  return usesSa ? 1 : 0;
+}
+
+// Each node leaves its value in the slot of its depth, so the program needs as many slots
+// as the expression is deep
+void Ferrum::Expression::emit(int index, int depth) {
+  const Node& node = nodes[index];
+  slots = std::max(slots, depth + 1);
+  if (node.x >= 0) {
+    emit(node.x, depth);
+  }
+  if (node.y >= 0) {
+    emit(node.y, depth + 1);
+  }
+  program.push_back(Step{node.code, node.value, depth, node.x >= 0 ? depth : 0, node.y >= 0 ? depth + 1 : 0});
+}
+
+template <typename F>
+static void map1(float* to, const float* x, long n, F f) {
+  for (long i = 0; i < n; i++) {
+    to[i] = f(x[i]);
+  }
+}
+
+template <typename F>
+static void map2(float* to, const float* x, const float* y, long n, F f) {
+  for (long i = 0; i < n; i++) {
+    to[i] = f(x[i], y[i]);
+  }
+}
+
+static void load(float* to, const float* from, long inc, long n) {
+  if (inc == 1) {
+    std::copy(from, from + n, to);
+  } else {
+    for (long i = 0; i < n; i++) {
+      to[i] = from[i * inc];
+    }
+  }
+}
+
+void Ferrum::Expression::run(const Ferrum::Run& run, long n, const Ferrum::Scalars& s) const {
+  thread_local std::vector<float> blocks;
+  if (blocks.size() < static_cast<size_t>(slots * BLOCK)) {
+    blocks.resize(slots * BLOCK);
+  }
+  for (long begin = 0; begin < n; begin += BLOCK) {
+    long count = std::min(BLOCK, n - begin);
+    for (const Step& step : program) {
+      float* to = blocks.data() + step.to * BLOCK;
+      const float* x = blocks.data() + step.x * BLOCK;
+      const float* y = blocks.data() + step.y * BLOCK;
+      switch (step.code) {
+        case Code::A: load(to, run.a + begin * run.inc_a, run.inc_a, count); break;
+        case Code::B: load(to, run.b + begin * run.inc_b, run.inc_b, count); break;
+        case Code::NUMBER: std::fill(to, to + count, step.value); break;
+        case Code::SA: std::fill(to, to + count, s.sa); break;
+        case Code::SHA: std::fill(to, to + count, s.sha); break;
+        case Code::SB: std::fill(to, to + count, s.sb); break;
+        case Code::SHB: std::fill(to, to + count, s.shb); break;
+        case Code::NEG: map1(to, x, count, [](float v) { return -v; }); break;
+        case Code::ADD: map2(to, x, y, count, [](float v, float w) { return v + w; }); break;
+        case Code::SUB: map2(to, x, y, count, [](float v, float w) { return v - w; }); break;
+        case Code::MUL: map2(to, x, y, count, [](float v, float w) { return v * w; }); break;
+        case Code::DIV: map2(to, x, y, count, [](float v, float w) { return v / w; }); break;
+        case Code::POW: map2(to, x, y, count, [](float v, float w) { return std::pow(v, w); }); break;
+        case Code::MIN: map2(to, x, y, count, [](float v, float w) { return std::fmin(v, w); }); break;
+        case Code::MAX: map2(to, x, y, count, [](float v, float w) { return std::fmax(v, w); }); break;
+        case Code::ATAN2: map2(to, x, y, count, [](float v, float w) { return std::atan2(v, w); }); break;
+        case Code::FMOD: map2(to, x, y, count, [](float v, float w) { return std::fmod(v, w); }); break;
+        case Code::COPYSIGN: map2(to, x, y, count, [](float v, float w) { return std::copysign(v, w); }); break;
+        case Code::ABS: map1(to, x, count, [](float v) { return std::fabs(v); }); break;
+        case Code::EXP: map1(to, x, count, [](float v) { return std::exp(v); }); break;
+        case Code::EXP2: map1(to, x, count, [](float v) { return std::exp2(v); }); break;
+        case Code::LOG: map1(to, x, count, [](float v) { return std::log(v); }); break;
+        case Code::LOG2: map1(to, x, count, [](float v) { return std::log2(v); }); break;
+        case Code::LOG10: map1(to, x, count, [](float v) { return std::log10(v); }); break;
+        case Code::SQRT: map1(to, x, count, [](float v) { return std::sqrt(v); }); break;
+        case Code::RSQRT: map1(to, x, count, [](float v) { return 1.0f / std::sqrt(v); }); break;
+        case Code::CBRT: map1(to, x, count, [](float v) { return std::cbrt(v); }); break;
+        case Code::SIN: map1(to, x, count, [](float v) { return std::sin(v); }); break;
+        case Code::COS: map1(to, x, count, [](float v) { return std::cos(v); }); break;
+        case Code::TAN: map1(to, x, count, [](float v) { return std::tan(v); }); break;
+        case Code::ASIN: map1(to, x, count, [](float v) { return std::asin(v); }); break;
+        case Code::ACOS: map1(to, x, count, [](float v) { return std::acos(v); }); break;
+        case Code::ATAN: map1(to, x, count, [](float v) { return std::atan(v); }); break;
+        case Code::SINH: map1(to, x, count, [](float v) { return std::sinh(v); }); break;
+        case Code::COSH: map1(to, x, count, [](float v) { return std::cosh(v); }); break;
+        case Code::TANH: map1(to, x, count, [](float v) { return std::tanh(v); }); break;
+        case Code::FLOOR: map1(to, x, count, [](float v) { return std::floor(v); }); break;
+        case Code::CEIL: map1(to, x, count, [](float v) { return std::ceil(v); }); break;
+        case Code::ROUND: map1(to, x, count, [](float v) { return std::round(v); }); break;
+        case Code::TRUNC: map1(to, x, count, [](float v) { return std::trunc(v); }); break;
+        case Code::SIGMOID: map1(to, x, count, [](float v) { return 1.0f / (1.0f + std::exp(-v)); }); break;
+        case Code::RELU: map1(to, x, count, [](float v) { return std::fmax(v, 0.0f); }); break;
+      }
+    }
+    float* r = run.r + begin * run.inc_r;
+    const float* value = blocks.data();
+    for (long i = 0; i < count; i++) {
+      r[i * run.inc_r] = value[i];
+    }
+  }
+}
+
+static std::string literal(float value) {
+  if (std::isinf(value)) {
+    return value > 0 ? "INFINITY" : "(-INFINITY)";
+  }
+  char text[32];
+  std::snprintf(text, sizeof(text), "%.9g", value);
+  std::string s(text);
+  if (s.find_first_of(".e") == std::string::npos) {
+    s += ".0";
+  }
+  return value < 0 ? "(" + s + "f)" : s + "f";
+}
+
+std::string Ferrum::Expression::metal(int index) const {
+  const Node& node = nodes[index];
+  std::string x = node.x >= 0 ? metal(node.x) : "";
+  std::string y = node.y >= 0 ? metal(node.y) : "";
+  switch (node.code) {
+    case Code::A: return "a";
+    case Code::B: return "b";
+    case Code::NUMBER: return literal(node.value);
+    case Code::SA: return "sa";
+    case Code::SHA: return "sha";
+    case Code::SB: return "sb";
+    case Code::SHB: return "shb";
+    case Code::NEG: return "(-" + x + ")";
+    case Code::ADD: return "(" + x + " + " + y + ")";
+    case Code::SUB: return "(" + x + " - " + y + ")";
+    case Code::MUL: return "(" + x + " * " + y + ")";
+    case Code::DIV: return "(" + x + " / " + y + ")";
+    case Code::SIGMOID: return "(1.0f / (1.0f + exp(-" + x + ")))";
+    case Code::RELU: return "fmax(" + x + ", 0.0f)";
+    default: {
+      const Function* f = function(node.code);
+      return std::string(f->metal) + "(" + x + (node.y >= 0 ? ", " + y : "") + ")";
+    }
+  }
+}
+
+// The mapping of threads onto a triangle that the uplo kernels in vect-math.metal use
+static const char* UPLO_ELEMENT =
+    "static inline uint uplo_threads(int sd) {\n"
+    "    return (uint)sd * (uint)(sd + 1) / 2;\n"
+    "}\n\n"
+    "static inline bool uplo_element(uint k, int sd, int unit, int bottom, thread int& gid_0, thread int& gid_1) {\n"
+    "    if (bottom == 0) {\n"
+    "        if (unit == 132 || k >= (uint)sd * (uint)sd) {\n"
+    "            return false;\n"
+    "        }\n"
+    "        gid_0 = k % sd;\n"
+    "        gid_1 = k / sd;\n"
+    "        return true;\n"
+    "    }\n"
+    "    const int n = unit == 132 ? sd - 1 : sd;\n"
+    "    if (n <= 0 || k >= uplo_threads(n)) {\n"
+    "        return false;\n"
+    "    }\n"
+    "    uint c = (uint)((sqrt(8.0f * k + 1.0f) - 1.0f) * 0.5f);\n"
+    "    while (c * (c + 1) / 2 > k) {\n"
+    "        c--;\n"
+    "    }\n"
+    "    while ((c + 1) * (c + 2) / 2 <= k) {\n"
+    "        c++;\n"
+    "    }\n"
+    "    const int r = k - c * (c + 1) / 2;\n"
+    "    if (bottom < 0) {\n"
+    "        gid_0 = r;\n"
+    "        gid_1 = c + sd - n;\n"
+    "    } else {\n"
+    "        gid_0 = sd - 1 - r;\n"
+    "        gid_1 = n - 1 - c;\n"
+    "    }\n"
+    "    return true;\n"
+    "}\n\n";
+
+std::string Ferrum::Expression::metalSource(const std::string& name, Ferrum::KernelShape shape) const {
+  int index = 0;
+  std::string args;
+  auto arg = [&](const std::string& declaration) {
+    args += (args.empty() ? "" : ",\n    ") + declaration + " [[buffer(" + std::to_string(index++) + ")]]";
+  };
+  // vectors are indexed by a signed stride, and matrices by a leading dimension
+  std::string inc = shape == KernelShape::VECTOR ? "stride_" : "ld_";
+  auto buffer = [&](const std::string& qualifier, const std::string& v) {
+    arg(qualifier + " float* " + v);
+    arg("constant int& offset_" + v);
+    arg("constant int& " + inc + v);
+  };
+  auto element = [&](const std::string& v) {
+    return shape == KernelShape::VECTOR ? v + "[offset_" + v + " + (int)id * stride_" + v + "]"
+                                        : v + "[offset_" + v + " + gid_0 + gid_1 * ld_" + v + "]";
+  };
+
+  if (shape == KernelShape::GE) {
+    arg("constant int& sd");
+    arg("constant int& fd");
+  } else if (shape == KernelShape::UPLO) {
+    arg("constant int& sd");
+    arg("constant int& unit");
+    arg("constant int& bottom");
+  }
+  buffer("const device", "x");
+  if (usesB) {
+    buffer("const device", "y");
+  }
+  if (scalars() >= 1) {
+    arg("constant float& sa");
+  }
+  if (scalars() == 4) {
+    arg("constant float& sha");
+    arg("constant float& sb");
+    arg("constant float& shb");
+  }
+  buffer("device", "z");
+  args += shape == KernelShape::GE ? ",\n    uint2 id [[thread_position_in_grid]]"
+                                   : ",\n    uint id [[thread_position_in_grid]]";
+
+  std::string body = "        const float a = " + element("x") + ";\n";
+  if (usesB) {
+    body += "        const float b = " + element("y") + ";\n";
+  }
+  body += "        " + element("z") + " = " + metal(root) + ";\n";
+
+  std::string source = "#include <metal_stdlib>\nusing namespace metal;\n\n";
+  if (shape == KernelShape::UPLO) {
+    source += UPLO_ELEMENT;
+  }
+  source += "kernel void " + name + " (\n    " + args + ") {\n";
+  switch (shape) {
+    case KernelShape::VECTOR:
+      source += "    {\n" + body + "    }\n";
+      break;
+    case KernelShape::GE:
+      source += "    int gid_0 = id.x;\n    int gid_1 = id.y;\n";
+      source += "    if (gid_0 < sd && gid_1 < fd) {\n" + body + "    }\n";
+      break;
+    case KernelShape::UPLO:
+      source += "    int gid_0, gid_1;\n";
+      source += "    for (uint k = id; uplo_element(k, sd, unit, bottom, gid_0, gid_1); k += uplo_threads(sd)) {\n" +
+                body + "    }\n";
+      break;
+  }
+  return source + "}\n";
+}
+
+// compiled kernels
+
+static std::mutex compiledLock;
+static std::atomic<const Ferrum::CompiledKernel*> compiled[Ferrum::MAX_COMPILED_KERNELS];
+static int compiledCount = 0;
+
+static const char* prefix(Ferrum::KernelShape shape) {
+  switch (shape) {
+    case Ferrum::KernelShape::GE:
+      return "ge_";
+    case Ferrum::KernelShape::UPLO:
+      return "uplo_";
+    default:
+      return "vector_";
+  }
+}
+
+Ferrum::FunctionID Ferrum::compileKernel(const std::string& source, Ferrum::KernelShape shape) {
+  std::lock_guard<std::mutex> guard(compiledLock);
+  for (int i = 0; i < compiledCount; i++) {
+    const CompiledKernel* kernel = compiled[i].load(std::memory_order_relaxed);
+    if (kernel->shape == shape && kernel->expression->source() == source) {
+      return kernel->id;
+    }
+  }
+  if (compiledCount >= MAX_COMPILED_KERNELS) {
+    std::cerr << "Error: Too many compiled kernels for expression '" << source << "'" << std::endl;
+    return FunctionID::UNKNOWN;
+  }
+  Expression* expression = Expression::parse(source);
+  if (expression == nullptr) {
+    return FunctionID::UNKNOWN;
+  }
+  FunctionID id = static_cast<FunctionID>(FUNCTION_COUNT + compiledCount);
+  std::string name = prefix(shape) + std::string("compiled_") + std::to_string(compiledCount);
+  CpuKernel kernel{shape, expression->kind(), nullptr, expression->cost(), expression};
+  compiled[compiledCount].store(new CompiledKernel{id, compiledCount, name, shape, expression, kernel},
+                                std::memory_order_release);
+  compiledCount++;
+  return id;
+}
+
+const Ferrum::CompiledKernel* Ferrum::compiledKernel(Ferrum::FunctionID id) {
+  int index = static_cast<int>(id) - FUNCTION_COUNT;
+  if (index < 0 || index >= MAX_COMPILED_KERNELS) {
+    return nullptr;
+  }
+  return compiled[index].load(std::memory_order_acquire);
+}
+
+const char* Ferrum::kernelName(Ferrum::FunctionID id) {
+  const char* name = functionName(id);
+  if (name != nullptr) {
+    return name;
+  }
+  const CompiledKernel* compiled = compiledKernel(id);
+  return compiled != nullptr ? compiled->name.c_str() : "unknown";
+}
+
+// Backends that dispatch through the host kernel table need nothing more than the kernel
+Ferrum::FunctionID Ferrum::Backend::compile(const std::string& expression, Ferrum::KernelShape shape) {
+  return compileKernel(expression, shape);
+}
@@ -1,186 +1,274 @@
 #include <jni.h>
 #include "ferrum_FerrumEngine.h"
 
+#include "coalescer.hpp"
+#include "cpuengine.hpp"
 #include "engine.hpp"
+#include "split.hpp"
+#include "stream.hpp"
+#include "tuner.hpp"
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
+#include <mutex>
+#include <vector>
 
 #define ILLEGAL_ARG_EX "java/lang/IllegalArgumentException"
 
+// Written exactly once, before any engine is returned to Java, then only read.
+// This keeps dispatch free of locks when many JVM threads share an engine.
 static jfieldID engineFieldID;
+static std::once_flag engineFieldOnce;
 
-JNIEXPORT jlong JNICALL Java_ferrum_FerrumEngine_init(JNIEnv* env, jclass cls, jstring path) {
+// The engine handle held by Java is always a Backend, so that engines can be wrapped
+
+static Ferrum::Backend* newEngine(JNIEnv* env, jclass cls, jstring path, int device = 0) {
   DBG("Initializing engine");
   DBG("Converting path from JVM to C++");
   char* cpath;
   cpath = path ? (char*)env->GetStringUTFChars(path, NULL) : NULL;
   DBG("Converted path");
   DBG("Creating engine");
-  Ferrum::MetalEngine* engine = new Ferrum::MetalEngine(cpath);
+  Ferrum::Backend* engine = new Ferrum::MetalEngine(cpath, Ferrum::MetalEngine::DEFAULT_QUEUE_COUNT, device);
   DBG("Created engine");
-  env->ReleaseStringUTFChars(path, cpath);
-  // This will stay valid while the engine class is loaded. There is no harm is setting it again.
+  if (path) {
+    env->ReleaseStringUTFChars(path, cpath);
+  }
+  // This will stay valid while the engine class is loaded
   DBG("Getting engine field ID, and saving");
-  engineFieldID = env->GetFieldID(cls, "engineHandle", "J");
+  std::call_once(engineFieldOnce, [=]() {
+    engineFieldID = env->GetFieldID(cls, "engineHandle", "J");
+  });
+  return engine;
+}
+
+JNIEXPORT jlong JNICALL Java_ferrum_FerrumEngine_init(JNIEnv* env, jclass cls, jstring path) {
+  Ferrum::Backend* engine = newEngine(env, cls, path);
   DBG("returning engine handle");
   return reinterpret_cast<jlong>(engine);
 }
 
+JNIEXPORT jlong JNICALL Java_ferrum_FerrumEngine_initCoalescing(JNIEnv* env, jclass cls, jstring path,
+                                                                jlong windowMicros, jint maxBatch) {
+  Ferrum::Backend* engine = new Ferrum::Coalescer(newEngine(env, cls, path), windowMicros, maxBatch);
+  DBG("returning coalescing engine handle");
+  return reinterpret_cast<jlong>(engine);
+}
+
+JNIEXPORT jlong JNICALL Java_ferrum_FerrumEngine_initSplit(JNIEnv* env, jclass cls, jstring path) {
+  std::vector<Ferrum::Backend*> backends{newEngine(env, cls, path), new Ferrum::CpuEngine()};
+  Ferrum::Backend* engine = new Ferrum::SplitEngine(backends);
+  DBG("returning split engine handle");
+  return reinterpret_cast<jlong>(engine);
+}
+
+JNIEXPORT jlong JNICALL Java_ferrum_FerrumEngine_initSharded(JNIEnv* env, jclass cls, jstring path) {
+  std::vector<Ferrum::Backend*> backends;
+  int devices = std::max(1, Ferrum::MetalEngine::deviceCount());
+  for (int d = 0; d < devices; d++) {
+    backends.push_back(newEngine(env, cls, path, d));
+  }
+  Ferrum::Backend* engine = new Ferrum::SplitEngine(backends);
+  DBG("returning sharded engine handle");
+  return reinterpret_cast<jlong>(engine);
+}
+
+JNIEXPORT jlong JNICALL Java_ferrum_FerrumEngine_initTuned(JNIEnv* env, jclass cls, jstring path,
+                                                           jstring profilePath) {
+  std::vector<Ferrum::Backend*> backends{newEngine(env, cls, path), new Ferrum::CpuEngine()};
+  std::vector<std::string> names;
+  for (Ferrum::Backend* backend : backends) {
+    names.push_back(backend->name());
+  }
+  const char* cprofile = env->GetStringUTFChars(profilePath, NULL);
+  Ferrum::TuningProfile profile;
+  // a missing or stale profile is measured again, and saved for the next start
+  if (!profile.load(cprofile) || profile.backendNames() != names) {
+    DBG("Calibrating engine");
+    profile = Ferrum::calibrate(backends);
+    profile.save(cprofile);
+  }
+  env->ReleaseStringUTFChars(profilePath, cprofile);
+  Ferrum::Backend* engine = new Ferrum::TunedEngine(backends, profile);
+  DBG("returning tuned engine handle");
+  return reinterpret_cast<jlong>(engine);
+}
+
 JNIEXPORT void JNICALL Java_ferrum_FerrumEngine_close(JNIEnv* env, jclass cls, jlong engine) {
-  Ferrum::MetalEngine* e = reinterpret_cast<Ferrum::MetalEngine*>(engine);
+  Ferrum::Backend* e = reinterpret_cast<Ferrum::Backend*>(engine);
   delete e;
 }
 
 // vector function implementations
 
-template <typename CallWithArgs>
-JNIEXPORT jfloatArray JNICALL vect1(JNIEnv* env, jobject obj, jstring fn,
-                                    jfloatArray a,
-                                    CallWithArgs call) {
+// The elements from the first to the last of n strided elements, in either direction
+static long span(jint n, jint stride) {
+  return n <= 0 ? 0 : (n - 1) * std::abs(static_cast<long>(stride)) + 1;
+}
+
+// Throws if the array cannot hold n elements from the offset, at the stride
+static bool holds(JNIEnv* env, jfloatArray a, jint offset, jint stride, jint n) {
+  if (n < 0 || !Ferrum::holds(env->GetArrayLength(a), offset, stride, n)) {
+    env->ThrowNew(env->FindClass(ILLEGAL_ARG_EX), "Vector does not fit in its array");
+    return false;
+  }
+  return true;
+}
+
+static bool functionID(JNIEnv* env, jstring fn, Ferrum::FunctionID& fnId) {
   const char* cfn = env->GetStringUTFChars(fn, NULL);
-  Ferrum::FunctionID fnId = Ferrum::getFunctionID(cfn);
+  fnId = Ferrum::getFunctionID(cfn);
   if (fnId == Ferrum::FunctionID::UNKNOWN) {
     std::string msg = "Unknown function: " + std::string(cfn);
     env->ReleaseStringUTFChars(fn, cfn);
     env->ThrowNew(env->FindClass(ILLEGAL_ARG_EX), msg.c_str());
-    return NULL;
+    return false;
   }
   env->ReleaseStringUTFChars(fn, cfn);
-  Ferrum::MetalEngine* engine = reinterpret_cast<Ferrum::MetalEngine*>(env->GetLongField(obj, engineFieldID));
-  int len = env->GetArrayLength(a);
-  jfloat *aa = env->GetFloatArrayElements(a, NULL);
-  jfloatArray jresult = env->NewFloatArray(len);
-  jfloat *res = env->GetFloatArrayElements(jresult, NULL);
-  call(engine, fnId, aa, len, res);
-  env->ReleaseFloatArrayElements(a, aa, JNI_ABORT);
-  env->ReleaseFloatArrayElements(jresult, res, 0);
-  return jresult;
+  return true;
 }
 
-enum class ArgSelection { A, B };
-
+// Only the span of each array that the n elements cover is copied out of the JVM, and the
+// result is a new array of n elements. The call sees every span from its first element.
 template <typename CallWithArgs>
-JNIEXPORT jfloatArray JNICALL vect2(JNIEnv* env, jobject obj, jstring fn,
-                                    jfloatArray a, jfloatArray b,
+JNIEXPORT jfloatArray JNICALL vect1(JNIEnv* env, jobject obj, jstring fn, jint n,
+                                    jfloatArray a, jint offset_a, jint stride_a,
                                     CallWithArgs call) {
-  const char* cfn = env->GetStringUTFChars(fn, NULL);
-  Ferrum::FunctionID fnId = Ferrum::getFunctionID(cfn);
-  if (fnId == Ferrum::FunctionID::UNKNOWN) {
-    std::string msg = "Unknown function: " + std::string(cfn);
-    env->ReleaseStringUTFChars(fn, cfn);
-    env->ThrowNew(env->FindClass(ILLEGAL_ARG_EX), msg.c_str());
+  Ferrum::FunctionID fnId;
+  if (!functionID(env, fn, fnId) || !holds(env, a, offset_a, stride_a, n)) {
     return NULL;
   }
-  env->ReleaseStringUTFChars(fn, cfn);
-  Ferrum::MetalEngine* engine = reinterpret_cast<Ferrum::MetalEngine*>(env->GetLongField(obj, engineFieldID));
-  int lena = env->GetArrayLength(a);
-  int lenb = env->GetArrayLength(b);
-  // take on the same shape as the shorter of the two
-  int lenr;
-  ArgSelection args;
-  if (lena < lenb) {
-    lenr = lena;
-    args = ArgSelection::A;
-  } else {
-    lenr = lenb;
-    args = ArgSelection::B;
+  Ferrum::Backend* engine = reinterpret_cast<Ferrum::Backend*>(env->GetLongField(obj, engineFieldID));
+  long lena = span(n, stride_a);
+  std::vector<jfloat> aa(lena);
+  std::vector<jfloat> res(n);
+  env->GetFloatArrayRegion(a, offset_a, lena, aa.data());
+  if (call(engine, fnId, aa.data(), lena, res.data()) == nullptr) {
+    return NULL;
+  }
+  jfloatArray jresult = env->NewFloatArray(n);
+  env->SetFloatArrayRegion(jresult, 0, n, res.data());
+  return jresult;
+}
+
+template <typename CallWithArgs>
+JNIEXPORT jfloatArray JNICALL vect2(JNIEnv* env, jobject obj, jstring fn, jint n,
+                                    jfloatArray a, jint offset_a, jint stride_a,
+                                    jfloatArray b, jint offset_b, jint stride_b,
+                                    bool keepB, CallWithArgs call) {
+  Ferrum::FunctionID fnId;
+  if (!functionID(env, fn, fnId) || !holds(env, a, offset_a, stride_a, n) || !holds(env, b, offset_b, stride_b, n)) {
+    return NULL;
+  }
+  Ferrum::Backend* engine = reinterpret_cast<Ferrum::Backend*>(env->GetLongField(obj, engineFieldID));
+  long lena = span(n, stride_a);
+  long lenb = span(n, stride_b);
+  std::vector<jfloat> aa(lena);
+  std::vector<jfloat> bb(lenb);
+  std::vector<jfloat> res(n);
+  env->GetFloatArrayRegion(a, offset_a, lena, aa.data());
+  env->GetFloatArrayRegion(b, offset_b, lenb, bb.data());
+  if (call(engine, fnId, aa.data(), lena, bb.data(), lenb, res.data()) == nullptr) {
+    return NULL;
   }
-  int len = lena < lenb ? lena : lenb;
-  jfloat *aa = env->GetFloatArrayElements(a, NULL);
-  jfloat *bb = env->GetFloatArrayElements(b, NULL);
-  jfloatArray jresult = env->NewFloatArray(len);
-  jfloat *res = env->GetFloatArrayElements(jresult, NULL);
-  int keep = call(engine, fnId, aa, lena, bb, lenb, res, lenr, args);
-  env->ReleaseFloatArrayElements(a, aa, JNI_ABORT);
-  env->ReleaseFloatArrayElements(b, bb, keep);
-  env->ReleaseFloatArrayElements(jresult, res, 0);
+  // b is also an output of pair functions
+  if (keepB) {
+    env->SetFloatArrayRegion(b, offset_b, lenb, bb.data());
+  }
+  jfloatArray jresult = env->NewFloatArray(n);
+  env->SetFloatArrayRegion(jresult, 0, n, res.data());
   return jresult;
 }
 
 JNIEXPORT jfloatArray JNICALL Java_ferrum_FerrumEngine_vect_1bB
-  (JNIEnv* env, jobject obj, jstring fn, jfloatArray a, jint offset_a, jint stride_a) {
-  return vect1(env, obj, fn, a,
-               [=](Ferrum::MetalEngine* engine, Ferrum::FunctionID fnId, jfloat* a, int len, jfloat* res) {
-                 engine->vect_bB(fnId, a, len, offset_a, stride_a, res, len, offset_a, stride_a);
+  (JNIEnv* env, jobject obj, jstring fn, jint n, jfloatArray a, jint offset_a, jint stride_a) {
+  return vect1(env, obj, fn, n, a, offset_a, stride_a,
+               [=](Ferrum::Backend* engine, Ferrum::FunctionID fnId, jfloat* a, long lena, jfloat* res) {
+                 return engine->vect_bB(fnId, n, a, lena, 0, stride_a, res, n, 0, 1);
                });
 }
 
 JNIEXPORT jfloatArray JNICALL Java_ferrum_FerrumEngine_vect_1bfB
-  (JNIEnv* env, jobject obj, jstring fn, jfloatArray a, jint offset_a, jint stride_a, jfloat sa) {
-  return vect1(env, obj, fn, a,
-               [=](Ferrum::MetalEngine* engine, Ferrum::FunctionID fnId, jfloat* a, int len, jfloat* res) {
-                 engine->vect_bfB(fnId, a, len, offset_a, stride_a, sa, res, len, offset_a, stride_a);
+  (JNIEnv* env, jobject obj, jstring fn, jint n, jfloatArray a, jint offset_a, jint stride_a, jfloat sa) {
+  return vect1(env, obj, fn, n, a, offset_a, stride_a,
+               [=](Ferrum::Backend* engine, Ferrum::FunctionID fnId, jfloat* a, long lena, jfloat* res) {
+                 return engine->vect_bfB(fnId, n, a, lena, 0, stride_a, sa, res, n, 0, 1);
                });
 }
 
 JNIEXPORT jfloatArray JNICALL Java_ferrum_FerrumEngine_vect_1fbB
-  (JNIEnv* env, jobject obj, jstring fn, jfloat sa, jfloatArray a, jint offset_a, jint stride_a) {
-  return vect1(env, obj, fn, a,
-               [=](Ferrum::MetalEngine* engine, Ferrum::FunctionID fnId, jfloat* a, int len, jfloat* res) {
-                 engine->vect_fbB(fnId, sa, a, len, offset_a, stride_a, res, len, offset_a, stride_a);
+  (JNIEnv* env, jobject obj, jstring fn, jint n, jfloat sa, jfloatArray a, jint offset_a, jint stride_a) {
+  return vect1(env, obj, fn, n, a, offset_a, stride_a,
+               [=](Ferrum::Backend* engine, Ferrum::FunctionID fnId, jfloat* a, long lena, jfloat* res) {
+                 return engine->vect_fbB(fnId, n, sa, a, lena, 0, stride_a, res, n, 0, 1);
                });
 }
 
 JNIEXPORT jfloatArray JNICALL Java_ferrum_FerrumEngine_vect_1bbB
-  (JNIEnv* env, jobject obj, jstring fn, jfloatArray a, jint offset_a, jint stride_a, jfloatArray b, jint offset_b, jint stride_b) {
-  return vect2(env, obj, fn, a, b,
-               [=](Ferrum::MetalEngine* engine, Ferrum::FunctionID fnId, jfloat* a, int lena, jfloat* b, int lenb, jfloat* res, int lenr, ArgSelection args) {
-                 int offset, stride;
-                 if (args == ArgSelection::A) {
-                   offset = offset_a;
-                   stride = stride_a;
-                 } else {
-                   offset = offset_b;
-                   stride = stride_b;
-                 }
-                 engine->vect_bbB(fnId, a, lena, offset_a, stride_a, b, lenb, offset_b, stride_b, res, lenr, offset, stride);
-                 return JNI_ABORT;  // free the b array
+  (JNIEnv* env, jobject obj, jstring fn, jint n, jfloatArray a, jint offset_a, jint stride_a, jfloatArray b, jint offset_b, jint stride_b) {
+  return vect2(env, obj, fn, n, a, offset_a, stride_a, b, offset_b, stride_b, false,
+               [=](Ferrum::Backend* engine, Ferrum::FunctionID fnId, jfloat* a, long lena, jfloat* b, long lenb, jfloat* res) {
+                 return engine->vect_bbB(fnId, n, a, lena, 0, stride_a, b, lenb, 0, stride_b, res, n, 0, 1);
                });
 }
 
 JNIEXPORT jfloatArray JNICALL Java_ferrum_FerrumEngine_vect_1bBB
-  (JNIEnv* env, jobject obj, jstring fn, jfloatArray a, jint offset_a, jint stride_a, jfloatArray b, jint offset_b, jint stride_b) {
-  return vect2(env, obj, fn, a, b,
-               [=](Ferrum::MetalEngine* engine, Ferrum::FunctionID fnId, jfloat* a, int lena, jfloat* b, int lenb, jfloat* res, int lenr, ArgSelection args) {
-                 int offset, stride;
-                 if (args == ArgSelection::A) {
-                   offset = offset_a;
-                   stride = stride_a;
-                 } else {
-                   offset = offset_b;
-                   stride = stride_b;
-                 }
-                 engine->vect_bBB(fnId, a, lena, offset_a, stride_a, b, lenb, offset_b, stride_b, res, lenr, offset, stride);
-                 return 0;  // keep the b array
+  (JNIEnv* env, jobject obj, jstring fn, jint n, jfloatArray a, jint offset_a, jint stride_a, jfloatArray b, jint offset_b, jint stride_b) {
+  return vect2(env, obj, fn, n, a, offset_a, stride_a, b, offset_b, stride_b, true,
+               [=](Ferrum::Backend* engine, Ferrum::FunctionID fnId, jfloat* a, long lena, jfloat* b, long lenb, jfloat* res) {
+                 return engine->vect_bBB(fnId, n, a, lena, 0, stride_a, b, lenb, 0, stride_b, res, n, 0, 1);
                });
 }
 
 JNIEXPORT jfloatArray JNICALL Java_ferrum_FerrumEngine_vect_1bffffB
-  (JNIEnv* env, jobject obj, jstring fn, jfloatArray a, jint offset_a, jint stride_a, jfloat sa, jfloat sha, jfloat sb, jfloat shb) {
-  return vect1(env, obj, fn, a,
-               [=](Ferrum::MetalEngine* engine, Ferrum::FunctionID fnId, jfloat* a, int len, jfloat* res) {
-                 engine->vect_bffffB(fnId, a, len, offset_a, stride_a,
-                                     sa, sha, sb, shb,
-                                     res, len, offset_a, stride_a);
+  (JNIEnv* env, jobject obj, jstring fn, jint n, jfloatArray a, jint offset_a, jint stride_a, jfloat sa, jfloat sha, jfloat sb, jfloat shb) {
+  return vect1(env, obj, fn, n, a, offset_a, stride_a,
+               [=](Ferrum::Backend* engine, Ferrum::FunctionID fnId, jfloat* a, long lena, jfloat* res) {
+                 return engine->vect_bffffB(fnId, n, a, lena, 0, stride_a,
+                                            sa, sha, sb, shb,
+                                            res, n, 0, 1);
                });
 }
 
 JNIEXPORT jfloatArray JNICALL Java_ferrum_FerrumEngine_vect_1bbffffB
-  (JNIEnv* env, jobject obj, jstring fn, jfloatArray a, jint offset_a, jint stride_a, jfloatArray b, jint offset_b, jint stride_b,
+  (JNIEnv* env, jobject obj, jstring fn, jint n, jfloatArray a, jint offset_a, jint stride_a, jfloatArray b, jint offset_b, jint stride_b,
    jfloat sa, jfloat sha, jfloat sb, jfloat shb) {
-  return vect2(env, obj, fn, a, b,
-               [=](Ferrum::MetalEngine* engine, Ferrum::FunctionID fnId, jfloat* a, int lena, jfloat* b, int lenb, jfloat* res, int lenr, ArgSelection args) {
-                 int offset, stride;
-                 if (args == ArgSelection::A) {
-                   offset = offset_a;
-                   stride = stride_a;
-                 } else {
-                   offset = offset_b;
-                   stride = stride_b;
-                 }
-                 engine->vect_bbffffB(fnId, a, lena, offset_a, stride_a, b, lenb, offset_b, stride_b,
-                                      sa, sha, sb, shb,
-                                      res, lenr, offset, stride);
-                 return JNI_ABORT;  // free the b array
+  return vect2(env, obj, fn, n, a, offset_a, stride_a, b, offset_b, stride_b, false,
+               [=](Ferrum::Backend* engine, Ferrum::FunctionID fnId, jfloat* a, long lena, jfloat* b, long lenb, jfloat* res) {
+                 return engine->vect_bbffffB(fnId, n, a, lena, 0, stride_a, b, lenb, 0, stride_b,
+                                             sa, sha, sb, shb,
+                                             res, n, 0, 1);
                });
 }
 
+
+// streaming over files
+
+static bool streamFiles(JNIEnv* env, jobject obj, jstring fn, jstring a, jstring b, jstring output) {
+  Ferrum::FunctionID fnId;
+  if (!functionID(env, fn, fnId)) {
+    return false;
+  }
+  Ferrum::Backend* engine = reinterpret_cast<Ferrum::Backend*>(env->GetLongField(obj, engineFieldID));
+  const char* ca = env->GetStringUTFChars(a, NULL);
+  const char* cb = b ? env->GetStringUTFChars(b, NULL) : NULL;
+  const char* cout = env->GetStringUTFChars(output, NULL);
+  Ferrum::Streamer streamer(engine);
+  bool ok = cb ? streamer.stream_bbB(fnId, ca, cb, cout) : streamer.stream_bB(fnId, ca, cout);
+  env->ReleaseStringUTFChars(a, ca);
+  if (cb) {
+    env->ReleaseStringUTFChars(b, cb);
+  }
+  env->ReleaseStringUTFChars(output, cout);
+  return ok;
+}
+
+JNIEXPORT jboolean JNICALL Java_ferrum_FerrumEngine_stream_1bB
+  (JNIEnv* env, jobject obj, jstring fn, jstring input, jstring output) {
+  return streamFiles(env, obj, fn, input, NULL, output) ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jboolean JNICALL Java_ferrum_FerrumEngine_stream_1bbB
+  (JNIEnv* env, jobject obj, jstring fn, jstring a, jstring b, jstring output) {
+  return streamFiles(env, obj, fn, a, b, output) ? JNI_TRUE : JNI_FALSE;
+}
@@ -2,213 +2,217 @@
 
 #include "functions.hpp"
 
-#include <unordered_map>
-
+// Every name finds its own id, as this file compiles
 namespace Ferrum {
-  std::unordered_map<std::string, FunctionID>* functionMap;
-
-  __attribute__((constructor)) void initFunctionMap() {
-    functionMap = new std::unordered_map<std::string, FunctionID>();
-    std::unordered_map<std::string, FunctionID>& fnMap = *functionMap;
-    fnMap["ge_abs"] = ge_abs;
-    fnMap["ge_acos"] = ge_acos;
-    fnMap["ge_acosh"] = ge_acosh;
-    fnMap["ge_add"] = ge_add;
-    fnMap["ge_asin"] = ge_asin;
-    fnMap["ge_asinh"] = ge_asinh;
-    fnMap["ge_atan"] = ge_atan;
-    fnMap["ge_atan2"] = ge_atan2;
-    fnMap["ge_atanh"] = ge_atanh;
-    fnMap["ge_cbrt"] = ge_cbrt;
-    fnMap["ge_cdf_norm"] = ge_cdf_norm;
-    fnMap["ge_cdf_norm_inv"] = ge_cdf_norm_inv;
-    fnMap["ge_ceil"] = ge_ceil;
-    fnMap["ge_copysign"] = ge_copysign;
-    fnMap["ge_cos"] = ge_cos;
-    fnMap["ge_cosh"] = ge_cosh;
-    fnMap["ge_div"] = ge_div;
-    fnMap["ge_elu"] = ge_elu;
-    fnMap["ge_erf"] = ge_erf;
-    fnMap["ge_erf_inv"] = ge_erf_inv;
-    fnMap["ge_erfc"] = ge_erfc;
-    fnMap["ge_erfcinv"] = ge_erfcinv;
-    fnMap["ge_exp"] = ge_exp;
-    fnMap["ge_exp10"] = ge_exp10;
-    fnMap["ge_exp2"] = ge_exp2;
-    fnMap["ge_expm1"] = ge_expm1;
-    fnMap["ge_floor"] = ge_floor;
-    fnMap["ge_fmax"] = ge_fmax;
-    fnMap["ge_fmin"] = ge_fmin;
-    fnMap["ge_fmod"] = ge_fmod;
-    fnMap["ge_frac"] = ge_frac;
-    fnMap["ge_frem"] = ge_frem;
-    fnMap["ge_gamma"] = ge_gamma;
-    fnMap["ge_hypot"] = ge_hypot;
-    fnMap["ge_inv"] = ge_inv;
-    fnMap["ge_inv_cbrt"] = ge_inv_cbrt;
-    fnMap["ge_inv_sqrt"] = ge_inv_sqrt;
-    fnMap["ge_lgamma"] = ge_lgamma;
-    fnMap["ge_linear_frac"] = ge_linear_frac;
-    fnMap["ge_log"] = ge_log;
-    fnMap["ge_log10"] = ge_log10;
-    fnMap["ge_log1p"] = ge_log1p;
-    fnMap["ge_log2"] = ge_log2;
-    fnMap["ge_modf"] = ge_modf;
-    fnMap["ge_mul"] = ge_mul;
-    fnMap["ge_pow"] = ge_pow;
-    fnMap["ge_pow2o3"] = ge_pow2o3;
-    fnMap["ge_pow3o2"] = ge_pow3o2;
-    fnMap["ge_powx"] = ge_powx;
-    fnMap["ge_ramp"] = ge_ramp;
-    fnMap["ge_relu"] = ge_relu;
-    fnMap["ge_round"] = ge_round;
-    fnMap["ge_scale_shift"] = ge_scale_shift;
-    fnMap["ge_sigmoid"] = ge_sigmoid;
-    fnMap["ge_sin"] = ge_sin;
-    fnMap["ge_sincos"] = ge_sincos;
-    fnMap["ge_sinh"] = ge_sinh;
-    fnMap["ge_sqr"] = ge_sqr;
-    fnMap["ge_sqrt"] = ge_sqrt;
-    fnMap["ge_sub"] = ge_sub;
-    fnMap["ge_tan"] = ge_tan;
-    fnMap["ge_tanh"] = ge_tanh;
-    fnMap["ge_trunc"] = ge_trunc;
-    fnMap["uplo_abs"] = uplo_abs;
-    fnMap["uplo_acos"] = uplo_acos;
-    fnMap["uplo_acosh"] = uplo_acosh;
-    fnMap["uplo_add"] = uplo_add;
-    fnMap["uplo_asin"] = uplo_asin;
-    fnMap["uplo_asinh"] = uplo_asinh;
-    fnMap["uplo_atan"] = uplo_atan;
-    fnMap["uplo_atan2"] = uplo_atan2;
-    fnMap["uplo_atanh"] = uplo_atanh;
-    fnMap["uplo_cbrt"] = uplo_cbrt;
-    fnMap["uplo_cdf_norm"] = uplo_cdf_norm;
-    fnMap["uplo_cdf_norm_inv"] = uplo_cdf_norm_inv;
-    fnMap["uplo_ceil"] = uplo_ceil;
-    fnMap["uplo_copysign"] = uplo_copysign;
-    fnMap["uplo_cos"] = uplo_cos;
-    fnMap["uplo_cosh"] = uplo_cosh;
-    fnMap["uplo_div"] = uplo_div;
-    fnMap["uplo_elu"] = uplo_elu;
-    fnMap["uplo_erf"] = uplo_erf;
-    fnMap["uplo_erf_inv"] = uplo_erf_inv;
-    fnMap["uplo_erfc"] = uplo_erfc;
-    fnMap["uplo_erfc_inv"] = uplo_erfc_inv;
-    fnMap["uplo_exp"] = uplo_exp;
-    fnMap["uplo_exp10"] = uplo_exp10;
-    fnMap["uplo_exp2"] = uplo_exp2;
-    fnMap["uplo_expm1"] = uplo_expm1;
-    fnMap["uplo_floor"] = uplo_floor;
-    fnMap["uplo_fmax"] = uplo_fmax;
-    fnMap["uplo_fmin"] = uplo_fmin;
-    fnMap["uplo_fmod"] = uplo_fmod;
-    fnMap["uplo_frac"] = uplo_frac;
-    fnMap["uplo_frem"] = uplo_frem;
-    fnMap["uplo_gamma"] = uplo_gamma;
-    fnMap["uplo_hypot"] = uplo_hypot;
-    fnMap["uplo_inv"] = uplo_inv;
-    fnMap["uplo_inv_cbrt"] = uplo_inv_cbrt;
-    fnMap["uplo_inv_sqrt"] = uplo_inv_sqrt;
-    fnMap["uplo_lgamma"] = uplo_lgamma;
-    fnMap["uplo_linear_frac"] = uplo_linear_frac;
-    fnMap["uplo_log"] = uplo_log;
-    fnMap["uplo_log10"] = uplo_log10;
-    fnMap["uplo_log1p"] = uplo_log1p;
-    fnMap["uplo_log2"] = uplo_log2;
-    fnMap["uplo_modf"] = uplo_modf;
-    fnMap["uplo_mul"] = uplo_mul;
-    fnMap["uplo_pow"] = uplo_pow;
-    fnMap["uplo_pow2o3"] = uplo_pow2o3;
-    fnMap["uplo_pow3o2"] = uplo_pow3o2;
-    fnMap["uplo_powx"] = uplo_powx;
-    fnMap["uplo_ramp"] = uplo_ramp;
-    fnMap["uplo_relu"] = uplo_relu;
-    fnMap["uplo_round"] = uplo_round;
-    fnMap["uplo_scale_shift"] = uplo_scale_shift;
-    fnMap["uplo_sigmoid"] = uplo_sigmoid;
-    fnMap["uplo_sin"] = uplo_sin;
-    fnMap["uplo_sincos"] = uplo_sincos;
-    fnMap["uplo_sinh"] = uplo_sinh;
-    fnMap["uplo_sqr"] = uplo_sqr;
-    fnMap["uplo_sqrt"] = uplo_sqrt;
-    fnMap["uplo_sub"] = uplo_sub;
-    fnMap["uplo_tan"] = uplo_tan;
-    fnMap["uplo_tanh"] = uplo_tanh;
-    fnMap["uplo_trunc"] = uplo_trunc;
-    fnMap["vector_abs"] = vector_abs;
-    fnMap["vector_acos"] = vector_acos;
-    fnMap["vector_acosh"] = vector_acosh;
-    fnMap["vector_add"] = vector_add;
-    fnMap["vector_asin"] = vector_asin;
-    fnMap["vector_asinh"] = vector_asinh;
-    fnMap["vector_atan"] = vector_atan;
-    fnMap["vector_atan2"] = vector_atan2;
-    fnMap["vector_atanh"] = vector_atanh;
-    fnMap["vector_cbrt"] = vector_cbrt;
-    fnMap["vector_cdf_norm"] = vector_cdf_norm;
-    fnMap["vector_cdf_norm_inv"] = vector_cdf_norm_inv;
-    fnMap["vector_ceil"] = vector_ceil;
-    fnMap["vector_copy"] = vector_copy;
-    fnMap["vector_copysign"] = vector_copysign;
-    fnMap["vector_cos"] = vector_cos;
-    fnMap["vector_cosh"] = vector_cosh;
-    fnMap["vector_div"] = vector_div;
-    fnMap["vector_elu"] = vector_elu;
-    fnMap["vector_equals"] = vector_equals;
-    fnMap["vector_erf"] = vector_erf;
-    fnMap["vector_erf_inv"] = vector_erf_inv;
-    fnMap["vector_erfc"] = vector_erfc;
-    fnMap["vector_erfc_inv"] = vector_erfc_inv;
-    fnMap["vector_exp"] = vector_exp;
-    fnMap["vector_exp10"] = vector_exp10;
-    fnMap["vector_exp2"] = vector_exp2;
-    fnMap["vector_expm1"] = vector_expm1;
-    fnMap["vector_floor"] = vector_floor;
-    fnMap["vector_fmax"] = vector_fmax;
-    fnMap["vector_fmin"] = vector_fmin;
-    fnMap["vector_fmod"] = vector_fmod;
-    fnMap["vector_frac"] = vector_frac;
-    fnMap["vector_frem"] = vector_frem;
-    fnMap["vector_gamma"] = vector_gamma;
-    fnMap["vector_hypot"] = vector_hypot;
-    fnMap["vector_inv"] = vector_inv;
-    fnMap["vector_inv_cbrt"] = vector_inv_cbrt;
-    fnMap["vector_inv_sqrt"] = vector_inv_sqrt;
-    fnMap["vector_lgamma"] = vector_lgamma;
-    fnMap["vector_linear_frac"] = vector_linear_frac;
-    fnMap["vector_log"] = vector_log;
-    fnMap["vector_log10"] = vector_log10;
-    fnMap["vector_log1p"] = vector_log1p;
-    fnMap["vector_log2"] = vector_log2;
-    fnMap["vector_modf"] = vector_modf;
-    fnMap["vector_mul"] = vector_mul;
-    fnMap["vector_pow"] = vector_pow;
-    fnMap["vector_pow2o3"] = vector_pow2o3;
-    fnMap["vector_pow3o2"] = vector_pow3o2;
-    fnMap["vector_powx"] = vector_powx;
-    fnMap["vector_ramp"] = vector_ramp;
-    fnMap["vector_relu"] = vector_relu;
-    fnMap["vector_round"] = vector_round;
-    fnMap["vector_scale_shift"] = vector_scale_shift;
-    fnMap["vector_set"] = vector_set;
-    fnMap["vector_sigmoid"] = vector_sigmoid;
-    fnMap["vector_sin"] = vector_sin;
-    fnMap["vector_sincos"] = vector_sincos;
-    fnMap["vector_sinh"] = vector_sinh;
-    fnMap["vector_sqr"] = vector_sqr;
-    fnMap["vector_sqrt"] = vector_sqrt;
-    fnMap["vector_sub"] = vector_sub;
-    fnMap["vector_swap"] = vector_swap;
-    fnMap["vector_tan"] = vector_tan;
-    fnMap["vector_tanh"] = vector_tanh;
-    fnMap["vector_trunc"] = vector_trunc;
-  }
-
-  __attribute__((destructor)) void cleanupFunctionMap() {
-    delete functionMap;
-    functionMap = nullptr;
-  }
-
+  static_assert(functionID("blas_gemm") == blas_gemm);
+  static_assert(functionID("blas_gemv_n") == blas_gemv_n);
+  static_assert(functionID("blas_gemv_t") == blas_gemv_t);
+  static_assert(functionID("blas_ger") == blas_ger);
+  static_assert(functionID("blas_omatcopy") == blas_omatcopy);
+  static_assert(functionID("blas_potrf") == blas_potrf);
+  static_assert(functionID("blas_spmv") == blas_spmv);
+  static_assert(functionID("blas_syrk") == blas_syrk);
+  static_assert(functionID("blas_tpmv") == blas_tpmv);
+  static_assert(functionID("blas_tpttr") == blas_tpttr);
+  static_assert(functionID("blas_trmm") == blas_trmm);
+  static_assert(functionID("blas_trmv") == blas_trmv);
+  static_assert(functionID("blas_trsm") == blas_trsm);
+  static_assert(functionID("blas_trsv") == blas_trsv);
+  static_assert(functionID("blas_trttp") == blas_trttp);
+  static_assert(functionID("ge_abs") == ge_abs);
+  static_assert(functionID("ge_acos") == ge_acos);
+  static_assert(functionID("ge_acosh") == ge_acosh);
+  static_assert(functionID("ge_add") == ge_add);
+  static_assert(functionID("ge_asin") == ge_asin);
+  static_assert(functionID("ge_asinh") == ge_asinh);
+  static_assert(functionID("ge_atan") == ge_atan);
+  static_assert(functionID("ge_atan2") == ge_atan2);
+  static_assert(functionID("ge_atanh") == ge_atanh);
+  static_assert(functionID("ge_cbrt") == ge_cbrt);
+  static_assert(functionID("ge_cdf_norm") == ge_cdf_norm);
+  static_assert(functionID("ge_cdf_norm_inv") == ge_cdf_norm_inv);
+  static_assert(functionID("ge_ceil") == ge_ceil);
+  static_assert(functionID("ge_copysign") == ge_copysign);
+  static_assert(functionID("ge_cos") == ge_cos);
+  static_assert(functionID("ge_cosh") == ge_cosh);
+  static_assert(functionID("ge_div") == ge_div);
+  static_assert(functionID("ge_elu") == ge_elu);
+  static_assert(functionID("ge_erf") == ge_erf);
+  static_assert(functionID("ge_erf_inv") == ge_erf_inv);
+  static_assert(functionID("ge_erfc") == ge_erfc);
+  static_assert(functionID("ge_erfcinv") == ge_erfcinv);
+  static_assert(functionID("ge_exp") == ge_exp);
+  static_assert(functionID("ge_exp10") == ge_exp10);
+  static_assert(functionID("ge_exp2") == ge_exp2);
+  static_assert(functionID("ge_expm1") == ge_expm1);
+  static_assert(functionID("ge_floor") == ge_floor);
+  static_assert(functionID("ge_fmax") == ge_fmax);
+  static_assert(functionID("ge_fmin") == ge_fmin);
+  static_assert(functionID("ge_fmod") == ge_fmod);
+  static_assert(functionID("ge_frac") == ge_frac);
+  static_assert(functionID("ge_frem") == ge_frem);
+  static_assert(functionID("ge_gamma") == ge_gamma);
+  static_assert(functionID("ge_hypot") == ge_hypot);
+  static_assert(functionID("ge_inv") == ge_inv);
+  static_assert(functionID("ge_inv_cbrt") == ge_inv_cbrt);
+  static_assert(functionID("ge_inv_sqrt") == ge_inv_sqrt);
+  static_assert(functionID("ge_lgamma") == ge_lgamma);
+  static_assert(functionID("ge_linear_frac") == ge_linear_frac);
+  static_assert(functionID("ge_log") == ge_log);
+  static_assert(functionID("ge_log10") == ge_log10);
+  static_assert(functionID("ge_log1p") == ge_log1p);
+  static_assert(functionID("ge_log2") == ge_log2);
+  static_assert(functionID("ge_modf") == ge_modf);
+  static_assert(functionID("ge_mul") == ge_mul);
+  static_assert(functionID("ge_pow") == ge_pow);
+  static_assert(functionID("ge_pow2o3") == ge_pow2o3);
+  static_assert(functionID("ge_pow3o2") == ge_pow3o2);
+  static_assert(functionID("ge_powx") == ge_powx);
+  static_assert(functionID("ge_ramp") == ge_ramp);
+  static_assert(functionID("ge_relu") == ge_relu);
+  static_assert(functionID("ge_round") == ge_round);
+  static_assert(functionID("ge_scale_shift") == ge_scale_shift);
+  static_assert(functionID("ge_sigmoid") == ge_sigmoid);
+  static_assert(functionID("ge_sin") == ge_sin);
+  static_assert(functionID("ge_sincos") == ge_sincos);
+  static_assert(functionID("ge_sinh") == ge_sinh);
+  static_assert(functionID("ge_sqr") == ge_sqr);
+  static_assert(functionID("ge_sqrt") == ge_sqrt);
+  static_assert(functionID("ge_sub") == ge_sub);
+  static_assert(functionID("ge_tan") == ge_tan);
+  static_assert(functionID("ge_tanh") == ge_tanh);
+  static_assert(functionID("ge_trunc") == ge_trunc);
+  static_assert(functionID("uplo_abs") == uplo_abs);
+  static_assert(functionID("uplo_acos") == uplo_acos);
+  static_assert(functionID("uplo_acosh") == uplo_acosh);
+  static_assert(functionID("uplo_add") == uplo_add);
+  static_assert(functionID("uplo_asin") == uplo_asin);
+  static_assert(functionID("uplo_asinh") == uplo_asinh);
+  static_assert(functionID("uplo_atan") == uplo_atan);
+  static_assert(functionID("uplo_atan2") == uplo_atan2);
+  static_assert(functionID("uplo_atanh") == uplo_atanh);
+  static_assert(functionID("uplo_cbrt") == uplo_cbrt);
+  static_assert(functionID("uplo_cdf_norm") == uplo_cdf_norm);
+  static_assert(functionID("uplo_cdf_norm_inv") == uplo_cdf_norm_inv);
+  static_assert(functionID("uplo_ceil") == uplo_ceil);
+  static_assert(functionID("uplo_copysign") == uplo_copysign);
+  static_assert(functionID("uplo_cos") == uplo_cos);
+  static_assert(functionID("uplo_cosh") == uplo_cosh);
+  static_assert(functionID("uplo_div") == uplo_div);
+  static_assert(functionID("uplo_elu") == uplo_elu);
+  static_assert(functionID("uplo_erf") == uplo_erf);
+  static_assert(functionID("uplo_erf_inv") == uplo_erf_inv);
+  static_assert(functionID("uplo_erfc") == uplo_erfc);
+  static_assert(functionID("uplo_erfc_inv") == uplo_erfc_inv);
+  static_assert(functionID("uplo_exp") == uplo_exp);
+  static_assert(functionID("uplo_exp10") == uplo_exp10);
+  static_assert(functionID("uplo_exp2") == uplo_exp2);
+  static_assert(functionID("uplo_expm1") == uplo_expm1);
+  static_assert(functionID("uplo_floor") == uplo_floor);
+  static_assert(functionID("uplo_fmax") == uplo_fmax);
+  static_assert(functionID("uplo_fmin") == uplo_fmin);
+  static_assert(functionID("uplo_fmod") == uplo_fmod);
+  static_assert(functionID("uplo_frac") == uplo_frac);
+  static_assert(functionID("uplo_frem") == uplo_frem);
+  static_assert(functionID("uplo_gamma") == uplo_gamma);
+  static_assert(functionID("uplo_hypot") == uplo_hypot);
+  static_assert(functionID("uplo_inv") == uplo_inv);
+  static_assert(functionID("uplo_inv_cbrt") == uplo_inv_cbrt);
+  static_assert(functionID("uplo_inv_sqrt") == uplo_inv_sqrt);
+  static_assert(functionID("uplo_lgamma") == uplo_lgamma);
+  static_assert(functionID("uplo_linear_frac") == uplo_linear_frac);
+  static_assert(functionID("uplo_log") == uplo_log);
+  static_assert(functionID("uplo_log10") == uplo_log10);
+  static_assert(functionID("uplo_log1p") == uplo_log1p);
+  static_assert(functionID("uplo_log2") == uplo_log2);
+  static_assert(functionID("uplo_modf") == uplo_modf);
+  static_assert(functionID("uplo_mul") == uplo_mul);
+  static_assert(functionID("uplo_pow") == uplo_pow);
+  static_assert(functionID("uplo_pow2o3") == uplo_pow2o3);
+  static_assert(functionID("uplo_pow3o2") == uplo_pow3o2);
+  static_assert(functionID("uplo_powx") == uplo_powx);
+  static_assert(functionID("uplo_ramp") == uplo_ramp);
+  static_assert(functionID("uplo_relu") == uplo_relu);
+  static_assert(functionID("uplo_round") == uplo_round);
+  static_assert(functionID("uplo_scale_shift") == uplo_scale_shift);
+  static_assert(functionID("uplo_sigmoid") == uplo_sigmoid);
+  static_assert(functionID("uplo_sin") == uplo_sin);
+  static_assert(functionID("uplo_sincos") == uplo_sincos);
+  static_assert(functionID("uplo_sinh") == uplo_sinh);
+  static_assert(functionID("uplo_sqr") == uplo_sqr);
+  static_assert(functionID("uplo_sqrt") == uplo_sqrt);
+  static_assert(functionID("uplo_sub") == uplo_sub);
+  static_assert(functionID("uplo_tan") == uplo_tan);
+  static_assert(functionID("uplo_tanh") == uplo_tanh);
+  static_assert(functionID("uplo_trunc") == uplo_trunc);
+  static_assert(functionID("vector_abs") == vector_abs);
+  static_assert(functionID("vector_acos") == vector_acos);
+  static_assert(functionID("vector_acosh") == vector_acosh);
+  static_assert(functionID("vector_add") == vector_add);
+  static_assert(functionID("vector_asin") == vector_asin);
+  static_assert(functionID("vector_asinh") == vector_asinh);
+  static_assert(functionID("vector_atan") == vector_atan);
+  static_assert(functionID("vector_atan2") == vector_atan2);
+  static_assert(functionID("vector_atanh") == vector_atanh);
+  static_assert(functionID("vector_cbrt") == vector_cbrt);
+  static_assert(functionID("vector_cdf_norm") == vector_cdf_norm);
+  static_assert(functionID("vector_cdf_norm_inv") == vector_cdf_norm_inv);
+  static_assert(functionID("vector_ceil") == vector_ceil);
+  static_assert(functionID("vector_copy") == vector_copy);
+  static_assert(functionID("vector_copysign") == vector_copysign);
+  static_assert(functionID("vector_cos") == vector_cos);
+  static_assert(functionID("vector_cosh") == vector_cosh);
+  static_assert(functionID("vector_div") == vector_div);
+  static_assert(functionID("vector_elu") == vector_elu);
+  static_assert(functionID("vector_equals") == vector_equals);
+  static_assert(functionID("vector_erf") == vector_erf);
+  static_assert(functionID("vector_erf_inv") == vector_erf_inv);
+  static_assert(functionID("vector_erfc") == vector_erfc);
+  static_assert(functionID("vector_erfc_inv") == vector_erfc_inv);
+  static_assert(functionID("vector_exp") == vector_exp);
+  static_assert(functionID("vector_exp10") == vector_exp10);
+  static_assert(functionID("vector_exp2") == vector_exp2);
+  static_assert(functionID("vector_expm1") == vector_expm1);
+  static_assert(functionID("vector_floor") == vector_floor);
+  static_assert(functionID("vector_fmax") == vector_fmax);
+  static_assert(functionID("vector_fmin") == vector_fmin);
+  static_assert(functionID("vector_fmod") == vector_fmod);
+  static_assert(functionID("vector_frac") == vector_frac);
+  static_assert(functionID("vector_frem") == vector_frem);
+  static_assert(functionID("vector_gamma") == vector_gamma);
+  static_assert(functionID("vector_hypot") == vector_hypot);
+  static_assert(functionID("vector_inv") == vector_inv);
+  static_assert(functionID("vector_inv_cbrt") == vector_inv_cbrt);
+  static_assert(functionID("vector_inv_sqrt") == vector_inv_sqrt);
+  static_assert(functionID("vector_lgamma") == vector_lgamma);
+  static_assert(functionID("vector_linear_frac") == vector_linear_frac);
+  static_assert(functionID("vector_log") == vector_log);
+  static_assert(functionID("vector_log10") == vector_log10);
+  static_assert(functionID("vector_log1p") == vector_log1p);
+  static_assert(functionID("vector_log2") == vector_log2);
+  static_assert(functionID("vector_modf") == vector_modf);
+  static_assert(functionID("vector_mul") == vector_mul);
+  static_assert(functionID("vector_pow") == vector_pow);
+  static_assert(functionID("vector_pow2o3") == vector_pow2o3);
+  static_assert(functionID("vector_pow3o2") == vector_pow3o2);
+  static_assert(functionID("vector_powx") == vector_powx);
+  static_assert(functionID("vector_ramp") == vector_ramp);
+  static_assert(functionID("vector_relu") == vector_relu);
+  static_assert(functionID("vector_round") == vector_round);
+  static_assert(functionID("vector_scale_shift") == vector_scale_shift);
+  static_assert(functionID("vector_set") == vector_set);
+  static_assert(functionID("vector_sigmoid") == vector_sigmoid);
+  static_assert(functionID("vector_sin") == vector_sin);
+  static_assert(functionID("vector_sincos") == vector_sincos);
+  static_assert(functionID("vector_sinh") == vector_sinh);
+  static_assert(functionID("vector_sqr") == vector_sqr);
+  static_assert(functionID("vector_sqrt") == vector_sqrt);
+  static_assert(functionID("vector_sub") == vector_sub);
+  static_assert(functionID("vector_swap") == vector_swap);
+  static_assert(functionID("vector_tan") == vector_tan);
+  static_assert(functionID("vector_tanh") == vector_tanh);
+  static_assert(functionID("vector_trunc") == vector_trunc);
+  static_assert(functionID("") == UNKNOWN);
+  static_assert(functionID("blas_gemm_") == UNKNOWN);
 } // namespace Ferrum
 
@@ -0,0 +1,347 @@
+#include "graph.hpp"
+#include "expression.hpp"
+
+#include <iostream>
+
+// tests that an sd x fd column major matrix fits in an array
+static bool fits(long sd, long fd, long len, long offset, long ld) {
+  if (sd <= 0 || fd <= 0) {
+    return true;
+  }
+  return offset >= 0 && ld >= sd && offset + (sd - 1) + (fd - 1) * ld < len;
+}
+
+static Ferrum::Graph::Op makeOp(Ferrum::FunctionID id, Ferrum::KernelShape shape, Ferrum::Graph::Form form,
+                                long n, long fd, int unit, int bottom, const Ferrum::Scalars& s) {
+  return Ferrum::Graph::Op{id, shape, form, n, fd, unit, bottom, s, {-1, 0, 0}, {-1, 0, 0}, {-1, 0, 0}};
+}
+
+int Ferrum::Graph::tensor(float* data, long len) {
+  tensors.push_back(Tensor{data, len});
+  return static_cast<int>(tensors.size()) - 1;
+}
+
+// Finds the tensor that holds the whole of an operand's array
+bool Ferrum::Graph::operand(const float* data, long len, long offset, long stride, Ferrum::Graph::Operand& out) const {
+  for (size_t t = 0; t < tensors.size(); t++) {
+    const Tensor& tensor = tensors[t];
+    if (data >= tensor.data && data + len <= tensor.data + tensor.len) {
+      out = Operand{static_cast<int>(t), (data - tensor.data) + offset, stride};
+      return true;
+    }
+  }
+  return false;
+}
+
+float* Ferrum::Graph::record(Ferrum::Graph::Op op, const float* a, long lena, long offset_a, long stride_a,
+                             const float* b, long lenb, long offset_b, long stride_b,
+                             float* result, long len, long offset, long stride) {
+  auto inside = [&](long arrayLen, long arrayOffset, long arrayStride) {
+    switch (op.shape) {
+      case KernelShape::VECTOR:
+        return holds(arrayLen, arrayOffset, arrayStride, op.n);
+      case KernelShape::GE:
+        return fits(op.n, op.fd, arrayLen, arrayOffset, arrayStride);
+      default:
+        return fits(op.n, op.n, arrayLen, arrayOffset, arrayStride);
+    }
+  };
+  if (!(inside(lena, offset_a, stride_a) &&
+        (b == nullptr || inside(lenb, offset_b, stride_b)) &&
+        inside(len, offset, stride))) {
+    std::cerr << "Error: " << (op.shape == KernelShape::VECTOR ? "Vector" : "Matrix")
+              << " does not fit in its array for function '" << kernelName(op.id) << "'" << std::endl;
+    return nullptr;
+  }
+  if (!(operand(a, lena, offset_a, stride_a, op.a) &&
+        (b == nullptr || operand(b, lenb, offset_b, stride_b, op.b)) &&
+        operand(result, len, offset, stride, op.r))) {
+    std::cerr << "Error: Operand is not in a tensor of the graph for function '" << kernelName(op.id) << "'"
+              << std::endl;
+    return nullptr;
+  }
+  recorded.push_back(op);
+  return result;
+}
+
+float* Ferrum::Graph::call(Ferrum::Backend* backend, const Ferrum::Graph::Op& op,
+                           float* const* data, const long* lens) {
+  float* a = data[op.a.tensor];
+  long lena = lens[op.a.tensor];
+  float* b = op.b.tensor < 0 ? nullptr : data[op.b.tensor];
+  long lenb = op.b.tensor < 0 ? 0 : lens[op.b.tensor];
+  float* r = data[op.r.tensor];
+  long len = lens[op.r.tensor];
+  const Operand& ra = op.a;
+  const Operand& rb = op.b;
+  const Operand& rr = op.r;
+  const Scalars& s = op.s;
+  switch (op.shape) {
+    case KernelShape::VECTOR:
+      switch (op.form) {
+        case Form::bB:
+          return backend->vect_bB(op.id, op.n, a, lena, ra.offset, ra.stride, r, len, rr.offset, rr.stride);
+        case Form::bfB:
+          return backend->vect_bfB(op.id, op.n, a, lena, ra.offset, ra.stride, s.sa,
+                                   r, len, rr.offset, rr.stride);
+        case Form::fbB:
+          return backend->vect_fbB(op.id, op.n, s.sa, a, lena, ra.offset, ra.stride,
+                                   r, len, rr.offset, rr.stride);
+        case Form::bbB:
+          return backend->vect_bbB(op.id, op.n, a, lena, ra.offset, ra.stride, b, lenb, rb.offset, rb.stride,
+                                   r, len, rr.offset, rr.stride);
+        case Form::bBB:
+          return backend->vect_bBB(op.id, op.n, a, lena, ra.offset, ra.stride, b, lenb, rb.offset, rb.stride,
+                                   r, len, rr.offset, rr.stride);
+        case Form::bffffB:
+          return backend->vect_bffffB(op.id, op.n, a, lena, ra.offset, ra.stride, s.sa, s.sha, s.sb, s.shb,
+                                      r, len, rr.offset, rr.stride);
+        case Form::bbffffB:
+          return backend->vect_bbffffB(op.id, op.n, a, lena, ra.offset, ra.stride, b, lenb, rb.offset, rb.stride,
+                                       s.sa, s.sha, s.sb, s.shb, r, len, rr.offset, rr.stride);
+      }
+      break;
+    case KernelShape::GE:
+      switch (op.form) {
+        case Form::bB:
+          return backend->ge_bB(op.id, op.n, op.fd, a, lena, ra.offset, ra.stride, r, len, rr.offset, rr.stride);
+        case Form::bfB:
+          return backend->ge_bfB(op.id, op.n, op.fd, a, lena, ra.offset, ra.stride, s.sa,
+                                 r, len, rr.offset, rr.stride);
+        case Form::fbB:
+          return backend->ge_fbB(op.id, op.n, op.fd, s.sa, a, lena, ra.offset, ra.stride,
+                                 r, len, rr.offset, rr.stride);
+        case Form::bbB:
+          return backend->ge_bbB(op.id, op.n, op.fd, a, lena, ra.offset, ra.stride, b, lenb, rb.offset, rb.stride,
+                                 r, len, rr.offset, rr.stride);
+        case Form::bBB:
+          return backend->ge_bBB(op.id, op.n, op.fd, a, lena, ra.offset, ra.stride, b, lenb, rb.offset, rb.stride,
+                                 r, len, rr.offset, rr.stride);
+        case Form::bffffB:
+          return backend->ge_bffffB(op.id, op.n, op.fd, a, lena, ra.offset, ra.stride, s.sa, s.sha, s.sb, s.shb,
+                                    r, len, rr.offset, rr.stride);
+        case Form::bbffffB:
+          return backend->ge_bbffffB(op.id, op.n, op.fd, a, lena, ra.offset, ra.stride,
+                                     b, lenb, rb.offset, rb.stride,
+                                     s.sa, s.sha, s.sb, s.shb, r, len, rr.offset, rr.stride);
+      }
+      break;
+    case KernelShape::UPLO:
+      switch (op.form) {
+        case Form::bB:
+          return backend->uplo_bB(op.id, op.n, op.unit, op.bottom, a, lena, ra.offset, ra.stride,
+                                  r, len, rr.offset, rr.stride);
+        case Form::bfB:
+          return backend->uplo_bfB(op.id, op.n, op.unit, op.bottom, a, lena, ra.offset, ra.stride, s.sa,
+                                   r, len, rr.offset, rr.stride);
+        case Form::fbB:
+          return backend->uplo_fbB(op.id, op.n, op.unit, op.bottom, a, lena, ra.offset, ra.stride, s.sa,
+                                   r, len, rr.offset, rr.stride);
+        case Form::bbB:
+          return backend->uplo_bbB(op.id, op.n, op.unit, op.bottom, a, lena, ra.offset, ra.stride,
+                                   b, lenb, rb.offset, rb.stride, r, len, rr.offset, rr.stride);
+        case Form::bBB:
+          return backend->uplo_bBB(op.id, op.n, op.unit, op.bottom, a, lena, ra.offset, ra.stride,
+                                   b, lenb, rb.offset, rb.stride, r, len, rr.offset, rr.stride);
+        case Form::bffffB:
+          return backend->uplo_bffffB(op.id, op.n, op.unit, op.bottom, a, lena, ra.offset, ra.stride,
+                                      s.sa, s.sha, s.sb, s.shb, r, len, rr.offset, rr.stride);
+        case Form::bbffffB:
+          return backend->uplo_bbffffB(op.id, op.n, op.unit, op.bottom, a, lena, ra.offset, ra.stride,
+                                       b, lenb, rb.offset, rb.stride,
+                                       s.sa, s.sha, s.sb, s.shb, r, len, rr.offset, rr.stride);
+      }
+      break;
+  }
+  return nullptr;
+}
+
+Ferrum::GraphExec::GraphExec(const Ferrum::Graph& graph) : ops(graph.ops()) {
+  for (int t = 0; t < graph.tensorCount(); t++) {
+    bound.push_back(graph.tensorData(t));
+    lens.push_back(graph.tensorLength(t));
+  }
+}
+
+bool Ferrum::CallGraphExec::replay() {
+  for (const Graph::Op& op : ops) {
+    if (Graph::call(backend, op, bound.data(), lens.data()) == nullptr) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Backends with nothing to prepare make the recorded calls in turn
+Ferrum::GraphExec* Ferrum::Backend::instantiate(const Ferrum::Graph& graph) {
+  return new CallGraphExec(this, graph);
+}
+
+// general vector functions
+float* Ferrum::Graph::vect_bB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                              float* result, long len, long offset, long stride) {
+  return record(makeOp(id, KernelShape::VECTOR, Form::bB, n, 1, 0, 0, {0, 0, 0, 0}),
+                a, lena, offset_a, stride_a, nullptr, 0, 0, 0, result, len, offset, stride);
+}
+
+float* Ferrum::Graph::vect_bfB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                               float sa,
+                               float* result, long len, long offset, long stride) {
+  return record(makeOp(id, KernelShape::VECTOR, Form::bfB, n, 1, 0, 0, {sa, 0, 0, 0}),
+                a, lena, offset_a, stride_a, nullptr, 0, 0, 0, result, len, offset, stride);
+}
+
+float* Ferrum::Graph::vect_fbB(Ferrum::FunctionID id, long n, float sa,
+                               const float* a, long lena, long offset_a, long stride_a,
+                               float* result, long len, long offset, long stride) {
+  return record(makeOp(id, KernelShape::VECTOR, Form::fbB, n, 1, 0, 0, {sa, 0, 0, 0}),
+                a, lena, offset_a, stride_a, nullptr, 0, 0, 0, result, len, offset, stride);
+}
+
+float* Ferrum::Graph::vect_bbB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                               const float* b, long lenb, long offset_b, long stride_b,
+                               float* result, long len, long offset, long stride) {
+  return record(makeOp(id, KernelShape::VECTOR, Form::bbB, n, 1, 0, 0, {0, 0, 0, 0}),
+                a, lena, offset_a, stride_a, b, lenb, offset_b, stride_b, result, len, offset, stride);
+}
+
+float* Ferrum::Graph::vect_bBB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                               float* b, long lenb, long offset_b, long stride_b,
+                               float* result, long len, long offset, long stride) {
+  return record(makeOp(id, KernelShape::VECTOR, Form::bBB, n, 1, 0, 0, {0, 0, 0, 0}),
+                a, lena, offset_a, stride_a, b, lenb, offset_b, stride_b, result, len, offset, stride);
+}
+
+float* Ferrum::Graph::vect_bffffB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                  float sa, float sha,
+                                  float sb, float shb,
+                                  float* result, long len, long offset, long stride) {
+  return record(makeOp(id, KernelShape::VECTOR, Form::bffffB, n, 1, 0, 0, {sa, sha, sb, shb}),
+                a, lena, offset_a, stride_a, nullptr, 0, 0, 0, result, len, offset, stride);
+}
+
+float* Ferrum::Graph::vect_bbffffB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                   const float* b, long lenb, long offset_b, long stride_b,
+                                   float sa, float sha,
+                                   float sb, float shb,
+                                   float* result, long len, long offset, long stride) {
+  return record(makeOp(id, KernelShape::VECTOR, Form::bbffffB, n, 1, 0, 0, {sa, sha, sb, shb}),
+                a, lena, offset_a, stride_a, b, lenb, offset_b, stride_b, result, len, offset, stride);
+}
+
+// general matrix functions
+float* Ferrum::Graph::ge_bB(Ferrum::FunctionID id, long sd, long fd,
+                            const float* a, long lena, long offset_a, long stride_a,
+                            float* result, long len, long offset, long stride) {
+  return record(makeOp(id, KernelShape::GE, Form::bB, sd, fd, 0, 0, {0, 0, 0, 0}),
+                a, lena, offset_a, stride_a, nullptr, 0, 0, 0, result, len, offset, stride);
+}
+
+float* Ferrum::Graph::ge_bfB(Ferrum::FunctionID id, long sd, long fd,
+                             const float* a, long lena, long offset_a, long stride_a,
+                             float sa,
+                             float* result, long len, long offset, long stride) {
+  return record(makeOp(id, KernelShape::GE, Form::bfB, sd, fd, 0, 0, {sa, 0, 0, 0}),
+                a, lena, offset_a, stride_a, nullptr, 0, 0, 0, result, len, offset, stride);
+}
+
+float* Ferrum::Graph::ge_fbB(Ferrum::FunctionID id, long sd, long fd, float sa,
+                             const float* a, long lena, long offset_a, long stride_a,
+                             float* result, long len, long offset, long stride) {
+  return record(makeOp(id, KernelShape::GE, Form::fbB, sd, fd, 0, 0, {sa, 0, 0, 0}),
+                a, lena, offset_a, stride_a, nullptr, 0, 0, 0, result, len, offset, stride);
+}
+
+float* Ferrum::Graph::ge_bbB(Ferrum::FunctionID id, long sd, long fd,
+                             const float* a, long lena, long offset_a, long stride_a,
+                             const float* b, long lenb, long offset_b, long stride_b,
+                             float* result, long len, long offset, long stride) {
+  return record(makeOp(id, KernelShape::GE, Form::bbB, sd, fd, 0, 0, {0, 0, 0, 0}),
+                a, lena, offset_a, stride_a, b, lenb, offset_b, stride_b, result, len, offset, stride);
+}
+
+float* Ferrum::Graph::ge_bBB(Ferrum::FunctionID id, long sd, long fd,
+                             const float* a, long lena, long offset_a, long stride_a,
+                             float* b, long lenb, long offset_b, long stride_b,
+                             float* result, long len, long offset, long stride) {
+  return record(makeOp(id, KernelShape::GE, Form::bBB, sd, fd, 0, 0, {0, 0, 0, 0}),
+                a, lena, offset_a, stride_a, b, lenb, offset_b, stride_b, result, len, offset, stride);
+}
+
+float* Ferrum::Graph::ge_bffffB(Ferrum::FunctionID id, long sd, long fd,
+                                const float* a, long lena, long offset_a, long stride_a,
+                                float sa, float sha,
+                                float sb, float shb,
+                                float* result, long len, long offset, long stride) {
+  return record(makeOp(id, KernelShape::GE, Form::bffffB, sd, fd, 0, 0, {sa, sha, sb, shb}),
+                a, lena, offset_a, stride_a, nullptr, 0, 0, 0, result, len, offset, stride);
+}
+
+float* Ferrum::Graph::ge_bbffffB(Ferrum::FunctionID id, long sd, long fd,
+                                 const float* a, long lena, long offset_a, long stride_a,
+                                 const float* b, long lenb, long offset_b, long stride_b,
+                                 float sa, float sha,
+                                 float sb, float shb,
+                                 float* result, long len, long offset, long stride) {
+  return record(makeOp(id, KernelShape::GE, Form::bbffffB, sd, fd, 0, 0, {sa, sha, sb, shb}),
+                a, lena, offset_a, stride_a, b, lenb, offset_b, stride_b, result, len, offset, stride);
+}
+
+// general uplo functions
+float* Ferrum::Graph::uplo_bB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                              const float* a, long lena, long offset_a, long stride_a,
+                              float* result, long len, long offset, long stride) {
+  return record(makeOp(id, KernelShape::UPLO, Form::bB, sd, sd, unit, bottom, {0, 0, 0, 0}),
+                a, lena, offset_a, stride_a, nullptr, 0, 0, 0, result, len, offset, stride);
+}
+
+float* Ferrum::Graph::uplo_bfB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                               const float* a, long lena, long offset_a, long stride_a,
+                               float sa,
+                               float* result, long len, long offset, long stride) {
+  return record(makeOp(id, KernelShape::UPLO, Form::bfB, sd, sd, unit, bottom, {sa, 0, 0, 0}),
+                a, lena, offset_a, stride_a, nullptr, 0, 0, 0, result, len, offset, stride);
+}
+
+float* Ferrum::Graph::uplo_fbB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                               const float* a, long lena, long offset_a, long stride_a,
+                               float sa,
+                               float* result, long len, long offset, long stride) {
+  return record(makeOp(id, KernelShape::UPLO, Form::fbB, sd, sd, unit, bottom, {sa, 0, 0, 0}),
+                a, lena, offset_a, stride_a, nullptr, 0, 0, 0, result, len, offset, stride);
+}
+
+float* Ferrum::Graph::uplo_bbB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                               const float* a, long lena, long offset_a, long stride_a,
+                               const float* b, long lenb, long offset_b, long stride_b,
+                               float* result, long len, long offset, long stride) {
+  return record(makeOp(id, KernelShape::UPLO, Form::bbB, sd, sd, unit, bottom, {0, 0, 0, 0}),
+                a, lena, offset_a, stride_a, b, lenb, offset_b, stride_b, result, len, offset, stride);
+}
+
+float* Ferrum::Graph::uplo_bBB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                               const float* a, long lena, long offset_a, long stride_a,
+                               float* b, long lenb, long offset_b, long stride_b,
+                               float* result, long len, long offset, long stride) {
+  return record(makeOp(id, KernelShape::UPLO, Form::bBB, sd, sd, unit, bottom, {0, 0, 0, 0}),
+                a, lena, offset_a, stride_a, b, lenb, offset_b, stride_b, result, len, offset, stride);
+}
+
+float* Ferrum::Graph::uplo_bffffB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                  const float* a, long lena, long offset_a, long stride_a,
+                                  float sa, float sha,
+                                  float sb, float shb,
+                                  float* result, long len, long offset, long stride) {
+  return record(makeOp(id, KernelShape::UPLO, Form::bffffB, sd, sd, unit, bottom, {sa, sha, sb, shb}),
+                a, lena, offset_a, stride_a, nullptr, 0, 0, 0, result, len, offset, stride);
+}
+
+float* Ferrum::Graph::uplo_bbffffB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   const float* b, long lenb, long offset_b, long stride_b,
+                                   float sa, float sha,
+                                   float sb, float shb,
+                                   float* result, long len, long offset, long stride) {
+  return record(makeOp(id, KernelShape::UPLO, Form::bbffffB, sd, sd, unit, bottom, {sa, sha, sb, shb}),
+                a, lena, offset_a, stride_a, b, lenb, offset_b, stride_b, result, len, offset, stride);
+}
@@ -0,0 +1,306 @@
+#include "kernelcache.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+static const char* ENTRY_MAGIC = "ferrum-kernel\n";
+static const char* ENTRY_EXT = ".bin";
+static const char* TEMP_EXT = ".tmp";
+static const char* LOCK_NAME = "lock";
+static const char* FERRUM_KERNEL_CACHE = "FERRUM_KERNEL_CACHE";
+// a temporary file this old was left by a writer that did not finish
+static const time_t STALE_SECONDS = 60 * 60;
+
+static bool endsWith(const std::string& name, const char* ext) {
+  size_t n = std::strlen(ext);
+  return name.size() > n && name.compare(name.size() - n, n, ext) == 0;
+}
+
+// Creates a directory and any of its parents that are missing
+static bool makeDirectories(const std::string& path) {
+  for (size_t end = path.find('/', 1); ; end = path.find('/', end + 1)) {
+    std::string part = path.substr(0, end);
+    if (mkdir(part.c_str(), 0755) != 0 && errno != EEXIST) {
+      return false;
+    }
+    if (end == std::string::npos) {
+      break;
+    }
+  }
+  struct stat info;
+  return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+static bool readFile(const std::string& path, std::string& contents) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info;
+  bool ok = fstat(fd, &info) == 0;
+  if (ok) {
+    contents.resize(static_cast<size_t>(info.st_size));
+    size_t done = 0;
+    while (ok && done < contents.size()) {
+      ssize_t count = read(fd, &contents[done], contents.size() - done);
+      ok = count > 0;
+      done += ok ? static_cast<size_t>(count) : 0;
+    }
+  }
+  close(fd);
+  return ok;
+}
+
+static bool writeFile(int fd, const std::string& contents) {
+  size_t done = 0;
+  while (done < contents.size()) {
+    ssize_t count = write(fd, contents.data() + done, contents.size() - done);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      return false;
+    }
+    done += static_cast<size_t>(count);
+  }
+  return true;
+}
+
+// An entry is the magic line, a line of the version and the lengths of the target, the source
+// and the data, and then the three of them
+static std::string entry(const std::string& target, const std::string& source, const std::string& data) {
+  std::string header = std::to_string(Ferrum::KernelCache::VERSION) + " " + std::to_string(target.size()) + " " +
+                       std::to_string(source.size()) + " " + std::to_string(data.size()) + "\n";
+  return ENTRY_MAGIC + header + target + source + data;
+}
+
+// The data of an entry, if it is whole and was written for this target and source
+static bool entryData(const std::string& contents, const std::string& target, const std::string& source,
+                      std::string& data) {
+  size_t magic = std::strlen(ENTRY_MAGIC);
+  if (contents.compare(0, magic, ENTRY_MAGIC) != 0) {
+    return false;
+  }
+  size_t line = contents.find('\n', magic);
+  if (line == std::string::npos) {
+    return false;
+  }
+  int version;
+  unsigned long long targetSize, sourceSize, dataSize;
+  std::string header = contents.substr(magic, line - magic);
+  if (std::sscanf(header.c_str(), "%d %llu %llu %llu", &version, &targetSize, &sourceSize, &dataSize) != 4 ||
+      version != Ferrum::KernelCache::VERSION || targetSize != target.size() || sourceSize != source.size() ||
+      contents.size() - line - 1 != targetSize + sourceSize + dataSize) {
+    return false;
+  }
+  size_t at = line + 1;
+  if (contents.compare(at, target.size(), target) != 0 ||
+      contents.compare(at + target.size(), source.size(), source) != 0) {
+    return false;
+  }
+  data = contents.substr(at + target.size() + source.size());
+  return true;
+}
+
+std::string Ferrum::KernelCache::defaultDirectory() {
+  const char* directory = std::getenv(FERRUM_KERNEL_CACHE);
+  if (directory != nullptr) {
+    return directory;
+  }
+  const char* home = std::getenv("HOME");
+#ifdef __APPLE__
+  return home == nullptr || *home == '\0' ? "" : std::string(home) + "/Library/Caches/ferrum";
+#else
+  const char* cache = std::getenv("XDG_CACHE_HOME");
+  if (cache != nullptr && *cache != '\0') {
+    return std::string(cache) + "/ferrum";
+  }
+  return home == nullptr || *home == '\0' ? "" : std::string(home) + "/.cache/ferrum";
+#endif
+}
+
+std::string Ferrum::KernelCache::hostTarget() {
+#if defined(__x86_64__)
+  std::string target = "x86_64";
+#elif defined(__aarch64__)
+  std::string target = "arm64";
+#else
+  std::string target = "unknown";
+#endif
+#if defined(__AVX512F__)
+  target += "-avx512";
+#elif defined(__AVX2__)
+  target += "-avx2";
+#elif defined(__AVX__)
+  target += "-avx";
+#elif defined(__ARM_NEON)
+  target += "-neon";
+#endif
+  return target;
+}
+
+Ferrum::KernelCache::KernelCache(const std::string& directory, const std::string& target, size_t maxBytes) :
+    host(target), maxBytes(maxBytes), hits(0), misses(0), stores(0), evicted(0) {
+  if (directory.empty()) {
+    return;
+  }
+  std::string versioned = directory + "/v" + std::to_string(VERSION);
+  if (!makeDirectories(versioned)) {
+    std::cerr << "Error: Failed to create the kernel cache directory: " << versioned << std::endl;
+    return;
+  }
+  root = versioned;
+}
+
+// FNV-1a over the version, the target and the source
+uint64_t Ferrum::KernelCache::hash(const std::string& source) const {
+  uint64_t h = 14695981039346656037ull;
+  auto mix = [&h](const std::string& text) {
+    for (unsigned char c : text) {
+      h = (h ^ c) * 1099511628211ull;
+    }
+    h = (h ^ 0) * 1099511628211ull;
+  };
+  mix(std::to_string(VERSION));
+  mix(host);
+  mix(source);
+  return h;
+}
+
+std::string Ferrum::KernelCache::path(const std::string& source) const {
+  char name[17];
+  std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash(source)));
+  return root + "/" + name + ENTRY_EXT;
+}
+
+bool Ferrum::KernelCache::load(const std::string& source, std::string& data) {
+  if (!enabled()) {
+    return false;
+  }
+  std::string file = path(source);
+  std::string contents;
+  if (!readFile(file, contents) || !entryData(contents, host, source, data)) {
+    misses++;
+    return false;
+  }
+  // the modification time orders the entries for eviction
+  utimensat(AT_FDCWD, file.c_str(), nullptr, 0);
+  hits++;
+  return true;
+}
+
+bool Ferrum::KernelCache::store(const std::string& source, const std::string& data) {
+  if (!enabled()) {
+    return false;
+  }
+  static std::atomic<unsigned int> temps(0);
+  std::string file = path(source);
+  std::string temp = file.substr(0, file.size() - std::strlen(ENTRY_EXT)) + "." + std::to_string(getpid()) + "." +
+                     std::to_string(temps++) + TEMP_EXT;
+  int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+  bool ok = fd >= 0 && writeFile(fd, entry(host, source, data));
+  if (fd >= 0) {
+    ok = close(fd) == 0 && ok;
+  }
+  if (!ok || rename(temp.c_str(), file.c_str()) != 0) {
+    std::cerr << "Error: Failed to write kernel cache entry: " << file << std::endl;
+    unlink(temp.c_str());
+    return false;
+  }
+  stores++;
+  if (size() > maxBytes) {
+    evict();
+  }
+  return true;
+}
+
+namespace {
+
+  struct Entry {
+    std::string path;
+    struct timespec used;
+    size_t bytes;
+  };
+
+} // namespace
+
+// The entries of a directory, removing what writers that did not finish left behind
+static std::vector<Entry> entries(const std::string& root, bool removeStale) {
+  std::vector<Entry> found;
+  DIR* dir = opendir(root.c_str());
+  if (dir == nullptr) {
+    return found;
+  }
+  time_t now = time(nullptr);
+  for (struct dirent* item = readdir(dir); item != nullptr; item = readdir(dir)) {
+    std::string name = item->d_name;
+    std::string file = root + "/" + name;
+    struct stat info;
+    if (!(endsWith(name, ENTRY_EXT) || endsWith(name, TEMP_EXT)) || stat(file.c_str(), &info) != 0) {
+      continue;
+    }
+    if (endsWith(name, TEMP_EXT)) {
+      if (removeStale && now - info.st_mtime > STALE_SECONDS) {
+        unlink(file.c_str());
+      }
+      continue;
+    }
+#ifdef __APPLE__
+    found.push_back({file, info.st_mtimespec, static_cast<size_t>(info.st_size)});
+#else
+    found.push_back({file, info.st_mtim, static_cast<size_t>(info.st_size)});
+#endif
+  }
+  closedir(dir);
+  return found;
+}
+
+size_t Ferrum::KernelCache::size() const {
+  size_t total = 0;
+  for (const Entry& entry : entries(root, false)) {
+    total += entry.bytes;
+  }
+  return total;
+}
+
+void Ferrum::KernelCache::evict() {
+  if (!enabled()) {
+    return;
+  }
+  // one process evicts at a time, so that two do not both remove entries to make the same room
+  std::string lockPath = root + "/" + LOCK_NAME;
+  int lock = open(lockPath.c_str(), O_RDWR | O_CREAT, 0644);
+  if (lock < 0 || flock(lock, LOCK_EX) != 0) {
+    std::cerr << "Error: Failed to lock the kernel cache: " << lockPath << std::endl;
+    if (lock >= 0) {
+      close(lock);
+    }
+    return;
+  }
+  std::vector<Entry> found = entries(root, true);
+  size_t total = 0;
+  for (const Entry& entry : found) {
+    total += entry.bytes;
+  }
+  std::sort(found.begin(), found.end(), [](const Entry& x, const Entry& y) {
+    return x.used.tv_sec != y.used.tv_sec ? x.used.tv_sec < y.used.tv_sec : x.used.tv_nsec < y.used.tv_nsec;
+  });
+  for (size_t i = 0; i < found.size() && total > maxBytes; i++) {
+    if (unlink(found[i].path.c_str()) == 0) {
+      evicted++;
+    }
+    total -= found[i].bytes;
+  }
+  flock(lock, LOCK_UN);
+  close(lock);
+}
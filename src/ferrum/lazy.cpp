@@ -0,0 +1,877 @@
+#include "lazy.hpp"
+
+#include <cstring>
+
+using Form = Ferrum::Graph::Form;
+using Op = Ferrum::Graph::Op;
+
+// How far back a call looks for an earlier call with the same arguments
+static const size_t CSE_WINDOW = 64;
+
+// The elements an operand may touch, from the lowest to the highest, with the shape of the
+// call that touches them
+struct Access {
+  const float* low;
+  const float* high;
+  long stride;
+  const Op* op;
+};
+
+// A deferred call, with the operands it reads and writes
+struct Node {
+  Op op;
+  bool alive;
+  int reads;
+  int writes;
+  Access read[2];
+  Access write[2];
+};
+
+static uint32_t bits(float f) {
+  uint32_t b;
+  std::memcpy(&b, &f, sizeof(b));
+  return b;
+}
+
+static long partOffset(long offset, long stride, long n, long begin, long count) {
+  return Ferrum::firstIndex(offset, stride, n) + (stride < 0 ? begin + count - 1 : begin) * stride;
+}
+
+static bool empty(const Op& op) {
+  return op.n <= 0 || (op.shape == Ferrum::KernelShape::GE && op.fd <= 0);
+}
+
+static Access access(const Ferrum::Graph& graph, const Op& op, const Ferrum::Graph::Operand& operand) {
+  const float* low = graph.tensorData(operand.tensor) + operand.offset;
+  long reach;
+  switch (op.shape) {
+    case Ferrum::KernelShape::VECTOR:
+      reach = (op.n - 1) * (operand.stride < 0 ? -operand.stride : operand.stride);
+      break;
+    case Ferrum::KernelShape::GE:
+      reach = (op.n - 1) + (op.fd - 1) * operand.stride;
+      break;
+    default:
+      reach = (op.n - 1) + (op.n - 1) * operand.stride;
+      break;
+  }
+  return Access{low, low + reach, operand.stride, &op};
+}
+
+static void analyse(const Ferrum::Graph& graph, Node& node) {
+  const Op& op = node.op;
+  node.reads = 0;
+  node.writes = 0;
+  node.read[node.reads++] = access(graph, op, op.a);
+  if (op.form == Form::bbB || op.form == Form::bbffffB) {
+    node.read[node.reads++] = access(graph, op, op.b);
+  }
+  if (op.form == Form::bBB) {
+    node.write[node.writes++] = access(graph, op, op.b);
+  }
+  node.write[node.writes++] = access(graph, op, op.r);
+  // swap exchanges its operands, reading and writing both
+  if (op.id == Ferrum::FunctionID::vector_swap) {
+    node.read[node.reads++] = node.write[0];
+    node.write[node.writes++] = node.read[0];
+  }
+}
+
+static bool overlap(const Access& x, const Access& y) {
+  return x.low <= y.high && y.low <= x.high;
+}
+
+// tests that two operands touch the same elements in the same order
+static bool same(const Access& x, const Access& y) {
+  const Op& p = *x.op;
+  const Op& q = *y.op;
+  if (x.low != y.low || x.stride != y.stride || p.shape != q.shape || p.n != q.n) {
+    return false;
+  }
+  switch (p.shape) {
+    case Ferrum::KernelShape::VECTOR:
+      return true;
+    case Ferrum::KernelShape::GE:
+      return p.fd == q.fd;
+    default:
+      return p.unit == q.unit && p.bottom == q.bottom;
+  }
+}
+
+// tests that an operand touches every element from its lowest to its highest
+static bool dense(const Access& x) {
+  const Op& op = *x.op;
+  switch (op.shape) {
+    case Ferrum::KernelShape::VECTOR:
+      return op.n == 1 || x.stride == 1 || x.stride == -1;
+    case Ferrum::KernelShape::GE:
+      return op.fd == 1 || x.stride == op.n;
+    default:
+      return op.n == 1;
+  }
+}
+
+// tests that writing w overwrites every element that x touches
+static bool covers(const Access& w, const Access& x) {
+  return same(w, x) || (dense(w) && w.low <= x.low && x.high <= w.high);
+}
+
+static bool reads(const Node& node, const Access& x) {
+  for (int k = 0; k < node.reads; k++) {
+    if (overlap(node.read[k], x)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool writes(const Node& node, const Access& x) {
+  for (int k = 0; k < node.writes; k++) {
+    if (overlap(node.write[k], x)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool readsOwnResult(const Node& node) {
+  for (int k = 0; k < node.writes; k++) {
+    if (reads(node, node.write[k])) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// tests that two calls compute the same thing from the same inputs
+static bool sameCall(const Node& x, const Node& y) {
+  const Op& p = x.op;
+  const Op& q = y.op;
+  if (p.id != q.id || p.form != q.form || x.reads != y.reads ||
+      bits(p.s.sa) != bits(q.s.sa) || bits(p.s.sha) != bits(q.s.sha) ||
+      bits(p.s.sb) != bits(q.s.sb) || bits(p.s.shb) != bits(q.s.shb)) {
+    return false;
+  }
+  for (int k = 0; k < x.reads; k++) {
+    if (!same(x.read[k], y.read[k])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// The other half of a sin and cos pair, and the function that computes both
+static bool pairOf(Ferrum::FunctionID id, Ferrum::FunctionID& other, Ferrum::FunctionID& both, bool& sine) {
+  switch (id) {
+    case Ferrum::FunctionID::vector_sin:
+    case Ferrum::FunctionID::vector_cos:
+      sine = id == Ferrum::FunctionID::vector_sin;
+      other = sine ? Ferrum::FunctionID::vector_cos : Ferrum::FunctionID::vector_sin;
+      both = Ferrum::FunctionID::vector_sincos;
+      return true;
+    case Ferrum::FunctionID::ge_sin:
+    case Ferrum::FunctionID::ge_cos:
+      sine = id == Ferrum::FunctionID::ge_sin;
+      other = sine ? Ferrum::FunctionID::ge_cos : Ferrum::FunctionID::ge_sin;
+      both = Ferrum::FunctionID::ge_sincos;
+      return true;
+    case Ferrum::FunctionID::uplo_sin:
+    case Ferrum::FunctionID::uplo_cos:
+      sine = id == Ferrum::FunctionID::uplo_sin;
+      other = sine ? Ferrum::FunctionID::uplo_cos : Ferrum::FunctionID::uplo_sin;
+      both = Ferrum::FunctionID::uplo_sincos;
+      return true;
+    default:
+      return false;
+  }
+}
+
+// tests that no call between two others writes over x, or touches y
+static bool untouched(const std::vector<Node>& nodes, size_t from, size_t to, const Access* x, int count,
+                      const Access* y) {
+  for (size_t k = from + 1; k < to; k++) {
+    const Node& node = nodes[k];
+    if (!node.alive) {
+      continue;
+    }
+    for (int c = 0; c < count; c++) {
+      if (writes(node, x[c])) {
+        return false;
+      }
+    }
+    if (y != nullptr && (writes(node, *y) || reads(node, *y))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Reuses the results of earlier calls, and merges sin and cos calls on the same input
+static void eliminateCommon(const Ferrum::Graph& graph, std::vector<Node>& nodes, Ferrum::LazyStats& counters) {
+  for (size_t j = 1; j < nodes.size(); j++) {
+    Node& later = nodes[j];
+    if (!later.alive || later.op.id == Ferrum::FunctionID::vector_copy) {
+      continue;
+    }
+    Ferrum::FunctionID other = Ferrum::FunctionID::UNKNOWN, both = Ferrum::FunctionID::UNKNOWN;
+    bool sine = false;
+    bool pairs = later.op.form == Form::bB && pairOf(later.op.id, other, both, sine);
+    for (size_t i = j; i-- > 0 && j - i <= CSE_WINDOW;) {
+      Node& earlier = nodes[i];
+      if (!earlier.alive || readsOwnResult(earlier)) {
+        continue;
+      }
+      if (sameCall(earlier, later) &&
+          untouched(nodes, i, j, earlier.read, earlier.reads, nullptr) &&
+          untouched(nodes, i, j, earlier.write, earlier.writes, nullptr)) {
+        bool sameResult = true;
+        for (int k = 0; k < later.writes; k++) {
+          sameResult = sameResult && same(earlier.write[k], later.write[k]);
+        }
+        if (sameResult) {
+          later.alive = false;
+          counters.reused++;
+        } else if (later.op.shape == Ferrum::KernelShape::VECTOR && later.writes == 1 &&
+                   !overlap(earlier.write[0], later.write[0])) {
+          // the same values, copied from where the earlier call left them
+          later.op.id = Ferrum::FunctionID::vector_copy;
+          later.op.form = Form::bB;
+          later.op.s = Ferrum::Scalars{0, 0, 0, 0};
+          later.op.a = earlier.op.r;
+          later.op.b = Ferrum::Graph::Operand{-1, 0, 0};
+          analyse(graph, later);
+          counters.reused++;
+        } else {
+          continue;
+        }
+        break;
+      }
+      // the pair is made where the earlier half was, so nothing in between may see the later half's result
+      if (pairs && earlier.op.id == other && earlier.op.form == Form::bB && same(earlier.read[0], later.read[0]) &&
+          !overlap(earlier.write[0], later.write[0]) && !reads(later, later.write[0]) &&
+          untouched(nodes, i, j, earlier.read, 1, &later.write[0])) {
+        const Ferrum::Graph::Operand& result = later.op.r;
+        earlier.op.id = both;
+        earlier.op.form = Form::bBB;
+        earlier.op.b = sine ? result : earlier.op.r;
+        earlier.op.r = sine ? earlier.op.r : result;
+        analyse(graph, earlier);
+        later.alive = false;
+        counters.merged++;
+        break;
+      }
+    }
+  }
+}
+
+static bool inside(const Access& x, const std::vector<Access>& regions) {
+  for (const Access& region : regions) {
+    if (region.low <= x.low && x.high <= region.high) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Drops calls whose results are overwritten before they are read, or are only left in scratch
+static void eliminateDead(std::vector<Node>& nodes, const std::vector<Access>& scratch, Ferrum::LazyStats& counters) {
+  for (size_t i = nodes.size(); i-- > 0;) {
+    Node& node = nodes[i];
+    if (!node.alive) {
+      continue;
+    }
+    bool dead = true;
+    for (int w = 0; w < node.writes && dead; w++) {
+      const Access& x = node.write[w];
+      bool settled = false;
+      for (size_t k = i + 1; k < nodes.size() && !settled; k++) {
+        const Node& after = nodes[k];
+        if (!after.alive) {
+          continue;
+        }
+        if (reads(after, x)) {
+          dead = false;
+          settled = true;
+        }
+        for (int c = 0; c < after.writes && !settled; c++) {
+          settled = covers(after.write[c], x);
+        }
+      }
+      if (!settled) {
+        dead = inside(x, scratch);
+      }
+    }
+    if (dead) {
+      node.alive = false;
+      counters.eliminated++;
+    }
+  }
+}
+
+// tests that a vector call can join a fused chain, as every operand it shares with the
+// chain is touched element for element in the same order
+static bool joins(const std::vector<Node*>& chain, const Node& node) {
+  auto aligned = [](const Access& x, const Access& y) { return !overlap(x, y) || same(x, y); };
+  if (node.writes == 2 && !aligned(node.write[0], node.write[1])) {
+    return false;
+  }
+  for (int w = 0; w < node.writes; w++) {
+    for (int r = 0; r < node.reads; r++) {
+      if (!aligned(node.write[w], node.read[r])) {
+        return false;
+      }
+    }
+  }
+  for (const Node* member : chain) {
+    for (int w = 0; w < node.writes; w++) {
+      for (int c = 0; c < member->reads; c++) {
+        if (!aligned(node.write[w], member->read[c])) {
+          return false;
+        }
+      }
+      for (int c = 0; c < member->writes; c++) {
+        if (!aligned(node.write[w], member->write[c])) {
+          return false;
+        }
+      }
+    }
+    for (int c = 0; c < member->writes; c++) {
+      for (int r = 0; r < node.reads; r++) {
+        if (!aligned(member->write[c], node.read[r])) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+static Ferrum::Graph::Operand part(const Ferrum::Graph::Operand& operand, long n, long begin, long count) {
+  if (operand.tensor < 0) {
+    return operand;
+  }
+  return Ferrum::Graph::Operand{operand.tensor, partOffset(operand.offset, operand.stride, n, begin, count),
+                                operand.stride};
+}
+
+Ferrum::LazyEngine::LazyEngine(Ferrum::Backend* backend, long fuseTile, int maxPending) :
+    engine(backend), fuseTile(fuseTile), maxPending(maxPending < 1 ? 1 : maxPending), counters() {
+}
+
+Ferrum::LazyEngine::~LazyEngine() {
+  materialize();
+  delete engine;
+}
+
+Ferrum::LazyStats Ferrum::LazyEngine::stats() const {
+  std::lock_guard<std::mutex> guard(lock);
+  return counters;
+}
+
+void Ferrum::LazyEngine::discard(const float* data, long len) {
+  std::lock_guard<std::mutex> guard(lock);
+  scratch.push_back(Scratch{data, len});
+}
+
+bool Ferrum::LazyEngine::materialize() {
+  std::lock_guard<std::mutex> guard(lock);
+  bool ok = run(true);
+  scratch.clear();
+  return ok;
+}
+
+void Ferrum::LazyEngine::declare(const float* data, long len) {
+  for (int t = 0; t < pending.tensorCount(); t++) {
+    const float* held = pending.tensorData(t);
+    if (data >= held && data + len <= held + pending.tensorLength(t)) {
+      return;
+    }
+  }
+  pending.tensor(const_cast<float*>(data), len);
+}
+
+float* Ferrum::LazyEngine::deferred(float* result) {
+  if (result == nullptr) {
+    return nullptr;
+  }
+  counters.recorded++;
+  // scratch is only known to be dead once the caller materializes, not part way through
+  if (static_cast<int>(pending.ops().size()) >= maxPending && !run(false)) {
+    return nullptr;
+  }
+  return result;
+}
+
+// Optimizes the pending calls, then makes them on the wrapped backend
+bool Ferrum::LazyEngine::run(bool final) {
+  std::vector<Node> nodes;
+  nodes.reserve(pending.ops().size());
+  for (const Op& op : pending.ops()) {
+    if (!empty(op)) {
+      nodes.push_back(Node{op, true, 0, 0, {}, {}});
+    }
+  }
+  // the nodes do not move from here on, so their operands can point at their calls
+  for (Node& node : nodes) {
+    analyse(pending, node);
+  }
+  std::vector<Access> regions;
+  for (const Scratch& region : final ? scratch : std::vector<Scratch>()) {
+    regions.push_back(Access{region.data, region.data + region.len - 1, 1, nullptr});
+  }
+  eliminateCommon(pending, nodes, counters);
+  eliminateDead(nodes, regions, counters);
+
+  std::vector<float*> data;
+  std::vector<long> lens;
+  for (int t = 0; t < pending.tensorCount(); t++) {
+    data.push_back(pending.tensorData(t));
+    lens.push_back(pending.tensorLength(t));
+  }
+  bool ok = true;
+  for (size_t i = 0; i < nodes.size() && ok; i++) {
+    if (!nodes[i].alive) {
+      continue;
+    }
+    std::vector<Node*> chain{&nodes[i]};
+    const Op& first = nodes[i].op;
+    size_t last = i;
+    if (fuseTile > 0 && first.shape == KernelShape::VECTOR && first.n > fuseTile && joins({}, nodes[i])) {
+      for (size_t k = i + 1; k < nodes.size(); k++) {
+        Node& next = nodes[k];
+        if (!next.alive) {
+          continue;
+        }
+        if (next.op.shape != KernelShape::VECTOR || next.op.n != first.n || !joins(chain, next)) {
+          break;
+        }
+        chain.push_back(&next);
+        last = k;
+      }
+    }
+    counters.executed++;
+    if (chain.size() == 1) {
+      ok = Graph::call(engine, first, data.data(), lens.data()) != nullptr;
+      continue;
+    }
+    // each tile runs through the whole chain while its operands are in cache
+    long n = first.n;
+    for (long begin = 0; begin < n && ok; begin += fuseTile) {
+      long count = n - begin < fuseTile ? n - begin : fuseTile;
+      for (size_t c = 0; c < chain.size() && ok; c++) {
+        Op tile = chain[c]->op;
+        tile.n = count;
+        tile.a = part(tile.a, n, begin, count);
+        tile.b = part(tile.b, n, begin, count);
+        tile.r = part(tile.r, n, begin, count);
+        ok = Graph::call(engine, tile, data.data(), lens.data()) != nullptr;
+      }
+    }
+    counters.fused += chain.size();
+    i = last;
+  }
+  pending.clear();
+  return ok;
+}
+
+// general vector functions
+float* Ferrum::LazyEngine::vect_bB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                   float* result, long len, long offset, long stride) {
+  std::lock_guard<std::mutex> guard(lock);
+  declare(a, lena);
+  declare(result, len);
+  return deferred(pending.vect_bB(id, n, a, lena, offset_a, stride_a, result, len, offset, stride));
+}
+
+float* Ferrum::LazyEngine::vect_bfB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                    float sa,
+                                    float* result, long len, long offset, long stride) {
+  std::lock_guard<std::mutex> guard(lock);
+  declare(a, lena);
+  declare(result, len);
+  return deferred(pending.vect_bfB(id, n, a, lena, offset_a, stride_a, sa, result, len, offset, stride));
+}
+
+float* Ferrum::LazyEngine::vect_fbB(Ferrum::FunctionID id, long n, float sa,
+                                    const float* a, long lena, long offset_a, long stride_a,
+                                    float* result, long len, long offset, long stride) {
+  std::lock_guard<std::mutex> guard(lock);
+  declare(a, lena);
+  declare(result, len);
+  return deferred(pending.vect_fbB(id, n, sa, a, lena, offset_a, stride_a, result, len, offset, stride));
+}
+
+float* Ferrum::LazyEngine::vect_bbB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                    const float* b, long lenb, long offset_b, long stride_b,
+                                    float* result, long len, long offset, long stride) {
+  std::lock_guard<std::mutex> guard(lock);
+  declare(a, lena);
+  declare(b, lenb);
+  declare(result, len);
+  return deferred(pending.vect_bbB(id, n, a, lena, offset_a, stride_a,
+                                   b, lenb, offset_b, stride_b,
+                                   result, len, offset, stride));
+}
+
+float* Ferrum::LazyEngine::vect_bBB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                    float* b, long lenb, long offset_b, long stride_b,
+                                    float* result, long len, long offset, long stride) {
+  std::lock_guard<std::mutex> guard(lock);
+  declare(a, lena);
+  declare(b, lenb);
+  declare(result, len);
+  return deferred(pending.vect_bBB(id, n, a, lena, offset_a, stride_a,
+                                   b, lenb, offset_b, stride_b,
+                                   result, len, offset, stride));
+}
+
+float* Ferrum::LazyEngine::vect_bffffB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                       float sa, float sha,
+                                       float sb, float shb,
+                                       float* result, long len, long offset, long stride) {
+  std::lock_guard<std::mutex> guard(lock);
+  declare(a, lena);
+  declare(result, len);
+  return deferred(pending.vect_bffffB(id, n, a, lena, offset_a, stride_a,
+                                      sa, sha, sb, shb,
+                                      result, len, offset, stride));
+}
+
+float* Ferrum::LazyEngine::vect_bbffffB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                        const float* b, long lenb, long offset_b, long stride_b,
+                                        float sa, float sha,
+                                        float sb, float shb,
+                                        float* result, long len, long offset, long stride) {
+  std::lock_guard<std::mutex> guard(lock);
+  declare(a, lena);
+  declare(b, lenb);
+  declare(result, len);
+  return deferred(pending.vect_bbffffB(id, n, a, lena, offset_a, stride_a,
+                                       b, lenb, offset_b, stride_b,
+                                       sa, sha, sb, shb,
+                                       result, len, offset, stride));
+}
+
+// general matrix functions
+float* Ferrum::LazyEngine::ge_bB(Ferrum::FunctionID id, long sd, long fd,
+                                 const float* a, long lena, long offset_a, long stride_a,
+                                 float* result, long len, long offset, long stride) {
+  std::lock_guard<std::mutex> guard(lock);
+  declare(a, lena);
+  declare(result, len);
+  return deferred(pending.ge_bB(id, sd, fd, a, lena, offset_a, stride_a, result, len, offset, stride));
+}
+
+float* Ferrum::LazyEngine::ge_bfB(Ferrum::FunctionID id, long sd, long fd,
+                                  const float* a, long lena, long offset_a, long stride_a,
+                                  float sa,
+                                  float* result, long len, long offset, long stride) {
+  std::lock_guard<std::mutex> guard(lock);
+  declare(a, lena);
+  declare(result, len);
+  return deferred(pending.ge_bfB(id, sd, fd, a, lena, offset_a, stride_a, sa, result, len, offset, stride));
+}
+
+float* Ferrum::LazyEngine::ge_fbB(Ferrum::FunctionID id, long sd, long fd, float sa,
+                                  const float* a, long lena, long offset_a, long stride_a,
+                                  float* result, long len, long offset, long stride) {
+  std::lock_guard<std::mutex> guard(lock);
+  declare(a, lena);
+  declare(result, len);
+  return deferred(pending.ge_fbB(id, sd, fd, sa, a, lena, offset_a, stride_a, result, len, offset, stride));
+}
+
+float* Ferrum::LazyEngine::ge_bbB(Ferrum::FunctionID id, long sd, long fd,
+                                  const float* a, long lena, long offset_a, long stride_a,
+                                  const float* b, long lenb, long offset_b, long stride_b,
+                                  float* result, long len, long offset, long stride) {
+  std::lock_guard<std::mutex> guard(lock);
+  declare(a, lena);
+  declare(b, lenb);
+  declare(result, len);
+  return deferred(pending.ge_bbB(id, sd, fd, a, lena, offset_a, stride_a,
+                                 b, lenb, offset_b, stride_b,
+                                 result, len, offset, stride));
+}
+
+float* Ferrum::LazyEngine::ge_bBB(Ferrum::FunctionID id, long sd, long fd,
+                                  const float* a, long lena, long offset_a, long stride_a,
+                                  float* b, long lenb, long offset_b, long stride_b,
+                                  float* result, long len, long offset, long stride) {
+  std::lock_guard<std::mutex> guard(lock);
+  declare(a, lena);
+  declare(b, lenb);
+  declare(result, len);
+  return deferred(pending.ge_bBB(id, sd, fd, a, lena, offset_a, stride_a,
+                                 b, lenb, offset_b, stride_b,
+                                 result, len, offset, stride));
+}
+
+float* Ferrum::LazyEngine::ge_bffffB(Ferrum::FunctionID id, long sd, long fd,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float sa, float sha,
+                                     float sb, float shb,
+                                     float* result, long len, long offset, long stride) {
+  std::lock_guard<std::mutex> guard(lock);
+  declare(a, lena);
+  declare(result, len);
+  return deferred(pending.ge_bffffB(id, sd, fd, a, lena, offset_a, stride_a,
+                                    sa, sha, sb, shb,
+                                    result, len, offset, stride));
+}
+
+float* Ferrum::LazyEngine::ge_bbffffB(Ferrum::FunctionID id, long sd, long fd,
+                                      const float* a, long lena, long offset_a, long stride_a,
+                                      const float* b, long lenb, long offset_b, long stride_b,
+                                      float sa, float sha,
+                                      float sb, float shb,
+                                      float* result, long len, long offset, long stride) {
+  std::lock_guard<std::mutex> guard(lock);
+  declare(a, lena);
+  declare(b, lenb);
+  declare(result, len);
+  return deferred(pending.ge_bbffffB(id, sd, fd, a, lena, offset_a, stride_a,
+                                     b, lenb, offset_b, stride_b,
+                                     sa, sha, sb, shb,
+                                     result, len, offset, stride));
+}
+
+// general uplo functions
+float* Ferrum::LazyEngine::uplo_bB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* result, long len, long offset, long stride) {
+  std::lock_guard<std::mutex> guard(lock);
+  declare(a, lena);
+  declare(result, len);
+  return deferred(pending.uplo_bB(id, sd, unit, bottom, a, lena, offset_a, stride_a, result, len, offset, stride));
+}
+
+float* Ferrum::LazyEngine::uplo_bfB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                    const float* a, long lena, long offset_a, long stride_a,
+                                    float sa,
+                                    float* result, long len, long offset, long stride) {
+  std::lock_guard<std::mutex> guard(lock);
+  declare(a, lena);
+  declare(result, len);
+  return deferred(pending.uplo_bfB(id, sd, unit, bottom, a, lena, offset_a, stride_a, sa, result, len, offset, stride));
+}
+
+float* Ferrum::LazyEngine::uplo_fbB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                    const float* a, long lena, long offset_a, long stride_a,
+                                    float sa,
+                                    float* result, long len, long offset, long stride) {
+  std::lock_guard<std::mutex> guard(lock);
+  declare(a, lena);
+  declare(result, len);
+  return deferred(pending.uplo_fbB(id, sd, unit, bottom, a, lena, offset_a, stride_a, sa, result, len, offset, stride));
+}
+
+float* Ferrum::LazyEngine::uplo_bbB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                    const float* a, long lena, long offset_a, long stride_a,
+                                    const float* b, long lenb, long offset_b, long stride_b,
+                                    float* result, long len, long offset, long stride) {
+  std::lock_guard<std::mutex> guard(lock);
+  declare(a, lena);
+  declare(b, lenb);
+  declare(result, len);
+  return deferred(pending.uplo_bbB(id, sd, unit, bottom, a, lena, offset_a, stride_a,
+                                   b, lenb, offset_b, stride_b,
+                                   result, len, offset, stride));
+}
+
+float* Ferrum::LazyEngine::uplo_bBB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                    const float* a, long lena, long offset_a, long stride_a,
+                                    float* b, long lenb, long offset_b, long stride_b,
+                                    float* result, long len, long offset, long stride) {
+  std::lock_guard<std::mutex> guard(lock);
+  declare(a, lena);
+  declare(b, lenb);
+  declare(result, len);
+  return deferred(pending.uplo_bBB(id, sd, unit, bottom, a, lena, offset_a, stride_a,
+                                   b, lenb, offset_b, stride_b,
+                                   result, len, offset, stride));
+}
+
+float* Ferrum::LazyEngine::uplo_bffffB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                       const float* a, long lena, long offset_a, long stride_a,
+                                       float sa, float sha,
+                                       float sb, float shb,
+                                       float* result, long len, long offset, long stride) {
+  std::lock_guard<std::mutex> guard(lock);
+  declare(a, lena);
+  declare(result, len);
+  return deferred(pending.uplo_bffffB(id, sd, unit, bottom, a, lena, offset_a, stride_a,
+                                      sa, sha, sb, shb,
+                                      result, len, offset, stride));
+}
+
+float* Ferrum::LazyEngine::uplo_bbffffB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                        const float* a, long lena, long offset_a, long stride_a,
+                                        const float* b, long lenb, long offset_b, long stride_b,
+                                        float sa, float sha,
+                                        float sb, float shb,
+                                        float* result, long len, long offset, long stride) {
+  std::lock_guard<std::mutex> guard(lock);
+  declare(a, lena);
+  declare(b, lenb);
+  declare(result, len);
+  return deferred(pending.uplo_bbffffB(id, sd, unit, bottom, a, lena, offset_a, stride_a,
+                                       b, lenb, offset_b, stride_b,
+                                       sa, sha, sb, shb,
+                                       result, len, offset, stride));
+}
+
+// linear algebra functions
+
+float* Ferrum::LazyEngine::gemm(int transA, int transB, long m, long n, long k, float alpha,
+                                const float* a, long lena, long offset_a, long lda,
+                                const float* b, long lenb, long offset_b, long ldb,
+                                float beta, float* c, long lenc, long offset_c, long ldc) {
+  // a product reads whole matrices, so the calls that wrote them run first. Scratch stays scratch:
+  // this call may read it, so what the deferred calls leave there is not dead yet.
+  std::lock_guard<std::mutex> guard(lock);
+  if (!run(false)) {
+    return nullptr;
+  }
+  return engine->gemm(transA, transB, m, n, k, alpha, a, lena, offset_a, lda, b, lenb, offset_b, ldb,
+                      beta, c, lenc, offset_c, ldc);
+}
+
+float* Ferrum::LazyEngine::gemv(int trans, long m, long n, float alpha,
+                                const float* a, long lena, long offset_a, long lda,
+                                const float* x, long lenx, long offset_x, long stride_x,
+                                float beta, float* y, long leny, long offset_y, long stride_y) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (!run(false)) {
+    return nullptr;
+  }
+  return engine->gemv(trans, m, n, alpha, a, lena, offset_a, lda, x, lenx, offset_x, stride_x,
+                      beta, y, leny, offset_y, stride_y);
+}
+
+float* Ferrum::LazyEngine::ger(long m, long n, float alpha,
+                               const float* x, long lenx, long offset_x, long stride_x,
+                               const float* y, long leny, long offset_y, long stride_y,
+                               float* a, long lena, long offset_a, long lda) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (!run(false)) {
+    return nullptr;
+  }
+  return engine->ger(m, n, alpha, x, lenx, offset_x, stride_x, y, leny, offset_y, stride_y,
+                     a, lena, offset_a, lda);
+}
+
+float* Ferrum::LazyEngine::trmv(int trans, long sd, int unit, int bottom,
+                                const float* a, long lena, long offset_a, long lda,
+                                float* x, long lenx, long offset_x, long stride_x) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (!run(false)) {
+    return nullptr;
+  }
+  return engine->trmv(trans, sd, unit, bottom, a, lena, offset_a, lda, x, lenx, offset_x, stride_x);
+}
+
+float* Ferrum::LazyEngine::trsv(int trans, long sd, int unit, int bottom,
+                                const float* a, long lena, long offset_a, long lda,
+                                float* x, long lenx, long offset_x, long stride_x) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (!run(false)) {
+    return nullptr;
+  }
+  return engine->trsv(trans, sd, unit, bottom, a, lena, offset_a, lda, x, lenx, offset_x, stride_x);
+}
+
+float* Ferrum::LazyEngine::trmm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                                const float* a, long lena, long offset_a, long lda,
+                                float* b, long lenb, long offset_b, long ldb) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (!run(false)) {
+    return nullptr;
+  }
+  return engine->trmm(side, trans, m, n, unit, bottom, alpha, a, lena, offset_a, lda, b, lenb, offset_b, ldb);
+}
+
+float* Ferrum::LazyEngine::trsm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                                const float* a, long lena, long offset_a, long lda,
+                                float* b, long lenb, long offset_b, long ldb) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (!run(false)) {
+    return nullptr;
+  }
+  return engine->trsm(side, trans, m, n, unit, bottom, alpha, a, lena, offset_a, lda, b, lenb, offset_b, ldb);
+}
+
+float* Ferrum::LazyEngine::syrk(int trans, long n, long k, int bottom, float alpha,
+                                const float* a, long lena, long offset_a, long lda,
+                                float beta, float* c, long lenc, long offset_c, long ldc) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (!run(false)) {
+    return nullptr;
+  }
+  return engine->syrk(trans, n, k, bottom, alpha, a, lena, offset_a, lda, beta, c, lenc, offset_c, ldc);
+}
+
+float* Ferrum::LazyEngine::potrf(long sd, int bottom, float* a, long lena, long offset_a, long lda) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (!run(false)) {
+    return nullptr;
+  }
+  return engine->potrf(sd, bottom, a, lena, offset_a, lda);
+}
+
+float* Ferrum::LazyEngine::potrs(long sd, long n, int bottom, const float* a, long lena, long offset_a, long lda,
+                                 float* b, long lenb, long offset_b, long ldb) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (!run(false)) {
+    return nullptr;
+  }
+  return engine->potrs(sd, n, bottom, a, lena, offset_a, lda, b, lenb, offset_b, ldb);
+}
+
+float* Ferrum::LazyEngine::trttp(long sd, int bottom, const float* a, long lena, long offset_a, long lda,
+                                 float* ap, long lenap, long offset_ap) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (!run(false)) {
+    return nullptr;
+  }
+  return engine->trttp(sd, bottom, a, lena, offset_a, lda, ap, lenap, offset_ap);
+}
+
+float* Ferrum::LazyEngine::tpttr(long sd, int bottom, const float* ap, long lenap, long offset_ap,
+                                 float* a, long lena, long offset_a, long lda) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (!run(false)) {
+    return nullptr;
+  }
+  return engine->tpttr(sd, bottom, ap, lenap, offset_ap, a, lena, offset_a, lda);
+}
+
+float* Ferrum::LazyEngine::tpmv(int trans, long sd, int unit, int bottom, const float* ap, long lenap, long offset_ap,
+                                float* x, long lenx, long offset_x, long stride_x) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (!run(false)) {
+    return nullptr;
+  }
+  return engine->tpmv(trans, sd, unit, bottom, ap, lenap, offset_ap, x, lenx, offset_x, stride_x);
+}
+
+float* Ferrum::LazyEngine::spmv(long sd, int bottom, float alpha, const float* ap, long lenap, long offset_ap,
+                                const float* x, long lenx, long offset_x, long stride_x,
+                                float beta, float* y, long leny, long offset_y, long stride_y) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (!run(false)) {
+    return nullptr;
+  }
+  return engine->spmv(sd, bottom, alpha, ap, lenap, offset_ap, x, lenx, offset_x, stride_x,
+                      beta, y, leny, offset_y, stride_y);
+}
+
+float* Ferrum::LazyEngine::omatcopy(int trans, long m, long n, float alpha,
+                                    const float* a, long lena, long offset_a, long lda,
+                                    float* b, long lenb, long offset_b, long ldb) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (!run(false)) {
+    return nullptr;
+  }
+  return engine->omatcopy(trans, m, n, alpha, a, lena, offset_a, lda, b, lenb, offset_b, ldb);
+}
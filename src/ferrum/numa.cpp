@@ -0,0 +1,142 @@
+#include "numa.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Memory policies from <linux/mempolicy.h>. The system call is used directly so that
+// there is no dependency on libnuma.
+static const int MPOL_PREFERRED_MODE = 1;
+static const int MPOL_INTERLEAVE_MODE = 3;
+
+// Parses a sysfs CPU list, such as "0-3,8-11"
+static std::vector<int> parseCpuList(const std::string& list) {
+  std::vector<int> cpus;
+  std::stringstream ranges(list);
+  std::string range;
+  while (std::getline(ranges, range, ',')) {
+    if (range.empty() || range == "\n") {
+      continue;
+    }
+    size_t dash = range.find('-');
+    int first = std::stoi(range.substr(0, dash));
+    int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+    for (int cpu = first; cpu <= last; cpu++) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+static std::vector<Ferrum::NumaNode> detectNodes() {
+  std::vector<Ferrum::NumaNode> nodes;
+#ifdef __linux__
+  const char* root = "/sys/devices/system/node";
+  DIR* dir = opendir(root);
+  if (dir != nullptr) {
+    while (struct dirent* entry = readdir(dir)) {
+      std::string name = entry->d_name;
+      if (name.rfind("node", 0) != 0 || name.size() == 4 ||
+          !std::all_of(name.begin() + 4, name.end(), ::isdigit)) {
+        continue;
+      }
+      std::ifstream cpulist(std::string(root) + "/" + name + "/cpulist");
+      std::string list;
+      std::getline(cpulist, list);
+      std::vector<int> cpus = parseCpuList(list);
+      // memory-only nodes have no CPUs to schedule on
+      if (!cpus.empty()) {
+        nodes.push_back(Ferrum::NumaNode{std::stoi(name.substr(4)), cpus});
+      }
+    }
+    closedir(dir);
+  }
+  std::sort(nodes.begin(), nodes.end(),
+            [](const Ferrum::NumaNode& a, const Ferrum::NumaNode& b) { return a.id < b.id; });
+#endif
+  if (nodes.empty()) {
+    Ferrum::NumaNode node{0, {}};
+    int count = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    for (int cpu = 0; cpu < count; cpu++) {
+      node.cpus.push_back(cpu);
+    }
+    nodes.push_back(node);
+  }
+  return nodes;
+}
+
+Ferrum::NumaTopology::NumaTopology(const std::vector<NumaNode>& nodes) : nodeList(nodes) {
+  if (nodeList.empty()) {
+    nodeList.push_back(NumaNode{0, {0}});
+  }
+}
+
+const Ferrum::NumaTopology& Ferrum::NumaTopology::host() {
+  static const NumaTopology topology(detectNodes());
+  return topology;
+}
+
+int Ferrum::NumaTopology::nodeOfCpu(int cpu) const {
+  for (int n = 0; n < nodeCount(); n++) {
+    const std::vector<int>& cpus = nodeList[n].cpus;
+    if (std::find(cpus.begin(), cpus.end(), cpu) != cpus.end()) {
+      return n;
+    }
+  }
+  return 0;
+}
+
+std::vector<int> Ferrum::NumaTopology::cpus() const {
+  std::vector<int> all;
+  for (const NumaNode& node : nodeList) {
+    all.insert(all.end(), node.cpus.begin(), node.cpus.end());
+  }
+  return all;
+}
+
+#ifdef __linux__
+static bool setPolicy(void* data, size_t bytes, int mode, unsigned long mask) {
+  // the kernel reads maxnode - 1 bits of the mask
+  return syscall(SYS_mbind, data, bytes, mode, &mask, sizeof(mask) * 8 + 1, 0) == 0;
+}
+#endif
+
+bool Ferrum::NumaTopology::preferNode(void* data, size_t bytes, int node) const {
+#ifdef __linux__
+  // a single node topology may still be one node of a larger host
+  int id = nodeList[node].id;
+  if (host().nodeCount() > 1 && id < static_cast<int>(sizeof(unsigned long) * 8)) {
+    return setPolicy(data, bytes, MPOL_PREFERRED_MODE, 1UL << id);
+  }
+#endif
+  (void)data;
+  (void)bytes;
+  (void)node;
+  return false;
+}
+
+bool Ferrum::NumaTopology::interleave(void* data, size_t bytes) const {
+#ifdef __linux__
+  unsigned long mask = 0;
+  for (const NumaNode& node : nodeList) {
+    if (node.id < static_cast<int>(sizeof(unsigned long) * 8)) {
+      mask |= 1UL << node.id;
+    }
+  }
+  if (nodeCount() > 1) {
+    return setPolicy(data, bytes, MPOL_INTERLEAVE_MODE, mask);
+  }
+#endif
+  (void)data;
+  (void)bytes;
+  return false;
+}
@@ -0,0 +1,41 @@
+#include "pool.hpp"
+
+#include <cstdlib>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// The smallest size class. Smaller requests share this class.
+static const int MIN_CLASS = 8;  // 256 bytes
+
+int Ferrum::sizeClass(size_t bytes, size_t& classBytes) {
+  int cls = MIN_CLASS;
+  while ((size_t(1) << cls) < bytes) {
+    cls++;
+  }
+  classBytes = size_t(1) << cls;
+  return cls;
+}
+
+// HostAllocator
+
+Ferrum::HostBlock Ferrum::HostAllocator::allocate(size_t bytes) {
+  bool huge = hugePages && bytes >= HUGE_PAGE_SIZE;
+  size_t alignment = huge ? HUGE_PAGE_SIZE : ALIGNMENT;
+  void* data = nullptr;
+  if (posix_memalign(&data, alignment, bytes) != 0) {
+    return HostBlock{nullptr, 0};
+  }
+#ifdef MADV_HUGEPAGE
+  // only a hint: transparent huge pages may be disabled on this host
+  if (huge) {
+    madvise(data, bytes, MADV_HUGEPAGE);
+  }
+#endif
+  return HostBlock{data, bytes};
+}
+
+void Ferrum::HostAllocator::free(Ferrum::HostBlock block) {
+  std::free(block.data);
+}
@@ -0,0 +1,651 @@
+#include "split.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+// Weight of the newest measurement in the moving average of throughput
+static const double RATE_ALPHA = 0.25;
+
+// The array length that holds count elements at a stride, in either direction
+static long span(long count, long stride) {
+  return (count - 1) * (stride < 0 ? -stride : stride) + 1;
+}
+
+// The lowest index of a part of an n element vector. With a negative stride the part's
+// elements run backwards from its far end, as the whole vector's do.
+static long partOffset(long offset, long stride, long n, long begin, long count) {
+  return Ferrum::firstIndex(offset, stride, n) + (stride < 0 ? begin + count - 1 : begin) * stride;
+}
+
+// Tests that an sd x fd column major matrix lies within its array. Matrices that do not
+// are passed whole to a backend, which rejects them.
+static bool fits(long sd, long fd, long len, long offset, long ld) {
+  return offset >= 0 && ld >= sd && offset + (sd - 1) + (fd - 1) * ld < len;
+}
+
+// The array length that holds count columns of sd rows, ld apart
+static long columnSpan(long sd, long count, long ld) {
+  return (count - 1) * ld + sd;
+}
+
+Ferrum::SplitEngine::SplitEngine(const std::vector<Ferrum::Backend*>& backends, long minSplit) :
+    engines(backends) {
+  int k = static_cast<int>(engines.size());
+  // every part must be able to hold its minimum
+  this->minSplit = std::max(minSplit, 2 * MIN_PART * k);
+  // the caller runs one part, and a lane thread runs each of the others
+  lanes = new ThreadPool(k - 1);
+}
+
+Ferrum::SplitEngine::~SplitEngine() {
+  delete lanes;
+  for (Backend* engine : engines) {
+    delete engine;
+  }
+}
+
+// Kernel ids are shared by the whole process, so each backend returns the same one
+Ferrum::FunctionID Ferrum::SplitEngine::compile(const std::string& expression, Ferrum::KernelShape shape) {
+  FunctionID id = FunctionID::UNKNOWN;
+  for (Backend* engine : engines) {
+    id = engine->compile(expression, shape);
+    if (id == FunctionID::UNKNOWN) {
+      return id;
+    }
+  }
+  return id;
+}
+
+std::vector<double> Ferrum::SplitEngine::throughput(Ferrum::FunctionID id) const {
+  std::lock_guard<std::mutex> guard(lock);
+  std::vector<double> measured(engines.size(), 0.0);
+  auto it = rates.find(static_cast<int>(id));
+  if (it != rates.end()) {
+    for (size_t i = 0; i < measured.size(); i++) {
+      measured[i] = it->second[i] * 1e9;
+    }
+  }
+  return measured;
+}
+
+// Unmeasured backends are assumed to match the average of the measured ones
+std::vector<double> Ferrum::SplitEngine::shares(Ferrum::FunctionID id) const {
+  std::vector<double> weights = throughput(id);
+  double known = 0.0;
+  int measured = 0;
+  for (double w : weights) {
+    if (w > 0.0) {
+      known += w;
+      measured++;
+    }
+  }
+  double guess = measured == 0 ? 1.0 : known / measured;
+  double total = 0.0;
+  for (double& w : weights) {
+    if (w <= 0.0) {
+      w = guess;
+    }
+    total += w;
+  }
+  for (double& w : weights) {
+    w /= total;
+  }
+  return weights;
+}
+
+int Ferrum::SplitEngine::fastest(Ferrum::FunctionID id) const {
+  std::vector<double> weights = shares(id);
+  return static_cast<int>(std::max_element(weights.begin(), weights.end()) - weights.begin());
+}
+
+// The number of units (elements or columns) for each backend. Every backend gets at least
+// minPart units, and the rounding is taken up by the largest part.
+std::vector<long> Ferrum::SplitEngine::partition(Ferrum::FunctionID id, long n, long minPart) const {
+  std::vector<double> weights = shares(id);
+  std::vector<long> counts(weights.size());
+  long assigned = 0;
+  size_t largest = 0;
+  for (size_t i = 0; i < counts.size(); i++) {
+    counts[i] = std::max(minPart, static_cast<long>(n * weights[i]));
+    assigned += counts[i];
+    if (counts[i] > counts[largest]) {
+      largest = i;
+    }
+  }
+  counts[largest] += n - assigned;
+  return counts;
+}
+
+// The fewest units of width elements that make up a part
+static long minUnits(long width) {
+  return (Ferrum::SplitEngine::MIN_PART + width - 1) / width;
+}
+
+// A call of n units is split when it is large enough, and every part can have its minimum
+bool Ferrum::SplitEngine::splits(long n, long width) const {
+  return n * width >= minSplit && n >= 2 * minUnits(width) * backendCount();
+}
+
+void Ferrum::SplitEngine::record(Ferrum::FunctionID id, int backend, long count, double nanos) {
+  double rate = count / std::max(nanos, 1.0);
+  std::lock_guard<std::mutex> guard(lock);
+  std::vector<double>& measured = rates[static_cast<int>(id)];
+  if (measured.empty()) {
+    measured.resize(engines.size(), 0.0);
+  }
+  double& average = measured[backend];
+  average = average == 0.0 ? rate : average + RATE_ALPHA * (rate - average);
+}
+
+// Runs the parts of a call concurrently, one per backend, timing each part.
+// The call is n units of width elements, such as n columns of a matrix.
+float* Ferrum::SplitEngine::split(Ferrum::FunctionID id, long n, long width, float* result, const Part& part) {
+  std::vector<long> counts = partition(id, n, minUnits(width));
+  std::vector<long> begins(counts.size(), 0);
+  for (size_t i = 1; i < counts.size(); i++) {
+    begins[i] = begins[i - 1] + counts[i - 1];
+  }
+  std::atomic<bool> failed(false);
+  lanes->parallelFor(static_cast<long>(counts.size()), 1, [&](long first, long last) {
+    for (long i = first; i < last; i++) {
+      auto start = std::chrono::steady_clock::now();
+      if (part(engines[i], begins[i], counts[i]) == nullptr) {
+        failed = true;
+        continue;
+      }
+      std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+      record(id, static_cast<int>(i), counts[i] * width, elapsed.count());
+    }
+  });
+  return failed ? nullptr : result;
+}
+
+// Vectors that overrun their arrays are passed whole to a backend, which rejects them
+
+// general vector functions
+float* Ferrum::SplitEngine::vect_bB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                    float* result, long len, long offset, long stride) {
+  if (!splits(n, 1) || !holds(lena, offset_a, stride_a, n) || !holds(len, offset, stride, n)) {
+    return engines[fastest(id)]->vect_bB(id, n, a, lena, offset_a, stride_a, result, len, offset, stride);
+  }
+  return split(id, n, 1, result, [&](Backend* engine, long begin, long count) {
+    return engine->vect_bB(id, count, a + partOffset(offset_a, stride_a, n, begin, count), span(count, stride_a), 0, stride_a,
+                           result + partOffset(offset, stride, n, begin, count), span(count, stride), 0, stride);
+  });
+}
+
+float* Ferrum::SplitEngine::vect_bfB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                     float sa,
+                                     float* result, long len, long offset, long stride) {
+  if (!splits(n, 1) || !holds(lena, offset_a, stride_a, n) || !holds(len, offset, stride, n)) {
+    return engines[fastest(id)]->vect_bfB(id, n, a, lena, offset_a, stride_a, sa, result, len, offset, stride);
+  }
+  return split(id, n, 1, result, [&](Backend* engine, long begin, long count) {
+    return engine->vect_bfB(id, count, a + partOffset(offset_a, stride_a, n, begin, count), span(count, stride_a), 0, stride_a,
+                            sa,
+                            result + partOffset(offset, stride, n, begin, count), span(count, stride), 0, stride);
+  });
+}
+
+float* Ferrum::SplitEngine::vect_fbB(Ferrum::FunctionID id, long n, float sa,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float* result, long len, long offset, long stride) {
+  if (!splits(n, 1) || !holds(lena, offset_a, stride_a, n) || !holds(len, offset, stride, n)) {
+    return engines[fastest(id)]->vect_fbB(id, n, sa, a, lena, offset_a, stride_a, result, len, offset, stride);
+  }
+  return split(id, n, 1, result, [&](Backend* engine, long begin, long count) {
+    return engine->vect_fbB(id, count, sa,
+                            a + partOffset(offset_a, stride_a, n, begin, count), span(count, stride_a), 0, stride_a,
+                            result + partOffset(offset, stride, n, begin, count), span(count, stride), 0, stride);
+  });
+}
+
+float* Ferrum::SplitEngine::vect_bbB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                     const float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) {
+  if (!splits(n, 1) || !holds(lena, offset_a, stride_a, n) || !holds(lenb, offset_b, stride_b, n) ||
+      !holds(len, offset, stride, n)) {
+    return engines[fastest(id)]->vect_bbB(id, n, a, lena, offset_a, stride_a,
+                                          b, lenb, offset_b, stride_b,
+                                          result, len, offset, stride);
+  }
+  return split(id, n, 1, result, [&](Backend* engine, long begin, long count) {
+    return engine->vect_bbB(id, count, a + partOffset(offset_a, stride_a, n, begin, count), span(count, stride_a), 0, stride_a,
+                            b + partOffset(offset_b, stride_b, n, begin, count), span(count, stride_b), 0, stride_b,
+                            result + partOffset(offset, stride, n, begin, count), span(count, stride), 0, stride);
+  });
+}
+
+float* Ferrum::SplitEngine::vect_bBB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                     float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) {
+  if (!splits(n, 1) || !holds(lena, offset_a, stride_a, n) || !holds(lenb, offset_b, stride_b, n) ||
+      !holds(len, offset, stride, n)) {
+    return engines[fastest(id)]->vect_bBB(id, n, a, lena, offset_a, stride_a,
+                                          b, lenb, offset_b, stride_b,
+                                          result, len, offset, stride);
+  }
+  return split(id, n, 1, result, [&](Backend* engine, long begin, long count) {
+    return engine->vect_bBB(id, count, a + partOffset(offset_a, stride_a, n, begin, count), span(count, stride_a), 0, stride_a,
+                            b + partOffset(offset_b, stride_b, n, begin, count), span(count, stride_b), 0, stride_b,
+                            result + partOffset(offset, stride, n, begin, count), span(count, stride), 0, stride);
+  });
+}
+
+float* Ferrum::SplitEngine::vect_bffffB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                        float sa, float sha,
+                                        float sb, float shb,
+                                        float* result, long len, long offset, long stride) {
+  if (!splits(n, 1) || !holds(lena, offset_a, stride_a, n) || !holds(len, offset, stride, n)) {
+    return engines[fastest(id)]->vect_bffffB(id, n, a, lena, offset_a, stride_a, sa, sha, sb, shb,
+                                             result, len, offset, stride);
+  }
+  return split(id, n, 1, result, [&](Backend* engine, long begin, long count) {
+    return engine->vect_bffffB(id, count, a + partOffset(offset_a, stride_a, n, begin, count), span(count, stride_a), 0, stride_a,
+                               sa, sha, sb, shb,
+                               result + partOffset(offset, stride, n, begin, count), span(count, stride), 0, stride);
+  });
+}
+
+float* Ferrum::SplitEngine::vect_bbffffB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                         const float* b, long lenb, long offset_b, long stride_b,
+                                         float sa, float sha,
+                                         float sb, float shb,
+                                         float* result, long len, long offset, long stride) {
+  if (!splits(n, 1) || !holds(lena, offset_a, stride_a, n) || !holds(lenb, offset_b, stride_b, n) ||
+      !holds(len, offset, stride, n)) {
+    return engines[fastest(id)]->vect_bbffffB(id, n, a, lena, offset_a, stride_a,
+                                              b, lenb, offset_b, stride_b,
+                                              sa, sha, sb, shb,
+                                              result, len, offset, stride);
+  }
+  return split(id, n, 1, result, [&](Backend* engine, long begin, long count) {
+    return engine->vect_bbffffB(id, count, a + partOffset(offset_a, stride_a, n, begin, count), span(count, stride_a), 0, stride_a,
+                                b + partOffset(offset_b, stride_b, n, begin, count), span(count, stride_b), 0, stride_b,
+                                sa, sha, sb, shb,
+                                result + partOffset(offset, stride, n, begin, count), span(count, stride), 0, stride);
+  });
+}
+
+// Matrices are split by columns, and uplo matrices are not split
+
+// general matrix functions
+float* Ferrum::SplitEngine::ge_bB(Ferrum::FunctionID id, long sd, long fd,
+                                  const float* a, long lena, long offset_a, long stride_a,
+                                  float* result, long len, long offset, long stride) {
+  if (!splits(fd, sd) || !fits(sd, fd, lena, offset_a, stride_a) ||
+      !fits(sd, fd, len, offset, stride)) {
+    return engines[fastest(id)]->ge_bB(id, sd, fd, a, lena, offset_a, stride_a, result, len, offset, stride);
+  }
+  return split(id, fd, sd, result, [&](Backend* engine, long begin, long count) {
+    return engine->ge_bB(id, sd, count,
+                         a + offset_a + begin * stride_a, columnSpan(sd, count, stride_a), 0, stride_a,
+                         result + offset + begin * stride, columnSpan(sd, count, stride), 0, stride);
+  });
+}
+
+float* Ferrum::SplitEngine::ge_bfB(Ferrum::FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float sa,
+                                   float* result, long len, long offset, long stride) {
+  if (!splits(fd, sd) || !fits(sd, fd, lena, offset_a, stride_a) ||
+      !fits(sd, fd, len, offset, stride)) {
+    return engines[fastest(id)]->ge_bfB(id, sd, fd, a, lena, offset_a, stride_a, sa, result, len, offset, stride);
+  }
+  return split(id, fd, sd, result, [&](Backend* engine, long begin, long count) {
+    return engine->ge_bfB(id, sd, count,
+                          a + offset_a + begin * stride_a, columnSpan(sd, count, stride_a), 0, stride_a,
+                          sa,
+                          result + offset + begin * stride, columnSpan(sd, count, stride), 0, stride);
+  });
+}
+
+float* Ferrum::SplitEngine::ge_fbB(Ferrum::FunctionID id, long sd, long fd, float sa,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* result, long len, long offset, long stride) {
+  if (!splits(fd, sd) || !fits(sd, fd, lena, offset_a, stride_a) ||
+      !fits(sd, fd, len, offset, stride)) {
+    return engines[fastest(id)]->ge_fbB(id, sd, fd, sa, a, lena, offset_a, stride_a, result, len, offset, stride);
+  }
+  return split(id, fd, sd, result, [&](Backend* engine, long begin, long count) {
+    return engine->ge_fbB(id, sd, count, sa,
+                          a + offset_a + begin * stride_a, columnSpan(sd, count, stride_a), 0, stride_a,
+                          result + offset + begin * stride, columnSpan(sd, count, stride), 0, stride);
+  });
+}
+
+float* Ferrum::SplitEngine::ge_bbB(Ferrum::FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   const float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) {
+  if (!splits(fd, sd) || !fits(sd, fd, lena, offset_a, stride_a) ||
+      !fits(sd, fd, lenb, offset_b, stride_b) || !fits(sd, fd, len, offset, stride)) {
+    return engines[fastest(id)]->ge_bbB(id, sd, fd, a, lena, offset_a, stride_a,
+                                        b, lenb, offset_b, stride_b,
+                                        result, len, offset, stride);
+  }
+  return split(id, fd, sd, result, [&](Backend* engine, long begin, long count) {
+    return engine->ge_bbB(id, sd, count,
+                          a + offset_a + begin * stride_a, columnSpan(sd, count, stride_a), 0, stride_a,
+                          b + offset_b + begin * stride_b, columnSpan(sd, count, stride_b), 0, stride_b,
+                          result + offset + begin * stride, columnSpan(sd, count, stride), 0, stride);
+  });
+}
+
+float* Ferrum::SplitEngine::ge_bBB(Ferrum::FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) {
+  if (!splits(fd, sd) || !fits(sd, fd, lena, offset_a, stride_a) ||
+      !fits(sd, fd, lenb, offset_b, stride_b) || !fits(sd, fd, len, offset, stride)) {
+    return engines[fastest(id)]->ge_bBB(id, sd, fd, a, lena, offset_a, stride_a,
+                                        b, lenb, offset_b, stride_b,
+                                        result, len, offset, stride);
+  }
+  return split(id, fd, sd, result, [&](Backend* engine, long begin, long count) {
+    return engine->ge_bBB(id, sd, count,
+                          a + offset_a + begin * stride_a, columnSpan(sd, count, stride_a), 0, stride_a,
+                          b + offset_b + begin * stride_b, columnSpan(sd, count, stride_b), 0, stride_b,
+                          result + offset + begin * stride, columnSpan(sd, count, stride), 0, stride);
+  });
+}
+
+float* Ferrum::SplitEngine::ge_bffffB(Ferrum::FunctionID id, long sd, long fd,
+                                      const float* a, long lena, long offset_a, long stride_a,
+                                      float sa, float sha,
+                                      float sb, float shb,
+                                      float* result, long len, long offset, long stride) {
+  if (!splits(fd, sd) || !fits(sd, fd, lena, offset_a, stride_a) ||
+      !fits(sd, fd, len, offset, stride)) {
+    return engines[fastest(id)]->ge_bffffB(id, sd, fd, a, lena, offset_a, stride_a,
+                                           sa, sha, sb, shb,
+                                           result, len, offset, stride);
+  }
+  return split(id, fd, sd, result, [&](Backend* engine, long begin, long count) {
+    return engine->ge_bffffB(id, sd, count,
+                             a + offset_a + begin * stride_a, columnSpan(sd, count, stride_a), 0, stride_a,
+                             sa, sha,
+                             sb, shb,
+                             result + offset + begin * stride, columnSpan(sd, count, stride), 0, stride);
+  });
+}
+
+float* Ferrum::SplitEngine::ge_bbffffB(Ferrum::FunctionID id, long sd, long fd,
+                                       const float* a, long lena, long offset_a, long stride_a,
+                                       const float* b, long lenb, long offset_b, long stride_b,
+                                       float sa, float sha,
+                                       float sb, float shb,
+                                       float* result, long len, long offset, long stride) {
+  if (!splits(fd, sd) || !fits(sd, fd, lena, offset_a, stride_a) ||
+      !fits(sd, fd, lenb, offset_b, stride_b) || !fits(sd, fd, len, offset, stride)) {
+    return engines[fastest(id)]->ge_bbffffB(id, sd, fd, a, lena, offset_a, stride_a,
+                                            b, lenb, offset_b, stride_b,
+                                            sa, sha, sb, shb,
+                                            result, len, offset, stride);
+  }
+  return split(id, fd, sd, result, [&](Backend* engine, long begin, long count) {
+    return engine->ge_bbffffB(id, sd, count,
+                              a + offset_a + begin * stride_a, columnSpan(sd, count, stride_a), 0, stride_a,
+                              b + offset_b + begin * stride_b, columnSpan(sd, count, stride_b), 0, stride_b,
+                              sa, sha,
+                              sb, shb,
+                              result + offset + begin * stride, columnSpan(sd, count, stride), 0, stride);
+  });
+}
+
+// general uplo functions
+float* Ferrum::SplitEngine::uplo_bB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                    const float* a, long lena, long offset_a, long stride_a,
+                                    float* result, long len, long offset, long stride) {
+  return engines[0]->uplo_bB(id, sd, unit, bottom, a, lena, offset_a, stride_a, result, len, offset, stride);
+}
+
+float* Ferrum::SplitEngine::uplo_bfB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float sa,
+                                     float* result, long len, long offset, long stride) {
+  return engines[0]->uplo_bfB(id, sd, unit, bottom, a, lena, offset_a, stride_a, sa, result, len, offset, stride);
+}
+
+float* Ferrum::SplitEngine::uplo_fbB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float sa,
+                                     float* result, long len, long offset, long stride) {
+  return engines[0]->uplo_fbB(id, sd, unit, bottom, a, lena, offset_a, stride_a, sa, result, len, offset, stride);
+}
+
+float* Ferrum::SplitEngine::uplo_bbB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     const float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) {
+  return engines[0]->uplo_bbB(id, sd, unit, bottom, a, lena, offset_a, stride_a,
+                              b, lenb, offset_b, stride_b,
+                              result, len, offset, stride);
+}
+
+float* Ferrum::SplitEngine::uplo_bBB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) {
+  return engines[0]->uplo_bBB(id, sd, unit, bottom, a, lena, offset_a, stride_a,
+                              b, lenb, offset_b, stride_b,
+                              result, len, offset, stride);
+}
+
+float* Ferrum::SplitEngine::uplo_bffffB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                        const float* a, long lena, long offset_a, long stride_a,
+                                        float sa, float sha,
+                                        float sb, float shb,
+                                        float* result, long len, long offset, long stride) {
+  return engines[0]->uplo_bffffB(id, sd, unit, bottom, a, lena, offset_a, stride_a,
+                                 sa, sha, sb, shb,
+                                 result, len, offset, stride);
+}
+
+float* Ferrum::SplitEngine::uplo_bbffffB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                         const float* a, long lena, long offset_a, long stride_a,
+                                         const float* b, long lenb, long offset_b, long stride_b,
+                                         float sa, float sha,
+                                         float sb, float shb,
+                                         float* result, long len, long offset, long stride) {
+  return engines[0]->uplo_bbffffB(id, sd, unit, bottom, a, lena, offset_a, stride_a,
+                                  b, lenb, offset_b, stride_b,
+                                  sa, sha, sb, shb,
+                                  result, len, offset, stride);
+}
+
+// linear algebra functions
+
+float* Ferrum::SplitEngine::gemm(int transA, int transB, long m, long n, long k, float alpha,
+                                 const float* a, long lena, long offset_a, long lda,
+                                 const float* b, long lenb, long offset_b, long ldb,
+                                 float beta, float* c, long lenc, long offset_c, long ldc) {
+  FunctionID id = FunctionID::blas_gemm;
+  bool ta = transA == TRANS;
+  bool tb = transB == TRANS;
+  // each part is a block of columns of C, from the same columns of op(B) and all of op(A)
+  if (!splits(n, m * k) || !fits(ta ? k : m, ta ? m : k, lena, offset_a, lda) ||
+      !fits(tb ? n : k, tb ? k : n, lenb, offset_b, ldb) || !fits(m, n, lenc, offset_c, ldc)) {
+    return engines[fastest(id)]->gemm(transA, transB, m, n, k, alpha, a, lena, offset_a, lda, b, lenb, offset_b, ldb,
+                                      beta, c, lenc, offset_c, ldc);
+  }
+  return split(id, n, m * k, c, [&](Backend* engine, long begin, long count) {
+    return engine->gemm(transA, transB, m, count, k, alpha, a, lena, offset_a, lda,
+                        b, lenb, tb ? offset_b + begin : offset_b + begin * ldb, ldb,
+                        beta, c + offset_c + begin * ldc, columnSpan(m, count, ldc), 0, ldc);
+  });
+}
+
+float* Ferrum::SplitEngine::gemv(int trans, long m, long n, float alpha,
+                                 const float* a, long lena, long offset_a, long lda,
+                                 const float* x, long lenx, long offset_x, long stride_x,
+                                 float beta, float* y, long leny, long offset_y, long stride_y) {
+  bool t = trans == TRANS;
+  FunctionID id = t ? FunctionID::blas_gemv_t : FunctionID::blas_gemv_n;
+  long rows = t ? n : m;
+  // each part is a block of y, from the same rows (or, transposed, columns) of A and all of x
+  if (!splits(rows, t ? m : n) || !fits(m, n, lena, offset_a, lda) ||
+      !holds(lenx, offset_x, stride_x, t ? m : n) || !holds(leny, offset_y, stride_y, rows)) {
+    return engines[fastest(id)]->gemv(trans, m, n, alpha, a, lena, offset_a, lda, x, lenx, offset_x, stride_x,
+                                      beta, y, leny, offset_y, stride_y);
+  }
+  return split(id, rows, t ? m : n, y, [&](Backend* engine, long begin, long count) {
+    const float* part = a + offset_a + (t ? begin * lda : begin);
+    return engine->gemv(trans, t ? m : count, t ? count : n, alpha,
+                        part, t ? columnSpan(m, count, lda) : columnSpan(count, n, lda), 0, lda,
+                        x, lenx, offset_x, stride_x,
+                        beta, y + partOffset(offset_y, stride_y, rows, begin, count), span(count, stride_y),
+                        0, stride_y);
+  });
+}
+
+float* Ferrum::SplitEngine::ger(long m, long n, float alpha,
+                                const float* x, long lenx, long offset_x, long stride_x,
+                                const float* y, long leny, long offset_y, long stride_y,
+                                float* a, long lena, long offset_a, long lda) {
+  FunctionID id = FunctionID::blas_ger;
+  // each part is a block of columns of A, from the same elements of y and all of x
+  if (!splits(n, m) || !holds(lenx, offset_x, stride_x, m) || !holds(leny, offset_y, stride_y, n) ||
+      !fits(m, n, lena, offset_a, lda)) {
+    return engines[fastest(id)]->ger(m, n, alpha, x, lenx, offset_x, stride_x, y, leny, offset_y, stride_y,
+                                     a, lena, offset_a, lda);
+  }
+  return split(id, n, m, a, [&](Backend* engine, long begin, long count) {
+    return engine->ger(m, count, alpha, x, lenx, offset_x, stride_x,
+                       y + partOffset(offset_y, stride_y, n, begin, count), span(count, stride_y), 0, stride_y,
+                       a + offset_a + begin * lda, columnSpan(m, count, lda), 0, lda);
+  });
+}
+
+float* Ferrum::SplitEngine::trmv(int trans, long sd, int unit, int bottom,
+                                 const float* a, long lena, long offset_a, long lda,
+                                 float* x, long lenx, long offset_x, long stride_x) {
+  // each element is computed from the others in place, so the call is not cut
+  return engines[fastest(FunctionID::blas_trmv)]->trmv(trans, sd, unit, bottom, a, lena, offset_a, lda,
+                                                       x, lenx, offset_x, stride_x);
+}
+
+float* Ferrum::SplitEngine::trsv(int trans, long sd, int unit, int bottom,
+                                 const float* a, long lena, long offset_a, long lda,
+                                 float* x, long lenx, long offset_x, long stride_x) {
+  return engines[fastest(FunctionID::blas_trsv)]->trsv(trans, sd, unit, bottom, a, lena, offset_a, lda,
+                                                       x, lenx, offset_x, stride_x);
+}
+
+float* Ferrum::SplitEngine::trmm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                                 const float* a, long lena, long offset_a, long lda,
+                                 float* b, long lenb, long offset_b, long ldb) {
+  FunctionID id = FunctionID::blas_trmm;
+  bool left = side == LEFT;
+  long sd = left ? m : n;
+  // each part is a block of the columns (left) or rows (right) of B, which are independent
+  if (!splits(left ? n : m, sd * sd / 2) || !fits(sd, sd, lena, offset_a, lda) ||
+      !fits(m, n, lenb, offset_b, ldb)) {
+    return engines[fastest(id)]->trmm(side, trans, m, n, unit, bottom, alpha, a, lena, offset_a, lda,
+                                    b, lenb, offset_b, ldb);
+  }
+  return split(id, left ? n : m, sd * sd / 2, b, [&](Backend* engine, long begin, long count) {
+    if (left) {
+      return engine->trmm(side, trans, m, count, unit, bottom, alpha, a, lena, offset_a, lda,
+                          b + offset_b + begin * ldb, columnSpan(m, count, ldb), 0, ldb);
+    }
+    return engine->trmm(side, trans, count, n, unit, bottom, alpha, a, lena, offset_a, lda,
+                        b + offset_b + begin, columnSpan(count, n, ldb), 0, ldb);
+  });
+}
+
+float* Ferrum::SplitEngine::trsm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                                 const float* a, long lena, long offset_a, long lda,
+                                 float* b, long lenb, long offset_b, long ldb) {
+  FunctionID id = FunctionID::blas_trsm;
+  bool left = side == LEFT;
+  long sd = left ? m : n;
+  // each part is a block of the columns (left) or rows (right) of B, which are independent
+  if (!splits(left ? n : m, sd * sd / 2) || !fits(sd, sd, lena, offset_a, lda) ||
+      !fits(m, n, lenb, offset_b, ldb)) {
+    return engines[fastest(id)]->trsm(side, trans, m, n, unit, bottom, alpha, a, lena, offset_a, lda,
+                                    b, lenb, offset_b, ldb);
+  }
+  return split(id, left ? n : m, sd * sd / 2, b, [&](Backend* engine, long begin, long count) {
+    if (left) {
+      return engine->trsm(side, trans, m, count, unit, bottom, alpha, a, lena, offset_a, lda,
+                          b + offset_b + begin * ldb, columnSpan(m, count, ldb), 0, ldb);
+    }
+    return engine->trsm(side, trans, count, n, unit, bottom, alpha, a, lena, offset_a, lda,
+                        b + offset_b + begin, columnSpan(count, n, ldb), 0, ldb);
+  });
+}
+
+float* Ferrum::SplitEngine::syrk(int trans, long n, long k, int bottom, float alpha,
+                                 const float* a, long lena, long offset_a, long lda,
+                                 float beta, float* c, long lenc, long offset_c, long ldc) {
+  // the columns of the triangle are of different lengths, and are not cut
+  return engines[fastest(FunctionID::blas_syrk)]->syrk(trans, n, k, bottom, alpha, a, lena, offset_a, lda,
+                                                       beta, c, lenc, offset_c, ldc);
+}
+
+float* Ferrum::SplitEngine::potrf(long sd, int bottom, float* a, long lena, long offset_a, long lda) {
+  // each step of the factorization needs all of the steps before it
+  return engines[fastest(FunctionID::blas_potrf)]->potrf(sd, bottom, a, lena, offset_a, lda);
+}
+
+float* Ferrum::SplitEngine::potrs(long sd, long n, int bottom, const float* a, long lena, long offset_a, long lda,
+                                  float* b, long lenb, long offset_b, long ldb) {
+  FunctionID id = FunctionID::blas_trsm;
+  // the columns of B are independent
+  if (!splits(n, sd * sd) || !fits(sd, sd, lena, offset_a, lda) || !fits(sd, n, lenb, offset_b, ldb)) {
+    return engines[fastest(id)]->potrs(sd, n, bottom, a, lena, offset_a, lda, b, lenb, offset_b, ldb);
+  }
+  return split(id, n, sd * sd, b, [&](Backend* engine, long begin, long count) {
+    return engine->potrs(sd, count, bottom, a, lena, offset_a, lda,
+                         b + offset_b + begin * ldb, columnSpan(sd, count, ldb), 0, ldb);
+  });
+}
+
+float* Ferrum::SplitEngine::trttp(long sd, int bottom, const float* a, long lena, long offset_a, long lda,
+                                  float* ap, long lenap, long offset_ap) {
+  // the packed columns are of different lengths, and are not cut
+  return engines[fastest(FunctionID::blas_trttp)]->trttp(sd, bottom, a, lena, offset_a, lda, ap, lenap, offset_ap);
+}
+
+float* Ferrum::SplitEngine::tpttr(long sd, int bottom, const float* ap, long lenap, long offset_ap,
+                                  float* a, long lena, long offset_a, long lda) {
+  return engines[fastest(FunctionID::blas_tpttr)]->tpttr(sd, bottom, ap, lenap, offset_ap, a, lena, offset_a, lda);
+}
+
+float* Ferrum::SplitEngine::tpmv(int trans, long sd, int unit, int bottom, const float* ap, long lenap, long offset_ap,
+                                 float* x, long lenx, long offset_x, long stride_x) {
+  // each element is computed from the others in place, so the call is not cut
+  return engines[fastest(FunctionID::blas_tpmv)]->tpmv(trans, sd, unit, bottom, ap, lenap, offset_ap,
+                                                       x, lenx, offset_x, stride_x);
+}
+
+float* Ferrum::SplitEngine::spmv(long sd, int bottom, float alpha, const float* ap, long lenap, long offset_ap,
+                                 const float* x, long lenx, long offset_x, long stride_x,
+                                 float beta, float* y, long leny, long offset_y, long stride_y) {
+  // every element of y reads the whole of x and a row of A that crosses the packed columns
+  return engines[fastest(FunctionID::blas_spmv)]->spmv(sd, bottom, alpha, ap, lenap, offset_ap,
+                                                       x, lenx, offset_x, stride_x, beta, y, leny, offset_y, stride_y);
+}
+
+float* Ferrum::SplitEngine::omatcopy(int trans, long m, long n, float alpha,
+                                     const float* a, long lena, long offset_a, long lda,
+                                     float* b, long lenb, long offset_b, long ldb) {
+  FunctionID id = FunctionID::blas_omatcopy;
+  bool t = trans == TRANS;
+  long rows = t ? n : m;
+  long cols = t ? m : n;
+  // each part is a block of the columns of B, which are columns of A, or rows with the transpose
+  if (!splits(cols, rows) || !fits(m, n, lena, offset_a, lda) || !fits(rows, cols, lenb, offset_b, ldb)) {
+    return engines[fastest(id)]->omatcopy(trans, m, n, alpha, a, lena, offset_a, lda, b, lenb, offset_b, ldb);
+  }
+  return split(id, cols, rows, b, [&](Backend* engine, long begin, long count) {
+    if (t) {
+      return engine->omatcopy(trans, count, n, alpha, a + offset_a + begin, columnSpan(count, n, lda), 0, lda,
+                              b + offset_b + begin * ldb, columnSpan(rows, count, ldb), 0, ldb);
+    }
+    return engine->omatcopy(trans, m, count, alpha, a + offset_a + begin * lda, columnSpan(m, count, lda), 0, lda,
+                            b + offset_b + begin * ldb, columnSpan(rows, count, ldb), 0, ldb);
+  });
+}
@@ -0,0 +1,362 @@
+#include "stream.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+static double seconds(Clock::time_point start, Clock::time_point end) {
+  return std::chrono::duration<double>(end - start).count();
+}
+
+static uintptr_t pageSize() {
+  static const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  return page;
+}
+
+namespace {
+
+  // Chunks waiting between two stages of a pipeline, by slot index
+  class Channel {
+    public:
+      void push(int slot) {
+        {
+          std::lock_guard<std::mutex> guard(lock);
+          slots.push_back(slot);
+        }
+        ready.notify_one();
+      }
+
+      // Returns false once the channel is closed and empty
+      bool pop(int& slot) {
+        std::unique_lock<std::mutex> guard(lock);
+        ready.wait(guard, [&]() { return !slots.empty() || closed; });
+        if (slots.empty()) {
+          return false;
+        }
+        slot = slots.front();
+        slots.pop_front();
+        return true;
+      }
+
+      void close() {
+        {
+          std::lock_guard<std::mutex> guard(lock);
+          closed = true;
+        }
+        ready.notify_all();
+      }
+
+    private:
+      std::mutex lock;
+      std::condition_variable ready;
+      std::deque<int> slots;
+      bool closed = false;
+  };
+
+  struct Slot {
+    Ferrum::HostBlock a;
+    Ferrum::HostBlock b;
+    Ferrum::HostBlock result;
+    long first;
+    long count;
+  };
+
+} // namespace
+
+// mapped files
+
+Ferrum::MappedFile* Ferrum::MappedFile::openRead(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  struct stat info;
+  if (fd < 0 || fstat(fd, &info) != 0) {
+    std::cerr << "Error: Failed to open " << path << std::endl;
+    if (fd >= 0) {
+      close(fd);
+    }
+    return nullptr;
+  }
+  size_t bytes = static_cast<size_t>(info.st_size);
+  void* data = nullptr;
+  if (bytes > 0) {
+    data = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+      std::cerr << "Error: Failed to map " << path << std::endl;
+      close(fd);
+      return nullptr;
+    }
+    madvise(data, bytes, MADV_SEQUENTIAL);
+  }
+  return new MappedFile(fd, static_cast<float*>(data), static_cast<long>(bytes / sizeof(float)), bytes, false);
+}
+
+Ferrum::MappedFile* Ferrum::MappedFile::create(const std::string& path, long count) {
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  size_t bytes = sizeof(float) * static_cast<size_t>(count);
+  if (fd < 0 || ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+    std::cerr << "Error: Failed to create " << path << std::endl;
+    if (fd >= 0) {
+      close(fd);
+    }
+    return nullptr;
+  }
+  void* data = nullptr;
+  if (bytes > 0) {
+    data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+      std::cerr << "Error: Failed to map " << path << std::endl;
+      close(fd);
+      return nullptr;
+    }
+    madvise(data, bytes, MADV_SEQUENTIAL);
+  }
+  return new MappedFile(fd, static_cast<float*>(data), count, bytes, true);
+}
+
+Ferrum::MappedFile::~MappedFile() {
+  if (elements != nullptr) {
+    munmap(elements, bytes);
+  }
+  close(fd);
+}
+
+void Ferrum::MappedFile::willNeed(long first, long n) const {
+  first = std::max(0L, first);
+  n = std::min(n, count - first);
+  if (n <= 0) {
+    return;
+  }
+  // every page that holds part of the range
+  uintptr_t start = reinterpret_cast<uintptr_t>(elements + first) & ~(pageSize() - 1);
+  uintptr_t end = reinterpret_cast<uintptr_t>(elements + first + n);
+  madvise(reinterpret_cast<void*>(start), end - start, MADV_WILLNEED);
+}
+
+void Ferrum::MappedFile::release(long first, long n) const {
+  first = std::max(0L, first);
+  n = std::min(n, count - first);
+  if (n <= 0) {
+    return;
+  }
+  if (writable) {
+#ifdef __linux__
+    sync_file_range(fd, static_cast<off_t>(sizeof(float) * first), static_cast<off_t>(sizeof(float) * n),
+                    SYNC_FILE_RANGE_WRITE);
+#else
+    uintptr_t start = reinterpret_cast<uintptr_t>(elements + first) & ~(pageSize() - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(elements + first + n);
+    msync(reinterpret_cast<void*>(start), end - start, MS_ASYNC);
+#endif
+    return;
+  }
+  // only the pages entirely inside the range, as the next chunk may share the last one
+  uintptr_t start = (reinterpret_cast<uintptr_t>(elements + first) + pageSize() - 1) & ~(pageSize() - 1);
+  uintptr_t end = reinterpret_cast<uintptr_t>(elements + first + n) & ~(pageSize() - 1);
+  if (start < end) {
+    madvise(reinterpret_cast<void*>(start), end - start, MADV_DONTNEED);
+  }
+}
+
+// streamer
+
+Ferrum::Streamer::Streamer(Ferrum::Backend* backend, long chunkElements) :
+    engine(backend), last() {
+  chunk = std::max(1L, chunkElements);
+  pool = new HostPool(HostAllocator());
+}
+
+Ferrum::Streamer::~Streamer() {
+  delete pool;
+}
+
+Ferrum::StreamStats Ferrum::Streamer::stats() const {
+  std::lock_guard<std::mutex> guard(lock);
+  return last;
+}
+
+float* Ferrum::Streamer::compute(Ferrum::FunctionID id, const float* a, const float* b, float* result, long n) {
+  if (b == nullptr) {
+    return engine->vect_bB(id, n, a, n, 0, 1, result, n, 0, 1);
+  }
+  return engine->vect_bbB(id, n, a, n, 0, 1, b, n, 0, 1, result, n, 0, 1);
+}
+
+// Computes straight from the input mappings into the output mapping
+bool Ferrum::Streamer::mapped(Ferrum::FunctionID id, const std::string& a, const std::string* b,
+                              const std::string& output) {
+  Clock::time_point begin = Clock::now();
+  MappedFile* inA = MappedFile::openRead(a);
+  MappedFile* inB = b == nullptr ? nullptr : MappedFile::openRead(*b);
+  MappedFile* out = nullptr;
+  bool ok = inA != nullptr && (b == nullptr || inB != nullptr);
+  long n = 0;
+  if (ok) {
+    n = inB == nullptr ? inA->size() : std::min(inA->size(), inB->size());
+    out = MappedFile::create(output, n);
+    ok = out != nullptr;
+  }
+
+  StreamStats stats{};
+  if (ok) {
+    inA->willNeed(0, chunk);
+    if (inB != nullptr) {
+      inB->willNeed(0, chunk);
+    }
+  }
+  for (long first = 0; ok && first < n; first += chunk) {
+    long count = std::min(chunk, n - first);
+    Clock::time_point start = Clock::now();
+    // the next chunk is read in the background while this one is computed
+    inA->willNeed(first + count, chunk);
+    if (inB != nullptr) {
+      inB->willNeed(first + count, chunk);
+    }
+    Clock::time_point read = Clock::now();
+    ok = compute(id, inA->data() + first, inB == nullptr ? nullptr : inB->data() + first,
+                 out->data() + first, count) != nullptr;
+    Clock::time_point computed = Clock::now();
+    inA->release(first, count);
+    if (inB != nullptr) {
+      inB->release(first, count);
+    }
+    out->release(first, count);
+    Clock::time_point written = Clock::now();
+
+    stats.elements += count;
+    stats.chunks++;
+    stats.readSeconds += seconds(start, read);
+    stats.computeSeconds += seconds(read, computed);
+    stats.writeSeconds += seconds(computed, written);
+  }
+  delete inA;
+  delete inB;
+  delete out;
+
+  stats.wallSeconds = seconds(begin, Clock::now());
+  std::lock_guard<std::mutex> guard(lock);
+  last = stats;
+  return ok;
+}
+
+// Three stages over SLOTS chunk buffers: the reader fills free slots, the caller computes
+// filled ones, and the writer drains computed ones and frees them again
+bool Ferrum::Streamer::pipeline(Ferrum::FunctionID id, const Source& a, const Source* b, const Sink& output) {
+  const int SLOTS = 3;
+  Clock::time_point begin = Clock::now();
+  size_t bytes = sizeof(float) * chunk;
+  Slot slots[SLOTS];
+  bool ok = true;
+  for (Slot& slot : slots) {
+    slot.a = pool->acquire(bytes);
+    slot.b = b == nullptr ? HostBlock{nullptr, 0} : pool->acquire(bytes);
+    slot.result = pool->acquire(bytes);
+    ok = ok && slot.a && slot.result && (b == nullptr || slot.b);
+  }
+
+  StreamStats stats{};
+  if (ok) {
+    Channel free, filled, computed;
+    for (int s = 0; s < SLOTS; s++) {
+      free.push(s);
+    }
+    std::atomic<bool> failed(false);
+
+    std::thread reader([&]() {
+      long first = 0;
+      int s;
+      while (free.pop(s)) {
+        Clock::time_point start = Clock::now();
+        Slot& slot = slots[s];
+        long count = std::min(chunk, a(static_cast<float*>(slot.a.data), first, chunk));
+        if (b != nullptr) {
+          count = std::min(count, (*b)(static_cast<float*>(slot.b.data), first, count));
+        }
+        stats.readSeconds += seconds(start, Clock::now());
+        if (count <= 0) {
+          break;
+        }
+        slot.first = first;
+        slot.count = count;
+        first += count;
+        filled.push(s);
+        if (count < chunk) {
+          break;
+        }
+      }
+      filled.close();
+    });
+
+    std::thread writer([&]() {
+      int s;
+      while (computed.pop(s)) {
+        Clock::time_point start = Clock::now();
+        Slot& slot = slots[s];
+        if (!output(static_cast<const float*>(slot.result.data), slot.first, slot.count)) {
+          failed = true;
+          free.close();
+        }
+        stats.writeSeconds += seconds(start, Clock::now());
+        free.push(s);
+      }
+    });
+
+    int s;
+    while (filled.pop(s)) {
+      Slot& slot = slots[s];
+      Clock::time_point start = Clock::now();
+      float* done = failed ? nullptr : compute(id, static_cast<const float*>(slot.a.data),
+                                               static_cast<const float*>(slot.b.data),
+                                               static_cast<float*>(slot.result.data), slot.count);
+      stats.computeSeconds += seconds(start, Clock::now());
+      if (done == nullptr) {
+        // stop the reader, and let the chunks already computed drain
+        failed = true;
+        free.close();
+        continue;
+      }
+      stats.elements += slot.count;
+      stats.chunks++;
+      computed.push(s);
+    }
+    computed.close();
+    reader.join();
+    writer.join();
+    ok = !failed;
+  }
+  for (Slot& slot : slots) {
+    pool->release(slot.a);
+    pool->release(slot.b);
+    pool->release(slot.result);
+  }
+
+  stats.wallSeconds = seconds(begin, Clock::now());
+  std::lock_guard<std::mutex> guard(lock);
+  last = stats;
+  return ok;
+}
+
+bool Ferrum::Streamer::stream_bB(Ferrum::FunctionID id, const std::string& input, const std::string& output) {
+  return mapped(id, input, nullptr, output);
+}
+
+bool Ferrum::Streamer::stream_bB(Ferrum::FunctionID id, const Source& input, const Sink& output) {
+  return pipeline(id, input, nullptr, output);
+}
+
+bool Ferrum::Streamer::stream_bbB(Ferrum::FunctionID id, const std::string& a, const std::string& b,
+                                  const std::string& output) {
+  return mapped(id, a, &b, output);
+}
+
+bool Ferrum::Streamer::stream_bbB(Ferrum::FunctionID id, const Source& a, const Source& b, const Sink& output) {
+  return pipeline(id, a, &b, output);
+}
@@ -0,0 +1,208 @@
+#include "threadpool.hpp"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Pins the calling thread to one CPU. Only a hint on platforms without affinity control.
+static void pinToCpu(int cpu) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+  (void)cpu;
+#endif
+}
+
+Ferrum::ThreadPool::ThreadPool(int threads, const std::vector<int>& cpus, const std::vector<int>& cpuNodes) :
+    queued(0), nextWorker(0), stopping(false) {
+  if (threads < 0) {
+    threads = std::max(0, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+  }
+  for (int i = 0; i < threads; i++) {
+    workers.emplace_back(new Worker());
+    int node = cpuNodes.empty() || cpus.empty() ? 0 : cpuNodes[i % cpus.size()];
+    workers[i]->node = node;
+    if (static_cast<int>(nodeWorkers.size()) <= node) {
+      nodeWorkers.resize(node + 1);
+    }
+    nodeWorkers[node].push_back(i);
+  }
+  // start the threads only once every deque exists, since workers steal from each other
+  for (int i = 0; i < threads; i++) {
+    int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+    workers[i]->thread = std::thread(&ThreadPool::workerLoop, this, i, cpu);
+  }
+}
+
+Ferrum::ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> guard(sleepLock);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto& worker : workers) {
+    worker->thread.join();
+  }
+}
+
+void Ferrum::ThreadPool::parallelFor(long n, long grain, const Body& body) {
+  if (n <= 0) {
+    return;
+  }
+  grain = std::max(1L, grain);
+  if (workers.empty() || n <= grain) {
+    for (long begin = 0; begin < n; begin += grain) {
+      body(begin, std::min(n, begin + grain));
+    }
+    return;
+  }
+
+  Job job;
+  job.body = &body;
+  job.grain = grain;
+  job.remaining = n;
+  job.done = false;
+  run(Task{&job, 0, n}, -1);
+  wait(job);
+}
+
+void Ferrum::ThreadPool::parallelFor(long n, long grain, const Body& body, const std::vector<long>& nodeSplits) {
+  if (n <= 0) {
+    return;
+  }
+  if (workers.empty() || nodeSplits.size() < 3) {
+    parallelFor(n, grain, body);
+    return;
+  }
+
+  Job job;
+  job.body = &body;
+  job.grain = std::max(1L, grain);
+  job.remaining = n;
+  job.done = false;
+  for (size_t k = 0; k + 1 < nodeSplits.size(); k++) {
+    long begin = nodeSplits[k];
+    long end = nodeSplits[k + 1];
+    if (begin >= end) {
+      continue;
+    }
+    // the node's workers split the range further between themselves
+    const std::vector<int>* local = k < nodeWorkers.size() ? &nodeWorkers[k] : nullptr;
+    int target = (local != nullptr && !local->empty())
+                   ? (*local)[nextWorker.fetch_add(1) % local->size()]
+                   : static_cast<int>(nextWorker.fetch_add(1) % workers.size());
+    pushTo(Task{&job, begin, end}, target);
+  }
+  wait(job);
+}
+
+// Helps with whatever is queued until the job is finished
+void Ferrum::ThreadPool::wait(Job& job) {
+  Task task;
+  while (job.remaining.load() > 0 && steal(-1, task)) {
+    run(task, -1);
+  }
+  // done is set under the lock by the last task, so once it is seen here nothing
+  // else touches the job, which lives on the caller's stack
+  std::unique_lock<std::mutex> guard(job.lock);
+  job.finished.wait(guard, [&]() { return job.done; });
+}
+
+void Ferrum::ThreadPool::workerLoop(int index, int cpu) {
+  if (cpu >= 0) {
+    pinToCpu(cpu);
+  }
+  Task task;
+  while (true) {
+    if (pop(index, task) || steal(index, task)) {
+      run(task, index);
+      continue;
+    }
+    std::unique_lock<std::mutex> guard(sleepLock);
+    wake.wait(guard, [&]() { return stopping || queued.load() > 0; });
+    if (stopping && queued.load() == 0) {
+      return;
+    }
+  }
+}
+
+// Splits the task down to the grain, offering each upper half to the pool, then runs what is left
+void Ferrum::ThreadPool::run(Task task, int self) {
+  Job* job = task.job;
+  while (task.end - task.begin > job->grain) {
+    long mid = task.begin + (task.end - task.begin) / 2;
+    push(Task{job, mid, task.end}, self);
+    task.end = mid;
+  }
+  (*job->body)(task.begin, task.end);
+  long count = task.end - task.begin;
+  if (job->remaining.fetch_sub(count) == count) {
+    std::lock_guard<std::mutex> guard(job->lock);
+    job->done = true;
+    job->finished.notify_all();
+  }
+}
+
+// Workers push onto their own deque. Callers are not workers, so they deal their work out.
+void Ferrum::ThreadPool::push(const Task& task, int self) {
+  int target = self >= 0 ? self : static_cast<int>(nextWorker.fetch_add(1) % workers.size());
+  pushTo(task, target);
+}
+
+void Ferrum::ThreadPool::pushTo(const Task& task, int target) {
+  {
+    std::lock_guard<std::mutex> guard(workers[target]->lock);
+    workers[target]->tasks.push_back(task);
+  }
+  queued++;
+  {
+    // pairs with the predicate check in workerLoop, so the wake-up cannot be missed
+    std::lock_guard<std::mutex> guard(sleepLock);
+  }
+  wake.notify_one();
+}
+
+bool Ferrum::ThreadPool::pop(int self, Task& task) {
+  Worker& worker = *workers[self];
+  std::lock_guard<std::mutex> guard(worker.lock);
+  if (worker.tasks.empty()) {
+    return false;
+  }
+  task = worker.tasks.back();
+  worker.tasks.pop_back();
+  queued--;
+  return true;
+}
+
+bool Ferrum::ThreadPool::steal(int self, Task& task) {
+  if (queued.load() == 0) {
+    return false;
+  }
+  int count = static_cast<int>(workers.size());
+  int start = self >= 0 ? self + 1 : static_cast<int>(nextWorker.load() % count);
+  // workers look on their own node first, where the memory for the work is likely to be
+  int node = self >= 0 ? workers[self]->node : -1;
+  for (int pass = (node >= 0 && nodeWorkers.size() > 1) ? 0 : 1; pass < 2; pass++) {
+    for (int i = 0; i < count; i++) {
+      int victim = (start + i) % count;
+      if (victim == self || (pass == 0 && workers[victim]->node != node)) {
+        continue;
+      }
+      Worker& worker = *workers[victim];
+      std::lock_guard<std::mutex> guard(worker.lock);
+      if (!worker.tasks.empty()) {
+        task = worker.tasks.front();
+        worker.tasks.pop_front();
+        queued--;
+        return true;
+      }
+    }
+  }
+  return false;
+}
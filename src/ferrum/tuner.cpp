@@ -0,0 +1,608 @@
+#include "tuner.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <set>
+#include <sstream>
+
+#include "cpukernels.hpp"
+
+static const char* PROFILE_MAGIC = "ferrum-tuning";
+
+// Functions that take scalars, and so cannot be timed through the plain argument forms
+static const std::set<std::string> SCALAR_FUNCTIONS = {
+  "vector_elu", "vector_linear_frac", "vector_powx", "vector_relu", "vector_scale_shift"
+};
+
+// The name of each function, by ID
+static std::vector<std::string> functionNames() {
+  std::vector<std::string> names;
+  for (const Ferrum::FunctionInfo& info : Ferrum::FUNCTION_INFO) {
+    names.push_back(info.name);
+  }
+  return names;
+}
+
+static std::vector<std::string> backendNames(const std::vector<Ferrum::Backend*>& backends) {
+  std::vector<std::string> names;
+  for (Ferrum::Backend* backend : backends) {
+    names.push_back(backend->name());
+  }
+  return names;
+}
+
+void Ferrum::TuningProfile::set(Ferrum::FunctionID id, int sizeClass, bool strided, Ferrum::Choice choice) {
+  choices[Key{static_cast<int>(id), strided, sizeClass}] = choice;
+}
+
+const Ferrum::Choice* Ferrum::TuningProfile::find(Ferrum::FunctionID id, int sizeClass, bool strided) const {
+  int fn = static_cast<int>(id);
+  auto above = choices.lower_bound(Key{fn, strided, sizeClass});
+  bool hasAbove = above != choices.end() && std::get<0>(above->first) == fn && std::get<1>(above->first) == strided;
+  if (hasAbove && std::get<2>(above->first) == sizeClass) {
+    return &above->second;
+  }
+  auto below = above;
+  bool hasBelow = false;
+  if (below != choices.begin()) {
+    --below;
+    hasBelow = std::get<0>(below->first) == fn && std::get<1>(below->first) == strided;
+  }
+  if (hasAbove && hasBelow) {
+    int up = std::get<2>(above->first) - sizeClass;
+    int down = sizeClass - std::get<2>(below->first);
+    return up < down ? &above->second : &below->second;
+  }
+  return hasAbove ? &above->second : hasBelow ? &below->second : nullptr;
+}
+
+// ferrum-tuning <version>
+// backends <name> ...
+// <function> <strided> <size class> <backend> <option>
+bool Ferrum::TuningProfile::save(const std::string& path) const {
+  std::ofstream out(path);
+  if (!out) {
+    std::cerr << "Error: Failed to write tuning profile: " << path << std::endl;
+    return false;
+  }
+  std::vector<std::string> fnNames = functionNames();
+  out << PROFILE_MAGIC << " " << VERSION << "\n" << "backends";
+  for (const std::string& name : names) {
+    out << " " << name;
+  }
+  out << "\n";
+  for (const auto& entry : choices) {
+    out << fnNames[std::get<0>(entry.first)] << " " << std::get<1>(entry.first) << " " << std::get<2>(entry.first)
+        << " " << entry.second.backend << " " << entry.second.option << "\n";
+  }
+  return static_cast<bool>(out);
+}
+
+bool Ferrum::TuningProfile::load(const std::string& path) {
+  names.clear();
+  choices.clear();
+  std::ifstream in(path);
+  std::string magic, label, line;
+  int version = 0;
+  if (!(in >> magic >> version) || magic != PROFILE_MAGIC || version != VERSION) {
+    return false;
+  }
+  std::getline(in, line);
+  std::getline(in, line);
+  std::istringstream header(line);
+  if (!(header >> label) || label != "backends") {
+    return false;
+  }
+  for (std::string name; header >> name;) {
+    names.push_back(name);
+  }
+  while (std::getline(in, line)) {
+    std::istringstream fields(line);
+    std::string fn;
+    int strided, sizeClass;
+    Choice choice;
+    if (!(fields >> fn >> strided >> sizeClass >> choice.backend >> choice.option) ||
+        choice.backend < 0 || choice.backend >= static_cast<int>(names.size())) {
+      names.clear();
+      choices.clear();
+      return false;
+    }
+    // functions that are no longer in the library are dropped
+    FunctionID id = getFunctionID(fn);
+    if (id != FunctionID::UNKNOWN) {
+      set(id, sizeClass, strided != 0, choice);
+    }
+  }
+  return true;
+}
+
+// The best of several runs of one call, in nanoseconds. A call that fails is never chosen.
+static double timeCall(Ferrum::Backend* backend, Ferrum::FunctionID id, Ferrum::KernelKind kind, long len, long inc,
+                       std::vector<float>& a, std::vector<float>& b, std::vector<float>& r, int repeats) {
+  long n = Ferrum::elementCount(len, 0, inc);
+  double best = std::numeric_limits<double>::infinity();
+  // the first run is a warm-up
+  for (int i = 0; i <= repeats; i++) {
+    auto start = std::chrono::steady_clock::now();
+    float* done = nullptr;
+    switch (kind) {
+      case Ferrum::KernelKind::UNARY:
+        done = backend->vect_bB(id, n, a.data(), len, 0, inc, r.data(), len, 0, inc);
+        break;
+      case Ferrum::KernelKind::BINARY:
+        done = backend->vect_bbB(id, n, a.data(), len, 0, inc, b.data(), len, 0, inc, r.data(), len, 0, inc);
+        break;
+      case Ferrum::KernelKind::PAIR:
+        done = backend->vect_bBB(id, n, a.data(), len, 0, inc, b.data(), len, 0, inc, r.data(), len, 0, inc);
+        break;
+      default:
+        break;
+    }
+    if (done == nullptr) {
+      return std::numeric_limits<double>::infinity();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    if (i > 0) {
+      best = std::min(best, elapsed.count());
+    }
+  }
+  return best;
+}
+
+Ferrum::TuningProfile Ferrum::calibrate(const std::vector<Ferrum::Backend*>& backends,
+                                       const Ferrum::CalibrationOptions& options) {
+  TuningProfile profile(backendNames(backends));
+
+  // families of vector functions, by kind and cost, with members in name order
+  std::vector<std::string> fnNames = functionNames();
+  std::sort(fnNames.begin(), fnNames.end());
+  std::map<std::pair<KernelKind, int>, std::vector<std::string>> families;
+  for (const std::string& fn : fnNames) {
+    const CpuKernel& kernel = cpuKernel(getFunctionID(fn));
+    if (fn.rfind("vector_", 0) == 0 && kernel.shape == KernelShape::VECTOR && kernel.kind != KernelKind::UNSUPPORTED) {
+      families[{kernel.kind, kernel.cost}].push_back(fn);
+    }
+  }
+
+  for (const auto& family : families) {
+    auto timed = std::find_if(family.second.begin(), family.second.end(),
+                              [](const std::string& fn) { return SCALAR_FUNCTIONS.count(fn) == 0; });
+    if (timed == family.second.end()) {
+      continue;
+    }
+    FunctionID id = getFunctionID(*timed);
+    KernelKind kind = family.first.first;
+
+    for (long n = options.minLength; n <= options.maxLength; n *= 4) {
+      int c = sizeClass(n);
+      for (bool strided : {false, true}) {
+        long inc = strided ? 2 : 1;
+        long len = (n - 1) * inc + 1;
+        std::vector<float> a(len), b(len), r(len);
+        for (long i = 0; i < len; i++) {
+          a[i] = 0.25f + (i % 100) * 0.005f;
+          b[i] = 0.75f - (i % 77) * 0.005f;
+        }
+        Choice best{0, 0};
+        double bestTime = std::numeric_limits<double>::infinity();
+        for (size_t k = 0; k < backends.size(); k++) {
+          std::vector<int> launch = backends[k]->launchOptions(id);
+          launch.insert(launch.begin(), 0);
+          for (int option : launch) {
+            backends[k]->setLaunchOption(id, c, option);
+            double t = timeCall(backends[k], id, kind, len, inc, a, b, r, options.repeats);
+            if (t < bestTime) {
+              bestTime = t;
+              best = Choice{static_cast<int>(k), option};
+            }
+          }
+          backends[k]->setLaunchOption(id, c, 0);
+        }
+        for (const std::string& fn : family.second) {
+          profile.set(getFunctionID(fn), c, strided, best);
+        }
+      }
+    }
+  }
+  return profile;
+}
+
+// The vector function whose profile applies to a function: itself for vectors,
+// and the vector form of the same operation for ge and uplo functions
+static Ferrum::FunctionID measuredAs(const std::string& fn) {
+  for (const char* prefix : {"vector_", "ge_", "uplo_"}) {
+    if (fn.rfind(prefix, 0) == 0) {
+      return Ferrum::getFunctionID("vector_" + fn.substr(std::string(prefix).size()));
+    }
+  }
+  return Ferrum::FunctionID::UNKNOWN;
+}
+
+Ferrum::TunedEngine::TunedEngine(const std::vector<Ferrum::Backend*>& backends, const Ferrum::TuningProfile& profile) :
+    engines(backends), routes(FUNCTION_COUNT * 2 * SIZE_CLASSES, 0) {
+  if (!profile.empty() && profile.backendNames() != backendNames(engines)) {
+    std::cerr << "Error: Tuning profile was measured on other backends, and is ignored" << std::endl;
+    return;
+  }
+  for (int i = 0; i < FUNCTION_COUNT; i++) {
+    FunctionID id = static_cast<FunctionID>(i);
+    FunctionID measured = measuredAs(FUNCTION_INFO[i].name);
+    if (measured == FunctionID::UNKNOWN) {
+      continue;
+    }
+    for (int strided = 0; strided < 2; strided++) {
+      for (int c = 0; c < SIZE_CLASSES; c++) {
+        const Choice* choice = profile.find(measured, c, strided != 0);
+        if (choice == nullptr) {
+          continue;
+        }
+        routes[(static_cast<size_t>(id) * 2 + strided) * SIZE_CLASSES + c] = static_cast<signed char>(choice->backend);
+        // launch options do not depend on the stride, so the unit stride choice is kept
+        if (id == measured && strided == 0 && choice->option != 0) {
+          engines[choice->backend]->setLaunchOption(id, c, choice->option);
+        }
+      }
+    }
+  }
+}
+
+Ferrum::TunedEngine::~TunedEngine() {
+  for (Backend* engine : engines) {
+    delete engine;
+  }
+}
+
+int Ferrum::TunedEngine::route(Ferrum::FunctionID id, long n, bool strided) const {
+  size_t i = (static_cast<size_t>(id) * 2 + (strided ? 1 : 0)) * SIZE_CLASSES + sizeClass(n);
+  return (id == FunctionID::UNKNOWN || i >= routes.size()) ? 0 : routes[i];
+}
+
+// general vector functions
+float* Ferrum::TunedEngine::vect_bB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                    float* result, long len, long offset, long stride) {
+  bool strided = stride_a != 1 || stride != 1;
+  Backend* engine = engineFor(id, n, strided);
+  return engine->vect_bB(id, n, a, lena, offset_a, stride_a,
+                         result, len, offset, stride);
+}
+
+float* Ferrum::TunedEngine::vect_bfB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                     float sa,
+                                     float* result, long len, long offset, long stride) {
+  bool strided = stride_a != 1 || stride != 1;
+  Backend* engine = engineFor(id, n, strided);
+  return engine->vect_bfB(id, n, a, lena, offset_a, stride_a,
+                          sa,
+                          result, len, offset, stride);
+}
+
+float* Ferrum::TunedEngine::vect_fbB(Ferrum::FunctionID id, long n, float sa,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float* result, long len, long offset, long stride) {
+  bool strided = stride_a != 1 || stride != 1;
+  Backend* engine = engineFor(id, n, strided);
+  return engine->vect_fbB(id, n, sa,
+                          a, lena, offset_a, stride_a,
+                          result, len, offset, stride);
+}
+
+float* Ferrum::TunedEngine::vect_bbB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                     const float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) {
+  bool strided = stride_a != 1 || stride_b != 1 || stride != 1;
+  Backend* engine = engineFor(id, n, strided);
+  return engine->vect_bbB(id, n, a, lena, offset_a, stride_a,
+                          b, lenb, offset_b, stride_b,
+                          result, len, offset, stride);
+}
+
+float* Ferrum::TunedEngine::vect_bBB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                     float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) {
+  bool strided = stride_a != 1 || stride_b != 1 || stride != 1;
+  Backend* engine = engineFor(id, n, strided);
+  return engine->vect_bBB(id, n, a, lena, offset_a, stride_a,
+                          b, lenb, offset_b, stride_b,
+                          result, len, offset, stride);
+}
+
+float* Ferrum::TunedEngine::vect_bffffB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                        float sa, float sha,
+                                        float sb, float shb,
+                                        float* result, long len, long offset, long stride) {
+  bool strided = stride_a != 1 || stride != 1;
+  Backend* engine = engineFor(id, n, strided);
+  return engine->vect_bffffB(id, n, a, lena, offset_a, stride_a,
+                             sa, sha,
+                             sb, shb,
+                             result, len, offset, stride);
+}
+
+float* Ferrum::TunedEngine::vect_bbffffB(Ferrum::FunctionID id, long n, const float* a, long lena, long offset_a, long stride_a,
+                                         const float* b, long lenb, long offset_b, long stride_b,
+                                         float sa, float sha,
+                                         float sb, float shb,
+                                         float* result, long len, long offset, long stride) {
+  bool strided = stride_a != 1 || stride_b != 1 || stride != 1;
+  Backend* engine = engineFor(id, n, strided);
+  return engine->vect_bbffffB(id, n, a, lena, offset_a, stride_a,
+                              b, lenb, offset_b, stride_b,
+                              sa, sha,
+                              sb, shb,
+                              result, len, offset, stride);
+}
+
+// general matrix functions
+float* Ferrum::TunedEngine::ge_bB(Ferrum::FunctionID id, long sd, long fd,
+                                  const float* a, long lena, long offset_a, long stride_a,
+                                  float* result, long len, long offset, long stride) {
+  Backend* engine = engineFor(id, sd * fd, false);
+  return engine->ge_bB(id, sd, fd,
+                       a, lena, offset_a, stride_a,
+                       result, len, offset, stride);
+}
+
+float* Ferrum::TunedEngine::ge_bfB(Ferrum::FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float sa,
+                                   float* result, long len, long offset, long stride) {
+  Backend* engine = engineFor(id, sd * fd, false);
+  return engine->ge_bfB(id, sd, fd,
+                        a, lena, offset_a, stride_a,
+                        sa,
+                        result, len, offset, stride);
+}
+
+float* Ferrum::TunedEngine::ge_fbB(Ferrum::FunctionID id, long sd, long fd, float sa,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* result, long len, long offset, long stride) {
+  Backend* engine = engineFor(id, sd * fd, false);
+  return engine->ge_fbB(id, sd, fd, sa,
+                        a, lena, offset_a, stride_a,
+                        result, len, offset, stride);
+}
+
+float* Ferrum::TunedEngine::ge_bbB(Ferrum::FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   const float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) {
+  Backend* engine = engineFor(id, sd * fd, false);
+  return engine->ge_bbB(id, sd, fd,
+                        a, lena, offset_a, stride_a,
+                        b, lenb, offset_b, stride_b,
+                        result, len, offset, stride);
+}
+
+float* Ferrum::TunedEngine::ge_bBB(Ferrum::FunctionID id, long sd, long fd,
+                                   const float* a, long lena, long offset_a, long stride_a,
+                                   float* b, long lenb, long offset_b, long stride_b,
+                                   float* result, long len, long offset, long stride) {
+  Backend* engine = engineFor(id, sd * fd, false);
+  return engine->ge_bBB(id, sd, fd,
+                        a, lena, offset_a, stride_a,
+                        b, lenb, offset_b, stride_b,
+                        result, len, offset, stride);
+}
+
+float* Ferrum::TunedEngine::ge_bffffB(Ferrum::FunctionID id, long sd, long fd,
+                                      const float* a, long lena, long offset_a, long stride_a,
+                                      float sa, float sha,
+                                      float sb, float shb,
+                                      float* result, long len, long offset, long stride) {
+  Backend* engine = engineFor(id, sd * fd, false);
+  return engine->ge_bffffB(id, sd, fd,
+                           a, lena, offset_a, stride_a,
+                           sa, sha,
+                           sb, shb,
+                           result, len, offset, stride);
+}
+
+float* Ferrum::TunedEngine::ge_bbffffB(Ferrum::FunctionID id, long sd, long fd,
+                                       const float* a, long lena, long offset_a, long stride_a,
+                                       const float* b, long lenb, long offset_b, long stride_b,
+                                       float sa, float sha,
+                                       float sb, float shb,
+                                       float* result, long len, long offset, long stride) {
+  Backend* engine = engineFor(id, sd * fd, false);
+  return engine->ge_bbffffB(id, sd, fd,
+                            a, lena, offset_a, stride_a,
+                            b, lenb, offset_b, stride_b,
+                            sa, sha,
+                            sb, shb,
+                            result, len, offset, stride);
+}
+
+// general uplo functions
+float* Ferrum::TunedEngine::uplo_bB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                    const float* a, long lena, long offset_a, long stride_a,
+                                    float* result, long len, long offset, long stride) {
+  Backend* engine = engineFor(id, sd * sd / 2, false);
+  return engine->uplo_bB(id, sd, unit, bottom,
+                         a, lena, offset_a, stride_a,
+                         result, len, offset, stride);
+}
+
+float* Ferrum::TunedEngine::uplo_bfB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float sa,
+                                     float* result, long len, long offset, long stride) {
+  Backend* engine = engineFor(id, sd * sd / 2, false);
+  return engine->uplo_bfB(id, sd, unit, bottom,
+                          a, lena, offset_a, stride_a,
+                          sa,
+                          result, len, offset, stride);
+}
+
+float* Ferrum::TunedEngine::uplo_fbB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float sa,
+                                     float* result, long len, long offset, long stride) {
+  Backend* engine = engineFor(id, sd * sd / 2, false);
+  return engine->uplo_fbB(id, sd, unit, bottom,
+                          a, lena, offset_a, stride_a,
+                          sa,
+                          result, len, offset, stride);
+}
+
+float* Ferrum::TunedEngine::uplo_bbB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     const float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) {
+  Backend* engine = engineFor(id, sd * sd / 2, false);
+  return engine->uplo_bbB(id, sd, unit, bottom,
+                          a, lena, offset_a, stride_a,
+                          b, lenb, offset_b, stride_b,
+                          result, len, offset, stride);
+}
+
+float* Ferrum::TunedEngine::uplo_bBB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                     const float* a, long lena, long offset_a, long stride_a,
+                                     float* b, long lenb, long offset_b, long stride_b,
+                                     float* result, long len, long offset, long stride) {
+  Backend* engine = engineFor(id, sd * sd / 2, false);
+  return engine->uplo_bBB(id, sd, unit, bottom,
+                          a, lena, offset_a, stride_a,
+                          b, lenb, offset_b, stride_b,
+                          result, len, offset, stride);
+}
+
+float* Ferrum::TunedEngine::uplo_bffffB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                        const float* a, long lena, long offset_a, long stride_a,
+                                        float sa, float sha,
+                                        float sb, float shb,
+                                        float* result, long len, long offset, long stride) {
+  Backend* engine = engineFor(id, sd * sd / 2, false);
+  return engine->uplo_bffffB(id, sd, unit, bottom,
+                             a, lena, offset_a, stride_a,
+                             sa, sha,
+                             sb, shb,
+                             result, len, offset, stride);
+}
+
+float* Ferrum::TunedEngine::uplo_bbffffB(Ferrum::FunctionID id, long sd, int unit, int bottom,
+                                         const float* a, long lena, long offset_a, long stride_a,
+                                         const float* b, long lenb, long offset_b, long stride_b,
+                                         float sa, float sha,
+                                         float sb, float shb,
+                                         float* result, long len, long offset, long stride) {
+  Backend* engine = engineFor(id, sd * sd / 2, false);
+  return engine->uplo_bbffffB(id, sd, unit, bottom,
+                              a, lena, offset_a, stride_a,
+                              b, lenb, offset_b, stride_b,
+                              sa, sha,
+                              sb, shb,
+                              result, len, offset, stride);
+}
+
+// linear algebra functions
+
+float* Ferrum::TunedEngine::gemm(int transA, int transB, long m, long n, long k, float alpha,
+                                 const float* a, long lena, long offset_a, long lda,
+                                 const float* b, long lenb, long offset_b, long ldb,
+                                 float beta, float* c, long lenc, long offset_c, long ldc) {
+  Backend* engine = engineFor(FunctionID::blas_gemm, m * n, false);
+  return engine->gemm(transA, transB, m, n, k, alpha, a, lena, offset_a, lda, b, lenb, offset_b, ldb,
+                      beta, c, lenc, offset_c, ldc);
+}
+
+float* Ferrum::TunedEngine::gemv(int trans, long m, long n, float alpha,
+                                 const float* a, long lena, long offset_a, long lda,
+                                 const float* x, long lenx, long offset_x, long stride_x,
+                                 float beta, float* y, long leny, long offset_y, long stride_y) {
+  FunctionID id = trans == TRANS ? FunctionID::blas_gemv_t : FunctionID::blas_gemv_n;
+  Backend* engine = engineFor(id, m * n, stride_x != 1 || stride_y != 1);
+  return engine->gemv(trans, m, n, alpha, a, lena, offset_a, lda, x, lenx, offset_x, stride_x,
+                      beta, y, leny, offset_y, stride_y);
+}
+
+float* Ferrum::TunedEngine::ger(long m, long n, float alpha,
+                                const float* x, long lenx, long offset_x, long stride_x,
+                                const float* y, long leny, long offset_y, long stride_y,
+                                float* a, long lena, long offset_a, long lda) {
+  Backend* engine = engineFor(FunctionID::blas_ger, m * n, stride_x != 1 || stride_y != 1);
+  return engine->ger(m, n, alpha, x, lenx, offset_x, stride_x, y, leny, offset_y, stride_y,
+                     a, lena, offset_a, lda);
+}
+
+float* Ferrum::TunedEngine::trmv(int trans, long sd, int unit, int bottom,
+                                 const float* a, long lena, long offset_a, long lda,
+                                 float* x, long lenx, long offset_x, long stride_x) {
+  Backend* engine = engineFor(FunctionID::blas_trmv, sd * sd / 2, stride_x != 1);
+  return engine->trmv(trans, sd, unit, bottom, a, lena, offset_a, lda, x, lenx, offset_x, stride_x);
+}
+
+float* Ferrum::TunedEngine::trsv(int trans, long sd, int unit, int bottom,
+                                 const float* a, long lena, long offset_a, long lda,
+                                 float* x, long lenx, long offset_x, long stride_x) {
+  Backend* engine = engineFor(FunctionID::blas_trsv, sd * sd / 2, stride_x != 1);
+  return engine->trsv(trans, sd, unit, bottom, a, lena, offset_a, lda, x, lenx, offset_x, stride_x);
+}
+
+float* Ferrum::TunedEngine::trmm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                                 const float* a, long lena, long offset_a, long lda,
+                                 float* b, long lenb, long offset_b, long ldb) {
+  Backend* engine = engineFor(FunctionID::blas_trmm, m * n, false);
+  return engine->trmm(side, trans, m, n, unit, bottom, alpha, a, lena, offset_a, lda, b, lenb, offset_b, ldb);
+}
+
+float* Ferrum::TunedEngine::trsm(int side, int trans, long m, long n, int unit, int bottom, float alpha,
+                                 const float* a, long lena, long offset_a, long lda,
+                                 float* b, long lenb, long offset_b, long ldb) {
+  Backend* engine = engineFor(FunctionID::blas_trsm, m * n, false);
+  return engine->trsm(side, trans, m, n, unit, bottom, alpha, a, lena, offset_a, lda, b, lenb, offset_b, ldb);
+}
+
+float* Ferrum::TunedEngine::syrk(int trans, long n, long k, int bottom, float alpha,
+                                 const float* a, long lena, long offset_a, long lda,
+                                 float beta, float* c, long lenc, long offset_c, long ldc) {
+  Backend* engine = engineFor(FunctionID::blas_syrk, n * k, false);
+  return engine->syrk(trans, n, k, bottom, alpha, a, lena, offset_a, lda, beta, c, lenc, offset_c, ldc);
+}
+
+float* Ferrum::TunedEngine::potrf(long sd, int bottom, float* a, long lena, long offset_a, long lda) {
+  Backend* engine = engineFor(FunctionID::blas_potrf, sd * sd / 2, false);
+  return engine->potrf(sd, bottom, a, lena, offset_a, lda);
+}
+
+float* Ferrum::TunedEngine::potrs(long sd, long n, int bottom, const float* a, long lena, long offset_a, long lda,
+                                  float* b, long lenb, long offset_b, long ldb) {
+  // two triangular solves
+  Backend* engine = engineFor(FunctionID::blas_trsm, sd * n, false);
+  return engine->potrs(sd, n, bottom, a, lena, offset_a, lda, b, lenb, offset_b, ldb);
+}
+
+float* Ferrum::TunedEngine::trttp(long sd, int bottom, const float* a, long lena, long offset_a, long lda,
+                                  float* ap, long lenap, long offset_ap) {
+  Backend* engine = engineFor(FunctionID::blas_trttp, packedLength(sd), false);
+  return engine->trttp(sd, bottom, a, lena, offset_a, lda, ap, lenap, offset_ap);
+}
+
+float* Ferrum::TunedEngine::tpttr(long sd, int bottom, const float* ap, long lenap, long offset_ap,
+                                  float* a, long lena, long offset_a, long lda) {
+  Backend* engine = engineFor(FunctionID::blas_tpttr, packedLength(sd), false);
+  return engine->tpttr(sd, bottom, ap, lenap, offset_ap, a, lena, offset_a, lda);
+}
+
+float* Ferrum::TunedEngine::tpmv(int trans, long sd, int unit, int bottom, const float* ap, long lenap, long offset_ap,
+                                 float* x, long lenx, long offset_x, long stride_x) {
+  Backend* engine = engineFor(FunctionID::blas_tpmv, packedLength(sd), stride_x != 1);
+  return engine->tpmv(trans, sd, unit, bottom, ap, lenap, offset_ap, x, lenx, offset_x, stride_x);
+}
+
+float* Ferrum::TunedEngine::spmv(long sd, int bottom, float alpha, const float* ap, long lenap, long offset_ap,
+                                 const float* x, long lenx, long offset_x, long stride_x,
+                                 float beta, float* y, long leny, long offset_y, long stride_y) {
+  Backend* engine = engineFor(FunctionID::blas_spmv, packedLength(sd), stride_x != 1 || stride_y != 1);
+  return engine->spmv(sd, bottom, alpha, ap, lenap, offset_ap, x, lenx, offset_x, stride_x,
+                      beta, y, leny, offset_y, stride_y);
+}
+
+float* Ferrum::TunedEngine::omatcopy(int trans, long m, long n, float alpha,
+                                     const float* a, long lena, long offset_a, long lda,
+                                     float* b, long lenb, long offset_b, long ldb) {
+  Backend* engine = engineFor(FunctionID::blas_omatcopy, m * n, false);
+  return engine->omatcopy(trans, m, n, alpha, a, lena, offset_a, lda, b, lenb, offset_b, ldb);
+}
@@ -5,8 +5,12 @@
 #define MTL_PRIVATE_IMPLEMENTATION
 
 // include the std namespace so we can use the std::cout and std::getenv
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <fstream>
+#include <set>
+#include <vector>
 
 #include <Metal/Metal.hpp>
 #include <MetalKit/MetalKit.hpp>
@@ -129,7 +133,123 @@ MTL::Library* loadLibrary(const char* path) {
   return library;
 }
 
-void printCode(std::vector<std::string>& names, const char* header, const char* cpp) {
+// A kernel's name, the operand buffers it only reads, the buffers it writes (and may also
+// read), and its float scalars
+struct Kernel {
+  std::string name;
+  int inputs;
+  int outputs;
+  int scalars;
+};
+
+// Reads a kernel's operands from its argument reflection. An operand buffer x is the one
+// followed by its offset_x, and is an output unless it is declared const.
+Kernel describe(MTL::Library* library, const std::string& name) {
+  Kernel kernel{name, 0, 0, 0};
+  MTL::Function* function = library->newFunction(nsStr(name.c_str()));
+  MTL::ComputePipelineReflection* reflection = nullptr;
+  NS::Error* pError = nullptr;
+  MTL::ComputePipelineState* state = function == nullptr ? nullptr
+      : library->device()->newComputePipelineState(function, MTL::PipelineOptionArgumentInfo, &reflection, &pError);
+  if (state == nullptr || reflection == nullptr) {
+    std::cerr << "Error: Failed to reflect on function: " << name << std::endl;
+  } else {
+    NS::Array* arguments = reflection->arguments();
+    std::set<std::string> offsets;
+    for (NS::UInteger i = 0; i < arguments->count(); i++) {
+      offsets.insert(str(arguments->object<MTL::Argument>(i)->name()));
+    }
+    for (NS::UInteger i = 0; i < arguments->count(); i++) {
+      MTL::Argument* argument = arguments->object<MTL::Argument>(i);
+      if (argument->type() != MTL::ArgumentTypeBuffer) {
+        continue;
+      }
+      if (offsets.count(std::string("offset_") + str(argument->name())) != 0) {
+        (argument->access() == MTL::ArgumentAccessReadOnly ? kernel.inputs : kernel.outputs)++;
+      } else if (argument->bufferDataType() == MTL::DataTypeFloat) {
+        kernel.scalars++;
+      }
+    }
+    state->release();
+  }
+  if (function != nullptr) {
+    function->release();
+  }
+  return kernel;
+}
+
+// Must match functionHash in the generated header
+uint32_t functionHash(const std::string& name, uint32_t seed) {
+  uint32_t h = 2166136261u ^ seed;
+  for (unsigned char c : name) {
+    h = (h ^ c) * 16777619u;
+  }
+  h ^= h >> 16;
+  h *= 0x7feb352du;
+  h ^= h >> 15;
+  h *= 0x846ca68bu;
+  return h ^ (h >> 16);
+}
+
+// A perfect hash of the names, by hash and displace: the names are put in buckets by one hash,
+// and each bucket, largest first, finds a seed that hashes its names into free slots.
+// Returns false if some bucket finds no seed.
+bool perfectHash(const std::vector<Kernel>& kernels, uint32_t buckets, uint32_t slots,
+                 std::vector<uint32_t>& seeds, std::vector<int>& table) {
+  std::vector<std::vector<int>> members(buckets);
+  for (size_t i = 0; i < kernels.size(); i++) {
+    members[functionHash(kernels[i].name, 0) & (buckets - 1)].push_back(static_cast<int>(i));
+  }
+  std::vector<uint32_t> order(buckets);
+  for (uint32_t b = 0; b < buckets; b++) {
+    order[b] = b;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t x, uint32_t y) {
+    return members[x].size() > members[y].size();
+  });
+  seeds.assign(buckets, 0);
+  table.assign(slots, -1);
+  for (uint32_t b : order) {
+    if (members[b].empty()) {
+      break;
+    }
+    bool placed = false;
+    for (uint32_t seed = 1; seed < (1u << 20) && !placed; seed++) {
+      std::vector<uint32_t> taken;
+      for (int i : members[b]) {
+        uint32_t slot = functionHash(kernels[i].name, seed) & (slots - 1);
+        if (table[slot] >= 0 || std::find(taken.begin(), taken.end(), slot) != taken.end()) {
+          break;
+        }
+        taken.push_back(slot);
+      }
+      if (taken.size() == members[b].size()) {
+        for (size_t k = 0; k < taken.size(); k++) {
+          table[taken[k]] = members[b][k];
+        }
+        seeds[b] = seed;
+        placed = true;
+      }
+    }
+    if (!placed) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void printCode(std::vector<Kernel>& kernels, const char* header, const char* cpp) {
+  uint32_t slots = 1;
+  while (slots < kernels.size()) {
+    slots *= 2;
+  }
+  std::vector<uint32_t> seeds;
+  std::vector<int> table;
+  while (!perfectHash(kernels, std::max(slots / 4, 1u), slots, seeds, table)) {
+    slots *= 2;
+  }
+  uint32_t buckets = static_cast<uint32_t>(seeds.size());
+
   std::ofstream headerFile(header);
   if (!headerFile.is_open()) {
     std::cerr << "Error: Failed to open file: " << header << std::endl;
@@ -140,21 +260,81 @@ void printCode(std::vector<std::string>& names, const char* header, const char*
   headerFile << "#pragma once\n" << std::endl;
   headerFile << "#ifndef _FUNCTIONS_HPP" << std::endl;
   headerFile << "#define _FUNCTIONS_HPP\n" << std::endl;
+  headerFile << "#include <cstdint>" << std::endl;
   headerFile << "#include <string>" << std::endl;
-  headerFile << "#include <unordered_map>\n" << std::endl;
+  headerFile << "#include <string_view>\n" << std::endl;
   headerFile << "namespace Ferrum {\n" << std::endl;
-  headerFile << "  enum FunctionID {" << std::endl;
+  headerFile << "  enum FunctionID : int {" << std::endl;
   headerFile << "    UNKNOWN = -1," << std::endl;
   int index = 0;
-  for (const std::string& fn : names) {
-    headerFile << "    " << fn << " = " << index;
-    if (++index < names.size()) {
+  for (const Kernel& kernel : kernels) {
+    headerFile << "    " << kernel.name << " = " << index;
+    if (++index < kernels.size()) {
       headerFile << ",";
     }
     headerFile << std::endl;
   }
   headerFile << "  };\n" << std::endl;
-  headerFile << "  extern std::unordered_map<std::string, FunctionID>* functionMap;\n" << std::endl;
+  headerFile << "  const int FUNCTION_COUNT = " << kernels.size() << ";\n" << std::endl;
+  headerFile << "  // A kernel's operand buffers that are only read, the buffers it writes (and may also read)," << std::endl;
+  headerFile << "  // and its float scalars" << std::endl;
+  headerFile << "  struct FunctionInfo {" << std::endl;
+  headerFile << "    const char* name;" << std::endl;
+  headerFile << "    int inputs;" << std::endl;
+  headerFile << "    int outputs;" << std::endl;
+  headerFile << "    int scalars;" << std::endl;
+  headerFile << "  };\n" << std::endl;
+  headerFile << "  inline constexpr FunctionInfo FUNCTION_INFO[FUNCTION_COUNT] = {" << std::endl;
+  index = 0;
+  for (const Kernel& kernel : kernels) {
+    headerFile << "    {\"" << kernel.name << "\", " << kernel.inputs << ", " << kernel.outputs << ", "
+               << kernel.scalars << "}";
+    if (++index < kernels.size()) {
+      headerFile << ",";
+    }
+    headerFile << std::endl;
+  }
+  headerFile << "  };\n" << std::endl;
+  headerFile << "  // A perfect hash of the names: the bucket of a name holds the seed that hashes it to its slot," << std::endl;
+  headerFile << "  // and the slot holds its id. Empty slots hold 0, whose name does not match." << std::endl;
+  headerFile << "  const uint32_t FUNCTION_BUCKETS = " << buckets << ";" << std::endl;
+  headerFile << "  const uint32_t FUNCTION_SLOTS = " << slots << ";\n" << std::endl;
+  headerFile << "  inline constexpr uint32_t FUNCTION_SEEDS[FUNCTION_BUCKETS] = {";
+  for (uint32_t b = 0; b < buckets; b++) {
+    headerFile << (b % 16 == 0 ? "\n     " : "") << " " << seeds[b] << (b + 1 < buckets ? "," : "");
+  }
+  headerFile << "\n  };\n" << std::endl;
+  headerFile << "  inline constexpr int16_t FUNCTION_SLOT_IDS[FUNCTION_SLOTS] = {";
+  for (uint32_t s = 0; s < slots; s++) {
+    headerFile << (s % 16 == 0 ? "\n     " : "") << " " << std::max(table[s], 0) << (s + 1 < slots ? "," : "");
+  }
+  headerFile << "\n  };\n" << std::endl;
+  headerFile << "  // FNV-1a, finished with a mix so that every bit of the result depends on every bit of the name" << std::endl;
+  headerFile << "  constexpr uint32_t functionHash(std::string_view name, uint32_t seed) {" << std::endl;
+  headerFile << "    uint32_t h = 2166136261u ^ seed;" << std::endl;
+  headerFile << "    for (char c : name) {" << std::endl;
+  headerFile << "      h = (h ^ static_cast<unsigned char>(c)) * 16777619u;" << std::endl;
+  headerFile << "    }" << std::endl;
+  headerFile << "    h ^= h >> 16;" << std::endl;
+  headerFile << "    h *= 0x7feb352du;" << std::endl;
+  headerFile << "    h ^= h >> 15;" << std::endl;
+  headerFile << "    h *= 0x846ca68bu;" << std::endl;
+  headerFile << "    return h ^ (h >> 16);" << std::endl;
+  headerFile << "  }\n" << std::endl;
+  headerFile << "  // The id of a built-in function's name, or UNKNOWN" << std::endl;
+  headerFile << "  constexpr FunctionID functionID(std::string_view name) {" << std::endl;
+  headerFile << "    uint32_t seed = FUNCTION_SEEDS[functionHash(name, 0) & (FUNCTION_BUCKETS - 1)];" << std::endl;
+  headerFile << "    int id = FUNCTION_SLOT_IDS[functionHash(name, seed) & (FUNCTION_SLOTS - 1)];" << std::endl;
+  headerFile << "    return name == FUNCTION_INFO[id].name ? static_cast<FunctionID>(id) : UNKNOWN;" << std::endl;
+  headerFile << "  }\n" << std::endl;
+  headerFile << "  // The operands of a built-in function, or nullptr" << std::endl;
+  headerFile << "  constexpr const FunctionInfo* functionInfo(FunctionID id) {" << std::endl;
+  headerFile << "    return id >= 0 && id < FUNCTION_COUNT ? &FUNCTION_INFO[id] : nullptr;" << std::endl;
+  headerFile << "  }\n" << std::endl;
+  headerFile << "  // The name of a built-in function, or nullptr" << std::endl;
+  headerFile << "  constexpr const char* functionName(FunctionID id) {" << std::endl;
+  headerFile << "    return id >= 0 && id < FUNCTION_COUNT ? FUNCTION_INFO[id].name : nullptr;" << std::endl;
+  headerFile << "  }\n" << std::endl;
   headerFile << "} // namespace Ferrum\n" << std::endl;
   headerFile << "#endif // _FUNCTIONS_HPP\n" << std::endl;
   headerFile.close();
@@ -168,20 +348,14 @@ void printCode(std::vector<std::string>& names, const char* header, const char*
   headerName = headerName.substr(headerName.find_last_of('/') + 1);
   sourceFile << "// This file is auto-generated\n" << std::endl;
   sourceFile << "#include \"" << headerName << "\"\n" << std::endl;
-  sourceFile << "#include <unordered_map>\n" << std::endl;
+  sourceFile << "// Every name finds its own id, as this file compiles" << std::endl;
   sourceFile << "namespace Ferrum {" << std::endl;
-  sourceFile << "  std::unordered_map<std::string, FunctionID>* functionMap;\n" << std::endl;
-  sourceFile << "  __attribute__((constructor)) void initFunctionMap() {" << std::endl;
-  sourceFile << "    functionMap = new std::unordered_map<std::string, FunctionID>();" << std::endl;
-  sourceFile << "    std::unordered_map<std::string, FunctionID>& fnMap = *functionMap;" << std::endl;
-  for (const std::string& fn : names) {
-    sourceFile << "    fnMap[\"" << fn << "\"] = " << fn << ";" << std::endl;
-  }
-  sourceFile << "  }\n" << std::endl;
-  sourceFile << "  __attribute__((destructor)) void cleanupFunctionMap() {" << std::endl;
-  sourceFile << "    delete functionMap;" << std::endl;
-  sourceFile << "    functionMap = nullptr;" << std::endl;
-  sourceFile << "  }\n\n} // namespace Ferrum\n" << std::endl;
+  for (const Kernel& kernel : kernels) {
+    sourceFile << "  static_assert(functionID(\"" << kernel.name << "\") == " << kernel.name << ");" << std::endl;
+  }
+  sourceFile << "  static_assert(functionID(\"\") == UNKNOWN);" << std::endl;
+  sourceFile << "  static_assert(functionID(\"" << kernels[0].name << "_\") == UNKNOWN);" << std::endl;
+  sourceFile << "} // namespace Ferrum\n" << std::endl;
   sourceFile.close();
 }
 
@@ -231,7 +405,11 @@ int main(int argc, char** argv) {
     names.push_back(name->utf8String());
   }
   std::sort(names.begin(), names.end());
-  printCode(names, headerFile.c_str(), srcFile.c_str());
+  std::vector<Kernel> kernels;
+  for (const std::string& name : names) {
+    kernels.push_back(describe(library, name));
+  }
+  printCode(kernels, headerFile.c_str(), srcFile.c_str());
   std::cout << "Generated code for " << length << " function names" << std::endl;
   return 0;
 }